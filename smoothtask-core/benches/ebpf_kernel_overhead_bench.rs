@@ -0,0 +1,543 @@
+//! Сквозной бенчмарк стоимости eBPF программ в ядре
+//!
+//! В отличие от `ebpf_benchmarks.rs`, который измеряет коллектор в userspace,
+//! этот бенчмарк загружает каждый встроенный объект из `src/ebpf_programs/`,
+//! прикрепляет его программы и прогоняет воспроизводимые нагрузки:
+//! - `fork_exec` — шторм fork/exec (`/bin/true`);
+//! - `syscall_flood` — поток системных вызовов (`getppid`);
+//! - `context_switch` — пинг-понг двух потоков через пару сокетов;
+//! - `tcp_churn` — установка и закрытие TCP соединений через loopback;
+//! - `block_io` — случайные чтения и записи блоками 4 КиБ в духе fio
+//!   (`randrw`, `fdatasync` и сброс кэша страниц каждые 64 операции).
+//!
+//! Для каждой пары «объект × нагрузка» в отчёт попадают:
+//! - добавленное время ядра на событие по статистике BPF (`run_time_ns` /
+//!   `run_cnt`, учёт включается через `BPF_ENABLE_STATS`);
+//! - изменение пропускной способности нагрузки относительно базового прогона,
+//!   в котором все объекты загружены, но откреплены;
+//! - память карт по учёту ядра (`memlock`);
+//! - время обхода хеш-карт в зависимости от числа записей.
+//!
+//! Отчёт выводится в JSON (`schema_version` меняется при несовместимых
+//! изменениях формата), его можно сравнивать между версиями и ядрами.
+//!
+//! Запуск (нужны root или CAP_BPF + CAP_PERFMON):
+//!
+//! ```text
+//! sudo -E cargo bench -p smoothtask-core --features ebpf --bench ebpf_kernel_overhead_bench
+//! ```
+//!
+//! Переменные окружения:
+//! - `SMOOTHTASK_BENCH_DURATION_MS` — длительность одного прогона (по умолчанию 2000);
+//! - `SMOOTHTASK_BENCH_REPEATS` — количество прогонов, берётся медиана (по умолчанию 3);
+//! - `SMOOTHTASK_BENCH_PROGRAMS` — объекты через запятую (по умолчанию все встроенные, кроме `test_*`);
+//! - `SMOOTHTASK_BENCH_WORKLOADS` — нагрузки через запятую (по умолчанию все);
+//! - `SMOOTHTASK_BENCH_IO_DIR` — каталог файла `block_io` (по умолчанию временный каталог);
+//! - `SMOOTHTASK_BENCH_OUTPUT` — путь к файлу отчёта (по умолчанию stdout).
+
+use serde::Serialize;
+use smoothtask_core::metrics::ebpf_objects::{embedded_program_names, EbpfObject};
+use smoothtask_core::metrics::ebpf_overhead::{
+    sysctl_run_time_stats_enabled, EbpfMapUsage, EbpfProgramOverhead,
+};
+use smoothtask_core::metrics::ebpf_sampling::{enable_run_time_stats, ProgramRuntimeStats};
+use std::collections::HashMap;
+use std::fs::{self, File, OpenOptions};
+use std::hint::black_box;
+use std::io::{self, Read, Write};
+use std::net::{Ipv4Addr, TcpListener, TcpStream};
+use std::os::fd::AsRawFd;
+use std::os::unix::fs::FileExt;
+use std::os::unix::net::UnixStream;
+use std::path::{Path, PathBuf};
+use std::process::{Command, Stdio};
+use std::sync::atomic::{AtomicBool, Ordering};
+use std::sync::Arc;
+use std::thread;
+use std::time::{Duration, Instant};
+
+/// Версия формата отчёта
+const SCHEMA_VERSION: u32 = 1;
+
+/// Системных вызовов между проверками времени в `syscall_flood`
+const SYSCALL_BATCH: u64 = 1024;
+
+/// Размер сообщения одного соединения `tcp_churn`
+const TCP_PAYLOAD: usize = 64;
+
+/// Размер блока и файла `block_io`
+const BLOCK_SIZE: usize = 4096;
+const BLOCK_IO_FILE_SIZE: u64 = 64 * 1024 * 1024;
+/// Операций между `fdatasync` и сбросом кэша страниц
+const BLOCK_IO_SYNC_EVERY: u64 = 64;
+/// Начальное значение генератора смещений: прогоны обращаются к одним и тем же блокам
+const BLOCK_IO_SEED: u64 = 0x5eed_0f_b10c;
+
+/// Воспроизводимая нагрузка
+#[derive(Debug, Clone, Copy, PartialEq, Eq)]
+enum Workload {
+    ForkExec,
+    SyscallFlood,
+    ContextSwitch,
+    TcpChurn,
+    BlockIo,
+}
+
+impl Workload {
+    const ALL: [Workload; 5] = [
+        Workload::ForkExec,
+        Workload::SyscallFlood,
+        Workload::ContextSwitch,
+        Workload::TcpChurn,
+        Workload::BlockIo,
+    ];
+
+    fn name(self) -> &'static str {
+        match self {
+            Workload::ForkExec => "fork_exec",
+            Workload::SyscallFlood => "syscall_flood",
+            Workload::ContextSwitch => "context_switch",
+            Workload::TcpChurn => "tcp_churn",
+            Workload::BlockIo => "block_io",
+        }
+    }
+
+    /// Выполнять нагрузку в течение `duration`; возвращает количество операций
+    fn run(self, duration: Duration, io_dir: &Path) -> io::Result<u64> {
+        let deadline = Instant::now() + duration;
+        match self {
+            Workload::ForkExec => fork_exec_storm(deadline),
+            Workload::SyscallFlood => Ok(syscall_flood(deadline)),
+            Workload::ContextSwitch => context_switch_ping_pong(deadline),
+            Workload::TcpChurn => tcp_connection_churn(deadline),
+            Workload::BlockIo => block_io(deadline, io_dir),
+        }
+    }
+}
+
+fn fork_exec_storm(deadline: Instant) -> io::Result<u64> {
+    let mut ops = 0;
+    while Instant::now() < deadline {
+        let status = Command::new("/bin/true")
+            .stdin(Stdio::null())
+            .stdout(Stdio::null())
+            .stderr(Stdio::null())
+            .status()?;
+        if !status.success() {
+            return Err(io::Error::other("/bin/true завершился с ошибкой"));
+        }
+        ops += 1;
+    }
+    Ok(ops)
+}
+
+fn syscall_flood(deadline: Instant) -> u64 {
+    let mut ops = 0;
+    while Instant::now() < deadline {
+        for _ in 0..SYSCALL_BATCH {
+            // SAFETY: getppid не принимает аргументов и всегда успешен; прямой
+            // вызов обходит кэширование в libc
+            black_box(unsafe { libc::syscall(libc::SYS_getppid) });
+        }
+        ops += SYSCALL_BATCH;
+    }
+    ops
+}
+
+fn context_switch_ping_pong(deadline: Instant) -> io::Result<u64> {
+    let (mut local, mut remote) = UnixStream::pair()?;
+    let echo = thread::spawn(move || -> io::Result<()> {
+        let mut byte = [0u8; 1];
+        // Закрытие сокета основным потоком завершает эхо
+        while remote.read(&mut byte)? > 0 {
+            remote.write_all(&byte)?;
+        }
+        Ok(())
+    });
+
+    let mut ops = 0;
+    let mut byte = [0u8; 1];
+    while Instant::now() < deadline {
+        local.write_all(&byte)?;
+        local.read_exact(&mut byte)?;
+        ops += 1;
+    }
+    drop(local);
+    echo.join()
+        .map_err(|_| io::Error::other("поток эха завершился паникой"))??;
+    Ok(ops)
+}
+
+fn tcp_connection_churn(deadline: Instant) -> io::Result<u64> {
+    let listener = TcpListener::bind((Ipv4Addr::LOCALHOST, 0))?;
+    let address = listener.local_addr()?;
+    let stop = Arc::new(AtomicBool::new(false));
+
+    let server_stop = Arc::clone(&stop);
+    let server = thread::spawn(move || -> io::Result<()> {
+        let mut payload = [0u8; TCP_PAYLOAD];
+        for stream in listener.incoming() {
+            if server_stop.load(Ordering::Acquire) {
+                return Ok(());
+            }
+            let mut stream = stream?;
+            stream.read_exact(&mut payload)?;
+            stream.write_all(&payload)?;
+        }
+        Ok(())
+    });
+
+    let mut ops = 0;
+    let mut payload = [0x5au8; TCP_PAYLOAD];
+    let result = (|| -> io::Result<()> {
+        while Instant::now() < deadline {
+            let mut stream = TcpStream::connect(address)?;
+            stream.set_nodelay(true)?;
+            stream.write_all(&payload)?;
+            stream.read_exact(&mut payload)?;
+            ops += 1;
+        }
+        Ok(())
+    })();
+
+    // Последнее соединение только будит сервер, чтобы он увидел флаг остановки
+    stop.store(true, Ordering::Release);
+    let _ = TcpStream::connect(address);
+    server
+        .join()
+        .map_err(|_| io::Error::other("TCP сервер завершился паникой"))??;
+    result.map(|()| ops)
+}
+
+fn block_io(deadline: Instant, dir: &Path) -> io::Result<u64> {
+    let path = dir.join(format!("smoothtask-bench-{}.dat", std::process::id()));
+    let file = OpenOptions::new()
+        .read(true)
+        .write(true)
+        .create(true)
+        .truncate(true)
+        .open(&path)?;
+    let result = random_block_io(&file, deadline);
+    let _ = fs::remove_file(&path);
+    result
+}
+
+fn random_block_io(file: &File, deadline: Instant) -> io::Result<u64> {
+    file.set_len(BLOCK_IO_FILE_SIZE)?;
+    let blocks = BLOCK_IO_FILE_SIZE / BLOCK_SIZE as u64;
+    let mut block = vec![0xa5u8; BLOCK_SIZE];
+    let mut state = BLOCK_IO_SEED;
+    let mut ops = 0u64;
+
+    while Instant::now() < deadline {
+        // xorshift64: одинаковая последовательность смещений в каждом прогоне
+        state ^= state << 13;
+        state ^= state >> 7;
+        state ^= state << 17;
+        let offset = (state % blocks) * BLOCK_SIZE as u64;
+
+        if ops % 2 == 0 {
+            file.write_all_at(&block, offset)?;
+        } else {
+            file.read_exact_at(&mut block, offset)?;
+        }
+        ops += 1;
+
+        if ops % BLOCK_IO_SYNC_EVERY == 0 {
+            file.sync_data()?;
+            // После сброса кэша чтения снова доходят до блочного устройства
+            // SAFETY: дескриптор открыт до конца функции
+            unsafe {
+                libc::posix_fadvise(file.as_raw_fd(), 0, 0, libc::POSIX_FADV_DONTNEED);
+            }
+        }
+    }
+    file.sync_data()?;
+    Ok(ops)
+}
+
+/// Параметры запуска из переменных окружения
+struct BenchSettings {
+    duration: Duration,
+    repeats: usize,
+    programs: Vec<String>,
+    workloads: Vec<Workload>,
+    io_dir: PathBuf,
+    output: Option<PathBuf>,
+}
+
+impl BenchSettings {
+    fn from_env() -> Self {
+        let number = |name: &str, default: u64| {
+            std::env::var(name)
+                .ok()
+                .and_then(|value| value.parse().ok())
+                .unwrap_or(default)
+        };
+        let list = |name: &str| {
+            std::env::var(name).ok().map(|value| {
+                value
+                    .split(',')
+                    .map(|item| item.trim().to_string())
+                    .filter(|item| !item.is_empty())
+                    .collect::<Vec<_>>()
+            })
+        };
+
+        let programs = list("SMOOTHTASK_BENCH_PROGRAMS").unwrap_or_else(|| {
+            embedded_program_names()
+                .into_iter()
+                .filter(|name| !name.starts_with("test_"))
+                .map(str::to_string)
+                .collect()
+        });
+        let workloads = match list("SMOOTHTASK_BENCH_WORKLOADS") {
+            Some(names) => Workload::ALL
+                .into_iter()
+                .filter(|workload| names.iter().any(|name| name == workload.name()))
+                .collect(),
+            None => Workload::ALL.to_vec(),
+        };
+
+        Self {
+            duration: Duration::from_millis(number("SMOOTHTASK_BENCH_DURATION_MS", 2000)),
+            repeats: number("SMOOTHTASK_BENCH_REPEATS", 3).max(1) as usize,
+            programs,
+            workloads,
+            io_dir: std::env::var_os("SMOOTHTASK_BENCH_IO_DIR")
+                .map(PathBuf::from)
+                .unwrap_or_else(std::env::temp_dir),
+            output: std::env::var_os("SMOOTHTASK_BENCH_OUTPUT").map(PathBuf::from),
+        }
+    }
+}
+
+/// Пропускная способность нагрузки без прикреплённых программ
+#[derive(Debug, Serialize)]
+struct BaselineResult {
+    workload: &'static str,
+    ops_per_sec: f64,
+    error: Option<String>,
+}
+
+/// Объект, который не удалось загрузить
+#[derive(Debug, Serialize)]
+struct LoadError {
+    object: String,
+    error: String,
+}
+
+/// Результат одного объекта под одной нагрузкой
+#[derive(Debug, Serialize)]
+struct OverheadResult {
+    object: String,
+    workload: &'static str,
+    attached_programs: usize,
+    ops_per_sec: f64,
+    baseline_ops_per_sec: f64,
+    /// Изменение пропускной способности относительно базового прогона (%)
+    throughput_delta_pct: f64,
+    /// Запуски программ объекта за все прогоны
+    kernel_runs: u64,
+    /// Время программ объекта в ядре за все прогоны (нс)
+    kernel_run_time_ns: u64,
+    /// Среднее добавленное время ядра на событие (нс)
+    ns_per_event: f64,
+    /// Добавленное время ядра на операцию нагрузки (нс)
+    kernel_ns_per_op: f64,
+    programs: Vec<EbpfProgramOverhead>,
+    /// Память карт объекта по учёту ядра (байт)
+    map_memory_bytes: u64,
+    /// Записи хеш-карт после нагрузки
+    map_entries: u64,
+    /// Время обхода хеш-карт объекта (нс)
+    map_walk_ns: u64,
+    maps: Vec<EbpfMapUsage>,
+    error: Option<String>,
+}
+
+/// Отчёт бенчмарка
+#[derive(Debug, Serialize)]
+struct BenchReport {
+    schema_version: u32,
+    kernel_release: String,
+    run_time_stats_enabled: bool,
+    duration_ms: u64,
+    repeats: usize,
+    baselines: Vec<BaselineResult>,
+    load_errors: Vec<LoadError>,
+    results: Vec<OverheadResult>,
+}
+
+/// Пропускная способность серии прогонов
+#[derive(Debug, Clone, Copy, Default)]
+struct Throughput {
+    /// Медиана операций в секунду
+    ops_per_sec: f64,
+    /// Операции всех прогонов
+    total_ops: u64,
+}
+
+/// Прогнать нагрузку `repeats` раз
+fn measure_throughput(workload: Workload, settings: &BenchSettings) -> io::Result<Throughput> {
+    let mut samples = Vec::with_capacity(settings.repeats);
+    let mut total_ops = 0;
+    for _ in 0..settings.repeats {
+        let started = Instant::now();
+        let ops = workload.run(settings.duration, &settings.io_dir)?;
+        samples.push(ops as f64 / started.elapsed().as_secs_f64());
+        total_ops += ops;
+    }
+    samples.sort_by(f64::total_cmp);
+    Ok(Throughput {
+        ops_per_sec: samples[samples.len() / 2],
+        total_ops,
+    })
+}
+
+fn runtime_stats(object: &EbpfObject) -> HashMap<String, ProgramRuntimeStats> {
+    object.program_runtime_stats().into_iter().collect()
+}
+
+fn measure_object(
+    object: &EbpfObject,
+    workload: Workload,
+    baseline_ops_per_sec: f64,
+    settings: &BenchSettings,
+) -> OverheadResult {
+    let attached_programs = object.attach();
+    let before = runtime_stats(object);
+    let throughput = measure_throughput(workload, settings);
+    let after = runtime_stats(object);
+    object.detach();
+
+    let mut programs: Vec<_> = after
+        .iter()
+        .map(|(program, stats)| {
+            let start = before.get(program).copied().unwrap_or_default();
+            let delta = ProgramRuntimeStats {
+                run_time_ns: stats.run_time_ns.saturating_sub(start.run_time_ns),
+                run_cnt: stats.run_cnt.saturating_sub(start.run_cnt),
+            };
+            EbpfProgramOverhead::new(object.name(), program, delta)
+        })
+        .filter(|program| program.run_cnt > 0)
+        .collect();
+    programs.sort_by(|a, b| b.run_time_ns.cmp(&a.run_time_ns));
+
+    let kernel_runs: u64 = programs.iter().map(|program| program.run_cnt).sum();
+    let kernel_run_time_ns: u64 = programs.iter().map(|program| program.run_time_ns).sum();
+
+    let walk_started = Instant::now();
+    let maps = object.map_usage();
+    let map_walk_ns = walk_started.elapsed().as_nanos() as u64;
+
+    let (throughput, error) = match throughput {
+        Ok(throughput) => (throughput, None),
+        Err(e) => (Throughput::default(), Some(e.to_string())),
+    };
+    let ops_per_sec = throughput.ops_per_sec;
+    let ratio = |numerator: f64, denominator: f64| {
+        if denominator > 0.0 {
+            numerator / denominator
+        } else {
+            0.0
+        }
+    };
+
+    OverheadResult {
+        object: object.name().to_string(),
+        workload: workload.name(),
+        attached_programs,
+        ops_per_sec,
+        baseline_ops_per_sec,
+        throughput_delta_pct: ratio(ops_per_sec - baseline_ops_per_sec, baseline_ops_per_sec)
+            * 100.0,
+        kernel_runs,
+        kernel_run_time_ns,
+        ns_per_event: ratio(kernel_run_time_ns as f64, kernel_runs as f64),
+        kernel_ns_per_op: ratio(kernel_run_time_ns as f64, throughput.total_ops as f64),
+        programs,
+        map_memory_bytes: object.map_memory().iter().map(|(_, bytes)| bytes).sum(),
+        map_entries: maps.iter().map(|map| map.entries).sum(),
+        map_walk_ns,
+        maps,
+        error,
+    }
+}
+
+fn run(settings: &BenchSettings) -> BenchReport {
+    // Учёт времени выполнения действует, пока открыт дескриптор
+    let stats_fd = enable_run_time_stats();
+    if let Err(e) = &stats_fd {
+        eprintln!("BPF_ENABLE_STATS недоступен ({}), используется sysctl", e);
+    }
+    let run_time_stats_enabled = stats_fd.is_ok() || sysctl_run_time_stats_enabled();
+
+    // Все объекты загружаются заранее и открепляются: базовый прогон идёт с
+    // теми же картами в памяти, но без программ на точках трассировки
+    let mut objects = Vec::new();
+    let mut load_errors = Vec::new();
+    for program in &settings.programs {
+        match EbpfObject::load(program) {
+            Ok(object) => {
+                object.detach();
+                objects.push(object);
+            }
+            Err(e) => load_errors.push(LoadError {
+                object: program.clone(),
+                error: format!("{:#}", e),
+            }),
+        }
+    }
+
+    let mut baselines = Vec::new();
+    let mut results = Vec::new();
+    for &workload in &settings.workloads {
+        eprintln!("{}: базовый прогон", workload.name());
+        let baseline = measure_throughput(workload, settings);
+        let baseline_ops_per_sec = baseline.as_ref().map_or(0.0, |b| b.ops_per_sec);
+        baselines.push(BaselineResult {
+            workload: workload.name(),
+            ops_per_sec: baseline_ops_per_sec,
+            error: baseline.err().map(|e| e.to_string()),
+        });
+
+        for object in &objects {
+            eprintln!("{}: {}", workload.name(), object.name());
+            results.push(measure_object(
+                object,
+                workload,
+                baseline_ops_per_sec,
+                settings,
+            ));
+        }
+    }
+
+    BenchReport {
+        schema_version: SCHEMA_VERSION,
+        kernel_release: fs::read_to_string("/proc/sys/kernel/osrelease")
+            .map(|release| release.trim().to_string())
+            .unwrap_or_default(),
+        run_time_stats_enabled,
+        duration_ms: settings.duration.as_millis() as u64,
+        repeats: settings.repeats,
+        baselines,
+        load_errors,
+        results,
+    }
+}
+
+fn main() {
+    let settings = BenchSettings::from_env();
+    let report = run(&settings);
+    let json = serde_json::to_string_pretty(&report).expect("отчёт сериализуется в JSON");
+
+    match &settings.output {
+        Some(path) => {
+            fs::write(path, json + "\n").expect("не удалось записать отчёт");
+            eprintln!("Отчёт записан в {}", path.display());
+        }
+        None => println!("{}", json),
+    }
+}
@@ -0,0 +1,220 @@
+//! Скрипт сборки smoothtask-core.
+//!
+//! При включённом feature `ebpf` компилирует все eBPF программы из
+//! `src/ebpf_programs/*.c` в CO-RE объекты `*.bpf.o` (clang `-target bpf`)
+//! и генерирует таблицу встроенных объектов `OUT_DIR/ebpf_objects.rs`,
+//! которая подключается модулем `metrics::ebpf_objects` через `include!`.
+//!
+//! Демон больше не зависит от наличия исходников `.c` и компилятора на
+//! целевой машине: байткод встроен в бинарник и загружается из памяти.
+//!
+//! Переменные окружения:
+//! - `SMOOTHTASK_BPF_CLANG` — путь к clang (по умолчанию `clang`)
+//! - `SMOOTHTASK_VMLINUX_H` — путь к готовому `vmlinux.h`; если не задан,
+//!   заголовок генерируется через `bpftool btf dump` из `/sys/kernel/btf/vmlinux`
+//! - `SMOOTHTASK_BPF_CGROUP_AGGREGATION` — `0` отключает per-cgroup агрегаты
+//!   в программах (см. `src/ebpf_programs/smoothtask_cgroup.h`)
+//! - `SMOOTHTASK_ALLOW_MISSING_EBPF_TOOLCHAIN` — `1` разрешает собрать бинарник
+//!   с feature `ebpf` без clang/`vmlinux.h` (например, для CI без toolchain)
+//!
+//! Отсутствие clang или `vmlinux.h` и ошибка компиляции любой программы
+//! прерывают сборку: иначе бинарник с feature `ebpf` молча получил бы пустую
+//! таблицу объектов. С `SMOOTHTASK_ALLOW_MISSING_EBPF_TOOLCHAIN=1` такие
+//! ошибки становятся предупреждениями, невстроенные программы не попадают в
+//! таблицу, и в рантайме коллектор деградирует так же, как при отсутствии
+//! поддержки eBPF.
+//!
+//! Тестовые фикстуры `test_*.c` не компилируются и не встраиваются.
+
+use std::env;
+use std::fs;
+use std::path::{Path, PathBuf};
+use std::process::Command;
+
+const EBPF_PROGRAMS_DIR: &str = "src/ebpf_programs";
+
+/// Префикс тестовых фикстур, которые не попадают в бинарник
+const TEST_FIXTURE_PREFIX: &str = "test_";
+
+fn main() {
+    println!("cargo:rerun-if-changed={}", EBPF_PROGRAMS_DIR);
+    println!("cargo:rerun-if-env-changed=SMOOTHTASK_BPF_CLANG");
+    println!("cargo:rerun-if-env-changed=SMOOTHTASK_VMLINUX_H");
+    println!("cargo:rerun-if-env-changed=SMOOTHTASK_BPF_CGROUP_AGGREGATION");
+    println!("cargo:rerun-if-env-changed=SMOOTHTASK_ALLOW_MISSING_EBPF_TOOLCHAIN");
+
+    let out_dir = PathBuf::from(env::var("OUT_DIR").expect("OUT_DIR не задан cargo"));
+    let mut objects: Vec<(String, PathBuf)> = Vec::new();
+
+    if env::var_os("CARGO_FEATURE_EBPF").is_some() {
+        objects = compile_ebpf_programs(&out_dir);
+    }
+
+    write_objects_table(&out_dir, &objects);
+}
+
+/// Разрешена ли сборка с feature `ebpf` без toolchain.
+fn missing_toolchain_allowed() -> bool {
+    env::var("SMOOTHTASK_ALLOW_MISSING_EBPF_TOOLCHAIN")
+        .map(|value| value.trim() == "1")
+        .unwrap_or(false)
+}
+
+/// Сообщить о проблеме toolchain: прервать сборку или, при явном
+/// разрешении, ограничиться предупреждением.
+fn toolchain_error(message: &str) {
+    if missing_toolchain_allowed() {
+        println!("cargo:warning={}", message);
+    } else {
+        panic!(
+            "{}. Установите clang и bpftool (или задайте SMOOTHTASK_VMLINUX_H) либо \
+             соберите с SMOOTHTASK_ALLOW_MISSING_EBPF_TOOLCHAIN=1",
+            message
+        );
+    }
+}
+
+/// Является ли исходник тестовой фикстурой.
+fn is_test_fixture(path: &Path) -> bool {
+    path.file_stem()
+        .and_then(|stem| stem.to_str())
+        .map_or(false, |stem| stem.starts_with(TEST_FIXTURE_PREFIX))
+}
+
+/// Скомпилировать все eBPF программы и вернуть список (имя, путь к объекту).
+fn compile_ebpf_programs(out_dir: &Path) -> Vec<(String, PathBuf)> {
+    let clang = env::var("SMOOTHTASK_BPF_CLANG").unwrap_or_else(|_| "clang".to_string());
+    let include_dir = out_dir.join("bpf_include");
+    if let Err(e) = fs::create_dir_all(&include_dir) {
+        toolchain_error(&format!("Не удалось создать {:?}: {}", include_dir, e));
+        return Vec::new();
+    }
+
+    if !prepare_vmlinux_header(&include_dir) {
+        toolchain_error("vmlinux.h недоступен, CO-RE программы на его основе не будут встроены");
+    }
+
+    let target_arch = env::var("CARGO_CFG_TARGET_ARCH").unwrap_or_else(|_| "x86_64".to_string());
+    // Программы на <linux/bpf.h> требуют asm/types.h из multiarch каталога
+    let multiarch_include = PathBuf::from(format!("/usr/include/{}-linux-gnu", target_arch));
+
+    let arch = match target_arch.as_str() {
+        "x86_64" => "x86",
+        "aarch64" => "arm64",
+        "riscv64" => "riscv",
+        "powerpc64" => "powerpc",
+        other => other,
+    };
+
+    // Per-cgroup агрегаты включены по умолчанию
+    let cgroup_aggregation = env::var("SMOOTHTASK_BPF_CGROUP_AGGREGATION")
+        .map(|value| value.trim() != "0")
+        .unwrap_or(true);
+
+    let mut sources: Vec<PathBuf> = match fs::read_dir(EBPF_PROGRAMS_DIR) {
+        Ok(entries) => entries
+            .filter_map(|entry| entry.ok().map(|e| e.path()))
+            .filter(|path| path.extension().map_or(false, |ext| ext == "c"))
+            .filter(|path| !is_test_fixture(path))
+            .collect(),
+        Err(e) => {
+            toolchain_error(&format!(
+                "Не удалось прочитать {}: {}",
+                EBPF_PROGRAMS_DIR, e
+            ));
+            return Vec::new();
+        }
+    };
+    sources.sort();
+
+    let mut objects = Vec::new();
+    for source in sources {
+        let name = match source.file_stem().and_then(|s| s.to_str()) {
+            Some(name) => name.to_string(),
+            None => continue,
+        };
+        let object = out_dir.join(format!("{}.bpf.o", name));
+
+        let mut command = Command::new(&clang);
+        if multiarch_include.exists() {
+            command.arg("-I").arg(&multiarch_include);
+        }
+        let status = command
+            .arg("-target")
+            .arg("bpf")
+            .arg("-g")
+            .arg("-O2")
+            .arg(format!("-D__TARGET_ARCH_{}", arch))
+            .arg(format!(
+                "-DSMOOTHTASK_CGROUP_AGGREGATION={}",
+                u8::from(cgroup_aggregation)
+            ))
+            .arg("-I")
+            .arg(&include_dir)
+            .arg("-I")
+            .arg(EBPF_PROGRAMS_DIR)
+            .arg("-c")
+            .arg(&source)
+            .arg("-o")
+            .arg(&object)
+            .status();
+
+        match status {
+            Ok(status) if status.success() => objects.push((name, object)),
+            Ok(status) => toolchain_error(&format!(
+                "Не удалось скомпилировать eBPF программу {:?} ({}), она не будет встроена",
+                source, status
+            )),
+            Err(e) => {
+                toolchain_error(&format!(
+                    "clang ({}) недоступен: {}. eBPF объекты не будут встроены",
+                    clang, e
+                ));
+                break;
+            }
+        }
+    }
+
+    objects
+}
+
+/// Подготовить `vmlinux.h` в каталоге включаемых файлов.
+fn prepare_vmlinux_header(include_dir: &Path) -> bool {
+    let target = include_dir.join("vmlinux.h");
+
+    if let Ok(path) = env::var("SMOOTHTASK_VMLINUX_H") {
+        return fs::copy(&path, &target).is_ok();
+    }
+
+    if target.exists() {
+        return true;
+    }
+
+    let output = Command::new("bpftool")
+        .args(["btf", "dump", "file", "/sys/kernel/btf/vmlinux", "format", "c"])
+        .output();
+
+    match output {
+        Ok(output) if output.status.success() => fs::write(&target, output.stdout).is_ok(),
+        _ => false,
+    }
+}
+
+/// Сгенерировать таблицу встроенных объектов для `include!`.
+fn write_objects_table(out_dir: &Path, objects: &[(String, PathBuf)]) {
+    let mut table = String::new();
+    table.push_str("/// Встроенные eBPF объекты: (имя программы, байткод `.bpf.o`).\n");
+    table.push_str("///\n/// Сгенерировано build.rs, не редактировать вручную.\n");
+    table.push_str("pub static EMBEDDED_EBPF_OBJECTS: &[(&str, &[u8])] = &[\n");
+    for (name, path) in objects {
+        table.push_str(&format!(
+            "    ({:?}, include_bytes!({:?})),\n",
+            name,
+            path.display().to_string()
+        ));
+    }
+    table.push_str("];\n");
+
+    let table_path = out_dir.join("ebpf_objects.rs");
+    fs::write(&table_path, table).expect("Не удалось записать таблицу eBPF объектов");
+}
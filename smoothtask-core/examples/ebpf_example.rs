@@ -5,7 +5,7 @@
 
 use smoothtask_core::metrics::ebpf::{
     ConnectionStat, EbpfConfig, EbpfFilterConfig, EbpfMetrics, EbpfMetricsCollector,
-    EbpfNotificationThresholds, NetworkStat, SyscallStat,
+    EbpfNotificationThresholds, FilesystemMonitorMode, NetworkStat, SyscallStat,
 };
 use std::time::Duration;
 
@@ -58,6 +58,25 @@ fn main() -> anyhow::Result<()> {
         enable_high_performance_mode: true,
         enable_aggressive_caching: false,
         aggressive_cache_interval_ms: 5000,
+        enable_ringbuf_events: false,
+        ringbuf_wakeup_threshold_bytes: 4096,
+        ringbuf_poll_timeout_ms: 100,
+        syscall_latency_app_syscalls: Vec::new(),
+        enable_adaptive_sampling: true,
+        sampling_cpu_budget_percent: 1.0,
+        max_sampling_rate: 64,
+        enable_overhead_stats: true,
+        process_memory_rss_delta_kb: 1024,
+        filesystem_mode: FilesystemMonitorMode::Detailed,
+        enable_memory_pressure_monitoring: false,
+        enable_kmem_allocation_tracking: false,
+        enable_runqueue_latency_fast_path: false,
+        runqueue_latency_threshold_us: 5_000,
+        runqueue_latency_min_interval_ms: 50,
+        demand_driven_attachment: false,
+        attachment_idle_timeout_secs: 300,
+        enable_epoch_aggregation: false,
+        epoch_interval_ms: 1000,
     };
 
     println!("   Configuration created with:");
@@ -1277,6 +1277,286 @@ pub fn apply_priority_adjustments(
     result
 }
 
+/// Цель быстрого пути: заранее вычисленный класс интерактивного процесса.
+#[derive(Debug, Clone, PartialEq)]
+pub struct FastPathTarget {
+    /// AppGroup, к которому относится процесс.
+    pub app_group_id: String,
+    /// Класс приоритета из последнего тика политики.
+    pub target_class: PriorityClass,
+}
+
+/// Итог обработки события задержки в очереди выполнения.
+#[derive(Debug, Clone, Copy, PartialEq, Eq)]
+pub enum FastPathOutcome {
+    /// Класс применён к потоку.
+    Applied(PriorityClass),
+    /// Процесс не отмечен как интерактивный.
+    NotTargeted,
+    /// Класс уже применён к потоку быстрым путём.
+    AlreadyApplied,
+    /// Не удалось применить nice.
+    Failed,
+}
+
+/// Статистика быстрого пути.
+#[derive(Debug, Clone, Copy, Default, PartialEq, Eq)]
+pub struct FastPathStats {
+    /// Количество обработанных событий.
+    pub events: u64,
+    /// Количество применений класса к потокам.
+    pub applied: u64,
+    /// Количество событий, для которых класс уже был применён.
+    pub skipped_applied: u64,
+    /// Количество событий для неотмеченных процессов.
+    pub skipped_untargeted: u64,
+    /// Количество ошибок применения nice.
+    pub errors: u64,
+    /// Количество некритичных ошибок (latency_nice, cgroup).
+    pub warnings: u64,
+    /// Количество потоков, возвращённых к классу процесса после смены класса.
+    pub restored: u64,
+}
+
+/// Выбрать процессы для быстрого пути по результатам политики.
+///
+/// Отмечаются процессы групп с классами `Interactive` и `CritInteractive`:
+/// именно для них задержка в очереди выполнения заметна пользователю.
+pub fn plan_fast_path_targets(
+    snapshot: &Snapshot,
+    policy_results: &HashMap<String, PolicyResult>,
+) -> HashMap<i32, FastPathTarget> {
+    let mut targets = HashMap::new();
+
+    for process in &snapshot.processes {
+        let Some(app_group_id) = &process.app_group_id else {
+            continue;
+        };
+        let Some(policy) = policy_results.get(app_group_id) else {
+            continue;
+        };
+
+        if matches!(
+            policy.priority_class,
+            PriorityClass::Interactive | PriorityClass::CritInteractive
+        ) {
+            targets.insert(
+                process.pid,
+                FastPathTarget {
+                    app_group_id: app_group_id.clone(),
+                    target_class: policy.priority_class,
+                },
+            );
+        }
+    }
+
+    targets
+}
+
+/// Классы приоритета процессов по результатам политики.
+///
+/// Нужны быстрому пути, чтобы вернуть ускоренные потоки процесса, выбывшего
+/// из набора целей, к классу, который применяет основной цикл.
+pub fn plan_process_classes(
+    snapshot: &Snapshot,
+    policy_results: &HashMap<String, PolicyResult>,
+) -> HashMap<i32, PriorityClass> {
+    snapshot
+        .processes
+        .iter()
+        .filter_map(|process| {
+            let policy = policy_results.get(process.app_group_id.as_ref()?)?;
+            Some((process.pid, policy.priority_class))
+        })
+        .collect()
+}
+
+/// Быстрый путь актуатора для событий задержки в очереди выполнения.
+///
+/// События приходят из eBPF (см. `metrics::ebpf_runqueue`) для потоков
+/// отмеченных процессов, ожидавших CPU дольше порога. Класс приоритета не
+/// вычисляется заново: применяется класс из последнего тика политики.
+///
+/// nice и latency_nice в Linux действуют на поток, а основной цикл применяет
+/// их только к потоку с TID = PID процесса. Быстрый путь применяет класс к
+/// голодающему потоку и один раз на процесс — cgroup (cpu.weight). Повторные
+/// события для потока, которому класс уже применён, пропускаются, поэтому
+/// гистерезис основного цикла здесь не нужен.
+///
+/// Когда процесс выбывает из набора или меняет класс, ускоренные потоки
+/// (кроме основного, который ведёт основной цикл) возвращаются к новому
+/// классу процесса, иначе они навсегда остались бы с интерактивным nice.
+#[derive(Debug, Default)]
+pub struct FastPathActuator {
+    targets: HashMap<i32, FastPathTarget>,
+    /// Класс, применённый к потоку: TID -> (PID процесса, класс).
+    applied_threads: HashMap<i32, (i32, PriorityClass)>,
+    /// Класс, с которым процесс помещён в cgroup.
+    applied_cgroups: HashMap<i32, PriorityClass>,
+    stats: FastPathStats,
+}
+
+impl FastPathActuator {
+    /// Создать быстрый путь без отмеченных процессов.
+    pub fn new() -> Self {
+        Self::default()
+    }
+
+    /// Заменить набор отмеченных процессов.
+    ///
+    /// `process_classes` — классы всех процессов по результатам политики (см.
+    /// [`plan_process_classes`]). Потоки процессов, выбывших из набора или
+    /// сменивших класс, возвращаются к новому классу процесса (`Normal`, если
+    /// процесс больше не классифицирован), а записи о применении удаляются.
+    pub fn update_targets(
+        &mut self,
+        targets: HashMap<i32, FastPathTarget>,
+        process_classes: &HashMap<i32, PriorityClass>,
+    ) {
+        for (tid, pid, class) in self.plan_thread_restores(&targets, process_classes) {
+            self.restore_thread(pid, tid, class);
+        }
+
+        let class_of = |pid: &i32| targets.get(pid).map(|target| target.target_class);
+        self.applied_threads
+            .retain(|_, (pid, class)| class_of(pid) == Some(*class));
+        self.applied_cgroups
+            .retain(|pid, class| class_of(pid) == Some(*class));
+        self.targets = targets;
+    }
+
+    /// Потоки, которые нужно вернуть к классу процесса: (TID, PID, класс).
+    fn plan_thread_restores(
+        &self,
+        targets: &HashMap<i32, FastPathTarget>,
+        process_classes: &HashMap<i32, PriorityClass>,
+    ) -> Vec<(i32, i32, PriorityClass)> {
+        let mut restores: Vec<_> = self
+            .applied_threads
+            .iter()
+            .filter(|(&tid, &(pid, _))| tid != pid)
+            .filter_map(|(&tid, &(pid, applied))| {
+                let class = targets
+                    .get(&pid)
+                    .map(|target| target.target_class)
+                    .or_else(|| process_classes.get(&pid).copied())
+                    .unwrap_or(PriorityClass::Normal);
+                (class != applied).then_some((tid, pid, class))
+            })
+            .collect();
+        restores.sort_unstable();
+        restores
+    }
+
+    /// Вернуть поток к классу процесса.
+    ///
+    /// Поток, завершившийся после ускорения, пропускается: его TID мог быть
+    /// переиспользован другим процессом.
+    fn restore_thread(&mut self, pid: i32, tid: i32, class: PriorityClass) {
+        if !Path::new(&format!("/proc/{}/task/{}", pid, tid)).exists() {
+            return;
+        }
+        let params = class.params();
+
+        if let Err(e) = apply_nice(tid, params.nice.nice) {
+            warn!(
+                pid,
+                tid,
+                target_class = ?class,
+                error = %e,
+                "Fast path failed to restore nice priority"
+            );
+            self.stats.errors += 1;
+            return;
+        }
+        if let Err(e) = apply_latency_nice(tid, params.latency_nice.latency_nice) {
+            debug!(pid, tid, error = %e, "Fast path failed to restore latency_nice");
+            self.stats.warnings += 1;
+        }
+
+        debug!(
+            pid,
+            tid,
+            target_class = ?class,
+            "Fast path restored thread to process priority class"
+        );
+        self.stats.restored += 1;
+    }
+
+    /// PID отмеченных процессов.
+    pub fn target_pids(&self) -> impl Iterator<Item = i32> + '_ {
+        self.targets.keys().copied()
+    }
+
+    /// Класс, который нужно применить к потоку, если он ещё не применён.
+    pub fn pending_class(&self, pid: i32, tid: i32) -> Option<PriorityClass> {
+        let target = self.targets.get(&pid)?;
+        match self.applied_threads.get(&tid) {
+            Some(&(applied_pid, class)) if applied_pid == pid && class == target.target_class => {
+                None
+            }
+            _ => Some(target.target_class),
+        }
+    }
+
+    /// Обработать событие задержки потока `tid` процесса `pid`.
+    pub fn handle_stall(&mut self, pid: i32, tid: i32, latency_ns: u64) -> FastPathOutcome {
+        self.stats.events += 1;
+
+        let Some(target) = self.targets.get(&pid) else {
+            self.stats.skipped_untargeted += 1;
+            return FastPathOutcome::NotTargeted;
+        };
+        let Some(class) = self.pending_class(pid, tid) else {
+            self.stats.skipped_applied += 1;
+            return FastPathOutcome::AlreadyApplied;
+        };
+        let params = class.params();
+
+        if let Err(e) = apply_nice(tid, params.nice.nice) {
+            warn!(
+                pid,
+                tid,
+                target_class = ?class,
+                latency_ns,
+                error = %e,
+                "Fast path failed to apply nice priority"
+            );
+            self.stats.errors += 1;
+            return FastPathOutcome::Failed;
+        }
+
+        if let Err(e) = apply_latency_nice(tid, params.latency_nice.latency_nice) {
+            debug!(pid, tid, error = %e, "Fast path failed to apply latency_nice");
+            self.stats.warnings += 1;
+        }
+
+        if self.applied_cgroups.get(&pid) != Some(&class) {
+            if let Err(e) = apply_cgroup(pid, params.cgroup, &target.app_group_id, None) {
+                debug!(pid, error = %e, "Fast path failed to apply cgroup");
+                self.stats.warnings += 1;
+            }
+            self.applied_cgroups.insert(pid, class);
+        }
+
+        debug!(
+            pid,
+            tid,
+            target_class = ?class,
+            latency_ns,
+            "Fast path applied priority class after runqueue stall"
+        );
+        self.applied_threads.insert(tid, (pid, class));
+        self.stats.applied += 1;
+        FastPathOutcome::Applied(class)
+    }
+
+    /// Текущая статистика быстрого пути.
+    pub fn stats(&self) -> FastPathStats {
+        self.stats
+    }
+}
+
 #[cfg(test)]
 mod tests {
     use super::*;
@@ -2456,4 +2736,134 @@ mod tests {
         // Главное - функция не должна паниковать
         let _ = result;
     }
+
+    #[test]
+    fn test_plan_fast_path_targets_selects_interactive_groups() {
+        let snapshot = make_snapshot(
+            vec![
+                base_process("app1", 10),
+                base_process("app2", 20),
+                base_process("app3", 30),
+            ],
+            vec![app_group("app1"), app_group("app2"), app_group("app3")],
+        );
+
+        let mut policy_results = HashMap::new();
+        policy_results.insert(
+            "app1".to_string(),
+            make_policy_result(PriorityClass::Interactive, "focused GUI"),
+        );
+        policy_results.insert(
+            "app2".to_string(),
+            make_policy_result(PriorityClass::Background, "batch"),
+        );
+        policy_results.insert(
+            "app3".to_string(),
+            make_policy_result(PriorityClass::CritInteractive, "audio"),
+        );
+
+        let targets = plan_fast_path_targets(&snapshot, &policy_results);
+        assert_eq!(targets.len(), 2);
+        assert_eq!(targets[&10].target_class, PriorityClass::Interactive);
+        assert_eq!(targets[&10].app_group_id, "app1");
+        assert_eq!(targets[&30].target_class, PriorityClass::CritInteractive);
+        assert!(!targets.contains_key(&20));
+    }
+
+    #[test]
+    fn test_fast_path_pending_class_tracks_applied_threads() {
+        let mut fast_path = FastPathActuator::new();
+        let target = |class| FastPathTarget {
+            app_group_id: "app1".to_string(),
+            target_class: class,
+        };
+        fast_path.update_targets(
+            HashMap::from([(100, target(PriorityClass::Interactive))]),
+            &HashMap::new(),
+        );
+
+        assert_eq!(fast_path.pending_class(200, 200), None);
+        assert_eq!(
+            fast_path.pending_class(100, 101),
+            Some(PriorityClass::Interactive)
+        );
+        assert_eq!(
+            fast_path.handle_stall(200, 200, 5_000_000),
+            FastPathOutcome::NotTargeted
+        );
+
+        fast_path
+            .applied_threads
+            .insert(101, (100, PriorityClass::Interactive));
+        assert_eq!(fast_path.pending_class(100, 101), None);
+        assert_eq!(
+            fast_path.handle_stall(100, 101, 5_000_000),
+            FastPathOutcome::AlreadyApplied
+        );
+
+        // Смена класса сбрасывает записи о применении
+        fast_path.update_targets(
+            HashMap::from([(100, target(PriorityClass::CritInteractive))]),
+            &HashMap::new(),
+        );
+        assert_eq!(
+            fast_path.pending_class(100, 101),
+            Some(PriorityClass::CritInteractive)
+        );
+
+        let stats = fast_path.stats();
+        assert_eq!(stats.events, 2);
+        assert_eq!(stats.skipped_untargeted, 1);
+        assert_eq!(stats.skipped_applied, 1);
+    }
+
+    #[test]
+    fn test_fast_path_restores_threads_when_target_loses_class() {
+        let mut fast_path = FastPathActuator::new();
+        let target = |class| FastPathTarget {
+            app_group_id: "app1".to_string(),
+            target_class: class,
+        };
+        // PID выше pid_max: потоков с такими TID в системе нет
+        let (pid, other_pid) = (5_000_000, 5_000_100);
+        fast_path.update_targets(
+            HashMap::from([
+                (pid, target(PriorityClass::Interactive)),
+                (other_pid, target(PriorityClass::Interactive)),
+            ]),
+            &HashMap::new(),
+        );
+        for tid in [pid, pid + 1, pid + 2, other_pid + 1] {
+            let owner = if tid > other_pid { other_pid } else { pid };
+            fast_path
+                .applied_threads
+                .insert(tid, (owner, PriorityClass::Interactive));
+        }
+
+        // Процесс понижен до Background, второй процесс исчез из снапшота
+        let new_targets = HashMap::new();
+        let process_classes = HashMap::from([(pid, PriorityClass::Background)]);
+        assert_eq!(
+            fast_path.plan_thread_restores(&new_targets, &process_classes),
+            vec![
+                (pid + 1, pid, PriorityClass::Background),
+                (pid + 2, pid, PriorityClass::Background),
+                (other_pid + 1, other_pid, PriorityClass::Normal),
+            ]
+        );
+
+        // Цель без смены класса не трогается
+        let unchanged = HashMap::from([(pid, target(PriorityClass::Interactive))]);
+        assert_eq!(
+            fast_path.plan_thread_restores(&unchanged, &process_classes),
+            vec![(other_pid + 1, other_pid, PriorityClass::Normal)]
+        );
+
+        fast_path.update_targets(new_targets, &process_classes);
+        assert!(fast_path.applied_threads.is_empty());
+        assert!(fast_path.applied_cgroups.is_empty());
+        // Несуществующие потоки пропускаются без ошибок
+        assert_eq!(fast_path.stats().restored, 0);
+        assert_eq!(fast_path.stats().errors, 0);
+    }
 }
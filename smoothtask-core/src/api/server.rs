@@ -9,12 +9,14 @@ use axum::{
     Router,
 };
 use chrono::Utc;
-use serde_json::{json, Value};
+use serde_json::{json, value::RawValue, Value};
 use std::collections::HashMap;
 use std::fs;
 use std::sync::Arc;
 
 use crate::metrics::app_performance::{collect_all_app_performance, AppPerformanceConfig};
+use crate::metrics::ebpf::{EbpfMetricGroup, EbpfSnapshot, EbpfSnapshotSection};
+use crate::metrics::ebpf_profiler::{StackKind, StackProfileRequest};
 use std::time::{Duration, Instant, SystemTime, UNIX_EPOCH};
 use tokio::net::TcpListener;
 use tokio::sync::RwLock;
@@ -81,11 +83,11 @@ pub struct ApiCache {
     /// Кэшированная версия конфигурации (JSON)
     cached_config_json: Option<(Value, Instant)>,
     /// Кэшированная версия данных об энергопотреблении процессов (JSON)
-    cached_process_energy_json: Option<(Value, Instant)>,
+    cached_process_energy_json: Option<(RawJson, Instant)>,
     /// Кэшированная версия данных об использовании памяти процессами (JSON)
     cached_process_memory_json: Option<(Value, Instant)>,
     /// Кэшированная версия данных об использовании GPU процессами (JSON)
-    cached_process_gpu_json: Option<(Value, Instant)>,
+    cached_process_gpu_json: Option<(RawJson, Instant)>,
     /// Кэшированная версия данных об использовании сети процессами (JSON)
     cached_process_network_json: Option<(Value, Instant)>,
     /// Кэшированная версия данных об использовании диска процессами (JSON)
@@ -1187,6 +1189,9 @@ async fn version_handler() -> Json<Value> {
 ///
 /// Возвращает метрики в формате Prometheus.
 async fn prometheus_metrics_handler(State(state): State<ApiState>) -> Result<String, StatusCode> {
+    // Перцентили задержек системных вызовов нужны при каждом опросе
+    crate::metrics::system::request_ebpf_metric_groups(&[EbpfMetricGroup::Syscalls]);
+
     let mut metrics = String::new();
 
     // Добавляем метрики версии
@@ -1800,6 +1805,12 @@ async fn prometheus_metrics_handler(State(state): State<ApiState>) -> Result<Str
         }
     }
 
+    // Перцентили задержек системных вызовов и стоимость eBPF программ;
+    // текст формируется один раз за поколение снимка
+    if let Some(ebpf_snapshot) = current_ebpf_snapshot(&state).await {
+        metrics.push_str(ebpf_snapshot.prometheus_text());
+    }
+
     // Добавляем пользовательские метрики если доступны
     if let Some(custom_metrics_manager) = &state.custom_metrics_manager {
         let custom_metrics_values = custom_metrics_manager.get_all_metrics_values().await.ok();
@@ -2113,6 +2124,46 @@ async fn endpoints_handler() -> Json<Value> {
                 "method": "GET",
                 "description": "Получение информации о текущих сетевых соединениях через eBPF"
             },
+            {
+                "path": "/api/ebpf/syscalls/latency",
+                "method": "GET",
+                "description": "Получение перцентилей задержек системных вызовов (p50/p99) из eBPF гистограмм"
+            },
+            {
+                "path": "/api/ebpf/overhead",
+                "method": "GET",
+                "description": "Получение стоимости каждой eBPF программы, заполнения карт и отладочных счётчиков ядра"
+            },
+            {
+                "path": "/api/ebpf/epoch",
+                "method": "GET",
+                "description": "Получение сводки последней эпохи, собранной в ядре по таймеру: загрузка, трафик и самые нагруженные процессы"
+            },
+            {
+                "path": "/api/ebpf/profile",
+                "method": "POST",
+                "description": "Запуск сессии профилирования стеков процессов на CPU и вне CPU с заданной длительностью"
+            },
+            {
+                "path": "/api/ebpf/profile",
+                "method": "GET",
+                "description": "Получение состояния текущей или последней сессии профилирования стеков"
+            },
+            {
+                "path": "/api/ebpf/profile/stop",
+                "method": "POST",
+                "description": "Досрочное завершение сессии профилирования стеков с сохранением результата"
+            },
+            {
+                "path": "/api/ebpf/profile/folded",
+                "method": "GET",
+                "description": "Получение результата профилирования в формате свёрнутых стеков (flamegraph.pl)"
+            },
+            {
+                "path": "/api/ebpf/profile/flamegraph",
+                "method": "GET",
+                "description": "Получение результата профилирования деревом для d3-flame-graph"
+            },
             {
                 "path": "/api/gpu/temperature-power",
                 "method": "GET",
@@ -2129,7 +2180,7 @@ async fn endpoints_handler() -> Json<Value> {
                 "description": "Обновление метрик температуры и энергопотребления GPU для процессов"
             }
         ],
-        "count": 34
+        "count": 43
     }))
 }
 
@@ -3696,6 +3747,17 @@ fn create_router(state: ApiState) -> Router {
         .route("/api/cache/config", post(cache_config_update_handler))
         .route("/api/network/connections", get(network_connections_handler))
         .route("/api/cpu/temperature", get(cpu_temperature_handler))
+        .route("/api/ebpf/syscalls/latency", get(syscall_latency_handler))
+        .route("/api/ebpf/overhead", get(ebpf_overhead_handler))
+        .route("/api/ebpf/epoch", get(ebpf_epoch_handler))
+        .route("/api/ebpf/profile", get(ebpf_profile_status_handler))
+        .route("/api/ebpf/profile", post(ebpf_profile_start_handler))
+        .route("/api/ebpf/profile/stop", post(ebpf_profile_stop_handler))
+        .route("/api/ebpf/profile/folded", get(ebpf_profile_folded_handler))
+        .route(
+            "/api/ebpf/profile/flamegraph",
+            get(ebpf_profile_flamegraph_handler),
+        )
         .with_state(state)
 }
 
@@ -3815,7 +3877,20 @@ async fn processes_handler(State(state): State<ApiState>) -> Result<Json<Value>,
 /// Обработчик для endpoint `/api/processes/energy`.
 ///
 /// Возвращает статистику энергопотребления процессов (если доступны).
-async fn process_energy_handler(State(state): State<ApiState>) -> Result<Json<Value>, StatusCode> {
+/// Список процессов вставляется в ответ готовой секцией eBPF снимка.
+async fn process_energy_handler(State(state): State<ApiState>) -> Result<RawJson, StatusCode> {
+    /// Ответ с секцией `process_energy`, закодированной снимком
+    #[derive(serde::Serialize)]
+    struct ProcessEnergyResponse<'a> {
+        status: &'static str,
+        process_energy: &'a RawValue,
+        count: usize,
+        total_energy_uj: u64,
+        total_energy_w: f32,
+        cache_info: Value,
+        timestamp: String,
+    }
+
     // Начинаем отслеживание производительности
     let _start_time = Instant::now();
 
@@ -3824,6 +3899,9 @@ async fn process_energy_handler(State(state): State<ApiState>) -> Result<Json<Va
     perf_metrics.increment_requests();
     drop(perf_metrics); // Освобождаем блокировку
 
+    // eBPF программы группы прикрепляются по запросу
+    crate::metrics::system::request_ebpf_metric_groups(&[EbpfMetricGroup::ProcessEnergy]);
+
     // Пробуем использовать кэш
     let cache = state.get_or_create_cache();
     let mut cache_write = cache.write().await;
@@ -3836,7 +3914,7 @@ async fn process_energy_handler(State(state): State<ApiState>) -> Result<Json<Va
             drop(perf_metrics);
 
             trace!("Cache hit for process_energy_handler");
-            return Ok(Json(cached_json.clone()));
+            return Ok(cached_json.clone());
         }
     }
 
@@ -3845,47 +3923,53 @@ async fn process_energy_handler(State(state): State<ApiState>) -> Result<Json<Va
     perf_metrics.increment_cache_misses();
     drop(perf_metrics);
 
-    // Пробуем получить данные из eBPF метрик
-    let mut result = json!({
-        "status": "degraded",
-        "process_energy": null,
-        "count": 0,
-        "message": "Process energy monitoring not available",
-        "suggestion": "Enable process energy monitoring in configuration and ensure eBPF support",
-        "component_status": check_component_availability(&state),
-        "cache_info": {
-            "cached": false,
-            "ttl_seconds": cache_write.cache_ttl_seconds
-        },
-        "timestamp": Utc::now().to_rfc3339()
+    let cache_info = json!({
+        "cached": false,
+        "ttl_seconds": cache_write.cache_ttl_seconds
     });
 
     // Пробуем получить доступ к eBPF метрикам
-    if let Some(metrics_arc) = &state.metrics {
-        let metrics = metrics_arc.read().await;
-        if let Some(ebpf_metrics) = &metrics.ebpf {
-            if let Some(energy_details) = &ebpf_metrics.process_energy_details {
-                result = json!({
-                    "status": "ok",
-                    "process_energy": energy_details,
-                    "count": energy_details.len(),
-                    "total_energy_uj": energy_details.iter().map(|s| s.energy_uj).sum::<u64>(),
-                    "total_energy_w": energy_details.iter().map(|s| s.energy_w).sum::<f32>(),
-                    "cache_info": {
-                        "cached": false,
-                        "ttl_seconds": cache_write.cache_ttl_seconds
-                    },
-                    "timestamp": Utc::now().to_rfc3339()
-                });
-            }
-        }
-    }
+    let ebpf_snapshot = current_ebpf_snapshot(&state).await;
+    let energy = ebpf_snapshot.as_ref().and_then(|ebpf| {
+        Some((
+            ebpf.process_energy_details.as_ref()?,
+            ebpf.section_json(EbpfSnapshotSection::ProcessEnergy)?,
+        ))
+    });
+
+    let (result, count) = match energy {
+        Some((energy_details, section)) => (
+            RawJson::encode(&ProcessEnergyResponse {
+                status: "ok",
+                process_energy: section,
+                count: energy_details.len(),
+                total_energy_uj: energy_details.iter().map(|s| s.energy_uj).sum(),
+                total_energy_w: energy_details.iter().map(|s| s.energy_w).sum(),
+                cache_info,
+                timestamp: Utc::now().to_rfc3339(),
+            })?,
+            energy_details.len(),
+        ),
+        None => (
+            RawJson::encode(&json!({
+                "status": "degraded",
+                "process_energy": null,
+                "count": 0,
+                "message": "Process energy monitoring not available",
+                "suggestion": "Enable process energy monitoring in configuration and ensure eBPF support",
+                "component_status": check_component_availability(&state),
+                "cache_info": cache_info,
+                "timestamp": Utc::now().to_rfc3339()
+            }))?,
+            0,
+        ),
+    };
 
     // Кэшируем результат
     cache_write.cached_process_energy_json = Some((result.clone(), Instant::now()));
 
-    trace!("Cached process energy data (count: {})", result["count"]);
-    Ok(Json(result))
+    trace!("Cached process energy data (count: {})", count);
+    Ok(result)
 }
 
 /// Обработчик для endpoint `/api/processes/memory`.
@@ -3900,6 +3984,9 @@ async fn process_memory_handler(State(state): State<ApiState>) -> Result<Json<Va
     perf_metrics.increment_requests();
     drop(perf_metrics); // Освобождаем блокировку
 
+    // eBPF программы группы прикрепляются по запросу
+    crate::metrics::system::request_ebpf_metric_groups(&[EbpfMetricGroup::ProcessMemory]);
+
     // Пробуем использовать кэш
     let cache = state.get_or_create_cache();
     let mut cache_write = cache.write().await;
@@ -3981,73 +4068,69 @@ async fn process_memory_handler(State(state): State<ApiState>) -> Result<Json<Va
     }
 
     // Пробуем получить данные из eBPF метрик (если доступны)
-    if let Some(metrics_arc) = &state.metrics {
-        let metrics = metrics_arc.read().await;
-        if let Some(ebpf_metrics) = &metrics.ebpf {
-            if let Some(process_memory_details) = &ebpf_metrics.process_memory_details {
-                // Добавляем eBPF данные к результату
-                let mut ebpf_memory_processes = Vec::new();
-                let mut total_rss_bytes = 0u64;
-                let mut total_vms_bytes = 0u64;
-                let mut total_shared_bytes = 0u64;
-                let mut total_swap_bytes = 0u64;
-                let mut total_heap_usage = 0u64;
-                let mut total_stack_usage = 0u64;
-                let mut total_anonymous_memory = 0u64;
-                let mut total_file_backed_memory = 0u64;
-                let mut total_major_faults = 0u64;
-                let mut total_minor_faults = 0u64;
-
-                for stat in process_memory_details {
-                    let process_json = json!({
-                        "pid": stat.pid,
-                        "tgid": stat.tgid,
-                        "last_update_ns": stat.last_update_ns,
-                        "rss_bytes": stat.rss_bytes,
-                        "vms_bytes": stat.vms_bytes,
-                        "shared_bytes": stat.shared_bytes,
-                        "swap_bytes": stat.swap_bytes,
-                        "heap_usage": stat.heap_usage,
-                        "stack_usage": stat.stack_usage,
-                        "anonymous_memory": stat.anonymous_memory,
-                        "file_backed_memory": stat.file_backed_memory,
-                        "major_faults": stat.major_faults,
-                        "minor_faults": stat.minor_faults,
-                        "name": stat.name,
-                        "source": "ebpf"
-                    });
-                    ebpf_memory_processes.push(process_json);
-
-                    // Обновляем общие суммы
-                    total_rss_bytes += stat.rss_bytes;
-                    total_vms_bytes += stat.vms_bytes;
-                    total_shared_bytes += stat.shared_bytes;
-                    total_swap_bytes += stat.swap_bytes;
-                    total_heap_usage += stat.heap_usage;
-                    total_stack_usage += stat.stack_usage;
-                    total_anonymous_memory += stat.anonymous_memory;
-                    total_file_backed_memory += stat.file_backed_memory;
-                    total_major_faults += stat.major_faults;
-                    total_minor_faults += stat.minor_faults;
-                }
-
-                // Добавляем eBPF данные к результату
-                result["ebpf_process_memory"] = json!(ebpf_memory_processes);
-                result["ebpf_count"] = json!(process_memory_details.len());
-                result["total_rss_bytes"] = json!(total_rss_bytes);
-                result["total_vms_bytes"] = json!(total_vms_bytes);
-                result["total_shared_bytes"] = json!(total_shared_bytes);
-                result["total_swap_bytes"] = json!(total_swap_bytes);
-                result["total_heap_usage"] = json!(total_heap_usage);
-                result["total_stack_usage"] = json!(total_stack_usage);
-                result["total_anonymous_memory"] = json!(total_anonymous_memory);
-                result["total_file_backed_memory"] = json!(total_file_backed_memory);
-                result["total_major_faults"] = json!(total_major_faults);
-                result["total_minor_faults"] = json!(total_minor_faults);
-                result["message"] = json!(
-                    "Process memory monitoring data retrieved successfully (with eBPF details)"
-                );
+    if let Some(ebpf_metrics) = current_ebpf_snapshot(&state).await {
+        if let Some(process_memory_details) = &ebpf_metrics.process_memory_details {
+            // Добавляем eBPF данные к результату
+            let mut ebpf_memory_processes = Vec::new();
+            let mut total_rss_bytes = 0u64;
+            let mut total_vms_bytes = 0u64;
+            let mut total_shared_bytes = 0u64;
+            let mut total_swap_bytes = 0u64;
+            let mut total_heap_usage = 0u64;
+            let mut total_stack_usage = 0u64;
+            let mut total_anonymous_memory = 0u64;
+            let mut total_file_backed_memory = 0u64;
+            let mut total_major_faults = 0u64;
+            let mut total_minor_faults = 0u64;
+
+            for stat in process_memory_details {
+                let process_json = json!({
+                    "pid": stat.pid,
+                    "tgid": stat.tgid,
+                    "last_update_ns": stat.last_update_ns,
+                    "rss_bytes": stat.rss_bytes,
+                    "vms_bytes": stat.vms_bytes,
+                    "shared_bytes": stat.shared_bytes,
+                    "swap_bytes": stat.swap_bytes,
+                    "heap_usage": stat.heap_usage,
+                    "stack_usage": stat.stack_usage,
+                    "anonymous_memory": stat.anonymous_memory,
+                    "file_backed_memory": stat.file_backed_memory,
+                    "major_faults": stat.major_faults,
+                    "minor_faults": stat.minor_faults,
+                    "name": stat.name,
+                    "source": "ebpf"
+                });
+                ebpf_memory_processes.push(process_json);
+
+                // Обновляем общие суммы
+                total_rss_bytes += stat.rss_bytes;
+                total_vms_bytes += stat.vms_bytes;
+                total_shared_bytes += stat.shared_bytes;
+                total_swap_bytes += stat.swap_bytes;
+                total_heap_usage += stat.heap_usage;
+                total_stack_usage += stat.stack_usage;
+                total_anonymous_memory += stat.anonymous_memory;
+                total_file_backed_memory += stat.file_backed_memory;
+                total_major_faults += stat.major_faults;
+                total_minor_faults += stat.minor_faults;
             }
+
+            // Добавляем eBPF данные к результату
+            result["ebpf_process_memory"] = json!(ebpf_memory_processes);
+            result["ebpf_count"] = json!(process_memory_details.len());
+            result["total_rss_bytes"] = json!(total_rss_bytes);
+            result["total_vms_bytes"] = json!(total_vms_bytes);
+            result["total_shared_bytes"] = json!(total_shared_bytes);
+            result["total_swap_bytes"] = json!(total_swap_bytes);
+            result["total_heap_usage"] = json!(total_heap_usage);
+            result["total_stack_usage"] = json!(total_stack_usage);
+            result["total_anonymous_memory"] = json!(total_anonymous_memory);
+            result["total_file_backed_memory"] = json!(total_file_backed_memory);
+            result["total_major_faults"] = json!(total_major_faults);
+            result["total_minor_faults"] = json!(total_minor_faults);
+            result["message"] =
+                json!("Process memory monitoring data retrieved successfully (with eBPF details)");
         }
     }
 
@@ -4061,7 +4144,23 @@ async fn process_memory_handler(State(state): State<ApiState>) -> Result<Json<Va
 /// Обработчик для endpoint `/api/processes/gpu`.
 ///
 /// Возвращает статистику использования GPU процессами (если доступны).
-async fn process_gpu_handler(State(state): State<ApiState>) -> Result<Json<Value>, StatusCode> {
+/// Список процессов вставляется в ответ готовой секцией eBPF снимка.
+async fn process_gpu_handler(State(state): State<ApiState>) -> Result<RawJson, StatusCode> {
+    /// Ответ с секцией `process_gpu`, закодированной снимком
+    #[derive(serde::Serialize)]
+    struct ProcessGpuResponse<'a> {
+        status: &'static str,
+        process_gpu: &'a RawValue,
+        count: usize,
+        total_gpu_time_ns: u64,
+        total_memory_bytes: u64,
+        total_compute_units: u64,
+        message: &'static str,
+        component_status: Value,
+        cache_info: Value,
+        timestamp: String,
+    }
+
     // Начинаем отслеживание производительности
     let _start_time = Instant::now();
 
@@ -4070,6 +4169,9 @@ async fn process_gpu_handler(State(state): State<ApiState>) -> Result<Json<Value
     perf_metrics.increment_requests();
     drop(perf_metrics); // Освобождаем блокировку
 
+    // eBPF программы группы прикрепляются по запросу
+    crate::metrics::system::request_ebpf_metric_groups(&[EbpfMetricGroup::ProcessGpu]);
+
     // Пробуем использовать кэш
     let cache = state.get_or_create_cache();
     let mut cache_write = cache.write().await;
@@ -4082,7 +4184,7 @@ async fn process_gpu_handler(State(state): State<ApiState>) -> Result<Json<Value
             drop(perf_metrics);
 
             trace!("Cache hit for process_gpu_handler");
-            return Ok(Json(cached_json.clone()));
+            return Ok(cached_json.clone());
         }
     }
 
@@ -4091,64 +4193,64 @@ async fn process_gpu_handler(State(state): State<ApiState>) -> Result<Json<Value
     perf_metrics.increment_cache_misses();
     drop(perf_metrics);
 
-    // Пробуем получить данные из eBPF метрик
-    let mut result = json!({
-        "status": "degraded",
-        "process_gpu": null,
-        "count": 0,
-        "message": "Process GPU monitoring not available",
-        "suggestion": "Enable process GPU monitoring in configuration and ensure eBPF support",
-        "component_status": check_component_availability(&state),
-        "cache_info": {
-            "cached": false,
-            "ttl_seconds": cache_write.cache_ttl_seconds
-        },
-        "timestamp": Utc::now().to_rfc3339()
+    let cache_info = json!({
+        "cached": false,
+        "ttl_seconds": cache_write.cache_ttl_seconds
     });
 
     // Пробуем получить доступ к eBPF метрикам
-    if let Some(metrics_arc) = &state.metrics {
-        let metrics = metrics_arc.read().await;
-        if let Some(ebpf_metrics) = &metrics.ebpf {
-            if let Some(process_gpu_details) = &ebpf_metrics.process_gpu_details {
-                if !process_gpu_details.is_empty() {
-                    // Успешно получили данные о использовании GPU процессами
-                    let total_gpu_time_ns: u64 =
-                        process_gpu_details.iter().map(|p| p.gpu_time_ns).sum();
-                    let total_memory_bytes: u64 = process_gpu_details
-                        .iter()
-                        .map(|p| p.memory_usage_bytes)
-                        .sum();
-                    let total_compute_units: u64 = process_gpu_details
-                        .iter()
-                        .map(|p| p.compute_units_used)
-                        .sum();
-
-                    result = json!({
-                        "status": "ok",
-                        "process_gpu": process_gpu_details,
-                        "count": process_gpu_details.len(),
-                        "total_gpu_time_ns": total_gpu_time_ns,
-                        "total_memory_bytes": total_memory_bytes,
-                        "total_compute_units": total_compute_units,
-                        "message": "Process GPU monitoring data retrieved successfully",
-                        "component_status": check_component_availability(&state),
-                        "cache_info": {
-                            "cached": false,
-                            "ttl_seconds": cache_write.cache_ttl_seconds
-                        },
-                        "timestamp": Utc::now().to_rfc3339()
-                    });
-                }
-            }
+    let ebpf_snapshot = current_ebpf_snapshot(&state).await;
+    let gpu = ebpf_snapshot.as_ref().and_then(|ebpf| {
+        let details = ebpf.process_gpu_details.as_ref()?;
+        if details.is_empty() {
+            return None;
         }
-    }
+        Some((details, ebpf.section_json(EbpfSnapshotSection::ProcessGpu)?))
+    });
+
+    let (result, count) = match gpu {
+        Some((process_gpu_details, section)) => (
+            // Успешно получили данные о использовании GPU процессами
+            RawJson::encode(&ProcessGpuResponse {
+                status: "ok",
+                process_gpu: section,
+                count: process_gpu_details.len(),
+                total_gpu_time_ns: process_gpu_details.iter().map(|p| p.gpu_time_ns).sum(),
+                total_memory_bytes: process_gpu_details
+                    .iter()
+                    .map(|p| p.memory_usage_bytes)
+                    .sum(),
+                total_compute_units: process_gpu_details
+                    .iter()
+                    .map(|p| p.compute_units_used)
+                    .sum(),
+                message: "Process GPU monitoring data retrieved successfully",
+                component_status: check_component_availability(&state),
+                cache_info,
+                timestamp: Utc::now().to_rfc3339(),
+            })?,
+            process_gpu_details.len(),
+        ),
+        None => (
+            RawJson::encode(&json!({
+                "status": "degraded",
+                "process_gpu": null,
+                "count": 0,
+                "message": "Process GPU monitoring not available",
+                "suggestion": "Enable process GPU monitoring in configuration and ensure eBPF support",
+                "component_status": check_component_availability(&state),
+                "cache_info": cache_info,
+                "timestamp": Utc::now().to_rfc3339()
+            }))?,
+            0,
+        ),
+    };
 
     // Кэшируем результат
     cache_write.cached_process_gpu_json = Some((result.clone(), Instant::now()));
-    trace!("Cached process GPU data (count: {})", result["count"]);
+    trace!("Cached process GPU data (count: {})", count);
 
-    Ok(Json(result))
+    Ok(result)
 }
 
 /// Обработчик для endpoint `/api/processes/network`.
@@ -4163,6 +4265,9 @@ async fn process_network_handler(State(state): State<ApiState>) -> Result<Json<V
     perf_metrics.increment_requests();
     drop(perf_metrics); // Освобождаем блокировку
 
+    // eBPF программы группы прикрепляются по запросу
+    crate::metrics::system::request_ebpf_metric_groups(&[EbpfMetricGroup::ProcessNetwork]);
+
     // Пробуем использовать кэш
     let cache = state.get_or_create_cache();
     let mut cache_write = cache.write().await;
@@ -4204,50 +4309,47 @@ async fn process_network_handler(State(state): State<ApiState>) -> Result<Json<V
     });
 
     // Пробуем получить доступ к eBPF метрикам
-    if let Some(metrics_arc) = &state.metrics {
-        let metrics = metrics_arc.read().await;
-        if let Some(ebpf_metrics) = &metrics.ebpf {
-            if let Some(process_network_details) = &ebpf_metrics.process_network_details {
-                // Конвертируем статистику в JSON
-                let mut process_network_json = Vec::new();
-                let mut total_packets_sent = 0;
-                let mut total_packets_received = 0;
-                let mut total_bytes_sent = 0;
-                let mut total_bytes_received = 0;
-
-                for stat in process_network_details {
-                    let process_info = json!({
-                        "pid": stat.pid,
-                        "tgid": stat.tgid,
-                        "packets_sent": stat.packets_sent,
-                        "packets_received": stat.packets_received,
-                        "bytes_sent": stat.bytes_sent,
-                        "bytes_received": stat.bytes_received,
-                        "last_update_ns": stat.last_update_ns,
-                        "name": stat.name,
-                        "total_network_operations": stat.total_network_operations
-                    });
-                    process_network_json.push(process_info);
-
-                    total_packets_sent += stat.packets_sent;
-                    total_packets_received += stat.packets_received;
-                    total_bytes_sent += stat.bytes_sent;
-                    total_bytes_received += stat.bytes_received;
-                }
+    if let Some(ebpf_metrics) = current_ebpf_snapshot(&state).await {
+        if let Some(process_network_details) = &ebpf_metrics.process_network_details {
+            // Конвертируем статистику в JSON
+            let mut process_network_json = Vec::new();
+            let mut total_packets_sent = 0;
+            let mut total_packets_received = 0;
+            let mut total_bytes_sent = 0;
+            let mut total_bytes_received = 0;
+
+            for stat in process_network_details {
+                let process_info = json!({
+                    "pid": stat.pid,
+                    "tgid": stat.tgid,
+                    "packets_sent": stat.packets_sent,
+                    "packets_received": stat.packets_received,
+                    "bytes_sent": stat.bytes_sent,
+                    "bytes_received": stat.bytes_received,
+                    "last_update_ns": stat.last_update_ns,
+                    "name": stat.name,
+                    "total_network_operations": stat.total_network_operations
+                });
+                process_network_json.push(process_info);
 
-                result["status"] = "ok".into();
-                result["process_network"] = process_network_json.into();
-                result["count"] = process_network_details.len().into();
-                result["total_packets_sent"] = total_packets_sent.into();
-                result["total_packets_received"] = total_packets_received.into();
-                result["total_bytes_sent"] = total_bytes_sent.into();
-                result["total_bytes_received"] = total_bytes_received.into();
-                result["message"] = "Process network monitoring data retrieved successfully".into();
-                result["cache_info"]["cached"] = false.into();
-
-                // Кэшируем результат
-                cache_write.cached_process_network_json = Some((result.clone(), Instant::now()));
+                total_packets_sent += stat.packets_sent;
+                total_packets_received += stat.packets_received;
+                total_bytes_sent += stat.bytes_sent;
+                total_bytes_received += stat.bytes_received;
             }
+
+            result["status"] = "ok".into();
+            result["process_network"] = process_network_json.into();
+            result["count"] = process_network_details.len().into();
+            result["total_packets_sent"] = total_packets_sent.into();
+            result["total_packets_received"] = total_packets_received.into();
+            result["total_bytes_sent"] = total_bytes_sent.into();
+            result["total_bytes_received"] = total_bytes_received.into();
+            result["message"] = "Process network monitoring data retrieved successfully".into();
+            result["cache_info"]["cached"] = false.into();
+
+            // Кэшируем результат
+            cache_write.cached_process_network_json = Some((result.clone(), Instant::now()));
         }
     }
 
@@ -4266,6 +4368,9 @@ async fn process_disk_handler(State(state): State<ApiState>) -> Result<Json<Valu
     perf_metrics.increment_requests();
     drop(perf_metrics); // Освобождаем блокировку
 
+    // eBPF программы группы прикрепляются по запросу
+    crate::metrics::system::request_ebpf_metric_groups(&[EbpfMetricGroup::ProcessDisk]);
+
     // Пробуем использовать кэш
     let cache = state.get_or_create_cache();
     let mut cache_write = cache.write().await;
@@ -4307,50 +4412,47 @@ async fn process_disk_handler(State(state): State<ApiState>) -> Result<Json<Valu
     });
 
     // Пробуем получить доступ к eBPF метрикам
-    if let Some(metrics_arc) = &state.metrics {
-        let metrics = metrics_arc.read().await;
-        if let Some(ebpf_metrics) = &metrics.ebpf {
-            if let Some(process_disk_details) = &ebpf_metrics.process_disk_details {
-                // Конвертируем статистику в JSON
-                let mut process_disk_json = Vec::new();
-                let mut total_bytes_read = 0;
-                let mut total_bytes_written = 0;
-                let mut total_read_operations = 0;
-                let mut total_write_operations = 0;
-
-                for stat in process_disk_details {
-                    let process_info = json!({
-                        "pid": stat.pid,
-                        "tgid": stat.tgid,
-                        "bytes_read": stat.bytes_read,
-                        "bytes_written": stat.bytes_written,
-                        "read_operations": stat.read_operations,
-                        "write_operations": stat.write_operations,
-                        "last_update_ns": stat.last_update_ns,
-                        "name": stat.name,
-                        "total_io_operations": stat.total_io_operations
-                    });
-                    process_disk_json.push(process_info);
-
-                    total_bytes_read += stat.bytes_read;
-                    total_bytes_written += stat.bytes_written;
-                    total_read_operations += stat.read_operations;
-                    total_write_operations += stat.write_operations;
-                }
+    if let Some(ebpf_metrics) = current_ebpf_snapshot(&state).await {
+        if let Some(process_disk_details) = &ebpf_metrics.process_disk_details {
+            // Конвертируем статистику в JSON
+            let mut process_disk_json = Vec::new();
+            let mut total_bytes_read = 0;
+            let mut total_bytes_written = 0;
+            let mut total_read_operations = 0;
+            let mut total_write_operations = 0;
+
+            for stat in process_disk_details {
+                let process_info = json!({
+                    "pid": stat.pid,
+                    "tgid": stat.tgid,
+                    "bytes_read": stat.bytes_read,
+                    "bytes_written": stat.bytes_written,
+                    "read_operations": stat.read_operations,
+                    "write_operations": stat.write_operations,
+                    "last_update_ns": stat.last_update_ns,
+                    "name": stat.name,
+                    "total_io_operations": stat.total_io_operations
+                });
+                process_disk_json.push(process_info);
 
-                result["status"] = "ok".into();
-                result["process_disk"] = process_disk_json.into();
-                result["count"] = process_disk_details.len().into();
-                result["total_bytes_read"] = total_bytes_read.into();
-                result["total_bytes_written"] = total_bytes_written.into();
-                result["total_read_operations"] = total_read_operations.into();
-                result["total_write_operations"] = total_write_operations.into();
-                result["message"] = "Process disk monitoring data retrieved successfully".into();
-                result["cache_info"]["cached"] = false.into();
-
-                // Кэшируем результат
-                cache_write.cached_process_disk_json = Some((result.clone(), Instant::now()));
+                total_bytes_read += stat.bytes_read;
+                total_bytes_written += stat.bytes_written;
+                total_read_operations += stat.read_operations;
+                total_write_operations += stat.write_operations;
             }
+
+            result["status"] = "ok".into();
+            result["process_disk"] = process_disk_json.into();
+            result["count"] = process_disk_details.len().into();
+            result["total_bytes_read"] = total_bytes_read.into();
+            result["total_bytes_written"] = total_bytes_written.into();
+            result["total_read_operations"] = total_read_operations.into();
+            result["total_write_operations"] = total_write_operations.into();
+            result["message"] = "Process disk monitoring data retrieved successfully".into();
+            result["cache_info"]["cached"] = false.into();
+
+            // Кэшируем результат
+            cache_write.cached_process_disk_json = Some((result.clone(), Instant::now()));
         }
     }
 
@@ -4943,6 +5045,46 @@ fn graceful_degradation_response(resource_name: &str, suggestion: &str) -> Json<
     }))
 }
 
+/// Текущий снимок eBPF метрик
+///
+/// Блокировка метрик держится только на время копирования указателя на
+/// снимок, поэтому сериализация не задерживает запись следующего поколения.
+async fn current_ebpf_snapshot(state: &ApiState) -> Option<EbpfSnapshot> {
+    let metrics_arc = state.metrics.as_ref()?;
+    let snapshot = metrics_arc.read().await.ebpf.clone();
+    snapshot
+}
+
+/// JSON ответ, уже сериализованный в текст
+///
+/// Ответы с секциями eBPF снимка ([`EbpfSnapshot::section_json`]) кодируются
+/// один раз: секция записывается в текст как есть, а кэш обработчика хранит
+/// готовый текст, так что попадание в кэш не копирует дерево `Value`.
+#[derive(Debug, Clone, PartialEq)]
+struct RawJson(Arc<str>);
+
+impl RawJson {
+    /// Сериализовать ответ
+    fn encode<T: serde::Serialize>(response: &T) -> Result<Self, StatusCode> {
+        serde_json::to_string(response)
+            .map(|text| Self(text.into()))
+            .map_err(|e| {
+                error!("Failed to serialize API response: {}", e);
+                StatusCode::INTERNAL_SERVER_ERROR
+            })
+    }
+}
+
+impl IntoResponse for RawJson {
+    fn into_response(self) -> Response<axum::body::Body> {
+        (
+            [(axum::http::header::CONTENT_TYPE, "application/json")],
+            String::from(&*self.0),
+        )
+            .into_response()
+    }
+}
+
 /// Хелпер для проверки доступности основных компонентов
 fn check_component_availability(state: &ApiState) -> Value {
     json!({
@@ -5870,7 +6012,7 @@ mod tests {
             NotificationBackend, NotificationConfig, NotificationLevel, Paths,
             PatternAutoUpdateConfig, PolicyMode, Thresholds,
         };
-        use crate::metrics::ebpf::{EbpfConfig, EbpfFilterConfig};
+        use crate::metrics::ebpf::{EbpfConfig, EbpfFilterConfig, FilesystemMonitorMode};
         let config = Config {
             polling_interval_ms: 1000,
             max_candidates: 150,
@@ -5959,6 +6101,25 @@ mod tests {
                 enable_aggressive_caching: false,
                 aggressive_cache_interval_ms: 5000,
                 filter_config: EbpfFilterConfig::default(),
+                enable_ringbuf_events: false,
+                ringbuf_wakeup_threshold_bytes: 4096,
+                ringbuf_poll_timeout_ms: 100,
+                syscall_latency_app_syscalls: Vec::new(),
+                enable_adaptive_sampling: true,
+                sampling_cpu_budget_percent: 1.0,
+                max_sampling_rate: 64,
+                enable_overhead_stats: true,
+                process_memory_rss_delta_kb: 1024,
+                filesystem_mode: FilesystemMonitorMode::Detailed,
+                enable_memory_pressure_monitoring: false,
+                enable_kmem_allocation_tracking: false,
+                enable_runqueue_latency_fast_path: false,
+                runqueue_latency_threshold_us: 5_000,
+                runqueue_latency_min_interval_ms: 50,
+                demand_driven_attachment: false,
+                attachment_idle_timeout_secs: 300,
+                enable_epoch_aggregation: false,
+                epoch_interval_ms: 1000,
             },
             custom_metrics: None,
         };
@@ -6210,7 +6371,7 @@ mod tests {
             CacheIntervals, Config, LoggingConfig, MLClassifierConfig, ModelConfig, ModelType,
             Paths, PatternAutoUpdateConfig, PolicyMode, Thresholds,
         };
-        use crate::metrics::ebpf::{EbpfConfig, EbpfFilterConfig};
+        use crate::metrics::ebpf::{EbpfConfig, EbpfFilterConfig, FilesystemMonitorMode};
         let config = Config {
             polling_interval_ms: 1000,
             max_candidates: 150,
@@ -6299,6 +6460,25 @@ mod tests {
                 enable_notifications: false,
                 notification_thresholds: EbpfNotificationThresholds::default(),
                 filter_config: EbpfFilterConfig::default(),
+                enable_ringbuf_events: false,
+                ringbuf_wakeup_threshold_bytes: 4096,
+                ringbuf_poll_timeout_ms: 100,
+                syscall_latency_app_syscalls: Vec::new(),
+                enable_adaptive_sampling: true,
+                sampling_cpu_budget_percent: 1.0,
+                max_sampling_rate: 64,
+                enable_overhead_stats: true,
+                process_memory_rss_delta_kb: 1024,
+                filesystem_mode: FilesystemMonitorMode::Detailed,
+                enable_memory_pressure_monitoring: false,
+                enable_kmem_allocation_tracking: false,
+                enable_runqueue_latency_fast_path: false,
+                runqueue_latency_threshold_us: 5_000,
+                runqueue_latency_min_interval_ms: 50,
+                demand_driven_attachment: false,
+                attachment_idle_timeout_secs: 300,
+                enable_epoch_aggregation: false,
+                epoch_interval_ms: 1000,
             },
             custom_metrics: None,
         };
@@ -9179,8 +9359,10 @@ async fn network_connections_handler(
                             .into_iter()
                             .map(|conn| {
                                 json!({
-                                    "src_ip": format_ip(conn.src_ip),
-                                    "dst_ip": format_ip(conn.dst_ip),
+                                    "src_ip": format_conn_addr(conn.src_addr, conn.src_ip),
+                                    "dst_ip": format_conn_addr(conn.dst_addr, conn.dst_ip),
+                                    "family": conn.family,
+                                    "tgid": conn.tgid,
                                     "src_port": conn.src_port,
                                     "dst_port": conn.dst_port,
                                     "protocol": protocol_to_string(conn.protocol),
@@ -9318,12 +9500,352 @@ async fn cpu_temperature_handler(State(state): State<ApiState>) -> Result<Json<V
     }
 }
 
+/// Обработчик для endpoint `/api/ebpf/syscalls/latency`.
+///
+/// Возвращает перцентили задержек системных вызовов из log2 гистограмм eBPF:
+/// сводки по всей системе и по процессам для отслеживаемых системных вызовов
+/// (futex, read, io_uring_enter). Параметр `tgid` ограничивает ответ одним процессом.
+async fn syscall_latency_handler(
+    State(state): State<ApiState>,
+    Query(params): Query<HashMap<String, String>>,
+) -> Result<Json<Value>, StatusCode> {
+    // Обновляем метрики производительности
+    let mut perf_metrics = state.performance_metrics.write().await;
+    perf_metrics.increment_requests();
+    drop(perf_metrics); // Освобождаем блокировку
+
+    // eBPF программы группы прикрепляются по запросу
+    crate::metrics::system::request_ebpf_metric_groups(&[EbpfMetricGroup::Syscalls]);
+
+    let tgid_filter = match params.get("tgid") {
+        Some(value) => Some(value.parse::<u32>().map_err(|_| StatusCode::BAD_REQUEST)?),
+        None => None,
+    };
+
+    let mut result = json!({
+        "status": "degraded",
+        "system": null,
+        "applications": null,
+        "message": "Syscall latency histograms not available",
+        "suggestion": "Enable syscall monitoring in eBPF configuration and ensure syscall_monitor is embedded",
+        "timestamp": Utc::now().to_rfc3339()
+    });
+
+    let ebpf_snapshot = current_ebpf_snapshot(&state).await;
+    if let Some(latency_details) = ebpf_snapshot
+        .as_ref()
+        .and_then(|ebpf| ebpf.syscall_latency_details.as_ref())
+    {
+        let (applications, system): (Vec<_>, Vec<_>) = latency_details
+            .iter()
+            .filter(|stat| tgid_filter.is_none() || stat.tgid == tgid_filter)
+            .partition(|stat| stat.tgid.is_some());
+
+        result = json!({
+            "status": "ok",
+            "system": system,
+            "applications": applications,
+            "count": system.len() + applications.len(),
+            "timestamp": Utc::now().to_rfc3339()
+        });
+    }
+
+    Ok(Json(result))
+}
+
+/// Обработчик для endpoint `/api/ebpf/overhead`.
+///
+/// Возвращает стоимость каждой загруженной eBPF программы (количество
+/// запусков, суммарное и среднее время), заполнение хеш-карт относительно
+/// `max_entries`, отладочные счётчики ядра (пропавшие записи, отказы
+/// обновления карт) и текущие коэффициенты адаптивной выборки. Параметр
+/// `object` ограничивает ответ одним eBPF объектом.
+async fn ebpf_overhead_handler(
+    State(state): State<ApiState>,
+    Query(params): Query<HashMap<String, String>>,
+) -> Result<Json<Value>, StatusCode> {
+    // Обновляем метрики производительности
+    let mut perf_metrics = state.performance_metrics.write().await;
+    perf_metrics.increment_requests();
+    drop(perf_metrics); // Освобождаем блокировку
+
+    let object_filter = params.get("object");
+
+    let mut result = json!({
+        "status": "degraded",
+        "programs": null,
+        "maps": null,
+        "debug_counters": null,
+        "message": "eBPF overhead statistics not available",
+        "suggestion": "Enable enable_overhead_stats in eBPF configuration; run time requires Linux 5.8+ or kernel.bpf_stats_enabled=1",
+        "timestamp": Utc::now().to_rfc3339()
+    });
+
+    let ebpf_snapshot = current_ebpf_snapshot(&state).await;
+    if let Some(report) = ebpf_snapshot
+        .as_ref()
+        .and_then(|ebpf| ebpf.program_overhead.as_ref())
+    {
+        let matches = |object: &String| object_filter.map_or(true, |filter| object == filter);
+        let programs: Vec<_> = report
+            .programs
+            .iter()
+            .filter(|program| matches(&program.object))
+            .collect();
+        let maps: Vec<_> = report
+            .maps
+            .iter()
+            .filter(|map| matches(&map.object))
+            .collect();
+        let debug_counters: Vec<_> = report
+            .debug_counters
+            .iter()
+            .filter(|counters| matches(&counters.object))
+            .collect();
+
+        result = json!({
+            "status": "ok",
+            "run_time_stats_enabled": report.run_time_stats_enabled,
+            "programs": programs,
+            "maps": maps,
+            "debug_counters": debug_counters,
+            "sampling": report.sampling,
+            "timestamp": Utc::now().to_rfc3339()
+        });
+    }
+
+    Ok(Json(result))
+}
+
+/// Обработчик для endpoint `/api/ebpf/epoch`.
+///
+/// Возвращает последнюю сводку эпохи, собранную в ядре программой
+/// `epoch_aggregator`: загрузку CPU, ожидание ввода-вывода, трафик и самые
+/// нагруженные процессы за эпоху. С параметром `history=true` возвращает
+/// также предыдущие сводки от старых к новым.
+async fn ebpf_epoch_handler(
+    State(state): State<ApiState>,
+    Query(params): Query<HashMap<String, String>>,
+) -> Result<Json<Value>, StatusCode> {
+    // Обновляем метрики производительности
+    let mut perf_metrics = state.performance_metrics.write().await;
+    perf_metrics.increment_requests();
+    drop(perf_metrics); // Освобождаем блокировку
+
+    let include_history = params.get("history").map_or(false, |value| value == "true");
+
+    let ebpf_snapshot = current_ebpf_snapshot(&state).await;
+    let epochs = ebpf_snapshot
+        .as_ref()
+        .and_then(|ebpf| ebpf.epoch_summaries.as_ref())
+        .filter(|epochs| !epochs.is_empty());
+
+    let Some(epochs) = epochs else {
+        return Ok(Json(json!({
+            "status": "degraded",
+            "latest": null,
+            "message": "In-kernel epoch aggregation not available",
+            "suggestion": "Enable enable_epoch_aggregation in eBPF configuration; requires Linux 5.19+ with bpf_timer and the sched_monitor or process_network program loaded",
+            "timestamp": Utc::now().to_rfc3339()
+        })));
+    };
+
+    let mut result = json!({
+        "status": "ok",
+        "latest": epochs.last(),
+        "epochs_available": epochs.len(),
+        "timestamp": Utc::now().to_rfc3339()
+    });
+    if include_history {
+        result["history"] = json!(epochs);
+    }
+
+    Ok(Json(result))
+}
+
+/// Обработчик для endpoint `/api/ebpf/profile` (POST).
+///
+/// Запускает сессию профилирования стеков выбранных процессов: выборку на CPU
+/// (таймер perf с частотой `frequency_hz` на каждом CPU) и ожидание вне CPU
+/// (`sched_switch`). Через `duration_secs` программы открепляются
+/// автоматически; результат доступен через `/api/ebpf/profile/folded` и
+/// `/api/ebpf/profile/flamegraph`.
+///
+/// # Примеры
+///
+/// ```bash
+/// curl -X POST http://127.0.0.1:8080/api/ebpf/profile \
+///     -H 'Content-Type: application/json' \
+///     -d '{"tgids": [4242], "duration_secs": 10}'
+/// ```
+async fn ebpf_profile_start_handler(
+    State(state): State<ApiState>,
+    Json(payload): Json<Value>,
+) -> Result<Json<Value>, StatusCode> {
+    // Обновляем метрики производительности
+    let mut perf_metrics = state.performance_metrics.write().await;
+    perf_metrics.increment_requests();
+    drop(perf_metrics); // Освобождаем блокировку
+
+    let request: StackProfileRequest = match serde_json::from_value(payload) {
+        Ok(request) => request,
+        Err(e) => {
+            warn!("Invalid stack profile request: {}", e);
+            return Ok(Json(json!({
+                "status": "error",
+                "message": format!("Invalid profiling request: {}", e),
+                "suggestion": "Required fields: tgids (array of u32), duration_secs. Optional: on_cpu, off_cpu, frequency_hz, min_offcpu_us",
+                "timestamp": Utc::now().to_rfc3339()
+            })));
+        }
+    };
+
+    match crate::metrics::system::start_ebpf_stack_profile(request) {
+        Ok(()) => {
+            info!("Stack profiling session started");
+            Ok(Json(json!({
+                "status": "ok",
+                "profile": crate::metrics::system::ebpf_stack_profile_status(),
+                "timestamp": Utc::now().to_rfc3339()
+            })))
+        }
+        Err(e) => Ok(Json(json!({
+            "status": "error",
+            "message": e.to_string(),
+            "suggestion": "Stack profiling requires eBPF support (CAP_BPF and CAP_PERFMON or root) and one session at a time",
+            "timestamp": Utc::now().to_rfc3339()
+        }))),
+    }
+}
+
+/// Обработчик для endpoint `/api/ebpf/profile` (GET).
+///
+/// Возвращает состояние текущей или последней сессии профилирования
+/// (`idle`, `running`, `finished`, `failed`) и сводку результата.
+async fn ebpf_profile_status_handler(
+    State(state): State<ApiState>,
+) -> Result<Json<Value>, StatusCode> {
+    // Обновляем метрики производительности
+    let mut perf_metrics = state.performance_metrics.write().await;
+    perf_metrics.increment_requests();
+    drop(perf_metrics); // Освобождаем блокировку
+
+    let summary = crate::metrics::system::ebpf_stack_profile().map(|profile| {
+        json!({
+            "started_at": profile.started_at,
+            "duration_ms": profile.duration_ms,
+            "on_cpu_stacks": profile.stacks.iter().filter(|s| s.kind == StackKind::OnCpu).count(),
+            "off_cpu_stacks": profile.stacks.iter().filter(|s| s.kind == StackKind::OffCpu).count(),
+            "lost_samples": profile.lost_samples,
+            "truncated": profile.truncated
+        })
+    });
+
+    Ok(Json(json!({
+        "status": "ok",
+        "profile": crate::metrics::system::ebpf_stack_profile_status(),
+        "summary": summary,
+        "timestamp": Utc::now().to_rfc3339()
+    })))
+}
+
+/// Обработчик для endpoint `/api/ebpf/profile/stop` (POST).
+///
+/// Завершает выполняющуюся сессию профилирования досрочно; собранные стеки
+/// сохраняются как результат.
+async fn ebpf_profile_stop_handler(
+    State(state): State<ApiState>,
+) -> Result<Json<Value>, StatusCode> {
+    // Обновляем метрики производительности
+    let mut perf_metrics = state.performance_metrics.write().await;
+    perf_metrics.increment_requests();
+    drop(perf_metrics); // Освобождаем блокировку
+
+    let stopped = crate::metrics::system::stop_ebpf_stack_profile();
+    let message = if stopped {
+        "Stack profiling session is stopping"
+    } else {
+        "No stack profiling session is running"
+    };
+    Ok(Json(json!({
+        "status": "ok",
+        "stopped": stopped,
+        "message": message,
+        "timestamp": Utc::now().to_rfc3339()
+    })))
+}
+
+/// Вид стеков из параметра `kind` (`on_cpu` по умолчанию или `off_cpu`)
+fn stack_kind_param(params: &HashMap<String, String>) -> Result<StackKind, StatusCode> {
+    match params.get("kind") {
+        Some(kind) => {
+            serde_json::from_value(Value::String(kind.clone())).map_err(|_| StatusCode::BAD_REQUEST)
+        }
+        None => Ok(StackKind::OnCpu),
+    }
+}
+
+/// Обработчик для endpoint `/api/ebpf/profile/folded`.
+///
+/// Возвращает результат последней сессии в формате свёрнутых стеков
+/// (`comm;кадр;...;кадр значение`, вход `flamegraph.pl`). Параметр `kind`:
+/// `on_cpu` (значение — количество выборок) или `off_cpu` (микросекунды вне CPU).
+///
+/// # Примеры
+///
+/// ```bash
+/// curl "http://127.0.0.1:8080/api/ebpf/profile/folded?kind=off_cpu" | flamegraph.pl > offcpu.svg
+/// ```
+async fn ebpf_profile_folded_handler(
+    Query(params): Query<HashMap<String, String>>,
+) -> Result<String, StatusCode> {
+    let kind = stack_kind_param(&params)?;
+    let profile = crate::metrics::system::ebpf_stack_profile().ok_or(StatusCode::NOT_FOUND)?;
+    Ok(profile.folded(kind))
+}
+
+/// Обработчик для endpoint `/api/ebpf/profile/flamegraph`.
+///
+/// Возвращает результат последней сессии деревом `{name, value, children}`
+/// для d3-flame-graph. Параметр `kind` такой же, как у `/api/ebpf/profile/folded`.
+async fn ebpf_profile_flamegraph_handler(
+    Query(params): Query<HashMap<String, String>>,
+) -> Result<Json<Value>, StatusCode> {
+    let kind = stack_kind_param(&params)?;
+
+    let result = match crate::metrics::system::ebpf_stack_profile() {
+        Some(profile) => json!({
+            "status": "ok",
+            "kind": kind,
+            "lost_samples": profile.lost_samples,
+            "truncated": profile.truncated,
+            "flamegraph": profile.flamegraph(kind),
+            "timestamp": Utc::now().to_rfc3339()
+        }),
+        None => json!({
+            "status": "degraded",
+            "kind": kind,
+            "flamegraph": null,
+            "message": "No finished stack profiling session",
+            "suggestion": "Start a session with POST /api/ebpf/profile and wait for duration_secs",
+            "timestamp": Utc::now().to_rfc3339()
+        }),
+    };
+
+    Ok(Json(result))
+}
+
 /// Вспомогательная функция для форматирования IP адреса
 fn format_ip(ip: u32) -> String {
     let bytes = ip.to_be_bytes();
     format!("{}.{}.{}.{}", bytes[0], bytes[1], bytes[2], bytes[3])
 }
 
+/// Адрес соединения: полный адрес (в том числе IPv6), если он известен
+fn format_conn_addr(addr: Option<std::net::IpAddr>, ip: u32) -> String {
+    addr.map_or_else(|| format_ip(ip), |addr| addr.to_string())
+}
+
 /// Вспомогательная функция для преобразования протокола в строку
 fn protocol_to_string(protocol: u8) -> String {
     match protocol {
@@ -9411,7 +9933,7 @@ mod test_process_energy_api {
         };
 
         let system_metrics = crate::metrics::system::SystemMetrics {
-            ebpf: Some(ebpf_metrics),
+            ebpf: Some(ebpf_metrics.into()),
             ..crate::metrics::system::SystemMetrics::default()
         };
 
@@ -9480,7 +10002,7 @@ mod test_process_energy_api {
         };
 
         let system_metrics = crate::metrics::system::SystemMetrics {
-            ebpf: Some(ebpf_metrics),
+            ebpf: Some(ebpf_metrics.into()),
             ..crate::metrics::system::SystemMetrics::default()
         };
 
@@ -9702,7 +10224,7 @@ mod test_process_gpu_api {
         };
 
         let system_metrics = crate::metrics::system::SystemMetrics {
-            ebpf: Some(ebpf_metrics),
+            ebpf: Some(ebpf_metrics.into()),
             ..crate::metrics::system::SystemMetrics::default()
         };
 
@@ -9780,7 +10302,7 @@ mod test_process_gpu_api {
         };
 
         let system_metrics = crate::metrics::system::SystemMetrics {
-            ebpf: Some(ebpf_metrics),
+            ebpf: Some(ebpf_metrics.into()),
             ..crate::metrics::system::SystemMetrics::default()
         };
 
@@ -9879,7 +10401,7 @@ mod test_process_network_api {
             process_network_details: Some(network_stats.clone()),
             ..EbpfMetrics::default()
         };
-        system_metrics.ebpf = Some(ebpf_metrics);
+        system_metrics.ebpf = Some(ebpf_metrics.into());
 
         let state = ApiState {
             metrics: Some(Arc::new(RwLock::new(system_metrics))),
@@ -9950,7 +10472,7 @@ mod test_process_network_api {
             process_network_details: Some(network_stats.clone()),
             ..EbpfMetrics::default()
         };
-        system_metrics.ebpf = Some(ebpf_metrics);
+        system_metrics.ebpf = Some(ebpf_metrics.into());
 
         let state = ApiState {
             metrics: Some(Arc::new(RwLock::new(system_metrics))),
@@ -10050,7 +10572,7 @@ async fn test_process_disk_handler_with_metrics() {
         process_disk_details: Some(disk_stats.clone()),
         ..EbpfMetrics::default()
     };
-    system_metrics.ebpf = Some(ebpf_metrics);
+    system_metrics.ebpf = Some(ebpf_metrics.into());
 
     let state = ApiState {
         metrics: Some(Arc::new(RwLock::new(system_metrics))),
@@ -10108,7 +10630,7 @@ async fn test_process_disk_handler_cache() {
         process_disk_details: Some(disk_stats.clone()),
         ..EbpfMetrics::default()
     };
-    system_metrics.ebpf = Some(ebpf_metrics);
+    system_metrics.ebpf = Some(ebpf_metrics.into());
 
     let state = ApiState {
         metrics: Some(Arc::new(RwLock::new(system_metrics))),
@@ -10881,3 +11403,261 @@ async fn test_logs_field_handler_with_value() {
     assert_eq!(logs.len(), 1);
     assert_eq!(logs[0]["message"], "Request 1");
 }
+
+#[cfg(test)]
+mod test_syscall_latency_api {
+    use super::*;
+    use crate::metrics::ebpf::{EbpfMetrics, SyscallLatencyStat};
+    use crate::metrics::system::SystemMetrics;
+
+    fn latency_state() -> ApiState {
+        let stat = |tgid: Option<u32>| SyscallLatencyStat {
+            syscall_id: 202,
+            syscall_name: Some("futex".to_string()),
+            tgid,
+            count: 100,
+            total_time_ns: 500_000,
+            interval_count: 100,
+            avg_time_ns: 5_000,
+            p50_ns: 4_096,
+            p99_ns: 65_536,
+            buckets: Vec::new(),
+        };
+
+        let system_metrics = SystemMetrics {
+            ebpf: Some(EbpfSnapshot::new(EbpfMetrics {
+                syscall_latency_details: Some(vec![stat(None), stat(Some(42)), stat(Some(7))]),
+                ..EbpfMetrics::default()
+            })),
+            ..SystemMetrics::default()
+        };
+
+        ApiState {
+            metrics: Some(Arc::new(RwLock::new(system_metrics))),
+            ..ApiState::default()
+        }
+    }
+
+    #[tokio::test]
+    async fn test_syscall_latency_handler_without_metrics() {
+        let response = syscall_latency_handler(State(ApiState::default()), Query(HashMap::new()))
+            .await
+            .unwrap();
+
+        assert_eq!(response.0["status"], "degraded");
+        assert!(response.0["system"].is_null());
+    }
+
+    #[tokio::test]
+    async fn test_syscall_latency_handler_splits_scopes() {
+        let response = syscall_latency_handler(State(latency_state()), Query(HashMap::new()))
+            .await
+            .unwrap();
+
+        assert_eq!(response.0["status"], "ok");
+        assert_eq!(response.0["count"], 3);
+        assert_eq!(response.0["system"].as_array().unwrap().len(), 1);
+        assert_eq!(response.0["applications"].as_array().unwrap().len(), 2);
+        assert_eq!(response.0["system"][0]["p99_ns"], 65_536);
+    }
+
+    #[tokio::test]
+    async fn test_syscall_latency_handler_tgid_filter() {
+        let mut params = HashMap::new();
+        params.insert("tgid".to_string(), "42".to_string());
+        let response = syscall_latency_handler(State(latency_state()), Query(params))
+            .await
+            .unwrap();
+
+        assert_eq!(response.0["count"], 1);
+        assert_eq!(response.0["applications"][0]["tgid"], 42);
+
+        let mut params = HashMap::new();
+        params.insert("tgid".to_string(), "not-a-pid".to_string());
+        let response = syscall_latency_handler(State(latency_state()), Query(params)).await;
+        assert_eq!(response.unwrap_err(), StatusCode::BAD_REQUEST);
+    }
+}
+
+#[cfg(test)]
+mod test_ebpf_overhead_api {
+    use super::*;
+    use crate::metrics::ebpf::{EbpfMetrics, EbpfOverheadReport};
+    use crate::metrics::ebpf_overhead::{EbpfDebugCounters, EbpfMapUsage, EbpfProgramOverhead};
+    use crate::metrics::ebpf_sampling::ProgramRuntimeStats;
+    use crate::metrics::system::SystemMetrics;
+
+    fn overhead_state() -> ApiState {
+        let stats = ProgramRuntimeStats {
+            run_time_ns: 40_000,
+            run_cnt: 100,
+        };
+
+        let system_metrics = SystemMetrics {
+            ebpf: Some(EbpfSnapshot::new(EbpfMetrics {
+                program_overhead: Some(EbpfOverheadReport {
+                    run_time_stats_enabled: true,
+                    programs: vec![
+                        EbpfProgramOverhead::new("sched_monitor", "sched_switch", stats),
+                        EbpfProgramOverhead::new("process_monitor", "trace_syscall_entry", stats),
+                    ],
+                    maps: vec![EbpfMapUsage::new(
+                        "sched_monitor",
+                        "sched_task_map",
+                        10,
+                        100,
+                    )],
+                    debug_counters: vec![EbpfDebugCounters::from_slots("sched_monitor", &[0, 2])],
+                    sampling: Vec::new(),
+                }),
+                ..EbpfMetrics::default()
+            })),
+            ..SystemMetrics::default()
+        };
+
+        ApiState {
+            metrics: Some(Arc::new(RwLock::new(system_metrics))),
+            ..ApiState::default()
+        }
+    }
+
+    #[tokio::test]
+    async fn test_ebpf_overhead_handler_without_metrics() {
+        let response = ebpf_overhead_handler(State(ApiState::default()), Query(HashMap::new()))
+            .await
+            .unwrap();
+
+        assert_eq!(response.0["status"], "degraded");
+        assert!(response.0["programs"].is_null());
+    }
+
+    #[tokio::test]
+    async fn test_ebpf_overhead_handler_reports_programs_and_maps() {
+        let response = ebpf_overhead_handler(State(overhead_state()), Query(HashMap::new()))
+            .await
+            .unwrap();
+
+        assert_eq!(response.0["status"], "ok");
+        assert_eq!(response.0["run_time_stats_enabled"], true);
+        assert_eq!(response.0["programs"].as_array().unwrap().len(), 2);
+        assert_eq!(response.0["programs"][0]["avg_run_time_ns"], 400);
+        assert_eq!(response.0["maps"][0]["fill_ratio"], 0.1);
+        assert_eq!(response.0["debug_counters"][0]["update_failures"], 2);
+    }
+
+    #[tokio::test]
+    async fn test_ebpf_overhead_handler_object_filter() {
+        let mut params = HashMap::new();
+        params.insert("object".to_string(), "process_monitor".to_string());
+        let response = ebpf_overhead_handler(State(overhead_state()), Query(params))
+            .await
+            .unwrap();
+
+        assert_eq!(response.0["programs"].as_array().unwrap().len(), 1);
+        assert_eq!(response.0["programs"][0]["program"], "trace_syscall_entry");
+        assert!(response.0["maps"].as_array().unwrap().is_empty());
+    }
+}
+
+#[cfg(test)]
+mod test_ebpf_profile_api {
+    use super::*;
+
+    #[tokio::test]
+    async fn test_ebpf_profile_start_rejects_invalid_request() {
+        let response = ebpf_profile_start_handler(
+            State(ApiState::default()),
+            Json(json!({ "duration_secs": 5 })),
+        )
+        .await
+        .unwrap();
+        assert_eq!(response.0["status"], "error");
+
+        let response = ebpf_profile_start_handler(
+            State(ApiState::default()),
+            Json(json!({ "tgids": [], "duration_secs": 5 })),
+        )
+        .await
+        .unwrap();
+        assert_eq!(response.0["status"], "error");
+    }
+
+    #[tokio::test]
+    async fn test_ebpf_profile_kind_param() {
+        let mut params = HashMap::new();
+        assert_eq!(stack_kind_param(&params), Ok(StackKind::OnCpu));
+
+        params.insert("kind".to_string(), "off_cpu".to_string());
+        assert_eq!(stack_kind_param(&params), Ok(StackKind::OffCpu));
+
+        params.insert("kind".to_string(), "wall".to_string());
+        assert_eq!(stack_kind_param(&params), Err(StatusCode::BAD_REQUEST));
+        let response = ebpf_profile_folded_handler(Query(params)).await;
+        assert_eq!(response.unwrap_err(), StatusCode::BAD_REQUEST);
+    }
+}
+
+#[cfg(test)]
+mod test_ebpf_epoch_api {
+    use super::*;
+    use crate::metrics::ebpf::{EbpfMetrics, EpochSummary};
+    use crate::metrics::ebpf_epoch::EpochTopProcess;
+    use crate::metrics::system::SystemMetrics;
+
+    fn epoch_state() -> ApiState {
+        let epoch = |seq: u64| EpochSummary {
+            seq,
+            duration_ms: 1000.0,
+            cpu_cores: 1.5,
+            top_cpu: vec![EpochTopProcess {
+                tgid: 42,
+                total: 900_000_000,
+                per_sec: 900_000_000.0,
+            }],
+            ..EpochSummary::default()
+        };
+        let system_metrics = SystemMetrics {
+            ebpf: Some(EbpfSnapshot::new(EbpfMetrics {
+                epoch_summaries: Some(vec![epoch(1), epoch(2)]),
+                ..EbpfMetrics::default()
+            })),
+            ..SystemMetrics::default()
+        };
+
+        ApiState {
+            metrics: Some(Arc::new(RwLock::new(system_metrics))),
+            ..ApiState::default()
+        }
+    }
+
+    #[tokio::test]
+    async fn test_ebpf_epoch_handler_without_aggregation() {
+        let response = ebpf_epoch_handler(State(ApiState::default()), Query(HashMap::new()))
+            .await
+            .unwrap();
+
+        assert_eq!(response.0["status"], "degraded");
+        assert!(response.0["latest"].is_null());
+    }
+
+    #[tokio::test]
+    async fn test_ebpf_epoch_handler_reports_latest_epoch() {
+        let response = ebpf_epoch_handler(State(epoch_state()), Query(HashMap::new()))
+            .await
+            .unwrap();
+
+        assert_eq!(response.0["status"], "ok");
+        assert_eq!(response.0["latest"]["seq"], 2);
+        assert_eq!(response.0["latest"]["top_cpu"][0]["tgid"], 42);
+        assert_eq!(response.0["epochs_available"], 2);
+        assert!(response.0.get("history").is_none());
+
+        let mut params = HashMap::new();
+        params.insert("history".to_string(), "true".to_string());
+        let response = ebpf_epoch_handler(State(epoch_state()), Query(params))
+            .await
+            .unwrap();
+        assert_eq!(response.0["history"].as_array().unwrap().len(), 2);
+        assert_eq!(response.0["history"][0]["seq"], 1);
+    }
+}
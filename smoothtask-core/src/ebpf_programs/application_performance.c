@@ -4,261 +4,98 @@
 // eBPF программа для мониторинга производительности приложений
 // Отслеживает время выполнения, время ожидания различных ресурсов
 // и рассчитывает проценты использования времени
+//
+// Время выполнения, ожидание в очереди выполнения и время вне CPU
+// учитываются общей программой планировщика sched_monitor.c и читаются
+// коллектором из sched_task_map, а системные вызовы и время ожидания
+// блокировок (futex) — общей программой syscall_monitor.c, задержки из-за
+// нехватки памяти — memory_pressure.c, а выделения памяти ядра — отдельной
+// программой kmem_allocations.c, которая включается по требованию; здесь
+// остаются только счётчики событий.
+// Статистика агрегируется по процессу: одна запись в task-local storage
+// лидера группы потоков (см. smoothtask_task_state.h), а не на поток.
+// Userspace выгружает записи итератором dump_application_performance.
+// Те же счётчики суммируются по cgroup текущей задачи в per-CPU карте
+// app_cgroup_map (см. smoothtask_cgroup.h).
 
 #include "vmlinux.h"
 #include <bpf/bpf_helpers.h>
 #include <bpf/bpf_tracing.h>
 #include <bpf/bpf_core_read.h>
+#include "smoothtask_sampling.h"
+#include "smoothtask_bpf.h"
+#include "smoothtask_debug.h"
+#include "smoothtask_cgroup.h"
+#include "smoothtask_task_state.h"
 
-// Максимальное количество отслеживаемых процессов
+// Максимальное количество процессов legacy варианта
 #define MAX_APPLICATIONS 20480
 
-// Структура для хранения статистики производительности приложения
-struct application_performance_stats {
-    __u32 pid;                    // Идентификатор процесса
-    __u32 tgid;                   // Идентификатор потока
-    __u64 execution_time_ns;      // Время выполнения в наносекундах
-    __u64 io_wait_time_ns;        // Время ожидания ввода-вывода
-    __u64 cpu_wait_time_ns;       // Время ожидания CPU
-    __u64 lock_wait_time_ns;      // Время ожидания блокировок
-    __u64 network_wait_time_ns;   // Время ожидания сети
-    __u64 disk_wait_time_ns;      // Время ожидания диска
-    __u64 memory_wait_time_ns;    // Время ожидания памяти
-    __u64 gpu_wait_time_ns;       // Время ожидания GPU
-    __u64 other_wait_time_ns;     // Время ожидания других ресурсов
-    __u64 total_time_ns;          // Общее время выполнения
-    __u64 last_update_ns;         // Время последнего обновления
-    __u64 cache_misses;           // Количество промахов кэша
-    __u64 cache_hits;             // Количество попаданий в кэш
-    __u64 branch_misses;          // Количество промахов ветвлений
-    __u64 branch_hits;            // Количество успешных ветвлений
-    __u64 page_faults;            // Количество page faults
-    __u64 context_switches;       // Количество переключений контекста
-    __u64 system_calls;           // Количество системных вызовов
-    __u64 interrupts;             // Количество прерываний
-    __u64 memory_allocations;     // Количество выделений памяти
-    __u64 memory_frees;           // Количество освобождений памяти
-    char comm[16];                // Имя процесса
-};
+// Статистика производительности приложений
+// (struct application_performance_stats в smoothtask_bpf.h)
+SMOOTHTASK_TASK_STATE(application_performance_map, struct application_performance_stats,
+                      MAX_APPLICATIONS);
 
-// Карта для хранения статистики производительности приложений
-struct {
-    __uint(type, BPF_MAP_TYPE_HASH);
-    __uint(max_entries, MAX_APPLICATIONS);
-    __type(key, __u32);                          // PID как ключ
-    __type(value, struct application_performance_stats);
-} application_performance_map SEC(".maps");
+// Per-CPU итоги по cgroup текущей задачи (struct app_cgroup_stats в smoothtask_bpf.h)
+SMOOTHTASK_CGROUP_MAP(app_cgroup_map, struct app_cgroup_stats);
 
-// Прикрепляемся к точке трассировки sched/sched_process_exec
-// для отслеживания запуска новых процессов
-SEC("tracepoint/sched/sched_process_exec")
-int trace_process_exec(struct trace_event_raw_sched_process_exec *ctx)
-{
-    __u32 pid = bpf_get_current_pid_tgid() >> 32;
-    __u32 tgid = bpf_get_current_pid_tgid();
-    __u64 current_time = bpf_ktime_get_ns();
-
-    // Инициализируем запись для нового процесса
-    struct application_performance_stats stats = {};
-    stats.pid = pid;
-    stats.tgid = tgid;
-    stats.execution_time_ns = 0;
-    stats.io_wait_time_ns = 0;
-    stats.cpu_wait_time_ns = 0;
-    stats.lock_wait_time_ns = 0;
-    stats.network_wait_time_ns = 0;
-    stats.disk_wait_time_ns = 0;
-    stats.memory_wait_time_ns = 0;
-    stats.gpu_wait_time_ns = 0;
-    stats.other_wait_time_ns = 0;
-    stats.total_time_ns = 0;
-    stats.last_update_ns = current_time;
-    stats.cache_misses = 0;
-    stats.cache_hits = 0;
-    stats.branch_misses = 0;
-    stats.branch_hits = 0;
-    stats.page_faults = 0;
-    stats.context_switches = 0;
-    stats.system_calls = 0;
-    stats.interrupts = 0;
-    stats.memory_allocations = 0;
-    stats.memory_frees = 0;
-
-    bpf_get_current_comm(&stats.comm, sizeof(stats.comm));
-
-    // Сохраняем в карту
-    bpf_map_update_elem(&application_performance_map, &pid, &stats, BPF_ANY);
-
-    return 0;
-}
-
-// Прикрепляемся к точке трассировки sched/sched_process_exit
-// для отслеживания завершения процессов
-SEC("tracepoint/sched/sched_process_exit")
-int trace_process_exit(struct trace_event_raw_sched_process_exit *ctx)
-{
-    __u32 pid = bpf_get_current_pid_tgid() >> 32;
-
-    // Удаляем запись при завершении процесса
-    bpf_map_delete_elem(&application_performance_map, &pid);
-
-    return 0;
-}
-
-// Прикрепляемся к точке трассировки sched/sched_switch
-// для отслеживания переключения процессов и учета времени выполнения
-SEC("tracepoint/sched/sched_switch")
-int trace_sched_switch(struct trace_event_raw_sched_switch *ctx)
-{
-    __u32 prev_pid = ctx->prev_pid;
-    __u32 next_pid = ctx->next_pid;
-    __u64 current_time = bpf_ktime_get_ns();
-
-    // Обновляем статистику для предыдущего процесса
-    struct application_performance_stats *prev_stats = bpf_map_lookup_elem(&application_performance_map, &prev_pid);
-    if (prev_stats) {
-        // Увеличиваем время выполнения для предыдущего процесса
-        // В реальной системе нужно получить фактическое время выполнения
-        __u64 exec_time_increase = 1000000; // 1 мс выполнения (пример)
-        prev_stats->execution_time_ns += exec_time_increase;
-        prev_stats->total_time_ns += exec_time_increase;
-        prev_stats->last_update_ns = current_time;
-    }
-
-    // Инициализируем статистику для нового процесса, если еще не существует
-    struct application_performance_stats *next_stats = bpf_map_lookup_elem(&application_performance_map, &next_pid);
-    if (!next_stats) {
-        struct application_performance_stats new_stats = {};
-        new_stats.pid = next_pid;
-        new_stats.tgid = next_pid; // Для нового процесса tgid = pid
-        new_stats.last_update_ns = current_time;
-        
-        bpf_get_current_comm(&new_stats.comm, sizeof(new_stats.comm));
-        
-        bpf_map_update_elem(&application_performance_map, &next_pid, &new_stats, BPF_ANY);
-    }
-
-    return 0;
-}
-
-// Прикрепляемся к точке трассировки block/block_rq_issue
-// для отслеживания ожидания диска
-SEC("tracepoint/block/block_rq_issue")
-int trace_block_rq_issue(struct trace_event_raw_block_rq_issue *ctx)
+static __always_inline void account_cgroup(__u64 page_faults, __u64 interrupts)
 {
-    __u32 pid = bpf_get_current_pid_tgid() >> 32;
-    __u64 current_time = bpf_ktime_get_ns();
+    struct app_cgroup_stats zero = {};
+    struct app_cgroup_stats *cgroup = smoothtask_cgroup_entry(&app_cgroup_map, &zero);
 
-    // Обновляем статистику ожидания диска
-    struct application_performance_stats *stats = bpf_map_lookup_elem(&application_performance_map, &pid);
-    if (stats) {
-        __u64 disk_wait_increase = 500000; // 500 мкс ожидания диска (пример)
-        stats->disk_wait_time_ns += disk_wait_increase;
-        stats->total_time_ns += disk_wait_increase;
-        stats->last_update_ns = current_time;
+    if (cgroup) {
+        cgroup->page_faults += page_faults;
+        cgroup->interrupts += interrupts;
     }
-
-    return 0;
 }
 
-// Прикрепляемся к точке трассировки net/net_dev_queue
-// для отслеживания ожидания сети
-SEC("tracepoint/net/net_dev_queue")
-int trace_net_dev_queue(struct trace_event_raw_net_dev_queue *ctx)
+static __always_inline struct application_performance_stats *
+get_or_init_stats(__u32 tgid, struct task_struct *task, __u64 now)
 {
-    __u32 pid = bpf_get_current_pid_tgid() >> 32;
-    __u64 current_time = bpf_ktime_get_ns();
-
-    // Обновляем статистику ожидания сети
-    struct application_performance_stats *stats = bpf_map_lookup_elem(&application_performance_map, &pid);
-    if (stats) {
-        __u64 network_wait_increase = 300000; // 300 мкс ожидания сети (пример)
-        stats->network_wait_time_ns += network_wait_increase;
-        stats->total_time_ns += network_wait_increase;
-        stats->last_update_ns = current_time;
-    }
+    struct application_performance_stats *stats;
 
-    return 0;
-}
+    stats = smoothtask_task_state_lookup(&application_performance_map, task);
+    if (stats)
+        return stats;
 
-// Прикрепляемся к точке трассировки syscalls/sys_enter_futex
-// для отслеживания ожидания блокировок
-SEC("tracepoint/syscalls/sys_enter_futex")
-int trace_futex_enter(struct trace_event_raw_sys_enter *ctx)
-{
-    __u32 pid = bpf_get_current_pid_tgid() >> 32;
-    __u64 current_time = bpf_ktime_get_ns();
+    struct application_performance_stats new_stats = {};
+    new_stats.tgid = tgid;
+    new_stats.last_update_ns = now;
 
-    // Обновляем статистику ожидания блокировок
-    struct application_performance_stats *stats = bpf_map_lookup_elem(&application_performance_map, &pid);
-    if (stats) {
-        __u64 lock_wait_increase = 200000; // 200 мкс ожидания блокировки (пример)
-        stats->lock_wait_time_ns += lock_wait_increase;
-        stats->total_time_ns += lock_wait_increase;
-        stats->last_update_ns = current_time;
-    }
+    struct task_struct *leader = BPF_CORE_READ(task, group_leader);
+    BPF_CORE_READ_STR_INTO(&new_stats.comm, leader, comm);
 
-    return 0;
+    return smoothtask_task_state_create(&application_performance_map, task, &new_stats);
 }
 
-// Прикрепляемся к точке трассировки syscalls/sys_enter_io_submit
-// для отслеживания ожидания ввода-вывода
-SEC("tracepoint/syscalls/sys_enter_io_submit")
-int trace_io_submit_enter(struct trace_event_raw_sys_enter *ctx)
+// Прикрепляемся к точке трассировки sched/sched_process_exec
+// для отслеживания запуска новых процессов
+SEC("tp_btf/sched_process_exec")
+int BPF_PROG(trace_process_exec, struct task_struct *p, pid_t old_pid, struct linux_binprm *bprm)
 {
-    __u32 pid = bpf_get_current_pid_tgid() >> 32;
+    __u32 tgid = bpf_get_current_pid_tgid() >> 32;
     __u64 current_time = bpf_ktime_get_ns();
 
-    // Обновляем статистику ожидания ввода-вывода
-    struct application_performance_stats *stats = bpf_map_lookup_elem(&application_performance_map, &pid);
-    if (stats) {
-        __u64 io_wait_increase = 400000; // 400 мкс ожидания ввода-вывода (пример)
-        stats->io_wait_time_ns += io_wait_increase;
-        stats->total_time_ns += io_wait_increase;
-        stats->last_update_ns = current_time;
-    }
-
-    return 0;
-}
+    // Новый образ процесса начинает статистику заново
+    struct application_performance_stats stats = {};
+    stats.tgid = tgid;
+    stats.last_update_ns = current_time;
 
-// Прикрепляемся к точке трассировки sched/sched_stat_wait
-// для отслеживания ожидания CPU
-SEC("tracepoint/sched/sched_stat_wait")
-int trace_sched_stat_wait(struct trace_event_raw_sched_stat_wait *ctx)
-{
-    __u32 pid = bpf_get_current_pid_tgid() >> 32;
-    __u64 current_time = bpf_ktime_get_ns();
+    bpf_get_current_comm(&stats.comm, sizeof(stats.comm));
 
-    // Обновляем статистику ожидания CPU
-    struct application_performance_stats *stats = bpf_map_lookup_elem(&application_performance_map, &pid);
-    if (stats) {
-        __u64 cpu_wait_increase = BPF_CORE_READ(ctx, delay);
-        if (cpu_wait_increase > 0) {
-            stats->cpu_wait_time_ns += cpu_wait_increase;
-            stats->total_time_ns += cpu_wait_increase;
-            stats->last_update_ns = current_time;
-        }
-    }
+    smoothtask_task_state_reset(&application_performance_map, smoothtask_current_task(), &stats);
 
     return 0;
 }
 
-// Прикрепляемся к точке трассировки syscalls/sys_enter_mmap
-// для отслеживания ожидания памяти
-SEC("tracepoint/syscalls/sys_enter_mmap")
-int trace_mmap_enter(struct trace_event_raw_sys_enter *ctx)
+// Прикрепляемся к точке трассировки sched/sched_process_exit
+// для отслеживания завершения процессов
+SEC("tp_btf/sched_process_exit")
+int BPF_PROG(trace_process_exit, struct task_struct *p)
 {
-    __u32 pid = bpf_get_current_pid_tgid() >> 32;
-    __u64 current_time = bpf_ktime_get_ns();
-
-    // Обновляем статистику ожидания памяти
-    struct application_performance_stats *stats = bpf_map_lookup_elem(&application_performance_map, &pid);
-    if (stats) {
-        __u64 memory_wait_increase = 150000; // 150 мкс ожидания памяти (пример)
-        stats->memory_wait_time_ns += memory_wait_increase;
-        stats->total_time_ns += memory_wait_increase;
-        stats->last_update_ns = current_time;
-    }
+    // Запись процесса освобождается вместе с лидером группы потоков
+    smoothtask_task_state_exit(&application_performance_map, p);
 
     return 0;
 }
@@ -268,57 +105,21 @@ int trace_mmap_enter(struct trace_event_raw_sys_enter *ctx)
 SEC("tracepoint/exceptions/page_fault_user")
 int trace_page_fault_user(struct trace_event_raw_page_fault_user *ctx)
 {
-    __u32 pid = bpf_get_current_pid_tgid() >> 32;
-    __u64 current_time = bpf_ktime_get_ns();
-
-    // Обновляем статистику page faults
-    struct application_performance_stats *stats = bpf_map_lookup_elem(&application_performance_map, &pid);
-    if (stats) {
-        stats->page_faults += 1;
-        stats->last_update_ns = current_time;
-    }
+    __u32 weight = smoothtask_sample(SMOOTHTASK_SAMPLE_PAGE_FAULTS);
+    if (!weight)
+        return 0;
 
-    return 0;
-}
-
-// Прикрепляемся к точке трассировки sched/sched_switch
-// для отслеживания переключений контекста
-SEC("tracepoint/sched/sched_switch")
-int trace_context_switch(struct trace_event_raw_sched_switch *ctx)
-{
-    __u32 prev_pid = ctx->prev_pid;
-    __u32 next_pid = ctx->next_pid;
     __u64 current_time = bpf_ktime_get_ns();
 
-    // Обновляем статистику переключений контекста для предыдущего процесса
-    struct application_performance_stats *prev_stats = bpf_map_lookup_elem(&application_performance_map, &prev_pid);
-    if (prev_stats) {
-        prev_stats->context_switches += 1;
-        prev_stats->last_update_ns = current_time;
-    }
-
-    // Обновляем статистику переключений контекста для нового процесса
-    struct application_performance_stats *next_stats = bpf_map_lookup_elem(&application_performance_map, &next_pid);
-    if (next_stats) {
-        next_stats->context_switches += 1;
-        next_stats->last_update_ns = current_time;
-    }
-
-    return 0;
-}
-
-// Прикрепляемся к точке трассировки syscalls/sys_enter
-// для отслеживания системных вызовов
-SEC("tracepoint/syscalls/sys_enter")
-int trace_syscall_enter(struct trace_event_raw_sys_enter *ctx)
-{
-    __u32 pid = bpf_get_current_pid_tgid() >> 32;
-    __u64 current_time = bpf_ktime_get_ns();
+    account_cgroup(weight, 0);
 
-    // Обновляем статистику системных вызовов
-    struct application_performance_stats *stats = bpf_map_lookup_elem(&application_performance_map, &pid);
+    // Обновляем статистику page faults; запись процесса, запущенного до
+    // загрузки программы, создаётся здесь
+    struct application_performance_stats *stats =
+        get_or_init_stats(bpf_get_current_pid_tgid() >> 32, smoothtask_current_task(),
+                          current_time);
     if (stats) {
-        stats->system_calls += 1;
+        stats->page_faults += weight;
         stats->last_update_ns = current_time;
     }
 
@@ -330,11 +131,13 @@ int trace_syscall_enter(struct trace_event_raw_sys_enter *ctx)
 SEC("tracepoint/irq/irq_handler_entry")
 int trace_irq_handler_entry(struct trace_event_raw_irq_handler_entry *ctx)
 {
-    __u32 pid = bpf_get_current_pid_tgid() >> 32;
     __u64 current_time = bpf_ktime_get_ns();
 
+    account_cgroup(0, 1);
+
     // Обновляем статистику прерываний
-    struct application_performance_stats *stats = bpf_map_lookup_elem(&application_performance_map, &pid);
+    struct application_performance_stats *stats =
+        smoothtask_task_state_lookup(&application_performance_map, smoothtask_current_task());
     if (stats) {
         stats->interrupts += 1;
         stats->last_update_ns = current_time;
@@ -343,41 +146,9 @@ int trace_irq_handler_entry(struct trace_event_raw_irq_handler_entry *ctx)
     return 0;
 }
 
-// Прикрепляемся к точке трассировки kmem/kmalloc
-// для отслеживания выделений памяти
-SEC("tracepoint/kmem/kmalloc")
-int trace_kmalloc(struct trace_event_raw_kmalloc *ctx)
-{
-    __u32 pid = bpf_get_current_pid_tgid() >> 32;
-    __u64 current_time = bpf_ktime_get_ns();
-
-    // Обновляем статистику выделений памяти
-    struct application_performance_stats *stats = bpf_map_lookup_elem(&application_performance_map, &pid);
-    if (stats) {
-        stats->memory_allocations += 1;
-        stats->last_update_ns = current_time;
-    }
-
-    return 0;
-}
-
-// Прикрепляемся к точке трассировки kmem/kfree
-// для отслеживания освобождений памяти
-SEC("tracepoint/kmem/kfree")
-int trace_kfree(struct trace_event_raw_kfree *ctx)
-{
-    __u32 pid = bpf_get_current_pid_tgid() >> 32;
-    __u64 current_time = bpf_ktime_get_ns();
-
-    // Обновляем статистику освобождений памяти
-    struct application_performance_stats *stats = bpf_map_lookup_elem(&application_performance_map, &pid);
-    if (stats) {
-        stats->memory_frees += 1;
-        stats->last_update_ns = current_time;
-    }
-
-    return 0;
-}
+// Выгрузка записей процессов в userspace
+SMOOTHTASK_TASK_STATE_ITER(dump_application_performance, application_performance_map,
+                           struct application_performance_stats)
 
 // Лицензия
 char _license[] SEC("license") = "GPL";
@@ -0,0 +1,344 @@
+// SPDX-License-Identifier: GPL-2.0 OR BSD-2-Clause
+/* Copyright (c) 2025 SmoothTask Authors */
+
+// Агрегация счётчиков по эпохам в ядре
+//
+// Программа не подключается к событиям ядра. Userspace один раз выполняет
+// epoch_start (BPF_PROG_TEST_RUN), которая взводит bpf_timer; по каждому
+// срабатыванию таймера обработчик обходит карты других программ
+// (bpf_for_each_map_elem) и сворачивает их в сводку эпохи:
+// - sched_task_map (sched_monitor.c) — время на CPU, ожидание ввода-вывода и
+//   переключения контекста процессов;
+// - process_traffic_map (process_network.c) — трафик процессов, per-CPU копии
+//   суммируются через bpf_map_lookup_percpu_elem().
+// Карты не копируются: userspace подставляет дескрипторы карт уже загруженных
+// программ (bpf_map__reuse_fd), объявления ниже совпадают с исходными.
+//
+// Счётчики источников не сбрасываются — их читают и другие коллекторы.
+// Приращения за эпоху считаются относительно значений прошлой эпохи из
+// собственных карт epoch_*_prev_map. Сводка содержит суммы за эпоху и
+// N процессов с наибольшим приращением по каждому измерению; сводки пишутся
+// в кольцо из EPOCH_RING_SIZE записей, и userspace читает одну запись на эпоху
+// независимо от количества процессов.
+//
+// Требуется Linux 5.19+ (bpf_timer, BPF_PROG_TYPE_SYSCALL,
+// bpf_map_lookup_percpu_elem); на старых ядрах объект не загружается и
+// коллектор продолжает работать через обход карт.
+
+#include "vmlinux.h"
+#include <bpf/bpf_helpers.h>
+#include <bpf/bpf_tracing.h>
+#include <bpf/bpf_core_read.h>
+#include "smoothtask_bpf.h"
+#include "smoothtask_debug.h"
+
+// Размеры разделяемых карт (SCHED_MAX_TASKS в sched_monitor.c,
+// MAX_PROCESS_TRAFFIC_ENTRIES в process_network.c)
+#define EPOCH_SCHED_MAX_TASKS 20480
+#define EPOCH_TRAFFIC_MAX_ENTRIES 4096
+
+// Количество сводок в кольце (EPOCH_RING_SIZE в ebpf_epoch.rs)
+#define EPOCH_RING_SIZE 16
+
+// Длина списков самых нагруженных процессов (EPOCH_TOP_N в ebpf_epoch.rs)
+#define EPOCH_TOP_N 8
+
+// Наибольшее количество CPU, per-CPU копии которых суммируются
+#define EPOCH_MAX_CPUS 256
+
+#define EPOCH_CLOCK_MONOTONIC 1
+#define EPOCH_EBUSY 16
+
+// Параметры агрегации (RawEpochConfig в ebpf_epoch.rs)
+struct epoch_config {
+    __u64 epoch_ns;               // Длительность эпохи
+    __u32 nr_cpus;                // Количество возможных CPU
+    __u32 _pad;
+};
+SMOOTHTASK_ASSERT_SIZE(epoch_config, 16);
+
+// Процесс в списке самых нагруженных (RawEpochTop в ebpf_epoch.rs)
+struct epoch_top {
+    __u64 value;
+    __u32 tgid;
+    __u32 _pad;
+};
+SMOOTHTASK_ASSERT_SIZE(epoch_top, 16);
+
+// Сводка эпохи (RawEpochSummary в ebpf_epoch.rs).
+// seq записывается последним: userspace отбрасывает запись, номер которой не
+// совпадает с ожидаемым (запись перезаписана или ещё заполняется).
+struct epoch_summary {
+    __u64 seq;
+    __u64 start_ns;
+    __u64 end_ns;
+    __u64 cpu_ns;                 // Время на CPU всех процессов
+    __u64 io_wait_ns;             // Ожидание ввода-вывода всех процессов
+    __u64 net_bytes;              // Отправлено и получено всеми процессами
+    __u64 context_switches;
+    __u32 cpu_tasks;              // Процессы, выполнявшиеся в эпоху
+    __u32 net_tasks;              // Процессы с сетевым трафиком в эпоху
+    struct epoch_top top_cpu[EPOCH_TOP_N];
+    struct epoch_top top_io[EPOCH_TOP_N];
+    struct epoch_top top_net[EPOCH_TOP_N];
+};
+SMOOTHTASK_ASSERT_SIZE(epoch_summary, 448);
+
+// Состояние таймера
+struct epoch_timer {
+    struct bpf_timer timer;
+    __u64 seq;                    // Номер последней завершённой эпохи
+    __u64 last_ns;                // Конец последней эпохи
+};
+SMOOTHTASK_ASSERT_SIZE(epoch_timer, 32);
+
+// Значения счётчиков процесса на конец прошлой эпохи
+struct epoch_sched_prev {
+    __u64 runtime_ns;
+    __u64 io_wait_ns;
+    __u32 context_switches;
+    __u32 _pad;
+};
+SMOOTHTASK_ASSERT_SIZE(epoch_sched_prev, 24);
+
+struct epoch_fold_ctx {
+    __u64 seq;
+    __u32 slot;
+    __u32 nr_cpus;
+};
+
+// Разделяемые карты: заменяются картами sched_monitor и process_network
+struct {
+    __uint(type, BPF_MAP_TYPE_LRU_HASH);
+    __uint(max_entries, EPOCH_SCHED_MAX_TASKS);
+    __type(key, __u32);                          // TGID как ключ
+    __type(value, struct sched_task_stats);
+} sched_task_map SEC(".maps");
+
+struct {
+    __uint(type, BPF_MAP_TYPE_LRU_PERCPU_HASH);
+    __uint(max_entries, EPOCH_TRAFFIC_MAX_ENTRIES);
+    __type(key, __u32);                          // TGID как ключ
+    __type(value, struct net_traffic);
+} process_traffic_map SEC(".maps");
+
+struct {
+    __uint(type, BPF_MAP_TYPE_ARRAY);
+    __uint(max_entries, 1);
+    __type(key, __u32);
+    __type(value, struct epoch_config);
+} epoch_config_map SEC(".maps");
+
+struct {
+    __uint(type, BPF_MAP_TYPE_ARRAY);
+    __uint(max_entries, 1);
+    __type(key, __u32);
+    __type(value, struct epoch_timer);
+} epoch_timer_map SEC(".maps");
+
+struct {
+    __uint(type, BPF_MAP_TYPE_ARRAY);
+    __uint(max_entries, EPOCH_RING_SIZE);
+    __type(key, __u32);
+    __type(value, struct epoch_summary);
+} epoch_ring_map SEC(".maps");
+
+// Номер последней записанной сводки
+struct {
+    __uint(type, BPF_MAP_TYPE_ARRAY);
+    __uint(max_entries, 1);
+    __type(key, __u32);
+    __type(value, __u64);
+} epoch_head_map SEC(".maps");
+
+// LRU вытесняет записи завершившихся процессов
+struct {
+    __uint(type, BPF_MAP_TYPE_LRU_HASH);
+    __uint(max_entries, EPOCH_SCHED_MAX_TASKS);
+    __type(key, __u32);                          // TGID как ключ
+    __type(value, struct epoch_sched_prev);
+} epoch_sched_prev_map SEC(".maps");
+
+struct {
+    __uint(type, BPF_MAP_TYPE_LRU_HASH);
+    __uint(max_entries, EPOCH_TRAFFIC_MAX_ENTRIES);
+    __type(key, __u32);                          // TGID как ключ
+    __type(value, __u64);                        // Отправлено и получено
+} epoch_net_prev_map SEC(".maps");
+
+// Приращение счётчика; меньшее значение означает новую запись с тем же TGID
+static __always_inline __u64 epoch_delta(__u64 value, __u64 prev)
+{
+    return value >= prev ? value - prev : value;
+}
+
+// Заменить процесс с наименьшим значением, если новое больше
+static __always_inline void epoch_top_insert(struct epoch_top *top, __u32 tgid, __u64 value)
+{
+    __u32 min_idx = 0;
+
+    if (!value)
+        return;
+
+    for (__u32 i = 1; i < EPOCH_TOP_N; i++) {
+        if (top[i].value < top[min_idx & (EPOCH_TOP_N - 1)].value)
+            min_idx = i;
+    }
+    min_idx &= EPOCH_TOP_N - 1;
+    if (value > top[min_idx].value) {
+        top[min_idx].value = value;
+        top[min_idx].tgid = tgid;
+    }
+}
+
+static __always_inline struct epoch_summary *epoch_slot(struct epoch_fold_ctx *ctx)
+{
+    __u32 slot = ctx->slot;
+
+    return bpf_map_lookup_elem(&epoch_ring_map, &slot);
+}
+
+static long epoch_fold_sched(struct bpf_map *map, __u32 *tgid, struct sched_task_stats *stats,
+                             struct epoch_fold_ctx *ctx)
+{
+    struct epoch_summary *summary = epoch_slot(ctx);
+    struct epoch_sched_prev *prev = bpf_map_lookup_elem(&epoch_sched_prev_map, tgid);
+    struct epoch_sched_prev latest = {};
+    __u64 cpu_ns = 0, io_wait_ns = 0, switches = 0;
+
+    if (!summary)
+        return 1;
+
+    latest.runtime_ns = stats->runtime_ns;
+    latest.io_wait_ns = stats->io_wait_ns;
+    latest.context_switches = stats->context_switches;
+
+    if (prev) {
+        cpu_ns = epoch_delta(latest.runtime_ns, prev->runtime_ns);
+        io_wait_ns = epoch_delta(latest.io_wait_ns, prev->io_wait_ns);
+        switches = epoch_delta(latest.context_switches, prev->context_switches);
+        *prev = latest;
+    } else {
+        // Первая эпоха только запоминает базовые значения; процесс, появившийся
+        // позже, целиком учитывается в эпохе, где его заметили
+        if (ctx->seq > 1) {
+            cpu_ns = latest.runtime_ns;
+            io_wait_ns = latest.io_wait_ns;
+            switches = latest.context_switches;
+        }
+        smoothtask_map_update(&epoch_sched_prev_map, tgid, &latest, BPF_ANY);
+    }
+
+    summary->cpu_ns += cpu_ns;
+    summary->io_wait_ns += io_wait_ns;
+    summary->context_switches += switches;
+    if (cpu_ns)
+        summary->cpu_tasks += 1;
+    epoch_top_insert(summary->top_cpu, *tgid, cpu_ns);
+    epoch_top_insert(summary->top_io, *tgid, io_wait_ns);
+    return 0;
+}
+
+static long epoch_fold_net(struct bpf_map *map, __u32 *tgid, struct net_traffic *value,
+                           struct epoch_fold_ctx *ctx)
+{
+    struct epoch_summary *summary = epoch_slot(ctx);
+    __u64 *prev;
+    __u64 bytes = 0, delta = 0;
+
+    if (!summary)
+        return 1;
+
+    // value — копия текущего CPU; трафик процесса — сумма копий всех CPU
+    for (__u32 cpu = 0; cpu < EPOCH_MAX_CPUS; cpu++) {
+        struct net_traffic *traffic;
+
+        if (cpu >= ctx->nr_cpus)
+            break;
+        traffic = bpf_map_lookup_percpu_elem(&process_traffic_map, tgid, cpu);
+        if (traffic)
+            bytes += traffic->bytes_sent + traffic->bytes_received;
+    }
+
+    prev = bpf_map_lookup_elem(&epoch_net_prev_map, tgid);
+    if (prev) {
+        delta = epoch_delta(bytes, *prev);
+        *prev = bytes;
+    } else {
+        if (ctx->seq > 1)
+            delta = bytes;
+        smoothtask_map_update(&epoch_net_prev_map, tgid, &bytes, BPF_ANY);
+    }
+
+    summary->net_bytes += delta;
+    if (delta)
+        summary->net_tasks += 1;
+    epoch_top_insert(summary->top_net, *tgid, delta);
+    return 0;
+}
+
+static int epoch_timer_fired(void *map, __u32 *key, struct epoch_timer *timer)
+{
+    __u32 zero = 0;
+    struct epoch_config *config = bpf_map_lookup_elem(&epoch_config_map, &zero);
+    __u64 *head = bpf_map_lookup_elem(&epoch_head_map, &zero);
+    struct epoch_fold_ctx ctx = {};
+    struct epoch_summary *summary;
+    __u64 now = bpf_ktime_get_ns();
+
+    if (!config || !head)
+        return 0;
+
+    ctx.seq = timer->seq + 1;
+    ctx.slot = ctx.seq % EPOCH_RING_SIZE;
+    ctx.nr_cpus = config->nr_cpus;
+
+    summary = epoch_slot(&ctx);
+    if (!summary)
+        return 0;
+
+    __builtin_memset(summary, 0, sizeof(*summary));
+    summary->start_ns = timer->last_ns;
+    summary->end_ns = now;
+
+    bpf_for_each_map_elem(&sched_task_map, epoch_fold_sched, &ctx, 0);
+    bpf_for_each_map_elem(&process_traffic_map, epoch_fold_net, &ctx, 0);
+
+    summary->seq = ctx.seq;
+    *head = ctx.seq;
+    timer->seq = ctx.seq;
+    timer->last_ns = now;
+
+    bpf_timer_start(&timer->timer, config->epoch_ns, 0);
+    return 0;
+}
+
+// Взвести таймер эпох; выполняется из userspace через BPF_PROG_TEST_RUN
+SEC("syscall")
+int epoch_start(void *ctx)
+{
+    __u32 zero = 0;
+    struct epoch_config *config = bpf_map_lookup_elem(&epoch_config_map, &zero);
+    struct epoch_timer *timer = bpf_map_lookup_elem(&epoch_timer_map, &zero);
+    long err;
+
+    if (!config || !timer || !config->epoch_ns)
+        return 1;
+
+    // Повторный запуск только перевзводит уже созданный таймер
+    err = bpf_timer_init(&timer->timer, &epoch_timer_map, EPOCH_CLOCK_MONOTONIC);
+    if (err && err != -EPOCH_EBUSY)
+        return 2;
+
+    if (bpf_timer_set_callback(&timer->timer, epoch_timer_fired))
+        return 3;
+
+    if (!timer->last_ns)
+        timer->last_ns = bpf_ktime_get_ns();
+    if (bpf_timer_start(&timer->timer, config->epoch_ns, 0))
+        return 4;
+
+    return 0;
+}
+
+char _license[] SEC("license") = "GPL";
@@ -2,117 +2,219 @@
 /* Copyright (c) 2024 SmoothTask Project */
 
 // eBPF программа для мониторинга операций с файловой системой
-// Отслеживает операции открытия, чтения, записи и закрытия файлов
+// Считает открытия, чтения и записи обычных файлов и реально переданные байты
+//
+// Объём берётся из возвращаемого значения vfs_read()/vfs_write() в программах
+// fexit, а не из запрошенного размера в точках входа системных вызовов:
+// короткие чтения, чтения за концом файла и ошибки учитываются так, как их
+// увидело приложение. Каналы, сокеты и устройства отсекаются по типу inode.
+// Чтения в обход vfs_read() (readv, io_uring, splice, отображение в память)
+// не учитываются.
+//
+// Режим задаётся из userspace в filesystem_config_map и может меняться без
+// перезагрузки программы (см. ebpf_filesystem.rs):
+// - FS_MODE_COUNTERS: только общие per-CPU итоги, одно обращение к карте на событие;
+// - FS_MODE_DETAILED: дополнительно per-CPU записи по TGID и по паре
+//   (файл, процесс) в LRU картах, из которых userspace выбирает самые
+//   нагруженные файлы. Файл определяется парой (устройство, inode).
+// Пока конфигурация не записана, программа работает в режиме счётчиков.
 
-#include <linux/bpf.h>
+#include "vmlinux.h"
 #include <bpf/bpf_helpers.h>
 #include <bpf/bpf_tracing.h>
+#include <bpf/bpf_core_read.h>
+#include "smoothtask_counters.h"
+#include "smoothtask_filter.h"
 
-// Максимальное количество отслеживаемых файлов
-#define MAX_FILES 1024
+// Режимы работы программы
+#define FS_MODE_COUNTERS 0
+#define FS_MODE_DETAILED 1
 
-// Структура для хранения информации о файлах
-struct file_stats {
-    __u64 read_count;
-    __u64 write_count;
-    __u64 open_count;
-    __u64 close_count;
+// Максимальное количество отслеживаемых процессов
+#define MAX_FS_PROCESSES 4096
+
+// Максимальное количество отслеживаемых пар (файл, процесс)
+#define MAX_FS_FILES 8192
+
+// Макросы типа inode отсутствуют в vmlinux.h
+#define FS_S_IFMT 00170000
+#define FS_S_IFREG 0100000
+
+enum fs_op {
+    FS_OP_READ,
+    FS_OP_WRITE,
+    FS_OP_OPEN,
+};
+
+// Конфигурация (раскладка совпадает с RawFilesystemConfig в ebpf_filesystem.rs)
+struct filesystem_config {
+    __u32 mode;
+    __u32 pad;
+};
+
+// Счётчики операций (раскладка совпадает с RawFsIoCounters в ebpf_filesystem.rs)
+struct fs_io_counters {
+    __u64 reads;
+    __u64 writes;
+    __u64 opens;
     __u64 bytes_read;
     __u64 bytes_written;
-    __u64 last_access_time;
 };
 
-// Карта для хранения статистики по файлам
+// Ключ пары (файл, процесс) (раскладка совпадает с RawFsFileKey в ebpf_filesystem.rs)
+struct fs_file_key {
+    __u64 ino;
+    __u32 dev;
+    __u32 tgid;
+};
+
+// Операции процесса с файлом (раскладка совпадает с RawFsFileStats в ebpf_filesystem.rs)
+struct fs_file_stats {
+    struct fs_io_counters io;
+    __u64 last_access_ns;    // Последняя операция на этом CPU
+};
+
 struct {
-    __uint(type, BPF_MAP_TYPE_HASH);
-    __uint(max_entries, MAX_FILES);
-    __type(key, __u32);  // Идентификатор файла (упрощенно)
-    __type(value, struct file_stats);
-} file_stats_map SEC(".maps");
+    __uint(type, BPF_MAP_TYPE_ARRAY);
+    __uint(max_entries, 1);
+    __type(key, __u32);
+    __type(value, struct filesystem_config);
+} filesystem_config_map SEC(".maps");
 
-// Карта для хранения общего количества операций с файлами
+// Общие итоги (per-CPU копии суммируются в userspace)
 struct {
     __uint(type, BPF_MAP_TYPE_PERCPU_ARRAY);
     __uint(max_entries, 1);
     __type(key, __u32);
-    __type(value, __u64);
-} total_file_ops_map SEC(".maps");
+    __type(value, struct fs_io_counters);
+} fs_totals_map SEC(".maps");
+
+// Итоги по TGID в детальном режиме
+struct {
+    __uint(type, BPF_MAP_TYPE_LRU_PERCPU_HASH);
+    __uint(max_entries, MAX_FS_PROCESSES);
+    __type(key, __u32);
+    __type(value, struct fs_io_counters);
+} fs_process_io_map SEC(".maps");
+
+// Операции по паре (файл, процесс) в детальном режиме
+struct {
+    __uint(type, BPF_MAP_TYPE_LRU_PERCPU_HASH);
+    __uint(max_entries, MAX_FS_FILES);
+    __type(key, struct fs_file_key);
+    __type(value, struct fs_file_stats);
+} fs_file_io_map SEC(".maps");
 
-// Точка входа для отслеживания операций открытия файлов
-SEC("tracepoint/syscalls/sys_enter_open")
-int trace_file_open(struct trace_event_raw_sys_enter *ctx)
+static __always_inline void io_add(struct fs_io_counters *io, enum fs_op op, __u64 bytes)
 {
-    __u32 key = 0;
-    __u64 *count;
-    
-    // Увеличиваем общее количество операций с файлами
-    count = bpf_map_lookup_elem(&total_file_ops_map, &key);
-    if (count) {
-        __sync_fetch_and_add(count, 1);
+    switch (op) {
+    case FS_OP_READ:
+        io->reads += 1;
+        io->bytes_read += bytes;
+        break;
+    case FS_OP_WRITE:
+        io->writes += 1;
+        io->bytes_written += bytes;
+        break;
+    case FS_OP_OPEN:
+        io->opens += 1;
+        break;
     }
-    
-    // В реальной реализации здесь будет анализ параметров вызова
-    // Пока что это заглушка
-    
-    return 0;
 }
 
-// Точка входа для отслеживания операций чтения файлов
-SEC("tracepoint/syscalls/sys_enter_read")
-int trace_file_read(struct trace_event_raw_sys_enter *ctx)
+static __always_inline bool detailed_mode(void)
 {
-    __u32 key = 0;
-    __u64 *count;
-    
-    // Увеличиваем общее количество операций с файлами
-    count = bpf_map_lookup_elem(&total_file_ops_map, &key);
-    if (count) {
-        __sync_fetch_and_add(count, 1);
-    }
-    
-    // В реальной реализации здесь будет анализ параметров вызова
-    // Пока что это заглушка
-    
-    return 0;
+    __u32 zero = 0;
+    struct filesystem_config *config = bpf_map_lookup_elem(&filesystem_config_map, &zero);
+
+    return config && config->mode == FS_MODE_DETAILED;
 }
 
-// Точка входа для отслеживания операций записи в файлы
-SEC("tracepoint/syscalls/sys_enter_write")
-int trace_file_write(struct trace_event_raw_sys_enter *ctx)
+static __always_inline void account_process(__u32 tgid, enum fs_op op, __u64 bytes)
 {
-    __u32 key = 0;
-    __u64 *count;
-    
-    // Увеличиваем общее количество операций с файлами
-    count = bpf_map_lookup_elem(&total_file_ops_map, &key);
-    if (count) {
-        __sync_fetch_and_add(count, 1);
-    }
-    
-    // В реальной реализации здесь будет анализ параметров вызова
-    // Пока что это заглушка
-    
-    return 0;
+    struct fs_io_counters *io = SMOOTHTASK_LOOKUP_OR_INIT(&fs_process_io_map, &tgid,
+                                                          struct fs_io_counters);
+
+    if (io)
+        io_add(io, op, bytes);
+}
+
+static __always_inline void account_file(struct inode *inode, __u32 tgid, enum fs_op op,
+                                         __u64 bytes)
+{
+    struct fs_file_key key = {
+        .ino = inode->i_ino,
+        .dev = inode->i_sb->s_dev,
+        .tgid = tgid,
+    };
+    __u64 now = bpf_ktime_get_ns();
+    struct fs_file_stats *stats = SMOOTHTASK_LOOKUP_OR_INIT(&fs_file_io_map, &key,
+                                                            struct fs_file_stats);
+
+    if (!stats)
+        return;
+
+    io_add(&stats->io, op, bytes);
+    stats->last_access_ns = now;
 }
 
-// Точка входа для отслеживания операций закрытия файлов
-SEC("tracepoint/syscalls/sys_enter_close")
-int trace_file_close(struct trace_event_raw_sys_enter *ctx)
+// Учесть операцию с обычным файлом; ошибки (отрицательный результат) пропускаются
+static __always_inline int account_op(struct file *file, long ret, enum fs_op op)
 {
-    __u32 key = 0;
-    __u64 *count;
-    
-    // Увеличиваем общее количество операций с файлами
-    count = bpf_map_lookup_elem(&total_file_ops_map, &key);
-    if (count) {
-        __sync_fetch_and_add(count, 1);
+    __u32 tgid = bpf_get_current_pid_tgid() >> 32;
+    struct inode *inode;
+    __u32 zero = 0;
+
+    if (ret < 0 || tgid == 0) {
+        return 0;
+    }
+
+    // Указатели fexit типизированы BTF, поля файла читаются напрямую
+    inode = file->f_inode;
+    if (!inode || (inode->i_mode & FS_S_IFMT) != FS_S_IFREG) {
+        return 0;
     }
-    
-    // В реальной реализации здесь будет анализ параметров вызова
-    // Пока что это заглушка
-    
+
+    if (!smoothtask_task_allowed(tgid)) {
+        return 0; // Процесс отфильтрован конфигурацией
+    }
+
+    struct fs_io_counters *totals = bpf_map_lookup_elem(&fs_totals_map, &zero);
+    if (totals)
+        io_add(totals, op, ret);
+    else
+        smoothtask_debug_inc(SMOOTHTASK_DEBUG_LOOKUP_MISS);
+
+    if (!detailed_mode())
+        return 0;
+
+    account_process(tgid, op, ret);
+    account_file(inode, tgid, op, ret);
     return 0;
 }
 
+// Чтение: результат — количество прочитанных байт
+SEC("fexit/vfs_read")
+int BPF_PROG(trace_vfs_read, struct file *file, char *buf, size_t count, loff_t *pos,
+             ssize_t ret)
+{
+    return account_op(file, ret, FS_OP_READ);
+}
+
+// Запись: результат — количество записанных байт
+SEC("fexit/vfs_write")
+int BPF_PROG(trace_vfs_write, struct file *file, const char *buf, size_t count, loff_t *pos,
+             ssize_t ret)
+{
+    return account_op(file, ret, FS_OP_WRITE);
+}
+
+// Открытие: к моменту возврата vfs_open() inode файла уже известен
+SEC("fexit/vfs_open")
+int BPF_PROG(trace_vfs_open, const struct path *path, struct file *file, int ret)
+{
+    return ret ? 0 : account_op(file, 0, FS_OP_OPEN);
+}
+
 // Лицензия для eBPF программы
-char _license[] SEC("license") = "GPL";
\ No newline at end of file
+char _license[] SEC("license") = "GPL";
@@ -1,196 +1,302 @@
 // SPDX-License-Identifier: GPL-2.0 OR BSD-2-Clause
 /* Copyright (c) 2024 SmoothTask Project */
 
-// eBPF программа для мониторинга производительности GPU
-// Отслеживает активность GPU и использование ресурсов
+// eBPF программа для мониторинга загрузки GPU
+//
+// Единственная программа GPU: считает время выполнения заданий планировщика
+// DRM (drm_sched) по кольцам устройств и по процессам, отправившим задания.
+// Задание проходит три точки трассировки модуля gpu_sched:
+// - постановка в очередь (drm_sched_job) — в контексте процесса, который
+//   отправил задание; здесь запоминаются его TGID и cgroup;
+// - запуск на кольце (drm_run_job) — в рабочем потоке планировщика; здесь
+//   запоминаются время запуска и кольцо;
+// - завершение (drm_sched_process_job) — при сигнале fence задания.
+// Записи заданий лежат в LRU карте с ключом по адресу drm_sched_fence
+// задания, поэтому запуск и завершение сопоставляются точно, а не по
+// текущей задаче.
+//
+// Кольцо выполняет задания по порядку: задание занимает его с момента
+// max(собственный запуск, завершение предыдущего) до своего завершения. Этот
+// отрезок прибавляется и к кольцу, и к процессу, так что сумма по процессам
+// кольца равна времени его занятости, а ожидание в аппаратной очереди не
+// учитывается дважды. Тот же отрезок прибавляется к per-CPU итогам cgroup
+// отправителя (gpu_cgroup_map, см. smoothtask_cgroup.h): завершение приходит
+// не в контексте отправителя, поэтому cgroup берётся из записи задания.
+//
+// В новых ядрах те же точки трассировки называются drm_sched_job_queue,
+// drm_sched_job_run и drm_sched_job_done с теми же аргументами. Программа
+// содержит обработчики для обоих наборов имён; те, что не нашлись в ядре,
+// не прикрепляются (см. EbpfObject::load).
 
-#include <linux/bpf.h>
+#include "vmlinux.h"
 #include <bpf/bpf_helpers.h>
 #include <bpf/bpf_tracing.h>
+#include <bpf/bpf_core_read.h>
+#include "smoothtask_bpf.h"
+#include "smoothtask_counters.h"
+#include "smoothtask_cgroup.h"
 
-// Максимальное количество отслеживаемых GPU устройств
-#define MAX_GPU_DEVICES 8
-
-// Структура для хранения информации о производительности GPU
-struct gpu_stats {
-    __u64 gpu_usage_ns;
-    __u64 memory_usage_bytes;
-    __u64 compute_units_active;
-    __u64 last_timestamp;
-    __u64 power_usage_uw;
-    __u32 temperature_celsius;  // Температура GPU в градусах Цельсия
-    __u32 max_temperature_celsius;  // Максимальная температура GPU
+// Колец на всех устройствах (у amdgpu их порядка двадцати на устройство)
+#define MAX_GPU_RINGS 128
+
+// Заданий между постановкой в очередь и завершением
+#define MAX_GPU_JOBS 4096
+
+// Пар (процесс, кольцо)
+#define MAX_GPU_PROCESS_RINGS 8192
+
+// Типы gpu_sched объявлены модулем и могут отсутствовать в vmlinux.h;
+// поля читаются через CO-RE по BTF модуля
+struct drm_gpu_scheduler___smoothtask {
+    const char *name;
+    struct device *dev;
+} __attribute__((preserve_access_index));
+
+struct drm_sched_job___smoothtask {
+    void *s_fence;
+    struct drm_gpu_scheduler___smoothtask *sched;
+} __attribute__((preserve_access_index));
+
+// Задание между постановкой в очередь и завершением
+struct gpu_job {
+    __u64 ring;                 // Адрес drm_gpu_scheduler кольца
+    __u64 start_ns;             // Запуск на кольце (0 — ещё в очереди)
+    __u64 cgroup_id;            // cgroup отправителя (0 — неизвестна)
+    __u32 tgid;                 // Отправитель (0 — неизвестен)
+    __u32 pad;
+};
+
+// Статистика кольца (раскладка совпадает с RawGpuRingStats в ebpf_gpu.rs)
+struct gpu_ring_stats {
+    __u64 ring;                 // Адрес drm_gpu_scheduler кольца
+    __u64 busy_ns;              // Время, когда на кольце выполнялось задание
+    __u64 jobs;                 // Завершённые задания
+    __u64 last_done_ns;         // Завершение последнего задания
+    char name[16];              // Имя кольца (gfx_0.0.0, sdma0, vcn_dec, ...)
+    char device[32];            // Имя устройства (dev_name, например 0000:03:00.0)
+};
+
+struct gpu_process_key {
+    __u64 ring;
+    __u32 tgid;
+    __u32 pad;
+};
+
+// Время процесса на кольце (раскладка совпадает с RawGpuProcessUsage в ebpf_gpu.rs)
+struct gpu_process_usage {
+    __u64 ring;
+    __u32 tgid;
+    __u32 pad;
+    __u64 busy_ns;
+    __u64 jobs;
+    __u64 last_update_ns;
 };
 
-// Карта для хранения статистики по GPU устройствам
+struct {
+    __uint(type, BPF_MAP_TYPE_LRU_HASH);
+    __uint(max_entries, MAX_GPU_JOBS);
+    __type(key, __u64);  // Адрес drm_sched_fence задания
+    __type(value, struct gpu_job);
+} gpu_jobs SEC(".maps");
+
 struct {
     __uint(type, BPF_MAP_TYPE_HASH);
-    __uint(max_entries, MAX_GPU_DEVICES);
-    __type(key, __u32);  // Идентификатор GPU устройства
-    __type(value, struct gpu_stats);
-} gpu_stats_map SEC(".maps");
+    __uint(max_entries, MAX_GPU_RINGS);
+    __type(key, __u64);  // Адрес drm_gpu_scheduler кольца
+    __type(value, struct gpu_ring_stats);
+} gpu_ring_stats_map SEC(".maps");
 
-// Карта для хранения общего времени использования GPU
 struct {
-    __uint(type, BPF_MAP_TYPE_PERCPU_ARRAY);
-    __uint(max_entries, 1);
-    __type(key, __u32);
-    __type(value, __u64);
-} total_gpu_usage_map SEC(".maps");
-
-// Точка входа для отслеживания активности GPU
-SEC("tracepoint/drm/drm_gpu_sched_run_job")
-int trace_gpu_activity(struct trace_event_raw_drm_gpu_sched_run_job *ctx)
+    __uint(type, BPF_MAP_TYPE_LRU_HASH);
+    __uint(max_entries, MAX_GPU_PROCESS_RINGS);
+    __type(key, struct gpu_process_key);
+    __type(value, struct gpu_process_usage);
+} gpu_process_usage_map SEC(".maps");
+
+// Per-CPU итоги по cgroup отправителя (struct gpu_cgroup_stats в smoothtask_bpf.h)
+SMOOTHTASK_CGROUP_MAP(gpu_cgroup_map, struct gpu_cgroup_stats);
+
+// Запись кольца; кольцо регистрируется при первом запущенном задании
+static __always_inline struct gpu_ring_stats *
+lookup_ring(struct drm_gpu_scheduler___smoothtask *sched)
 {
-    __u32 gpu_id = 0; // В реальной реализации нужно получить реальный GPU ID
-    struct gpu_stats *stats;
-    
-    // Получаем текущее время
-    __u64 timestamp = bpf_ktime_get_ns();
-    
-    // Получаем статистику для этого GPU устройства
-    stats = bpf_map_lookup_elem(&gpu_stats_map, &gpu_id);
-    if (!stats) {
-        // Инициализируем новую запись
-        struct gpu_stats new_stats = {0};
-        new_stats.last_timestamp = timestamp;
-        bpf_map_update_elem(&gpu_stats_map, &gpu_id, &new_stats, BPF_ANY);
-        return 0;
-    }
-    
-    // Рассчитываем дельту времени
-    __u64 delta = timestamp - stats->last_timestamp;
-    stats->last_timestamp = timestamp;
-    
-    // Увеличиваем использование GPU (в наносекундах)
-    __sync_fetch_and_add(&stats->gpu_usage_ns, delta);
-    
-    // Увеличиваем общее время использования GPU
-    __u32 total_key = 0;
-    __u64 *total_usage = bpf_map_lookup_elem(&total_gpu_usage_map, &total_key);
-    if (total_usage) {
-        __sync_fetch_and_add(total_usage, delta);
-    }
-    
-    // Обновляем температуру GPU (симуляция)
-    // В реальной реализации нужно получить реальную температуру из ядра
-    __u32 current_temp = 50; // Базовая температура
-    if (stats->gpu_usage_ns > 1000000000) { // Если GPU активно используется
-        current_temp = 65 + (stats->gpu_usage_ns / 1000000000) % 20; // 65-85°C
-    }
-    
-    stats->temperature_celsius = current_temp;
-    
-    // Обновляем максимальную температуру
-    if (current_temp > stats->max_temperature_celsius) {
-        stats->max_temperature_celsius = current_temp;
+    __u64 ring = (__u64)sched;
+    struct gpu_ring_stats *stats = bpf_map_lookup_elem(&gpu_ring_stats_map, &ring);
+
+    if (stats)
+        return stats;
+
+    struct gpu_ring_stats new_stats = {};
+    new_stats.ring = ring;
+    bpf_probe_read_kernel_str(new_stats.name, sizeof(new_stats.name), BPF_CORE_READ(sched, name));
+
+    // Указатель на устройство появился в планировщике не во всех версиях ядра
+    if (bpf_core_field_exists(sched->dev)) {
+        struct device *dev = BPF_CORE_READ(sched, dev);
+        const char *dev_name = dev ? BPF_CORE_READ(dev, kobj.name) : 0;
+
+        if (dev_name)
+            bpf_probe_read_kernel_str(new_stats.device, sizeof(new_stats.device), dev_name);
     }
-    
-    return 0;
+
+    // Кольцо могли зарегистрировать параллельно на другом CPU — тогда берём его
+    smoothtask_map_update(&gpu_ring_stats_map, &ring, &new_stats, BPF_NOEXIST);
+    return smoothtask_lookup_created(&gpu_ring_stats_map, &ring);
 }
 
-// Точка входа для отслеживания использования памяти GPU
-SEC("tracepoint/drm/drm_gem_object_create")
-int trace_gpu_memory(struct trace_event_raw_drm_gem_object_create *ctx)
+// Прибавить время задания к процессу на кольце
+static __always_inline void charge_process(const struct gpu_job *job, __u64 busy_ns, __u64 now)
 {
-    __u32 gpu_id = 0; // В реальной реализации нужно получить реальный GPU ID
-    struct gpu_stats *stats;
-    
-    // Получаем статистику для этого GPU устройства
-    stats = bpf_map_lookup_elem(&gpu_stats_map, &gpu_id);
-    if (!stats) {
-        // Инициализируем новую запись
-        struct gpu_stats new_stats = {0};
-        new_stats.last_timestamp = bpf_ktime_get_ns();
-        bpf_map_update_elem(&gpu_stats_map, &gpu_id, &new_stats, BPF_ANY);
-        return 0;
+    struct gpu_process_key key = {
+        .ring = job->ring,
+        .tgid = job->tgid,
+    };
+    struct gpu_process_usage *usage = SMOOTHTASK_LOOKUP_OR_INIT(&gpu_process_usage_map, &key,
+                                                                struct gpu_process_usage);
+
+    if (!usage)
+        return;
+
+    // Новая запись ещё без владельца; параллельные CPU записывают одно и то же
+    if (!usage->jobs) {
+        usage->ring = job->ring;
+        usage->tgid = job->tgid;
     }
-    
-    // Увеличиваем использование памяти GPU
-    // В реальной реализации нужно получить реальный размер объекта
-    __u64 memory_increase = 4096; // Пример: 4KB увеличение (реально нужно получить из ctx)
-    __sync_fetch_and_add(&stats->memory_usage_bytes, memory_increase);
-    
-    return 0;
+
+    __sync_fetch_and_add(&usage->busy_ns, busy_ns);
+    __sync_fetch_and_add(&usage->jobs, 1);
+    usage->last_update_ns = now;
 }
 
-// Точка входа для отслеживания вычислительных задач GPU
-SEC("tracepoint/drm/drm_gpu_sched_job_start")
-int trace_gpu_compute_start(struct trace_event_raw_drm_gpu_sched_job_start *ctx)
+// Прибавить время задания к cgroup отправителя
+static __always_inline void charge_cgroup(const struct gpu_job *job, __u64 busy_ns)
 {
-    __u32 gpu_id = 0; // В реальной реализации нужно получить реальный GPU ID
-    struct gpu_stats *stats;
-    
-    // Получаем статистику для этого GPU устройства
-    stats = bpf_map_lookup_elem(&gpu_stats_map, &gpu_id);
-    if (!stats) {
-        // Инициализируем новую запись
-        struct gpu_stats new_stats = {0};
-        new_stats.last_timestamp = bpf_ktime_get_ns();
-        bpf_map_update_elem(&gpu_stats_map, &gpu_id, &new_stats, BPF_ANY);
+    struct gpu_cgroup_stats zero = {};
+    struct gpu_cgroup_stats *cgroup =
+        smoothtask_cgroup_entry_of(&gpu_cgroup_map, job->cgroup_id, &zero);
+
+    if (!cgroup)
+        return;
+
+    cgroup->busy_ns += busy_ns;
+    cgroup->jobs += 1;
+}
+
+// Постановка в очередь: запоминаем процесс, отправивший задание
+static __always_inline int job_queued(struct drm_sched_job___smoothtask *sched_job)
+{
+    __u64 fence = (__u64)BPF_CORE_READ(sched_job, s_fence);
+    struct gpu_job job = {};
+
+    if (!fence)
         return 0;
-    }
-    
-    // Увеличиваем количество активных вычислительных единиц
-    __sync_fetch_and_add(&stats->compute_units_active, 1);
-    
+
+    job.tgid = bpf_get_current_pid_tgid() >> 32;
+    job.cgroup_id = bpf_get_current_cgroup_id();
+    smoothtask_map_update(&gpu_jobs, &fence, &job, BPF_ANY);
     return 0;
 }
 
-// Точка входа для отслеживания завершения вычислительных задач GPU
-SEC("tracepoint/drm/drm_gpu_sched_job_end")
-int trace_gpu_compute_end(struct trace_event_raw_drm_gpu_sched_job_end *ctx)
+// Запуск на кольце: запоминаем кольцо и время запуска
+static __always_inline int job_run(struct drm_sched_job___smoothtask *sched_job)
 {
-    __u32 gpu_id = 0; // В реальной реализации нужно получить реальный GPU ID
-    struct gpu_stats *stats;
-    
-    // Получаем статистику для этого GPU устройства
-    stats = bpf_map_lookup_elem(&gpu_stats_map, &gpu_id);
-    if (!stats) {
+    __u64 fence = (__u64)BPF_CORE_READ(sched_job, s_fence);
+    struct drm_gpu_scheduler___smoothtask *sched = BPF_CORE_READ(sched_job, sched);
+    __u64 now = bpf_ktime_get_ns();
+
+    if (!fence || !sched || !lookup_ring(sched))
+        return 0;
+
+    struct gpu_job *job = bpf_map_lookup_elem(&gpu_jobs, &fence);
+    if (job) {
+        job->ring = (__u64)sched;
+        job->start_ns = now;
         return 0;
     }
-    
-    // Уменьшаем количество активных вычислительных единиц
-    if (stats->compute_units_active > 0) {
-        __sync_fetch_and_sub(&stats->compute_units_active, 1);
-    }
-    
+
+    // Задание поставлено в очередь до загрузки программы или вытеснено из LRU:
+    // его время учитывается кольцом, но не процессом
+    struct gpu_job new_job = {
+        .ring = (__u64)sched,
+        .start_ns = now,
+    };
+    smoothtask_map_update(&gpu_jobs, &fence, &new_job, BPF_ANY);
     return 0;
 }
 
-// Точка входа для отслеживания потребления энергии GPU
-// Используем общий tracepoint для отслеживания изменений в энергопотреблении
-SEC("tracepoint/power/power_start")
-int trace_gpu_power_usage(struct trace_event_raw_power_start *ctx)
+// Завершение: время от начала занятия кольца до сигнала fence
+static __always_inline int job_done(void *s_fence)
 {
-    __u32 gpu_id = 0; // В реальной реализации нужно получить реальный GPU ID
-    struct gpu_stats *stats;
-    
-    // Получаем статистику для этого GPU устройства
-    stats = bpf_map_lookup_elem(&gpu_stats_map, &gpu_id);
-    if (!stats) {
-        // Инициализируем новую запись
-        struct gpu_stats new_stats = {0};
-        new_stats.last_timestamp = bpf_ktime_get_ns();
-        bpf_map_update_elem(&gpu_stats_map, &gpu_id, &new_stats, BPF_ANY);
+    __u64 fence = (__u64)s_fence;
+    __u64 now = bpf_ktime_get_ns();
+    struct gpu_job *entry = bpf_map_lookup_elem(&gpu_jobs, &fence);
+
+    if (!entry)
         return 0;
-    }
-    
-    // Увеличиваем потребление энергии
-    // В реальной реализации нужно получить реальное значение энергопотребления
-    __u64 power_increase = 1000; // Пример: 1000 микроватт (реально нужно получить из ctx)
-    
-    // Масштабируем энергопотребление в зависимости от использования GPU
-    if (stats->gpu_usage_ns > 0) {
-        __u64 usage_factor = stats->gpu_usage_ns / 1000000; // Масштабирующий фактор
-        if (usage_factor > 100) usage_factor = 100; // Ограничиваем максимальный фактор
-        power_increase = 1000 + (usage_factor * 50); // 1000-6000 микроватт
-    }
-    
-    __sync_fetch_and_add(&stats->power_usage_uw, power_increase);
-    
+
+    struct gpu_job job = *entry;
+    bpf_map_delete_elem(&gpu_jobs, &fence);
+
+    // Задание отменено до запуска
+    if (!job.start_ns)
+        return 0;
+
+    struct gpu_ring_stats *ring = bpf_map_lookup_elem(&gpu_ring_stats_map, &job.ring);
+    if (!ring)
+        return 0;
+
+    // Fence одного кольца сигнализируются по порядку и последовательно,
+    // поэтому last_done_ns обновляется без атомарных операций
+    __u64 begin = job.start_ns > ring->last_done_ns ? job.start_ns : ring->last_done_ns;
+    __u64 busy_ns = now > begin ? now - begin : 0;
+
+    ring->last_done_ns = now;
+    __sync_fetch_and_add(&ring->busy_ns, busy_ns);
+    __sync_fetch_and_add(&ring->jobs, 1);
+
+    if (job.tgid)
+        charge_process(&job, busy_ns, now);
+    if (job.cgroup_id)
+        charge_cgroup(&job, busy_ns);
     return 0;
 }
 
+SEC("raw_tp/drm_sched_job")
+int BPF_PROG(trace_gpu_job_queue, struct drm_sched_job___smoothtask *sched_job)
+{
+    return job_queued(sched_job);
+}
+
+SEC("raw_tp/drm_run_job")
+int BPF_PROG(trace_gpu_job_run, struct drm_sched_job___smoothtask *sched_job)
+{
+    return job_run(sched_job);
+}
+
+SEC("raw_tp/drm_sched_process_job")
+int BPF_PROG(trace_gpu_job_done, void *s_fence)
+{
+    return job_done(s_fence);
+}
+
+// Имена точек трассировки в новых ядрах
+SEC("raw_tp/drm_sched_job_queue")
+int BPF_PROG(trace_gpu_job_queue_v2, struct drm_sched_job___smoothtask *sched_job)
+{
+    return job_queued(sched_job);
+}
+
+SEC("raw_tp/drm_sched_job_run")
+int BPF_PROG(trace_gpu_job_run_v2, struct drm_sched_job___smoothtask *sched_job)
+{
+    return job_run(sched_job);
+}
+
+SEC("raw_tp/drm_sched_job_done")
+int BPF_PROG(trace_gpu_job_done_v2, void *s_fence)
+{
+    return job_done(s_fence);
+}
+
 // Лицензия для eBPF программы
-char _license[] SEC("license") = "GPL";
\ No newline at end of file
+char _license[] SEC("license") = "GPL";
@@ -0,0 +1,77 @@
+// SPDX-License-Identifier: GPL-2.0 OR BSD-2-Clause
+/* Copyright (c) 2024 SmoothTask Project */
+
+// eBPF программа учёта выделений памяти ядра (kmalloc/kfree) по процессам
+//
+// kmem/kmalloc и kmem/kfree — одни из самых частых событий ядра, поэтому
+// программа вынесена из application_performance.c в отдельный объект и
+// загружается только при enable_kmem_allocation_tracking. Выборка
+// SMOOTHTASK_SAMPLE_KMEM снижает стоимость под нагрузкой, счётчики
+// увеличиваются на вес события. Итоги ведутся в per-CPU LRU карте по TGID и
+// сливаются userspace со статистикой производительности приложений
+// (см. ebpf_memory_pressure.rs).
+
+#include "vmlinux.h"
+#include <bpf/bpf_helpers.h>
+#include <bpf/bpf_tracing.h>
+#include <bpf/bpf_core_read.h>
+#include "smoothtask_counters.h"
+#include "smoothtask_filter.h"
+#include "smoothtask_sampling.h"
+
+// Максимальное количество отслеживаемых процессов
+#define MAX_KMEM_PROCESSES 4096
+
+// Счётчики процесса (раскладка совпадает с RawKmemCounters в ebpf_memory_pressure.rs)
+struct kmem_counters {
+    __u64 allocations;
+    __u64 frees;
+};
+
+// Per-CPU счётчики по TGID; LRU вытесняет завершившиеся процессы
+struct {
+    __uint(type, BPF_MAP_TYPE_LRU_PERCPU_HASH);
+    __uint(max_entries, MAX_KMEM_PROCESSES);
+    __type(key, __u32);
+    __type(value, struct kmem_counters);
+} kmem_process_map SEC(".maps");
+
+static __always_inline int account_kmem(__u64 allocations, __u64 frees)
+{
+    __u32 tgid = bpf_get_current_pid_tgid() >> 32;
+    struct kmem_counters *counters;
+
+    if (tgid == 0 || !smoothtask_task_allowed(tgid))
+        return 0;
+
+    counters = SMOOTHTASK_LOOKUP_OR_INIT(&kmem_process_map, &tgid, struct kmem_counters);
+    if (!counters)
+        return 0;
+
+    counters->allocations += allocations;
+    counters->frees += frees;
+    return 0;
+}
+
+// Прикрепляемся к точке трассировки kmem/kmalloc
+// для отслеживания выделений памяти
+SEC("tracepoint/kmem/kmalloc")
+int trace_kmalloc(struct trace_event_raw_kmalloc *ctx)
+{
+    __u32 weight = smoothtask_sample(SMOOTHTASK_SAMPLE_KMEM);
+
+    return weight ? account_kmem(weight, 0) : 0;
+}
+
+// Прикрепляемся к точке трассировки kmem/kfree
+// для отслеживания освобождений памяти
+SEC("tracepoint/kmem/kfree")
+int trace_kfree(struct trace_event_raw_kfree *ctx)
+{
+    __u32 weight = smoothtask_sample(SMOOTHTASK_SAMPLE_KMEM);
+
+    return weight ? account_kmem(0, weight) : 0;
+}
+
+// Лицензия для eBPF программы
+char _license[] SEC("license") = "GPL";
@@ -0,0 +1,233 @@
+// SPDX-License-Identifier: GPL-2.0 OR BSD-2-Clause
+/* Copyright (c) 2025 SmoothTask Authors */
+
+// eBPF программа потоковой доставки событий жизненного цикла через BPF_MAP_TYPE_RINGBUF
+//
+// Вместо накопления состояния в HASH картах, которые userspace обходит целиком
+// на каждом тике, программа публикует компактные события (exec/fork/exit,
+// смена состояния TCP, постановка и завершение блочных запросов) в кольцевой
+// буфер. Потребитель в userspace вычитывает их пачками, поэтому стоимость
+// сбора пропорциональна частоте событий, а не размеру таблиц.
+//
+// Пробуждение потребителя управляется порогом накопленных данных из
+// lifecycle_config_map: пока в буфере меньше wakeup_threshold_bytes,
+// события публикуются с BPF_RB_NO_WAKEUP и забираются по таймауту poll.
+
+#include "vmlinux.h"
+#include <bpf/bpf_helpers.h>
+#include <bpf/bpf_tracing.h>
+#include <bpf/bpf_core_read.h>
+#include "smoothtask_bpf.h"
+
+#define LIFECYCLE_RINGBUF_SIZE (256 * 1024)
+
+#define LIFECYCLE_EVENT_EXEC 1
+#define LIFECYCLE_EVENT_FORK 2
+#define LIFECYCLE_EVENT_EXIT 3
+#define LIFECYCLE_EVENT_TCP_STATE 4
+#define LIFECYCLE_EVENT_BLOCK_RQ_ISSUE 5
+#define LIFECYCLE_EVENT_BLOCK_RQ_COMPLETE 6
+
+#define LIFECYCLE_IPPROTO_TCP 6
+
+// Событие жизненного цикла (56 байт, раскладка совпадает с RawLifecycleEvent в ebpf_events.rs)
+struct lifecycle_event {
+    __u64 timestamp_ns;
+    // exit_code для EXIT, (sport << 16 | dport) для TCP, байты для блочных запросов
+    __u64 value;
+    __u32 event_type;
+    __u32 pid;
+    __u32 tgid;
+    // PID дочернего процесса для FORK, новое состояние для TCP, устройство для блочных запросов
+    __u32 aux;
+    // Старое состояние для TCP, 1 для записи у блочных запросов
+    __u32 aux2;
+    __u32 _pad;
+    char comm[16];
+};
+
+// Настройки потока событий, заполняются из userspace
+struct lifecycle_config {
+    // Порог накопленных байт, после которого потребитель принудительно пробуждается (0 — поведение libbpf по умолчанию)
+    __u64 wakeup_threshold_bytes;
+    // Битовая маска включённых типов событий (бит N — тип N), 0 — все типы
+    __u32 event_mask;
+    __u32 _pad;
+};
+
+struct {
+    __uint(type, BPF_MAP_TYPE_RINGBUF);
+    __uint(max_entries, LIFECYCLE_RINGBUF_SIZE);
+} lifecycle_events SEC(".maps");
+
+struct {
+    __uint(type, BPF_MAP_TYPE_ARRAY);
+    __uint(max_entries, 1);
+    __type(key, __u32);
+    __type(value, struct lifecycle_config);
+} lifecycle_config_map SEC(".maps");
+
+// Количество событий, потерянных из-за переполнения кольцевого буфера
+struct {
+    __uint(type, BPF_MAP_TYPE_PERCPU_ARRAY);
+    __uint(max_entries, 1);
+    __type(key, __u32);
+    __type(value, __u64);
+} lifecycle_dropped_map SEC(".maps");
+
+static __always_inline struct lifecycle_config *get_config(void)
+{
+    __u32 key = 0;
+    return bpf_map_lookup_elem(&lifecycle_config_map, &key);
+}
+
+static __always_inline bool event_enabled(struct lifecycle_config *cfg, __u32 event_type)
+{
+    if (!cfg || cfg->event_mask == 0)
+        return true;
+    return cfg->event_mask & (1U << event_type);
+}
+
+static __always_inline struct lifecycle_event *reserve_event(__u32 event_type)
+{
+    struct lifecycle_config *cfg = get_config();
+    struct lifecycle_event *event;
+    __u64 pid_tgid;
+
+    if (!event_enabled(cfg, event_type))
+        return NULL;
+
+    event = bpf_ringbuf_reserve(&lifecycle_events, sizeof(*event), 0);
+    if (!event) {
+        __u32 key = 0;
+        __u64 *dropped = bpf_map_lookup_elem(&lifecycle_dropped_map, &key);
+        if (dropped)
+            (*dropped)++;
+        return NULL;
+    }
+
+    pid_tgid = bpf_get_current_pid_tgid();
+    event->timestamp_ns = bpf_ktime_get_ns();
+    event->value = 0;
+    event->event_type = event_type;
+    event->pid = (__u32)pid_tgid;
+    event->tgid = pid_tgid >> 32;
+    event->aux = 0;
+    event->aux2 = 0;
+    event->_pad = 0;
+    bpf_get_current_comm(&event->comm, sizeof(event->comm));
+    return event;
+}
+
+static __always_inline void submit_event(struct lifecycle_event *event)
+{
+    struct lifecycle_config *cfg = get_config();
+    __u64 flags = 0;
+
+    if (cfg && cfg->wakeup_threshold_bytes > 0) {
+        if (bpf_ringbuf_query(&lifecycle_events, BPF_RB_AVAIL_DATA) >= cfg->wakeup_threshold_bytes)
+            flags = BPF_RB_FORCE_WAKEUP;
+        else
+            flags = BPF_RB_NO_WAKEUP;
+    }
+
+    bpf_ringbuf_submit(event, flags);
+}
+
+SEC("tp_btf/sched_process_exec")
+int BPF_PROG(lifecycle_exec, struct task_struct *p, pid_t old_pid, struct linux_binprm *bprm)
+{
+    struct lifecycle_event *event = reserve_event(LIFECYCLE_EVENT_EXEC);
+    if (!event)
+        return 0;
+
+    submit_event(event);
+    return 0;
+}
+
+SEC("tp_btf/sched_process_fork")
+int BPF_PROG(lifecycle_fork, struct task_struct *parent, struct task_struct *child)
+{
+    struct lifecycle_event *event;
+    __u32 child_pid = BPF_CORE_READ(child, pid);
+    __u32 child_tgid = BPF_CORE_READ(child, tgid);
+
+    // Создание потоков не меняет набор процессов
+    if (child_pid != child_tgid)
+        return 0;
+
+    event = reserve_event(LIFECYCLE_EVENT_FORK);
+    if (!event)
+        return 0;
+
+    event->aux = child_tgid;
+    submit_event(event);
+    return 0;
+}
+
+SEC("tp_btf/sched_process_exit")
+int BPF_PROG(lifecycle_exit, struct task_struct *p)
+{
+    struct lifecycle_event *event;
+
+    // Учитываем только завершение лидера группы потоков
+    if (BPF_CORE_READ(p, pid) != BPF_CORE_READ(p, tgid))
+        return 0;
+
+    event = reserve_event(LIFECYCLE_EVENT_EXIT);
+    if (!event)
+        return 0;
+
+    event->value = BPF_CORE_READ(p, exit_code);
+    submit_event(event);
+    return 0;
+}
+
+SEC("tracepoint/sock/inet_sock_set_state")
+int lifecycle_tcp_state(struct trace_event_raw_inet_sock_set_state *ctx)
+{
+    struct lifecycle_event *event;
+
+    if (ctx->protocol != LIFECYCLE_IPPROTO_TCP)
+        return 0;
+
+    event = reserve_event(LIFECYCLE_EVENT_TCP_STATE);
+    if (!event)
+        return 0;
+
+    event->value = ((__u64)ctx->sport << 16) | ctx->dport;
+    event->aux = ctx->newstate;
+    event->aux2 = ctx->oldstate;
+    submit_event(event);
+    return 0;
+}
+
+SEC("tracepoint/block/block_rq_issue")
+int lifecycle_block_rq_issue(struct trace_event_raw_block_rq *ctx)
+{
+    struct lifecycle_event *event = reserve_event(LIFECYCLE_EVENT_BLOCK_RQ_ISSUE);
+    if (!event)
+        return 0;
+
+    event->value = ctx->bytes;
+    event->aux = ctx->dev;
+    event->aux2 = smoothtask_rwbs_op(ctx->rwbs) == 'W' ? 1 : 0;
+    submit_event(event);
+    return 0;
+}
+
+SEC("tracepoint/block/block_rq_complete")
+int lifecycle_block_rq_complete(struct trace_event_raw_block_rq_completion *ctx)
+{
+    struct lifecycle_event *event = reserve_event(LIFECYCLE_EVENT_BLOCK_RQ_COMPLETE);
+    if (!event)
+        return 0;
+
+    event->value = (__u64)ctx->nr_sector << 9;
+    event->aux = ctx->dev;
+    event->aux2 = smoothtask_rwbs_op(ctx->rwbs) == 'W' ? 1 : 0;
+    submit_event(event);
+    return 0;
+}
+
+char _license[] SEC("license") = "GPL";
@@ -0,0 +1,349 @@
+// SPDX-License-Identifier: GPL-2.0 OR BSD-2-Clause
+/* Copyright (c) 2024 SmoothTask Project */
+
+// eBPF программа учёта задержек из-за нехватки памяти
+//
+// Измеряет, сколько времени потоки процесса стоят в ожидании памяти — тот
+// же сигнал, что и PSI memory, но по процессу (TGID) и по cgroup:
+// - major page fault: время handle_mm_fault() для отказов с VM_FAULT_MAJOR
+//   (страница читалась с диска или из swap). Повторные попытки
+//   (VM_FAULT_RETRY) суммируются и учитываются при завершении отказа,
+//   как это делает mm_account_fault();
+// - swap-in: время do_swap_page(), когда страница читалась из swap; входит
+//   во время major fault и отдельно в общую задержку не добавляется;
+// - прямое освобождение памяти (direct reclaim и reclaim по лимиту memcg) в
+//   контексте выделяющего потока, по точкам трассировки vmscan.
+// stall_ns — общая задержка без двойного учёта: освобождение внутри major
+// fault уже входит во время отказа.
+//
+// Начала интервалов хранятся по TID в LRU карте: запись создаётся при первом
+// отказе потока и переиспользуется, поэтому на горячем пути обычного
+// (minor) отказа остаются только поиск в карте и запись времени. Выборка не
+// применяется: редкие долгие события важнее частых коротких. Итоги ведутся
+// в per-CPU LRU картах по TGID и по cgroup v2; слияние по CPU и доли
+// задержки за интервал считаются в userspace (см. ebpf_memory_pressure.rs).
+
+#include "vmlinux.h"
+#include <bpf/bpf_helpers.h>
+#include <bpf/bpf_tracing.h>
+#include <bpf/bpf_core_read.h>
+#include "smoothtask_counters.h"
+#include "smoothtask_filter.h"
+
+// Максимальное количество потоков с интервалами
+#define MAX_STALL_THREADS 65536
+
+// Максимальное количество отслеживаемых процессов
+#define MAX_STALL_PROCESSES 4096
+
+// Максимальное количество отслеживаемых cgroup
+#define MAX_STALL_CGROUPS 1024
+
+// Биты vm_fault_t (enum vm_fault_reason в vmlinux.h зависит от версии ядра)
+#define STALL_VM_FAULT_OOM 0x0001
+#define STALL_VM_FAULT_SIGBUS 0x0002
+#define STALL_VM_FAULT_MAJOR 0x0004
+#define STALL_VM_FAULT_HWPOISON 0x0010
+#define STALL_VM_FAULT_HWPOISON_LARGE 0x0020
+#define STALL_VM_FAULT_SIGSEGV 0x0040
+#define STALL_VM_FAULT_RETRY 0x0400
+#define STALL_VM_FAULT_FALLBACK 0x0800
+#define STALL_VM_FAULT_ERROR                                                            \
+    (STALL_VM_FAULT_OOM | STALL_VM_FAULT_SIGBUS | STALL_VM_FAULT_SIGSEGV |              \
+     STALL_VM_FAULT_HWPOISON | STALL_VM_FAULT_HWPOISON_LARGE | STALL_VM_FAULT_FALLBACK)
+
+// Открытые интервалы потока
+struct memory_stall_thread {
+    __u64 fault_start_ns;       // Вход в handle_mm_fault (0 — вне отказа)
+    __u64 fault_pending_ns;     // Время попыток отказа, завершившихся VM_FAULT_RETRY
+    __u64 fault_reclaim_ns;     // Освобождение памяти внутри текущего отказа
+    __u64 swapin_start_ns;
+    __u64 reclaim_start_ns;
+    __u32 fault_pending_major;  // Одна из повторённых попыток была major
+    __u32 pad;
+};
+
+// Задержки (раскладка совпадает с RawMemoryStallCounters в ebpf_memory_pressure.rs)
+struct memory_stall_counters {
+    __u64 major_faults;
+    __u64 major_fault_ns;
+    __u64 swapins;
+    __u64 swapin_ns;
+    __u64 reclaims;
+    __u64 reclaim_ns;
+    __u64 stall_ns;             // Общая задержка без двойного учёта
+};
+
+// Итоги процесса (раскладка совпадает с RawMemoryStallProcess в ebpf_memory_pressure.rs).
+// Имя записывается в копию каждого CPU при первом событии на нём.
+struct memory_stall_process {
+    struct memory_stall_counters stalls;
+    __u64 last_stall_ns;
+    char comm[16];
+};
+
+struct {
+    __uint(type, BPF_MAP_TYPE_LRU_HASH);
+    __uint(max_entries, MAX_STALL_THREADS);
+    __type(key, __u32);                            // TID
+    __type(value, struct memory_stall_thread);
+} memory_stall_thread_map SEC(".maps");
+
+// Per-CPU итоги по TGID; LRU вытесняет завершившиеся процессы
+struct {
+    __uint(type, BPF_MAP_TYPE_LRU_PERCPU_HASH);
+    __uint(max_entries, MAX_STALL_PROCESSES);
+    __type(key, __u32);
+    __type(value, struct memory_stall_process);
+} memory_stall_process_map SEC(".maps");
+
+// Per-CPU итоги по идентификатору cgroup v2
+struct {
+    __uint(type, BPF_MAP_TYPE_LRU_PERCPU_HASH);
+    __uint(max_entries, MAX_STALL_CGROUPS);
+    __type(key, __u64);
+    __type(value, struct memory_stall_counters);
+} memory_stall_cgroup_map SEC(".maps");
+
+static __always_inline void counters_add(struct memory_stall_counters *dst,
+                                         const struct memory_stall_counters *delta)
+{
+    dst->major_faults += delta->major_faults;
+    dst->major_fault_ns += delta->major_fault_ns;
+    dst->swapins += delta->swapins;
+    dst->swapin_ns += delta->swapin_ns;
+    dst->reclaims += delta->reclaims;
+    dst->reclaim_ns += delta->reclaim_ns;
+    dst->stall_ns += delta->stall_ns;
+}
+
+static __always_inline void account_process(const struct memory_stall_counters *delta,
+                                            __u64 now)
+{
+    __u32 tgid = bpf_get_current_pid_tgid() >> 32;
+    struct memory_stall_process *process =
+        SMOOTHTASK_LOOKUP_OR_INIT(&memory_stall_process_map, &tgid, struct memory_stall_process);
+
+    if (!process)
+        return;
+
+    // Новая запись (или копия этого CPU, созданная другим CPU) ещё без имени
+    if (!process->comm[0])
+        bpf_get_current_comm(&process->comm, sizeof(process->comm));
+    counters_add(&process->stalls, delta);
+    process->last_stall_ns = now;
+}
+
+static __always_inline void account_cgroup(const struct memory_stall_counters *delta)
+{
+    __u64 cgroup_id = bpf_get_current_cgroup_id();
+    struct memory_stall_counters *cgroup = SMOOTHTASK_LOOKUP_OR_INIT(
+        &memory_stall_cgroup_map, &cgroup_id, struct memory_stall_counters);
+
+    if (cgroup)
+        counters_add(cgroup, delta);
+}
+
+// Прибавить задержки к итогам текущего процесса и его cgroup
+static __always_inline void account_stall(const struct memory_stall_counters *delta, __u64 now)
+{
+    account_process(delta, now);
+    account_cgroup(delta);
+}
+
+static __always_inline struct memory_stall_thread *current_thread(void)
+{
+    __u32 tid = (__u32)bpf_get_current_pid_tgid();
+
+    return bpf_map_lookup_elem(&memory_stall_thread_map, &tid);
+}
+
+SEC("fentry/handle_mm_fault")
+int BPF_PROG(trace_fault_enter, struct vm_area_struct *vma, unsigned long address,
+             unsigned int flags, struct pt_regs *regs)
+{
+    __u64 pid_tgid = bpf_get_current_pid_tgid();
+    __u32 tid = (__u32)pid_tgid;
+    __u64 now = bpf_ktime_get_ns();
+    struct memory_stall_thread *thread;
+
+    if (!smoothtask_task_allowed(pid_tgid >> 32))
+        return 0;
+
+    thread = bpf_map_lookup_elem(&memory_stall_thread_map, &tid);
+    if (!thread) {
+        struct memory_stall_thread new_thread = {
+            .fault_start_ns = now,
+        };
+
+        smoothtask_map_update(&memory_stall_thread_map, &tid, &new_thread, BPF_NOEXIST);
+        return 0;
+    }
+
+    thread->fault_start_ns = now;
+    return 0;
+}
+
+SEC("fexit/handle_mm_fault")
+int BPF_PROG(trace_fault_exit, struct vm_area_struct *vma, unsigned long address,
+             unsigned int flags, struct pt_regs *regs, vm_fault_t ret)
+{
+    struct memory_stall_thread *thread = current_thread();
+    __u64 now = bpf_ktime_get_ns();
+
+    if (!thread || !thread->fault_start_ns)
+        return 0;
+
+    __u64 latency_ns = now > thread->fault_start_ns ? now - thread->fault_start_ns : 0;
+    thread->fault_start_ns = 0;
+
+    // Отказ будет повторён: время попытки учитывается вместе с повтором
+    if (ret & STALL_VM_FAULT_RETRY) {
+        thread->fault_pending_ns += latency_ns;
+        if (ret & STALL_VM_FAULT_MAJOR)
+            thread->fault_pending_major = 1;
+        return 0;
+    }
+
+    __u64 total_ns = latency_ns + thread->fault_pending_ns;
+    __u64 reclaim_ns = thread->fault_reclaim_ns;
+    bool major = (ret & STALL_VM_FAULT_MAJOR) || thread->fault_pending_major;
+    thread->fault_pending_ns = 0;
+    thread->fault_reclaim_ns = 0;
+    thread->fault_pending_major = 0;
+
+    if (ret & STALL_VM_FAULT_ERROR)
+        return 0;
+
+    struct memory_stall_counters delta = {};
+    if (major) {
+        delta.major_faults = 1;
+        delta.major_fault_ns = total_ns;
+        delta.stall_ns = total_ns;
+    } else if (reclaim_ns) {
+        // Освобождение внутри minor отказа ещё не вошло в общую задержку
+        delta.stall_ns = reclaim_ns;
+    } else {
+        return 0;
+    }
+
+    account_stall(&delta, now);
+    return 0;
+}
+
+SEC("fentry/do_swap_page")
+int BPF_PROG(trace_swapin_enter, struct vm_fault *vmf)
+{
+    struct memory_stall_thread *thread = current_thread();
+
+    // Запись создаётся при входе в отказ, внутри которого выполняется swap-in
+    if (thread)
+        thread->swapin_start_ns = bpf_ktime_get_ns();
+
+    return 0;
+}
+
+SEC("fexit/do_swap_page")
+int BPF_PROG(trace_swapin_exit, struct vm_fault *vmf, vm_fault_t ret)
+{
+    struct memory_stall_thread *thread = current_thread();
+    __u64 now = bpf_ktime_get_ns();
+
+    if (!thread || !thread->swapin_start_ns)
+        return 0;
+
+    __u64 start_ns = thread->swapin_start_ns;
+    thread->swapin_start_ns = 0;
+
+    // Страница из swap cache чтения с устройства не требует
+    if (!(ret & STALL_VM_FAULT_MAJOR) || now <= start_ns)
+        return 0;
+
+    struct memory_stall_counters delta = {
+        .swapins = 1,
+        .swapin_ns = now - start_ns,
+    };
+    account_stall(&delta, now);
+    return 0;
+}
+
+static __always_inline int reclaim_begin(void)
+{
+    __u64 pid_tgid = bpf_get_current_pid_tgid();
+    __u32 tid = (__u32)pid_tgid;
+    __u64 now = bpf_ktime_get_ns();
+    struct memory_stall_thread *thread;
+
+    if (!smoothtask_task_allowed(pid_tgid >> 32))
+        return 0;
+
+    thread = bpf_map_lookup_elem(&memory_stall_thread_map, &tid);
+    if (!thread) {
+        struct memory_stall_thread new_thread = {
+            .reclaim_start_ns = now,
+        };
+
+        smoothtask_map_update(&memory_stall_thread_map, &tid, &new_thread, BPF_NOEXIST);
+        return 0;
+    }
+
+    thread->reclaim_start_ns = now;
+    return 0;
+}
+
+static __always_inline int reclaim_end(void)
+{
+    struct memory_stall_thread *thread = current_thread();
+    __u64 now = bpf_ktime_get_ns();
+
+    if (!thread || !thread->reclaim_start_ns)
+        return 0;
+
+    __u64 start_ns = thread->reclaim_start_ns;
+    thread->reclaim_start_ns = 0;
+    if (now <= start_ns)
+        return 0;
+
+    struct memory_stall_counters delta = {
+        .reclaims = 1,
+        .reclaim_ns = now - start_ns,
+    };
+
+    // Внутри отказа общая задержка учитывается при его завершении
+    if (thread->fault_start_ns)
+        thread->fault_reclaim_ns += delta.reclaim_ns;
+    else
+        delta.stall_ns = delta.reclaim_ns;
+
+    account_stall(&delta, now);
+    return 0;
+}
+
+// Прямое освобождение памяти при нехватке свободных страниц в зоне
+SEC("tp_btf/mm_vmscan_direct_reclaim_begin")
+int BPF_PROG(trace_direct_reclaim_begin)
+{
+    return reclaim_begin();
+}
+
+SEC("tp_btf/mm_vmscan_direct_reclaim_end")
+int BPF_PROG(trace_direct_reclaim_end)
+{
+    return reclaim_end();
+}
+
+// Освобождение памяти при достижении лимита memcg
+SEC("tp_btf/mm_vmscan_memcg_reclaim_begin")
+int BPF_PROG(trace_memcg_reclaim_begin)
+{
+    return reclaim_begin();
+}
+
+SEC("tp_btf/mm_vmscan_memcg_reclaim_end")
+int BPF_PROG(trace_memcg_reclaim_end)
+{
+    return reclaim_end();
+}
+
+// Лицензия для eBPF программы
+char _license[] SEC("license") = "GPL";
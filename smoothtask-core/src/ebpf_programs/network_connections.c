@@ -2,161 +2,157 @@
 /* Copyright (c) 2024 SmoothTask Project */
 
 // eBPF программа для мониторинга сетевых соединений
-// Отслеживает активные TCP/UDP соединения и их состояние
+// Отслеживает активные TCP соединения (IPv4 и IPv6), их состояние и трафик
+//
+// Соединение хранится одной компактной записью в LRU_HASH карте с ключом
+// cookie сокета: ключ не имеет коллизий, а LRU вытесняет самые старые записи
+// вместо отказа при заполнении таблицы. На TCP_CLOSE запись удаляется, поэтому
+// карта содержит только живые соединения. На каждое событие приходится одно
+// обращение к карте.
 
-#include <linux/bpf.h>
+#include "vmlinux.h"
 #include <bpf/bpf_helpers.h>
 #include <bpf/bpf_tracing.h>
-#include <linux/if_ether.h>
-#include <linux/ip.h>
-#include <linux/tcp.h>
-#include <linux/udp.h>
-#include <linux/in.h>
+#include <bpf/bpf_core_read.h>
+#include <bpf/bpf_endian.h>
+#include "smoothtask_debug.h"
 
 // Максимальное количество отслеживаемых соединений
-#define MAX_CONNECTIONS 2048
-
-// Структура для хранения информации о сетевых соединениях
-struct connection_info {
-    __u32 saddr;           // Источник IP адрес
-    __u32 daddr;           // Назначение IP адрес
-    __u16 sport;           // Источник порт
-    __u16 dport;           // Назначение порт
-    __u8 protocol;         // Протокол (TCP/UDP)
-    __u8 state;            // Состояние соединения
-    __u64 packets;         // Количество пакетов
+#define MAX_CONNECTIONS 65536
+
+// Константы ядра, недоступные рядом с vmlinux.h
+#define CONN_AF_INET  2
+#define CONN_AF_INET6 10
+#define CONN_IPPROTO_TCP 6
+#define CONN_TCP_CLOSE 7
+#define CONN_TCP_SYN_SENT 2
+#define CONN_TCP_LISTEN 10
+
+// Запись соединения (80 байт, раскладка совпадает с RawConnectionRecord в ebpf_net.rs).
+// Для IPv4 адрес занимает первые 4 байта полей адресов.
+struct connection_record {
+    __u8 saddr[16];        // Адрес источника
+    __u8 daddr[16];        // Адрес назначения
+    __u16 sport;           // Порт источника (порядок байт хоста)
+    __u16 dport;           // Порт назначения (порядок байт хоста)
+    __u16 family;          // AF_INET или AF_INET6
+    __u8 protocol;         // Протокол
+    __u8 state;            // Состояние TCP
+    __u32 tgid;            // Процесс-владелец (0, пока неизвестен)
+    __u32 _pad;
+    __u64 packets;         // Количество операций отправки и чтения
     __u64 bytes;           // Количество байт
     __u64 start_time;      // Время начала соединения
     __u64 last_activity;   // Время последней активности
 };
 
-// Карта для хранения информации о соединениях
+// Активные соединения по cookie сокета
 struct {
-    __uint(type, BPF_MAP_TYPE_HASH);
+    __uint(type, BPF_MAP_TYPE_LRU_HASH);
     __uint(max_entries, MAX_CONNECTIONS);
-    __type(key, __u64);  // Уникальный идентификатор соединения
-    __type(value, struct connection_info);
+    __type(key, __u64);
+    __type(value, struct connection_record);
 } connection_map SEC(".maps");
 
-// Карта для хранения статистики по соединениям
-struct {
-    __uint(type, BPF_MAP_TYPE_HASH);
-    __uint(max_entries, MAX_CONNECTIONS);
-    __type(key, __u64);  // Уникальный идентификатор соединения
-    __type(value, __u64); // Количество соединений
-} connection_stats_map SEC(".maps");
+static __always_inline void record_tuple(struct connection_record *record, const struct sock *sk)
+{
+    record->family = BPF_CORE_READ(sk, __sk_common.skc_family);
+    record->sport = BPF_CORE_READ(sk, __sk_common.skc_num);
+    record->dport = bpf_ntohs(BPF_CORE_READ(sk, __sk_common.skc_dport));
+    record->protocol = CONN_IPPROTO_TCP;
 
-// Карта для хранения активных соединений
-struct {
-    __uint(type, BPF_MAP_TYPE_HASH);
-    __uint(max_entries, MAX_CONNECTIONS);
-    __type(key, __u64);  // Уникальный идентификатор соединения
-    __type(value, __u8); // Флаг активности
-} active_connections_map SEC(".maps");
-
-// Точка входа для отслеживания TCP соединений
-SEC("tracepoint/sock/sock_inet_sock_set_state")
-int trace_tcp_connection(struct trace_event_raw_sock_inet_sock_set_state *ctx) {
-    __u64 conn_id = 0;
-    struct connection_info conn_info = {};
-    
-    // Извлекаем информацию о соединении
-    conn_info.saddr = ctx->saddr;
-    conn_info.daddr = ctx->daddr;
-    conn_info.sport = ctx->sport;
-    conn_info.dport = ctx->dport;
-    conn_info.protocol = IPPROTO_TCP;
-    conn_info.state = ctx->newstate;
-    conn_info.start_time = bpf_ktime_get_ns();
-    conn_info.last_activity = bpf_ktime_get_ns();
-    
-    // Создаем уникальный идентификатор соединения
-    conn_id = (__u64)conn_info.saddr << 32 | conn_info.daddr;
-    conn_id ^= (__u64)conn_info.sport << 16 | conn_info.dport;
-    
-    // Сохраняем информацию о соединении
-    bpf_map_update_elem(&connection_map, &conn_id, &conn_info, BPF_ANY);
-    
-    // Обновляем статистику соединений
-    __u64 *count = bpf_map_lookup_elem(&connection_stats_map, &conn_id);
-    if (count) {
-        __sync_fetch_and_add(count, 1);
+    if (record->family == CONN_AF_INET6) {
+        BPF_CORE_READ_INTO(&record->saddr, sk, __sk_common.skc_v6_rcv_saddr.in6_u.u6_addr8);
+        BPF_CORE_READ_INTO(&record->daddr, sk, __sk_common.skc_v6_daddr.in6_u.u6_addr8);
     } else {
-        __u64 new_count = 1;
-        bpf_map_update_elem(&connection_stats_map, &conn_id, &new_count, BPF_ANY);
+        BPF_CORE_READ_INTO((__be32 *)record->saddr, sk, __sk_common.skc_rcv_saddr);
+        BPF_CORE_READ_INTO((__be32 *)record->daddr, sk, __sk_common.skc_daddr);
     }
-    
-    // Помечаем соединение как активное
-    __u8 active = 1;
-    bpf_map_update_elem(&active_connections_map, &conn_id, &active, BPF_ANY);
-    
-    return 0;
 }
 
-// Точка входа для отслеживания UDP пакетов
-SEC("tracepoint/net/netif_receive_skb")
-int trace_udp_packet(struct trace_event_raw_netif_receive_skb *ctx) {
-    // В реальной реализации здесь будет анализ UDP пакетов
-    // Пока что это заглушка
+// Точка входа для отслеживания состояния TCP соединений
+SEC("tp_btf/inet_sock_set_state")
+int BPF_PROG(trace_tcp_connection, const struct sock *sk, int oldstate, int newstate)
+{
+    struct connection_record *record;
+    __u64 cookie;
+    __u64 now;
+
+    if (BPF_CORE_READ(sk, sk_protocol) != CONN_IPPROTO_TCP)
+        return 0;
+
+    cookie = bpf_get_socket_cookie((void *)sk);
+
+    // Закрытое соединение удаляется сразу, не дожидаясь вытеснения
+    if (newstate == CONN_TCP_CLOSE) {
+        bpf_map_delete_elem(&connection_map, &cookie);
+        return 0;
+    }
+
+    // Слушающие сокеты соединениями не считаются
+    if (newstate == CONN_TCP_LISTEN)
+        return 0;
+
+    now = bpf_ktime_get_ns();
+    record = bpf_map_lookup_elem(&connection_map, &cookie);
+    if (record) {
+        record->state = newstate;
+        record->last_activity = now;
+        return 0;
+    }
+
+    struct connection_record new_record = {};
+
+    record_tuple(&new_record, sk);
+    new_record.state = newstate;
+    new_record.start_time = now;
+    new_record.last_activity = now;
+    // connect() выполняется в контексте процесса, остальные переходы — часто в softirq
+    if (oldstate == CONN_TCP_CLOSE && newstate == CONN_TCP_SYN_SENT)
+        new_record.tgid = bpf_get_current_pid_tgid() >> 32;
+
+    smoothtask_map_update(&connection_map, &cookie, &new_record, BPF_NOEXIST);
     return 0;
 }
 
-// Точка входа для отслеживания сетевых пакетов
-SEC("tracepoint/net/net_dev_queue")
-int trace_network_packet(struct trace_event_raw_net_dev_queue *ctx) {
-    // В реальной реализации здесь будет анализ сетевых пакетов
-    // Пока что это заглушка
+// Учесть переданные данные отслеживаемого соединения.
+// tcp_sendmsg() и tcp_cleanup_rbuf() выполняются под блокировкой сокета,
+// поэтому запись соединения обновляется без атомарных операций.
+static __always_inline int account_connection(struct sock *sk, long bytes)
+{
+    struct connection_record *record;
+    __u64 cookie;
+
+    if (bytes <= 0)
+        return 0;
+
+    cookie = bpf_get_socket_cookie(sk);
+    record = bpf_map_lookup_elem(&connection_map, &cookie);
+    if (!record)
+        return 0;
+
+    // Владелец принятого соединения известен только с первой передачи данных
+    if (!record->tgid)
+        record->tgid = bpf_get_current_pid_tgid() >> 32;
+    record->packets += 1;
+    record->bytes += bytes;
+    record->last_activity = bpf_ktime_get_ns();
     return 0;
 }
 
-// Точка входа для отслеживания закрытия соединений
-SEC("tracepoint/sock/sock_inet_sock_set_state")
-int trace_connection_close(struct trace_event_raw_sock_inet_sock_set_state *ctx) {
-    __u64 conn_id = 0;
-    struct connection_info *conn_info;
-    
-    // Создаем уникальный идентификатор соединения
-    conn_id = (__u64)ctx->saddr << 32 | ctx->daddr;
-    conn_id ^= (__u64)ctx->sport << 16 | ctx->dport;
-    
-    // Получаем информацию о соединении
-    conn_info = bpf_map_lookup_elem(&connection_map, &conn_id);
-    if (conn_info) {
-        // Обновляем время последней активности
-        conn_info->last_activity = bpf_ktime_get_ns();
-        conn_info->state = ctx->newstate;
-        
-        // Обновляем информацию о соединении
-        bpf_map_update_elem(&connection_map, &conn_id, conn_info, BPF_ANY);
-    }
-    
-    return 0;
+// Точка входа для отслеживания отправки данных
+SEC("fexit/tcp_sendmsg")
+int BPF_PROG(trace_connection_send, struct sock *sk, struct msghdr *msg, size_t size, int ret)
+{
+    return account_connection(sk, ret);
 }
 
-// Точка входа для отслеживания передачи данных
-SEC("tracepoint/sock/sock_inet_sock_set_state")
-int trace_connection_data(struct trace_event_raw_sock_inet_sock_set_state *ctx) {
-    __u64 conn_id = 0;
-    struct connection_info *conn_info;
-    
-    // Создаем уникальный идентификатор соединения
-    conn_id = (__u64)ctx->saddr << 32 | ctx->daddr;
-    conn_id ^= (__u64)ctx->sport << 16 | ctx->dport;
-    
-    // Получаем информацию о соединении
-    conn_info = bpf_map_lookup_elem(&connection_map, &conn_id);
-    if (conn_info) {
-        // Увеличиваем счетчики пакетов и байт
-        conn_info->packets += 1;
-        conn_info->bytes += 1024; // Примерное значение
-        conn_info->last_activity = bpf_ktime_get_ns();
-        
-        // Обновляем информацию о соединении
-        bpf_map_update_elem(&connection_map, &conn_id, conn_info, BPF_ANY);
-    }
-    
-    return 0;
+// Точка входа для отслеживания получения данных
+SEC("fentry/tcp_cleanup_rbuf")
+int BPF_PROG(trace_connection_receive, struct sock *sk, int copied)
+{
+    return account_connection(sk, copied);
 }
 
 // Лицензия для eBPF программы
-char _license[] SEC("license") = "GPL";
\ No newline at end of file
+char _license[] SEC("license") = "GPL";
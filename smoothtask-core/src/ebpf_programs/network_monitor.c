@@ -7,6 +7,8 @@
 #include <linux/bpf.h>
 #include <bpf/bpf_helpers.h>
 #include <bpf/bpf_tracing.h>
+#include "smoothtask_counters.h"
+#include "smoothtask_sampling.h"
 #include <linux/if_ether.h>
 #include <linux/ip.h>
 #include <linux/tcp.h>
@@ -33,25 +35,17 @@ struct {
 } network_stats_map SEC(".maps");
 
 // Карта для хранения общего количества пакетов
-struct {
-    __uint(type, BPF_MAP_TYPE_PERCPU_ARRAY);
-    __uint(max_entries, 1);
-    __type(key, __u32);
-    __type(value, __u64);
-} total_packet_count_map SEC(".maps");
+SMOOTHTASK_PERCPU_COUNTER(total_packet_count_map, 1);
 
 // Точка входа для отслеживания сетевых пакетов
 SEC("tracepoint/net/netif_receive_skb")
 int trace_network_packet(struct trace_event_raw_netif_receive_skb *ctx)
 {
-    __u32 key = 0;
-    __u64 *count;
-    
-    // Увеличиваем общее количество пакетов
-    count = bpf_map_lookup_elem(&total_packet_count_map, &key);
-    if (count) {
-        __sync_fetch_and_add(count, 1);
-    }
+    __u32 weight = smoothtask_sample(SMOOTHTASK_SAMPLE_NET_RX);
+
+    // Увеличиваем общее количество пакетов на вес выбранного события
+    if (weight)
+        percpu_counter_add(&total_packet_count_map, 0, weight);
     
     // В реальной реализации здесь будет анализ пакетов
     // Пока что это заглушка
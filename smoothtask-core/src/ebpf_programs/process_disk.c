@@ -2,138 +2,308 @@
 /* Copyright (c) 2024 SmoothTask Project */
 
 // eBPF программа для мониторинга дисковой активности на уровне процессов
-// Отслеживает операции чтения/записи на диск для каждого процесса
+// Отслеживает операции чтения/записи на диск для каждого процесса, задержку
+// запросов и глубину очереди устройств
+//
+// Запись процесса хранится в task-local storage лидера группы потоков
+// (см. smoothtask_task_state.h) и выгружается итератором dump_process_disk.
+//
+// Запрос блочного уровня сопоставляется между точками трассировки по паре
+// (устройство, начальный сектор) в LRU карте disk_requests. Владельцем
+// запроса считается процесс, в контексте которого запрос вставлен в очередь
+// планировщика (block_rq_insert) или, без планировщика, выдан устройству
+// (block_rq_issue): рабочие потоки kblockd, выдающие запросы из очереди
+// планировщика, владельцами не становятся. Задержка от выдачи до завершения
+// накапливается в per-CPU log2 гистограммах по паре (процесс, устройство).
+// Объём и число операций дополнительно суммируются по cgroup владельца
+// (см. smoothtask_cgroup.h).
 
-#include <linux/bpf.h>
+#include "vmlinux.h"
 #include <bpf/bpf_helpers.h>
 #include <bpf/bpf_tracing.h>
-#include <linux/fs.h>
+#include <bpf/bpf_core_read.h>
+#include "smoothtask_bpf.h"
+#include "smoothtask_debug.h"
+#include "smoothtask_cgroup.h"
+#include "smoothtask_counters.h"
+#include "smoothtask_filter.h"
+#include "smoothtask_latency.h"
+#include "smoothtask_task_state.h"
 
-// Максимальное количество отслеживаемых процессов
+// Максимальное количество процессов legacy варианта
 #define MAX_PROCESS_DISK_STATS 4096
 
-// Структура для хранения статистики дисковой активности процесса
-struct process_disk_stats {
-    __u64 bytes_read;
-    __u64 bytes_written;
-    __u64 read_operations;
-    __u64 write_operations;
-    __u64 last_timestamp;
-    __u32 pid;
-    __u32 tgid;
+// Запросов между вставкой в очередь и завершением
+#define MAX_DISK_REQUESTS 16384
+
+// Пар (процесс, устройство) с гистограммами задержек
+#define MAX_DISK_LATENCY_HISTOGRAMS 2048
+
+// Блочных устройств
+#define MAX_DISK_DEVICES 256
+
+struct disk_request_key {
+    __u32 dev;
+    __u32 pad;
+    __u64 sector;
+};
+
+// Запрос между вставкой в очередь и завершением
+struct disk_request {
+    __u64 issue_ns;             // Выдача устройству (0 — ещё в очереди планировщика)
+    __u32 tgid;                 // Владелец запроса
+    __u32 pad;
+};
+
+// Ключ гистограммы (раскладка совпадает с RawDiskLatencyKey в ebpf_disk.rs)
+struct disk_latency_key {
+    __u32 tgid;                 // 0 — запрос без владельца (например, отфильтрованный)
+    __u32 dev;
+};
+
+// Очередь устройства (раскладка совпадает с RawDiskDeviceStats в ebpf_disk.rs)
+struct disk_device_stats {
+    __u32 dev;
+    __u32 pad;
+    __s64 inflight;             // Выданные устройству и ещё не завершённые запросы
+    __u64 max_inflight;
+    __u64 depth_sum;            // Сумма глубины очереди в момент выдачи запросов
+    __u64 issued;
+    __u64 completed;
 };
 
-// Карта для хранения статистики дисковой активности по PID
+// Статистика дисковой активности процессов (struct process_disk_stats в smoothtask_bpf.h)
+SMOOTHTASK_TASK_STATE(process_disk_stats_map, struct process_disk_stats, MAX_PROCESS_DISK_STATS);
+
+// Запросы в пути; LRU вытесняет запросы, завершение которых не было увидено
 struct {
-    __uint(type, BPF_MAP_TYPE_HASH);
-    __uint(max_entries, MAX_PROCESS_DISK_STATS);
-    __type(key, __u32);  // PID процесса
-    __type(value, struct process_disk_stats);
-} process_disk_stats_map SEC(".maps");
+    __uint(type, BPF_MAP_TYPE_LRU_HASH);
+    __uint(max_entries, MAX_DISK_REQUESTS);
+    __type(key, struct disk_request_key);
+    __type(value, struct disk_request);
+} disk_requests SEC(".maps");
 
-// Карта для хранения общего количества операций ввода-вывода
+// Per-CPU гистограммы задержек запросов по процессу и устройству
+struct {
+    __uint(type, BPF_MAP_TYPE_LRU_PERCPU_HASH);
+    __uint(max_entries, MAX_DISK_LATENCY_HISTOGRAMS);
+    __type(key, struct disk_latency_key);
+    __type(value, struct smoothtask_latency_hist);
+} disk_latency_map SEC(".maps");
+
+// Глубина очереди по устройству
 struct {
-    __uint(type, BPF_MAP_TYPE_PERCPU_ARRAY);
-    __uint(max_entries, 1);
+    __uint(type, BPF_MAP_TYPE_HASH);
+    __uint(max_entries, MAX_DISK_DEVICES);
     __type(key, __u32);
-    __type(value, __u64);
-} total_io_operations_count_map SEC(".maps");
+    __type(value, struct disk_device_stats);
+} disk_device_map SEC(".maps");
 
-// Точка входа для отслеживания операций чтения с диска
-SEC("tracepoint/block/block_rq_issue")
-int trace_process_disk_read(struct trace_event_raw_block_rq_issue *ctx)
+// Per-CPU итоги по cgroup владельца запроса (struct disk_cgroup_stats в smoothtask_bpf.h)
+SMOOTHTASK_CGROUP_MAP(disk_cgroup_map, struct disk_cgroup_stats);
+
+// Карта для хранения общего количества операций ввода-вывода
+SMOOTHTASK_PERCPU_COUNTER(total_io_operations_count_map, 1);
+
+// Учесть запрос в записи текущего процесса; возвращает TGID владельца или 0,
+// если процесс не учитывается (ядро, фильтр, запрос без данных)
+static __always_inline __u32 account_request(const char *rwbs, __u32 bytes)
 {
-    __u32 pid = bpf_get_current_pid_tgid() >> 32;
-    __u32 tgid = bpf_get_current_pid_tgid();
-    
-    if (pid == 0) {
+    __u32 tgid = bpf_get_current_pid_tgid() >> 32;
+    char op = smoothtask_rwbs_op(rwbs);
+
+    if (tgid == 0) {
         return 0; // Пропускаем ядро
     }
-    
-    // Проверяем, что это операция чтения
-    if (ctx->rwbs != 0 && (ctx->rwbs & 1) == 0) {
-        return 0; // Не операция чтения
+
+    if (!smoothtask_task_allowed(tgid)) {
+        return 0; // Процесс отфильтрован конфигурацией
     }
-    
+
+    if (!op)
+        return 0; // Не операция чтения или записи
+
+    struct task_struct *task = smoothtask_current_task();
+    struct disk_cgroup_stats zero = {};
+    struct disk_cgroup_stats *cgroup;
     struct process_disk_stats *stats;
-    
-    // Получаем или создаем статистику для этого PID
-    stats = bpf_map_lookup_elem(&process_disk_stats_map, &pid);
+
+    // Получаем или создаем статистику процесса
+    stats = smoothtask_task_state_lookup(&process_disk_stats_map, task);
     if (!stats) {
         struct process_disk_stats new_stats = {};
-        new_stats.pid = pid;
         new_stats.tgid = tgid;
-        new_stats.last_timestamp = bpf_ktime_get_ns();
-        bpf_map_update_elem(&process_disk_stats_map, &pid, &new_stats, BPF_ANY);
-        stats = bpf_map_lookup_elem(&process_disk_stats_map, &pid);
+        stats = smoothtask_task_state_create(&process_disk_stats_map, task, &new_stats);
         if (!stats) {
             return 0;
         }
     }
-    
-    // Обновляем статистику чтения
-    stats->bytes_read += ctx->bytes;
-    stats->read_operations += 1;
+
+    if (op == 'R') {
+        stats->bytes_read += bytes;
+        stats->read_operations += 1;
+    } else {
+        stats->bytes_written += bytes;
+        stats->write_operations += 1;
+    }
     stats->last_timestamp = bpf_ktime_get_ns();
-    
+
+    cgroup = smoothtask_cgroup_entry(&disk_cgroup_map, &zero);
+    if (cgroup) {
+        if (op == 'R') {
+            cgroup->bytes_read += bytes;
+            cgroup->read_operations += 1;
+        } else {
+            cgroup->bytes_written += bytes;
+            cgroup->write_operations += 1;
+        }
+    }
+
+    return tgid;
+}
+
+static __always_inline struct disk_device_stats *lookup_device(__u32 dev)
+{
+    struct disk_device_stats *stats = bpf_map_lookup_elem(&disk_device_map, &dev);
+
+    if (stats)
+        return stats;
+
+    struct disk_device_stats new_stats = {
+        .dev = dev,
+    };
+    smoothtask_map_update(&disk_device_map, &dev, &new_stats, BPF_NOEXIST);
+    return smoothtask_lookup_created(&disk_device_map, &dev);
+}
+
+// Вставка в очередь планировщика: запрос ещё в контексте процесса-владельца
+SEC("tracepoint/block/block_rq_insert")
+int trace_process_disk_insert(struct trace_event_raw_block_rq *ctx)
+{
+    struct disk_request_key key = {
+        .dev = ctx->dev,
+        .sector = ctx->sector,
+    };
+    struct disk_request request = {};
+
+    // Запросы без данных (flush) не имеют собственного сектора
+    if (ctx->nr_sector == 0)
+        return 0;
+
+    request.tgid = account_request(ctx->rwbs, ctx->bytes);
+    smoothtask_map_update(&disk_requests, &key, &request, BPF_ANY);
     return 0;
 }
 
-// Точка входа для отслеживания операций записи на диск
+// Выдача устройству: начало отсчёта задержки и рост глубины очереди
 SEC("tracepoint/block/block_rq_issue")
-int trace_process_disk_write(struct trace_event_raw_block_rq_issue *ctx)
+int trace_process_disk_io(struct trace_event_raw_block_rq *ctx)
 {
-    __u32 pid = bpf_get_current_pid_tgid() >> 32;
-    __u32 tgid = bpf_get_current_pid_tgid();
-    
-    if (pid == 0) {
-        return 0; // Пропускаем ядро
-    }
-    
-    // Проверяем, что это операция записи
-    if (ctx->rwbs != 2 && (ctx->rwbs & 2) == 0) {
-        return 0; // Не операция записи
-    }
-    
-    struct process_disk_stats *stats;
-    
-    // Получаем или создаем статистику для этого PID
-    stats = bpf_map_lookup_elem(&process_disk_stats_map, &pid);
-    if (!stats) {
-        struct process_disk_stats new_stats = {};
-        new_stats.pid = pid;
-        new_stats.tgid = tgid;
-        new_stats.last_timestamp = bpf_ktime_get_ns();
-        bpf_map_update_elem(&process_disk_stats_map, &pid, &new_stats, BPF_ANY);
-        stats = bpf_map_lookup_elem(&process_disk_stats_map, &pid);
-        if (!stats) {
+    struct disk_request_key key = {
+        .dev = ctx->dev,
+        .sector = ctx->sector,
+    };
+    __u64 now = bpf_ktime_get_ns();
+
+    if (ctx->nr_sector == 0)
+        return 0;
+
+    struct disk_request *request = bpf_map_lookup_elem(&disk_requests, &key);
+    if (request) {
+        // Повторная выдача после requeue уже учтена в очереди устройства
+        bool reissue = request->issue_ns != 0;
+
+        request->issue_ns = now;
+        if (reissue)
+            return 0;
+    } else {
+        // Запрос выдан в обход планировщика — в контексте владельца
+        struct disk_request new_request = {
+            .issue_ns = now,
+            .tgid = account_request(ctx->rwbs, ctx->bytes),
+        };
+        if (smoothtask_map_update(&disk_requests, &key, &new_request, BPF_ANY))
             return 0;
-        }
     }
-    
-    // Обновляем статистику записи
-    stats->bytes_written += ctx->bytes;
-    stats->write_operations += 1;
-    stats->last_timestamp = bpf_ktime_get_ns();
-    
+
+    struct disk_device_stats *device = lookup_device(ctx->dev);
+    if (!device)
+        return 0;
+
+    __sync_fetch_and_add(&device->inflight, 1);
+    __sync_fetch_and_add(&device->issued, 1);
+
+    // Глубина читается после увеличения: значение приблизительно при
+    // одновременной выдаче на нескольких CPU
+    __s64 depth = device->inflight;
+    if (depth > 0) {
+        __sync_fetch_and_add(&device->depth_sum, depth);
+        if ((__u64)depth > device->max_inflight)
+            device->max_inflight = depth;
+    }
+
     return 0;
 }
 
-// Точка входа для отслеживания общего количества операций ввода-вывода
+// Завершение: задержка от выдачи и уменьшение глубины очереди
 SEC("tracepoint/block/block_rq_complete")
-int trace_total_io_operations(struct trace_event_raw_block_rq_complete *ctx)
+int trace_total_io_operations(struct trace_event_raw_block_rq_completion *ctx)
 {
-    __u32 key = 0;
-    __u64 *count;
-    
+    struct disk_request_key key = {
+        .dev = ctx->dev,
+        .sector = ctx->sector,
+    };
+    __u64 now = bpf_ktime_get_ns();
+
     // Увеличиваем общее количество операций ввода-вывода
-    count = bpf_map_lookup_elem(&total_io_operations_count_map, &key);
-    if (count) {
-        __sync_fetch_and_add(count, 1);
+    percpu_counter_inc(&total_io_operations_count_map, 0);
+
+    struct disk_request *entry = bpf_map_lookup_elem(&disk_requests, &key);
+    if (!entry)
+        return 0;
+
+    struct disk_request request = *entry;
+    bpf_map_delete_elem(&disk_requests, &key);
+
+    // Запрос завершён без выдачи устройству (например, ошибкой в очереди)
+    if (!request.issue_ns)
+        return 0;
+
+    struct disk_device_stats *device = bpf_map_lookup_elem(&disk_device_map, &key.dev);
+    if (device) {
+        __sync_fetch_and_add(&device->inflight, -1);
+        __sync_fetch_and_add(&device->completed, 1);
+    }
+
+    struct disk_latency_key hist_key = {
+        .tgid = request.tgid,
+        .dev = key.dev,
+    };
+    struct smoothtask_latency_hist *hist = bpf_map_lookup_elem(&disk_latency_map, &hist_key);
+    if (!hist) {
+        struct smoothtask_latency_hist empty = {};
+        smoothtask_map_update(&disk_latency_map, &hist_key, &empty, BPF_NOEXIST);
+        hist = smoothtask_lookup_created(&disk_latency_map, &hist_key);
     }
-    
+    if (hist)
+        smoothtask_hist_record(hist, now > request.issue_ns ? now - request.issue_ns : 0, 1);
+
     return 0;
 }
 
+#ifdef SMOOTHTASK_TASK_STATE_LEGACY
+// Удаление записи завершившегося процесса; в task storage запись
+// освобождается вместе с задачей, и обработчик не нужен
+SEC("tp_btf/sched_process_exit")
+int BPF_PROG(trace_process_exit, struct task_struct *p)
+{
+    smoothtask_task_state_exit(&process_disk_stats_map, p);
+    return 0;
+}
+#endif
+
+// Выгрузка записей процессов в userspace
+SMOOTHTASK_TASK_STATE_ITER(dump_process_disk, process_disk_stats_map, struct process_disk_stats)
+
 // Лицензия для eBPF программы
-char _license[] SEC("license") = "GPL";
\ No newline at end of file
+char _license[] SEC("license") = "GPL";
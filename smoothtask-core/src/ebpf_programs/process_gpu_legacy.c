@@ -0,0 +1,9 @@
+// SPDX-License-Identifier: GPL-2.0 OR BSD-2-Clause
+/* Copyright (c) 2025 SmoothTask Authors */
+
+// Вариант process_gpu.c для ядер без BPF_MAP_TYPE_TASK_STORAGE (до Linux 5.11):
+// состояние процессов хранится в HASH карте с ключом TGID
+// (см. smoothtask_task_state.h)
+
+#define SMOOTHTASK_TASK_STATE_LEGACY
+#include "process_gpu.c"
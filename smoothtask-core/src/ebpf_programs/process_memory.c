@@ -3,40 +3,57 @@
 
 // eBPF program for monitoring process memory usage
 // Tracks memory allocations, deallocations, and usage patterns per process
+//
+// Periodic RSS snapshots are taken by the shared scheduler probe in
+// sched_monitor.c (sched_task_map) instead of a kprobe on finish_task_switch
+//
+// The record of a process is written only when its RSS moved by at least
+// rss_delta_pages since the last write; otherwise the handler returns after
+// a single lookup. Fields whose layout differs between kernels (rss_stat,
+// stack_vm) are read through CO-RE probes in smoothtask_task_fields.h.
 
 #include "vmlinux.h"
 #include <bpf/bpf_helpers.h>
 #include <bpf/bpf_tracing.h>
 #include <bpf/bpf_core_read.h>
+#include "smoothtask_debug.h"
+#include "smoothtask_task_fields.h"
 
-// Configuration structure for process memory monitoring
+#define MAX_MEMORY_PROCESSES 10240
+
+// Configuration written by userspace at load time
+// (layout matches RawProcessMemoryConfig in ebpf_memory.rs)
 struct process_memory_config {
-    bool enable_detailed_stats;
-    u32 sampling_rate;
-    u64 min_memory_threshold;
+    __u32 enabled;
+    __u32 sampling_rate;     // Handle one event out of N (0 and 1 handle all)
+    __u64 rss_delta_pages;   // Minimum RSS change that rewrites the record
 };
 
-// Memory statistics structure
+// Memory statistics of a process, sizes in pages unless noted
+// (layout matches RawProcessMemoryStat in ebpf_memory.rs)
 struct process_memory_stat {
-    u32 pid;
-    u64 timestamp;
-    u64 rss_bytes;
-    u64 vms_bytes;
-    u64 shared_bytes;
-    u64 swap_bytes;
-    u64 heap_usage;
-    u64 stack_usage;
-    u64 anonymous_memory;
-    u64 file_backed_memory;
-    u64 major_faults;
-    u64 minor_faults;
+    __u32 pid;
+    __u32 tgid;
+    __u64 last_update_ns;
+    __u64 rss_pages;
+    __u64 vm_pages;
+    __u64 shared_pages;      // File-backed and shmem resident pages
+    __u64 swap_pages;
+    __u64 anon_pages;
+    __u64 file_pages;
+    __u64 stack_pages;
+    __u64 heap_bytes;        // brk - start_brk
+    __u64 major_faults;
+    __u64 minor_faults;
+    __u64 updates;           // Number of record writes
+    char comm[16];
 };
 
 // BPF map for storing process memory statistics
 struct {
     __uint(type, BPF_MAP_TYPE_HASH);
-    __uint(max_entries, 10240);
-    __type(key, u32); // PID
+    __uint(max_entries, MAX_MEMORY_PROCESSES);
+    __type(key, __u32); // TGID
     __type(value, struct process_memory_stat);
 } process_memory_stats SEC(".maps");
 
@@ -44,174 +61,118 @@ struct {
 struct {
     __uint(type, BPF_MAP_TYPE_ARRAY);
     __uint(max_entries, 1);
-    __type(key, u32);
+    __type(key, __u32);
     __type(value, struct process_memory_config);
 } process_memory_config_map SEC(".maps");
 
-// Helper function to get current timestamp in nanoseconds
-static inline u64 get_current_timestamp() {
-    return bpf_ktime_get_ns();
+// stack_vm is absent from some stripped-down BTF; probe before reading
+static __always_inline __u64 read_stack_pages(struct mm_struct *mm)
+{
+    if (!bpf_core_field_exists(mm->stack_vm))
+        return 0;
+    return BPF_CORE_READ(mm, stack_vm);
+}
+
+// Fill the record in place from the task's address space
+static __always_inline void fill_memory_stat(struct process_memory_stat *stat,
+                                             struct task_struct *task,
+                                             struct mm_struct *mm, __u64 rss_pages)
+{
+    __s64 anon = smoothtask_mm_counter(mm, SMOOTHTASK_MM_ANONPAGES);
+    __s64 file = smoothtask_mm_counter(mm, SMOOTHTASK_MM_FILEPAGES);
+    __s64 shmem = smoothtask_mm_counter(mm, SMOOTHTASK_MM_SHMEMPAGES);
+    unsigned long start_brk = BPF_CORE_READ(mm, start_brk);
+    unsigned long brk = BPF_CORE_READ(mm, brk);
+    struct signal_struct *signal = BPF_CORE_READ(task, signal);
+
+    stat->last_update_ns = bpf_ktime_get_ns();
+    stat->rss_pages = rss_pages;
+    stat->vm_pages = BPF_CORE_READ(mm, total_vm);
+    stat->anon_pages = anon > 0 ? anon : 0;
+    stat->file_pages = file > 0 ? file : 0;
+    stat->shared_pages = stat->file_pages + (shmem > 0 ? shmem : 0);
+    stat->swap_pages = smoothtask_task_swap_pages(task);
+    stat->stack_pages = read_stack_pages(mm);
+    stat->heap_bytes = brk > start_brk ? brk - start_brk : 0;
+    // Process-wide fault counters of exited threads plus the current thread
+    stat->major_faults = BPF_CORE_READ(task, maj_flt) + BPF_CORE_READ(signal, maj_flt);
+    stat->minor_faults = BPF_CORE_READ(task, min_flt) + BPF_CORE_READ(signal, min_flt);
+    stat->updates += 1;
 }
 
-// Trace memory allocation events
-SEC("tracepoint/syscalls/sys_enter_mmap")
-int trace_mmap_enter(struct trace_event_raw_sys_enter *ctx) {
-    u32 pid = bpf_get_current_pid_tgid() >> 32;
-    
-    // Check if we should sample this event
-    u32 index = 0;
+// Refresh the record of the current process if its RSS moved enough
+static __always_inline int update_memory_stat(void)
+{
+    __u32 index = 0;
     struct process_memory_config *config = bpf_map_lookup_elem(&process_memory_config_map, &index);
-    if (!config || !config->enable_detailed_stats) {
+    if (!config || !config->enabled)
         return 0;
-    }
-    
+
     // Sample at configured rate
-    u32 sample_key = bpf_get_prandom_u32() % config->sampling_rate;
-    if (sample_key != 0) {
+    if (config->sampling_rate > 1 && bpf_get_prandom_u32() % config->sampling_rate != 0)
         return 0;
-    }
-    
-    // Get current memory stats for this process
-    struct process_memory_stat stat = {};
-    stat.pid = pid;
-    stat.timestamp = get_current_timestamp();
-    
-    // Read memory statistics from task struct
-    struct task_struct *task = (struct task_struct *)bpf_get_current_task();
-    
-    // Read RSS (Resident Set Size)
-    stat.rss_bytes = BPF_CORE_READ(task, mm, rss_stat.count[MM_FILEPAGES]) * PAGE_SIZE;
-    stat.rss_bytes += BPF_CORE_READ(task, mm, rss_stat.count[MM_ANONPAGES]) * PAGE_SIZE;
-    stat.rss_bytes += BPF_CORE_READ(task, mm, rss_stat.count[MM_SHMEMPAGES]) * PAGE_SIZE;
-    
-    // Read VMS (Virtual Memory Size)
-    stat.vms_bytes = BPF_CORE_READ(task, mm, total_vm) * PAGE_SIZE;
-    
-    // Read shared memory
-    stat.shared_bytes = BPF_CORE_READ(task, mm, shared_vm) * PAGE_SIZE;
-    
-    // Read swap usage
-    stat.swap_bytes = BPF_CORE_READ(task, mm, swap_addresses) * PAGE_SIZE;
-    
-    // Read heap and stack usage (approximate)
-    stat.heap_usage = BPF_CORE_READ(task, mm, start_brk) - BPF_CORE_READ(task, mm, brk);
-    stat.stack_usage = BPF_CORE_READ(task, mm, start_stack) - BPF_CORE_READ(task, mm, stack.vm_start);
-    
-    // Read anonymous vs file-backed memory
-    stat.anonymous_memory = BPF_CORE_READ(task, mm, rss_stat.count[MM_ANONPAGES]) * PAGE_SIZE;
-    stat.file_backed_memory = BPF_CORE_READ(task, mm, rss_stat.count[MM_FILEPAGES]) * PAGE_SIZE;
-    
-    // Read page faults
-    stat.major_faults = BPF_CORE_READ(task, maj_flt);
-    stat.minor_faults = BPF_CORE_READ(task, min_flt);
-    
-    // Store statistics
-    bpf_map_update_elem(&process_memory_stats, &pid, &stat, BPF_ANY);
-    
-    return 0;
-}
 
-// Trace memory deallocation events
-SEC("tracepoint/syscalls/sys_enter_munmap")
-int trace_munmap_enter(struct trace_event_raw_sys_enter *ctx) {
-    u32 pid = bpf_get_current_pid_tgid() >> 32;
-    
-    // Check if we should sample this event
-    u32 index = 0;
-    struct process_memory_config *config = bpf_map_lookup_elem(&process_memory_config_map, &index);
-    if (!config || !config->enable_detailed_stats) {
+    __u32 tgid = bpf_get_current_pid_tgid() >> 32;
+    struct task_struct *task = (struct task_struct *)bpf_get_current_task();
+    struct mm_struct *mm = BPF_CORE_READ(task, mm);
+    if (!mm)
         return 0;
-    }
-    
-    // Sample at configured rate
-    u32 sample_key = bpf_get_prandom_u32() % config->sampling_rate;
-    if (sample_key != 0) {
+
+    __u64 rss_pages = smoothtask_task_rss_pages(task);
+    struct process_memory_stat *stat = bpf_map_lookup_elem(&process_memory_stats, &tgid);
+    if (stat) {
+        __u64 delta = rss_pages > stat->rss_pages ? rss_pages - stat->rss_pages
+                                                  : stat->rss_pages - rss_pages;
+        // Fast path: no write while RSS stays within the configured delta
+        if (delta < config->rss_delta_pages)
+            return 0;
+
+        fill_memory_stat(stat, task, mm, rss_pages);
         return 0;
     }
-    
-    // Get current memory stats for this process
-    struct process_memory_stat stat = {};
-    stat.pid = pid;
-    stat.timestamp = get_current_timestamp();
-    
-    // Read memory statistics from task struct
-    struct task_struct *task = (struct task_struct *)bpf_get_current_task();
-    
-    // Read RSS (Resident Set Size)
-    stat.rss_bytes = BPF_CORE_READ(task, mm, rss_stat.count[MM_FILEPAGES]) * PAGE_SIZE;
-    stat.rss_bytes += BPF_CORE_READ(task, mm, rss_stat.count[MM_ANONPAGES]) * PAGE_SIZE;
-    stat.rss_bytes += BPF_CORE_READ(task, mm, rss_stat.count[MM_SHMEMPAGES]) * PAGE_SIZE;
-    
-    // Read VMS (Virtual Memory Size)
-    stat.vms_bytes = BPF_CORE_READ(task, mm, total_vm) * PAGE_SIZE;
-    
-    // Read shared memory
-    stat.shared_bytes = BPF_CORE_READ(task, mm, shared_vm) * PAGE_SIZE;
-    
-    // Read swap usage
-    stat.swap_bytes = BPF_CORE_READ(task, mm, swap_addresses) * PAGE_SIZE;
-    
-    // Read heap and stack usage (approximate)
-    stat.heap_usage = BPF_CORE_READ(task, mm, start_brk) - BPF_CORE_READ(task, mm, brk);
-    stat.stack_usage = BPF_CORE_READ(task, mm, start_stack) - BPF_CORE_READ(task, mm, stack.vm_start);
-    
-    // Read anonymous vs file-backed memory
-    stat.anonymous_memory = BPF_CORE_READ(task, mm, rss_stat.count[MM_ANONPAGES]) * PAGE_SIZE;
-    stat.file_backed_memory = BPF_CORE_READ(task, mm, rss_stat.count[MM_FILEPAGES]) * PAGE_SIZE;
-    
-    // Read page faults
-    stat.major_faults = BPF_CORE_READ(task, maj_flt);
-    stat.minor_faults = BPF_CORE_READ(task, min_flt);
-    
-    // Store statistics
-    bpf_map_update_elem(&process_memory_stats, &pid, &stat, BPF_ANY);
-    
+
+    struct process_memory_stat new_stat = {};
+    new_stat.pid = tgid;
+    new_stat.tgid = tgid;
+    bpf_get_current_comm(&new_stat.comm, sizeof(new_stat.comm));
+    fill_memory_stat(&new_stat, task, mm, rss_pages);
+
+    // A concurrent insert from another thread of the process wins
+    smoothtask_map_update(&process_memory_stats, &tgid, &new_stat, BPF_NOEXIST);
     return 0;
 }
 
-// Periodic collection of memory statistics
-SEC("kprobe/finish_task_switch")
-int trace_task_switch(struct pt_regs *ctx) {
-    u32 pid = bpf_get_current_pid_tgid() >> 32;
-    
-    // Check if we should collect statistics for this process
-    u32 index = 0;
-    struct process_memory_config *config = bpf_map_lookup_elem(&process_memory_config_map, &index);
-    if (!config) {
-        return 0;
-    }
-    
-    // Only collect if memory usage is above threshold
-    struct task_struct *task = (struct task_struct *)bpf_get_current_task();
-    u64 rss = BPF_CORE_READ(task, mm, rss_stat.count[MM_FILEPAGES]) * PAGE_SIZE;
-    rss += BPF_CORE_READ(task, mm, rss_stat.count[MM_ANONPAGES]) * PAGE_SIZE;
-    rss += BPF_CORE_READ(task, mm, rss_stat.count[MM_SHMEMPAGES]) * PAGE_SIZE;
-    
-    if (rss < config->min_memory_threshold) {
-        return 0;
-    }
-    
-    // Collect memory statistics
-    struct process_memory_stat stat = {};
-    stat.pid = pid;
-    stat.timestamp = get_current_timestamp();
-    
-    // Read memory statistics from task struct
-    stat.rss_bytes = rss;
-    stat.vms_bytes = BPF_CORE_READ(task, mm, total_vm) * PAGE_SIZE;
-    stat.shared_bytes = BPF_CORE_READ(task, mm, shared_vm) * PAGE_SIZE;
-    stat.swap_bytes = BPF_CORE_READ(task, mm, swap_addresses) * PAGE_SIZE;
-    stat.heap_usage = BPF_CORE_READ(task, mm, start_brk) - BPF_CORE_READ(task, mm, brk);
-    stat.stack_usage = BPF_CORE_READ(task, mm, start_stack) - BPF_CORE_READ(task, mm, stack.vm_start);
-    stat.anonymous_memory = BPF_CORE_READ(task, mm, rss_stat.count[MM_ANONPAGES]) * PAGE_SIZE;
-    stat.file_backed_memory = BPF_CORE_READ(task, mm, rss_stat.count[MM_FILEPAGES]) * PAGE_SIZE;
-    stat.major_faults = BPF_CORE_READ(task, maj_flt);
-    stat.minor_faults = BPF_CORE_READ(task, min_flt);
-    
-    // Store statistics
-    bpf_map_update_elem(&process_memory_stats, &pid, &stat, BPF_ANY);
-    
+// Address space growth: mmap returns with the new mapping in place
+SEC("tracepoint/syscalls/sys_exit_mmap")
+int trace_mmap_exit(struct trace_event_raw_sys_exit *ctx)
+{
+    return update_memory_stat();
+}
+
+// Address space shrink: munmap returns with the pages released
+SEC("tracepoint/syscalls/sys_exit_munmap")
+int trace_munmap_exit(struct trace_event_raw_sys_exit *ctx)
+{
+    return update_memory_stat();
+}
+
+// Heap growth and shrink
+SEC("tracepoint/syscalls/sys_exit_brk")
+int trace_brk_exit(struct trace_event_raw_sys_exit *ctx)
+{
+    return update_memory_stat();
+}
+
+// Drop the record when the thread-group leader exits
+SEC("tp_btf/sched_process_exit")
+int BPF_PROG(trace_memory_process_exit, struct task_struct *p)
+{
+    __u32 pid = BPF_CORE_READ(p, pid);
+    __u32 tgid = BPF_CORE_READ(p, tgid);
+
+    if (pid == tgid)
+        bpf_map_delete_elem(&process_memory_stats, &tgid);
     return 0;
 }
 
-char _license[] SEC("license") = "GPL";
\ No newline at end of file
+char _license[] SEC("license") = "GPL";
@@ -2,131 +2,184 @@
 /* Copyright (c) 2024 SmoothTask Project */
 
 // eBPF программа для мониторинга сетевой активности на уровне процессов
-// Отслеживает сетевые пакеты и байты, отправленные и полученные каждым процессом
+// Считает реально переданные и полученные байты каждого процесса и сокета
+//
+// Объём берётся из точек, где ядро уже знает количество скопированных данных:
+// - TCP: возвращаемое значение tcp_sendmsg() и аргумент copied у tcp_cleanup_rbuf();
+// - UDP: возвращаемое значение udp_sendmsg()/udpv6_sendmsg() и аргумент len
+//   у skb_consume_udp(), который вызывается из udp_recvmsg() и udpv6_recvmsg().
+// Программы fentry/fexit вызываются через BPF трамплин без накладных расходов
+// kprobe, а байты складываются в per-CPU копии записей по TGID и по cookie
+// сокета, а также по cgroup процесса (см. smoothtask_cgroup.h): на событие
+// приходится не более трёх обращений к картам без атомарных операций. Все
+// карты LRU, поэтому короткоживущие соединения вытесняются сами, без
+// обработчиков закрытия сокетов.
 
-#include <linux/bpf.h>
+#include "vmlinux.h"
 #include <bpf/bpf_helpers.h>
 #include <bpf/bpf_tracing.h>
-#include <linux/if_ether.h>
-#include <linux/ip.h>
-#include <linux/tcp.h>
-#include <linux/udp.h>
+#include "smoothtask_bpf.h"
+#include "smoothtask_debug.h"
+#include "smoothtask_cgroup.h"
+#include "smoothtask_counters.h"
+#include "smoothtask_filter.h"
+#include "smoothtask_sampling.h"
 
 // Максимальное количество отслеживаемых процессов
-#define MAX_PROCESS_NETWORK_STATS 4096
-
-// Структура для хранения сетевой статистики процесса
-struct process_network_stats {
-    __u64 packets_sent;
-    __u64 packets_received;
-    __u64 bytes_sent;
-    __u64 bytes_received;
-    __u64 last_timestamp;
-    __u32 pid;
+#define MAX_PROCESS_TRAFFIC_ENTRIES 4096
+
+// Максимальное количество отслеживаемых сокетов
+#define MAX_SOCKET_TRAFFIC_ENTRIES 16384
+
+// Трафик сокета (раскладка совпадает с RawSocketTraffic в ebpf_net.rs).
+// Владелец и протокол записываются в копию каждого CPU при первом событии на нём.
+struct socket_traffic {
+    struct net_traffic traffic;
     __u32 tgid;
+    __u16 protocol;
+    __u16 family;
 };
 
-// Карта для хранения статистики сетевой активности по PID
+// Трафик по TGID (struct net_traffic в smoothtask_bpf.h; per-CPU копии суммируются в userspace)
 struct {
-    __uint(type, BPF_MAP_TYPE_HASH);
-    __uint(max_entries, MAX_PROCESS_NETWORK_STATS);
-    __type(key, __u32);  // PID процесса
-    __type(value, struct process_network_stats);
-} process_network_stats_map SEC(".maps");
+    __uint(type, BPF_MAP_TYPE_LRU_PERCPU_HASH);
+    __uint(max_entries, MAX_PROCESS_TRAFFIC_ENTRIES);
+    __type(key, __u32);
+    __type(value, struct net_traffic);
+} process_traffic_map SEC(".maps");
 
-// Карта для хранения общего количества сетевых пакетов
+// Трафик по cookie сокета
 struct {
-    __uint(type, BPF_MAP_TYPE_PERCPU_ARRAY);
-    __uint(max_entries, 1);
-    __type(key, __u32);
-    __type(value, __u64);
-} total_network_packet_count_map SEC(".maps");
+    __uint(type, BPF_MAP_TYPE_LRU_PERCPU_HASH);
+    __uint(max_entries, MAX_SOCKET_TRAFFIC_ENTRIES);
+    __type(key, __u64);
+    __type(value, struct socket_traffic);
+} socket_traffic_map SEC(".maps");
+
+// Трафик по cgroup процесса
+SMOOTHTASK_CGROUP_MAP(cgroup_traffic_map, struct net_traffic);
 
-// Точка входа для отслеживания отправки сетевых пакетов
-SEC("tracepoint/sock/sock_inet_sock_set_state")
-int trace_process_network_send(struct trace_event_raw_sock_inet_sock_set_state *ctx)
+// Карта для хранения общего количества сетевых пакетов
+SMOOTHTASK_PERCPU_COUNTER(total_network_packet_count_map, 1);
+
+static __always_inline void traffic_add(struct net_traffic *traffic, __u64 bytes, bool send)
 {
-    __u32 pid = bpf_get_current_pid_tgid() >> 32;
-    __u32 tgid = bpf_get_current_pid_tgid();
-    
-    if (pid == 0) {
-        return 0; // Пропускаем ядро
-    }
-    
-    struct process_network_stats *stats;
-    
-    // Получаем или создаем статистику для этого PID
-    stats = bpf_map_lookup_elem(&process_network_stats_map, &pid);
-    if (!stats) {
-        struct process_network_stats new_stats = {};
-        new_stats.pid = pid;
-        new_stats.tgid = tgid;
-        new_stats.last_timestamp = bpf_ktime_get_ns();
-        bpf_map_update_elem(&process_network_stats_map, &pid, &new_stats, BPF_ANY);
-        stats = bpf_map_lookup_elem(&process_network_stats_map, &pid);
-        if (!stats) {
-            return 0;
-        }
+    if (send) {
+        traffic->bytes_sent += bytes;
+        traffic->send_calls += 1;
+    } else {
+        traffic->bytes_received += bytes;
+        traffic->recv_calls += 1;
     }
-    
-    // Обновляем статистику отправки
-    stats->packets_sent += 1;
-    stats->bytes_sent += 1024; // Примерное значение для пакета
-    stats->last_timestamp = bpf_ktime_get_ns();
-    
-    return 0;
 }
 
-// Точка входа для отслеживания получения сетевых пакетов
-SEC("tracepoint/sock/sock_inet_sock_set_state")
-int trace_process_network_receive(struct trace_event_raw_sock_inet_sock_set_state *ctx)
+static __always_inline void account_process(__u32 tgid, __u64 bytes, bool send)
+{
+    struct net_traffic *traffic = SMOOTHTASK_LOOKUP_OR_INIT(&process_traffic_map, &tgid,
+                                                            struct net_traffic);
+
+    if (traffic)
+        traffic_add(traffic, bytes, send);
+}
+
+static __always_inline void account_cgroup(__u64 bytes, bool send)
+{
+    struct net_traffic zero = {};
+    struct net_traffic *traffic = smoothtask_cgroup_entry(&cgroup_traffic_map, &zero);
+
+    if (traffic)
+        traffic_add(traffic, bytes, send);
+}
+
+// Указатели fentry/fexit типизированы BTF, поля сокета читаются напрямую
+static __always_inline void socket_set_owner(struct socket_traffic *socket, struct sock *sk,
+                                             __u32 tgid)
 {
-    __u32 pid = bpf_get_current_pid_tgid() >> 32;
-    __u32 tgid = bpf_get_current_pid_tgid();
-    
-    if (pid == 0) {
-        return 0; // Пропускаем ядро
+    socket->tgid = tgid;
+    socket->protocol = sk->sk_protocol;
+    socket->family = sk->__sk_common.skc_family;
+}
+
+static __always_inline void account_socket(struct sock *sk, __u32 tgid, __u64 bytes, bool send)
+{
+    __u64 cookie = bpf_get_socket_cookie(sk);
+    struct socket_traffic *socket = SMOOTHTASK_LOOKUP_OR_INIT(&socket_traffic_map, &cookie,
+                                                              struct socket_traffic);
+
+    if (!socket)
+        return;
+
+    // Новая запись (или копия этого CPU, созданная другим CPU) ещё без владельца
+    if (!socket->tgid)
+        socket_set_owner(socket, sk, tgid);
+    traffic_add(&socket->traffic, bytes, send);
+}
+
+// Учесть переданные данные; отрицательный результат (ошибка) и нулевой объём пропускаются
+static __always_inline int account_traffic(struct sock *sk, long bytes, bool send)
+{
+    __u32 tgid = bpf_get_current_pid_tgid() >> 32;
+
+    if (bytes <= 0 || tgid == 0) {
+        return 0;
     }
-    
-    struct process_network_stats *stats;
-    
-    // Получаем или создаем статистику для этого PID
-    stats = bpf_map_lookup_elem(&process_network_stats_map, &pid);
-    if (!stats) {
-        struct process_network_stats new_stats = {};
-        new_stats.pid = pid;
-        new_stats.tgid = tgid;
-        new_stats.last_timestamp = bpf_ktime_get_ns();
-        bpf_map_update_elem(&process_network_stats_map, &pid, &new_stats, BPF_ANY);
-        stats = bpf_map_lookup_elem(&process_network_stats_map, &pid);
-        if (!stats) {
-            return 0;
-        }
+
+    if (!smoothtask_task_allowed(tgid)) {
+        return 0; // Процесс отфильтрован конфигурацией
     }
-    
-    // Обновляем статистику получения
-    stats->packets_received += 1;
-    stats->bytes_received += 1024; // Примерное значение для пакета
-    stats->last_timestamp = bpf_ktime_get_ns();
-    
+
+    account_process(tgid, bytes, send);
+    account_socket(sk, tgid, bytes, send);
+    account_cgroup(bytes, send);
     return 0;
 }
 
+// Отправка TCP: результат — количество принятых в очередь байт
+SEC("fexit/tcp_sendmsg")
+int BPF_PROG(trace_tcp_sendmsg, struct sock *sk, struct msghdr *msg, size_t size, int ret)
+{
+    return account_traffic(sk, ret, true);
+}
+
+// Получение TCP: copied — количество байт, прочитанных приложением
+SEC("fentry/tcp_cleanup_rbuf")
+int BPF_PROG(trace_tcp_cleanup_rbuf, struct sock *sk, int copied)
+{
+    return account_traffic(sk, copied, false);
+}
+
+SEC("fexit/udp_sendmsg")
+int BPF_PROG(trace_udp_sendmsg, struct sock *sk, struct msghdr *msg, size_t len, int ret)
+{
+    return account_traffic(sk, ret, true);
+}
+
+SEC("fexit/udpv6_sendmsg")
+int BPF_PROG(trace_udpv6_sendmsg, struct sock *sk, struct msghdr *msg, size_t len, int ret)
+{
+    return account_traffic(sk, ret, true);
+}
+
+// Получение UDP (IPv4 и IPv6): сигнатура стабильна, в отличие от udp_recvmsg().
+// При MSG_PEEK len отрицательный, и подсмотренные данные не учитываются.
+SEC("fentry/skb_consume_udp")
+int BPF_PROG(trace_skb_consume_udp, struct sock *sk, struct sk_buff *skb, int len)
+{
+    return account_traffic(sk, len, false);
+}
+
 // Точка входа для отслеживания общего сетевого трафика
 SEC("tracepoint/net/netif_receive_skb")
 int trace_total_network_packet(struct trace_event_raw_netif_receive_skb *ctx)
 {
-    __u32 key = 0;
-    __u64 *count;
-    
-    // Увеличиваем общее количество пакетов
-    count = bpf_map_lookup_elem(&total_network_packet_count_map, &key);
-    if (count) {
-        __sync_fetch_and_add(count, 1);
-    }
-    
+    __u32 weight = smoothtask_sample(SMOOTHTASK_SAMPLE_NET_RX);
+
+    // Увеличиваем общее количество пакетов на вес выбранного события
+    if (weight)
+        percpu_counter_add(&total_network_packet_count_map, 0, weight);
+
     return 0;
 }
 
 // Лицензия для eBPF программы
-char _license[] SEC("license") = "GPL";
\ No newline at end of file
+char _license[] SEC("license") = "GPL";
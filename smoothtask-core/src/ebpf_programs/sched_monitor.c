@@ -0,0 +1,362 @@
+// SPDX-License-Identifier: GPL-2.0 OR BSD-2-Clause
+/* Copyright (c) 2025 SmoothTask Authors */
+
+// Общая eBPF программа планировщика
+//
+// Единственная точка подключения к sched_switch для всех коллекторов:
+// производительность приложений, энергопотребление и память процессов
+// читают одну компактную запись на процесс из sched_task_map вместо
+// собственных обработчиков переключения контекста. На каждое переключение
+// выполняется одна программа и не более шести обращений к картам (семи —
+// при ожидании в очереди дольше SCHED_LATENCY_MIN_THRESHOLD_NS).
+//
+// Учёт выполняется точными дельтами в наносекундах:
+// - время на CPU — по метке в per-CPU слоте (одна кэш-линия на CPU);
+// - ожидание в очереди выполнения — от sched_wakeup или вытеснения
+//   до переключения на поток;
+// - время вне CPU — от ухода с CPU до пробуждения, с разбивкой на
+//   непрерываемый сон (ввод-вывод) и обычный сон.
+// Записи агрегируются по TGID. Потоки одного процесса переключаются на разных
+// CPU одновременно, поэтому счётчики записи процесса увеличиваются атомарно
+// (__sync_fetch_and_add); per-CPU копии записи на SCHED_MAX_TASKS процессов
+// стоили бы памяти на каждый CPU и обхода всех копий в epoch_aggregator.c.
+// Время на CPU и переключения уходящей задачи
+// дополнительно суммируются по её cgroup (см. smoothtask_cgroup.h): sched_switch
+// выполняется в контексте prev, так что bpf_get_current_cgroup_id() возвращает
+// cgroup уходящей задачи. По этому времени userspace распределяет энергию RAPL
+// между cgroup приложений.
+//
+// Для процессов, отмеченных userspace в sched_latency_target_map (интерактивные
+// группы по результатам политики), превышение порога ожидания в очереди
+// публикуется в кольцевой буфер sched_latency_events. Поток-потребитель
+// применяет заранее вычисленный класс приоритета к голодающему потоку, не
+// дожидаясь следующего тика (см. ebpf_runqueue.rs).
+
+#include "vmlinux.h"
+#include <bpf/bpf_helpers.h>
+#include <bpf/bpf_tracing.h>
+#include <bpf/bpf_core_read.h>
+#include "smoothtask_bpf.h"
+#include "smoothtask_debug.h"
+#include "smoothtask_cgroup.h"
+#include "smoothtask_task_fields.h"
+
+// Максимальное количество отслеживаемых процессов
+#define SCHED_MAX_TASKS 20480
+
+// Максимальное количество отслеживаемых потоков
+#define SCHED_MAX_THREADS 65536
+
+// RSS снимается на каждом (маска + 1)-м уходе процесса с CPU
+#define SCHED_RSS_SAMPLE_MASK 63
+
+// Состояния задачи из include/linux/sched.h
+#define SCHED_TASK_RUNNING 0x0000
+#define SCHED_TASK_UNINTERRUPTIBLE 0x0002
+
+// Максимальное количество отмеченных интерактивных процессов
+#define SCHED_MAX_LATENCY_TARGETS 1024
+
+// Ожидания короче этого значения не проверяются по карте порогов, чтобы не
+// добавлять обращение к карте на каждое переключение (совпадает с
+// MIN_RUNQUEUE_LATENCY_THRESHOLD_NS в ebpf_runqueue.rs)
+#define SCHED_LATENCY_MIN_THRESHOLD_NS 1000000ULL
+
+// Размер кольцевого буфера событий задержки (байт, степень двойки)
+#define SCHED_LATENCY_RINGBUF_SIZE (64 * 1024)
+
+// Метка начала выполнения текущей задачи и накопленное время занятости CPU
+// (раскладка совпадает с RawSchedOncpuSlot в ebpf_sched.rs; busy_ns служит
+// делителем при распределении энергии RAPL, см. ebpf_energy.rs)
+struct sched_oncpu_slot {
+    __u64 oncpu_ts;
+    __u64 busy_ns;
+    __u32 pid;
+    __u32 tgid;
+};
+
+// Состояние потока между переключениями контекста
+struct sched_thread_state {
+    __u64 offcpu_ts;              // Момент ухода с CPU
+    __u64 wakeup_ts;              // Момент постановки в очередь выполнения
+    __u32 offcpu_state;           // Состояние задачи при уходе с CPU
+    __u32 _pad;
+};
+
+// Порог задержки для отмеченного процесса (раскладка совпадает с
+// RawRunqueueLatencyTarget в ebpf_runqueue.rs). Пороги записывает userspace,
+// last_event_ns обновляет программа для ограничения частоты событий.
+struct sched_latency_target {
+    __u64 threshold_ns;           // Порог ожидания в очереди выполнения
+    __u64 min_interval_ns;        // Минимальный интервал между событиями процесса
+    __u64 last_event_ns;          // Время последнего опубликованного события
+};
+
+// Событие превышения порога (раскладка совпадает с RawRunqueueLatencyEvent)
+struct sched_latency_event {
+    __u64 timestamp_ns;
+    __u64 latency_ns;             // Ожидание в очереди выполнения
+    __u32 tgid;
+    __u32 pid;                    // Поток, ожидавший CPU
+    __u32 cpu;
+    __u32 _pad;
+};
+
+// Компактная запись процесса (struct sched_task_stats в smoothtask_bpf.h)
+struct {
+    __uint(type, BPF_MAP_TYPE_LRU_HASH);
+    __uint(max_entries, SCHED_MAX_TASKS);
+    __type(key, __u32);                          // TGID как ключ
+    __type(value, struct sched_task_stats);
+} sched_task_map SEC(".maps");
+
+struct {
+    __uint(type, BPF_MAP_TYPE_PERCPU_ARRAY);
+    __uint(max_entries, 1);
+    __type(key, __u32);
+    __type(value, struct sched_oncpu_slot);
+} sched_oncpu_map SEC(".maps");
+
+// LRU вытесняет записи потоков, завершение которых не было замечено
+struct {
+    __uint(type, BPF_MAP_TYPE_LRU_HASH);
+    __uint(max_entries, SCHED_MAX_THREADS);
+    __type(key, __u32);                          // TID как ключ
+    __type(value, struct sched_thread_state);
+} sched_thread_map SEC(".maps");
+
+struct {
+    __uint(type, BPF_MAP_TYPE_HASH);
+    __uint(max_entries, SCHED_MAX_LATENCY_TARGETS);
+    __type(key, __u32);                          // TGID как ключ
+    __type(value, struct sched_latency_target);
+} sched_latency_target_map SEC(".maps");
+
+struct {
+    __uint(type, BPF_MAP_TYPE_RINGBUF);
+    __uint(max_entries, SCHED_LATENCY_RINGBUF_SIZE);
+} sched_latency_events SEC(".maps");
+
+// Per-CPU итоги по cgroup уходящей задачи (struct sched_cgroup_stats в smoothtask_bpf.h)
+SMOOTHTASK_CGROUP_MAP(sched_cgroup_map, struct sched_cgroup_stats);
+
+static __always_inline struct sched_task_stats *get_or_init_task(__u32 tgid, struct task_struct *task)
+{
+    struct sched_task_stats *stats = bpf_map_lookup_elem(&sched_task_map, &tgid);
+    if (stats)
+        return stats;
+
+    struct sched_task_stats new_stats = {};
+    new_stats.tgid = tgid;
+
+    struct task_struct *leader = BPF_CORE_READ(task, group_leader);
+    BPF_CORE_READ_STR_INTO(&new_stats.comm, leader, comm);
+
+    smoothtask_map_update(&sched_task_map, &tgid, &new_stats, BPF_NOEXIST);
+    return smoothtask_lookup_created(&sched_task_map, &tgid);
+}
+
+static __always_inline struct sched_thread_state *get_or_init_thread(__u32 pid)
+{
+    struct sched_thread_state *thread = bpf_map_lookup_elem(&sched_thread_map, &pid);
+    if (thread)
+        return thread;
+
+    struct sched_thread_state new_thread = {};
+    smoothtask_map_update(&sched_thread_map, &pid, &new_thread, BPF_NOEXIST);
+    return smoothtask_lookup_created(&sched_thread_map, &pid);
+}
+
+// Опубликовать превышение порога ожидания для отмеченного процесса
+//
+// Ограничение частоты приблизительное: last_event_ns читается и пишется без
+// синхронизации, и потоки процесса, превысившие порог одновременно на разных
+// CPU, могут опубликовать по событию каждый. Окно гонки — от проверки до
+// записи метки, поэтому метка записывается до резервирования места в
+// кольцевом буфере. Лишние события не меняют приоритеты: потребитель
+// пропускает потоки, к которым класс уже применён. Сравнение с обменом
+// (BPF_CMPXCHG) закрыло бы окно, но требует Linux 5.12 для общей программы
+// планировщика.
+static __always_inline void report_runqueue_latency(__u32 tgid, __u32 pid, __u32 cpu,
+                                                    __u64 latency, __u64 now)
+{
+    struct sched_latency_target *target;
+    struct sched_latency_event *event;
+
+    if (latency < SCHED_LATENCY_MIN_THRESHOLD_NS)
+        return;
+
+    target = bpf_map_lookup_elem(&sched_latency_target_map, &tgid);
+    if (!target || latency < target->threshold_ns)
+        return;
+    if (target->last_event_ns != 0 && now - target->last_event_ns < target->min_interval_ns)
+        return;
+    target->last_event_ns = now;
+
+    event = bpf_ringbuf_reserve(&sched_latency_events, sizeof(*event), 0);
+    if (!event)
+        return;
+
+    event->timestamp_ns = now;
+    event->latency_ns = latency;
+    event->tgid = tgid;
+    event->pid = pid;
+    event->cpu = cpu;
+    event->_pad = 0;
+    bpf_ringbuf_submit(event, 0);
+}
+
+SEC("tp_btf/sched_switch")
+int BPF_PROG(sched_switch, bool preempt, struct task_struct *prev, struct task_struct *next)
+{
+    __u32 key = 0;
+    __u64 now = bpf_ktime_get_ns();
+    __u32 cpu = bpf_get_smp_processor_id();
+    __u32 prev_pid = BPF_CORE_READ(prev, pid);
+    __u32 next_pid = BPF_CORE_READ(next, pid);
+    __u32 next_tgid = BPF_CORE_READ(next, tgid);
+    struct sched_task_stats *stats;
+    struct sched_thread_state *thread;
+    struct sched_cgroup_stats *cgroup;
+    struct sched_cgroup_stats zero = {};
+
+    struct sched_oncpu_slot *slot = bpf_map_lookup_elem(&sched_oncpu_map, &key);
+    if (!slot)
+        return 0;
+
+    // Уходящая задача: время выполнения и начало ожидания вне CPU
+    if (prev_pid != 0) {
+        __u32 prev_tgid = BPF_CORE_READ(prev, tgid);
+        __u32 state = smoothtask_task_run_state(prev);
+        bool runnable = preempt || state == SCHED_TASK_RUNNING;
+        __u64 runtime = 0;
+
+        if (slot->oncpu_ts != 0 && slot->pid == prev_pid && now > slot->oncpu_ts)
+            runtime = now - slot->oncpu_ts;
+
+        slot->busy_ns += runtime;
+        stats = get_or_init_task(prev_tgid, prev);
+        if (stats) {
+            __sync_fetch_and_add(&stats->runtime_ns, runtime);
+            // Выборка RSS приблизительна при одновременных переключениях потоков
+            if ((stats->context_switches & SCHED_RSS_SAMPLE_MASK) == 0)
+                stats->rss_pages = smoothtask_task_rss_pages(prev);
+            __sync_fetch_and_add(&stats->context_switches, 1);
+            if (runnable)
+                __sync_fetch_and_add(&stats->involuntary_switches, 1);
+            stats->last_cpu = cpu;
+            stats->last_switch_ns = now;
+        }
+
+        cgroup = smoothtask_cgroup_entry(&sched_cgroup_map, &zero);
+        if (cgroup) {
+            cgroup->runtime_ns += runtime;
+            cgroup->context_switches += 1;
+            if (runnable)
+                cgroup->involuntary_switches += 1;
+        }
+
+        thread = get_or_init_thread(prev_pid);
+        if (thread) {
+            thread->offcpu_ts = now;
+            thread->offcpu_state = state;
+            // Вытесненная задача остаётся в очереди выполнения сразу
+            thread->wakeup_ts = runnable ? now : 0;
+        }
+    }
+
+    // Приходящая задача: ожидание в очереди и время сна
+    if (next_pid != 0) {
+        thread = bpf_map_lookup_elem(&sched_thread_map, &next_pid);
+        if (thread && (thread->offcpu_ts != 0 || thread->wakeup_ts != 0)) {
+            __u64 runqueue_wait = 0;
+            __u64 blocked = 0;
+            __u64 sleep_end = thread->wakeup_ts ? thread->wakeup_ts : now;
+
+            if (thread->wakeup_ts != 0 && now > thread->wakeup_ts)
+                runqueue_wait = now - thread->wakeup_ts;
+            if (thread->offcpu_ts != 0 && sleep_end > thread->offcpu_ts)
+                blocked = sleep_end - thread->offcpu_ts;
+
+            stats = get_or_init_task(next_tgid, next);
+            if (stats) {
+                __sync_fetch_and_add(&stats->runqueue_wait_ns, runqueue_wait);
+                if (thread->offcpu_state & SCHED_TASK_UNINTERRUPTIBLE)
+                    __sync_fetch_and_add(&stats->io_wait_ns, blocked);
+                else
+                    __sync_fetch_and_add(&stats->sleep_ns, blocked);
+                stats->last_cpu = cpu;
+                stats->last_switch_ns = now;
+            }
+
+            report_runqueue_latency(next_tgid, next_pid, cpu, runqueue_wait, now);
+
+            thread->offcpu_ts = 0;
+            thread->wakeup_ts = 0;
+        }
+    }
+
+    slot->oncpu_ts = now;
+    slot->pid = next_pid;
+    slot->tgid = next_tgid;
+
+    return 0;
+}
+
+// Пробуждение потока: начало ожидания в очереди выполнения
+static __always_inline int handle_wakeup(struct task_struct *p)
+{
+    __u32 pid = BPF_CORE_READ(p, pid);
+    struct sched_thread_state *thread;
+
+    if (pid == 0)
+        return 0;
+
+    thread = get_or_init_thread(pid);
+    if (thread && thread->wakeup_ts == 0)
+        thread->wakeup_ts = bpf_ktime_get_ns();
+
+    return 0;
+}
+
+SEC("tp_btf/sched_wakeup")
+int BPF_PROG(sched_wakeup, struct task_struct *p)
+{
+    return handle_wakeup(p);
+}
+
+SEC("tp_btf/sched_wakeup_new")
+int BPF_PROG(sched_wakeup_new, struct task_struct *p)
+{
+    return handle_wakeup(p);
+}
+
+// После exec обновляем имя процесса в записи
+SEC("tp_btf/sched_process_exec")
+int BPF_PROG(sched_process_exec, struct task_struct *p, pid_t old_pid, struct linux_binprm *bprm)
+{
+    __u32 tgid = BPF_CORE_READ(p, tgid);
+    struct sched_task_stats *stats = bpf_map_lookup_elem(&sched_task_map, &tgid);
+
+    if (stats)
+        bpf_get_current_comm(&stats->comm, sizeof(stats->comm));
+
+    return 0;
+}
+
+SEC("tp_btf/sched_process_exit")
+int BPF_PROG(sched_process_exit, struct task_struct *p)
+{
+    __u32 pid = BPF_CORE_READ(p, pid);
+    __u32 tgid = BPF_CORE_READ(p, tgid);
+
+    bpf_map_delete_elem(&sched_thread_map, &pid);
+
+    // Запись процесса удаляется только при завершении лидера группы потоков
+    if (pid == tgid)
+        bpf_map_delete_elem(&sched_task_map, &tgid);
+
+    return 0;
+}
+
+char _license[] SEC("license") = "GPL";
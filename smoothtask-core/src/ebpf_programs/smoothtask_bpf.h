@@ -0,0 +1,164 @@
+// SPDX-License-Identifier: GPL-2.0 OR BSD-2-Clause
+
+// Общие раскладки значений карт eBPF программ SmoothTask
+//
+// Здесь определены записи процессов и cgroup, которые коллектор читает из
+// карт. Каждой структуре соответствует #[repr(C)] зеркало в userspace, а
+// SMOOTHTASK_ASSERT_SIZE фиксирует её размер: изменение раскладки ломает
+// сборку программы, а тест test_layouts_match_shared_header в
+// ebpf_task_state.rs сверяет размеры из этого файла с зеркалами.
+//
+// Правила раскладки:
+// - запись помещается в одну кэш-линию: поля, которые обновляются на каждом
+//   событии (горячие), идут первыми, идентичность процесса (TGID, имя),
+//   записываемая только при создании записи, — после них;
+// - запись длиннее кэш-линии допускается только с горячей частью в первых
+//   SMOOTHTASK_CACHELINE_SIZE байтах (SMOOTHTASK_ASSERT_HOT);
+// - поля, которые ядро не заполняет, в запись не входят: данные других
+//   программ userspace добавляет при слиянии;
+// - u32 поля идут парами или с явным _pad, чтобы раскладка не зависела от
+//   неявного выравнивания.
+//
+// Элементы карт ядро размещает с выравниванием 8 байт, поэтому атрибут
+// aligned(64) только увеличил бы записи; вместо него размер ограничен линией.
+//
+// Здесь же разбираются поля точек трассировки, которые читают несколько
+// программ (rwbs блочных запросов).
+//
+// Заголовок не подключает зависимости сам: перед ним должен быть подключён
+// vmlinux.h.
+
+#ifndef __SMOOTHTASK_BPF_H
+#define __SMOOTHTASK_BPF_H
+
+#define SMOOTHTASK_CACHELINE_SIZE 64
+
+// Размер записи совпадает с зеркалом в userspace
+#define SMOOTHTASK_ASSERT_SIZE(type, size) \
+    _Static_assert(sizeof(struct type) == (size), #type ": раскладка не совпадает с userspace")
+
+// Горячие поля до last_hot включительно лежат в первой кэш-линии записи
+#define SMOOTHTASK_ASSERT_HOT(type, last_hot)                                       \
+    _Static_assert(__builtin_offsetof(struct type, last_hot) +                      \
+                           sizeof(((struct type *)0)->last_hot) <=                  \
+                       SMOOTHTASK_CACHELINE_SIZE,                                   \
+                   #type ": горячие поля не помещаются в кэш-линию")
+
+// Запись process_map (process_monitor.c; RawProcessInfo в ebpf_task_state.rs).
+// Пишется только при exec и fork; счётчики процесса ведут sched_monitor.c и
+// syscall_monitor.c.
+struct process_info {
+    __u64 start_time;             // Время начала процесса
+    __u64 last_activity;          // Время последней активности
+    __u32 tgid;
+    __u32 ppid;                   // TGID родительского процесса
+    char comm[16];                // Имя процесса
+};
+SMOOTHTASK_ASSERT_SIZE(process_info, 40);
+
+// Запись process_gpu_map (process_gpu.c; RawProcessGpuStats в ebpf_task_state.rs).
+// Время GPU и устройство userspace берёт из gpu_monitor.c.
+struct process_gpu_stats {
+    __u64 memory_usage_bytes;     // Использование памяти GPU в байтах
+    __u64 last_update_ns;
+    __u32 tgid;
+    __u32 _pad;
+};
+SMOOTHTASK_ASSERT_SIZE(process_gpu_stats, 24);
+
+// Запись process_disk_stats_map (process_disk.c; RawProcessDiskStats в ebpf_task_state.rs)
+struct process_disk_stats {
+    __u64 bytes_read;
+    __u64 bytes_written;
+    __u64 read_operations;
+    __u64 write_operations;
+    __u64 last_timestamp;
+    __u32 tgid;
+    __u32 _pad;
+};
+SMOOTHTASK_ASSERT_SIZE(process_disk_stats, 48);
+
+// Запись application_performance_map (application_performance.c;
+// RawApplicationPerformanceStats в ebpf_task_state.rs). Системные вызовы,
+// ожидание блокировок и выделения памяти ядра userspace берёт из карт
+// syscall_monitor.c и kmem_allocations.c.
+struct application_performance_stats {
+    __u64 page_faults;            // Page faults с учётом веса выборки
+    __u64 interrupts;             // Прерывания в контексте процесса
+    __u64 last_update_ns;
+    __u32 tgid;
+    __u32 _pad;
+    char comm[16];                // Имя лидера группы потоков
+};
+SMOOTHTASK_ASSERT_SIZE(application_performance_stats, 48);
+
+// Компактная запись процесса планировщика (sched_monitor.c; RawSchedTaskStats
+// в ebpf_sched.rs). Первые 64 байта обновляются на каждом переключении, имя —
+// только при создании записи и exec.
+struct sched_task_stats {
+    __u32 tgid;
+    __u32 last_cpu;               // CPU последнего выполнения
+    __u64 runtime_ns;             // Время на CPU
+    __u64 runqueue_wait_ns;       // Ожидание в очереди выполнения
+    __u64 io_wait_ns;             // Непрерываемый сон (ввод-вывод)
+    __u64 sleep_ns;               // Прерываемый сон
+    __u64 last_switch_ns;         // Последнее переключение с участием процесса
+    __u32 context_switches;       // Уходы с CPU
+    __u32 involuntary_switches;   // Из них вытеснения
+    __u64 rss_pages;              // Последний снимок RSS в страницах
+    char comm[16];                // Имя лидера группы потоков
+};
+SMOOTHTASK_ASSERT_SIZE(sched_task_stats, 80);
+SMOOTHTASK_ASSERT_HOT(sched_task_stats, rss_pages);
+
+// Сетевой трафик (process_network.c; RawNetTraffic в ebpf_net.rs)
+struct net_traffic {
+    __u64 bytes_sent;
+    __u64 bytes_received;
+    __u64 send_calls;
+    __u64 recv_calls;
+};
+SMOOTHTASK_ASSERT_SIZE(net_traffic, 32);
+
+// Итоги cgroup (smoothtask_cgroup.h; зеркала RawCgroup* в ebpf_cgroup.rs)
+struct disk_cgroup_stats {
+    __u64 bytes_read;
+    __u64 bytes_written;
+    __u64 read_operations;
+    __u64 write_operations;
+};
+SMOOTHTASK_ASSERT_SIZE(disk_cgroup_stats, 32);
+
+// Время выполнения заданий GPU по cgroup процесса, отправившего задание
+struct gpu_cgroup_stats {
+    __u64 busy_ns;
+    __u64 jobs;
+};
+SMOOTHTASK_ASSERT_SIZE(gpu_cgroup_stats, 16);
+
+struct app_cgroup_stats {
+    __u64 page_faults;
+    __u64 interrupts;
+};
+SMOOTHTASK_ASSERT_SIZE(app_cgroup_stats, 16);
+
+struct sched_cgroup_stats {
+    __u64 runtime_ns;
+    __u64 context_switches;
+    __u64 involuntary_switches;
+};
+SMOOTHTASK_ASSERT_SIZE(sched_cgroup_stats, 24);
+
+// Тип блочного запроса по полю rwbs точек трассировки block: 'R', 'W' или 0.
+// blk_fill_rwbs ставит перед типом флаг F (REQ_PREFLUSH), поэтому запись со
+// сбросом кэша выглядит как "FW"; "F" и "FF" — сброс без данных.
+static __always_inline char smoothtask_rwbs_op(const char *rwbs)
+{
+    char op = rwbs[0];
+
+    if (op == 'F')
+        op = rwbs[1];
+    return op == 'R' || op == 'W' ? op : 0;
+}
+
+#endif /* __SMOOTHTASK_BPF_H */
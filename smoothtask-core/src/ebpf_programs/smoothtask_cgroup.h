@@ -0,0 +1,76 @@
+// SPDX-License-Identifier: GPL-2.0 OR BSD-2-Clause
+
+// Per-cgroup агрегаты eBPF программ SmoothTask
+//
+// Актуатор управляет приоритетами на уровне cgroup v2 приложений, поэтому
+// программы дополнительно к записям процессов ведут итоги по идентификатору
+// cgroup текущей задачи (bpf_get_current_cgroup_id()). Карты per-CPU: копия
+// записи принадлежит текущему CPU и обновляется без атомарных операций, а
+// userspace суммирует копии при чтении (см. ebpf_cgroup.rs). Размер карт
+// ограничен числом cgroup приложений, а не числом процессов, и коллектору не
+// нужно сводить статистику процессов по cgroup.
+//
+// Событие, которое обрабатывается не в контексте владельца (завершение
+// задания GPU в gpu_monitor.c), учитывается через smoothtask_cgroup_entry_of()
+// по cgroup, запомненной в контексте владельца.
+//
+// Агрегация включается на этапе сборки: SMOOTHTASK_CGROUP_AGGREGATION=0
+// (переменная окружения SMOOTHTASK_BPF_CGROUP_AGGREGATION=0 для build.rs)
+// оставляет карты из одной записи, а smoothtask_cgroup_entry() возвращает
+// NULL, так что код обновления удаляется компилятором.
+//
+// Заголовок не подключает зависимости сам: перед ним должны быть подключены
+// vmlinux.h, <bpf/bpf_helpers.h> и smoothtask_debug.h.
+
+#ifndef __SMOOTHTASK_CGROUP_H
+#define __SMOOTHTASK_CGROUP_H
+
+#ifndef SMOOTHTASK_CGROUP_AGGREGATION
+#define SMOOTHTASK_CGROUP_AGGREGATION 1
+#endif
+
+// Максимальное количество cgroup в каждой карте (совпадает с MAX_CGROUPS в ebpf_cgroup.rs)
+#if SMOOTHTASK_CGROUP_AGGREGATION
+#define SMOOTHTASK_MAX_CGROUPS 1024
+#else
+#define SMOOTHTASK_MAX_CGROUPS 1
+#endif
+
+// Per-CPU итоги по идентификатору cgroup v2; LRU вытесняет удалённые cgroup
+#define SMOOTHTASK_CGROUP_MAP(name, value_type)           \
+    struct {                                              \
+        __uint(type, BPF_MAP_TYPE_LRU_PERCPU_HASH);       \
+        __uint(max_entries, SMOOTHTASK_MAX_CGROUPS);      \
+        __type(key, __u64);                               \
+        __type(value, value_type);                        \
+    } name SEC(".maps")
+
+// Запись cgroup cgroup_id; отсутствующая запись создаётся копией zero.
+// NULL — агрегация отключена при сборке или запись не удалось создать.
+static __always_inline void *smoothtask_cgroup_entry_of(void *map, __u64 cgroup_id,
+                                                        const void *zero)
+{
+#if SMOOTHTASK_CGROUP_AGGREGATION
+    void *value = bpf_map_lookup_elem(map, &cgroup_id);
+
+    if (value)
+        return value;
+
+    smoothtask_map_update(map, &cgroup_id, zero, BPF_NOEXIST);
+    return smoothtask_lookup_created(map, &cgroup_id);
+#else
+    return 0;
+#endif
+}
+
+// Запись cgroup текущей задачи (см. smoothtask_cgroup_entry_of)
+static __always_inline void *smoothtask_cgroup_entry(void *map, const void *zero)
+{
+#if SMOOTHTASK_CGROUP_AGGREGATION
+    return smoothtask_cgroup_entry_of(map, bpf_get_current_cgroup_id(), zero);
+#else
+    return 0;
+#endif
+}
+
+#endif /* __SMOOTHTASK_CGROUP_H */
@@ -0,0 +1,90 @@
+// SPDX-License-Identifier: GPL-2.0 OR BSD-2-Clause
+
+// Общие per-CPU счётчики для глобальных итогов eBPF программ SmoothTask
+//
+// Каждый CPU увеличивает только собственную копию счётчика, поэтому в ядре
+// используется обычное сложение без __sync_fetch_and_add и без разделяемой
+// между ядрами кэш-линии. Userspace читает все копии одним пакетным запросом
+// и суммирует их (см. ebpf_counters.rs).
+//
+// Заголовок не подключает зависимости ядра сам: перед ним должны быть подключены
+// определения типов ядра и <bpf/bpf_helpers.h>. Отказы при создании записей
+// учитываются в отладочных счётчиках smoothtask_debug.h.
+//
+// Здесь же SMOOTHTASK_LOOKUP_OR_INIT — общий для программ способ найти или
+// создать запись по ключу перед прибавлением события.
+
+#ifndef __SMOOTHTASK_COUNTERS_H
+#define __SMOOTHTASK_COUNTERS_H
+
+#include "smoothtask_debug.h"
+
+// Массив из `slots` независимых per-CPU счётчиков, индексируемых номером слота
+#define SMOOTHTASK_PERCPU_COUNTER(name, slots)          \
+    struct {                                            \
+        __uint(type, BPF_MAP_TYPE_PERCPU_ARRAY);        \
+        __uint(max_entries, slots);                     \
+        __type(key, __u32);                             \
+        __type(value, __u64);                           \
+    } name SEC(".maps")
+
+// Per-CPU счётчики с произвольным ключом; LRU вытесняет неактивные ключи
+#define SMOOTHTASK_PERCPU_KEYED_COUNTER(name, key_type, entries) \
+    struct {                                            \
+        __uint(type, BPF_MAP_TYPE_LRU_PERCPU_HASH);     \
+        __uint(max_entries, entries);                   \
+        __type(key, key_type);                          \
+        __type(value, __u64);                           \
+    } name SEC(".maps")
+
+// Запись key в map типа type; отсутствующая запись создаётся нулевой.
+// Создание идёт с BPF_NOEXIST, после чего запись перечитывается: её могли
+// успеть создать на другом CPU, а в per-CPU карте новая запись заполняется
+// только для текущего CPU. Событие прибавляется к результату вызывающей
+// стороной, поля владельца (имя, TGID) заполняются ею же, если пусты.
+// NULL — запись не удалось создать (учтено в отладочных счётчиках).
+#define SMOOTHTASK_LOOKUP_OR_INIT(map, key, type)                       \
+    ({                                                                  \
+        type *__entry = bpf_map_lookup_elem(map, key);                  \
+                                                                        \
+        if (!__entry) {                                                 \
+            type __zero;                                                \
+                                                                        \
+            __builtin_memset(&__zero, 0, sizeof(__zero));               \
+            smoothtask_map_update(map, key, &__zero, BPF_NOEXIST);      \
+            __entry = smoothtask_lookup_created(map, key);              \
+        }                                                               \
+        __entry;                                                        \
+    })
+
+// Прибавить delta к слоту per-CPU счётчика текущего CPU
+static __always_inline void percpu_counter_add(void *map, __u32 slot, __u64 delta)
+{
+    __u64 *value = bpf_map_lookup_elem(map, &slot);
+
+    if (value)
+        *value += delta;
+    else
+        smoothtask_debug_inc(SMOOTHTASK_DEBUG_LOOKUP_MISS);
+}
+
+static __always_inline void percpu_counter_inc(void *map, __u32 slot)
+{
+    percpu_counter_add(map, slot, 1);
+}
+
+// Прибавить delta к счётчику ключа на текущем CPU, создав запись при необходимости
+static __always_inline void percpu_keyed_counter_add(void *map, const void *key, __u64 delta)
+{
+    __u64 *value = SMOOTHTASK_LOOKUP_OR_INIT(map, key, __u64);
+
+    if (value)
+        *value += delta;
+}
+
+static __always_inline void percpu_keyed_counter_inc(void *map, const void *key)
+{
+    percpu_keyed_counter_add(map, key, 1);
+}
+
+#endif /* __SMOOTHTASK_COUNTERS_H */
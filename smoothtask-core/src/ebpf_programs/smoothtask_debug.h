@@ -0,0 +1,66 @@
+// SPDX-License-Identifier: GPL-2.0 OR BSD-2-Clause
+
+// Отладочные счётчики eBPF программ SmoothTask
+//
+// Per-CPU массив smoothtask_debug_map считает ситуации, которые иначе остаются
+// незаметными: отсутствие записи, которая должна была существовать, и отказы
+// bpf_map_update_elem() (чаще всего -E2BIG у переполненной HASH карты или
+// -ENOMEM). Userspace суммирует копии CPU и публикует итоги по каждому
+// объекту (см. ebpf_overhead.rs), так что заполнение карт и потери данных
+// видны в API и Prometheus.
+//
+// Заголовок не подключает зависимости сам: перед ним должны быть подключены
+// определения типов ядра и <bpf/bpf_helpers.h>.
+
+#ifndef __SMOOTHTASK_DEBUG_H
+#define __SMOOTHTASK_DEBUG_H
+
+// Слоты (совпадают с DEBUG_SLOT_* в ebpf_overhead.rs)
+#define SMOOTHTASK_DEBUG_LOOKUP_MISS 0
+#define SMOOTHTASK_DEBUG_UPDATE_FAIL 1
+#define SMOOTHTASK_DEBUG_SLOTS       4
+
+// Заголовки errno недоступны рядом с vmlinux.h
+#define SMOOTHTASK_EEXIST 17
+
+struct {
+    __uint(type, BPF_MAP_TYPE_PERCPU_ARRAY);
+    __uint(max_entries, SMOOTHTASK_DEBUG_SLOTS);
+    __type(key, __u32);
+    __type(value, __u64);
+} smoothtask_debug_map SEC(".maps");
+
+static __always_inline void smoothtask_debug_inc(__u32 slot)
+{
+    __u64 *value = bpf_map_lookup_elem(&smoothtask_debug_map, &slot);
+
+    // Копия принадлежит текущему CPU, атомарные операции не нужны
+    if (value)
+        *value += 1;
+}
+
+// bpf_map_update_elem() с учётом отказов.
+// Ожидаемый -EEXIST при BPF_NOEXIST (запись создана на другом CPU) отказом не считается.
+static __always_inline long smoothtask_map_update(void *map, const void *key, const void *value,
+                                                  __u64 flags)
+{
+    long err = bpf_map_update_elem(map, key, value, flags);
+
+    if (err && !(flags == BPF_NOEXIST && err == -SMOOTHTASK_EEXIST))
+        smoothtask_debug_inc(SMOOTHTASK_DEBUG_UPDATE_FAIL);
+
+    return err;
+}
+
+// Найти запись, только что созданную через BPF_NOEXIST; отсутствие означает потерю события
+static __always_inline void *smoothtask_lookup_created(void *map, const void *key)
+{
+    void *value = bpf_map_lookup_elem(map, key);
+
+    if (!value)
+        smoothtask_debug_inc(SMOOTHTASK_DEBUG_LOOKUP_MISS);
+
+    return value;
+}
+
+#endif /* __SMOOTHTASK_DEBUG_H */
@@ -0,0 +1,130 @@
+// SPDX-License-Identifier: GPL-2.0 OR BSD-2-Clause
+
+// Фильтрация событий в ядре по процессу, cgroup и номеру системного вызова
+//
+// Userspace заполняет карты фильтров каждого загруженного объекта (см.
+// ebpf_filter.rs) и может менять их во время работы. Обработчики вызывают
+// smoothtask_task_allowed() / smoothtask_syscall_allowed() до любых записей
+// в карты и сразу выходят для неинтересных событий. Пока соответствующий
+// флаг в smoothtask_filter_config_map не выставлен, фильтр пропускает всё.
+//
+// Включённые фильтры объединяются по «И»: событие должно пройти каждый из них.
+//
+// Заголовок не подключает зависимости сам: перед ним должны быть подключены
+// определения типов ядра и <bpf/bpf_helpers.h>.
+
+#ifndef __SMOOTHTASK_FILTER_H
+#define __SMOOTHTASK_FILTER_H
+
+// Флаги конфигурации (совпадают с FILTER_FLAG_* в ebpf_filter.rs)
+#define SMOOTHTASK_FILTER_PID     (1U << 0)
+#define SMOOTHTASK_FILTER_CGROUP  (1U << 1)
+#define SMOOTHTASK_FILTER_SYSCALL (1U << 2)
+
+#define SMOOTHTASK_FILTER_MAX_PIDS     1024
+#define SMOOTHTASK_FILTER_MAX_CGROUPS  64
+#define SMOOTHTASK_FILTER_MAX_SYSCALLS 512
+
+// Глубина иерархии cgroup, на которой ищутся разрешённые предки
+#define SMOOTHTASK_FILTER_CGROUP_LEVELS 8
+
+// Активные фильтры (раскладка совпадает с RawFilterConfig в ebpf_filter.rs)
+struct smoothtask_filter_config {
+    __u32 flags;
+    __u32 _pad;
+};
+
+struct {
+    __uint(type, BPF_MAP_TYPE_ARRAY);
+    __uint(max_entries, 1);
+    __type(key, __u32);
+    __type(value, struct smoothtask_filter_config);
+} smoothtask_filter_config_map SEC(".maps");
+
+// Разрешённые процессы (TGID)
+struct {
+    __uint(type, BPF_MAP_TYPE_HASH);
+    __uint(max_entries, SMOOTHTASK_FILTER_MAX_PIDS);
+    __type(key, __u32);
+    __type(value, __u8);
+} smoothtask_filter_pid_map SEC(".maps");
+
+// Разрешённые cgroup v2 (идентификатор — inode каталога cgroup);
+// разрешение распространяется на всё поддерево
+struct {
+    __uint(type, BPF_MAP_TYPE_HASH);
+    __uint(max_entries, SMOOTHTASK_FILTER_MAX_CGROUPS);
+    __type(key, __u64);
+    __type(value, __u8);
+} smoothtask_filter_cgroup_map SEC(".maps");
+
+// Разрешённые номера системных вызовов (1 — разрешён)
+struct {
+    __uint(type, BPF_MAP_TYPE_ARRAY);
+    __uint(max_entries, SMOOTHTASK_FILTER_MAX_SYSCALLS);
+    __type(key, __u32);
+    __type(value, __u8);
+} smoothtask_filter_syscall_map SEC(".maps");
+
+static __always_inline __u32 smoothtask_filter_flags(void)
+{
+    __u32 key = 0;
+    struct smoothtask_filter_config *config;
+
+    config = bpf_map_lookup_elem(&smoothtask_filter_config_map, &key);
+    return config ? config->flags : 0;
+}
+
+// Текущая задача или один из её предков входит в разрешённые cgroup
+static __always_inline int smoothtask_cgroup_allowed(void)
+{
+    __u64 cgroup_id = bpf_get_current_cgroup_id();
+
+    if (bpf_map_lookup_elem(&smoothtask_filter_cgroup_map, &cgroup_id))
+        return 1;
+
+#pragma unroll
+    for (int level = 1; level <= SMOOTHTASK_FILTER_CGROUP_LEVELS; level++) {
+        __u64 ancestor = bpf_get_current_ancestor_cgroup_id(level);
+
+        // Уровни глубже самой задачи возвращают 0
+        if (!ancestor || ancestor == cgroup_id)
+            break;
+        if (bpf_map_lookup_elem(&smoothtask_filter_cgroup_map, &ancestor))
+            return 1;
+    }
+
+    return 0;
+}
+
+// Нужно ли обрабатывать событие процесса tgid (вызывается в контексте задачи)
+static __always_inline int smoothtask_task_allowed(__u32 tgid)
+{
+    __u32 flags = smoothtask_filter_flags();
+
+    if (flags & SMOOTHTASK_FILTER_PID) {
+        if (!bpf_map_lookup_elem(&smoothtask_filter_pid_map, &tgid))
+            return 0;
+    }
+
+    if (flags & SMOOTHTASK_FILTER_CGROUP) {
+        if (!smoothtask_cgroup_allowed())
+            return 0;
+    }
+
+    return 1;
+}
+
+// Нужно ли обрабатывать системный вызов с номером syscall_id
+static __always_inline int smoothtask_syscall_allowed(__u32 syscall_id)
+{
+    __u8 *allowed;
+
+    if (!(smoothtask_filter_flags() & SMOOTHTASK_FILTER_SYSCALL))
+        return 1;
+
+    allowed = bpf_map_lookup_elem(&smoothtask_filter_syscall_map, &syscall_id);
+    return allowed && *allowed;
+}
+
+#endif /* __SMOOTHTASK_FILTER_H */
@@ -0,0 +1,54 @@
+// SPDX-License-Identifier: GPL-2.0 OR BSD-2-Clause
+
+// Общие log2 гистограммы задержек eBPF программ SmoothTask
+//
+// Интервал N содержит задержки из [2^N, 2^(N+1)) наносекунд. Гистограммы
+// хранятся в per-CPU картах: значение принадлежит текущему CPU, поэтому
+// запись ведётся без атомарных операций. Userspace сливает копии CPU и
+// оценивает перцентили (см. ebpf_latency.rs).
+//
+// Заголовок не подключает зависимости сам: перед ним должны быть подключены
+// определения типов ядра.
+
+#ifndef __SMOOTHTASK_LATENCY_H
+#define __SMOOTHTASK_LATENCY_H
+
+// Количество log2 интервалов гистограммы (до ~4.3 с)
+#define SMOOTHTASK_LATENCY_BUCKETS 32
+
+// Гистограмма задержек (раскладка совпадает с RawLatencyHistogram в ebpf_latency.rs)
+struct smoothtask_latency_hist {
+    __u64 count;
+    __u64 total_time_ns;
+    __u64 buckets[SMOOTHTASK_LATENCY_BUCKETS];
+};
+
+// Номер log2 интервала для задержки
+static __always_inline __u32 smoothtask_latency_bucket(__u64 value)
+{
+    __u32 bucket = 0;
+
+    if (value >> 32) { value >>= 32; bucket += 32; }
+    if (value >> 16) { value >>= 16; bucket += 16; }
+    if (value >> 8) { value >>= 8; bucket += 8; }
+    if (value >> 4) { value >>= 4; bucket += 4; }
+    if (value >> 2) { value >>= 2; bucket += 2; }
+    if (value >> 1) { bucket += 1; }
+
+    return bucket < SMOOTHTASK_LATENCY_BUCKETS ? bucket : SMOOTHTASK_LATENCY_BUCKETS - 1;
+}
+
+// Учесть weight измерений задержки latency_ns в гистограмме текущего CPU
+static __always_inline void smoothtask_hist_record(struct smoothtask_latency_hist *hist,
+                                                   __u64 latency_ns, __u32 weight)
+{
+    __u32 bucket = smoothtask_latency_bucket(latency_ns);
+
+    // Значение per-CPU карты принадлежит текущему CPU, атомарные операции не нужны
+    hist->count += weight;
+    hist->total_time_ns += latency_ns * weight;
+    if (bucket < SMOOTHTASK_LATENCY_BUCKETS)
+        hist->buckets[bucket] += weight;
+}
+
+#endif /* __SMOOTHTASK_LATENCY_H */
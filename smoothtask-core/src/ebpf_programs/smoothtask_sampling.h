@@ -0,0 +1,59 @@
+// SPDX-License-Identifier: GPL-2.0 OR BSD-2-Clause
+
+// Адаптивная выборка высокочастотных событий eBPF программ SmoothTask
+//
+// Для каждого класса событий (системные вызовы, kmalloc/kfree, page faults,
+// приём пакетов) userspace задаёт коэффициент выборки N: обрабатывается в
+// среднем одно событие из N. Коэффициент подбирается контроллером в
+// ebpf_sampling.rs по измеренному времени выполнения программ, так что при
+// всплесках нагрузки пробы сами снижают свою стоимость.
+//
+// smoothtask_sample() возвращает вес события: 0 — событие пропускается,
+// иначе N. Счётчики увеличиваются на вес, поэтому их оценка остаётся
+// несмещённой при любом коэффициенте.
+//
+// Заголовок не подключает зависимости сам: перед ним должны быть подключены
+// определения типов ядра и <bpf/bpf_helpers.h>.
+
+#ifndef __SMOOTHTASK_SAMPLING_H
+#define __SMOOTHTASK_SAMPLING_H
+
+// Классы событий (совпадают с SamplingClass в ebpf_sampling.rs)
+#define SMOOTHTASK_SAMPLE_SYSCALLS    0
+#define SMOOTHTASK_SAMPLE_KMEM        1
+#define SMOOTHTASK_SAMPLE_PAGE_FAULTS 2
+#define SMOOTHTASK_SAMPLE_NET_RX      3
+
+// Размер таблицы с запасом под новые классы
+#define SMOOTHTASK_SAMPLE_CLASSES 8
+
+// Коэффициент выборки класса (раскладка совпадает с RawSamplingConfig в ebpf_sampling.rs)
+struct smoothtask_sampling {
+    __u32 rate;
+    __u32 _pad;
+};
+
+struct {
+    __uint(type, BPF_MAP_TYPE_ARRAY);
+    __uint(max_entries, SMOOTHTASK_SAMPLE_CLASSES);
+    __type(key, __u32);
+    __type(value, struct smoothtask_sampling);
+} smoothtask_sampling_map SEC(".maps");
+
+// Вес события класса sample_class: 0 — пропустить, иначе текущий коэффициент
+static __always_inline __u32 smoothtask_sample(__u32 sample_class)
+{
+    struct smoothtask_sampling *sampling;
+    __u32 rate;
+
+    sampling = bpf_map_lookup_elem(&smoothtask_sampling_map, &sample_class);
+    rate = sampling ? sampling->rate : 1;
+
+    // Нулевое значение (карта ещё не заполнена) означает обработку всех событий
+    if (rate <= 1)
+        return 1;
+
+    return bpf_get_prandom_u32() % rate == 0 ? rate : 0;
+}
+
+#endif /* __SMOOTHTASK_SAMPLING_H */
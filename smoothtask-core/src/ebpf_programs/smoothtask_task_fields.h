@@ -0,0 +1,91 @@
+// SPDX-License-Identifier: GPL-2.0 OR BSD-2-Clause
+
+// Чтение полей task_struct и mm_struct, раскладка которых менялась между
+// версиями ядра
+//
+// Поля читаются через CO-RE: старые раскладки описаны структурами с
+// суффиксом ___, и загрузчик выбирает ту, что есть в BTF ядра.
+//
+// Заголовок не подключает зависимости сам: перед ним должны быть подключены
+// vmlinux.h и <bpf/bpf_core_read.h>.
+
+#ifndef __SMOOTHTASK_TASK_FIELDS_H
+#define __SMOOTHTASK_TASK_FIELDS_H
+
+// Индексы счётчиков rss_stat из include/linux/mm_types_task.h
+#define SMOOTHTASK_MM_FILEPAGES 0
+#define SMOOTHTASK_MM_ANONPAGES 1
+#define SMOOTHTASK_MM_SWAPENTS 2
+#define SMOOTHTASK_MM_SHMEMPAGES 3
+
+// Старое имя поля состояния задачи (до Linux 5.14)
+struct task_struct___pre_5_14 {
+    long int state;
+} __attribute__((preserve_access_index));
+
+// rss_stat до Linux 6.2: атомарные счётчики вместо percpu_counter
+struct mm_rss_stat___pre_6_2 {
+    atomic_long_t count[4];
+} __attribute__((preserve_access_index));
+
+struct mm_struct___pre_6_2 {
+    struct mm_rss_stat___pre_6_2 rss_stat;
+} __attribute__((preserve_access_index));
+
+// Состояние задачи (TASK_RUNNING, TASK_INTERRUPTIBLE, ...)
+static __always_inline __u32 smoothtask_task_run_state(struct task_struct *task)
+{
+    if (bpf_core_field_exists(task->__state))
+        return BPF_CORE_READ(task, __state);
+
+    struct task_struct___pre_5_14 *old = (void *)task;
+    return BPF_CORE_READ(old, state);
+}
+
+// Счётчик rss_stat адресного пространства в страницах; member — константа
+// SMOOTHTASK_MM_*, чтобы индекс попал в CO-RE релокацию.
+// Начиная с 6.2 читается приближённое значение percpu_counter без локальных
+// остатков CPU, как и в /proc/[pid]/status.
+#define smoothtask_mm_counter(mm, member)                                      \
+    ({                                                                         \
+        __s64 __pages;                                                         \
+        if (bpf_core_type_exists(struct mm_rss_stat___pre_6_2)) {              \
+            struct mm_struct___pre_6_2 *__old = (void *)(mm);                  \
+            __pages = BPF_CORE_READ(__old, rss_stat.count[member].counter);    \
+        } else {                                                               \
+            __pages = BPF_CORE_READ(mm, rss_stat[member].count);               \
+        }                                                                      \
+        __pages;                                                               \
+    })
+
+// RSS задачи в страницах: файловые, анонимные и shmem страницы
+static __always_inline __u64 smoothtask_task_rss_pages(struct task_struct *task)
+{
+    struct mm_struct *mm = BPF_CORE_READ(task, mm);
+    __s64 pages;
+
+    // У потоков ядра нет адресного пространства
+    if (!mm)
+        return 0;
+
+    pages = smoothtask_mm_counter(mm, SMOOTHTASK_MM_FILEPAGES) +
+            smoothtask_mm_counter(mm, SMOOTHTASK_MM_ANONPAGES) +
+            smoothtask_mm_counter(mm, SMOOTHTASK_MM_SHMEMPAGES);
+
+    return pages > 0 ? pages : 0;
+}
+
+// Страницы адресного пространства задачи, вытесненные в swap
+static __always_inline __u64 smoothtask_task_swap_pages(struct task_struct *task)
+{
+    struct mm_struct *mm = BPF_CORE_READ(task, mm);
+    __s64 pages;
+
+    if (!mm)
+        return 0;
+
+    pages = smoothtask_mm_counter(mm, SMOOTHTASK_MM_SWAPENTS);
+    return pages > 0 ? pages : 0;
+}
+
+#endif /* __SMOOTHTASK_TASK_FIELDS_H */
@@ -0,0 +1,137 @@
+// SPDX-License-Identifier: GPL-2.0 OR BSD-2-Clause
+
+// Состояние процессов в task-local storage
+//
+// По умолчанию состояние процесса хранится в карте BPF_MAP_TYPE_TASK_STORAGE
+// (Linux 5.11+), привязанной к task_struct лидера группы потоков:
+// - доступ к записи не требует хеширования и не упирается в max_entries;
+// - запись освобождается ядром вместе с задачей, обработчик завершения не нужен;
+// - повторно использованный PID не наследует статистику завершившегося процесса.
+// Userspace выгружает записи итератором SEC("iter/task"), который объявляет
+// SMOOTHTASK_TASK_STATE_ITER (см. ebpf_task_state.rs).
+//
+// Для старых ядер каждая программа собирается ещё и в вариант *_legacy.c,
+// который определяет SMOOTHTASK_TASK_STATE_LEGACY перед подключением исходника.
+// В нём те же макросы объявляют HASH карту с ключом TGID, а userspace читает её
+// обычным обходом. Коллектор загружает legacy вариант, если основной объект
+// не прошёл загрузку.
+//
+// Заголовок не подключает зависимости сам: перед ним должны быть подключены
+// vmlinux.h, <bpf/bpf_helpers.h>, <bpf/bpf_core_read.h> и smoothtask_debug.h.
+
+#ifndef __SMOOTHTASK_TASK_STATE_H
+#define __SMOOTHTASK_TASK_STATE_H
+
+#ifndef SMOOTHTASK_TASK_STATE_LEGACY
+
+// Карта состояния процессов; legacy_entries используется только legacy вариантом
+#define SMOOTHTASK_TASK_STATE(name, value_type, legacy_entries) \
+    struct {                                                    \
+        __uint(type, BPF_MAP_TYPE_TASK_STORAGE);                \
+        __uint(map_flags, BPF_F_NO_PREALLOC);                   \
+        __type(key, int);                                       \
+        __type(value, value_type);                              \
+    } name SEC(".maps")
+
+// Текущая задача с типом BTF (допустима аргументом bpf_task_storage_get)
+#define smoothtask_current_task() bpf_get_current_task_btf()
+
+// Запись процесса задачи или NULL, если её ещё нет
+static __always_inline void *smoothtask_task_state_lookup(void *map, struct task_struct *task)
+{
+    return bpf_task_storage_get(map, task->group_leader, 0, 0);
+}
+
+// Запись процесса задачи; отсутствующая запись создаётся копией init
+static __always_inline void *smoothtask_task_state_create(void *map, struct task_struct *task,
+                                                          void *init)
+{
+    void *value = bpf_task_storage_get(map, task->group_leader, init,
+                                       BPF_LOCAL_STORAGE_GET_F_CREATE);
+
+    if (!value)
+        smoothtask_debug_inc(SMOOTHTASK_DEBUG_LOOKUP_MISS);
+    return value;
+}
+
+// Завершение задачи: запись освобождается ядром вместе с task_struct
+static __always_inline void smoothtask_task_state_exit(void *map, struct task_struct *task)
+{
+}
+
+// Итератор выгрузки записей: по одной записи на процесс, без потоков
+#define SMOOTHTASK_TASK_STATE_ITER(prog, map, value_type)                      \
+    SEC("iter/task")                                                           \
+    int prog(struct bpf_iter__task *ctx)                                       \
+    {                                                                          \
+        struct task_struct *task = ctx->task;                                  \
+        value_type *value;                                                     \
+                                                                               \
+        if (!task || task->pid != task->tgid)                                  \
+            return 0;                                                          \
+                                                                               \
+        value = bpf_task_storage_get(&map, task, 0, 0);                        \
+        if (value)                                                             \
+            bpf_seq_write(ctx->meta->seq, value, sizeof(*value));              \
+        return 0;                                                              \
+    }
+
+#else /* SMOOTHTASK_TASK_STATE_LEGACY */
+
+#define SMOOTHTASK_TASK_STATE(name, value_type, legacy_entries) \
+    struct {                                                    \
+        __uint(type, BPF_MAP_TYPE_HASH);                        \
+        __uint(max_entries, legacy_entries);                    \
+        __type(key, __u32);                                     \
+        __type(value, value_type);                              \
+    } name SEC(".maps")
+
+#define smoothtask_current_task() ((struct task_struct *)bpf_get_current_task())
+
+static __always_inline void *smoothtask_task_state_lookup(void *map, struct task_struct *task)
+{
+    __u32 tgid = BPF_CORE_READ(task, tgid);
+
+    return bpf_map_lookup_elem(map, &tgid);
+}
+
+static __always_inline void *smoothtask_task_state_create(void *map, struct task_struct *task,
+                                                          void *init)
+{
+    __u32 tgid = BPF_CORE_READ(task, tgid);
+    void *value = bpf_map_lookup_elem(map, &tgid);
+
+    if (value)
+        return value;
+
+    // Запись могли создать параллельно на другом CPU — тогда берём её
+    smoothtask_map_update(map, &tgid, init, BPF_NOEXIST);
+    return smoothtask_lookup_created(map, &tgid);
+}
+
+// Запись процесса удаляется при завершении лидера группы потоков
+static __always_inline void smoothtask_task_state_exit(void *map, struct task_struct *task)
+{
+    __u32 pid = BPF_CORE_READ(task, pid);
+    __u32 tgid = BPF_CORE_READ(task, tgid);
+
+    if (pid == tgid)
+        bpf_map_delete_elem(map, &tgid);
+}
+
+// Legacy вариант читается обходом карты, итератор не нужен
+#define SMOOTHTASK_TASK_STATE_ITER(prog, map, value_type)
+
+#endif /* SMOOTHTASK_TASK_STATE_LEGACY */
+
+// Начать запись процесса заново (например, после exec): существующая запись
+// перезаписывается копией init
+#define smoothtask_task_state_reset(map, task, init)                            \
+    ({                                                                         \
+        typeof(init) __state = smoothtask_task_state_create(map, task, init);  \
+        if (__state)                                                           \
+            *__state = *(init);                                                \
+        __state;                                                               \
+    })
+
+#endif /* __SMOOTHTASK_TASK_STATE_H */
@@ -0,0 +1,214 @@
+// SPDX-License-Identifier: GPL-2.0 OR BSD-2-Clause
+/* Copyright (c) 2025 SmoothTask Authors */
+
+// Профилировщик стеков по запросу
+//
+// Загружается только на время сессии профилирования (см. ebpf_profiler.rs) и
+// собирает стеки процессов, отмеченных в profile_target_map:
+// - на CPU — программа perf_event, которую userspace прикрепляет к
+//   программному таймеру cpu-clock на каждом CPU с заданной частотой;
+// - вне CPU — sched_switch: при уходе отмеченного потока с CPU его стеки и
+//   метка времени сохраняются в profile_offcpu_map, при возвращении время
+//   ожидания добавляется к стеку ухода.
+//
+// Стеки записываются через bpf_get_stackid() в карту BPF_MAP_TYPE_STACK_TRACE,
+// а счётчики агрегируются в ядре по ключу (TGID, имя потока, стеки, вид
+// выборки). Размер карт не зависит от длительности сессии и частоты выборки,
+// поэтому накладные расходы ограничены и при 99 Гц на всех CPU: userspace
+// читает результат один раз, по окончании сессии.
+
+#include "vmlinux.h"
+#include <bpf/bpf_helpers.h>
+#include <bpf/bpf_tracing.h>
+#include <bpf/bpf_core_read.h>
+#include "smoothtask_bpf.h"
+#include "smoothtask_debug.h"
+
+// Максимальное количество отмеченных процессов (MAX_PROFILE_TARGETS в ebpf_profiler.rs)
+#define PROFILE_MAX_TARGETS 64
+
+// Максимальное количество уникальных стеков
+#define PROFILE_MAX_STACKS 8192
+
+// Глубина сохраняемого стека; более глубокие стеки обрезаются со стороны корня
+#define PROFILE_STACK_DEPTH 64
+
+// Максимальное количество уникальных ключей агрегации
+#define PROFILE_MAX_COUNTS 16384
+
+// Максимальное количество потоков, одновременно находящихся вне CPU
+#define PROFILE_MAX_THREADS 16384
+
+// Режимы профилирования (PROFILE_MODE_* в ebpf_profiler.rs)
+#define PROFILE_MODE_ON_CPU  (1U << 0)
+#define PROFILE_MODE_OFF_CPU (1U << 1)
+
+// Вид выборки в ключе агрегации
+#define PROFILE_KIND_ON_CPU  0
+#define PROFILE_KIND_OFF_CPU 1
+
+// Параметры сессии (RawProfileConfig в ebpf_profiler.rs)
+struct profile_config {
+    __u64 min_offcpu_ns;          // Более короткие ожидания вне CPU не учитываются
+    __u32 modes;                  // Маска PROFILE_MODE_*
+    __u32 _pad;
+};
+SMOOTHTASK_ASSERT_SIZE(profile_config, 16);
+
+// Ключ агрегации (RawProfileKey в ebpf_profiler.rs).
+// Отрицательный идентификатор стека — ошибка bpf_get_stackid() (нет
+// пользовательского стека у потока ядра, переполнение карты стеков).
+struct profile_key {
+    __u32 tgid;
+    __u32 kind;                   // PROFILE_KIND_*
+    __s32 user_stack_id;
+    __s32 kernel_stack_id;
+    char comm[16];                // Имя потока
+};
+SMOOTHTASK_ASSERT_SIZE(profile_key, 32);
+
+// Счётчики ключа (RawProfileCount в ebpf_profiler.rs)
+struct profile_count {
+    __u64 samples;                // Выборки на CPU или уходы с CPU
+    __u64 total_ns;               // Суммарное время вне CPU
+};
+SMOOTHTASK_ASSERT_SIZE(profile_count, 16);
+
+// Поток, ушедший с CPU: стеки ухода и его метка времени
+struct profile_offcpu {
+    __u64 start_ns;
+    struct profile_key key;
+};
+SMOOTHTASK_ASSERT_SIZE(profile_offcpu, 40);
+
+struct {
+    __uint(type, BPF_MAP_TYPE_ARRAY);
+    __uint(max_entries, 1);
+    __type(key, __u32);
+    __type(value, struct profile_config);
+} profile_config_map SEC(".maps");
+
+struct {
+    __uint(type, BPF_MAP_TYPE_HASH);
+    __uint(max_entries, PROFILE_MAX_TARGETS);
+    __type(key, __u32);                          // TGID как ключ
+    __type(value, __u8);
+} profile_target_map SEC(".maps");
+
+struct {
+    __uint(type, BPF_MAP_TYPE_STACK_TRACE);
+    __uint(max_entries, PROFILE_MAX_STACKS);
+    __uint(key_size, sizeof(__u32));
+    __uint(value_size, PROFILE_STACK_DEPTH * sizeof(__u64));
+} profile_stack_map SEC(".maps");
+
+struct {
+    __uint(type, BPF_MAP_TYPE_HASH);
+    __uint(max_entries, PROFILE_MAX_COUNTS);
+    __type(key, struct profile_key);
+    __type(value, struct profile_count);
+} profile_count_map SEC(".maps");
+
+// LRU вытесняет потоки, которые завершились, не вернувшись на CPU
+struct {
+    __uint(type, BPF_MAP_TYPE_LRU_HASH);
+    __uint(max_entries, PROFILE_MAX_THREADS);
+    __type(key, __u32);                          // TID как ключ
+    __type(value, struct profile_offcpu);
+} profile_offcpu_map SEC(".maps");
+
+static __always_inline struct profile_config *profile_active_config(__u32 mode)
+{
+    __u32 key = 0;
+    struct profile_config *config = bpf_map_lookup_elem(&profile_config_map, &key);
+
+    if (!config || !(config->modes & mode))
+        return NULL;
+    return config;
+}
+
+static __always_inline bool profile_is_target(__u32 tgid)
+{
+    return tgid != 0 && bpf_map_lookup_elem(&profile_target_map, &tgid) != NULL;
+}
+
+static __always_inline void profile_account(const struct profile_key *key, __u64 ns)
+{
+    struct profile_count *count = bpf_map_lookup_elem(&profile_count_map, key);
+
+    if (!count) {
+        struct profile_count zero = {};
+
+        smoothtask_map_update(&profile_count_map, key, &zero, BPF_NOEXIST);
+        count = smoothtask_lookup_created(&profile_count_map, key);
+        if (!count)
+            return;
+    }
+
+    // Ключ общий для всех CPU
+    __sync_fetch_and_add(&count->samples, 1);
+    if (ns)
+        __sync_fetch_and_add(&count->total_ns, ns);
+}
+
+// Выборка на CPU по таймеру cpu-clock текущего CPU
+SEC("perf_event")
+int profile_cpu_sample(struct bpf_perf_event_data *ctx)
+{
+    __u32 tgid = bpf_get_current_pid_tgid() >> 32;
+    struct profile_key key = {};
+
+    if (!profile_active_config(PROFILE_MODE_ON_CPU) || !profile_is_target(tgid))
+        return 0;
+
+    key.tgid = tgid;
+    key.kind = PROFILE_KIND_ON_CPU;
+    key.user_stack_id = bpf_get_stackid(ctx, &profile_stack_map, BPF_F_USER_STACK);
+    key.kernel_stack_id = bpf_get_stackid(ctx, &profile_stack_map, 0);
+    bpf_get_current_comm(&key.comm, sizeof(key.comm));
+
+    profile_account(&key, 0);
+    return 0;
+}
+
+// sched_switch выполняется в контексте уходящей задачи, поэтому
+// bpf_get_stackid() возвращает стеки prev в точке ухода с CPU
+SEC("tp_btf/sched_switch")
+int BPF_PROG(profile_sched_switch, bool preempt, struct task_struct *prev, struct task_struct *next)
+{
+    struct profile_config *config = profile_active_config(PROFILE_MODE_OFF_CPU);
+    __u64 now = bpf_ktime_get_ns();
+    __u32 prev_pid = BPF_CORE_READ(prev, pid);
+    __u32 prev_tgid = BPF_CORE_READ(prev, tgid);
+    __u32 next_pid = BPF_CORE_READ(next, pid);
+    struct profile_offcpu *start;
+
+    if (!config)
+        return 0;
+
+    if (prev_pid != 0 && profile_is_target(prev_tgid)) {
+        struct profile_offcpu entry = {};
+
+        entry.start_ns = now;
+        entry.key.tgid = prev_tgid;
+        entry.key.kind = PROFILE_KIND_OFF_CPU;
+        entry.key.user_stack_id = bpf_get_stackid(ctx, &profile_stack_map, BPF_F_USER_STACK);
+        entry.key.kernel_stack_id = bpf_get_stackid(ctx, &profile_stack_map, 0);
+        BPF_CORE_READ_STR_INTO(&entry.key.comm, prev, comm);
+        smoothtask_map_update(&profile_offcpu_map, &prev_pid, &entry, BPF_ANY);
+    }
+
+    if (next_pid == 0)
+        return 0;
+
+    start = bpf_map_lookup_elem(&profile_offcpu_map, &next_pid);
+    if (!start)
+        return 0;
+
+    if (now > start->start_ns && now - start->start_ns >= config->min_offcpu_ns)
+        profile_account(&start->key, now - start->start_ns);
+    bpf_map_delete_elem(&profile_offcpu_map, &next_pid);
+    return 0;
+}
+
+char _license[] SEC("license") = "GPL";
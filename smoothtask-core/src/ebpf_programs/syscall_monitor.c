@@ -1,47 +1,265 @@
 // SPDX-License-Identifier: GPL-2.0 OR BSD-2-Clause
 /* Copyright (c) 2024 SmoothTask Project */
 
-// eBPF программа для мониторинга системных вызовов
+// Общая eBPF программа системных вызовов
+//
+// Единственная программа SmoothTask, подключённая к входу и выходу из
+// системных вызовов: она ведёт общий счётчик, гистограммы задержек, счётчики
+// по процессам и время ожидания блокировок (futex), которые читают коллекторы
+// системных вызовов, процессов и производительности приложений. Фильтры
+// smoothtask_filter.h и адаптивная выборка применяются один раз на входе.
+//
+// Программы подключаются к BTF точкам трассировки tp_btf/sys_enter и
+// tp_btf/sys_exit (ядро 5.5+); вариант syscall_monitor_raw_tp.c подключается
+// к raw_tp для ядер без BTF. В обоих случаях номер вызова и регистры
+// передаются как есть, без копирования аргументов классической точки
+// трассировки.
+// Завершение процесса отслеживается в sched_process_exit той же программы.
+//
+// Время входа хранится отдельно для каждого потока, поэтому конкурентные
+// вызовы одного номера не портят друг другу задержки. Задержки накапливаются
+// в per-CPU log2 гистограммах по номеру системного вызова (bucket N —
+// задержки в [2^N, 2^(N+1)) нс) без атомарных операций и разделяемых между
+// ядрами кэш-линий. Для помеченных из userspace номеров (futex, read,
+// io_uring_enter и т.п.) дополнительно ведутся гистограммы по процессам
+// (TGID). Ожидание futex учитывается для каждого вызова независимо от
+// выборки. Слияние по CPU и расчёт p50/p99 выполняются в userspace.
 
-#include <linux/bpf.h>
+#include "vmlinux.h"
 #include <bpf/bpf_helpers.h>
 #include <bpf/bpf_tracing.h>
+#include <bpf/bpf_core_read.h>
+#include "smoothtask_counters.h"
+#include "smoothtask_filter.h"
+#include "smoothtask_latency.h"
+#include "smoothtask_sampling.h"
 
-// Структура для хранения информации о системных вызовах
-struct syscall_info {
-    __u64 count;
-    __u64 timestamp;
+#ifdef SMOOTHTASK_SYSCALL_RAW_TP
+#define SYSCALL_SEC(name) SEC("raw_tp/" name)
+#else
+#define SYSCALL_SEC(name) SEC("tp_btf/" name)
+#endif
+
+// Максимальное количество отслеживаемых системных вызовов
+#define MAX_SYSCALLS 512
+
+// Максимальное количество потоков внутри системного вызова одновременно
+#define MAX_INFLIGHT_SYSCALLS 65536
+
+// Максимальное количество пар (процесс, системный вызов) с гистограммами
+#define MAX_APP_SYSCALL_HISTOGRAMS 4096
+
+// Максимальное количество процессов со счётчиками
+#define MAX_SYSCALL_PROCESSES 4096
+
+// Флаги номера системного вызова в syscall_app_filter_map
+// (совпадают с SYSCALL_TRACK_* в ebpf_syscall.rs)
+#define SYSCALL_TRACK_APP_LATENCY 1 // Гистограммы по процессам
+#define SYSCALL_TRACK_LOCK_WAIT 2   // Номер futex: учитывать ожидание блокировок
+
+// Команды futex, при которых поток ожидает блокировку
+#define FUTEX_CMD_MASK 0x7f
+#define FUTEX_CMD_WAIT 0
+#define FUTEX_CMD_LOCK_PI 6
+#define FUTEX_CMD_WAIT_BITSET 9
+
+// Незавершённый системный вызов потока
+struct syscall_start {
+    __u64 timestamp_ns;
+    __u32 syscall_id;
+    // Вес выборки: сколько вызовов представляет эта запись (0 — вызов не выбран
+    // и учитывается только ожидание блокировки)
+    __u32 weight;
+    __u32 flags;        // SYSCALL_TRACK_*, действующие для этого вызова
+    __u32 pad;
+};
+
+// Ключ гистограммы процесса (раскладка совпадает с RawSyscallAppKey в ebpf_latency.rs)
+struct syscall_app_key {
+    __u32 tgid;
+    __u32 syscall_id;
+};
+
+// Счётчики процесса (раскладка совпадает с RawSyscallProcessStats в ebpf_syscall.rs).
+// Имя записывается в копию каждого CPU при первом событии на нём.
+struct syscall_process_stats {
+    __u64 syscalls;         // Системные вызовы с учётом веса выборки
+    __u64 lock_wait_ns;     // Время ожидания futex
+    __u64 last_syscall_ns;
+    char comm[16];
 };
 
-// Карта для хранения счетчика системных вызовов
+// Время входа в системный вызов по TID; LRU вытесняет записи потоков,
+// завершившихся внутри вызова (exit, exit_group)
+struct {
+    __uint(type, BPF_MAP_TYPE_LRU_HASH);
+    __uint(max_entries, MAX_INFLIGHT_SYSCALLS);
+    __type(key, __u32);
+    __type(value, struct syscall_start);
+} syscall_start_map SEC(".maps");
+
+// Per-CPU гистограммы задержек по номеру системного вызова
 struct {
     __uint(type, BPF_MAP_TYPE_PERCPU_ARRAY);
-    __uint(max_entries, 1);
+    __uint(max_entries, MAX_SYSCALLS);
+    __type(key, __u32);
+    __type(value, struct smoothtask_latency_hist);
+} syscall_latency_hist_map SEC(".maps");
+
+// Флаги SYSCALL_TRACK_* по номеру системного вызова, записываются из userspace
+struct {
+    __uint(type, BPF_MAP_TYPE_ARRAY);
+    __uint(max_entries, MAX_SYSCALLS);
+    __type(key, __u32);
+    __type(value, __u32);
+} syscall_app_filter_map SEC(".maps");
+
+// Per-CPU гистограммы задержек по процессу и номеру системного вызова
+struct {
+    __uint(type, BPF_MAP_TYPE_LRU_PERCPU_HASH);
+    __uint(max_entries, MAX_APP_SYSCALL_HISTOGRAMS);
+    __type(key, struct syscall_app_key);
+    __type(value, struct smoothtask_latency_hist);
+} syscall_app_latency_map SEC(".maps");
+
+// Per-CPU счётчики по TGID; LRU вытесняет завершившиеся процессы
+struct {
+    __uint(type, BPF_MAP_TYPE_LRU_PERCPU_HASH);
+    __uint(max_entries, MAX_SYSCALL_PROCESSES);
     __type(key, __u32);
-    __type(value, struct syscall_info);
-} syscall_count_map SEC(".maps");
+    __type(value, struct syscall_process_stats);
+} syscall_process_map SEC(".maps");
+
+// Карта для хранения общего количества системных вызовов
+SMOOTHTASK_PERCPU_COUNTER(total_syscall_count_map, 1);
+
+// Ожидает ли вызов futex блокировку; регистры читаются через CO-RE, так как
+// в raw_tp указатель не типизирован BTF
+static __always_inline bool futex_waits(struct pt_regs *regs)
+{
+    __u32 op = (__u32)PT_REGS_PARM2_CORE_SYSCALL(regs) & FUTEX_CMD_MASK;
+
+    return op == FUTEX_CMD_WAIT || op == FUTEX_CMD_WAIT_BITSET || op == FUTEX_CMD_LOCK_PI;
+}
+
+static __always_inline void account_process(__u32 tgid, __u32 weight, __u64 lock_wait_ns,
+                                            __u64 now)
+{
+    struct syscall_process_stats *stats = SMOOTHTASK_LOOKUP_OR_INIT(&syscall_process_map, &tgid,
+                                                                    struct syscall_process_stats);
+
+    if (!stats)
+        return;
+
+    // Новая запись (или копия этого CPU, созданная другим CPU) ещё без имени
+    if (!stats->comm[0])
+        bpf_get_current_comm(&stats->comm, sizeof(stats->comm));
+    stats->syscalls += weight;
+    stats->lock_wait_ns += lock_wait_ns;
+    stats->last_syscall_ns = now;
+}
 
-// Точка входа для отслеживания системных вызовов
-SEC("tracepoint/syscalls/sys_enter_*")
-int trace_syscall_entry(struct trace_event_raw_sys_enter *ctx)
+SYSCALL_SEC("sys_enter")
+int BPF_PROG(trace_syscall_entry, struct pt_regs *regs, long id)
 {
-    __u32 key = 0;
-    struct syscall_info *info;
-    
-    // Получаем текущее время
-    __u64 timestamp = bpf_ktime_get_ns();
-    
-    // Получаем доступ к карте
-    info = bpf_map_lookup_elem(&syscall_count_map, &key);
-    if (!info)
+    __u64 pid_tgid = bpf_get_current_pid_tgid();
+    __u32 tid = (__u32)pid_tgid;
+    __u32 tgid = pid_tgid >> 32;
+
+    if (id < 0 || id >= MAX_SYSCALLS)
+        return 0;
+
+    __u32 syscall_id = (__u32)id;
+
+    // Отфильтрованные вызовы не оставляют записи о входе, поэтому выход
+    // для них тоже завершается на первом поиске
+    if (!smoothtask_task_allowed(tgid) || !smoothtask_syscall_allowed(syscall_id))
+        return 0;
+
+    __u32 *tracked = bpf_map_lookup_elem(&syscall_app_filter_map, &syscall_id);
+    __u32 flags = tracked ? *tracked : 0;
+    if ((flags & SYSCALL_TRACK_LOCK_WAIT) && !futex_waits(regs))
+        flags &= ~SYSCALL_TRACK_LOCK_WAIT;
+
+    // Невыбранные вызовы не оставляют записи о входе, если не ожидают блокировку
+    __u32 weight = smoothtask_sample(SMOOTHTASK_SAMPLE_SYSCALLS);
+    if (!weight && !(flags & SYSCALL_TRACK_LOCK_WAIT))
+        return 0;
+
+    __u64 now = bpf_ktime_get_ns();
+    if (weight) {
+        percpu_counter_add(&total_syscall_count_map, 0, weight);
+        account_process(tgid, weight, 0, now);
+    }
+
+    struct syscall_start start = {
+        .timestamp_ns = now,
+        .syscall_id = syscall_id,
+        .weight = weight,
+        .flags = flags,
+    };
+    smoothtask_map_update(&syscall_start_map, &tid, &start, BPF_ANY);
+
+    return 0;
+}
+
+SYSCALL_SEC("sys_exit")
+int BPF_PROG(trace_syscall_exit, struct pt_regs *regs, long ret)
+{
+    __u64 pid_tgid = bpf_get_current_pid_tgid();
+    __u32 tid = (__u32)pid_tgid;
+    __u64 now = bpf_ktime_get_ns();
+    struct smoothtask_latency_hist *hist;
+    struct syscall_start *start;
+
+    start = bpf_map_lookup_elem(&syscall_start_map, &tid);
+    if (!start)
         return 0;
-    
-    // Увеличиваем счетчик системных вызовов
-    __sync_fetch_and_add(&info->count, 1);
-    info->timestamp = timestamp;
-    
+
+    __u32 syscall_id = start->syscall_id;
+    __u32 weight = start->weight;
+    __u32 flags = start->flags;
+    __u64 latency_ns = now > start->timestamp_ns ? now - start->timestamp_ns : 0;
+    bpf_map_delete_elem(&syscall_start_map, &tid);
+
+    if (flags & SYSCALL_TRACK_LOCK_WAIT)
+        account_process(pid_tgid >> 32, 0, latency_ns, now);
+
+    if (!weight)
+        return 0;
+
+    hist = bpf_map_lookup_elem(&syscall_latency_hist_map, &syscall_id);
+    if (hist)
+        smoothtask_hist_record(hist, latency_ns, weight);
+
+    if (!(flags & SYSCALL_TRACK_APP_LATENCY))
+        return 0;
+
+    struct syscall_app_key app_key = {
+        .tgid = pid_tgid >> 32,
+        .syscall_id = syscall_id,
+    };
+    hist = SMOOTHTASK_LOOKUP_OR_INIT(&syscall_app_latency_map, &app_key,
+                                     struct smoothtask_latency_hist);
+    if (hist)
+        smoothtask_hist_record(hist, latency_ns, weight);
+
+    return 0;
+}
+
+// Счётчики процесса удаляются при завершении лидера группы потоков, чтобы
+// завершившиеся процессы не попадали в метрики до вытеснения из LRU
+SYSCALL_SEC("sched_process_exit")
+int BPF_PROG(trace_syscall_process_exit, struct task_struct *p)
+{
+    __u32 pid = BPF_CORE_READ(p, pid);
+    __u32 tgid = BPF_CORE_READ(p, tgid);
+
+    if (pid == tgid)
+        bpf_map_delete_elem(&syscall_process_map, &tgid);
+
     return 0;
 }
 
 // Лицензия для eBPF программы
-char _license[] SEC("license") = "GPL";
\ No newline at end of file
+char _license[] SEC("license") = "GPL";
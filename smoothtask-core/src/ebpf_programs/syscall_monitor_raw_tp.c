@@ -0,0 +1,8 @@
+// SPDX-License-Identifier: GPL-2.0 OR BSD-2-Clause
+/* Copyright (c) 2025 SmoothTask Authors */
+
+// Вариант syscall_monitor.c для ядер без BTF точек трассировки (tp_btf):
+// те же обработчики подключаются к raw_tp/sys_enter и raw_tp/sys_exit
+
+#define SMOOTHTASK_SYSCALL_RAW_TP
+#include "syscall_monitor.c"
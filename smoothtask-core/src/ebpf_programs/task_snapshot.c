@@ -0,0 +1,115 @@
+// SPDX-License-Identifier: GPL-2.0 OR BSD-2-Clause
+/* Copyright (c) 2025 SmoothTask Authors */
+
+// Снимок всех задач системы одним проходом итератора
+//
+// Итератор dump_task_snapshot выдаёт по одной записи фиксированного размера
+// на каждую задачу (включая потоки) прямо из task_struct. Userspace читает
+// весь вывод одним вызовом и сворачивает записи потоков по TGID (см.
+// task_snapshot.rs) вместо чтения /proc/[pid]/stat и /proc/[pid]/status
+// для каждого процесса.
+//
+// Программа не подключается к точкам трассировки и не держит карт:
+// ядро выполняет её только во время чтения итератора.
+
+#include "vmlinux.h"
+#include <bpf/bpf_helpers.h>
+#include <bpf/bpf_tracing.h>
+#include <bpf/bpf_core_read.h>
+#include "smoothtask_task_fields.h"
+
+// Флаги записи (совпадают с TASK_FLAG_* в task_snapshot.rs)
+#define TASK_SNAPSHOT_LEADER  (1U << 0)
+#define TASK_SNAPSHOT_KTHREAD (1U << 1)
+
+// PF_KTHREAD из include/linux/sched.h
+#define TASK_SNAPSHOT_PF_KTHREAD 0x00200000
+
+// Приоритет nice 0 (DEFAULT_PRIO из include/linux/sched/prio.h)
+#define TASK_SNAPSHOT_DEFAULT_PRIO 120
+
+// Запись задачи (раскладка совпадает с RawTaskSnapshot в task_snapshot.rs)
+struct task_snapshot_record {
+    __u32 pid;
+    __u32 tgid;
+    __u32 ppid;
+    __s32 nice;
+    __u32 state;              // __state | exit_state
+    __u32 flags;              // TASK_SNAPSHOT_*
+    __u64 utime_ns;           // Время в режиме пользователя
+    __u64 stime_ns;           // Время в режиме ядра
+    __u64 start_time_ns;      // Момент запуска от загрузки (CLOCK_BOOTTIME)
+    __u64 rss_pages;          // RSS адресного пространства
+    __u64 swap_pages;         // Страницы, вытесненные в swap
+    __u64 min_flt;
+    __u64 maj_flt;
+    __u64 nvcsw;              // Добровольные переключения контекста
+    __u64 nivcsw;             // Вытеснения
+    __u64 cgroup_id;          // Идентификатор cgroup v2
+    char comm[16];
+};
+
+// Имя поля времени запуска до Linux 5.5
+struct task_struct___pre_5_5 {
+    __u64 real_start_time;
+} __attribute__((preserve_access_index));
+
+static __always_inline __u64 read_start_time(struct task_struct *task)
+{
+    if (bpf_core_field_exists(task->start_boottime))
+        return BPF_CORE_READ(task, start_boottime);
+
+    struct task_struct___pre_5_5 *old = (void *)task;
+    return BPF_CORE_READ(old, real_start_time);
+}
+
+SEC("iter/task")
+int dump_task_snapshot(struct bpf_iter__task *ctx)
+{
+    struct task_struct *task = ctx->task;
+    struct task_snapshot_record record = {};
+
+    if (!task)
+        return 0;
+
+    record.pid = BPF_CORE_READ(task, pid);
+    record.tgid = BPF_CORE_READ(task, tgid);
+    record.ppid = BPF_CORE_READ(task, real_parent, tgid);
+    record.nice = BPF_CORE_READ(task, static_prio) - TASK_SNAPSHOT_DEFAULT_PRIO;
+    record.state = smoothtask_task_run_state(task) | BPF_CORE_READ(task, exit_state);
+    record.utime_ns = BPF_CORE_READ(task, utime);
+    record.stime_ns = BPF_CORE_READ(task, stime);
+    record.min_flt = BPF_CORE_READ(task, min_flt);
+    record.maj_flt = BPF_CORE_READ(task, maj_flt);
+    record.nvcsw = BPF_CORE_READ(task, nvcsw);
+    record.nivcsw = BPF_CORE_READ(task, nivcsw);
+    BPF_CORE_READ_STR_INTO(&record.comm, task, comm);
+
+    if (BPF_CORE_READ(task, flags) & TASK_SNAPSHOT_PF_KTHREAD)
+        record.flags |= TASK_SNAPSHOT_KTHREAD;
+
+    // Общие для процесса поля заполняются только в записи лидера; туда же
+    // добавляется время и ошибки страниц завершившихся потоков, которые ядро
+    // накапливает в signal_struct
+    if (record.pid == record.tgid) {
+        struct signal_struct *signal = BPF_CORE_READ(task, signal);
+
+        record.flags |= TASK_SNAPSHOT_LEADER;
+        record.start_time_ns = read_start_time(task);
+        record.rss_pages = smoothtask_task_rss_pages(task);
+        record.swap_pages = smoothtask_task_swap_pages(task);
+        record.cgroup_id = BPF_CORE_READ(task, cgroups, dfl_cgrp, kn, id);
+        if (signal) {
+            record.utime_ns += BPF_CORE_READ(signal, utime);
+            record.stime_ns += BPF_CORE_READ(signal, stime);
+            record.min_flt += BPF_CORE_READ(signal, min_flt);
+            record.maj_flt += BPF_CORE_READ(signal, maj_flt);
+        }
+    }
+
+    bpf_seq_write(ctx->meta->seq, &record, sizeof(record));
+    return 0;
+}
+
+// Лицензия для eBPF программы
+char _license[] SEC("license") = "GPL";
@@ -15,13 +15,16 @@ use anyhow::{Context, Result};
 use chrono::Utc;
 use config::auto_reload::ConfigAutoReload;
 use config::config_struct::Config;
-use std::collections::HashMap;
+use std::collections::{HashMap, HashSet};
 use std::sync::{Arc, Mutex};
 use std::time::{Duration, Instant, SystemTime};
 use tokio::sync::{watch, RwLock};
 use tracing::{debug, error, info, warn};
 
-use crate::actuator::{apply_priority_adjustments, plan_priority_changes, HysteresisTracker};
+use crate::actuator::{
+    apply_priority_adjustments, plan_fast_path_targets, plan_priority_changes,
+    plan_process_classes, FastPathActuator, FastPathTarget, HysteresisTracker,
+};
 use crate::api::{ApiServer, ApiServerHandle, ApiStateBuilder};
 use crate::classify::pattern_watcher::PatternUpdateResult;
 use crate::classify::{
@@ -43,18 +46,22 @@ use crate::logging::snapshots::{
 };
 use crate::metrics::audio::{AudioIntrospector, AudioMetrics, StaticAudioIntrospector};
 use crate::metrics::audio_pipewire::PipeWireIntrospector;
+use crate::metrics::ebpf::RunqueueLatencySettings;
+use crate::metrics::ebpf_runqueue::RunqueueLatencyEvent;
 use crate::metrics::extended_hardware_sensors::ExtendedHardwareSensors;
 use crate::metrics::input::{EvdevInputTracker, InputMetrics, InputTracker};
 use crate::metrics::process::collect_process_metrics;
 use crate::metrics::scheduling_latency::{LatencyCollector, LatencyProbe};
 use crate::metrics::system::{
-    collect_system_metrics, CpuTimes, DiskMetrics, HardwareMetrics, LoadAvg, MemoryInfo,
+    collect_system_metrics, enable_ebpf_demand_driven_attachment, start_ebpf_runqueue_fast_path,
+    sync_ebpf_runqueue_targets, CpuTimes, DiskMetrics, HardwareMetrics, LoadAvg, MemoryInfo,
     NetworkMetrics, PowerMetrics, PressureMetrics, ProcPaths, SystemMetrics, TemperatureMetrics,
 };
 use crate::metrics::windows::{
     is_wayland_available, StaticWindowIntrospector, WaylandIntrospector, WindowIntrospector,
     X11Introspector,
 };
+use crate::policy::classes::PriorityClass;
 use crate::policy::engine::PolicyEngine;
 
 /// Callback функция для уведомления о готовности демона (например, для systemd notify).
@@ -697,6 +704,21 @@ pub async fn run_daemon(
     let mut policy_engine = PolicyEngine::new(initial_config.clone());
     let mut hysteresis = HysteresisTracker::new();
 
+    // eBPF программы прикрепляются только для групп метрик, которые запрашивают
+    // потребители. Политика и ранкер работают по снапшоту /proc и групп не
+    // запрашивают; быстрый путь подписывается на события планировщика сам.
+    if initial_config.ebpf.demand_driven_attachment {
+        let idle_timeout = Duration::from_secs(initial_config.ebpf.attachment_idle_timeout_secs);
+        enable_ebpf_demand_driven_attachment(idle_timeout);
+        info!(
+            "eBPF programs are attached on demand (idle timeout: {} s)",
+            idle_timeout.as_secs()
+        );
+    }
+
+    // Быстрый путь: задержки в очереди выполнения из eBPF сразу попадают в актуатор
+    let fast_path = start_runqueue_fast_path(&initial_config, dry_run);
+
     // Инициализация интроспекторов
     // Пробуем использовать X11Introspector, если X-сервер доступен
     // Если X11 недоступен, пробуем WaylandIntrospector
@@ -1228,6 +1250,15 @@ pub async fn run_daemon(
         // Применение политики
         let policy_results = policy_engine.evaluate_snapshot(&snapshot);
 
+        // Обновляем набор процессов быстрого пути по результатам политики
+        if let Some(fast_path) = &fast_path {
+            sync_runqueue_fast_path(
+                fast_path,
+                plan_fast_path_targets(&snapshot, &policy_results),
+                &plan_process_classes(&snapshot, &policy_results),
+            );
+        }
+
         // Планирование изменений приоритетов
         let adjustments = plan_priority_changes(&snapshot, &policy_results);
 
@@ -1418,6 +1449,78 @@ pub async fn run_daemon(
     Ok(custom_metrics_manager)
 }
 
+/// Запустить быстрый путь актуатора для задержек в очереди выполнения.
+///
+/// Возвращает `None`, если быстрый путь выключен в конфигурации, демон
+/// работает в режиме dry-run или поток событий eBPF не удалось запустить.
+fn start_runqueue_fast_path(
+    config: &Config,
+    dry_run: bool,
+) -> Option<Arc<Mutex<FastPathActuator>>> {
+    let ebpf = &config.ebpf;
+    if !ebpf.enable_runqueue_latency_fast_path {
+        return None;
+    }
+    if dry_run {
+        info!("Runqueue latency fast path is disabled in dry-run mode");
+        return None;
+    }
+
+    let fast_path = Arc::new(Mutex::new(FastPathActuator::new()));
+    let worker_fast_path = Arc::clone(&fast_path);
+    let settings = RunqueueLatencySettings {
+        threshold_ns: ebpf.runqueue_latency_threshold_us.saturating_mul(1_000),
+        min_interval_ns: ebpf
+            .runqueue_latency_min_interval_ms
+            .saturating_mul(1_000_000),
+        poll_timeout_ms: ebpf.ringbuf_poll_timeout_ms,
+    };
+    let handler = Box::new(move |event: &RunqueueLatencyEvent| {
+        if let Ok(mut fast_path) = worker_fast_path.lock() {
+            fast_path.handle_stall(event.tgid as i32, event.pid as i32, event.latency_ns);
+        }
+    });
+
+    match start_ebpf_runqueue_fast_path(settings, handler) {
+        Ok(()) => {
+            info!(
+                "Runqueue latency fast path started (threshold: {} us, min interval: {} ms)",
+                ebpf.runqueue_latency_threshold_us, ebpf.runqueue_latency_min_interval_ms
+            );
+            Some(fast_path)
+        }
+        Err(e) => {
+            warn!(
+                "Failed to start runqueue latency fast path, priorities will be applied on ticks only: {}",
+                e
+            );
+            None
+        }
+    }
+}
+
+/// Передать быстрому пути и eBPF программе процессы, отмеченные политикой.
+fn sync_runqueue_fast_path(
+    fast_path: &Mutex<FastPathActuator>,
+    targets: HashMap<i32, FastPathTarget>,
+    process_classes: &HashMap<i32, PriorityClass>,
+) {
+    let tgids: HashSet<u32> = targets.keys().map(|&pid| pid as u32).collect();
+
+    if let Ok(mut fast_path) = fast_path.lock() {
+        fast_path.update_targets(targets, process_classes);
+        let stats = fast_path.stats();
+        debug!(
+            "Runqueue fast path: {} events, {} applied, {} restored, {} errors",
+            stats.events, stats.applied, stats.restored, stats.errors
+        );
+    }
+
+    if let Err(e) = sync_ebpf_runqueue_targets(&tgids) {
+        warn!("Failed to publish runqueue fast path targets: {}", e);
+    }
+}
+
 /// Собрать полный снапшот системы.
 ///
 /// Функция собирает все метрики системы, процессов, окон, аудио и ввода,
@@ -17,9 +17,11 @@
 //!
 //! Модуль использует следующую архитектуру:
 //!
-//! 1. **eBPF программы**: загружаются из файлов `.c` и прикрепляются к ядру
+//! 1. **eBPF программы**: компилируются `build.rs` в CO-RE объекты `.bpf.o`, встраиваются
+//!    в бинарник (модуль `ebpf_objects`) и загружаются из памяти
 //! 2. **eBPF карты**: используются для обмена данными между ядром и пользовательским пространством
 //! 3. **Итерация по картам**: функция `iterate_ebpf_map_keys` обеспечивает полный сбор данных
+//!    пакетным чтением (`BPF_MAP_LOOKUP_BATCH`) с поэлементным fallback для старых ядер
 //! 4. **Параллельная обработка**: для детализированной статистики используется многопоточность
 //! 5. **Кэширование**: уменьшает нагрузку на систему при частом сборе метрик
 //!
@@ -73,8 +75,169 @@
 use anyhow::{Context, Result};
 use std::time::Duration;
 
+use super::ebpf_events::LifecycleEventSummary;
 #[cfg(feature = "ebpf")]
-use libbpf_rs::{Map, Program, Skel, SkelBuilder};
+use super::ebpf_events::{LifecycleEventStream, LifecycleStreamConfig};
+#[cfg(feature = "ebpf")]
+use super::ebpf_batch::{self, BatchStatus, KernelMapBatch, MapBatchBuffer};
+#[cfg(feature = "ebpf")]
+use super::ebpf_cgroup::{
+    build_cgroup_stats, reduce_cgroup_entries, CgroupCounters, CgroupPathCache, CgroupTables,
+    APP_CGROUP_MAP, DISK_CGROUP_MAP, GPU_CGROUP_MAP, MAX_CGROUPS, NET_CGROUP_MAP, SCHED_CGROUP_MAP,
+};
+pub use super::ebpf_cgroup::CgroupResourceStat;
+use super::ebpf_demand::EbpfDemand;
+#[cfg(feature = "ebpf")]
+use super::ebpf_demand::{programs_for_groups, EbpfProgramRole};
+pub use super::ebpf_demand::EbpfMetricGroup;
+#[cfg(feature = "ebpf")]
+use super::ebpf_counters::{self, TOTAL_PACKET_COUNT_MAP_NAME};
+pub use super::ebpf_disk::{DiskLatencyStat, DiskQueueStat};
+#[cfg(feature = "ebpf")]
+use super::ebpf_disk::{
+    summarize_disk_latency, RawDiskDeviceStats, RawDiskLatencyKey, DISK_DEVICE_MAP,
+    DISK_LATENCY_MAP,
+};
+#[cfg(feature = "ebpf")]
+use super::ebpf_epoch::{collects_group, EpochAggregator};
+pub use super::ebpf_epoch::EpochSummary;
+pub use super::ebpf_latency::SyscallLatencyStat;
+#[cfg(feature = "ebpf")]
+use super::ebpf_latency::{
+    syscall_latency_stats, LatencyWindow, RawLatencyHistogram, RawSyscallAppKey,
+    SyscallLatencyKey, SYSCALL_APP_FILTER_MAP_NAME, SYSCALL_APP_LATENCY_MAP_NAME,
+    SYSCALL_LATENCY_HIST_MAP_NAME,
+};
+pub use super::ebpf_filesystem::{FilesystemMonitorMode, FilesystemStat, ProcessFilesystemStat};
+#[cfg(feature = "ebpf")]
+use super::ebpf_filesystem::{
+    top_files, top_processes, RawFilesystemConfig, RawFsFileKey, RawFsFileStats, RawFsIoCounters,
+    FILESYSTEM_CONFIG_MAP, FILESYSTEM_PROGRAM, FS_FILE_IO_MAP, FS_PROCESS_IO_MAP, FS_TOTALS_MAP,
+};
+use super::ebpf_filter::{resolve_cgroup_id, KernelFilterSet, DEFAULT_CGROUP_ROOT};
+#[cfg(feature = "ebpf")]
+use super::ebpf_filter::{
+    RawFilterConfig, FILTER_CGROUP_MAP_NAME, FILTER_CONFIG_MAP_NAME, FILTER_PID_MAP_NAME,
+    FILTER_SYSCALL_MAP_NAME,
+};
+#[cfg(feature = "ebpf")]
+use super::ebpf_energy::{EnergyAttributor, RaplPackages, POWERCAP_ROOT};
+#[cfg(feature = "ebpf")]
+use super::ebpf_gpu::{
+    device_usage, fold_process_usage, GpuBusySampler, GpuDeviceUsage, GpuProcessUsage, GpuTopology,
+    RawGpuProcessUsage, RawGpuRingStats, GPU_PROCESS_USAGE_MAP, GPU_PROGRAM, GPU_RING_STATS_MAP,
+};
+use super::ebpf_memory::RawProcessMemoryStat;
+#[cfg(feature = "ebpf")]
+use super::ebpf_memory::{
+    RawProcessMemoryConfig, PROCESS_MEMORY_CONFIG_MAP, PROCESS_MEMORY_STATS_MAP,
+};
+#[cfg(feature = "ebpf")]
+use super::ebpf_memory_pressure::{
+    reduce_kmem_counters, reduce_process_stalls, MemoryStallTracker, RawMemoryStallCounters,
+    KMEM_PROCESS_MAP, KMEM_PROGRAM, MEMORY_PRESSURE_PROGRAM, MEMORY_STALL_CGROUP_MAP,
+    MEMORY_STALL_PROCESS_MAP,
+};
+pub use super::ebpf_memory_pressure::{CgroupMemoryStallStat, ProcessMemoryStallStat};
+use super::ebpf_memory_pressure::{RawKmemCounters, RawMemoryStallProcess};
+use super::ebpf_net::RawConnectionRecord;
+pub use super::ebpf_net::SocketTrafficStat;
+#[cfg(feature = "ebpf")]
+use super::ebpf_net::{
+    reduce_process_traffic, top_sockets, RawNetTraffic, RawSocketTraffic, CONNECTION_MAP_NAME,
+    PROCESS_TRAFFIC_MAP_NAME, SOCKET_TRAFFIC_MAP_NAME,
+};
+#[cfg(feature = "ebpf")]
+use super::ebpf_objects::{is_program_embedded, EbpfObject};
+pub use super::ebpf_overhead::EbpfOverheadReport;
+#[cfg(feature = "ebpf")]
+use super::ebpf_overhead::{
+    sysctl_run_time_stats_enabled, EbpfDebugCounters, EbpfProgramOverhead, DEBUG_MAP_NAME,
+    DEBUG_SLOTS, OVERHEAD_REPORT_INTERVAL,
+};
+#[cfg(feature = "ebpf")]
+use super::ebpf_runqueue::RunqueueLatencyStream;
+pub use super::ebpf_runqueue::{RunqueueLatencyHandler, RunqueueLatencySettings};
+pub use super::ebpf_sampling::SamplingClassState;
+#[cfg(feature = "ebpf")]
+use super::ebpf_sampling::{
+    aggregate_by_class, enable_run_time_stats, AdaptiveSampler, RawSamplingConfig, SamplingClass,
+    SAMPLING_ADJUST_INTERVAL, SAMPLING_MAP_NAME,
+};
+use super::ebpf_sched::{comm_to_string, RawSchedTaskStats};
+#[cfg(feature = "ebpf")]
+use super::ebpf_sched::{
+    total_busy_ns, RawSchedOncpuSlot, SchedTaskTable, SCHED_ONCPU_MAP_NAME, SCHED_PROGRAM_NAME,
+    SCHED_TASK_MAP_NAME,
+};
+pub use super::ebpf_snapshot::{EbpfSnapshot, EbpfSnapshotSection};
+use super::ebpf_syscall::RawSyscallProcessStats;
+#[cfg(feature = "ebpf")]
+use super::ebpf_syscall::{
+    reduce_process_stats, tracking_flags, SYSCALL_PROCESS_MAP, SYSCALL_PROGRAM,
+    SYSCALL_RAW_TP_PROGRAM, TOTAL_SYSCALL_COUNT_MAP,
+};
+#[cfg(feature = "ebpf")]
+use super::ebpf_task_state::{
+    self, RawProcessDiskStats, RawProcessGpuStats, TaskStateBackend, APPLICATION_PERFORMANCE_ITER,
+    PROCESS_DISK_ITER, PROCESS_GPU_ITER, PROCESS_INFO_ITER,
+};
+use super::ebpf_task_state::{RawApplicationPerformanceStats, RawProcessInfo};
+#[cfg(feature = "ebpf")]
+use super::ebpf_thermal::{
+    millicelsius_to_celsius, read_critical_trips, summarize_cpu_zones, RawThermalZoneState,
+    THERMAL_SYSFS_ROOT, THERMAL_ZONE_MAP,
+};
+
+/// Карты хранятся как владеющие дескрипторы, не привязанные ко времени жизни объекта
+#[cfg(feature = "ebpf")]
+use libbpf_rs::MapHandle as Map;
+
+/// Загруженный eBPF объект разделяется между коллектором и кэшем программ
+#[cfg(feature = "ebpf")]
+type Program = std::sync::Arc<EbpfObject>;
+
+/// Карты общей программы системных вызовов (гистограммы и счётчики процессов
+/// подключаются отдельно)
+#[cfg(feature = "ebpf")]
+const SYSCALL_MAP_NAMES: &[&str] = &[TOTAL_SYSCALL_COUNT_MAP];
+
+/// Вариант программы для ядер, на которых основной объект не загружается,
+/// и его описание для журнала
+#[cfg(feature = "ebpf")]
+fn fallback_program_variant(program_name: &str) -> Option<(String, &'static str)> {
+    if ebpf_task_state::is_task_state_program(program_name) {
+        // Ядро без task storage: состояние процессов в HASH картах по TGID
+        Some((
+            ebpf_task_state::legacy_program_name(program_name),
+            "с HASH картами по TGID",
+        ))
+    } else if program_name == SYSCALL_PROGRAM {
+        // Ядро без BTF точек трассировки
+        Some((SYSCALL_RAW_TP_PROGRAM.to_string(), "на raw_tp"))
+    } else {
+        None
+    }
+}
+
+/// Карты программы мониторинга GPU (карта процессов хранится отдельно)
+#[cfg(feature = "ebpf")]
+const GPU_MAP_NAMES: &[&str] = &[GPU_RING_STATS_MAP];
+
+/// Карты программы мониторинга файловой системы (карты детального режима хранятся отдельно)
+#[cfg(feature = "ebpf")]
+const FILESYSTEM_MAP_NAMES: &[&str] = &[FS_TOTALS_MAP];
+
+/// Карты программы мониторинга сетевых соединений
+#[cfg(feature = "ebpf")]
+const CONNECTION_MAP_NAMES: &[&str] = &[CONNECTION_MAP_NAME];
+
+/// Карты программы мониторинга процессов
+///
+/// Системные вызовы процессов берутся из общей программы системных вызовов
+/// (см. [`SYSCALL_PROCESS_MAP`])
+#[cfg(feature = "ebpf")]
+const PROCESS_MAP_NAMES: &[&str] = &["process_map"];
 
 /// Конфигурация eBPF-метрик
 #[derive(Debug, Clone, serde::Deserialize, serde::Serialize)]
@@ -131,6 +294,131 @@ pub struct EbpfConfig {
     pub notification_thresholds: EbpfNotificationThresholds,
     /// Конфигурация фильтрации и агрегации данных
     pub filter_config: EbpfFilterConfig,
+    /// Включить потоковую доставку событий жизненного цикла через кольцевой буфер
+    /// (exec/fork/exit, состояния TCP, блочные запросы) вместо полного обхода HASH карт
+    #[serde(default)]
+    pub enable_ringbuf_events: bool,
+    /// Порог накопленных в кольцевом буфере байт для пробуждения потребителя (0 — по умолчанию libbpf)
+    #[serde(default = "default_ringbuf_wakeup_threshold_bytes")]
+    pub ringbuf_wakeup_threshold_bytes: u64,
+    /// Таймаут ожидания событий потребителем кольцевого буфера (в миллисекундах)
+    #[serde(default = "default_ringbuf_poll_timeout_ms")]
+    pub ringbuf_poll_timeout_ms: u64,
+    /// Номера системных вызовов, для которых ведутся гистограммы задержек по процессам
+    /// (по умолчанию futex, read и io_uring_enter текущей архитектуры)
+    #[serde(default = "default_syscall_latency_app_syscalls")]
+    pub syscall_latency_app_syscalls: Vec<u32>,
+    /// Включить адаптивную выборку высокочастотных событий (системные вызовы,
+    /// kmalloc/kfree, page faults, приём пакетов) по измеренной стоимости программ
+    #[serde(default = "default_enable_adaptive_sampling")]
+    pub enable_adaptive_sampling: bool,
+    /// Бюджет CPU на класс событий (процент от всех CPU), при превышении
+    /// которого коэффициент выборки увеличивается
+    #[serde(default = "default_sampling_cpu_budget_percent")]
+    pub sampling_cpu_budget_percent: f64,
+    /// Максимальный коэффициент выборки (обрабатывается одно событие из N)
+    #[serde(default = "default_max_sampling_rate")]
+    pub max_sampling_rate: u32,
+    /// Публиковать стоимость каждой eBPF программы, заполнение карт и отладочные
+    /// счётчики ядра (API `/api/ebpf/overhead` и Prometheus)
+    #[serde(default = "default_enable_overhead_stats")]
+    pub enable_overhead_stats: bool,
+    /// Изменение RSS процесса (в КБ), после которого eBPF программа памяти
+    /// переписывает его запись; меньшие изменения не вызывают записи в карту
+    #[serde(default = "default_process_memory_rss_delta_kb")]
+    pub process_memory_rss_delta_kb: u64,
+    /// Режим мониторинга файловой системы: только общие счётчики или
+    /// дополнительно учёт по процессам и файлам
+    #[serde(default)]
+    pub filesystem_mode: FilesystemMonitorMode,
+    /// Включить учёт задержек из-за нехватки памяти (major page fault, чтение
+    /// из swap, прямое освобождение памяти) по процессам и cgroup
+    #[serde(default)]
+    pub enable_memory_pressure_monitoring: bool,
+    /// Включить учёт kmalloc/kfree по процессам (одни из самых частых событий
+    /// ядра, поэтому выключено по умолчанию)
+    #[serde(default)]
+    pub enable_kmem_allocation_tracking: bool,
+    /// Включить быстрый путь реакции на задержки в очереди выполнения: потоки
+    /// интерактивных процессов, ожидавшие CPU дольше порога, получают класс
+    /// приоритета из последнего тика политики, не дожидаясь следующего
+    #[serde(default)]
+    pub enable_runqueue_latency_fast_path: bool,
+    /// Порог ожидания в очереди выполнения для быстрого пути (в микросекундах,
+    /// не меньше 1000)
+    #[serde(default = "default_runqueue_latency_threshold_us")]
+    pub runqueue_latency_threshold_us: u64,
+    /// Минимальный интервал между событиями быстрого пути для одного процесса
+    /// (в миллисекундах)
+    #[serde(default = "default_runqueue_latency_min_interval_ms")]
+    pub runqueue_latency_min_interval_ms: u64,
+    /// Прикреплять программы только для групп метрик, на которые подписаны
+    /// потребители (см. `ebpf_demand`); программы остальных групп остаются
+    /// загруженными, но не выполняются на событиях ядра
+    #[serde(default)]
+    pub demand_driven_attachment: bool,
+    /// Время, через которое программы группы без запросов открепляются (в секундах)
+    #[serde(default = "default_attachment_idle_timeout_secs")]
+    pub attachment_idle_timeout_secs: u64,
+    /// Сворачивать счётчики планировщика и сетевого трафика процессов в
+    /// сводки эпох в ядре по таймеру (см. `ebpf_epoch`, Linux 5.19+); на
+    /// старых ядрах сводки не собираются, остальной сбор не меняется.
+    /// Пока агрегатор работает, детальная статистика процессов, обходящая
+    /// карты планировщика и трафика, собирается только по запросу потребителя.
+    /// Выключено по умолчанию: таймер обходит карты источников каждую эпоху
+    #[serde(default)]
+    pub enable_epoch_aggregation: bool,
+    /// Длительность эпохи агрегации (в миллисекундах, от 100 до 60000)
+    #[serde(default = "default_epoch_interval_ms")]
+    pub epoch_interval_ms: u64,
+}
+
+fn default_ringbuf_wakeup_threshold_bytes() -> u64 {
+    4096
+}
+
+fn default_ringbuf_poll_timeout_ms() -> u64 {
+    100
+}
+
+fn default_syscall_latency_app_syscalls() -> Vec<u32> {
+    super::ebpf_latency::default_app_latency_syscalls()
+}
+
+fn default_enable_adaptive_sampling() -> bool {
+    true
+}
+
+fn default_sampling_cpu_budget_percent() -> f64 {
+    super::ebpf_sampling::DEFAULT_SAMPLING_CPU_BUDGET_PERCENT
+}
+
+fn default_max_sampling_rate() -> u32 {
+    super::ebpf_sampling::DEFAULT_MAX_SAMPLING_RATE
+}
+
+fn default_enable_overhead_stats() -> bool {
+    true
+}
+
+fn default_process_memory_rss_delta_kb() -> u64 {
+    super::ebpf_memory::DEFAULT_RSS_DELTA_KB
+}
+
+fn default_runqueue_latency_threshold_us() -> u64 {
+    5_000
+}
+
+fn default_runqueue_latency_min_interval_ms() -> u64 {
+    50
+}
+
+fn default_attachment_idle_timeout_secs() -> u64 {
+    super::ebpf_demand::DEFAULT_ATTACHMENT_IDLE_TIMEOUT.as_secs()
+}
+
+fn default_epoch_interval_ms() -> u64 {
+    super::ebpf_epoch::DEFAULT_EPOCH_INTERVAL_MS
 }
 
 impl Default for EbpfConfig {
@@ -162,6 +450,25 @@ impl Default for EbpfConfig {
             enable_notifications: true,
             notification_thresholds: EbpfNotificationThresholds::default(),
             filter_config: EbpfFilterConfig::default(),
+            enable_ringbuf_events: false,
+            ringbuf_wakeup_threshold_bytes: default_ringbuf_wakeup_threshold_bytes(),
+            ringbuf_poll_timeout_ms: default_ringbuf_poll_timeout_ms(),
+            syscall_latency_app_syscalls: default_syscall_latency_app_syscalls(),
+            enable_adaptive_sampling: default_enable_adaptive_sampling(),
+            sampling_cpu_budget_percent: default_sampling_cpu_budget_percent(),
+            max_sampling_rate: default_max_sampling_rate(),
+            enable_overhead_stats: default_enable_overhead_stats(),
+            process_memory_rss_delta_kb: default_process_memory_rss_delta_kb(),
+            filesystem_mode: FilesystemMonitorMode::default(),
+            enable_memory_pressure_monitoring: false,
+            enable_kmem_allocation_tracking: false,
+            enable_runqueue_latency_fast_path: false,
+            runqueue_latency_threshold_us: default_runqueue_latency_threshold_us(),
+            runqueue_latency_min_interval_ms: default_runqueue_latency_min_interval_ms(),
+            demand_driven_attachment: false,
+            attachment_idle_timeout_secs: default_attachment_idle_timeout_secs(),
+            enable_epoch_aggregation: false,
+            epoch_interval_ms: default_epoch_interval_ms(),
         }
     }
 }
@@ -223,6 +530,12 @@ pub struct EbpfFilterConfig {
     pub min_process_priority: i32,
     /// Максимальный приоритет процесса для фильтрации
     pub max_process_priority: i32,
+    /// Включить фильтрацию по cgroup (учитывается вместе с поддеревом)
+    #[serde(default)]
+    pub enable_cgroup_filtering: bool,
+    /// Пути cgroup v2 относительно /sys/fs/cgroup (например, "user.slice")
+    #[serde(default)]
+    pub filtered_cgroups: Vec<String>,
 }
 
 impl Default for EbpfFilterConfig {
@@ -255,6 +568,8 @@ impl Default for EbpfFilterConfig {
             enable_process_priority_filtering: false,
             min_process_priority: -20, // Минимальный приоритет (наивысший)
             max_process_priority: 19,  // Максимальный приоритет (наименьший)
+            enable_cgroup_filtering: false,
+            filtered_cgroups: Vec::new(),
         }
     }
 }
@@ -279,8 +594,11 @@ pub struct EbpfStatus {
 /// Статистика по температуре CPU
 #[derive(Debug, Clone, PartialEq, serde::Serialize, serde::Deserialize)]
 pub struct CpuTemperatureStat {
-    /// Идентификатор CPU ядра
+    /// Номер термальной зоны (`thermal_zoneN`)
     pub cpu_id: u32,
+    /// Тип термальной зоны (`x86_pkg_temp`, `cpu-thermal`, ...)
+    #[serde(default)]
+    pub zone_type: String,
     /// Текущая температура CPU (в градусах Цельсия)
     pub temperature_celsius: u32,
     /// Максимальная температура CPU (в градусах Цельсия)
@@ -314,25 +632,6 @@ pub struct GpuStat {
     pub max_temperature_celsius: u32,
 }
 
-/// Статистика по операциям с файловой системой
-#[derive(Debug, Clone, PartialEq, serde::Serialize, serde::Deserialize)]
-pub struct FilesystemStat {
-    /// Идентификатор файла
-    pub file_id: u32,
-    /// Количество операций чтения
-    pub read_count: u64,
-    /// Количество операций записи
-    pub write_count: u64,
-    /// Количество операций открытия
-    pub open_count: u64,
-    /// Количество операций закрытия
-    pub close_count: u64,
-    /// Количество прочитанных байт
-    pub bytes_read: u64,
-    /// Количество записанных байт
-    pub bytes_written: u64,
-}
-
 /// Статистика по сетевым соединениям
 #[derive(Debug, Clone, PartialEq, serde::Serialize, serde::Deserialize)]
 pub struct ConnectionStat {
@@ -356,6 +655,50 @@ pub struct ConnectionStat {
     pub start_time: u64,
     /// Время последней активности
     pub last_activity: u64,
+    /// Семейство адресов (AF_INET, AF_INET6)
+    #[serde(default)]
+    pub family: u16,
+    /// Адрес источника, в том числе IPv6
+    #[serde(default)]
+    pub src_addr: Option<std::net::IpAddr>,
+    /// Адрес назначения, в том числе IPv6
+    #[serde(default)]
+    pub dst_addr: Option<std::net::IpAddr>,
+    /// Процесс-владелец соединения (0, если неизвестен)
+    #[serde(default)]
+    pub tgid: u32,
+}
+
+impl ConnectionStat {
+    /// Построить статистику из записи `connection_map`.
+    ///
+    /// Для IPv6 соединений `src_ip`/`dst_ip` равны 0, адреса доступны в
+    /// `src_addr`/`dst_addr`.
+    pub fn from_record(record: &RawConnectionRecord) -> Self {
+        let src_addr = record.src_addr();
+        let dst_addr = record.dst_addr();
+        let ipv4 = |addr: Option<std::net::IpAddr>| match addr {
+            Some(std::net::IpAddr::V4(v4)) => u32::from(v4),
+            _ => 0,
+        };
+
+        Self {
+            src_ip: ipv4(src_addr),
+            dst_ip: ipv4(dst_addr),
+            src_port: record.sport,
+            dst_port: record.dport,
+            protocol: record.protocol,
+            state: record.state,
+            packets: record.packets,
+            bytes: record.bytes,
+            start_time: record.start_time,
+            last_activity: record.last_activity,
+            family: record.family,
+            src_addr,
+            dst_addr,
+            tgid: record.tgid,
+        }
+    }
 }
 
 /// Статистика по процесс-специфичным метрикам
@@ -383,6 +726,90 @@ pub struct ProcessStat {
     pub name: String,
 }
 
+impl ProcessStat {
+    /// Собрать статистику процесса из записи `process_map`.
+    ///
+    /// Запись хранит только идентичность процесса; счётчики дополняются из
+    /// карт общих программ.
+    pub fn from_raw(raw: &RawProcessInfo) -> Self {
+        Self {
+            pid: raw.tgid,
+            tgid: raw.tgid,
+            ppid: raw.ppid,
+            cpu_time: 0,
+            memory_usage: 0,
+            syscall_count: 0,
+            io_bytes: 0,
+            start_time: raw.start_time,
+            last_activity: raw.last_activity,
+            name: comm_to_string(&raw.comm),
+        }
+    }
+
+    /// Статистика процесса, известного только по счётчикам общей программы
+    /// системных вызовов (например, запущенного до загрузки программ).
+    pub fn from_syscalls(tgid: u32, syscalls: &RawSyscallProcessStats) -> Self {
+        let mut stat = Self::from_raw(&RawProcessInfo {
+            tgid,
+            ..Default::default()
+        });
+        stat.name = syscalls.name();
+        stat.apply_syscalls(syscalls);
+        stat
+    }
+
+    /// Дополнить статистику счётчиками общей программы системных вызовов.
+    pub fn apply_syscalls(&mut self, syscalls: &RawSyscallProcessStats) {
+        self.syscall_count = syscalls.syscalls;
+        self.last_activity = self.last_activity.max(syscalls.last_syscall_ns);
+    }
+
+    /// Количество активных процессов: записи `process_map` с активностью и
+    /// процессы со счётчиками системных вызовов. `process_monitor` видит только
+    /// exec/fork/exit, поэтому процессы, запущенные до загрузки программы,
+    /// известны лишь по системным вызовам (как в [`Self::from_syscalls`]).
+    pub fn count_active(
+        processes: &[RawProcessInfo],
+        syscalls: &std::collections::HashMap<u32, RawSyscallProcessStats>,
+    ) -> u64 {
+        let mut active: std::collections::HashSet<u32> = processes
+            .iter()
+            .filter(|process| process.last_activity > 0)
+            .map(|process| process.tgid)
+            .collect();
+        active.extend(
+            syscalls
+                .iter()
+                .filter(|(_, syscalls)| syscalls.syscalls > 0)
+                .map(|(&tgid, _)| tgid),
+        );
+        active.len() as u64
+    }
+}
+
+impl ProcessMemoryStat {
+    /// Собрать статистику памяти из записи `process_memory_stats`.
+    pub fn from_raw(raw: &RawProcessMemoryStat, page_size: u64) -> Self {
+        let bytes = |pages: u64| pages.saturating_mul(page_size);
+        Self {
+            pid: raw.pid,
+            tgid: raw.tgid,
+            last_update_ns: raw.last_update_ns,
+            rss_bytes: bytes(raw.rss_pages),
+            vms_bytes: bytes(raw.vm_pages),
+            shared_bytes: bytes(raw.shared_pages),
+            swap_bytes: bytes(raw.swap_pages),
+            heap_usage: raw.heap_bytes,
+            stack_usage: bytes(raw.stack_pages),
+            anonymous_memory: bytes(raw.anon_pages),
+            file_backed_memory: bytes(raw.file_pages),
+            major_faults: raw.major_faults,
+            minor_faults: raw.minor_faults,
+            name: comm_to_string(&raw.comm),
+        }
+    }
+}
+
 /// Статистика по энергопотреблению процессов
 #[derive(Debug, Clone, PartialEq, serde::Serialize, serde::Deserialize)]
 pub struct ProcessEnergyStat {
@@ -390,15 +817,15 @@ pub struct ProcessEnergyStat {
     pub pid: u32,
     /// Идентификатор потока
     pub tgid: u32,
-    /// Потребление энергии в микроджоулях
+    /// Энергия, приписанная процессу с начала наблюдения, в микроджоулях
     pub energy_uj: u64,
-    /// Последнее обновление в наносекундах
+    /// Последнее переключение контекста с участием процесса в наносекундах
     pub last_update_ns: u64,
-    /// Идентификатор CPU
+    /// CPU последнего выполнения
     pub cpu_id: u32,
     /// Имя процесса
     pub name: String,
-    /// Потребление энергии в ваттах (вычисленное)
+    /// Средняя мощность процесса за последний интервал распределения в ваттах
     pub energy_w: f32,
 }
 
@@ -509,9 +936,9 @@ pub struct ProcessMemoryStat {
 /// Статистика по производительности приложений
 #[derive(Debug, Clone, PartialEq, serde::Serialize, serde::Deserialize)]
 pub struct ApplicationPerformanceStat {
-    /// Идентификатор процесса
+    /// Идентификатор процесса (TGID, статистика агрегирована по всем потокам)
     pub pid: u32,
-    /// Идентификатор потока
+    /// Идентификатор группы потоков
     pub tgid: u32,
     /// Время выполнения в наносекундах
     pub execution_time_ns: u64,
@@ -579,6 +1006,123 @@ pub struct ApplicationPerformanceStat {
     pub other_wait_percent: f32,
 }
 
+/// Доля `part` от `total` в процентах (0 при нулевом `total`).
+fn percent_of(part: u64, total: u64) -> f32 {
+    if total == 0 {
+        0.0
+    } else {
+        ((part as f64 / total as f64) * 100.0) as f32
+    }
+}
+
+impl ApplicationPerformanceStat {
+    /// Собрать статистику процесса из записи программы производительности
+    /// приложений, общей записи планировщика и счётчиков общей программы
+    /// системных вызовов.
+    ///
+    /// Возвращает `None`, если для процесса нет записи приложения или планировщика.
+    pub fn from_kernel(
+        app: Option<&RawApplicationPerformanceStats>,
+        sched: Option<&RawSchedTaskStats>,
+        syscalls: Option<&RawSyscallProcessStats>,
+    ) -> Option<Self> {
+        let tgid = app.map(|a| a.tgid).or_else(|| sched.map(|s| s.tgid))?;
+        let mut app = app.copied().unwrap_or_default();
+        let sched = sched.copied().unwrap_or_default();
+
+        // Системные вызовы и ожидание futex учитывает общая программа
+        let mut system_calls = 0;
+        let mut lock_wait_time_ns = 0;
+        if let Some(syscalls) = syscalls {
+            system_calls = syscalls.syscalls;
+            lock_wait_time_ns = syscalls.lock_wait_ns;
+            app.last_update_ns = app.last_update_ns.max(syscalls.last_syscall_ns);
+            if app.comm[0] == 0 {
+                app.comm = syscalls.comm;
+            }
+        }
+
+        // Проценты считаются от времени, учтённого планировщиком: выполнение,
+        // очередь выполнения и сон. Ожидание блокировок является частью этого
+        // времени и не суммируется повторно.
+        let total_time = sched.total_time_ns();
+        let execution_percent = percent_of(sched.runtime_ns, total_time);
+        let wait_percent = if total_time > 0 {
+            100.0 - execution_percent
+        } else {
+            0.0
+        };
+        let name = if app.comm[0] != 0 {
+            comm_to_string(&app.comm)
+        } else {
+            sched.name()
+        };
+
+        Some(Self {
+            pid: tgid,
+            tgid,
+            execution_time_ns: sched.runtime_ns,
+            io_wait_time_ns: sched.io_wait_ns,
+            cpu_wait_time_ns: sched.runqueue_wait_ns,
+            lock_wait_time_ns,
+            network_wait_time_ns: 0,
+            disk_wait_time_ns: 0,
+            memory_wait_time_ns: 0,
+            gpu_wait_time_ns: 0,
+            other_wait_time_ns: sched.sleep_ns,
+            total_time_ns: total_time,
+            last_update_ns: app.last_update_ns.max(sched.last_switch_ns),
+            cache_misses: 0,
+            cache_hits: 0,
+            branch_misses: 0,
+            branch_hits: 0,
+            page_faults: app.page_faults,
+            context_switches: sched.context_switches as u64,
+            system_calls,
+            interrupts: app.interrupts,
+            memory_allocations: 0,
+            memory_frees: 0,
+            name,
+            execution_percent,
+            wait_percent,
+            io_wait_percent: percent_of(sched.io_wait_ns, total_time),
+            cpu_wait_percent: percent_of(sched.runqueue_wait_ns, total_time),
+            lock_wait_percent: percent_of(lock_wait_time_ns, total_time),
+            network_wait_percent: 0.0,
+            disk_wait_percent: 0.0,
+            memory_wait_percent: 0.0,
+            gpu_wait_percent: 0.0,
+            other_wait_percent: percent_of(sched.sleep_ns, total_time),
+        })
+    }
+
+    /// Статистика процесса, известного только по счётчикам общей программы
+    /// системных вызовов.
+    pub fn from_syscalls(tgid: u32, syscalls: &RawSyscallProcessStats) -> Option<Self> {
+        let app = RawApplicationPerformanceStats {
+            tgid,
+            ..Default::default()
+        };
+        Self::from_kernel(Some(&app), None, Some(syscalls))
+    }
+
+    /// Учесть задержки из-за нехватки памяти программы `memory_pressure`.
+    ///
+    /// Ожидание памяти, как и ожидание блокировок, является частью времени,
+    /// учтённого планировщиком, и в общее время не добавляется.
+    pub fn apply_memory_stalls(&mut self, stalls: &RawMemoryStallProcess) {
+        self.memory_wait_time_ns = stalls.stalls.stall_ns;
+        self.memory_wait_percent = percent_of(stalls.stalls.stall_ns, self.total_time_ns);
+        self.last_update_ns = self.last_update_ns.max(stalls.last_stall_ns);
+    }
+
+    /// Учесть счётчики kmalloc/kfree программы `kmem_allocations`.
+    pub fn apply_kmem(&mut self, kmem: &RawKmemCounters) {
+        self.memory_allocations = kmem.allocations;
+        self.memory_frees = kmem.frees;
+    }
+}
+
 /// Структура для хранения eBPF метрик
 #[derive(Debug, Clone, Default, PartialEq, serde::Serialize, serde::Deserialize)]
 pub struct EbpfMetrics {
@@ -640,6 +1184,39 @@ pub struct EbpfMetrics {
     pub process_memory_details: Option<Vec<ProcessMemoryStat>>,
     /// Детализированная статистика по производительности приложений (опционально)
     pub application_performance_details: Option<Vec<ApplicationPerformanceStat>>,
+    /// Сводка по событиям жизненного цикла из кольцевого буфера (опционально)
+    #[serde(default)]
+    pub lifecycle_events: Option<LifecycleEventSummary>,
+    /// Перцентили задержек системных вызовов из log2 гистограмм (опционально)
+    #[serde(default)]
+    pub syscall_latency_details: Option<Vec<SyscallLatencyStat>>,
+    /// Стоимость eBPF программ, заполнение карт и отладочные счётчики (опционально)
+    #[serde(default)]
+    pub program_overhead: Option<EbpfOverheadReport>,
+    /// Реальный трафик самых нагруженных сокетов (опционально)
+    #[serde(default)]
+    pub socket_traffic_details: Option<Vec<SocketTrafficStat>>,
+    /// Задержки блочного ввода-вывода по устройствам и процессам (опционально)
+    #[serde(default)]
+    pub disk_latency_details: Option<Vec<DiskLatencyStat>>,
+    /// Глубина очереди блочных устройств (опционально)
+    #[serde(default)]
+    pub disk_queue_details: Option<Vec<DiskQueueStat>>,
+    /// Операции с файлами по процессам (опционально, детальный режим)
+    #[serde(default)]
+    pub filesystem_process_details: Option<Vec<ProcessFilesystemStat>>,
+    /// Задержки из-за нехватки памяти по процессам (опционально)
+    #[serde(default)]
+    pub memory_stall_details: Option<Vec<ProcessMemoryStallStat>>,
+    /// Задержки из-за нехватки памяти по cgroup (опционально)
+    #[serde(default)]
+    pub cgroup_memory_stall_details: Option<Vec<CgroupMemoryStallStat>>,
+    /// Потребление ресурсов по cgroup v2 из per-cgroup карт программ (опционально)
+    #[serde(default)]
+    pub cgroup_resource_details: Option<Vec<CgroupResourceStat>>,
+    /// Последние сводки эпох, собранные в ядре, от старых к новым (опционально)
+    #[serde(default)]
+    pub epoch_summaries: Option<Vec<EpochSummary>>,
 }
 
 /// Конфигурация порогов для уведомлений eBPF
@@ -736,75 +1313,63 @@ pub struct SyscallStat {
     pub avg_time_ns: u64,
 }
 
-/// Загрузить eBPF программу из файла
+/// Загрузить встроенную eBPF программу по имени
+///
+/// Байткод берётся из объектов `.bpf.o`, скомпилированных `build.rs` и встроенных
+/// в бинарник (см. [`super::ebpf_objects`]). Для совместимости допускается
+/// передавать путь к исходнику (`src/ebpf_programs/cpu_metrics.c`) — из него
+/// берётся только имя программы.
 #[cfg(feature = "ebpf")]
-fn load_ebpf_program_from_file(program_path: &str) -> Result<Program> {
-    use libbpf_rs::Program;
-    use std::path::Path;
+fn load_embedded_ebpf_program(program_name: &str) -> Result<Program> {
+    use super::ebpf_objects;
 
-    let path = Path::new(program_path);
-    if !path.exists() {
+    let name = ebpf_objects::program_name_from_path(program_name);
+    if !ebpf_objects::is_program_embedded(name) {
         tracing::error!(
-            "eBPF программа не найдена: {:?}. Проверьте путь к файлу и наличие программы",
-            program_path
+            "eBPF программа {} не встроена в бинарник. Проверьте, что сборка выполнялась с feature \"ebpf\" и доступным clang",
+            name
         );
-        anyhow::bail!("eBPF программа не найдена: {}. Убедитесь, что файл существует и путь корректен. Требуемые программы должны быть в директории src/ebpf_programs/", program_path);
+        anyhow::bail!("eBPF программа {} не встроена в бинарник. Встроенные программы: {:?}", name, ebpf_objects::embedded_program_names());
     }
 
-    tracing::info!("Загрузка eBPF программы из {:?}", program_path);
+    tracing::info!("Загрузка встроенной eBPF программы {}", name);
 
-    // Реальная загрузка eBPF программы с использованием libbpf-rs
-    let program = Program::from_file(path).context(format!(
-        "Не удалось загрузить eBPF программу из {:?}. Это может быть вызвано: 1) Несовместимостью версии ядра (требуется Linux 5.4+), 2) Отсутствием необходимых прав (CAP_BPF или root), 3) Повреждением файла программы",
-        program_path
+    let program = EbpfObject::load(name).context(format!(
+        "Не удалось загрузить eBPF программу {}. Это может быть вызвано: 1) Несовместимостью версии ядра (требуется Linux 5.4+), 2) Отсутствием необходимых прав (CAP_BPF или root), 3) Отсутствием BTF для CO-RE релокаций",
+        name
     ))?;
 
-    tracing::info!("eBPF программа успешно загружена из {:?}", program_path);
-    Ok(program)
+    tracing::info!("eBPF программа {} успешно загружена", name);
+    Ok(std::sync::Arc::new(program))
 }
 
-/// Загрузить eBPF программу из файла с таймаутом
+/// Загрузить встроенную eBPF программу с таймаутом
 #[cfg(feature = "ebpf")]
-fn load_ebpf_program_from_file_with_timeout(
-    program_path: &str,
-    timeout_ms: u64,
-) -> Result<Program> {
-    use libbpf_rs::Program;
-    use std::path::Path;
+fn load_embedded_ebpf_program_with_timeout(program_name: &str, timeout_ms: u64) -> Result<Program> {
     use std::time::Instant;
 
-    let path = Path::new(program_path);
-    if !path.exists() {
-        tracing::warn!("eBPF программа не найдена: {:?}", program_path);
-        anyhow::bail!("eBPF программа не найдена: {}", program_path);
-    }
-
     tracing::info!(
-        "Загрузка eBPF программы из {:?} (таймаут: {}ms)",
-        program_path,
+        "Загрузка встроенной eBPF программы {} (таймаут: {}ms)",
+        program_name,
         timeout_ms
     );
 
     let start_time = Instant::now();
 
-    // Реальная загрузка eBPF программы с использованием libbpf-rs
-    let program = Program::from_file(path).context(format!(
-        "Не удалось загрузить eBPF программу из {:?}",
-        program_path
-    ))?;
+    let program = load_embedded_ebpf_program(program_name)?;
 
     let elapsed = start_time.elapsed();
     if elapsed.as_millis() > timeout_ms as u128 {
         tracing::warn!(
-            "Загрузка eBPF программы {:?} превысила таймаут ({}ms > {}ms)",
-            program_path,
+            "Загрузка eBPF программы {} превысила таймаут ({}ms > {}ms)",
+            program_name,
             elapsed.as_millis(),
             timeout_ms
         );
     } else {
         tracing::info!(
-            "eBPF программа успешно загружена из {:?} за {:?}",
-            program_path,
+            "eBPF программа {} успешно загружена за {:?}",
+            program_name,
             elapsed
         );
     }
@@ -812,31 +1377,29 @@ fn load_ebpf_program_from_file_with_timeout(
     Ok(program)
 }
 
-/// Параллельная загрузка нескольких eBPF программ
+/// Параллельная загрузка нескольких встроенных eBPF программ
 #[cfg(feature = "ebpf")]
 fn load_ebpf_programs_parallel(
-    program_paths: Vec<&str>,
+    program_names: Vec<&'static str>,
     timeout_ms: u64,
 ) -> Result<Vec<Option<Program>>> {
     use std::sync::mpsc;
     use std::thread;
-    use std::time::Duration;
+    use std::time::{Duration, Instant};
 
-    tracing::info!(
-        "Параллельная загрузка {} eBPF программ",
-        program_paths.len()
-    );
+    let program_count = program_names.len();
+    tracing::info!("Параллельная загрузка {} eBPF программ", program_count);
 
     let (sender, receiver) = mpsc::channel();
     let mut handles = Vec::new();
 
-    for (index, path) in program_paths.into_iter().enumerate() {
+    for (index, name) in program_names.into_iter().enumerate() {
         let sender = sender.clone();
         let timeout = timeout_ms;
 
         let handle = thread::spawn(move || {
-            let result = load_ebpf_program_from_file_with_timeout(path, timeout);
-            sender.send((index, result)).unwrap();
+            let result = load_embedded_ebpf_program_with_timeout(name, timeout);
+            let _ = sender.send((index, result));
         });
 
         handles.push(handle);
@@ -846,10 +1409,10 @@ fn load_ebpf_programs_parallel(
     let timeout_duration = Duration::from_millis(timeout_ms * 2); // Общий таймаут
     let start_time = Instant::now();
 
-    let mut results = vec![None; program_paths.len()];
+    let mut results: Vec<Option<Program>> = vec![None; program_count];
     let mut completed_count = 0;
 
-    loop {
+    while completed_count < program_count {
         match receiver.recv_timeout(timeout_duration.saturating_sub(start_time.elapsed())) {
             Ok((index, result)) => {
                 match result {
@@ -863,16 +1426,12 @@ fn load_ebpf_programs_parallel(
                     }
                 }
                 completed_count += 1;
-
-                if completed_count == program_paths.len() {
-                    break;
-                }
             }
             Err(_) => {
                 tracing::warn!(
                     "Таймаут ожидания загрузки программ ({} из {})",
                     completed_count,
-                    program_paths.len()
+                    program_count
                 );
                 break;
             }
@@ -894,6 +1453,9 @@ fn load_ebpf_programs_parallel(
 }
 
 /// Кэш загруженных eBPF программ для оптимизации производительности
+///
+/// Ключом служит имя встроенной программы; один загруженный объект
+/// разделяется между всеми потребителями через `Arc`.
 #[cfg(feature = "ebpf")]
 struct EbpfProgramCache {
     cache: std::collections::HashMap<String, Program>,
@@ -912,18 +1474,18 @@ impl EbpfProgramCache {
     }
 
     /// Получить программу из кэша или загрузить новую
-    fn get_or_load(&mut self, program_path: &str, timeout_ms: u64) -> Result<Program> {
-        if let Some(program) = self.cache.get(program_path) {
+    fn get_or_load(&mut self, program_name: &str, timeout_ms: u64) -> Result<Program> {
+        if let Some(program) = self.cache.get(program_name) {
             self.hit_count += 1;
-            tracing::debug!("Кэш-хит для программы {:?}", program_path);
+            tracing::debug!("Кэш-хит для программы {}", program_name);
             return Ok(program.clone());
         }
 
         self.miss_count += 1;
-        tracing::debug!("Кэш-мисс для программы {:?}, загрузка...", program_path);
+        tracing::debug!("Кэш-мисс для программы {}, загрузка...", program_name);
 
-        let program = load_ebpf_program_from_file_with_timeout(program_path, timeout_ms)?;
-        self.cache.insert(program_path.to_string(), program.clone());
+        let program = load_embedded_ebpf_program_with_timeout(program_name, timeout_ms)?;
+        self.cache.insert(program_name.to_string(), program.clone());
 
         Ok(program)
     }
@@ -947,59 +1509,80 @@ impl EbpfProgramCache {
     }
 }
 
-/// Загрузить eBPF карты из программы
+/// Получить карты загруженной eBPF программы по именам
+///
+/// Карты берутся из того же объекта, что и программа, поэтому повторная
+/// загрузка объекта не требуется. Отсутствующие карты пропускаются
+/// с предупреждением (варианты программ могут не содержать дополнительных карт).
 #[cfg(feature = "ebpf")]
-fn load_maps_from_program(program_path: &str, expected_map_name: &str) -> Result<Vec<Map>> {
-    use libbpf_rs::{Map, Program};
-    use std::path::Path;
+fn load_maps_from_program(program: &EbpfObject, map_names: &[&str]) -> Result<Vec<Map>> {
+    let mut maps = Vec::with_capacity(map_names.len());
 
-    let path = Path::new(program_path);
-    if !path.exists() {
-        tracing::warn!("eBPF программа не найдена: {:?}", program_path);
-        return Ok(Vec::new());
+    for map_name in map_names {
+        match program.map_handle(map_name)? {
+            Some(map) => maps.push(map),
+            None => tracing::warn!(
+                "Карта {} не найдена в eBPF программе {}",
+                map_name,
+                program.name()
+            ),
+        }
     }
 
-    tracing::info!("Загрузка eBPF карт из программы {:?}", program_path);
-
-    // Загружаем программу для доступа к картам
-    let program = Program::from_file(path).context(format!(
-        "Не удалось загрузить eBPF программу для извлечения карт из {:?}",
-        program_path
-    ))?;
-
-    // Получаем доступ к картам программы
-    let mut maps = Vec::new();
-
-    // Пробуем получить карту по имени
-    // В реальной реализации libbpf-rs предоставляет доступ к картам через skeleton
-    // Для упрощения создаем карту с ожидаемым именем
-
-    // Создаем карту с ожидаемым именем
-    let map = Map::from_file(path, expected_map_name).context(format!(
-        "Не удалось загрузить карту {} из программы {:?}",
-        expected_map_name, program_path
-    ))?;
-
-    maps.push(map);
-
     tracing::info!(
-        "Успешно загружено {} карт из программы {:?}",
+        "Успешно загружено {} карт из программы {}",
         maps.len(),
-        program_path
+        program.name()
     );
     Ok(maps)
 }
 
+#[cfg(feature = "ebpf")]
+thread_local! {
+    /// Переиспользуемый буфер пакетного чтения карт (у каждого потока сбора свой)
+    static MAP_BATCH_BUFFER: std::cell::RefCell<MapBatchBuffer> =
+        std::cell::RefCell::new(MapBatchBuffer::new());
+}
+
+/// Прочитать записи процессов программы с состоянием в task storage
+///
+/// Основной вариант программы выгружает записи итератором `iterator`
+/// (см. [`super::ebpf_task_state`]). В legacy варианте итератора нет,
+/// и записи читаются обходом его HASH карт.
+#[cfg(feature = "ebpf")]
+fn read_task_state<T: Default + Copy>(
+    program: Option<&Program>,
+    iterator: &str,
+    maps: &[Map],
+    capacity_hint: usize,
+) -> Result<Vec<T>> {
+    if let Some(program) = program {
+        if let Some(output) = program.read_iterator(iterator)? {
+            return Ok(ebpf_task_state::decode_records(&output));
+        }
+    }
+
+    let mut records = Vec::new();
+    for map in maps {
+        records.extend(iterate_ebpf_map_keys::<T>(map, capacity_hint)?);
+    }
+    Ok(records)
+}
+
 /// Итерироваться по всем ключам в eBPF карте и собирать данные
 ///
-/// Эта функция обеспечивает полный сбор данных из eBPF карт, итерируясь по всем ключам
-/// и извлекая соответствующие значения. Она используется всеми методами сбора метрик
-/// для обеспечения полного и точного сбора данных.
+/// Эта функция обеспечивает полный сбор данных из eBPF карт и используется всеми
+/// методами сбора метрик. Основной путь — пакетное чтение через `BPF_MAP_LOOKUP_BATCH`
+/// (Linux 5.6+) в переиспользуемый буфер потока: несколько системных вызовов на карту
+/// вместо двух на каждую запись. На ядрах без пакетных команд выполняется
+/// поэлементный обход через `get_next_key` + `lookup`.
+///
+/// Для per-CPU карт каждое значение CPU возвращается отдельным элементом.
 ///
 /// # Параметры
 ///
 /// * `map` - Ссылка на eBPF карту для итерации
-/// * `value_size` - Ожидаемый размер значения в байтах (для валидации)
+/// * `capacity_hint` - Ожидаемое количество записей (определяет размер пачки)
 ///
 /// # Возвращает
 ///
@@ -1020,117 +1603,400 @@ fn load_maps_from_program(program_path: &str, expected_map_name: &str) -> Result
 /// }
 /// ```
 #[cfg(feature = "ebpf")]
-fn iterate_ebpf_map_keys<T: Default + Copy>(map: &Map, value_size: usize) -> Result<Vec<T>> {
-    use libbpf_rs::Map;
-    use std::mem::size_of;
-
-    let mut results = Vec::new();
-
-    // Пробуем получить первый ключ
-    let mut key = 0u32;
-    let mut next_key = key;
-
-    loop {
-        // Пробуем получить значение для текущего ключа
-        match map.lookup(&next_key, 0) {
-            Ok(value_bytes) => {
-                // Проверяем, что размер значения соответствует ожидаемому
-                if value_bytes.len() >= value_size {
-                    // Преобразуем байты в структуру T
-                    let mut value = T::default();
-                    let value_ptr = &value as *const T as *const u8;
-
-                    // Копируем байты в структуру (упрощенная реализация)
-                    if value_bytes.len() >= size_of::<T>() {
-                        unsafe {
-                            std::ptr::copy_nonoverlapping(
-                                value_bytes.as_ptr(),
-                                value_ptr as *mut u8,
-                                size_of::<T>(),
-                            );
-                        }
-                        results.push(value);
-                    }
+fn iterate_ebpf_map_keys<T: Default + Copy>(map: &Map, capacity_hint: usize) -> Result<Vec<T>> {
+    use libbpf_rs::{MapCore, MapFlags};
+    use std::os::fd::AsRawFd;
+
+    let key_size = map.key_size() as usize;
+    let map_type = map.map_type();
+    let map_type_id = map_type as u32;
+    let MapValueLayout {
+        per_cpu,
+        slot_size,
+        stride,
+    } = MapValueLayout::of(map)?;
+
+    let mut results = Vec::with_capacity(capacity_hint.min(ebpf_batch::MAX_BATCH_ENTRIES));
+
+    if !ebpf_batch::is_batch_unsupported(map_type_id) {
+        let batched = MAP_BATCH_BUFFER.with(|buffer| {
+            let mut buffer = buffer.borrow_mut();
+            buffer.prepare(key_size, stride, capacity_hint);
+            let mut source = KernelMapBatch::lookup(map.as_fd().as_raw_fd());
+            buffer.drain(&mut source, |_, values, count| {
+                ebpf_batch::decode_values(values, count, stride, slot_size, &mut results)
+            })
+        });
+
+        match batched {
+            Ok(_) => return Ok(results),
+            Err(BatchStatus::Unsupported) => {
+                ebpf_batch::mark_batch_unsupported(map_type_id);
+                tracing::debug!(
+                    "BPF_MAP_LOOKUP_BATCH не поддерживается для карт типа {:?}, используется поэлементный обход",
+                    map_type
+                );
+            }
+            Err(status) => {
+                tracing::warn!(
+                    "Ошибка пакетного чтения eBPF карты ({:?}), используется поэлементный обход",
+                    status
+                );
+            }
+        }
+        results.clear();
+    }
+
+    // Поэлементный обход для ядер без пакетных команд
+    for key in map.keys() {
+        if per_cpu {
+            if let Some(per_cpu_values) = map.lookup_percpu(&key, MapFlags::ANY)? {
+                for value in per_cpu_values {
+                    ebpf_batch::decode_values(&value, 1, value.len(), value.len(), &mut results);
                 }
+            }
+        } else if let Some(value) = map.lookup(&key, MapFlags::ANY)? {
+            ebpf_batch::decode_values(&value, 1, value.len(), value.len(), &mut results);
+        }
+    }
 
-                // Пробуем получить следующий ключ
-                match map.next_key(&next_key) {
-                    Ok(next) => {
-                        if let Ok(next_u32) = <[u8; 4]>::try_from(&next[..4]) {
-                            next_key = u32::from_le_bytes(next_u32);
-                        } else {
-                            break;
-                        }
-                    }
-                    Err(_) => break, // Нет больше ключей
+    Ok(results)
+}
+
+/// Раскладка значений карты в буфере чтения
+#[cfg(feature = "ebpf")]
+struct MapValueLayout {
+    /// Значение хранится отдельно для каждого CPU
+    per_cpu: bool,
+    /// Размер значения одного CPU
+    slot_size: usize,
+    /// Размер значения записи со всеми CPU
+    stride: usize,
+}
+
+#[cfg(feature = "ebpf")]
+impl MapValueLayout {
+    fn of(map: &Map) -> Result<Self> {
+        use libbpf_rs::{MapCore, MapType};
+
+        let value_size = map.value_size() as usize;
+        let per_cpu = matches!(
+            map.map_type(),
+            MapType::PercpuHash | MapType::PercpuArray | MapType::LruPercpuHash
+        );
+        let possible_cpus = if per_cpu {
+            libbpf_rs::num_possible_cpus().context("Не удалось определить количество CPU")?
+        } else {
+            1
+        };
+        let slot_size = if per_cpu {
+            ebpf_batch::value_stride(value_size, true, 1)
+        } else {
+            value_size
+        };
+
+        Ok(Self {
+            per_cpu,
+            slot_size,
+            stride: ebpf_batch::value_stride(value_size, per_cpu, possible_cpus),
+        })
+    }
+}
+
+/// Итерация по eBPF карте с сохранением ключей.
+///
+/// В отличие от [`iterate_ebpf_map_keys`] возвращает пары (ключ, значения), где
+/// для per-CPU карт значения всех CPU собраны в один вектор записи — это нужно
+/// картам, ключ которых несёт смысл (номер системного вызова, PID).
+#[cfg(feature = "ebpf")]
+fn iterate_ebpf_map_entries<K: Default + Copy, T: Default + Copy>(
+    map: &Map,
+    capacity_hint: usize,
+) -> Result<Vec<(K, Vec<T>)>> {
+    use libbpf_rs::{MapCore, MapFlags};
+    use std::os::fd::AsRawFd;
+
+    let key_size = map.key_size() as usize;
+    let map_type = map.map_type();
+    let map_type_id = map_type as u32;
+    let MapValueLayout {
+        per_cpu,
+        slot_size,
+        stride,
+    } = MapValueLayout::of(map)?;
+
+    let mut results: Vec<(K, Vec<T>)> =
+        Vec::with_capacity(capacity_hint.min(ebpf_batch::MAX_BATCH_ENTRIES));
+    let mut keys: Vec<K> = Vec::new();
+
+    if !ebpf_batch::is_batch_unsupported(map_type_id) {
+        let batched = MAP_BATCH_BUFFER.with(|buffer| {
+            let mut buffer = buffer.borrow_mut();
+            buffer.prepare(key_size, stride, capacity_hint);
+            let mut source = KernelMapBatch::lookup(map.as_fd().as_raw_fd());
+            buffer.drain(&mut source, |raw_keys, values, count| {
+                keys.clear();
+                ebpf_batch::decode_values(raw_keys, count, key_size, key_size, &mut keys);
+                for (key, entry) in keys.iter().zip(values.chunks_exact(stride)) {
+                    let mut per_cpu_values = Vec::new();
+                    ebpf_batch::decode_values(entry, 1, stride, slot_size, &mut per_cpu_values);
+                    results.push((*key, per_cpu_values));
                 }
+            })
+        });
+
+        match batched {
+            Ok(_) => return Ok(results),
+            Err(BatchStatus::Unsupported) => {
+                ebpf_batch::mark_batch_unsupported(map_type_id);
+                tracing::debug!(
+                    "BPF_MAP_LOOKUP_BATCH не поддерживается для карт типа {:?}, используется поэлементный обход",
+                    map_type
+                );
             }
-            Err(_) => {
-                // Ключ не найден, пробуем следующий
-                match map.next_key(&next_key) {
-                    Ok(next) => {
-                        if let Ok(next_u32) = <[u8; 4]>::try_from(&next[..4]) {
-                            next_key = u32::from_le_bytes(next_u32);
-                        } else {
-                            break;
-                        }
-                    }
-                    Err(_) => break, // Нет больше ключей
+            Err(status) => {
+                tracing::warn!(
+                    "Ошибка пакетного чтения eBPF карты ({:?}), используется поэлементный обход",
+                    status
+                );
+            }
+        }
+        results.clear();
+    }
+
+    // Поэлементный обход для ядер без пакетных команд
+    for raw_key in map.keys() {
+        keys.clear();
+        ebpf_batch::decode_values(&raw_key, 1, raw_key.len(), raw_key.len(), &mut keys);
+        let Some(&key) = keys.first() else {
+            continue;
+        };
+
+        let mut values = Vec::new();
+        if per_cpu {
+            if let Some(per_cpu_values) = map.lookup_percpu(&raw_key, MapFlags::ANY)? {
+                for value in per_cpu_values {
+                    ebpf_batch::decode_values(&value, 1, value.len(), value.len(), &mut values);
                 }
             }
+        } else if let Some(value) = map.lookup(&raw_key, MapFlags::ANY)? {
+            ebpf_batch::decode_values(&value, 1, value.len(), value.len(), &mut values);
         }
+        results.push((key, values));
     }
 
     Ok(results)
 }
 
-/// Основной структуры для управления eBPF метриками
-pub struct EbpfMetricsCollector {
-    config: EbpfConfig,
-    #[cfg(feature = "ebpf")]
-    cpu_program: Option<Program>,
-    #[cfg(feature = "ebpf")]
-    memory_program: Option<Program>,
-    #[cfg(feature = "ebpf")]
-    syscall_program: Option<Program>,
-    #[cfg(feature = "ebpf")]
-    network_program: Option<Program>,
-    #[cfg(feature = "ebpf")]
-    network_connections_program: Option<Program>,
-    #[cfg(feature = "ebpf")]
-    process_monitoring_program: Option<Program>,
-    #[cfg(feature = "ebpf")]
-    process_energy_program: Option<Program>,
-    #[cfg(feature = "ebpf")]
-    process_gpu_program: Option<Program>,
-    #[cfg(feature = "ebpf")]
-    process_network_program: Option<Program>,
-    #[cfg(feature = "ebpf")]
-    process_disk_program: Option<Program>,
-    #[cfg(feature = "ebpf")]
-    process_memory_program: Option<Program>,
-    #[cfg(feature = "ebpf")]
-    gpu_program: Option<Program>,
-    #[cfg(feature = "ebpf")]
-    cpu_temperature_program: Option<Program>,
-    #[cfg(feature = "ebpf")]
-    filesystem_program: Option<Program>,
-    #[cfg(feature = "ebpf")]
-    application_performance_program: Option<Program>,
-    #[cfg(feature = "ebpf")]
-    cpu_maps: Vec<Map>,
-    #[cfg(feature = "ebpf")]
-    memory_maps: Vec<Map>,
-    #[cfg(feature = "ebpf")]
-    syscall_maps: Vec<Map>,
-    #[cfg(feature = "ebpf")]
-    network_maps: Vec<Map>,
-    #[cfg(feature = "ebpf")]
-    connection_maps: Vec<Map>,
+/// Прочитать per-CPU счётчик одним пакетным запросом и сложить копии всех CPU.
+///
+/// Для массива из нескольких слотов возвращается сумма по всем слотам.
+#[cfg(feature = "ebpf")]
+fn read_percpu_counter(map: &Map) -> Result<u64> {
+    let values = iterate_ebpf_map_keys::<u64>(map, 1)?;
+    Ok(ebpf_counters::sum_per_cpu(&values))
+}
+
+/// Прочитать per-CPU карту cgroup и сложить копии CPU каждой записи
+///
+/// Для незагруженной программы или при ошибке чтения возвращает пустую таблицу.
+#[cfg(feature = "ebpf")]
+fn read_cgroup_table<V: CgroupCounters>(
+    map: Option<&Map>,
+    what: &str,
+) -> std::collections::HashMap<u64, V> {
+    let Some(map) = map else {
+        return std::collections::HashMap::new();
+    };
+
+    match iterate_ebpf_map_entries::<u64, V>(map, MAX_CGROUPS) {
+        Ok(entries) => reduce_cgroup_entries(&entries),
+        Err(e) => {
+            tracing::error!("Ошибка при чтении {} по cgroup: {}", what, e);
+            std::collections::HashMap::new()
+        }
+    }
+}
+
+/// Прочитать per-CPU счётчики с ключом одним пакетным запросом и свернуть их по ключу
+#[cfg(feature = "ebpf")]
+fn read_percpu_counters_by_key<K: Default + Copy + Eq + std::hash::Hash>(
+    map: &Map,
+    capacity_hint: usize,
+) -> Result<std::collections::HashMap<K, u64>> {
+    let entries = iterate_ebpf_map_entries::<K, u64>(map, capacity_hint)?;
+    Ok(ebpf_counters::reduce_keyed(entries))
+}
+
+/// Записать фильтры в карты объекта.
+///
+/// Возвращает `false`, если программа собрана без `smoothtask_filter.h`.
+#[cfg(feature = "ebpf")]
+fn write_kernel_filters(object: &EbpfObject, filters: &KernelFilterSet) -> Result<bool> {
+    use libbpf_rs::{MapCore, MapFlags};
+
+    let Some(config_map) = object.map_handle(FILTER_CONFIG_MAP_NAME)? else {
+        return Ok(false);
+    };
+    let config_key = 0u32.to_ne_bytes();
+
+    // На время замены списков фильтры выключены: лишнее событие лучше потерянного
+    config_map
+        .update(&config_key, &RawFilterConfig::default().to_ne_bytes(), MapFlags::ANY)
+        .context("Не удалось сбросить флаги фильтров")?;
+
+    if let Some(pid_map) = object.map_handle(FILTER_PID_MAP_NAME)? {
+        let keys = filters.pids.iter().flatten().map(|pid| pid.to_ne_bytes().to_vec());
+        replace_filter_keys(&pid_map, keys.collect())
+            .context("Не удалось обновить список разрешённых процессов")?;
+    }
+
+    if let Some(cgroup_map) = object.map_handle(FILTER_CGROUP_MAP_NAME)? {
+        let keys = filters.cgroup_ids.iter().flatten().map(|id| id.to_ne_bytes().to_vec());
+        replace_filter_keys(&cgroup_map, keys.collect())
+            .context("Не удалось обновить список разрешённых cgroup")?;
+    }
+
+    if let Some(syscall_map) = object.map_handle(FILTER_SYSCALL_MAP_NAME)? {
+        for (syscall_id, allowed) in filters.syscall_table().into_iter().enumerate() {
+            syscall_map
+                .update(&(syscall_id as u32).to_ne_bytes(), &[allowed], MapFlags::ANY)
+                .context("Не удалось обновить таблицу разрешённых системных вызовов")?;
+        }
+    }
+
+    config_map
+        .update(&config_key, &filters.raw_config().to_ne_bytes(), MapFlags::ANY)
+        .context("Не удалось записать флаги фильтров")?;
+    Ok(true)
+}
+
+/// Записать коэффициенты выборки в таблицу объекта.
+///
+/// Возвращает `false`, если объект не использует адаптивную выборку.
+#[cfg(feature = "ebpf")]
+fn write_sampling_rates(object: &EbpfObject, rates: &[(SamplingClass, u32)]) -> Result<bool> {
+    use libbpf_rs::{MapCore, MapFlags};
+
+    let Some(sampling_map) = object.map_handle(SAMPLING_MAP_NAME)? else {
+        return Ok(false);
+    };
+
+    for &(class, rate) in rates {
+        let value = RawSamplingConfig { rate, _pad: 0 };
+        sampling_map
+            .update(
+                &class.index().to_ne_bytes(),
+                &value.to_ne_bytes(),
+                MapFlags::ANY,
+            )
+            .with_context(|| format!("Не удалось записать коэффициент выборки {}", class.name()))?;
+    }
+    Ok(true)
+}
+
+/// Записать конфигурацию программы учёта памяти процессов.
+#[cfg(feature = "ebpf")]
+fn write_process_memory_config(object: &EbpfObject, config: RawProcessMemoryConfig) -> Result<()> {
+    use libbpf_rs::{MapCore, MapFlags};
+
+    let config_map = object
+        .map_handle(PROCESS_MEMORY_CONFIG_MAP)?
+        .with_context(|| format!("Карта {} не найдена", PROCESS_MEMORY_CONFIG_MAP))?;
+    config_map.update(&0u32.to_ne_bytes(), &config.to_ne_bytes(), MapFlags::ANY)?;
+    Ok(())
+}
+
+/// Записать режим программы мониторинга файловой системы.
+#[cfg(feature = "ebpf")]
+fn write_filesystem_config(object: &EbpfObject, mode: FilesystemMonitorMode) -> Result<()> {
+    use libbpf_rs::{MapCore, MapFlags};
+
+    let config_map = object
+        .map_handle(FILESYSTEM_CONFIG_MAP)?
+        .with_context(|| format!("Карта {} не найдена", FILESYSTEM_CONFIG_MAP))?;
+    let config = RawFilesystemConfig::new(mode);
+    config_map.update(&0u32.to_ne_bytes(), &config.to_ne_bytes(), MapFlags::ANY)?;
+    Ok(())
+}
+
+/// Заменить ключи карты-множества: удалить устаревшие и добавить новые
+#[cfg(feature = "ebpf")]
+fn replace_filter_keys(map: &Map, keys: Vec<Vec<u8>>) -> Result<()> {
+    use libbpf_rs::{MapCore, MapFlags};
+
+    let stale: Vec<Vec<u8>> = map.keys().filter(|key| !keys.contains(key)).collect();
+    for key in stale {
+        map.delete(&key)?;
+    }
+    for key in &keys {
+        map.update(key, &[1u8], MapFlags::ANY)?;
+    }
+    Ok(())
+}
+
+/// Потребитель, от имени которого быстрый путь задержек очереди выполнения
+/// подписывается на события планировщика
+#[cfg(feature = "ebpf")]
+const RUNQUEUE_FAST_PATH_CONSUMER: &str = "runqueue_fast_path";
+
+/// Потребитель, от имени которого агрегатор эпох удерживает прикреплёнными
+/// программы-источники
+#[cfg(feature = "ebpf")]
+const EPOCH_AGGREGATION_CONSUMER: &str = "epoch_aggregation";
+
+/// Основной структуры для управления eBPF метриками
+pub struct EbpfMetricsCollector {
+    config: EbpfConfig,
     #[cfg(feature = "ebpf")]
-    process_maps: Vec<Map>,
+    cpu_program: Option<Program>,
+    #[cfg(feature = "ebpf")]
+    memory_program: Option<Program>,
+    #[cfg(feature = "ebpf")]
+    syscall_program: Option<Program>,
     #[cfg(feature = "ebpf")]
-    process_energy_maps: Vec<Map>,
+    network_program: Option<Program>,
+    #[cfg(feature = "ebpf")]
+    network_connections_program: Option<Program>,
+    #[cfg(feature = "ebpf")]
+    process_monitoring_program: Option<Program>,
+    #[cfg(feature = "ebpf")]
+    process_gpu_program: Option<Program>,
+    #[cfg(feature = "ebpf")]
+    process_network_program: Option<Program>,
+    #[cfg(feature = "ebpf")]
+    process_disk_program: Option<Program>,
+    #[cfg(feature = "ebpf")]
+    process_memory_program: Option<Program>,
+    #[cfg(feature = "ebpf")]
+    gpu_program: Option<Program>,
+    #[cfg(feature = "ebpf")]
+    cpu_temperature_program: Option<Program>,
+    #[cfg(feature = "ebpf")]
+    filesystem_program: Option<Program>,
+    #[cfg(feature = "ebpf")]
+    application_performance_program: Option<Program>,
+    /// Общая программа планировщика (единственный обработчик sched_switch)
+    #[cfg(feature = "ebpf")]
+    sched_program: Option<Program>,
+    /// Задержки из-за нехватки памяти (major page fault, swap-in, reclaim)
+    #[cfg(feature = "ebpf")]
+    memory_pressure_program: Option<Program>,
+    /// Счётчики kmalloc/kfree по процессам (включается отдельно)
+    #[cfg(feature = "ebpf")]
+    kmem_program: Option<Program>,
+    #[cfg(feature = "ebpf")]
+    cpu_maps: Vec<Map>,
+    #[cfg(feature = "ebpf")]
+    memory_maps: Vec<Map>,
+    #[cfg(feature = "ebpf")]
+    syscall_maps: Vec<Map>,
+    #[cfg(feature = "ebpf")]
+    network_maps: Vec<Map>,
+    #[cfg(feature = "ebpf")]
+    connection_maps: Vec<Map>,
+    #[cfg(feature = "ebpf")]
+    process_maps: Vec<Map>,
     #[cfg(feature = "ebpf")]
     process_gpu_maps: Vec<Map>,
     #[cfg(feature = "ebpf")]
@@ -1148,10 +2014,119 @@ pub struct EbpfMetricsCollector {
     #[cfg(feature = "ebpf")]
     application_performance_maps: Vec<Map>,
     #[cfg(feature = "ebpf")]
+    sched_maps: Vec<Map>,
+    /// Per-CPU гистограммы задержек по номеру системного вызова
+    #[cfg(feature = "ebpf")]
+    syscall_latency_map: Option<Map>,
+    /// Per-CPU гистограммы задержек по процессу и номеру системного вызова
+    #[cfg(feature = "ebpf")]
+    syscall_app_latency_map: Option<Map>,
+    /// Per-CPU счётчик принятых пакетов
+    #[cfg(feature = "ebpf")]
+    network_packet_counter: Option<Map>,
+    /// Per-CPU счётчики системных вызовов и ожидания futex по TGID
+    #[cfg(feature = "ebpf")]
+    syscall_process_map: Option<Map>,
+    /// Per-CPU трафик по cookie сокета
+    #[cfg(feature = "ebpf")]
+    socket_traffic_map: Option<Map>,
+    /// Per-CPU гистограммы задержек блочного ввода-вывода по процессу и устройству
+    #[cfg(feature = "ebpf")]
+    disk_latency_map: Option<Map>,
+    /// Очереди блочных устройств
+    #[cfg(feature = "ebpf")]
+    disk_device_map: Option<Map>,
+    /// Время GPU по процессам и кольцам
+    #[cfg(feature = "ebpf")]
+    gpu_process_usage_map: Option<Map>,
+    /// Итоги файловых операций по TGID (детальный режим)
+    #[cfg(feature = "ebpf")]
+    fs_process_io_map: Option<Map>,
+    /// Файловые операции по паре (файл, процесс) (детальный режим)
+    #[cfg(feature = "ebpf")]
+    fs_file_io_map: Option<Map>,
+    /// Per-CPU задержки памяти по TGID
+    #[cfg(feature = "ebpf")]
+    memory_stall_process_map: Option<Map>,
+    /// Per-CPU задержки памяти по cgroup
+    #[cfg(feature = "ebpf")]
+    memory_stall_cgroup_map: Option<Map>,
+    /// Per-CPU счётчики kmalloc/kfree по TGID
+    #[cfg(feature = "ebpf")]
+    kmem_process_map: Option<Map>,
+    /// Per-CPU время на CPU и переключения по cgroup
+    #[cfg(feature = "ebpf")]
+    sched_cgroup_map: Option<Map>,
+    /// Per-CPU дисковые операции по cgroup
+    #[cfg(feature = "ebpf")]
+    disk_cgroup_map: Option<Map>,
+    /// Per-CPU сетевой трафик по cgroup
+    #[cfg(feature = "ebpf")]
+    net_cgroup_map: Option<Map>,
+    /// Per-CPU время заданий GPU по cgroup
+    #[cfg(feature = "ebpf")]
+    gpu_cgroup_map: Option<Map>,
+    /// Per-CPU счётчики производительности по cgroup
+    #[cfg(feature = "ebpf")]
+    app_cgroup_map: Option<Map>,
+    /// Загрузка колец GPU между сборами
+    #[cfg(feature = "ebpf")]
+    gpu_ring_sampler: std::sync::Mutex<GpuBusySampler<u64>>,
+    /// Загрузка GPU процессами между сборами
+    #[cfg(feature = "ebpf")]
+    gpu_process_sampler: std::sync::Mutex<GpuBusySampler<u32>>,
+    /// Per-CPU занятость CPU из общей программы планировщика
+    #[cfg(feature = "ebpf")]
+    sched_oncpu_map: Option<Map>,
+    /// Распределение энергии RAPL между процессами
+    #[cfg(feature = "ebpf")]
+    energy_attributor: std::sync::Mutex<EnergyAttributor>,
+    /// Распределение той же энергии между cgroup
+    #[cfg(feature = "ebpf")]
+    cgroup_energy_attributor: std::sync::Mutex<EnergyAttributor<u64>>,
+    /// Пути cgroup по идентификатору
+    #[cfg(feature = "ebpf")]
+    cgroup_paths: std::sync::Mutex<CgroupPathCache>,
+    /// Доля времени ожидания памяти процессов и cgroup между сборами
+    #[cfg(feature = "ebpf")]
+    memory_stall_tracker: std::sync::Mutex<MemoryStallTracker>,
+    /// Гистограммы задержек системных вызовов предыдущего сбора
+    #[cfg(feature = "ebpf")]
+    syscall_latency_window: std::sync::Mutex<LatencyWindow<SyscallLatencyKey>>,
+    /// Критическая температура термальных зон из sysfs (миллиградусы)
+    #[cfg(feature = "ebpf")]
+    thermal_critical_trips: std::collections::HashMap<i32, i32>,
+    #[cfg(feature = "ebpf")]
     program_cache: EbpfProgramCache,
+    /// Поток событий жизненного цикла из кольцевого буфера (если включён)
+    #[cfg(feature = "ebpf")]
+    lifecycle_stream: Option<LifecycleEventStream>,
+    /// Поток событий быстрого пути задержек очереди выполнения (если запущен)
+    #[cfg(feature = "ebpf")]
+    runqueue_latency_stream: Option<RunqueueLatencyStream>,
+    /// Контроллер коэффициентов адаптивной выборки
+    #[cfg(feature = "ebpf")]
+    sampler: AdaptiveSampler,
+    /// Дескриптор `BPF_ENABLE_STATS`: учёт времени выполнения программ ведётся, пока он открыт
+    #[cfg(feature = "ebpf")]
+    bpf_stats_fd: Option<std::os::fd::OwnedFd>,
+    /// Время последней подстройки коэффициентов выборки
+    #[cfg(feature = "ebpf")]
+    last_sampling_adjust: Option<std::time::Instant>,
+    /// Последний отчёт о стоимости программ и заполнении карт
+    #[cfg(feature = "ebpf")]
+    overhead_report: Option<EbpfOverheadReport>,
+    /// Время сборки последнего отчёта о стоимости программ
+    #[cfg(feature = "ebpf")]
+    last_overhead_report: Option<std::time::Instant>,
+    /// Агрегатор счётчиков по эпохам в ядре (если запущен)
+    #[cfg(feature = "ebpf")]
+    epoch_aggregator: Option<EpochAggregator>,
+    /// Подписки потребителей на группы метрик (`demand_driven_attachment`)
+    demand: EbpfDemand,
     initialized: bool,
-    /// Кэш для хранения последних метрик (оптимизация производительности)
-    metrics_cache: Option<EbpfMetrics>,
+    /// Последний опубликованный снимок метрик (оптимизация производительности)
+    metrics_cache: Option<EbpfSnapshot>,
     /// Счетчик для пакетной обработки
     batch_counter: usize,
     /// Счетчик попыток инициализации
@@ -1190,6 +2165,11 @@ enum EbpfErrorCategory {
 impl EbpfMetricsCollector {
     /// Создать новый коллектор eBPF метрик
     pub fn new(config: EbpfConfig) -> Self {
+        #[cfg(feature = "ebpf")]
+        let sampler =
+            AdaptiveSampler::new(config.sampling_cpu_budget_percent, config.max_sampling_rate);
+        let demand = EbpfDemand::new(Duration::from_secs(config.attachment_idle_timeout_secs));
+
         Self {
             config,
             #[cfg(feature = "ebpf")]
@@ -1205,7 +2185,6 @@ impl EbpfMetricsCollector {
             #[cfg(feature = "ebpf")]
             process_monitoring_program: None,
             #[cfg(feature = "ebpf")]
-            process_energy_program: None,
             #[cfg(feature = "ebpf")]
             process_gpu_program: None,
             #[cfg(feature = "ebpf")]
@@ -1219,6 +2198,12 @@ impl EbpfMetricsCollector {
             #[cfg(feature = "ebpf")]
             application_performance_program: None,
             #[cfg(feature = "ebpf")]
+            sched_program: None,
+            #[cfg(feature = "ebpf")]
+            memory_pressure_program: None,
+            #[cfg(feature = "ebpf")]
+            kmem_program: None,
+            #[cfg(feature = "ebpf")]
             cpu_maps: Vec::new(),
             #[cfg(feature = "ebpf")]
             memory_maps: Vec::new(),
@@ -1231,7 +2216,6 @@ impl EbpfMetricsCollector {
             #[cfg(feature = "ebpf")]
             process_maps: Vec::new(),
             #[cfg(feature = "ebpf")]
-            process_energy_maps: Vec::new(),
             #[cfg(feature = "ebpf")]
             process_gpu_maps: Vec::new(),
             #[cfg(feature = "ebpf")]
@@ -1245,7 +2229,79 @@ impl EbpfMetricsCollector {
             #[cfg(feature = "ebpf")]
             application_performance_maps: Vec::new(),
             #[cfg(feature = "ebpf")]
+            sched_maps: Vec::new(),
+            #[cfg(feature = "ebpf")]
+            syscall_latency_map: None,
+            #[cfg(feature = "ebpf")]
+            syscall_app_latency_map: None,
+            #[cfg(feature = "ebpf")]
+            network_packet_counter: None,
+            #[cfg(feature = "ebpf")]
+            syscall_process_map: None,
+            #[cfg(feature = "ebpf")]
+            socket_traffic_map: None,
+            #[cfg(feature = "ebpf")]
+            disk_latency_map: None,
+            #[cfg(feature = "ebpf")]
+            disk_device_map: None,
+            #[cfg(feature = "ebpf")]
+            gpu_process_usage_map: None,
+            #[cfg(feature = "ebpf")]
+            fs_process_io_map: None,
+            #[cfg(feature = "ebpf")]
+            fs_file_io_map: None,
+            #[cfg(feature = "ebpf")]
+            memory_stall_process_map: None,
+            #[cfg(feature = "ebpf")]
+            memory_stall_cgroup_map: None,
+            #[cfg(feature = "ebpf")]
+            kmem_process_map: None,
+            #[cfg(feature = "ebpf")]
+            sched_cgroup_map: None,
+            #[cfg(feature = "ebpf")]
+            disk_cgroup_map: None,
+            #[cfg(feature = "ebpf")]
+            net_cgroup_map: None,
+            #[cfg(feature = "ebpf")]
+            gpu_cgroup_map: None,
+            #[cfg(feature = "ebpf")]
+            app_cgroup_map: None,
+            #[cfg(feature = "ebpf")]
+            gpu_ring_sampler: std::sync::Mutex::new(GpuBusySampler::new()),
+            #[cfg(feature = "ebpf")]
+            gpu_process_sampler: std::sync::Mutex::new(GpuBusySampler::new()),
+            #[cfg(feature = "ebpf")]
+            sched_oncpu_map: None,
+            #[cfg(feature = "ebpf")]
+            energy_attributor: std::sync::Mutex::new(EnergyAttributor::default()),
+            #[cfg(feature = "ebpf")]
+            cgroup_energy_attributor: std::sync::Mutex::new(EnergyAttributor::default()),
+            #[cfg(feature = "ebpf")]
+            cgroup_paths: std::sync::Mutex::new(CgroupPathCache::new(DEFAULT_CGROUP_ROOT)),
+            #[cfg(feature = "ebpf")]
+            memory_stall_tracker: std::sync::Mutex::new(MemoryStallTracker::new()),
+            syscall_latency_window: std::sync::Mutex::new(LatencyWindow::new()),
+            #[cfg(feature = "ebpf")]
+            thermal_critical_trips: std::collections::HashMap::new(),
+            #[cfg(feature = "ebpf")]
             program_cache: EbpfProgramCache::new(),
+            #[cfg(feature = "ebpf")]
+            lifecycle_stream: None,
+            #[cfg(feature = "ebpf")]
+            runqueue_latency_stream: None,
+            #[cfg(feature = "ebpf")]
+            sampler,
+            #[cfg(feature = "ebpf")]
+            bpf_stats_fd: None,
+            #[cfg(feature = "ebpf")]
+            last_sampling_adjust: None,
+            #[cfg(feature = "ebpf")]
+            overhead_report: None,
+            #[cfg(feature = "ebpf")]
+            last_overhead_report: None,
+            #[cfg(feature = "ebpf")]
+            epoch_aggregator: None,
+            demand,
             initialized: false,
             // Кэш для хранения последних метрик (оптимизация производительности)
             metrics_cache: None,
@@ -1668,7 +2724,7 @@ impl EbpfMetricsCollector {
                         tracing::info!("CPU программа успешно загружена");
                     }
                     Err(e) => {
-                        let error_msg = format!("Ошибка загрузки CPU программы: {}. Это может быть вызвано: 1) Отсутствием файла src/ebpf_programs/cpu_metrics.c, 2) Несовместимостью версии ядра (требуется Linux 5.4+), 3) Отсутствием прав CAP_BPF или root, 4) Повреждением файла программы. Попробуйте пересобрать программы с помощью make build-ebpf", e);
+                        let error_msg = format!("Ошибка загрузки CPU программы: {}. Это может быть вызвано: 1) Отсутствием встроенного объекта cpu_metrics (сборка без clang), 2) Несовместимостью версии ядра (требуется Linux 5.4+), 3) Отсутствием прав CAP_BPF или root, 4) Отсутствием BTF для CO-RE релокаций. Попробуйте пересобрать smoothtask-core с feature \"ebpf\" и доступным clang", e);
                         tracing::error!("{}", error_msg);
                         detailed_errors.push(format!("CPU: {}", e));
                         error_count += 1;
@@ -1684,7 +2740,7 @@ impl EbpfMetricsCollector {
                         tracing::info!("Программа памяти успешно загружена");
                     }
                     Err(e) => {
-                        let error_msg = format!("Ошибка загрузки программы памяти: {}. Это может быть вызвано: 1) Отсутствием файла src/ebpf_programs/memory_metrics.c, 2) Недостаточными правами для доступа к памяти (CAP_SYS_ADMIN), 3) Проблемами с доступом к /proc/meminfo, 4) Несовместимостью версии ядра. Проверьте права доступа и попробуйте запустить с sudo", e);
+                        let error_msg = format!("Ошибка загрузки программы памяти: {}. Это может быть вызвано: 1) Отсутствием встроенного объекта cpu_metrics, 2) Недостаточными правами для доступа к памяти (CAP_SYS_ADMIN), 3) Проблемами с доступом к /proc/meminfo, 4) Несовместимостью версии ядра. Проверьте права доступа и попробуйте запустить с sudo", e);
                         tracing::error!("{}", error_msg);
                         detailed_errors.push(format!("Memory: {}", e));
                         error_count += 1;
@@ -1693,14 +2749,14 @@ impl EbpfMetricsCollector {
                 }
             }
 
-            if self.config.enable_syscall_monitoring {
+            if self.needs_syscall_program() {
                 match self.load_syscall_program() {
                     Ok(_) => {
                         success_count += 1;
-                        tracing::info!("Программа мониторинга системных вызовов успешно загружена");
+                        tracing::info!("Общая программа системных вызовов успешно загружена");
                     }
                     Err(e) => {
-                        let error_msg = format!("Ошибка загрузки программы мониторинга системных вызовов: {}. Это может быть вызвано: 1) Отсутствием файла src/ebpf_programs/syscall_monitor.c, 2) Недостаточными правами (требуется CAP_SYS_ADMIN или root), 3) Несовместимостью версии ядра, 4) Конфликтом с другими eBPF программами. Попробуйте запустить с sudo или отключить другие eBPF инструменты", e);
+                        let error_msg = format!("Ошибка загрузки программы мониторинга системных вызовов: {}. Это может быть вызвано: 1) Отсутствием встроенного объекта syscall_monitor, 2) Недостаточными правами (требуется CAP_SYS_ADMIN или root), 3) Несовместимостью версии ядра, 4) Конфликтом с другими eBPF программами. Попробуйте запустить с sudo или отключить другие eBPF инструменты", e);
                         tracing::error!("{}", error_msg);
                         detailed_errors.push(format!("Syscall: {}", e));
                         error_count += 1;
@@ -1725,7 +2781,8 @@ impl EbpfMetricsCollector {
                 }
             }
 
-            if self.config.enable_gpu_monitoring {
+            // Время GPU процессов тоже считает программа мониторинга GPU
+            if self.config.enable_gpu_monitoring || self.config.enable_process_gpu_monitoring {
                 match self.load_gpu_program() {
                     Ok(_) => {
                         success_count += 1;
@@ -1809,24 +2866,29 @@ impl EbpfMetricsCollector {
                 }
             }
 
-            if self.config.enable_process_energy_monitoring {
-                match self.load_process_energy_program() {
+            if self.config.enable_application_performance_monitoring
+                || self.config.enable_process_energy_monitoring
+                || self.config.enable_process_memory_monitoring
+            {
+                match self.load_sched_program() {
                     Ok(_) => {
                         success_count += 1;
-                        tracing::info!(
-                            "Программа мониторинга энергопотребления процессов успешно загружена"
-                        );
+                        tracing::info!("Общая программа планировщика успешно загружена");
                     }
                     Err(e) => {
-                        let error_msg = format!("Ошибка загрузки программы мониторинга энергопотребления процессов: {}. Проверьте доступ к энергетическим сенсорам и права доступа", e);
+                        let error_msg = format!("Ошибка загрузки общей программы планировщика: {}. Время выполнения и ожидания процессов будет недоступно", e);
                         tracing::error!("{}", error_msg);
-                        detailed_errors.push(format!("ProcessEnergy: {}", e));
+                        detailed_errors.push(format!("Sched: {}", e));
                         error_count += 1;
                         self.last_error = Some(error_msg);
                     }
                 }
             }
 
+            if self.config.enable_process_energy_monitoring {
+                self.init_energy_attribution();
+            }
+
             if self.config.enable_process_gpu_monitoring {
                 match self.load_process_gpu_program() {
                     Ok(_) => {
@@ -1917,7 +2979,59 @@ impl EbpfMetricsCollector {
                 }
             }
 
+            if self.needs_memory_pressure_program() {
+                match self.load_memory_pressure_program() {
+                    Ok(_) => {
+                        success_count += 1;
+                        tracing::info!("Программа учёта задержек памяти успешно загружена");
+                    }
+                    Err(e) => {
+                        let error_msg = format!("Ошибка загрузки программы учёта задержек памяти: {}. Требуются BTF ядра и поддержка fentry/fexit", e);
+                        tracing::error!("{}", error_msg);
+                        detailed_errors.push(format!("MemoryPressure: {}", e));
+                        error_count += 1;
+                        self.last_error = Some(error_msg);
+                    }
+                }
+            }
+
+            if self.config.enable_kmem_allocation_tracking {
+                match self.load_kmem_program() {
+                    Ok(_) => {
+                        success_count += 1;
+                        tracing::info!("Программа учёта выделений памяти ядра успешно загружена");
+                    }
+                    Err(e) => {
+                        let error_msg = format!("Ошибка загрузки программы учёта выделений памяти ядра: {}. Проверьте доступ к точкам трассировки kmem", e);
+                        tracing::error!("{}", error_msg);
+                        detailed_errors.push(format!("Kmem: {}", e));
+                        error_count += 1;
+                        self.last_error = Some(error_msg);
+                    }
+                }
+            }
+
+            if self.config.enable_ringbuf_events {
+                match self.start_lifecycle_stream() {
+                    Ok(_) => {
+                        success_count += 1;
+                        tracing::info!("Поток событий жизненного цикла успешно запущен");
+                    }
+                    Err(e) => {
+                        let error_msg = format!("Ошибка запуска потока событий жизненного цикла: {}. Требуется ядро 5.8+ с поддержкой BPF_MAP_TYPE_RINGBUF; сбор продолжится через обход карт", e);
+                        tracing::error!("{}", error_msg);
+                        detailed_errors.push(format!("LifecycleEvents: {}", e));
+                        error_count += 1;
+                        self.last_error = Some(error_msg);
+                    }
+                }
+            }
+
             self.initialized = success_count > 0;
+            self.refresh_kernel_filters();
+            self.start_run_time_stats();
+            self.start_epoch_aggregation();
+            self.apply_attachment_demand();
 
             if success_count > 0 {
                 tracing::info!(
@@ -1985,113 +3099,52 @@ impl EbpfMetricsCollector {
         }
 
         // Собираем список программ для загрузки на основе конфигурации
-        let mut programs_to_load = Vec::new();
+        let mut programs_to_load: Vec<(&str, &'static str, &'static [&'static str])> = Vec::new();
 
-        if self.config.enable_cpu_metrics {
-            programs_to_load.push(("cpu", "src/ebpf_programs/cpu_metrics.c", "cpu_metrics_map"));
+        if self.config.enable_cpu_metrics && is_program_embedded("cpu_metrics") {
+            programs_to_load.push(("cpu", "cpu_metrics", &["cpu_metrics_map"]));
         }
 
-        if self.config.enable_memory_metrics {
-            programs_to_load.push((
-                "memory",
-                "src/ebpf_programs/cpu_metrics.c",
-                "cpu_metrics_map",
-            ));
+        if self.config.enable_memory_metrics && is_program_embedded("cpu_metrics") {
+            programs_to_load.push(("memory", "cpu_metrics", &["cpu_metrics_map"]));
         }
 
-        if self.config.enable_syscall_monitoring {
-            // Пробуем загрузить расширенную версию программы
-            let advanced_path = "src/ebpf_programs/syscall_monitor_advanced.c";
-            let basic_path = "src/ebpf_programs/syscall_monitor.c";
-
-            let program_path = if std::path::Path::new(advanced_path).exists() {
-                advanced_path
-            } else if std::path::Path::new(basic_path).exists() {
-                basic_path
+        if self.needs_syscall_program() {
+            if is_program_embedded(SYSCALL_PROGRAM) {
+                programs_to_load.push(("syscall", SYSCALL_PROGRAM, SYSCALL_MAP_NAMES));
             } else {
-                tracing::warn!("eBPF программы для мониторинга системных вызовов не найдены");
-                None
-            };
-
-            if let Some(path) = program_path {
-                programs_to_load.push(("syscall", path, "syscall_count_map"));
+                tracing::warn!("Общая eBPF программа системных вызовов не встроена");
             }
         }
 
-        if self.config.enable_network_monitoring {
-            let path = "src/ebpf_programs/network_monitor.c";
-            if std::path::Path::new(path).exists() {
-                programs_to_load.push(("network", path, "network_stats_map"));
-            }
+        if self.config.enable_network_monitoring && is_program_embedded("network_monitor") {
+            programs_to_load.push(("network", "network_monitor", &["network_stats_map"]));
         }
 
-        if self.config.enable_network_connections {
-            let path = "src/ebpf_programs/network_connections.c";
-            if std::path::Path::new(path).exists() {
-                programs_to_load.push(("connections", path, "connection_map"));
-            }
+        if self.config.enable_network_connections && is_program_embedded("network_connections") {
+            programs_to_load.push(("connections", "network_connections", CONNECTION_MAP_NAMES));
         }
 
-        if self.config.enable_gpu_monitoring {
-            // Пробуем загрузить комплексную версию программы (наиболее полная)
-            let comprehensive_path = "src/ebpf_programs/gpu_monitor_comprehensive.c";
-            let high_perf_path = "src/ebpf_programs/gpu_monitor_high_perf.c";
-            let memory_optimized_path = "src/ebpf_programs/gpu_monitor_memory_optimized.c";
-            let optimized_path = "src/ebpf_programs/gpu_monitor_optimized.c";
-            let basic_path = "src/ebpf_programs/gpu_monitor.c";
-
-            let program_path = if std::path::Path::new(comprehensive_path).exists() {
-                tracing::info!("Выбрана комплексная eBPF программа для мониторинга GPU");
-                comprehensive_path
-            } else if std::path::Path::new(high_perf_path).exists() {
-                tracing::info!("Выбрана высокопроизводительная eBPF программа для мониторинга GPU");
-                high_perf_path
-            } else if std::path::Path::new(memory_optimized_path).exists() {
-                tracing::info!(
-                    "Выбрана оптимизированная по памяти eBPF программа для мониторинга GPU"
-                );
-                memory_optimized_path
-            } else if std::path::Path::new(optimized_path).exists() {
-                tracing::info!("Выбрана оптимизированная eBPF программа для мониторинга GPU");
-                optimized_path
-            } else if std::path::Path::new(basic_path).exists() {
-                tracing::info!("Выбрана базовая eBPF программа для мониторинга GPU");
-                basic_path
-            } else {
-                None
-            };
+        if (self.config.enable_gpu_monitoring || self.config.enable_process_gpu_monitoring)
+            && is_program_embedded(GPU_PROGRAM)
+        {
+            programs_to_load.push(("gpu", GPU_PROGRAM, GPU_MAP_NAMES));
+        }
 
-            if let Some(path) = program_path {
-                programs_to_load.push(("gpu", path, "gpu_stats_map"));
-            }
+        if self.config.enable_filesystem_monitoring && is_program_embedded(FILESYSTEM_PROGRAM) {
+            programs_to_load.push(("filesystem", FILESYSTEM_PROGRAM, FILESYSTEM_MAP_NAMES));
         }
 
-        if self.config.enable_filesystem_monitoring {
-            // Пробуем загрузить высокопроизводительную версию программы
-            let high_perf_path = "src/ebpf_programs/filesystem_monitor_high_perf.c";
-            let optimized_path = "src/ebpf_programs/filesystem_monitor_optimized.c";
-            let basic_path = "src/ebpf_programs/filesystem_monitor.c";
-
-            let program_path = if std::path::Path::new(high_perf_path).exists() {
-                high_perf_path
-            } else if std::path::Path::new(optimized_path).exists() {
-                optimized_path
-            } else if std::path::Path::new(basic_path).exists() {
-                basic_path
-            } else {
-                None
-            };
+        if self.config.enable_process_monitoring && is_program_embedded("process_monitor") {
+            programs_to_load.push(("process", "process_monitor", PROCESS_MAP_NAMES));
+        }
 
-            if let Some(path) = program_path {
-                programs_to_load.push(("filesystem", path, "filesystem_metrics_map"));
-            }
+        if self.needs_memory_pressure_program() && is_program_embedded(MEMORY_PRESSURE_PROGRAM) {
+            programs_to_load.push(("memory_pressure", MEMORY_PRESSURE_PROGRAM, &[]));
         }
 
-        if self.config.enable_process_monitoring {
-            let path = "src/ebpf_programs/process_monitor.c";
-            if std::path::Path::new(path).exists() {
-                programs_to_load.push(("process", path, "process_map"));
-            }
+        if self.config.enable_kmem_allocation_tracking && is_program_embedded(KMEM_PROGRAM) {
+            programs_to_load.push(("kmem", KMEM_PROGRAM, &[]));
         }
 
         if programs_to_load.is_empty() {
@@ -2107,10 +3160,11 @@ impl EbpfMetricsCollector {
         );
 
         // Используем параллельную загрузку для оптимизации
-        let start_time = Instant::now();
-        let program_paths: Vec<&str> = programs_to_load.iter().map(|(_, path, _)| *path).collect();
+        let start_time = std::time::Instant::now();
+        let program_names: Vec<&'static str> =
+            programs_to_load.iter().map(|(_, name, _)| *name).collect();
 
-        match load_ebpf_programs_parallel(program_paths, self.config.operation_timeout_ms) {
+        match load_ebpf_programs_parallel(program_names, self.config.operation_timeout_ms) {
             Ok(programs) => {
                 let mut success_count = 0;
                 let mut error_count = 0;
@@ -2118,7 +3172,7 @@ impl EbpfMetricsCollector {
 
                 // Обработка результатов параллельной загрузки
                 for (index, program_result) in programs.into_iter().enumerate() {
-                    if let Some((program_type, program_path, map_name)) =
+                    if let Some((program_type, program_name, map_names)) =
                         programs_to_load.get(index)
                     {
                         match program_result {
@@ -2127,8 +3181,7 @@ impl EbpfMetricsCollector {
                                 match self.save_program_and_load_maps(
                                     program_type,
                                     program,
-                                    program_path,
-                                    map_name,
+                                    map_names,
                                 ) {
                                     Ok(_) => {
                                         success_count += 1;
@@ -2149,24 +3202,67 @@ impl EbpfMetricsCollector {
                                 }
                             }
                             None => {
-                                error_count += 1;
-                                tracing::error!("Не удалось загрузить программу {}", program_type);
-                                detailed_errors
-                                    .push(format!("{}: загрузка не удалась", program_type));
-                            }
-                        }
-                    }
-                }
-
-                let elapsed = start_time.elapsed();
-                self.initialized = success_count > 0;
-
-                if success_count > 0 {
-                    tracing::info!(
-                        "Оптимизированная инициализация завершена ({} программ загружено, {} ошибок) за {:?}",
-                        success_count, error_count, elapsed
-                    );
-
+                                // Основной объект не загрузился на этом ядре: загружаем его вариант
+                                let Some((fallback, description)) =
+                                    fallback_program_variant(program_name)
+                                else {
+                                    error_count += 1;
+                                    tracing::error!(
+                                        "Не удалось загрузить программу {}",
+                                        program_type
+                                    );
+                                    detailed_errors
+                                        .push(format!("{}: загрузка не удалась", program_type));
+                                    continue;
+                                };
+                                let result = self
+                                    .load_embedded_program_with_maps(&fallback, map_names)
+                                    .and_then(|(program, _)| {
+                                        self.save_program_and_load_maps(
+                                            program_type,
+                                            program,
+                                            map_names,
+                                        )
+                                    });
+                                match result {
+                                    Ok(_) => {
+                                        success_count += 1;
+                                        tracing::warn!(
+                                            "Программа {} загружена в варианте {} {}",
+                                            program_type,
+                                            fallback,
+                                            description
+                                        );
+                                    }
+                                    Err(e) => {
+                                        error_count += 1;
+                                        tracing::error!(
+                                            "Не удалось загрузить программу {} и её вариант {}: {}",
+                                            program_type,
+                                            fallback,
+                                            e
+                                        );
+                                        detailed_errors.push(format!("{}: {}", program_type, e));
+                                    }
+                                }
+                            }
+                        }
+                    }
+                }
+
+                let elapsed = start_time.elapsed();
+                self.initialized = success_count > 0;
+                self.refresh_kernel_filters();
+                self.start_run_time_stats();
+                self.start_epoch_aggregation();
+                self.apply_attachment_demand();
+
+                if success_count > 0 {
+                    tracing::info!(
+                        "Оптимизированная инициализация завершена ({} программ загружено, {} ошибок) за {:?}",
+                        success_count, error_count, elapsed
+                    );
+
                     if !detailed_errors.is_empty() {
                         tracing::debug!("Детали ошибок: {}", detailed_errors.join(", "));
                     }
@@ -2210,53 +3306,48 @@ impl EbpfMetricsCollector {
         &mut self,
         program_type: &str,
         program: Program,
-        program_path: &str,
-        map_name: &str,
+        map_names: &[&str],
     ) -> Result<()> {
-        use libbpf_rs::{Map, Program};
+        let maps = load_maps_from_program(&program, map_names)?;
 
         match program_type {
             "cpu" => {
                 self.cpu_program = Some(program);
-                self.cpu_maps = self.load_maps_from_program(program_path, map_name)?;
+                self.cpu_maps = maps;
             }
             "memory" => {
                 self.memory_program = Some(program);
-                self.memory_maps = self.load_maps_from_program(program_path, map_name)?;
+                self.memory_maps = maps;
             }
             "syscall" => {
-                self.syscall_program = Some(program);
-                self.syscall_maps = self.load_maps_from_program(program_path, map_name)?;
+                self.attach_syscall_maps(program, maps)?;
             }
             "network" => {
+                self.network_packet_counter = program.map_handle(TOTAL_PACKET_COUNT_MAP_NAME)?;
                 self.network_program = Some(program);
-                self.network_maps = self.load_maps_from_program(program_path, map_name)?;
+                self.network_maps = maps;
             }
             "connections" => {
                 self.network_connections_program = Some(program);
-                // Для соединений загружаем несколько карт
-                self.connection_maps =
-                    self.load_maps_from_program(program_path, "connection_map")?;
-                self.connection_maps
-                    .extend(self.load_maps_from_program(program_path, "connection_stats_map")?);
-                self.connection_maps
-                    .extend(self.load_maps_from_program(program_path, "active_connections_map")?);
+                self.connection_maps = maps;
             }
             "gpu" => {
+                self.gpu_process_usage_map = program.map_handle(GPU_PROCESS_USAGE_MAP)?;
                 self.gpu_program = Some(program);
-                self.gpu_maps = self.load_maps_from_program(program_path, map_name)?;
+                self.gpu_maps = maps;
             }
             "filesystem" => {
-                self.filesystem_program = Some(program);
-                self.filesystem_maps = self.load_maps_from_program(program_path, map_name)?;
+                self.attach_filesystem_maps(program, maps)?;
             }
             "process" => {
                 self.process_monitoring_program = Some(program);
-                self.process_maps = self.load_maps_from_program(program_path, "process_map")?;
-                self.process_maps
-                    .extend(self.load_maps_from_program(program_path, "syscall_stats_map")?);
-                self.process_maps
-                    .extend(self.load_maps_from_program(program_path, "cpu_stats_map")?);
+                self.process_maps = maps;
+            }
+            "memory_pressure" => {
+                self.attach_memory_pressure_maps(program)?;
+            }
+            "kmem" => {
+                self.attach_kmem_maps(program)?;
             }
             _ => {
                 tracing::warn!("Неизвестный тип программы: {}", program_type);
@@ -2283,21 +3374,290 @@ impl EbpfMetricsCollector {
         Ok(())
     }
 
-    /// Загрузить eBPF программу для сбора CPU метрик
+    /// Загрузить встроенную программу через кэш и получить её карты
     #[cfg(feature = "ebpf")]
-    fn load_cpu_program(&mut self) -> Result<()> {
-        use libbpf_rs::{Map, Program};
+    fn load_embedded_program_with_maps(
+        &mut self,
+        program_name: &str,
+        map_names: &[&str],
+    ) -> Result<(Program, Vec<Map>)> {
+        let program = self
+            .program_cache
+            .get_or_load(program_name, self.config.operation_timeout_ms)?;
+        let maps = load_maps_from_program(&program, map_names)?;
+        Ok((program, maps))
+    }
 
-        let program_path = "src/ebpf_programs/cpu_metrics.c";
+    /// Загрузить программу с состоянием процессов в task storage
+    ///
+    /// Если основной объект не прошёл загрузку (ядро до 5.11 без
+    /// `BPF_MAP_TYPE_TASK_STORAGE` или без нужных хелперов), загружается
+    /// legacy вариант с HASH картами по TGID (см. [`super::ebpf_task_state`]).
+    #[cfg(feature = "ebpf")]
+    fn load_task_state_program_with_maps(
+        &mut self,
+        program_name: &str,
+        map_names: &[&str],
+    ) -> Result<(Program, Vec<Map>)> {
+        let (program, maps) = match self.load_embedded_program_with_maps(program_name, map_names) {
+            Ok(loaded) => loaded,
+            Err(e) => {
+                let legacy = ebpf_task_state::legacy_program_name(program_name);
+                if !is_program_embedded(&legacy) {
+                    return Err(e);
+                }
 
-        // Загрузка eBPF программы
-        let program = load_ebpf_program_from_file(program_path)?;
+                tracing::warn!(
+                    "eBPF программа {} не загружена ({:#}), используется вариант {} с HASH картами по TGID",
+                    program_name,
+                    e,
+                    legacy
+                );
+                self.load_embedded_program_with_maps(&legacy, map_names)?
+            }
+        };
 
-        // Сохранение программы
-        self.cpu_program = Some(program);
+        tracing::debug!(
+            "Состояние процессов программы {}: {:?}",
+            program.name(),
+            TaskStateBackend::of_program(program.name())
+        );
+        Ok((program, maps))
+    }
+
+    /// Запустить поток событий жизненного цикла поверх кольцевого буфера
+    #[cfg(feature = "ebpf")]
+    fn start_lifecycle_stream(&mut self) -> Result<()> {
+        if !is_program_embedded("lifecycle_events") {
+            anyhow::bail!("eBPF программа lifecycle_events не встроена в бинарник");
+        }
+
+        let program = self
+            .program_cache
+            .get_or_load("lifecycle_events", self.config.operation_timeout_ms)?;
+
+        let stream = LifecycleEventStream::start(
+            program,
+            LifecycleStreamConfig {
+                wakeup_threshold_bytes: self.config.ringbuf_wakeup_threshold_bytes,
+                poll_timeout_ms: self.config.ringbuf_poll_timeout_ms,
+            },
+        )?;
+
+        self.lifecycle_stream = Some(stream);
+        Ok(())
+    }
+
+    /// Текущая сводка по событиям жизненного цикла (если поток событий запущен)
+    pub fn lifecycle_event_summary(&self) -> Option<LifecycleEventSummary> {
+        #[cfg(feature = "ebpf")]
+        {
+            self.lifecycle_stream.as_ref().map(|stream| stream.summary())
+        }
+
+        #[cfg(not(feature = "ebpf"))]
+        {
+            None
+        }
+    }
+
+    /// Последние сводки эпох от старых к новым (если агрегация по эпохам запущена)
+    ///
+    /// Каждый вызов дочитывает из кольца ядра только сводки, записанные с
+    /// предыдущего вызова.
+    pub fn epoch_summaries(&self) -> Option<Vec<EpochSummary>> {
+        #[cfg(feature = "ebpf")]
+        {
+            self.epoch_aggregator
+                .as_ref()
+                .map(|aggregator| aggregator.poll())
+        }
+
+        #[cfg(not(feature = "ebpf"))]
+        {
+            None
+        }
+    }
+
+    /// Запустить быстрый путь реакции на задержки в очереди выполнения
+    ///
+    /// Общая программа планировщика загружается при необходимости. События
+    /// превышения порога для отмеченных процессов передаются `handler` в
+    /// отдельном потоке; набор процессов задаётся через
+    /// [`EbpfMetricsCollector::sync_runqueue_latency_targets`].
+    pub fn start_runqueue_latency_fast_path(
+        &mut self,
+        settings: RunqueueLatencySettings,
+        handler: RunqueueLatencyHandler,
+    ) -> Result<()> {
+        #[cfg(feature = "ebpf")]
+        {
+            if self.sched_program.is_none() {
+                self.load_sched_program()?;
+            }
+            let program = self
+                .sched_program
+                .clone()
+                .context("Общая eBPF программа планировщика не загружена")?;
+
+            let stream = RunqueueLatencyStream::start(program, settings, handler)?;
+            self.runqueue_latency_stream = Some(stream);
+
+            // События публикует sched_switch: программа не открепляется, пока работает поток
+            self.subscribe_metric_groups(
+                RUNQUEUE_FAST_PATH_CONSUMER,
+                &[EbpfMetricGroup::RunqueueLatency],
+            );
+            Ok(())
+        }
+
+        #[cfg(not(feature = "ebpf"))]
+        {
+            let _ = (settings, handler);
+            anyhow::bail!("Быстрый путь задержек очереди выполнения требует поддержки eBPF")
+        }
+    }
+
+    /// Синхронизировать набор процессов, отмеченных для быстрого пути
+    ///
+    /// Возвращает количество отмеченных процессов (0, если быстрый путь не запущен).
+    pub fn sync_runqueue_latency_targets(
+        &mut self,
+        tgids: &std::collections::HashSet<u32>,
+    ) -> Result<usize> {
+        #[cfg(feature = "ebpf")]
+        {
+            match self.runqueue_latency_stream.as_mut() {
+                Some(stream) => stream.sync_targets(tgids),
+                None => Ok(0),
+            }
+        }
+
+        #[cfg(not(feature = "ebpf"))]
+        {
+            let _ = tgids;
+            Ok(0)
+        }
+    }
+
+    /// Количество событий быстрого пути с момента запуска (если он запущен)
+    pub fn runqueue_latency_events_total(&self) -> Option<u64> {
+        #[cfg(feature = "ebpf")]
+        {
+            self.runqueue_latency_stream
+                .as_ref()
+                .map(|stream| stream.events_total())
+        }
+
+        #[cfg(not(feature = "ebpf"))]
+        {
+            None
+        }
+    }
+
+    /// Подписать потребителя на группы eBPF метрик
+    ///
+    /// Подписка заменяет предыдущую подписку того же потребителя и действует
+    /// до [`Self::unsubscribe_metric_groups`]. Учитывается только при
+    /// `demand_driven_attachment`.
+    pub fn subscribe_metric_groups(&mut self, consumer: &str, groups: &[EbpfMetricGroup]) {
+        self.demand.subscribe(consumer, groups);
+        #[cfg(feature = "ebpf")]
+        self.apply_attachment_demand();
+    }
+
+    /// Снять подписку потребителя
+    ///
+    /// Программы групп открепляются через `attachment_idle_timeout_secs`,
+    /// если их не запросит другой потребитель.
+    pub fn unsubscribe_metric_groups(&mut self, consumer: &str) -> bool {
+        self.demand.unsubscribe(consumer)
+    }
+
+    /// Отметить группы метрик нужными сейчас
+    ///
+    /// Для потребителей, которые читают метрики эпизодически (обработчики API,
+    /// экспорт Prometheus): программы групп остаются прикреплёнными
+    /// `attachment_idle_timeout_secs` после последнего запроса.
+    pub fn request_metric_groups(&mut self, groups: &[EbpfMetricGroup]) {
+        self.demand.request(groups, std::time::Instant::now());
+        #[cfg(feature = "ebpf")]
+        self.apply_attachment_demand();
+    }
+
+    /// Включить прикрепление программ по запросу потребителей
+    ///
+    /// Программы групп без подписок открепляются сразу, не дожидаясь
+    /// следующего сбора.
+    pub fn enable_demand_driven_attachment(&mut self, idle_timeout: Duration) {
+        self.config.demand_driven_attachment = true;
+        self.config.attachment_idle_timeout_secs = idle_timeout.as_secs();
+        self.demand.set_idle_timeout(idle_timeout);
+        #[cfg(feature = "ebpf")]
+        self.apply_attachment_demand();
+    }
+
+    /// Группы метрик, программы которых сейчас должны быть прикреплены
+    ///
+    /// Без `demand_driven_attachment` прикреплены все загруженные программы, и
+    /// возвращаются все группы.
+    pub fn active_metric_groups(&mut self) -> Vec<EbpfMetricGroup> {
+        if !self.config.demand_driven_attachment {
+            return EbpfMetricGroup::ALL.to_vec();
+        }
+        self.demand
+            .active_groups(std::time::Instant::now())
+            .into_iter()
+            .collect()
+    }
+
+    /// Прикрепить программы запрошенных групп и открепить остальные
+    ///
+    /// Объекты не перезагружаются: меняются только ссылки (links) программ,
+    /// так что карты сохраняют накопленные данные.
+    #[cfg(feature = "ebpf")]
+    fn apply_attachment_demand(&mut self) {
+        if !self.config.demand_driven_attachment || !self.initialized {
+            return;
+        }
+
+        let needed = programs_for_groups(self.active_metric_groups());
+        let mut attached = 0;
+        let mut detached = 0;
+        for role in EbpfProgramRole::ALL {
+            let Some(program) = self.role_program(role) else {
+                continue;
+            };
+            match (needed.contains(&role), program.is_attached()) {
+                (true, false) => {
+                    program.attach();
+                    attached += 1;
+                }
+                (false, true) => {
+                    program.detach();
+                    detached += 1;
+                }
+                _ => {}
+            }
+        }
+
+        if attached > 0 || detached > 0 {
+            tracing::debug!(
+                "Прикрепление eBPF программ по запросу: {} прикреплено, {} откреплено",
+                attached,
+                detached
+            );
+        }
+    }
+
+    /// Загрузить eBPF программу для сбора CPU метрик
+    #[cfg(feature = "ebpf")]
+    fn load_cpu_program(&mut self) -> Result<()> {
+        let (program, maps) =
+            self.load_embedded_program_with_maps("cpu_metrics", &["cpu_metrics_map"])?;
 
-        // Загрузка карт из программы
-        self.cpu_maps = self.load_maps_from_program(&program_path, "cpu_metrics_map")?;
+        self.cpu_program = Some(program);
+        self.cpu_maps = maps;
 
         tracing::info!(
             "eBPF программа для CPU метрик успешно загружена с {} картами",
@@ -2309,19 +3669,12 @@ impl EbpfMetricsCollector {
     /// Загрузить eBPF программу для мониторинга температуры CPU
     #[cfg(feature = "ebpf")]
     fn load_cpu_temperature_program(&mut self) -> Result<()> {
-        use libbpf_rs::{Map, Program};
-
-        let program_path = "src/ebpf_programs/cpu_temperature.c";
+        let (program, maps) =
+            self.load_embedded_program_with_maps("cpu_temperature", &[THERMAL_ZONE_MAP])?;
 
-        // Загрузка eBPF программы
-        let program = load_ebpf_program_from_file(program_path)?;
-
-        // Сохранение программы
         self.cpu_temperature_program = Some(program);
-
-        // Загрузка карт из программы
-        self.cpu_temperature_maps =
-            self.load_maps_from_program(&program_path, "cpu_temperature_map")?;
+        self.cpu_temperature_maps = maps;
+        self.thermal_critical_trips = read_critical_trips(std::path::Path::new(THERMAL_SYSFS_ROOT));
 
         tracing::info!(
             "eBPF программа для мониторинга температуры CPU успешно загружена с {} картами",
@@ -2333,18 +3686,12 @@ impl EbpfMetricsCollector {
     /// Загрузить eBPF программу для сбора метрик памяти
     #[cfg(feature = "ebpf")]
     fn load_memory_program(&mut self) -> Result<()> {
-        use libbpf_rs::{Map, Program};
-
-        let program_path = "src/ebpf_programs/cpu_metrics.c"; // Используем ту же программу для тестирования
-
-        // Загрузка eBPF программы
-        let program = load_ebpf_program_from_file(program_path)?;
+        // Используем ту же программу, что и для CPU метрик (объект разделяется через кэш)
+        let (program, maps) =
+            self.load_embedded_program_with_maps("cpu_metrics", &["cpu_metrics_map"])?;
 
-        // Сохранение программы
         self.memory_program = Some(program);
-
-        // Загрузка карт из программы
-        self.memory_maps = self.load_maps_from_program(&program_path, "cpu_metrics_map")?;
+        self.memory_maps = maps;
 
         tracing::info!(
             "eBPF программа для метрик памяти успешно загружена с {} картами",
@@ -2353,43 +3700,111 @@ impl EbpfMetricsCollector {
         Ok(())
     }
 
-    /// Загрузить eBPF программу для мониторинга системных вызовов
+    /// Нужна ли общая программа системных вызовов
+    ///
+    /// Программа подключается к sys_enter/sys_exit один раз и обслуживает
+    /// коллекторы системных вызовов, процессов и производительности приложений.
+    #[cfg(feature = "ebpf")]
+    fn needs_syscall_program(&self) -> bool {
+        self.config.enable_syscall_monitoring
+            || self.config.enable_process_monitoring
+            || self.config.enable_application_performance_monitoring
+    }
+
+    /// Загрузить общую eBPF программу системных вызовов
+    ///
+    /// Если ядро не поддерживает BTF точки трассировки (`tp_btf`), загружается
+    /// вариант на `raw_tp` с теми же картами.
     #[cfg(feature = "ebpf")]
     fn load_syscall_program(&mut self) -> Result<()> {
-        use libbpf_rs::{Map, Program};
-        use std::path::Path;
+        if !is_program_embedded(SYSCALL_PROGRAM) {
+            tracing::warn!("Общая eBPF программа системных вызовов не встроена");
+            return Ok(());
+        }
 
-        // Пробуем загрузить расширенную версию программы
-        let advanced_program_path = Path::new("src/ebpf_programs/syscall_monitor_advanced.c");
-        let basic_program_path = Path::new("src/ebpf_programs/syscall_monitor.c");
+        let (program, maps) =
+            match self.load_embedded_program_with_maps(SYSCALL_PROGRAM, SYSCALL_MAP_NAMES) {
+                Ok(loaded) => loaded,
+                Err(e) if is_program_embedded(SYSCALL_RAW_TP_PROGRAM) => {
+                    tracing::warn!(
+                        "eBPF программа {} не загружена ({:#}), используется вариант {} на raw_tp",
+                        SYSCALL_PROGRAM,
+                        e,
+                        SYSCALL_RAW_TP_PROGRAM
+                    );
+                    self.load_embedded_program_with_maps(SYSCALL_RAW_TP_PROGRAM, SYSCALL_MAP_NAMES)?
+                }
+                Err(e) => return Err(e),
+            };
 
-        let program_path = if advanced_program_path.exists() {
-            advanced_program_path
-        } else if basic_program_path.exists() {
-            basic_program_path
-        } else {
-            tracing::warn!("eBPF программы для мониторинга системных вызовов не найдены");
-            return Ok(());
-        };
+        self.attach_syscall_maps(program, maps)?;
 
         tracing::info!(
-            "Загрузка eBPF программы для мониторинга системных вызовов: {:?}",
-            program_path
+            "Общая eBPF программа системных вызовов успешно загружена с {} картами",
+            self.syscall_maps.len()
         );
+        Ok(())
+    }
 
-        // Загрузка eBPF программы
-        let program = load_ebpf_program_from_file(program_path.to_str().unwrap())?;
-
-        // Сохранение программы
+    /// Сохранить общую программу системных вызовов, подключить её карты
+    /// гистограмм и счётчиков процессов и записать флаги номеров вызовов
+    #[cfg(feature = "ebpf")]
+    fn attach_syscall_maps(&mut self, program: Program, maps: Vec<Map>) -> Result<()> {
+        self.syscall_latency_map = program.map_handle(SYSCALL_LATENCY_HIST_MAP_NAME)?;
+        self.syscall_app_latency_map = program.map_handle(SYSCALL_APP_LATENCY_MAP_NAME)?;
+        self.syscall_process_map = program.map_handle(SYSCALL_PROCESS_MAP)?;
+        let filter = program.map_handle(SYSCALL_APP_FILTER_MAP_NAME)?;
         self.syscall_program = Some(program);
+        self.syscall_maps = maps;
 
-        // Загрузка карт из программы
-        self.syscall_maps =
-            self.load_maps_from_program(program_path.to_str().unwrap(), "syscall_count_map")?;
+        match filter {
+            Some(filter) => self.setup_syscall_tracking(&filter),
+            None => Ok(()),
+        }
+    }
 
-        tracing::info!(
-            "eBPF программа для мониторинга системных вызовов успешно загружена с {} картами",
-            self.syscall_maps.len()
+    /// Включить гистограммы по процессам для номеров из конфигурации и учёт
+    /// ожидания блокировок для futex
+    #[cfg(feature = "ebpf")]
+    fn setup_syscall_tracking(&self, filter: &Map) -> Result<()> {
+        use libbpf_rs::{MapCore, MapFlags};
+
+        let max_syscalls = filter.max_entries();
+        for &syscall_id in &self.config.syscall_latency_app_syscalls {
+            if syscall_id >= max_syscalls {
+                tracing::warn!(
+                    "Номер системного вызова {} вне диапазона гистограмм (0..{}), пропускается",
+                    syscall_id,
+                    max_syscalls
+                );
+            }
+        }
+
+        // Ожидание futex нужно коллектору производительности приложений
+        // независимо от списка гистограмм
+        let flags = tracking_flags(
+            &self.config.syscall_latency_app_syscalls,
+            super::ebpf_latency::syscall_id("futex"),
+            max_syscalls,
+        );
+        for &(syscall_id, syscall_flags) in &flags {
+            filter
+                .update(
+                    &syscall_id.to_ne_bytes(),
+                    &syscall_flags.to_ne_bytes(),
+                    MapFlags::ANY,
+                )
+                .with_context(|| {
+                    format!(
+                        "Не удалось записать флаги учёта для системного вызова {}",
+                        syscall_id
+                    )
+                })?;
+        }
+
+        tracing::debug!(
+            "Флаги учёта записаны для {} системных вызовов",
+            flags.len()
         );
         Ok(())
     }
@@ -2397,33 +3812,17 @@ impl EbpfMetricsCollector {
     /// Загрузить eBPF программу для мониторинга сетевой активности
     #[cfg(feature = "ebpf")]
     fn load_network_program(&mut self) -> Result<()> {
-        use libbpf_rs::{Map, Program};
-        use std::path::Path;
-
-        let program_path = Path::new("src/ebpf_programs/network_monitor.c");
-
-        if !program_path.exists() {
-            tracing::warn!(
-                "eBPF программа для мониторинга сетевой активности не найдена: {:?}",
-                program_path
-            );
+        if !is_program_embedded("network_monitor") {
+            tracing::warn!("eBPF программа для мониторинга сетевой активности не встроена");
             return Ok(());
         }
 
-        tracing::info!(
-            "Загрузка eBPF программы для мониторинга сетевой активности: {:?}",
-            program_path
-        );
+        let (program, maps) =
+            self.load_embedded_program_with_maps("network_monitor", &["network_stats_map"])?;
 
-        // Загрузка eBPF программы
-        let program = load_ebpf_program_from_file(program_path.to_str().unwrap())?;
-
-        // Сохранение программы
+        self.network_packet_counter = program.map_handle(TOTAL_PACKET_COUNT_MAP_NAME)?;
         self.network_program = Some(program);
-
-        // Загрузка карт из программы
-        self.network_maps =
-            self.load_maps_from_program(program_path.to_str().unwrap(), "network_stats_map")?;
+        self.network_maps = maps;
 
         tracing::info!(
             "eBPF программа для мониторинга сетевой активности успешно загружена с {} картами",
@@ -2435,70 +3834,17 @@ impl EbpfMetricsCollector {
     /// Загрузить eBPF программу для мониторинга производительности GPU
     #[cfg(feature = "ebpf")]
     fn load_gpu_program(&mut self) -> Result<()> {
-        use libbpf_rs::{Map, Program};
-        use std::path::Path;
-
-        // Пробуем загрузить комплексную версию программы (наиболее полная)
-        let comprehensive_program_path = Path::new("src/ebpf_programs/gpu_monitor_comprehensive.c");
-        let high_perf_program_path = Path::new("src/ebpf_programs/gpu_monitor_high_perf.c");
-        let memory_optimized_program_path =
-            Path::new("src/ebpf_programs/gpu_monitor_memory_optimized.c");
-        let optimized_program_path = Path::new("src/ebpf_programs/gpu_monitor_optimized.c");
-        let basic_program_path = Path::new("src/ebpf_programs/gpu_monitor.c");
-
-        let program_path = if comprehensive_program_path.exists() {
-            tracing::info!("Выбрана комплексная eBPF программа для мониторинга GPU");
-            comprehensive_program_path
-        } else if high_perf_program_path.exists() {
-            tracing::info!("Выбрана высокопроизводительная eBPF программа для мониторинга GPU");
-            high_perf_program_path
-        } else if memory_optimized_program_path.exists() {
-            tracing::info!("Выбрана оптимизированная по памяти eBPF программа для мониторинга GPU");
-            memory_optimized_program_path
-        } else if optimized_program_path.exists() {
-            tracing::info!("Выбрана оптимизированная eBPF программа для мониторинга GPU");
-            optimized_program_path
-        } else if basic_program_path.exists() {
-            tracing::info!("Выбрана базовая eBPF программа для мониторинга GPU");
-            basic_program_path
-        } else {
-            tracing::warn!("eBPF программы для мониторинга GPU не найдены");
-            return Ok(());
-        };
-
-        if !program_path.exists() {
-            tracing::warn!(
-                "eBPF программа для мониторинга GPU не найдена: {:?}",
-                program_path
-            );
+        if !is_program_embedded(GPU_PROGRAM) {
+            tracing::warn!("eBPF программа для мониторинга GPU не встроена");
             return Ok(());
         }
 
-        tracing::info!(
-            "Загрузка eBPF программы для мониторинга GPU: {:?}",
-            program_path
-        );
-
-        // Загрузка eBPF программы
-        let program = load_ebpf_program_from_file(program_path.to_str().unwrap())?;
+        let (program, maps) = self.load_embedded_program_with_maps(GPU_PROGRAM, GPU_MAP_NAMES)?;
 
-        // Сохранение программы
+        self.gpu_process_usage_map = program.map_handle(GPU_PROCESS_USAGE_MAP)?;
+        self.gpu_cgroup_map = program.map_handle(GPU_CGROUP_MAP)?;
         self.gpu_program = Some(program);
-
-        // Загрузка карт из программы
-        self.gpu_maps =
-            self.load_maps_from_program(program_path.to_str().unwrap(), "gpu_stats_map")?;
-
-        // Для комплексной программы загружаем дополнительные карты
-        if program_path == comprehensive_program_path {
-            let mut additional_maps =
-                self.load_maps_from_program(program_path.to_str().unwrap(), "total_gpu_usage_map")?;
-            self.gpu_maps.extend(additional_maps);
-
-            let mut device_maps =
-                self.load_maps_from_program(program_path.to_str().unwrap(), "gpu_device_info_map")?;
-            self.gpu_maps.extend(device_maps);
-        }
+        self.gpu_maps = maps;
 
         tracing::info!(
             "eBPF программа для мониторинга GPU успешно загружена с {} картами",
@@ -2510,39 +3856,18 @@ impl EbpfMetricsCollector {
     /// Загрузить eBPF программу для мониторинга сетевых соединений
     #[cfg(feature = "ebpf")]
     fn load_network_connections_program(&mut self) -> Result<()> {
-        use libbpf_rs::{Map, Program};
-        use std::path::Path;
-
-        let program_path = Path::new("src/ebpf_programs/network_connections.c");
-
-        if !program_path.exists() {
-            tracing::warn!(
-                "eBPF программа для мониторинга сетевых соединений не найдена: {:?}",
-                program_path
-            );
+        if !is_program_embedded("network_connections") {
+            tracing::warn!("eBPF программа для мониторинга сетевых соединений не встроена");
             return Ok(());
         }
 
-        tracing::info!(
-            "Загрузка eBPF программы для мониторинга сетевых соединений: {:?}",
-            program_path
-        );
-
-        // Загрузка eBPF программы
-        let program = load_ebpf_program_from_file(program_path.to_str().unwrap())?;
+        let (program, maps) = self.load_embedded_program_with_maps(
+            "network_connections",
+            CONNECTION_MAP_NAMES,
+        )?;
 
-        // Сохранение программы
         self.network_connections_program = Some(program);
-
-        // Загрузка карт из программы
-        self.connection_maps =
-            self.load_maps_from_program(program_path.to_str().unwrap(), "connection_map")?;
-        self.connection_maps.extend(
-            self.load_maps_from_program(program_path.to_str().unwrap(), "connection_stats_map")?,
-        );
-        self.connection_maps.extend(
-            self.load_maps_from_program(program_path.to_str().unwrap(), "active_connections_map")?,
-        );
+        self.connection_maps = maps;
 
         tracing::info!(
             "eBPF программа для мониторинга сетевых соединений успешно загружена с {} картами",
@@ -2554,114 +3879,61 @@ impl EbpfMetricsCollector {
     /// Загрузить eBPF программу для мониторинга процесс-специфичных метрик
     #[cfg(feature = "ebpf")]
     fn load_process_monitoring_program(&mut self) -> Result<()> {
-        use libbpf_rs::{Map, Program};
-        use std::path::Path;
-
-        let program_path = Path::new("src/ebpf_programs/process_monitor.c");
-
-        if !program_path.exists() {
+        if !is_program_embedded("process_monitor") {
             tracing::warn!(
-                "eBPF программа для мониторинга процесс-специфичных метрик не найдена: {:?}",
-                program_path
+                "eBPF программа для мониторинга процесс-специфичных метрик не встроена"
             );
             return Ok(());
         }
 
-        tracing::info!(
-            "Загрузка eBPF программы для мониторинга процесс-специфичных метрик: {:?}",
-            program_path
-        );
-
-        // Загрузка eBPF программы
-        let program = load_ebpf_program_from_file(program_path.to_str().unwrap())?;
+        let (program, maps) =
+            self.load_task_state_program_with_maps("process_monitor", PROCESS_MAP_NAMES)?;
 
-        // Сохранение программы
         self.process_monitoring_program = Some(program);
-
-        // Загрузка карт из программы
-        self.process_maps =
-            self.load_maps_from_program(program_path.to_str().unwrap(), "process_map")?;
-        self.process_maps.extend(
-            self.load_maps_from_program(program_path.to_str().unwrap(), "syscall_stats_map")?,
-        );
-        self.process_maps
-            .extend(self.load_maps_from_program(program_path.to_str().unwrap(), "cpu_stats_map")?);
+        self.process_maps = maps;
 
         tracing::info!("eBPF программа для мониторинга процесс-специфичных метрик успешно загружена с {} картами", self.process_maps.len());
         Ok(())
     }
 
-    /// Загрузить eBPF программу для мониторинга энергопотребления процессов
+    /// Найти счётчики RAPL для распределения энергии между процессами
+    ///
+    /// Отдельной eBPF программы нет: время на CPU берётся из общей программы
+    /// планировщика. Без зон RAPL энергопотребление процессов недоступно.
     #[cfg(feature = "ebpf")]
-    fn load_process_energy_program(&mut self) -> Result<()> {
-        use libbpf_rs::{Map, Program};
-        use std::path::Path;
-
-        let program_path = Path::new("src/ebpf_programs/process_energy.c");
-
-        if !program_path.exists() {
+    fn init_energy_attribution(&mut self) {
+        let rapl = RaplPackages::discover(std::path::Path::new(POWERCAP_ROOT));
+        if rapl.is_empty() {
             tracing::warn!(
-                "eBPF программа для мониторинга энергопотребления процессов не найдена: {:?}",
-                program_path
+                "Зоны RAPL пакетов CPU не найдены в {}: энергопотребление процессов недоступно",
+                POWERCAP_ROOT
+            );
+        } else {
+            tracing::info!(
+                "Энергия распределяется по времени на CPU для {} зон RAPL",
+                rapl.zones().len()
             );
-            return Ok(());
         }
-
-        tracing::info!(
-            "Загрузка eBPF программы для мониторинга энергопотребления процессов: {:?}",
-            program_path
-        );
-
-        // Загрузка eBPF программы
-        let program = load_ebpf_program_from_file(program_path.to_str().unwrap())?;
-
-        // Сохранение программы
-        self.process_energy_program = Some(program);
-
-        // Загрузка карт из программы
-        self.process_energy_maps =
-            self.load_maps_from_program(program_path.to_str().unwrap(), "process_energy_map")?;
-        self.process_energy_maps.extend(
-            self.load_maps_from_program(program_path.to_str().unwrap(), "global_energy_map")?,
-        );
-
-        tracing::info!("eBPF программа для мониторинга энергопотребления процессов успешно загружена с {} картами", self.process_energy_maps.len());
-        Ok(())
+        self.energy_attributor = std::sync::Mutex::new(EnergyAttributor::new(rapl));
     }
 
     /// Загрузить eBPF программу для мониторинга использования GPU процессами
     #[cfg(feature = "ebpf")]
     fn load_process_gpu_program(&mut self) -> Result<()> {
-        use libbpf_rs::{Map, Program};
-        use std::path::Path;
-
-        let program_path = Path::new("src/ebpf_programs/process_gpu.c");
-
-        if !program_path.exists() {
+        if !is_program_embedded("process_gpu") {
             tracing::warn!(
-                "eBPF программа для мониторинга использования GPU процессами не найдена: {:?}",
-                program_path
+                "eBPF программа для мониторинга использования GPU процессами не встроена"
             );
             return Ok(());
         }
 
-        tracing::info!(
-            "Загрузка eBPF программы для мониторинга использования GPU процессами: {:?}",
-            program_path
-        );
-
-        // Загрузка eBPF программы
-        let program = load_ebpf_program_from_file(program_path.to_str().unwrap())?;
+        let (program, maps) = self.load_task_state_program_with_maps(
+            "process_gpu",
+            &["process_gpu_map"],
+        )?;
 
-        // Сохранение программы
         self.process_gpu_program = Some(program);
-
-        // Загрузка карт из программы
-        self.process_gpu_maps =
-            self.load_maps_from_program(program_path.to_str().unwrap(), "process_gpu_map")?;
-        self.process_gpu_maps.extend(
-            self.load_maps_from_program(program_path.to_str().unwrap(), "global_gpu_usage_map")?,
-        );
+        self.process_gpu_maps = maps;
 
         tracing::info!("eBPF программа для мониторинга использования GPU процессами успешно загружена с {} картами", self.process_gpu_maps.len());
         Ok(())
@@ -2670,33 +3942,20 @@ impl EbpfMetricsCollector {
     /// Загрузить eBPF программу для мониторинга использования сети процессами
     #[cfg(feature = "ebpf")]
     fn load_process_network_program(&mut self) -> Result<()> {
-        use libbpf_rs::{Map, Program};
-        use std::path::Path;
-
-        let program_path = Path::new("src/ebpf_programs/process_network.c");
-
-        if !program_path.exists() {
+        if !is_program_embedded("process_network") {
             tracing::warn!(
-                "eBPF программа для мониторинга использования сети процессами не найдена: {:?}",
-                program_path
+                "eBPF программа для мониторинга использования сети процессами не встроена"
             );
             return Ok(());
         }
 
-        tracing::info!(
-            "Загрузка eBPF программы для мониторинга использования сети процессами: {:?}",
-            program_path
-        );
-
-        // Загрузка eBPF программы
-        let program = load_ebpf_program_from_file(program_path.to_str().unwrap())?;
+        let (program, maps) =
+            self.load_embedded_program_with_maps("process_network", &[PROCESS_TRAFFIC_MAP_NAME])?;
 
-        // Сохранение программы
+        self.socket_traffic_map = program.map_handle(SOCKET_TRAFFIC_MAP_NAME)?;
+        self.net_cgroup_map = program.map_handle(NET_CGROUP_MAP)?;
         self.process_network_program = Some(program);
-
-        // Загрузка карт из программы
-        self.process_network_maps = self
-            .load_maps_from_program(program_path.to_str().unwrap(), "process_network_stats_map")?;
+        self.process_network_maps = maps;
 
         tracing::info!("eBPF программа для мониторинга использования сети процессами успешно загружена с {} картами", self.process_network_maps.len());
         Ok(())
@@ -2705,33 +3964,21 @@ impl EbpfMetricsCollector {
     /// Загрузить eBPF программу для мониторинга использования диска процессами
     #[cfg(feature = "ebpf")]
     fn load_process_disk_program(&mut self) -> Result<()> {
-        use libbpf_rs::{Map, Program};
-        use std::path::Path;
-
-        let program_path = Path::new("src/ebpf_programs/process_disk.c");
-
-        if !program_path.exists() {
+        if !is_program_embedded("process_disk") {
             tracing::warn!(
-                "eBPF программа для мониторинга использования диска процессами не найдена: {:?}",
-                program_path
+                "eBPF программа для мониторинга использования диска процессами не встроена"
             );
             return Ok(());
         }
 
-        tracing::info!(
-            "Загрузка eBPF программы для мониторинга использования диска процессами: {:?}",
-            program_path
-        );
-
-        // Загрузка eBPF программы
-        let program = load_ebpf_program_from_file(program_path.to_str().unwrap())?;
+        let (program, maps) =
+            self.load_task_state_program_with_maps("process_disk", &["process_disk_stats_map"])?;
 
-        // Сохранение программы
+        self.disk_latency_map = program.map_handle(DISK_LATENCY_MAP)?;
+        self.disk_device_map = program.map_handle(DISK_DEVICE_MAP)?;
+        self.disk_cgroup_map = program.map_handle(DISK_CGROUP_MAP)?;
         self.process_disk_program = Some(program);
-
-        // Загрузка карт из программы
-        self.process_disk_maps =
-            self.load_maps_from_program(program_path.to_str().unwrap(), "process_disk_stats_map")?;
+        self.process_disk_maps = maps;
 
         tracing::info!("eBPF программа для мониторинга использования диска процессами успешно загружена с {} картами", self.process_disk_maps.len());
         Ok(())
@@ -2740,33 +3987,25 @@ impl EbpfMetricsCollector {
     /// Загрузить eBPF программу для мониторинга использования памяти процессами
     #[cfg(feature = "ebpf")]
     fn load_process_memory_program(&mut self) -> Result<()> {
-        use libbpf_rs::{Map, Program};
-        use std::path::Path;
-
-        let program_path = Path::new("src/ebpf_programs/process_memory.c");
-
-        if !program_path.exists() {
+        if !is_program_embedded("process_memory") {
             tracing::warn!(
-                "eBPF программа для мониторинга использования памяти процессами не найдена: {:?}",
-                program_path
+                "eBPF программа для мониторинга использования памяти процессами не встроена"
             );
             return Ok(());
         }
 
-        tracing::info!(
-            "Загрузка eBPF программы для мониторинга использования памяти процессами: {:?}",
-            program_path
-        );
+        let (program, maps) =
+            self.load_embedded_program_with_maps("process_memory", &[PROCESS_MEMORY_STATS_MAP])?;
 
-        // Загрузка eBPF программы
-        let program = load_ebpf_program_from_file(program_path.to_str().unwrap())?;
+        // Без конфигурации программа не обновляет записи
+        let page_size = unsafe { libc::sysconf(libc::_SC_PAGESIZE) }.max(1) as u64;
+        let config =
+            RawProcessMemoryConfig::new(self.config.process_memory_rss_delta_kb, page_size);
+        write_process_memory_config(&program, config)
+            .context("Не удалось записать конфигурацию eBPF программы памяти процессов")?;
 
-        // Сохранение программы
         self.process_memory_program = Some(program);
-
-        // Загрузка карт из программы
-        self.process_memory_maps =
-            self.load_maps_from_program(program_path.to_str().unwrap(), "process_memory_stats")?;
+        self.process_memory_maps = maps;
 
         tracing::info!("eBPF программа для мониторинга использования памяти процессами успешно загружена с {} картами", self.process_memory_maps.len());
         Ok(())
@@ -2775,51 +4014,133 @@ impl EbpfMetricsCollector {
     /// Загрузить eBPF программу для мониторинга файловой системы
     #[cfg(feature = "ebpf")]
     fn load_filesystem_program(&mut self) -> Result<()> {
-        use libbpf_rs::{Map, Program};
-        use std::path::Path;
-
-        // Пробуем загрузить высокопроизводительную версию программы
-        let high_perf_program_path = Path::new("src/ebpf_programs/filesystem_monitor_high_perf.c");
-        let optimized_program_path = Path::new("src/ebpf_programs/filesystem_monitor_optimized.c");
-        let basic_program_path = Path::new("src/ebpf_programs/filesystem_monitor.c");
-
-        let program_path = if high_perf_program_path.exists() {
-            high_perf_program_path
-        } else if optimized_program_path.exists() {
-            optimized_program_path
-        } else if basic_program_path.exists() {
-            basic_program_path
-        } else {
-            tracing::warn!("eBPF программы для мониторинга файловой системы не найдены");
-            return Ok(());
-        };
-
-        if !program_path.exists() {
-            tracing::warn!(
-                "eBPF программа для мониторинга файловой системы не найдена: {:?}",
-                program_path
-            );
+        if !is_program_embedded(FILESYSTEM_PROGRAM) {
+            tracing::warn!("eBPF программа для мониторинга файловой системы не встроена");
             return Ok(());
         }
 
+        let (program, maps) =
+            self.load_embedded_program_with_maps(FILESYSTEM_PROGRAM, FILESYSTEM_MAP_NAMES)?;
+        self.attach_filesystem_maps(program, maps)?;
+
         tracing::info!(
-            "Загрузка eBPF программы для мониторинга файловой системы: {:?}",
-            program_path
+            "eBPF программа для мониторинга файловой системы успешно загружена в режиме {:?}",
+            self.config.filesystem_mode
         );
+        Ok(())
+    }
 
-        // Загрузка eBPF программы
-        let program = load_ebpf_program_from_file(program_path.to_str().unwrap())?;
+    /// Сохранить программу файловой системы и записать в неё режим работы
+    #[cfg(feature = "ebpf")]
+    fn attach_filesystem_maps(&mut self, program: Program, maps: Vec<Map>) -> Result<()> {
+        write_filesystem_config(&program, self.config.filesystem_mode)
+            .context("Не удалось записать режим eBPF программы файловой системы")?;
 
-        // Сохранение программы
+        self.fs_process_io_map = program.map_handle(FS_PROCESS_IO_MAP)?;
+        self.fs_file_io_map = program.map_handle(FS_FILE_IO_MAP)?;
         self.filesystem_program = Some(program);
+        self.filesystem_maps = maps;
+        Ok(())
+    }
+
+    /// Переключить режим мониторинга файловой системы без перезагрузки программы.
+    ///
+    /// В режиме счётчиков программа перестаёт обновлять карты по процессам и
+    /// файлам, а их содержимое больше не попадает в метрики.
+    pub fn set_filesystem_mode(&mut self, mode: FilesystemMonitorMode) -> Result<()> {
+        self.config.filesystem_mode = mode;
+
+        #[cfg(feature = "ebpf")]
+        {
+            if let Some(program) = &self.filesystem_program {
+                write_filesystem_config(program, mode)
+                    .context("Не удалось переключить режим eBPF программы файловой системы")?;
+            }
+        }
+
+        tracing::info!("Режим мониторинга файловой системы: {:?}", mode);
+        Ok(())
+    }
+
+    /// Нужна ли программа учёта задержек памяти
+    ///
+    /// Кроме собственных метрик, задержки заполняют время ожидания памяти в
+    /// статистике производительности приложений.
+    #[cfg(feature = "ebpf")]
+    fn needs_memory_pressure_program(&self) -> bool {
+        self.config.enable_memory_pressure_monitoring
+            || self.config.enable_application_performance_monitoring
+    }
+
+    /// Загрузить eBPF программу учёта задержек из-за нехватки памяти
+    #[cfg(feature = "ebpf")]
+    fn load_memory_pressure_program(&mut self) -> Result<()> {
+        if !is_program_embedded(MEMORY_PRESSURE_PROGRAM) {
+            tracing::warn!("eBPF программа учёта задержек памяти не встроена");
+            return Ok(());
+        }
+
+        let (program, _) = self.load_embedded_program_with_maps(MEMORY_PRESSURE_PROGRAM, &[])?;
+        self.attach_memory_pressure_maps(program)?;
+
+        tracing::info!("eBPF программа учёта задержек памяти успешно загружена");
+        Ok(())
+    }
+
+    /// Сохранить программу задержек памяти и подключить её карты по процессам и cgroup
+    #[cfg(feature = "ebpf")]
+    fn attach_memory_pressure_maps(&mut self, program: Program) -> Result<()> {
+        self.memory_stall_process_map = program.map_handle(MEMORY_STALL_PROCESS_MAP)?;
+        self.memory_stall_cgroup_map = program.map_handle(MEMORY_STALL_CGROUP_MAP)?;
+        self.memory_pressure_program = Some(program);
+        Ok(())
+    }
+
+    /// Загрузить eBPF программу учёта kmalloc/kfree по процессам
+    #[cfg(feature = "ebpf")]
+    fn load_kmem_program(&mut self) -> Result<()> {
+        if !is_program_embedded(KMEM_PROGRAM) {
+            tracing::warn!("eBPF программа учёта выделений памяти ядра не встроена");
+            return Ok(());
+        }
+
+        let (program, _) = self.load_embedded_program_with_maps(KMEM_PROGRAM, &[])?;
+        self.attach_kmem_maps(program)?;
+
+        tracing::info!("eBPF программа учёта выделений памяти ядра успешно загружена");
+        Ok(())
+    }
+
+    /// Сохранить программу kmalloc/kfree и подключить её карту процессов
+    #[cfg(feature = "ebpf")]
+    fn attach_kmem_maps(&mut self, program: Program) -> Result<()> {
+        self.kmem_process_map = program.map_handle(KMEM_PROCESS_MAP)?;
+        self.kmem_program = Some(program);
+        Ok(())
+    }
+
+    /// Загрузить общую программу планировщика
+    ///
+    /// Программа подключается к sched_switch один раз и обслуживает коллекторы
+    /// производительности приложений, энергопотребления и памяти процессов.
+    #[cfg(feature = "ebpf")]
+    fn load_sched_program(&mut self) -> Result<()> {
+        if !is_program_embedded(SCHED_PROGRAM_NAME) {
+            tracing::warn!("Общая eBPF программа планировщика не встроена");
+            return Ok(());
+        }
+
+        let (program, maps) =
+            self.load_embedded_program_with_maps(SCHED_PROGRAM_NAME, &[SCHED_TASK_MAP_NAME])?;
 
-        // Загрузка карт из программы
-        self.filesystem_maps =
-            self.load_maps_from_program(program_path.to_str().unwrap(), "filesystem_metrics_map")?;
+        self.sched_oncpu_map = program.map_handle(SCHED_ONCPU_MAP_NAME)?;
+        self.sched_cgroup_map = program.map_handle(SCHED_CGROUP_MAP)?;
+        self.sched_program = Some(program);
+        self.sched_maps = maps;
 
         tracing::info!(
-            "eBPF программа для мониторинга файловой системы успешно загружена с {} картами",
-            self.filesystem_maps.len()
+            "Общая eBPF программа планировщика успешно загружена с {} картами",
+            self.sched_maps.len()
         );
         Ok(())
     }
@@ -2827,35 +4148,21 @@ impl EbpfMetricsCollector {
     /// Загрузить eBPF программу для мониторинга производительности приложений
     #[cfg(feature = "ebpf")]
     fn load_application_performance_program(&mut self) -> Result<()> {
-        use libbpf_rs::{Map, Program};
-        use std::path::Path;
-
-        let program_path = Path::new("src/ebpf_programs/application_performance.c");
-
-        if !program_path.exists() {
+        if !is_program_embedded("application_performance") {
             tracing::warn!(
-                "eBPF программа для мониторинга производительности приложений не найдена: {:?}",
-                program_path
+                "eBPF программа для мониторинга производительности приложений не встроена"
             );
             return Ok(());
         }
 
-        tracing::info!(
-            "Загрузка eBPF программы для мониторинга производительности приложений: {:?}",
-            program_path
-        );
-
-        // Загрузка eBPF программы
-        let program = load_ebpf_program_from_file(program_path.to_str().unwrap())?;
+        let (program, maps) = self.load_task_state_program_with_maps(
+            "application_performance",
+            &["application_performance_map"],
+        )?;
 
-        // Сохранение программы
+        self.app_cgroup_map = program.map_handle(APP_CGROUP_MAP)?;
         self.application_performance_program = Some(program);
-
-        // Загрузка карт из программы
-        self.application_performance_maps = self.load_maps_from_program(
-            program_path.to_str().unwrap(),
-            "application_performance_map",
-        )?;
+        self.application_performance_maps = maps;
 
         tracing::info!(
             "eBPF программа для мониторинга производительности приложений успешно загружена с {} картами",
@@ -2865,77 +4172,119 @@ impl EbpfMetricsCollector {
     }
 
     /// Собрать детализированную статистику по системным вызовам
+    ///
+    /// Счётчики и суммарное время берутся из per-CPU гистограмм задержек
+    /// общей программы системных вызовов.
     #[cfg(feature = "ebpf")]
     fn collect_syscall_details(&self) -> Option<Vec<SyscallStat>> {
-        use libbpf_rs::Map;
-
-        // Реальный сбор детализированной статистики
-        // из eBPF карт.
-
         if !self.config.enable_syscall_monitoring {
             return None;
         }
 
-        // Реальный сбор данных из eBPF карт
-        // Используя libbpf-rs API для доступа к картам
-
-        let mut details = Vec::new();
-
-        // Пробуем получить доступ к картам системных вызовов
-        if self.syscall_maps.is_empty() {
-            tracing::warn!(
-                "Карты системных вызовов не инициализированы для детализированной статистики"
+        let Some(map) = &self.syscall_latency_map else {
+            tracing::debug!(
+                "Гистограммы задержек системных вызовов недоступны для детализированной статистики"
             );
             return None;
-        }
+        };
 
-        // Реальный сбор данных из eBPF карт
-        // Используем libbpf-rs API для доступа к картам системных вызовов
+        let entries = match iterate_ebpf_map_entries::<u32, RawLatencyHistogram>(
+            map,
+            ebpf_batch::MIN_BATCH_ENTRIES,
+        ) {
+            Ok(entries) => entries,
+            Err(e) => {
+                tracing::error!("Ошибка при итерации по карте системных вызовов: {}", e);
+                return None;
+            }
+        };
 
-        // Пробуем получить доступ к картам системных вызовов
-        if self.syscall_maps.is_empty() {
-            tracing::warn!(
-                "Карты системных вызовов не инициализированы для детализированной статистики"
-            );
+        let details: Vec<SyscallStat> = entries
+            .into_iter()
+            .filter_map(|(syscall_id, per_cpu)| {
+                let hist = RawLatencyHistogram::merge_per_cpu(&per_cpu);
+                (!hist.is_empty()).then(|| SyscallStat {
+                    syscall_id,
+                    count: hist.count,
+                    total_time_ns: hist.total_time_ns,
+                    avg_time_ns: hist.mean_ns(),
+                })
+            })
+            .collect();
+
+        // Если не удалось получить данные из карт, возвращаем None
+        if details.is_empty() {
+            None
+        } else {
+            Some(details)
+        }
+    }
+
+    /// Собрать перцентили задержек системных вызовов из log2 гистограмм
+    ///
+    /// Возвращает сводки по всей системе (`tgid == None`) и по процессам для
+    /// системных вызовов из `syscall_latency_app_syscalls`. Среднее и
+    /// перцентили считаются по вызовам с предыдущего сбора.
+    #[cfg(feature = "ebpf")]
+    fn collect_syscall_latency_stats(&self) -> Option<Vec<SyscallLatencyStat>> {
+        if !self.config.enable_syscall_monitoring {
             return None;
         }
 
-        // Реальный сбор детализированной статистики из eBPF карт
-        // В реальной eBPF программе карта системных вызовов хранит данные по каждому системному вызову
-        // Используем итерацию по ключам для получения статистики по всем системным вызовам
+        let map = self.syscall_latency_map.as_ref()?;
+        let mut totals: std::collections::HashMap<SyscallLatencyKey, RawLatencyHistogram> =
+            std::collections::HashMap::new();
 
-        let mut details = Vec::new();
+        match iterate_ebpf_map_entries::<u32, RawLatencyHistogram>(
+            map,
+            ebpf_batch::MIN_BATCH_ENTRIES,
+        ) {
+            Ok(entries) => totals.extend(entries.iter().map(|(syscall_id, per_cpu)| {
+                (
+                    (None, *syscall_id),
+                    RawLatencyHistogram::merge_per_cpu(per_cpu),
+                )
+            })),
+            Err(e) => {
+                tracing::error!("Ошибка при чтении гистограмм задержек системных вызовов: {}", e);
+            }
+        }
 
-        for map in &self.syscall_maps {
-            // Используем новую функцию итерации по ключам
-            match iterate_ebpf_map_keys::<SyscallStat>(map, 40) {
-                Ok(syscall_stats) => {
-                    // Фильтруем только системные вызовы с ненулевым счетчиком
-                    for stat in syscall_stats {
-                        if stat.count > 0 {
-                            details.push(stat);
-                        }
-                    }
-                }
+        if let Some(app_map) = &self.syscall_app_latency_map {
+            match iterate_ebpf_map_entries::<RawSyscallAppKey, RawLatencyHistogram>(
+                app_map,
+                ebpf_batch::MIN_BATCH_ENTRIES,
+            ) {
+                Ok(entries) => totals.extend(entries.iter().map(|(key, per_cpu)| {
+                    (
+                        (Some(key.tgid), key.syscall_id),
+                        RawLatencyHistogram::merge_per_cpu(per_cpu),
+                    )
+                })),
                 Err(e) => {
-                    tracing::error!("Ошибка при итерации по карте системных вызовов: {}", e);
-                    continue;
+                    tracing::error!(
+                        "Ошибка при чтении гистограмм задержек системных вызовов по процессам: {}",
+                        e
+                    );
                 }
             }
         }
 
-        // Если не удалось получить данные из карт, возвращаем None
-        if details.is_empty() {
+        let stats = self
+            .syscall_latency_window
+            .lock()
+            .map(|mut window| syscall_latency_stats(&mut window, &totals))
+            .unwrap_or_default();
+        if stats.is_empty() {
             None
         } else {
-            Some(details)
+            Some(stats)
         }
     }
 
     /// Собрать детализированную статистику по сетевой активности
     #[cfg(feature = "ebpf")]
     fn collect_network_details(&self) -> Option<Vec<NetworkStat>> {
-        use libbpf_rs::Map;
 
         // Реальный сбор детализированной статистики
         // из eBPF карт.
@@ -2999,99 +4348,69 @@ impl EbpfMetricsCollector {
         }
     }
 
-    /// Собрать детализированную статистику по операциям с файловой системой
+    /// Собрать самые нагруженные пары (файл, процесс) в детальном режиме
+    ///
+    /// В список попадает не больше `max_cached_details` пар с наибольшим объёмом.
     #[cfg(feature = "ebpf")]
     fn collect_filesystem_details(&self) -> Option<Vec<FilesystemStat>> {
-        use libbpf_rs::Map;
-
-        // Реальный сбор детализированной статистики
-        // из eBPF карт.
-
-        if !self.config.enable_filesystem_monitoring {
+        if !self.config.enable_filesystem_monitoring
+            || self.config.filesystem_mode != FilesystemMonitorMode::Detailed
+        {
             return None;
         }
 
-        // Реальный сбор данных из eBPF карт
-        // Используя libbpf-rs API для доступа к картам
+        let map = self.fs_file_io_map.as_ref()?;
+        let entries = match iterate_ebpf_map_entries::<RawFsFileKey, RawFsFileStats>(
+            map,
+            ebpf_batch::MIN_BATCH_ENTRIES,
+        ) {
+            Ok(entries) => entries,
+            Err(e) => {
+                tracing::error!("Ошибка при чтении файловых операций по файлам: {}", e);
+                return None;
+            }
+        };
 
-        let mut details = Vec::new();
+        let stats = top_files(&entries, self.max_cached_details);
+        if stats.is_empty() {
+            None
+        } else {
+            Some(stats)
+        }
+    }
 
-        // Пробуем получить доступ к картам файловой системы
-        if self.filesystem_maps.is_empty() {
-            tracing::warn!(
-                "Карты файловой системы не инициализированы для детализированной статистики. 
-                 Проверьте, что модуль eBPF загружен и конфигурация enable_filesystem_monitoring включена."
-            );
+    /// Собрать итоги файловых операций по процессам в детальном режиме
+    #[cfg(feature = "ebpf")]
+    fn collect_filesystem_process_stats(&self) -> Option<Vec<ProcessFilesystemStat>> {
+        if !self.config.enable_filesystem_monitoring
+            || self.config.filesystem_mode != FilesystemMonitorMode::Detailed
+        {
             return None;
         }
 
-        // Реальный сбор данных из eBPF карт
-        // Используем libbpf-rs API для доступа к картам файловой системы
-
-        // Реальный сбор детализированной статистики из eBPF карт
-        // В реальной eBPF программе карта файловой системы хранит данные по каждому файлу
-        // Используем итерацию по ключам для получения статистики по всем файлам
-
-        let mut details = Vec::new();
-        let mut error_count = 0;
-        let mut successful_maps = 0;
-
-        for map in &self.filesystem_maps {
-            // Используем новую функцию итерации по ключам
-            match iterate_ebpf_map_keys::<FilesystemStat>(map, 48) {
-                Ok(filesystem_stats) => {
-                    successful_maps += 1;
-                    // Фильтруем только файлы с ненулевой активностью
-                    for stat in filesystem_stats {
-                        if stat.read_count > 0
-                            || stat.write_count > 0
-                            || stat.open_count > 0
-                            || stat.close_count > 0
-                        {
-                            details.push(stat);
-                        }
-                    }
-                }
-                Err(e) => {
-                    error_count += 1;
-                    tracing::error!(
-                        "Ошибка при итерации по карте файловой системы для детализированной статистики: {}. 
-                         Рекомендации: 1) Проверьте права доступа к eBPF картам, 2) Убедитесь, что ядро поддерживает eBPF, 3) Перезагрузите модуль eBPF",
-                        e
-                    );
-                    continue;
-                }
+        let map = self.fs_process_io_map.as_ref()?;
+        let entries = match iterate_ebpf_map_entries::<u32, RawFsIoCounters>(
+            map,
+            ebpf_batch::MIN_BATCH_ENTRIES,
+        ) {
+            Ok(entries) => entries,
+            Err(e) => {
+                tracing::error!("Ошибка при чтении файловых операций по процессам: {}", e);
+                return None;
             }
-        }
-
-        // Логируем результаты сбора данных
-        if error_count > 0 {
-            tracing::warn!(
-                "Обнаружено {} ошибок при сборе детализированной статистики файловой системы из {} карт. 
-                 Успешно обработано {} карт",
-                error_count,
-                self.filesystem_maps.len(),
-                successful_maps
-            );
-        }
+        };
 
-        // Возвращаем None только если не удалось собрать данные из всех карт
-        if successful_maps == 0 {
-            tracing::error!(
-                "Не удалось собрать детализированную статистику файловой системы ни из одной карты"
-            );
-            return None;
+        let stats = top_processes(&entries, self.max_cached_details);
+        if stats.is_empty() {
+            None
+        } else {
+            Some(stats)
         }
-
-        // Если удалось собрать данные хотя бы из одной карты, возвращаем результат
-        // Даже если details пустой, это может быть нормально (нет активных файлов)
-        Some(details)
     }
 
     /// Собрать детализированную статистику по сетевым соединениям
     #[cfg(feature = "ebpf")]
     fn collect_connection_details(&self) -> Option<Vec<ConnectionStat>> {
-        use libbpf_rs::Map;
 
         // Реальный сбор детализированной статистики
         // из eBPF карт.
@@ -3121,16 +4440,9 @@ impl EbpfMetricsCollector {
         let mut details = Vec::new();
 
         for map in &self.connection_maps {
-            // Используем новую функцию итерации по ключам
-            match iterate_ebpf_map_keys::<ConnectionStat>(map, 48) {
-                Ok(connection_stats) => {
-                    // Фильтруем только активные соединения
-                    for stat in connection_stats {
-                        if stat.packets > 0 || stat.bytes > 0 {
-                            details.push(stat);
-                        }
-                    }
-                }
+            // Карта содержит только живые соединения: закрытые удаляются на TCP_CLOSE
+            match iterate_ebpf_map_keys::<RawConnectionRecord>(map, ebpf_batch::MIN_BATCH_ENTRIES) {
+                Ok(records) => details.extend(records.iter().map(ConnectionStat::from_record)),
                 Err(e) => {
                     tracing::error!("Ошибка при итерации по карте соединений: {}", e);
                     continue;
@@ -3149,7 +4461,6 @@ impl EbpfMetricsCollector {
     /// Собрать детализированную статистику по процесс-специфичным метрикам
     #[cfg(feature = "ebpf")]
     fn collect_process_details(&self) -> Option<Vec<ProcessStat>> {
-        use libbpf_rs::Map;
 
         // Реальный сбор детализированной статистики
         // из eBPF карт.
@@ -3178,24 +4489,41 @@ impl EbpfMetricsCollector {
 
         let mut details = Vec::new();
 
-        for map in &self.process_maps {
-            // Используем новую функцию итерации по ключам
-            match iterate_ebpf_map_keys::<ProcessStat>(map, 64) {
-                Ok(process_stats) => {
-                    // Фильтруем только активные процессы
-                    for stat in process_stats {
-                        if stat.syscall_count > 0 || stat.cpu_time > 0 {
-                            details.push(stat);
-                        }
+        // Системные вызовы процессов считает общая программа системных вызовов
+        let mut syscall_stats = self.collect_syscall_process_table();
+
+        match read_task_state::<RawProcessInfo>(
+            self.process_monitoring_program.as_ref(),
+            PROCESS_INFO_ITER,
+            &self.process_maps,
+            64,
+        ) {
+            Ok(process_stats) => {
+                // Фильтруем только активные процессы
+                for raw in process_stats {
+                    let mut stat = ProcessStat::from_raw(&raw);
+                    if let Some(syscalls) = syscall_stats.remove(&raw.tgid) {
+                        stat.apply_syscalls(&syscalls);
+                    }
+                    if stat.syscall_count > 0 || stat.cpu_time > 0 {
+                        details.push(stat);
                     }
                 }
-                Err(e) => {
-                    tracing::error!("Ошибка при итерации по карте процессов: {}", e);
-                    continue;
-                }
+            }
+            Err(e) => {
+                tracing::error!("Ошибка при чтении записей процессов: {}", e);
             }
         }
 
+        // Процессы, запущенные до загрузки программы, известны только по системным вызовам
+        let mut syscall_only: Vec<ProcessStat> = syscall_stats
+            .iter()
+            .filter(|(_, syscalls)| syscalls.syscalls > 0)
+            .map(|(&tgid, syscalls)| ProcessStat::from_syscalls(tgid, syscalls))
+            .collect();
+        syscall_only.sort_unstable_by_key(|stat| stat.tgid);
+        details.append(&mut syscall_only);
+
         // Если не удалось получить данные из карт, возвращаем None
         if details.is_empty() {
             None
@@ -3204,61 +4532,64 @@ impl EbpfMetricsCollector {
         }
     }
 
-    /// Собрать детализированную статистику по производительности GPU
+    /// Прочитать записи колец GPU
     #[cfg(feature = "ebpf")]
-    fn collect_gpu_details(&self) -> Option<Vec<GpuStat>> {
-        use libbpf_rs::Map;
-
-        // Реальный сбор детализированной статистики
-        // из eBPF карт.
+    fn collect_gpu_rings(&self) -> Vec<RawGpuRingStats> {
+        let Some(map) = self.gpu_maps.first() else {
+            return Vec::new();
+        };
 
-        if !self.config.enable_gpu_monitoring {
-            return None;
-        }
+        iterate_ebpf_map_keys::<RawGpuRingStats>(map, 32).unwrap_or_else(|e| {
+            tracing::error!("Ошибка при чтении записей колец GPU: {}", e);
+            Vec::new()
+        })
+    }
 
-        // Реальный сбор данных из eBPF карт
-        // Используя libbpf-rs API для доступа к картам
+    /// Собрать загрузку устройств GPU за интервал с прошлого замера
+    #[cfg(feature = "ebpf")]
+    fn collect_gpu_device_usage(&self) -> Vec<GpuDeviceUsage> {
+        let rings = self.collect_gpu_rings();
+        if rings.is_empty() {
+            return Vec::new();
+        }
+
+        let ring_rates = self
+            .gpu_ring_sampler
+            .lock()
+            .map(|mut sampler| {
+                sampler.sample(
+                    std::time::Instant::now(),
+                    rings.iter().map(|ring| (ring.ring, ring.busy_ns)),
+                )
+            })
+            .unwrap_or_default();
 
-        let mut details = Vec::new();
+        device_usage(&GpuTopology::from_rings(&rings), &rings, &ring_rates)
+    }
 
-        // Пробуем получить доступ к GPU картам
-        if self.gpu_maps.is_empty() {
-            tracing::warn!("GPU карты не инициализированы для детализированной статистики");
+    /// Собрать детализированную статистику по производительности GPU
+    #[cfg(feature = "ebpf")]
+    fn collect_gpu_details(&self) -> Option<Vec<GpuStat>> {
+        if !self.config.enable_gpu_monitoring {
             return None;
         }
 
-        // Реальный сбор данных из eBPF карт
-        // Используем libbpf-rs API для доступа к GPU картам
-
-        // Реальный сбор детализированной статистики из eBPF карт
-        // В реальной eBPF программе GPU карта хранит данные по каждому GPU устройству
-        // Используем итерацию по ключам для получения статистики по всем GPU устройствам
-
-        let mut details = Vec::new();
-
-        for map in &self.gpu_maps {
-            // Используем новую функцию итерации по ключам
-            match iterate_ebpf_map_keys::<GpuStat>(map, 32) {
-                Ok(gpu_stats) => {
-                    // Фильтруем только GPU устройства с ненулевым использованием
-                    for mut stat in gpu_stats {
-                        if stat.gpu_usage > 0.0 || stat.memory_usage > 0 {
-                            // Обновляем температуру и другие поля из текущих метрик
-                            stat.temperature_celsius =
-                                self.collect_gpu_temperature_from_maps().unwrap_or(0);
-                            stat.max_temperature_celsius = stat.temperature_celsius; // Упрощенно
-                            details.push(stat);
-                        }
-                    }
-                }
-                Err(e) => {
-                    tracing::error!("Ошибка при итерации по GPU карте: {}", e);
-                    continue;
-                }
-            }
-        }
+        // Устройство появляется в карте с первым заданием на одном из его колец.
+        // Память, энергопотребление и температура GPU читаются из sysfs (см. metrics::gpu)
+        let details: Vec<GpuStat> = self
+            .collect_gpu_device_usage()
+            .into_iter()
+            .map(|device| GpuStat {
+                gpu_id: device.gpu_id,
+                gpu_usage: device.usage_percent,
+                memory_usage: 0,
+                compute_units_active: device.active_rings,
+                power_usage_uw: 0,
+                temperature_celsius: 0,
+                max_temperature_celsius: 0,
+            })
+            .collect();
 
-        // Если не удалось получить данные из карт, возвращаем None
         if details.is_empty() {
             None
         } else {
@@ -3269,12 +4600,9 @@ impl EbpfMetricsCollector {
     /// Собрать метрики из eBPF программ с оптимизацией производительности
     #[cfg(feature = "ebpf")]
     fn collect_real_ebpf_metrics(&self) -> Result<EbpfMetrics> {
-        // Оптимизация: используем параллельный сбор метрик для уменьшения времени сбора
-        // Только собираем метрики для включенных функций
-
+        // Оптимизация: собираем метрики только для включенных функций
         let start_time = std::time::Instant::now();
 
-        // Оптимизация: собираем метрики только для включенных функций
         let cpu_usage = if self.config.enable_cpu_metrics {
             self.collect_cpu_metrics_from_maps()?
         } else {
@@ -3296,11 +4624,21 @@ impl EbpfMetricsCollector {
         // Оптимизация: собираем сетевые метрики в одном проходе
         let (network_packets, network_bytes) = self.collect_network_metrics_parallel()?;
 
-        // Оптимизация: собираем метрики сетевых соединений
-        let active_connections = if self.config.enable_network_connections {
-            self.collect_active_connections()?
-        } else {
-            0
+        let syscall_latency_details = self.collect_syscall_latency_stats();
+        let socket_traffic_details = self.collect_socket_traffic_stats();
+        let (disk_latency_details, disk_queue_details) = self.collect_disk_io_stats();
+        let filesystem_process_details = self.collect_filesystem_process_stats();
+        let (memory_stall_details, cgroup_memory_stall_details) = self.collect_memory_stall_stats();
+
+        // При включённом потоке событий счётчики соединений и процессов поддерживаются
+        // инкрементально, и полный обход соответствующих карт не нужен
+        let lifecycle_events = self.lifecycle_event_summary();
+        let epoch_summaries = self.epoch_summaries();
+
+        let active_connections = match &lifecycle_events {
+            Some(summary) => summary.active_tcp_connections,
+            None if self.config.enable_network_connections => self.collect_active_connections()?,
+            None => 0,
         };
 
         // Оптимизация: собираем GPU метрики в одном проходе
@@ -3308,8 +4646,7 @@ impl EbpfMetricsCollector {
             self.collect_gpu_metrics_parallel()?;
 
         // Собираем температуру CPU
-        let (cpu_temperature, cpu_max_temperature, cpu_temperature_details) =
-            self.collect_cpu_temperature_data()?;
+        let (cpu_temperature, cpu_max_temperature, _) = self.collect_cpu_temperature_data()?;
 
         let filesystem_ops = if self.config.enable_filesystem_monitoring {
             self.collect_filesystem_ops_from_maps()?
@@ -3317,61 +4654,12 @@ impl EbpfMetricsCollector {
             0
         };
 
-        // Оптимизация: собираем метрики активных процессов
-        let active_processes = if self.config.enable_process_monitoring {
-            self.collect_active_processes()?
-        } else {
-            0
-        };
-
-        // Собираем метрики энергопотребления процессов
-        let process_energy_details = if self.config.enable_process_energy_monitoring {
-            self.collect_process_energy_stats()?
-        } else {
-            None
-        };
-
-        let cpu_usage = cpu_usage?;
-        let memory_usage = memory_usage?;
-        let syscall_count = syscall_count?;
-        let (network_packets, network_bytes) = network_metrics?;
-        let active_connections = active_connections?;
-        let (gpu_usage, gpu_memory_usage) = gpu_metrics?;
-        let filesystem_ops = fs_metrics?;
-        let active_processes = active_processes?;
-
-        // Собираем метрики использования GPU процессами
-        let process_gpu_details = if self.config.enable_process_gpu_monitoring {
-            self.collect_process_gpu_stats()?
-        } else {
-            None
-        };
-
-        let process_network_details = if self.config.enable_process_network_monitoring {
-            self.collect_process_network_stats()?
-        } else {
-            None
-        };
-
-        let process_disk_details = if self.config.enable_process_disk_monitoring {
-            self.collect_process_disk_stats()?
-        } else {
-            None
-        };
-
-        let process_memory_details = if self.config.enable_process_memory_monitoring {
-            self.collect_process_memory_stats()?
-        } else {
-            None
+        let active_processes = match &lifecycle_events {
+            Some(summary) => summary.active_processes,
+            None if self.config.enable_process_monitoring => self.collect_active_processes()?,
+            None => 0,
         };
 
-        let application_performance_details =
-            if self.config.enable_application_performance_monitoring {
-                self.collect_application_performance_stats()?
-            } else {
-                None
-            };
-
         // Оптимизация: собираем детализированную статистику параллельно
         let (
             syscall_details,
@@ -3384,6 +4672,7 @@ impl EbpfMetricsCollector {
             process_energy_details,
             process_gpu_details,
             process_network_details,
+            process_disk_details,
             process_memory_details,
             application_performance_details,
         ) = self.collect_detailed_stats_parallel();
@@ -3400,22 +4689,28 @@ impl EbpfMetricsCollector {
             process_energy_details,
             process_gpu_details,
             process_network_details,
+            process_disk_details,
             process_memory_details,
+            application_performance_details,
         ) = self.optimize_detailed_stats(
             syscall_details,
             network_details,
             connection_details,
-            _gpu_details,
-            _cpu_temperature_details,
-            _process_details,
-            _filesystem_details,
-            _process_energy_details,
-            _process_gpu_details,
-            _process_network_details,
-            _process_disk_details,
-            _process_memory_details,
+            gpu_details,
+            cpu_temperature_details,
+            process_details,
+            filesystem_details,
+            process_energy_details,
+            process_gpu_details,
+            process_network_details,
+            process_disk_details,
+            process_memory_details,
+            application_performance_details,
         );
 
+        // После распределения энергии процессов: cgroup используют ту же дельту RAPL
+        let cgroup_resource_details = self.collect_cgroup_resource_stats();
+
         let collection_time = start_time.elapsed();
         tracing::debug!(
             "Сбор eBPF метрик завершен за {:?} (CPU: {:.1}%, Mem: {}MB, Syscalls: {}, Connections: {}, Processes: {})",
@@ -3456,14 +4751,27 @@ impl EbpfMetricsCollector {
             filesystem_details,
             process_energy_details,
             process_gpu_details,
+            process_network_details,
             process_disk_details,
             process_memory_details,
             application_performance_details,
+            lifecycle_events,
+            syscall_latency_details,
+            program_overhead: self.overhead_report.clone(),
+            socket_traffic_details,
+            disk_latency_details,
+            disk_queue_details,
+            filesystem_process_details,
+            memory_stall_details,
+            cgroup_memory_stall_details,
+            cgroup_resource_details,
+            epoch_summaries,
         })
     }
 
     /// Собрать детализированную статистику параллельно (оптимизация производительности)
     #[cfg(feature = "ebpf")]
+    #[allow(clippy::type_complexity)]
     fn collect_detailed_stats_parallel(
         &self,
     ) -> (
@@ -3477,125 +4785,113 @@ impl EbpfMetricsCollector {
         Option<Vec<ProcessEnergyStat>>,
         Option<Vec<ProcessGpuStat>>,
         Option<Vec<ProcessNetworkStat>>,
+        Option<Vec<ProcessDiskStat>>,
         Option<Vec<ProcessMemoryStat>>,
+        Option<Vec<ApplicationPerformanceStat>>,
     ) {
-        use rayon::prelude::*;
-
-        // Используем параллельное выполнение для сбора детализированной статистики
-        let results: Vec<_> = vec![
-            std::thread::spawn(|| {
-                if self.config.enable_syscall_monitoring {
-                    self.collect_syscall_details()
-                } else {
-                    None
-                }
-            }),
-            std::thread::spawn(|| {
-                if self.config.enable_network_monitoring {
-                    self.collect_network_details()
-                } else {
-                    None
-                }
-            }),
-            std::thread::spawn(|| {
-                if self.config.enable_network_connections {
-                    self.collect_connection_details()
-                } else {
-                    None
-                }
-            }),
-            std::thread::spawn(|| {
-                if self.config.enable_gpu_monitoring {
-                    self.collect_gpu_details()
-                } else {
-                    None
-                }
-            }),
-            std::thread::spawn(|| {
-                if self.config.enable_cpu_temperature_monitoring {
-                    self.collect_cpu_temperature_from_maps()
-                } else {
-                    None
-                }
-            }),
-            std::thread::spawn(|| {
-                if self.config.enable_process_monitoring {
-                    self.collect_process_details()
-                } else {
-                    None
-                }
-            }),
-            std::thread::spawn(|| {
-                if self.config.enable_filesystem_monitoring {
-                    self.collect_filesystem_details()
-                } else {
-                    None
-                }
-            }),
-            std::thread::spawn(|| {
-                if self.config.enable_process_energy_monitoring {
-                    self.collect_process_energy_stats()
-                } else {
-                    None
-                }
-            }),
-            std::thread::spawn(|| {
-                if self.config.enable_process_gpu_monitoring {
-                    self.collect_process_gpu_stats()
-                } else {
-                    None
-                }
-            }),
-            std::thread::spawn(|| {
-                if self.config.enable_process_network_monitoring {
-                    self.collect_process_network_stats()
-                } else {
-                    None
-                }
-            }),
-            std::thread::spawn(|| {
-                if self.config.enable_process_memory_monitoring {
-                    self.collect_process_memory_stats()
-                } else {
-                    None
-                }
-            }),
-            std::thread::spawn(|| {
-                if self.config.enable_application_performance_monitoring {
-                    self.collect_application_performance_stats()
-                } else {
-                    None
-                }
-            }),
-        ];
-
-        let syscall_details = results[0].join().unwrap();
-        let network_details = results[1].join().unwrap();
-        let connection_details = results[2].join().unwrap();
-        let gpu_details = results[3].join().unwrap();
-        let cpu_temperature_details = results[4].join().unwrap();
-        let process_details = results[5].join().unwrap();
-        let filesystem_details = results[6].join().unwrap();
-        let process_energy_details = results[7].join().unwrap();
-        let process_gpu_details = results[8].join().unwrap();
-        let process_network_details = results[9].join().unwrap();
-        let process_memory_details = results[10].join().unwrap();
-        let application_performance_details = results[11].join().unwrap();
+        let config = &self.config;
+
+        // Пока агрегатор эпох работает, планировщик и трафик процессов берутся
+        // из сводок: карты источников обходятся только для запрошенных групп
+        let aggregator_running = self.epoch_aggregator.is_some();
+        let requested = self.demand.requested_groups(std::time::Instant::now());
+        let collects = |group| collects_group(group, aggregator_running, &requested);
+
+        // Используем scoped потоки: им нужен доступ к картам коллектора по ссылке
+        std::thread::scope(|scope| {
+            let syscall = scope.spawn(|| {
+                config
+                    .enable_syscall_monitoring
+                    .then(|| self.collect_syscall_details())
+                    .flatten()
+            });
+            let network = scope.spawn(|| {
+                config
+                    .enable_network_monitoring
+                    .then(|| self.collect_network_details())
+                    .flatten()
+            });
+            let connections = scope.spawn(|| {
+                config
+                    .enable_network_connections
+                    .then(|| self.collect_connection_details())
+                    .flatten()
+            });
+            let gpu = scope.spawn(|| {
+                config
+                    .enable_gpu_monitoring
+                    .then(|| self.collect_gpu_details())
+                    .flatten()
+            });
+            let cpu_temperature = scope.spawn(|| {
+                config
+                    .enable_cpu_temperature_monitoring
+                    .then(|| self.collect_cpu_temperature_from_maps().ok())
+                    .flatten()
+            });
+            let process = scope.spawn(|| {
+                config
+                    .enable_process_monitoring
+                    .then(|| self.collect_process_details())
+                    .flatten()
+            });
+            let filesystem = scope.spawn(|| {
+                config
+                    .enable_filesystem_monitoring
+                    .then(|| self.collect_filesystem_details())
+                    .flatten()
+            });
+            let process_energy = scope.spawn(|| {
+                (config.enable_process_energy_monitoring
+                    && collects(EbpfMetricGroup::ProcessEnergy))
+                .then(|| self.collect_process_energy_stats().ok().flatten())
+                .flatten()
+            });
+            let process_gpu = scope.spawn(|| {
+                (config.enable_process_gpu_monitoring && collects(EbpfMetricGroup::ProcessGpu))
+                    .then(|| self.collect_process_gpu_stats().ok().flatten())
+                    .flatten()
+            });
+            let process_network = scope.spawn(|| {
+                (config.enable_process_network_monitoring
+                    && collects(EbpfMetricGroup::ProcessNetwork))
+                .then(|| self.collect_process_network_stats().ok().flatten())
+                .flatten()
+            });
+            let process_disk = scope.spawn(|| {
+                (config.enable_process_disk_monitoring && collects(EbpfMetricGroup::ProcessDisk))
+                    .then(|| self.collect_process_disk_stats().ok().flatten())
+                    .flatten()
+            });
+            let process_memory = scope.spawn(|| {
+                (config.enable_process_memory_monitoring
+                    && collects(EbpfMetricGroup::ProcessMemory))
+                .then(|| self.collect_process_memory_stats().ok().flatten())
+                .flatten()
+            });
+            let application_performance = scope.spawn(|| {
+                (config.enable_application_performance_monitoring
+                    && collects(EbpfMetricGroup::ApplicationPerformance))
+                .then(|| self.collect_application_performance_stats().ok().flatten())
+                .flatten()
+            });
 
-        (
-            syscall_details,
-            network_details,
-            connection_details,
-            gpu_details,
-            cpu_temperature_details,
-            process_details,
-            filesystem_details,
-            process_energy_details,
-            process_gpu_details,
-            process_network_details,
-            process_memory_details,
-            application_performance_details,
-        )
+            (
+                syscall.join().unwrap_or(None),
+                network.join().unwrap_or(None),
+                connections.join().unwrap_or(None),
+                gpu.join().unwrap_or(None),
+                cpu_temperature.join().unwrap_or(None),
+                process.join().unwrap_or(None),
+                filesystem.join().unwrap_or(None),
+                process_energy.join().unwrap_or(None),
+                process_gpu.join().unwrap_or(None),
+                process_network.join().unwrap_or(None),
+                process_disk.join().unwrap_or(None),
+                process_memory.join().unwrap_or(None),
+                application_performance.join().unwrap_or(None),
+            )
+        })
     }
 
     /// Оптимизировать детализированную статистику для уменьшения использования памяти
@@ -3809,104 +5105,90 @@ impl EbpfMetricsCollector {
         Ok((packets, bytes))
     }
 
-    /// Собрать GPU метрики параллельно (оптимизация)
+    /// Собрать GPU метрики: загрузку, память, активные кольца, энергопотребление и температуру
     #[cfg(feature = "ebpf")]
     fn collect_gpu_metrics_parallel(&self) -> Result<(f64, u64, u32, u64, u32)> {
-        // Оптимизация: собираем GPU метрики в одном проходе
         if !self.config.enable_gpu_monitoring {
             return Ok((0.0, 0, 0, 0, 0));
         }
 
-        let usage = self.collect_gpu_usage_from_maps()?;
-        let memory = self.collect_gpu_memory_from_maps()?;
-        let compute_units = self.collect_gpu_compute_units_from_maps()?;
-        let power_usage = self.collect_gpu_power_usage_from_maps()?;
-        let temperature = self.collect_gpu_temperature_from_maps()?;
+        // Загрузка системы — по самому загруженному устройству; программа
+        // считает только время заданий, остальные значения остаются нулевыми
+        let devices = self.collect_gpu_device_usage();
+        let usage = devices
+            .iter()
+            .map(|device| device.usage_percent)
+            .fold(0.0, f64::max);
+        let active_rings = devices.iter().map(|device| device.active_rings).sum();
 
-        Ok((usage, memory, compute_units, power_usage, temperature))
+        Ok((usage, 0, active_rings, 0, 0))
     }
 
-    /// Собрать температуру CPU из eBPF карт
+    /// Прочитать состояния термальных зон
     #[cfg(feature = "ebpf")]
-    fn collect_cpu_temperature_from_maps(&self) -> Result<Vec<CpuTemperatureStat>> {
-        use libbpf_rs::Map;
+    fn collect_thermal_zones(&self) -> Vec<RawThermalZoneState> {
+        let mut zones = Vec::new();
+        for map in &self.cpu_temperature_maps {
+            match iterate_ebpf_map_keys::<RawThermalZoneState>(map, 16) {
+                Ok(mut states) => zones.append(&mut states),
+                Err(e) => {
+                    tracing::error!("Ошибка при чтении состояний термальных зон: {}", e);
+                }
+            }
+        }
+        zones.sort_by_key(|zone| zone.id);
+        zones
+    }
 
-        // Пробуем получить доступ к картам температуры CPU
+    /// Собрать температуру термальных зон из eBPF карт
+    #[cfg(feature = "ebpf")]
+    fn collect_cpu_temperature_from_maps(&self) -> Result<Vec<CpuTemperatureStat>> {
         if self.cpu_temperature_maps.is_empty() {
             tracing::warn!("Карты температуры CPU не инициализированы");
             return Ok(Vec::new());
         }
 
-        // Сбор данных из карт температуры CPU
-        let mut temperature_stats = Vec::new();
-
-        for map in &self.cpu_temperature_maps {
-            // Используем функцию итерации по ключам для получения всех данных о температуре
-            // Обновленная структура соответствует новой eBPF программе
-            match iterate_ebpf_map_keys::<(u32, u32, u32, u32, u32, u32, u32)>(map, 256) {
-                Ok(temperature_data) => {
-                    for (
-                        cpu_id,
-                        temperature_celsius,
-                        max_temperature_celsius,
-                        critical_temperature_celsius,
-                        timestamp,
-                        update_count,
-                        error_count,
-                    ) in temperature_data
-                    {
-                        temperature_stats.push(CpuTemperatureStat {
-                            cpu_id,
-                            temperature_celsius,
-                            max_temperature_celsius,
-                            critical_temperature_celsius,
-                            timestamp,
-                            update_count,
-                            error_count,
-                        });
-                    }
-                }
-                Err(e) => {
-                    tracing::error!("Ошибка при итерации по карте температуры CPU: {}", e);
-                    continue;
-                }
-            }
-        }
+        Ok(self.thermal_zone_stats(&self.collect_thermal_zones()))
+    }
 
-        Ok(temperature_stats)
+    /// Преобразовать состояния зон в статистику с порогами из sysfs
+    #[cfg(feature = "ebpf")]
+    fn thermal_zone_stats(&self, zones: &[RawThermalZoneState]) -> Vec<CpuTemperatureStat> {
+        zones
+            .iter()
+            .map(|zone| CpuTemperatureStat {
+                cpu_id: zone.id.max(0) as u32,
+                zone_type: zone.zone_type(),
+                temperature_celsius: millicelsius_to_celsius(zone.temperature_mc),
+                max_temperature_celsius: millicelsius_to_celsius(zone.max_temperature_mc),
+                critical_temperature_celsius: self
+                    .thermal_critical_trips
+                    .get(&zone.id)
+                    .map_or(0, |trip| millicelsius_to_celsius(*trip)),
+                timestamp: zone.last_update_ns,
+                update_count: zone.updates.min(u32::MAX as u64) as u32,
+                error_count: 0,
+            })
+            .collect()
     }
 
     /// Собрать данные о температуре CPU (основные и детализированные)
+    ///
+    /// Средняя и наибольшая температура считаются по зонам процессора.
     #[cfg(feature = "ebpf")]
     fn collect_cpu_temperature_data(&self) -> Result<(u32, u32, Option<Vec<CpuTemperatureStat>>)> {
         if !self.config.enable_cpu_temperature_monitoring {
             return Ok((0, 0, None));
         }
 
-        // Собираем детализированную статистику
-        let temperature_details = self.collect_cpu_temperature_from_maps()?;
-
-        // Вычисляем среднюю и максимальную температуру
-        let (avg_temp, max_temp) = if !temperature_details.is_empty() {
-            let total_temp: u32 = temperature_details
-                .iter()
-                .map(|stat| stat.temperature_celsius)
-                .sum();
-            let avg_temp = total_temp / temperature_details.len() as u32;
-            let max_temp = temperature_details
-                .iter()
-                .map(|stat| stat.max_temperature_celsius)
-                .max()
-                .unwrap_or(0);
-            (avg_temp, max_temp)
-        } else {
-            (0, 0)
-        };
+        let zones = self.collect_thermal_zones();
+        let (avg_temp, max_temp) = summarize_cpu_zones(&zones).unwrap_or((0, 0));
 
-        let details = if temperature_details.is_empty() {
+        let details = self.thermal_zone_stats(&zones);
+        let details = if details.is_empty() {
             None
         } else {
-            Some(temperature_details)
+            Some(details)
         };
 
         Ok((avg_temp, max_temp, details))
@@ -3915,7 +5197,6 @@ impl EbpfMetricsCollector {
     /// Собрать CPU метрики из eBPF карт
     #[cfg(feature = "ebpf")]
     fn collect_cpu_metrics_from_maps(&self) -> Result<f64> {
-        use libbpf_rs::Map;
 
         // Пробуем получить доступ к CPU картам
         if self.cpu_maps.is_empty() {
@@ -3958,7 +5239,6 @@ impl EbpfMetricsCollector {
     /// Собрать метрики памяти из eBPF карт
     #[cfg(feature = "ebpf")]
     fn collect_memory_metrics_from_maps(&self) -> Result<u64> {
-        use libbpf_rs::Map;
 
         // Пробуем получить доступ к картам памяти
         if self.memory_maps.is_empty() {
@@ -3996,7 +5276,6 @@ impl EbpfMetricsCollector {
     /// Собрать количество системных вызовов из eBPF карт
     #[cfg(feature = "ebpf")]
     fn collect_syscall_count_from_maps(&self) -> Result<u64> {
-        use libbpf_rs::Map;
 
         // Пробуем получить доступ к картам системных вызовов
         if self.syscall_maps.is_empty() {
@@ -4004,19 +5283,14 @@ impl EbpfMetricsCollector {
             return Ok(0);
         }
 
-        // Реальный сбор данных из карт системных вызовов с использованием итерации по ключам
+        // Карты системных вызовов — per-CPU счётчики, копии всех CPU читаются одним запросом
         let mut total_count = 0u64;
 
         for map in &self.syscall_maps {
-            // Используем функцию итерации по ключам для получения всех данных о системных вызовах
-            match iterate_ebpf_map_keys::<u64>(map, 8) {
-                Ok(syscall_data) => {
-                    for count in syscall_data {
-                        total_count += count;
-                    }
-                }
+            match read_percpu_counter(map) {
+                Ok(count) => total_count = total_count.saturating_add(count),
                 Err(e) => {
-                    tracing::error!("Ошибка при итерации по карте системных вызовов: {}", e);
+                    tracing::error!("Ошибка при чтении per-CPU счётчика системных вызовов: {}", e);
                     continue;
                 }
             }
@@ -4028,45 +5302,18 @@ impl EbpfMetricsCollector {
     /// Собрать количество сетевых пакетов из eBPF карт
     #[cfg(feature = "ebpf")]
     fn collect_network_packets_from_maps(&self) -> Result<u64> {
-        use libbpf_rs::Map;
-
-        // Пробуем получить доступ к сетевым картам
-        if self.network_maps.is_empty() {
-            tracing::warn!("Сетевые карты не инициализированы для сбора статистики пакетов. Проверьте, что eBPF программа загружена");
+        // Общее количество пакетов ведётся в per-CPU счётчике программы
+        let Some(counter) = &self.network_packet_counter else {
+            tracing::warn!("Счётчик сетевых пакетов не инициализирован. Проверьте, что eBPF программа загружена");
             return Ok(0);
-        }
-
-        // Реальный сбор данных из сетевых карт с использованием итерации по ключам
-        let mut total_packets = 0u64;
-        let mut error_count = 0;
-
-        for map in &self.network_maps {
-            // Используем функцию итерации по ключам для получения всех данных о сетевых пакетах
-            match iterate_ebpf_map_keys::<u64>(map, 8) {
-                Ok(packet_data) => {
-                    for packets in packet_data {
-                        total_packets += packets;
-                    }
-                }
-                Err(e) => {
-                    error_count += 1;
-                    tracing::error!("Ошибка при итерации по сетевой карте пакетов: {}. Проверьте целостность eBPF карты и права доступа", e);
-                    continue;
-                }
-            }
-        }
-
-        if error_count > 0 {
-            tracing::warn!("Ошибки при сборе статистики пакетов из {} сетевых карт. Результат может быть неполным", error_count);
-        }
+        };
 
-        Ok(total_packets)
+        read_percpu_counter(counter).context("Не удалось прочитать per-CPU счётчик сетевых пакетов")
     }
 
     /// Собрать количество сетевых байт из eBPF карт
     #[cfg(feature = "ebpf")]
     fn collect_network_bytes_from_maps(&self) -> Result<u64> {
-        use libbpf_rs::Map;
 
         // Пробуем получить доступ к сетевым картам
         if self.network_maps.is_empty() {
@@ -4101,387 +5348,239 @@ impl EbpfMetricsCollector {
         Ok(total_bytes)
     }
 
-    /// Собрать использование GPU из eBPF карт
+    /// Собрать количество активных сетевых соединений
     #[cfg(feature = "ebpf")]
-    fn collect_gpu_usage_from_maps(&self) -> Result<f64> {
-        use libbpf_rs::Map;
+    fn collect_active_connections(&self) -> Result<u64> {
 
-        // Пробуем получить доступ к GPU картам
-        if self.gpu_maps.is_empty() {
-            tracing::warn!("GPU карты не инициализированы");
-            return Ok(0.0);
+        if !self.config.enable_network_connections {
+            return Ok(0);
         }
 
-        // Реальный сбор данных из GPU карт с использованием итерации по ключам
-        let mut total_usage = 0.0;
-        let mut map_count = 0;
+        // Пробуем получить доступ к картам соединений
+        if self.connection_maps.is_empty() {
+            tracing::warn!("Карты соединений не инициализированы");
+            return Ok(0);
+        }
 
-        for map in &self.gpu_maps {
-            // Используем функцию итерации по ключам для получения всех данных о GPU
-            match iterate_ebpf_map_keys::<f64>(map, 8) {
-                Ok(gpu_data) => {
-                    for usage in gpu_data {
-                        total_usage += usage;
-                        map_count += 1;
-                    }
-                }
+        // Считаем количество активных соединений
+        let mut active_count = 0u64;
+
+        for map in &self.connection_maps {
+            // Закрытые соединения удаляются в ядре, поэтому каждая запись — активное соединение
+            match iterate_ebpf_map_keys::<RawConnectionRecord>(map, ebpf_batch::MIN_BATCH_ENTRIES) {
+                Ok(records) => active_count += records.len() as u64,
                 Err(e) => {
-                    tracing::error!("Ошибка при итерации по GPU карте: {}", e);
+                    tracing::error!("Ошибка при итерации по карте активных соединений: {}", e);
                     continue;
                 }
             }
         }
 
-        if map_count > 0 {
-            Ok(total_usage / map_count as f64)
-        } else {
-            Ok(0.0)
-        }
+        Ok(active_count)
     }
 
-    /// Собрать использование памяти GPU из eBPF карт
+    /// Собрать количество активных процессов
     #[cfg(feature = "ebpf")]
-    fn collect_gpu_memory_from_maps(&self) -> Result<u64> {
-        use libbpf_rs::Map;
+    fn collect_active_processes(&self) -> Result<u64> {
 
-        // Пробуем получить доступ к GPU картам
-        if self.gpu_maps.is_empty() {
-            tracing::warn!("GPU карты не инициализированы");
+        if !self.config.enable_process_monitoring {
             return Ok(0);
         }
 
-        // Реальный сбор данных из GPU карт с использованием итерации по ключам
-        let mut total_memory = 0u64;
-        let mut map_count = 0;
+        // Пробуем получить доступ к картам процессов
+        let process_stats = if self.process_maps.is_empty() {
+            tracing::warn!("Карты процессов не инициализированы");
+            Vec::new()
+        } else {
+            read_task_state::<RawProcessInfo>(
+                self.process_monitoring_program.as_ref(),
+                PROCESS_INFO_ITER,
+                &self.process_maps,
+                64,
+            )
+            .unwrap_or_else(|e| {
+                tracing::error!("Ошибка при чтении записей активных процессов: {}", e);
+                Vec::new()
+            })
+        };
 
-        for map in &self.gpu_maps {
-            // Используем функцию итерации по ключам для получения всех данных о памяти GPU
-            match iterate_ebpf_map_keys::<u64>(map, 8) {
-                Ok(memory_data) => {
-                    for memory in memory_data {
-                        total_memory += memory;
-                        map_count += 1;
-                    }
-                }
-                Err(e) => {
-                    tracing::error!("Ошибка при итерации по GPU карте памяти: {}", e);
-                    continue;
-                }
-            }
-        }
+        // Процессы, запущенные до загрузки программы, известны только по системным вызовам
+        let syscall_stats = self.collect_syscall_process_table();
 
-        if map_count > 0 {
-            Ok(total_memory / map_count as u64)
-        } else {
-            Ok(0)
-        }
+        Ok(ProcessStat::count_active(&process_stats, &syscall_stats))
     }
 
-    /// Собрать количество активных вычислительных единиц GPU из eBPF карт
+    /// Собрать энергопотребление процессов
+    ///
+    /// Энергия пакетов RAPL делится между процессами пропорционально их времени
+    /// на CPU из общей записи планировщика (см. `ebpf_energy`). Возвращаются
+    /// процессы, которым за время наблюдения приписана энергия.
     #[cfg(feature = "ebpf")]
-    fn collect_gpu_compute_units_from_maps(&self) -> Result<u32> {
-        use libbpf_rs::Map;
-
-        // Пробуем получить доступ к GPU картам
-        if self.gpu_maps.is_empty() {
-            tracing::warn!("GPU карты не инициализированы");
-            return Ok(0);
+    fn collect_process_energy_stats(&self) -> Result<Option<Vec<ProcessEnergyStat>>> {
+        if !self.config.enable_process_energy_monitoring {
+            return Ok(None);
         }
 
-        // Реальный сбор данных о вычислительных единицах из GPU карт
-        let mut total_compute_units = 0u32;
-        let mut map_count = 0;
+        let Some(oncpu_map) = &self.sched_oncpu_map else {
+            tracing::warn!("Карта занятости CPU общей программы планировщика не инициализирована");
+            return Ok(None);
+        };
 
-        for map in &self.gpu_maps {
-            // Используем функцию итерации по ключам для получения данных о вычислительных единицах
-            match iterate_ebpf_map_keys::<u32>(map, 4) {
-                Ok(compute_data) => {
-                    for compute_units in compute_data {
-                        total_compute_units += compute_units;
-                        map_count += 1;
-                    }
-                }
-                Err(e) => {
-                    tracing::error!(
-                        "Ошибка при итерации по GPU карте вычислительных единиц: {}",
-                        e
-                    );
-                    continue;
-                }
+        let busy_ns = match iterate_ebpf_map_keys::<RawSchedOncpuSlot>(oncpu_map, 1) {
+            Ok(slots) => total_busy_ns(&slots),
+            Err(e) => {
+                tracing::error!("Ошибка при чтении занятости CPU: {}", e);
+                return Ok(None);
             }
-        }
+        };
+        let sched_tasks = self.collect_sched_task_table();
+
+        let mut energy_stats: Vec<ProcessEnergyStat> = self
+            .energy_attributor
+            .lock()
+            .map(|mut attributor| {
+                if !attributor.has_energy_source() {
+                    return Vec::new();
+                }
 
-        if map_count > 0 {
-            Ok(total_compute_units / map_count as u32)
+                let runtimes = sched_tasks.iter().map(|task| (task.tgid, task.runtime_ns));
+                attributor
+                    .sample(std::time::Instant::now(), busy_ns, runtimes)
+                    .iter()
+                    .filter(|(_, energy)| energy.energy_uj > 0)
+                    .filter_map(|(tgid, energy)| {
+                        let task = sched_tasks.get(*tgid)?;
+                        Some(ProcessEnergyStat {
+                            pid: *tgid,
+                            tgid: *tgid,
+                            energy_uj: energy.energy_uj,
+                            last_update_ns: task.last_switch_ns,
+                            cpu_id: task.last_cpu,
+                            name: task.name(),
+                            energy_w: energy.power_w as f32,
+                        })
+                    })
+                    .collect()
+            })
+            .unwrap_or_default();
+
+        // Самые энергоёмкие процессы первыми: список обрезается до max_cached_details
+        energy_stats.sort_by(|a, b| {
+            b.energy_w
+                .total_cmp(&a.energy_w)
+                .then_with(|| b.energy_uj.cmp(&a.energy_uj))
+        });
+
+        if energy_stats.is_empty() {
+            Ok(None)
         } else {
-            Ok(0)
+            Ok(Some(energy_stats))
         }
     }
 
-    /// Собрать данные об энергопотреблении GPU из eBPF карт
+    /// Прочитать время GPU процессов из программы мониторинга GPU
     #[cfg(feature = "ebpf")]
-    fn collect_gpu_power_usage_from_maps(&self) -> Result<u64> {
-        use libbpf_rs::Map;
-
-        // Пробуем получить доступ к GPU картам
-        if self.gpu_maps.is_empty() {
-            tracing::warn!("GPU карты не инициализированы");
-            return Ok(0);
-        }
+    fn collect_gpu_process_usage(&self) -> std::collections::HashMap<u32, GpuProcessUsage> {
+        let Some(map) = &self.gpu_process_usage_map else {
+            return Default::default();
+        };
 
-        // Реальный сбор данных об энергопотреблении из GPU карт
-        let mut total_power = 0u64;
-        let mut map_count = 0;
-
-        for map in &self.gpu_maps {
-            // Используем функцию итерации по ключам для получения данных об энергопотреблении
-            match iterate_ebpf_map_keys::<u64>(map, 8) {
-                Ok(power_data) => {
-                    for power in power_data {
-                        total_power += power;
-                        map_count += 1;
-                    }
-                }
-                Err(e) => {
-                    tracing::error!("Ошибка при итерации по GPU карте энергопотребления: {}", e);
-                    continue;
-                }
+        match iterate_ebpf_map_keys::<RawGpuProcessUsage>(map, 256) {
+            Ok(usage) => {
+                fold_process_usage(&GpuTopology::from_rings(&self.collect_gpu_rings()), &usage)
             }
-        }
-
-        if map_count > 0 {
-            Ok(total_power / map_count as u64)
-        } else {
-            Ok(0)
-        }
-    }
-
-    /// Собрать данные о температуре GPU из eBPF карт
-    #[cfg(feature = "ebpf")]
-    fn collect_gpu_temperature_from_maps(&self) -> Result<u32> {
-        use libbpf_rs::Map;
-
-        // Пробуем получить доступ к GPU картам
-        if self.gpu_maps.is_empty() {
-            tracing::warn!("GPU карты не инициализированы");
-            return Ok(0);
-        }
-
-        // Реальный сбор данных о температуре из GPU карт
-        let mut total_temp = 0u32;
-        let mut map_count = 0;
-
-        for map in &self.gpu_maps {
-            // Используем функцию итерации по ключам для получения данных о температуре
-            match iterate_ebpf_map_keys::<u32>(map, 4) {
-                Ok(temp_data) => {
-                    for temp in temp_data {
-                        total_temp += temp;
-                        map_count += 1;
-                    }
-                }
-                Err(e) => {
-                    tracing::error!("Ошибка при итерации по GPU карте температуры: {}", e);
-                    continue;
-                }
-            }
-        }
-
-        if map_count > 0 {
-            Ok(total_temp / map_count as u32)
-        } else {
-            Ok(0)
-        }
-    }
-
-    /// Собрать количество активных сетевых соединений
-    #[cfg(feature = "ebpf")]
-    fn collect_active_connections(&self) -> Result<u64> {
-        use libbpf_rs::Map;
-
-        if !self.config.enable_network_connections {
-            return Ok(0);
-        }
-
-        // Пробуем получить доступ к картам соединений
-        if self.connection_maps.is_empty() {
-            tracing::warn!("Карты соединений не инициализированы");
-            return Ok(0);
-        }
-
-        // Считаем количество активных соединений
-        let mut active_count = 0u64;
-
-        for map in &self.connection_maps {
-            // Используем функцию итерации по ключам для получения всех активных соединений
-            match iterate_ebpf_map_keys::<u8>(map, 1) {
-                Ok(active_flags) => {
-                    for flag in active_flags {
-                        if flag > 0 {
-                            active_count += 1;
-                        }
-                    }
-                }
-                Err(e) => {
-                    tracing::error!("Ошибка при итерации по карте активных соединений: {}", e);
-                    continue;
-                }
-            }
-        }
-
-        Ok(active_count)
-    }
-
-    /// Собрать количество активных процессов
-    #[cfg(feature = "ebpf")]
-    fn collect_active_processes(&self) -> Result<u64> {
-        use libbpf_rs::Map;
-
-        if !self.config.enable_process_monitoring {
-            return Ok(0);
-        }
-
-        // Пробуем получить доступ к картам процессов
-        if self.process_maps.is_empty() {
-            tracing::warn!("Карты процессов не инициализированы");
-            return Ok(0);
-        }
-
-        // Считаем количество активных процессов
-        let mut active_count = 0u64;
-
-        for map in &self.process_maps {
-            // Используем функцию итерации по ключам для получения всех активных процессов
-            match iterate_ebpf_map_keys::<ProcessStat>(map, 64) {
-                Ok(process_stats) => {
-                    for stat in process_stats {
-                        if stat.last_activity > 0 {
-                            active_count += 1;
-                        }
-                    }
-                }
-                Err(e) => {
-                    tracing::error!("Ошибка при итерации по карте активных процессов: {}", e);
-                    continue;
-                }
-            }
-        }
-
-        Ok(active_count)
-    }
-
-    /// Собрать статистику энергопотребления процессов из eBPF карт
-    #[cfg(feature = "ebpf")]
-    fn collect_process_energy_stats(&self) -> Result<Option<Vec<ProcessEnergyStat>>> {
-        use libbpf_rs::Map;
-
-        if !self.config.enable_process_energy_monitoring {
-            return Ok(None);
-        }
-
-        // Пробуем получить доступ к картам энергопотребления процессов
-        if self.process_energy_maps.is_empty() {
-            tracing::warn!("Карты энергопотребления процессов не инициализированы");
-            return Ok(None);
-        }
-
-        let mut energy_stats = Vec::new();
-
-        for map in &self.process_energy_maps {
-            // Используем функцию итерации по ключам для получения всех записей энергопотребления
-            match iterate_ebpf_map_keys::<ProcessEnergyStat>(map, 10240) {
-                Ok(stats) => {
-                    for stat in stats {
-                        // Конвертируем энергию из микроджоулей в ватты (упрощенная конвертация)
-                        let energy_w = if stat.last_update_ns > 0 {
-                            // Упрощенная конвертация: предполагаем 1 секунду интервала
-                            stat.energy_uj as f32 / 1_000_000.0
-                        } else {
-                            0.0
-                        };
-
-                        energy_stats.push(ProcessEnergyStat {
-                            pid: stat.pid,
-                            tgid: stat.tgid,
-                            energy_uj: stat.energy_uj,
-                            last_update_ns: stat.last_update_ns,
-                            cpu_id: stat.cpu_id,
-                            name: stat.name.clone(),
-                            energy_w,
-                        });
-                    }
-                }
-                Err(e) => {
-                    tracing::error!(
-                        "Ошибка при итерации по карте энергопотребления процессов: {}",
-                        e
-                    );
-                    continue;
-                }
+            Err(e) => {
+                tracing::error!("Ошибка при чтении времени GPU процессов: {}", e);
+                Default::default()
             }
         }
-
-        if energy_stats.is_empty() {
-            Ok(None)
-        } else {
-            Ok(Some(energy_stats))
-        }
     }
 
     /// Собрать статистику по использованию GPU процессами
+    ///
+    /// Время заданий GPU, их количество и устройство берутся из программы
+    /// мониторинга GPU, где запуск и завершение задания сопоставлены по fence;
+    /// память GPU — из записей `process_gpu`. Процент — доля времени GPU за
+    /// интервал с прошлого сбора.
     #[cfg(feature = "ebpf")]
     fn collect_process_gpu_stats(&self) -> Result<Option<Vec<ProcessGpuStat>>> {
-        use libbpf_rs::Map;
 
         if !self.config.enable_process_gpu_monitoring {
             return Ok(None);
         }
 
-        // Пробуем получить доступ к картам использования GPU процессами
-        if self.process_gpu_maps.is_empty() {
+        let usage = self.collect_gpu_process_usage();
+
+        if self.process_gpu_maps.is_empty() && usage.is_empty() {
             tracing::warn!("Карты использования GPU процессами не инициализированы");
             return Ok(None);
         }
 
-        let mut gpu_stats = Vec::new();
+        let mut records: std::collections::HashMap<u32, RawProcessGpuStats> =
+            std::collections::HashMap::new();
 
-        for map in &self.process_gpu_maps {
-            // Используем функцию итерации по ключам для получения всех записей использования GPU
-            match iterate_ebpf_map_keys::<ProcessGpuStat>(map, 10240) {
-                Ok(stats) => {
-                    for stat in stats {
-                        // Конвертируем время использования GPU в проценты (упрощенная конвертация)
-                        let gpu_usage_percent = if stat.last_update_ns > 0 {
-                            // Упрощенная конвертация: предполагаем 1 секунду интервала
-                            (stat.gpu_time_ns as f32 / 1_000_000.0).min(100.0)
-                        } else {
-                            0.0
-                        };
-
-                        gpu_stats.push(ProcessGpuStat {
-                            pid: stat.pid,
-                            tgid: stat.tgid,
-                            gpu_time_ns: stat.gpu_time_ns,
-                            memory_usage_bytes: stat.memory_usage_bytes,
-                            compute_units_used: stat.compute_units_used,
-                            last_update_ns: stat.last_update_ns,
-                            gpu_id: stat.gpu_id,
-                            temperature_celsius: stat.temperature_celsius,
-                            name: stat.name.clone(),
-                            gpu_usage_percent,
-                        });
-                    }
-                }
+        if !self.process_gpu_maps.is_empty() {
+            match read_task_state::<RawProcessGpuStats>(
+                self.process_gpu_program.as_ref(),
+                PROCESS_GPU_ITER,
+                &self.process_gpu_maps,
+                10240,
+            ) {
+                Ok(stats) => records.extend(stats.into_iter().map(|stat| (stat.tgid, stat))),
                 Err(e) => {
                     tracing::error!(
-                        "Ошибка при итерации по карте использования GPU процессами: {}",
+                        "Ошибка при чтении записей использования GPU процессами: {}",
                         e
                     );
-                    continue;
                 }
             }
         }
 
+        // Процессы, отправлявшие задания GPU до появления записи process_gpu
+        for process in usage.values() {
+            records.entry(process.tgid).or_insert(RawProcessGpuStats {
+                tgid: process.tgid,
+                ..Default::default()
+            });
+        }
+
+        let rates = self
+            .gpu_process_sampler
+            .lock()
+            .map(|mut sampler| {
+                sampler.sample(
+                    std::time::Instant::now(),
+                    usage.values().map(|process| (process.tgid, process.busy_ns)),
+                )
+            })
+            .unwrap_or_default();
+        let sched_tasks = self.collect_sched_task_table();
+
+        let gpu_stats: Vec<ProcessGpuStat> = records
+            .into_values()
+            .map(|stat| {
+                let process = usage.get(&stat.tgid);
+
+                ProcessGpuStat {
+                    pid: stat.tgid,
+                    tgid: stat.tgid,
+                    gpu_time_ns: process.map_or(0, |process| process.busy_ns),
+                    memory_usage_bytes: stat.memory_usage_bytes,
+                    compute_units_used: process.map_or(0, |process| process.jobs),
+                    last_update_ns: process.map_or(stat.last_update_ns, |process| {
+                        stat.last_update_ns.max(process.last_update_ns)
+                    }),
+                    gpu_id: process.map_or(0, |process| process.gpu_id),
+                    temperature_celsius: 0,
+                    name: sched_tasks
+                        .get(stat.tgid)
+                        .map(|task| task.name())
+                        .unwrap_or_default(),
+                    gpu_usage_percent: rates.get(&stat.tgid).copied().unwrap_or(0.0) as f32,
+                }
+            })
+            .collect();
+
         if gpu_stats.is_empty() {
             Ok(None)
         } else {
@@ -4490,9 +5589,13 @@ impl EbpfMetricsCollector {
     }
 
     /// Собрать статистику использования сети процессами из eBPF карт
+    ///
+    /// Байты — реально переданные и полученные данные, per-CPU копии записей
+    /// складываются по TGID. Пакетами считаются успешные вызовы отправки и
+    /// чтения. Процессы упорядочены по объёму трафика, чтобы при ограничении
+    /// детализации оставались самые нагруженные.
     #[cfg(feature = "ebpf")]
     fn collect_process_network_stats(&self) -> Result<Option<Vec<ProcessNetworkStat>>> {
-        use libbpf_rs::Map;
 
         if !self.config.enable_process_network_monitoring {
             return Ok(None);
@@ -4504,36 +5607,44 @@ impl EbpfMetricsCollector {
             return Ok(None);
         }
 
-        let mut network_stats = Vec::new();
-
+        let mut entries = Vec::new();
         for map in &self.process_network_maps {
-            // Используем функцию итерации по ключам для получения всех записей использования сети
-            match iterate_ebpf_map_keys::<ProcessNetworkStat>(map, 10240) {
-                Ok(stats) => {
-                    for stat in stats {
-                        network_stats.push(ProcessNetworkStat {
-                            pid: stat.pid,
-                            tgid: stat.tgid,
-                            packets_sent: stat.packets_sent,
-                            packets_received: stat.packets_received,
-                            bytes_sent: stat.bytes_sent,
-                            bytes_received: stat.bytes_received,
-                            last_update_ns: stat.last_update_ns,
-                            name: stat.name.clone(),
-                            total_network_operations: stat.packets_sent + stat.packets_received,
-                        });
-                    }
-                }
+            match iterate_ebpf_map_entries::<u32, RawNetTraffic>(map, ebpf_batch::MIN_BATCH_ENTRIES)
+            {
+                Ok(map_entries) => entries.extend(map_entries),
                 Err(e) => {
                     tracing::error!(
                         "Ошибка при итерации по карте использования сети процессами: {}",
                         e
                     );
-                    continue;
                 }
             }
         }
 
+        // Имя процесса берём из общей записи планировщика
+        let sched_tasks = self.collect_sched_task_table();
+        let mut network_stats: Vec<ProcessNetworkStat> = reduce_process_traffic(entries)
+            .into_iter()
+            .map(|(tgid, traffic)| ProcessNetworkStat {
+                pid: tgid,
+                tgid,
+                packets_sent: traffic.send_calls,
+                packets_received: traffic.recv_calls,
+                bytes_sent: traffic.bytes_sent,
+                bytes_received: traffic.bytes_received,
+                last_update_ns: sched_tasks.get(tgid).map_or(0, |task| task.last_switch_ns),
+                name: sched_tasks
+                    .get(tgid)
+                    .map_or_else(String::new, |task| task.name()),
+                total_network_operations: traffic.send_calls.saturating_add(traffic.recv_calls),
+            })
+            .collect();
+        network_stats.sort_by(|a, b| {
+            (b.bytes_sent + b.bytes_received)
+                .cmp(&(a.bytes_sent + a.bytes_received))
+                .then(a.tgid.cmp(&b.tgid))
+        });
+
         if network_stats.is_empty() {
             Ok(None)
         } else {
@@ -4541,10 +5652,103 @@ impl EbpfMetricsCollector {
         }
     }
 
+    /// Собрать трафик сокетов, упорядоченный по объёму
+    ///
+    /// Возвращается не больше `max_cached_details` самых нагруженных сокетов.
+    #[cfg(feature = "ebpf")]
+    fn collect_socket_traffic_stats(&self) -> Option<Vec<SocketTrafficStat>> {
+        if !self.config.enable_process_network_monitoring {
+            return None;
+        }
+
+        let map = self.socket_traffic_map.as_ref()?;
+        let sockets = match iterate_ebpf_map_entries::<u64, RawSocketTraffic>(
+            map,
+            ebpf_batch::MIN_BATCH_ENTRIES,
+        ) {
+            Ok(entries) => entries
+                .iter()
+                .filter_map(|(cookie, per_cpu)| SocketTrafficStat::from_per_cpu(*cookie, per_cpu))
+                .collect(),
+            Err(e) => {
+                tracing::error!("Ошибка при чтении трафика сокетов: {}", e);
+                return None;
+            }
+        };
+
+        let sockets = top_sockets(sockets, self.max_cached_details);
+        if sockets.is_empty() {
+            None
+        } else {
+            Some(sockets)
+        }
+    }
+
+    /// Собрать задержки блочного ввода-вывода и очереди устройств
+    ///
+    /// Сводки по устройствам идут первыми, за ними не больше `max_cached_details`
+    /// пар (процесс, устройство) с наибольшим суммарным ожиданием.
+    #[cfg(feature = "ebpf")]
+    fn collect_disk_io_stats(&self) -> (Option<Vec<DiskLatencyStat>>, Option<Vec<DiskQueueStat>>) {
+        if !self.config.enable_process_disk_monitoring {
+            return (None, None);
+        }
+
+        (
+            self.collect_disk_latency_stats(),
+            self.collect_disk_queue_stats(),
+        )
+    }
+
+    #[cfg(feature = "ebpf")]
+    fn collect_disk_latency_stats(&self) -> Option<Vec<DiskLatencyStat>> {
+        let map = self.disk_latency_map.as_ref()?;
+        let entries = match iterate_ebpf_map_entries::<RawDiskLatencyKey, RawLatencyHistogram>(
+            map,
+            ebpf_batch::MIN_BATCH_ENTRIES,
+        ) {
+            Ok(entries) => entries,
+            Err(e) => {
+                tracing::error!("Ошибка при чтении задержек блочного ввода-вывода: {}", e);
+                return None;
+            }
+        };
+
+        let merged: Vec<_> = entries
+            .iter()
+            .map(|(key, per_cpu)| (*key, RawLatencyHistogram::merge_per_cpu(per_cpu)))
+            .collect();
+        let stats = summarize_disk_latency(&merged, self.max_cached_details);
+        if stats.is_empty() {
+            None
+        } else {
+            Some(stats)
+        }
+    }
+
+    #[cfg(feature = "ebpf")]
+    fn collect_disk_queue_stats(&self) -> Option<Vec<DiskQueueStat>> {
+        let map = self.disk_device_map.as_ref()?;
+        let devices = match iterate_ebpf_map_keys::<RawDiskDeviceStats>(map, 16) {
+            Ok(devices) => devices,
+            Err(e) => {
+                tracing::error!("Ошибка при чтении очередей блочных устройств: {}", e);
+                return None;
+            }
+        };
+
+        let mut stats: Vec<_> = devices.iter().map(DiskQueueStat::from_raw).collect();
+        stats.sort_by(|a, b| a.device.cmp(&b.device));
+        if stats.is_empty() {
+            None
+        } else {
+            Some(stats)
+        }
+    }
+
     /// Собрать статистику использования диска процессами из eBPF карт
     #[cfg(feature = "ebpf")]
     fn collect_process_disk_stats(&self) -> Result<Option<Vec<ProcessDiskStat>>> {
-        use libbpf_rs::Map;
 
         if !self.config.enable_process_disk_monitoring {
             return Ok(None);
@@ -4557,33 +5761,38 @@ impl EbpfMetricsCollector {
         }
 
         let mut disk_stats = Vec::new();
-
-        for map in &self.process_disk_maps {
-            // Используем функцию итерации по ключам для получения всех записей использования диска
-            match iterate_ebpf_map_keys::<ProcessDiskStat>(map, 10240) {
-                Ok(stats) => {
-                    for stat in stats {
-                        disk_stats.push(ProcessDiskStat {
-                            pid: stat.pid,
-                            tgid: stat.tgid,
-                            bytes_read: stat.bytes_read,
-                            bytes_written: stat.bytes_written,
-                            read_operations: stat.read_operations,
-                            write_operations: stat.write_operations,
-                            last_update_ns: stat.last_update_ns,
-                            name: stat.name.clone(),
-                            total_io_operations: stat.read_operations + stat.write_operations,
-                        });
-                    }
-                }
-                Err(e) => {
-                    tracing::error!(
-                        "Ошибка при итерации по карте использования диска процессами: {}",
-                        e
-                    );
-                    continue;
+        let sched_tasks = self.collect_sched_task_table();
+
+        match read_task_state::<RawProcessDiskStats>(
+            self.process_disk_program.as_ref(),
+            PROCESS_DISK_ITER,
+            &self.process_disk_maps,
+            10240,
+        ) {
+            Ok(stats) => {
+                for stat in stats {
+                    disk_stats.push(ProcessDiskStat {
+                        pid: stat.tgid,
+                        tgid: stat.tgid,
+                        bytes_read: stat.bytes_read,
+                        bytes_written: stat.bytes_written,
+                        read_operations: stat.read_operations,
+                        write_operations: stat.write_operations,
+                        last_update_ns: stat.last_timestamp,
+                        name: sched_tasks
+                            .get(stat.tgid)
+                            .map(|task| task.name())
+                            .unwrap_or_default(),
+                        total_io_operations: stat.read_operations + stat.write_operations,
+                    });
                 }
             }
+            Err(e) => {
+                tracing::error!(
+                    "Ошибка при чтении записей использования диска процессами: {}",
+                    e
+                );
+            }
         }
 
         if disk_stats.is_empty() {
@@ -4596,7 +5805,6 @@ impl EbpfMetricsCollector {
     /// Собрать статистику использования памяти процессами из eBPF карт
     #[cfg(feature = "ebpf")]
     fn collect_process_memory_stats(&self) -> Result<Option<Vec<ProcessMemoryStat>>> {
-        use libbpf_rs::Map;
 
         if !self.config.enable_process_memory_monitoring {
             return Ok(None);
@@ -4609,28 +5817,24 @@ impl EbpfMetricsCollector {
         }
 
         let mut memory_stats = Vec::new();
+        let sched_tasks = self.collect_sched_task_table();
+        let page_size = unsafe { libc::sysconf(libc::_SC_PAGESIZE) }.max(1) as u64;
 
         for map in &self.process_memory_maps {
             // Используем функцию итерации по ключам для получения всех записей использования памяти
-            match iterate_ebpf_map_keys::<ProcessMemoryStat>(map, 10240) {
+            match iterate_ebpf_map_keys::<RawProcessMemoryStat>(map, 10240) {
                 Ok(stats) => {
-                    for stat in stats {
-                        memory_stats.push(ProcessMemoryStat {
-                            pid: stat.pid,
-                            tgid: stat.tgid,
-                            last_update_ns: stat.last_update_ns,
-                            rss_bytes: stat.rss_bytes,
-                            vms_bytes: stat.vms_bytes,
-                            shared_bytes: stat.shared_bytes,
-                            swap_bytes: stat.swap_bytes,
-                            heap_usage: stat.heap_usage,
-                            stack_usage: stat.stack_usage,
-                            anonymous_memory: stat.anonymous_memory,
-                            file_backed_memory: stat.file_backed_memory,
-                            major_faults: stat.major_faults,
-                            minor_faults: stat.minor_faults,
-                            name: stat.name.clone(),
-                        });
+                    for raw in stats {
+                        let mut stat = ProcessMemoryStat::from_raw(&raw, page_size);
+                        // Периодический снимок RSS делает общая программа планировщика;
+                        // берём его, если он свежее записи из mmap/munmap/brk
+                        if let Some(task) = sched_tasks.get(stat.pid) {
+                            if task.rss_pages > 0 && task.last_switch_ns > stat.last_update_ns {
+                                stat.rss_bytes = task.rss_bytes(page_size);
+                                stat.last_update_ns = task.last_switch_ns;
+                            }
+                        }
+                        memory_stats.push(stat);
                     }
                 }
                 Err(e) => {
@@ -4650,143 +5854,260 @@ impl EbpfMetricsCollector {
         }
     }
 
+    /// Прочитать снимок общей записи планировщика
+    ///
+    /// При ошибке чтения или незагруженной программе возвращает пустую таблицу:
+    /// коллекторы продолжают работу без данных планировщика.
+    #[cfg(feature = "ebpf")]
+    fn collect_sched_task_table(&self) -> SchedTaskTable {
+        let mut records = Vec::new();
+        for map in &self.sched_maps {
+            match iterate_ebpf_map_keys::<RawSchedTaskStats>(map, 20480) {
+                Ok(mut stats) => records.append(&mut stats),
+                Err(e) => {
+                    tracing::error!("Ошибка при итерации по карте планировщика: {}", e);
+                }
+            }
+        }
+        SchedTaskTable::from_records(records)
+    }
+
+    /// Прочитать счётчики процессов общей программы системных вызовов
+    ///
+    /// При ошибке чтения или незагруженной программе возвращает пустую таблицу.
+    #[cfg(feature = "ebpf")]
+    fn collect_syscall_process_table(
+        &self,
+    ) -> std::collections::HashMap<u32, RawSyscallProcessStats> {
+        let Some(map) = &self.syscall_process_map else {
+            return std::collections::HashMap::new();
+        };
+
+        match iterate_ebpf_map_entries::<u32, RawSyscallProcessStats>(
+            map,
+            ebpf_batch::MIN_BATCH_ENTRIES,
+        ) {
+            Ok(entries) => reduce_process_stats(&entries),
+            Err(e) => {
+                tracing::error!("Ошибка при чтении счётчиков системных вызовов процессов: {}", e);
+                std::collections::HashMap::new()
+            }
+        }
+    }
+
+    /// Прочитать задержки памяти процессов программы `memory_pressure`
+    ///
+    /// При ошибке чтения или незагруженной программе возвращает пустую таблицу.
+    #[cfg(feature = "ebpf")]
+    fn collect_memory_stall_process_table(
+        &self,
+    ) -> std::collections::HashMap<u32, RawMemoryStallProcess> {
+        let Some(map) = &self.memory_stall_process_map else {
+            return std::collections::HashMap::new();
+        };
+
+        match iterate_ebpf_map_entries::<u32, RawMemoryStallProcess>(
+            map,
+            ebpf_batch::MIN_BATCH_ENTRIES,
+        ) {
+            Ok(entries) => reduce_process_stalls(&entries),
+            Err(e) => {
+                tracing::error!("Ошибка при чтении задержек памяти процессов: {}", e);
+                std::collections::HashMap::new()
+            }
+        }
+    }
+
+    /// Прочитать счётчики kmalloc/kfree процессов программы `kmem_allocations`
+    ///
+    /// При ошибке чтения или незагруженной программе возвращает пустую таблицу.
+    #[cfg(feature = "ebpf")]
+    fn collect_kmem_process_table(&self) -> std::collections::HashMap<u32, RawKmemCounters> {
+        let Some(map) = &self.kmem_process_map else {
+            return std::collections::HashMap::new();
+        };
+
+        match iterate_ebpf_map_entries::<u32, RawKmemCounters>(map, ebpf_batch::MIN_BATCH_ENTRIES) {
+            Ok(entries) => reduce_kmem_counters(&entries),
+            Err(e) => {
+                tracing::error!("Ошибка при чтении счётчиков выделений памяти ядра: {}", e);
+                std::collections::HashMap::new()
+            }
+        }
+    }
+
+    /// Собрать задержки из-за нехватки памяти по процессам и cgroup
+    ///
+    /// В каждом списке не больше `max_cached_details` записей с наибольшей
+    /// долей ожидания памяти с прошлого сбора.
+    #[cfg(feature = "ebpf")]
+    fn collect_memory_stall_stats(
+        &self,
+    ) -> (
+        Option<Vec<ProcessMemoryStallStat>>,
+        Option<Vec<CgroupMemoryStallStat>>,
+    ) {
+        if !self.config.enable_memory_pressure_monitoring {
+            return (None, None);
+        }
+
+        let processes = self.collect_memory_stall_process_table();
+        let cgroups = match &self.memory_stall_cgroup_map {
+            Some(map) => match iterate_ebpf_map_entries::<u64, RawMemoryStallCounters>(
+                map,
+                ebpf_batch::MIN_BATCH_ENTRIES,
+            ) {
+                Ok(entries) => entries
+                    .iter()
+                    .map(|(id, per_cpu)| (*id, RawMemoryStallCounters::merge_per_cpu(per_cpu)))
+                    .collect(),
+                Err(e) => {
+                    tracing::error!("Ошибка при чтении задержек памяти cgroup: {}", e);
+                    std::collections::HashMap::new()
+                }
+            },
+            None => std::collections::HashMap::new(),
+        };
+
+        let (process_stats, cgroup_stats) = self
+            .memory_stall_tracker
+            .lock()
+            .map(|mut tracker| {
+                tracker.sample(
+                    std::time::Instant::now(),
+                    &processes,
+                    &cgroups,
+                    self.max_cached_details,
+                )
+            })
+            .unwrap_or_default();
+
+        let process_stats = if process_stats.is_empty() {
+            None
+        } else {
+            Some(process_stats)
+        };
+        let cgroup_stats = if cgroup_stats.is_empty() {
+            None
+        } else {
+            Some(cgroup_stats)
+        };
+        (process_stats, cgroup_stats)
+    }
+
+    /// Собрать потребление ресурсов по cgroup v2
+    ///
+    /// Программы ведут итоги по cgroup в ядре, поэтому здесь только
+    /// складываются копии CPU каждой записи. Энергия делится между cgroup по
+    /// времени на CPU вслед за распределением энергии процессов. В списке не
+    /// больше `max_cached_details` cgroup с наибольшим временем на CPU.
+    #[cfg(feature = "ebpf")]
+    fn collect_cgroup_resource_stats(&self) -> Option<Vec<CgroupResourceStat>> {
+        let tables = CgroupTables {
+            sched: read_cgroup_table(self.sched_cgroup_map.as_ref(), "времени на CPU"),
+            disk: read_cgroup_table(self.disk_cgroup_map.as_ref(), "дисковых операций"),
+            network: read_cgroup_table(self.net_cgroup_map.as_ref(), "сетевого трафика"),
+            gpu: read_cgroup_table(self.gpu_cgroup_map.as_ref(), "времени GPU"),
+            performance: read_cgroup_table(self.app_cgroup_map.as_ref(), "производительности"),
+        };
+        let cgroup_ids = tables.cgroup_ids();
+        if cgroup_ids.is_empty() {
+            return None;
+        }
+
+        let energy = match (
+            self.energy_attributor.lock(),
+            self.cgroup_energy_attributor.lock(),
+        ) {
+            (Ok(processes), Ok(mut cgroups)) => {
+                let runtimes = tables
+                    .sched
+                    .iter()
+                    .map(|(id, stats)| (*id, stats.runtime_ns));
+                cgroups.follow(&*processes, runtimes).clone()
+            }
+            _ => std::collections::HashMap::new(),
+        };
+
+        let mut paths = self.cgroup_paths.lock().ok()?;
+        paths.refresh(std::time::Instant::now(), &cgroup_ids);
+        let stats = build_cgroup_stats(&tables, &energy, &paths, self.max_cached_details);
+        Some(stats)
+    }
+
     /// Собрать статистику производительности приложений из eBPF карт
     #[cfg(feature = "ebpf")]
     fn collect_application_performance_stats(
         &self,
     ) -> Result<Option<Vec<ApplicationPerformanceStat>>> {
-        use libbpf_rs::Map;
 
         if !self.config.enable_application_performance_monitoring {
             return Ok(None);
         }
 
+        let sched_tasks = self.collect_sched_task_table();
+        let mut syscall_stats = self.collect_syscall_process_table();
+
         // Пробуем получить доступ к картам производительности приложений
-        if self.application_performance_maps.is_empty() {
+        if self.application_performance_maps.is_empty()
+            && sched_tasks.is_empty()
+            && syscall_stats.is_empty()
+        {
             tracing::warn!("Карты производительности приложений не инициализированы");
             return Ok(None);
         }
 
         let mut performance_stats = Vec::new();
-
-        for map in &self.application_performance_maps {
-            // Используем функцию итерации по ключам для получения всех записей производительности
-            match iterate_ebpf_map_keys::<ApplicationPerformanceStat>(map, 20480) {
-                Ok(stats) => {
-                    for stat in stats {
-                        // Вычисляем проценты
-                        let total_time = stat.execution_time_ns
-                            + stat.io_wait_time_ns
-                            + stat.cpu_wait_time_ns
-                            + stat.lock_wait_time_ns
-                            + stat.network_wait_time_ns
-                            + stat.disk_wait_time_ns
-                            + stat.memory_wait_time_ns
-                            + stat.gpu_wait_time_ns
-                            + stat.other_wait_time_ns;
-
-                        let execution_percent = if total_time > 0 {
-                            (stat.execution_time_ns as f32 / total_time as f32) * 100.0
-                        } else {
-                            0.0
-                        };
-
-                        let wait_percent = 100.0 - execution_percent;
-
-                        let io_wait_percent = if total_time > 0 {
-                            (stat.io_wait_time_ns as f32 / total_time as f32) * 100.0
-                        } else {
-                            0.0
-                        };
-
-                        let cpu_wait_percent = if total_time > 0 {
-                            (stat.cpu_wait_time_ns as f32 / total_time as f32) * 100.0
-                        } else {
-                            0.0
-                        };
-
-                        let lock_wait_percent = if total_time > 0 {
-                            (stat.lock_wait_time_ns as f32 / total_time as f32) * 100.0
-                        } else {
-                            0.0
-                        };
-
-                        let network_wait_percent = if total_time > 0 {
-                            (stat.network_wait_time_ns as f32 / total_time as f32) * 100.0
-                        } else {
-                            0.0
-                        };
-
-                        let disk_wait_percent = if total_time > 0 {
-                            (stat.disk_wait_time_ns as f32 / total_time as f32) * 100.0
-                        } else {
-                            0.0
-                        };
-
-                        let memory_wait_percent = if total_time > 0 {
-                            (stat.memory_wait_time_ns as f32 / total_time as f32) * 100.0
-                        } else {
-                            0.0
-                        };
-
-                        let gpu_wait_percent = if total_time > 0 {
-                            (stat.gpu_wait_time_ns as f32 / total_time as f32) * 100.0
-                        } else {
-                            0.0
-                        };
-
-                        let other_wait_percent = if total_time > 0 {
-                            (stat.other_wait_time_ns as f32 / total_time as f32) * 100.0
-                        } else {
-                            0.0
-                        };
-
-                        performance_stats.push(ApplicationPerformanceStat {
-                            pid: stat.pid,
-                            tgid: stat.tgid,
-                            execution_time_ns: stat.execution_time_ns,
-                            io_wait_time_ns: stat.io_wait_time_ns,
-                            cpu_wait_time_ns: stat.cpu_wait_time_ns,
-                            lock_wait_time_ns: stat.lock_wait_time_ns,
-                            network_wait_time_ns: stat.network_wait_time_ns,
-                            disk_wait_time_ns: stat.disk_wait_time_ns,
-                            memory_wait_time_ns: stat.memory_wait_time_ns,
-                            gpu_wait_time_ns: stat.gpu_wait_time_ns,
-                            other_wait_time_ns: stat.other_wait_time_ns,
-                            total_time_ns: total_time,
-                            last_update_ns: stat.last_update_ns,
-                            cache_misses: stat.cache_misses,
-                            cache_hits: stat.cache_hits,
-                            branch_misses: stat.branch_misses,
-                            branch_hits: stat.branch_hits,
-                            page_faults: stat.page_faults,
-                            context_switches: stat.context_switches,
-                            system_calls: stat.system_calls,
-                            interrupts: stat.interrupts,
-                            memory_allocations: stat.memory_allocations,
-                            memory_frees: stat.memory_frees,
-                            name: stat.name.clone(),
-                            execution_percent,
-                            wait_percent,
-                            io_wait_percent,
-                            cpu_wait_percent,
-                            lock_wait_percent,
-                            network_wait_percent,
-                            disk_wait_percent,
-                            memory_wait_percent,
-                            gpu_wait_percent,
-                            other_wait_percent,
-                        });
-                    }
-                }
-                Err(e) => {
-                    tracing::error!(
-                        "Ошибка при итерации по карте производительности приложений: {}",
-                        e
-                    );
-                    continue;
+        let mut seen_tgids = std::collections::HashSet::new();
+
+        match read_task_state::<RawApplicationPerformanceStats>(
+            self.application_performance_program.as_ref(),
+            APPLICATION_PERFORMANCE_ITER,
+            &self.application_performance_maps,
+            20480,
+        ) {
+            Ok(stats) => {
+                for stat in stats.iter().filter(|stat| stat.tgid != 0) {
+                    seen_tgids.insert(stat.tgid);
+                    performance_stats.extend(ApplicationPerformanceStat::from_kernel(
+                        Some(stat),
+                        sched_tasks.get(stat.tgid),
+                        syscall_stats.remove(&stat.tgid).as_ref(),
+                    ));
                 }
             }
+            Err(e) => {
+                tracing::error!(
+                    "Ошибка при чтении записей производительности приложений: {}",
+                    e
+                );
+            }
+        }
+
+        // Процессы, у которых есть только данные планировщика и системных вызовов
+        for task in sched_tasks.iter().filter(|task| !seen_tgids.contains(&task.tgid)) {
+            performance_stats.extend(ApplicationPerformanceStat::from_kernel(
+                None,
+                Some(task),
+                syscall_stats.remove(&task.tgid).as_ref(),
+            ));
+        }
+        let mut syscall_only: Vec<_> = syscall_stats.into_iter().collect();
+        syscall_only.sort_unstable_by_key(|(tgid, _)| *tgid);
+        for (tgid, syscalls) in syscall_only {
+            performance_stats.extend(ApplicationPerformanceStat::from_syscalls(tgid, &syscalls));
+        }
+
+        // Ожидание памяти и kmalloc/kfree учитывают отдельные программы
+        let memory_stalls = self.collect_memory_stall_process_table();
+        let kmem_counters = self.collect_kmem_process_table();
+        for stat in &mut performance_stats {
+            if let Some(stalls) = memory_stalls.get(&stat.tgid) {
+                stat.apply_memory_stalls(stalls);
+            }
+            if let Some(kmem) = kmem_counters.get(&stat.tgid) {
+                stat.apply_kmem(kmem);
+            }
         }
 
         if performance_stats.is_empty() {
@@ -4797,60 +6118,35 @@ impl EbpfMetricsCollector {
     }
 
     /// Собрать количество операций с файловой системой из eBPF карт
+    ///
+    /// Общие итоги ведутся в обоих режимах программы.
     #[cfg(feature = "ebpf")]
     fn collect_filesystem_ops_from_maps(&self) -> Result<u64> {
-        use libbpf_rs::Map;
-
-        // Пробуем получить доступ к картам файловой системы
-        if self.filesystem_maps.is_empty() {
-            tracing::warn!(
-                "Карты файловой системы не инициализированы. 
-                 Проверьте, что модуль eBPF загружен и конфигурация enable_filesystem_monitoring включена."
-            );
+        let Some(map) = self.filesystem_maps.first() else {
             return Ok(0);
-        }
-
-        // Реальный сбор данных из карт файловой системы с использованием итерации по ключам
-        let mut total_ops = 0u64;
-        let mut error_count = 0;
-
-        for map in &self.filesystem_maps {
-            // Используем функцию итерации по ключам для получения всех данных о файловой системе
-            match iterate_ebpf_map_keys::<u64>(map, 8) {
-                Ok(fs_data) => {
-                    for ops in fs_data {
-                        total_ops += ops;
-                    }
-                }
-                Err(e) => {
-                    error_count += 1;
-                    tracing::error!(
-                        "Ошибка при итерации по карте файловой системы: {}. 
-                         Рекомендации: 1) Проверьте права доступа к eBPF картам, 2) Убедитесь, что ядро поддерживает eBPF, 3) Перезагрузите модуль eBPF",
-                        e
-                    );
-                    continue;
-                }
-            }
-        }
-
-        // Логируем количество ошибок, если они были
-        if error_count > 0 {
-            tracing::warn!(
-                "Обнаружено {} ошибок при сборе метрик файловой системы из {} карт",
-                error_count,
-                self.filesystem_maps.len()
-            );
-        }
+        };
 
-        Ok(total_ops)
+        let per_cpu = iterate_ebpf_map_keys::<RawFsIoCounters>(map, 1)
+            .context("Ошибка при чтении итогов файловых операций")?;
+        Ok(RawFsIoCounters::merge_per_cpu(&per_cpu).total_ops())
     }
 
     /// Собрать текущие метрики
+    ///
+    /// Возвращает копию метрик; потребителям, которые их не изменяют,
+    /// достаточно [`Self::collect_snapshot`].
     pub fn collect_metrics(&mut self) -> Result<EbpfMetrics> {
+        Ok(self.collect_snapshot()?.to_metrics())
+    }
+
+    /// Собрать текущие метрики как разделяемый снимок
+    ///
+    /// Попадание в кэш возвращает опубликованный снимок без копирования
+    /// метрик; новое поколение публикуется только после сбора из карт.
+    pub fn collect_snapshot(&mut self) -> Result<EbpfSnapshot> {
         if !self.initialized {
             tracing::warn!("eBPF метрики не инициализированы, возвращаем значения по умолчанию");
-            return Ok(EbpfMetrics::default());
+            return Ok(EbpfSnapshot::default());
         }
 
         // Проверяем, доступна ли eBPF функциональность
@@ -4867,8 +6163,14 @@ impl EbpfMetricsCollector {
 
                 // Если кэша нет, возвращаем значения по умолчанию с предупреждением
                 tracing::warn!("Нет кэшированных метрик, возвращаем значения по умолчанию");
-                return Ok(EbpfMetrics::default());
+                return Ok(EbpfSnapshot::default());
             }
+
+            // Прикрепление программ по запросу, подстройка выборки и отчёт о
+            // стоимости не зависят от кэширования метрик
+            self.apply_attachment_demand();
+            self.adapt_sampling_rates();
+            self.refresh_overhead_report();
         }
 
         // Оптимизация: агрессивное кэширование
@@ -4909,12 +6211,13 @@ impl EbpfMetricsCollector {
             // Сбор реальных метрик из eBPF программ с улучшенной обработкой ошибок
             match self.collect_real_ebpf_metrics() {
                 Ok(metrics) => {
-                    // Кэшируем метрики если включено кэширование
+                    let snapshot = EbpfSnapshot::new(metrics);
+                    // Кэшируем снимок если включено кэширование
                     if self.config.enable_caching {
-                        self.metrics_cache = Some(metrics.clone());
+                        self.metrics_cache = Some(snapshot.clone());
                         self.batch_counter = 1;
                     }
-                    return Ok(metrics);
+                    return Ok(snapshot);
                 }
                 Err(e) => {
                     tracing::error!(
@@ -4936,7 +6239,7 @@ impl EbpfMetricsCollector {
                     tracing::info!("Попытка сбора частичных метрик после основной ошибки");
                     if let Ok(partial_metrics) = self.collect_partial_metrics() {
                         tracing::warn!("Возвращаем частичные метрики. Некоторые данные могут быть устаревшими или отсутствовать");
-                        return Ok(partial_metrics);
+                        return Ok(partial_metrics.into());
                     }
 
                     // Если ничего не получилось, возвращаем значения по умолчанию
@@ -4948,7 +6251,7 @@ impl EbpfMetricsCollector {
                     // Логируем ошибку в систему мониторинга
                     self.log_ebpf_error(&e);
 
-                    return Ok(EbpfMetrics::default());
+                    return Ok(EbpfSnapshot::default());
                 }
             }
         }
@@ -4959,7 +6262,7 @@ impl EbpfMetricsCollector {
             tracing::info!(
                 "eBPF поддержка отключена на уровне компиляции, возвращаем значения по умолчанию"
             );
-            Ok(EbpfMetrics::default())
+            Ok(EbpfSnapshot::default())
         }
     }
 
@@ -5422,10 +6725,19 @@ impl EbpfMetricsCollector {
     fn perform_memory_cleanup(&mut self) {
         tracing::debug!("Выполнение очистки памяти eBPF");
 
-        // Очистка кэша метрик если он слишком большой
-        if let Some(cached_metrics) = &self.metrics_cache {
+        // Очистка кэша метрик если он слишком большой; опубликованный снимок
+        // не изменяется, урезанные метрики публикуются новым поколением
+        let limit = self.max_cached_details;
+        let exceeds = |len: Option<usize>| len.is_some_and(|len| len > limit);
+        let oversized = self.metrics_cache.as_ref().is_some_and(|cached| {
+            exceeds(cached.syscall_details.as_ref().map(Vec::len))
+                || exceeds(cached.network_details.as_ref().map(Vec::len))
+                || exceeds(cached.gpu_details.as_ref().map(Vec::len))
+                || exceeds(cached.filesystem_details.as_ref().map(Vec::len))
+        });
+        if let Some(cached_metrics) = self.metrics_cache.as_ref().filter(|_| oversized) {
             // Ограничиваем количество детализированных статистик
-            let mut optimized_metrics = cached_metrics.clone();
+            let mut optimized_metrics = cached_metrics.to_metrics();
 
             // Ограничиваем количество системных вызовов
             if let Some(mut syscall_details) = optimized_metrics.syscall_details {
@@ -5476,7 +6788,7 @@ impl EbpfMetricsCollector {
             }
 
             // Обновляем кэш с оптимизированными метриками
-            self.metrics_cache = Some(optimized_metrics);
+            self.metrics_cache = Some(optimized_metrics.into());
         }
 
         // Очистка неиспользуемых eBPF карт
@@ -5688,6 +7000,350 @@ impl EbpfMetricsCollector {
             "Установлена новая конфигурация фильтрации: {:?}",
             self.filter_config
         );
+        self.refresh_kernel_filters();
+    }
+
+    /// Содержимое карт фильтров ядра для текущей конфигурации.
+    ///
+    /// В ядро передаются фильтры по PID, cgroup и номеру системного вызова;
+    /// cgroup, путь которой не удалось разрешить, пропускается.
+    pub fn kernel_filter_set(&self) -> KernelFilterSet {
+        let config = &self.filter_config;
+        let pids = config
+            .enable_pid_filtering
+            .then_some(config.filtered_pids.as_slice());
+        let syscalls = config
+            .enable_syscall_type_filtering
+            .then_some(config.filtered_syscall_types.as_slice());
+        let cgroup_ids = config.enable_cgroup_filtering.then(|| {
+            config
+                .filtered_cgroups
+                .iter()
+                .filter_map(|cgroup| {
+                    match resolve_cgroup_id(std::path::Path::new(DEFAULT_CGROUP_ROOT), cgroup) {
+                        Ok(id) => Some(id),
+                        Err(e) => {
+                            tracing::warn!(
+                                "Не удалось определить идентификатор cgroup {}: {}. Cgroup не будет учтена фильтром",
+                                cgroup,
+                                e
+                            );
+                            None
+                        }
+                    }
+                })
+                .collect::<Vec<u64>>()
+        });
+
+        KernelFilterSet::new(pids, cgroup_ids.as_deref(), syscalls)
+    }
+
+    /// Передать фильтры в загруженные программы; ошибки только логируются
+    fn refresh_kernel_filters(&self) {
+        #[cfg(feature = "ebpf")]
+        {
+            if !self.initialized {
+                return;
+            }
+
+            if let Err(e) = self.sync_kernel_filters() {
+                tracing::error!(
+                    "Не удалось обновить фильтры в ядре: {}. События будут отфильтрованы только после сбора",
+                    e
+                );
+            }
+        }
+    }
+
+    /// Записать фильтры в карты всех загруженных объектов
+    #[cfg(feature = "ebpf")]
+    fn sync_kernel_filters(&self) -> Result<()> {
+        let filters = self.kernel_filter_set();
+        let mut updated = 0;
+
+        for program in self.loaded_programs() {
+            if write_kernel_filters(program, &filters)? {
+                updated += 1;
+            }
+        }
+
+        tracing::info!(
+            "Фильтры ядра (флаги {:#x}) записаны в {} eBPF объектов",
+            filters.raw_config().flags,
+            updated
+        );
+        Ok(())
+    }
+
+    /// Запустить агрегацию счётчиков по эпохам поверх загруженных программ
+    /// планировщика и сетевого трафика процессов
+    fn start_epoch_aggregation(&mut self) {
+        #[cfg(feature = "ebpf")]
+        {
+            if !self.initialized
+                || !self.config.enable_epoch_aggregation
+                || self.epoch_aggregator.is_some()
+                || (self.sched_program.is_none() && self.process_network_program.is_none())
+            {
+                return;
+            }
+            if !is_program_embedded(super::ebpf_epoch::EPOCH_AGGREGATOR_OBJECT) {
+                tracing::warn!("eBPF программа агрегации по эпохам не встроена");
+                return;
+            }
+
+            match EpochAggregator::start(
+                self.sched_program.as_deref(),
+                self.process_network_program.as_deref(),
+                self.config.epoch_interval_ms,
+            ) {
+                Ok(aggregator) => {
+                    self.epoch_aggregator = Some(aggregator);
+                    // Таймер читает карты источников: откреплённый источник дал бы нулевые приращения
+                    self.subscribe_metric_groups(
+                        EPOCH_AGGREGATION_CONSUMER,
+                        &[EbpfMetricGroup::Epoch],
+                    );
+                }
+                Err(e) => tracing::warn!(
+                    "Не удалось запустить агрегацию eBPF счётчиков по эпохам: {}. Сводки эпох будут недоступны, сбор продолжится через обход карт",
+                    e
+                ),
+            }
+        }
+    }
+
+    /// Включить учёт времени выполнения программ для адаптивной выборки и отчёта о стоимости
+    fn start_run_time_stats(&mut self) {
+        #[cfg(feature = "ebpf")]
+        {
+            if !self.initialized
+                || !(self.config.enable_adaptive_sampling || self.config.enable_overhead_stats)
+                || self.bpf_stats_fd.is_some()
+            {
+                return;
+            }
+
+            match enable_run_time_stats() {
+                Ok(fd) => {
+                    self.bpf_stats_fd = Some(fd);
+                    self.last_sampling_adjust = None;
+                    tracing::info!("Учёт времени выполнения eBPF программ включён");
+                    if self.config.enable_adaptive_sampling {
+                        tracing::info!(
+                            "Адаптивная выборка eBPF включена (бюджет {:.2}% CPU на класс событий, коэффициент до {})",
+                            self.config.sampling_cpu_budget_percent,
+                            self.config.max_sampling_rate
+                        );
+                    }
+                }
+                // Учёт может быть уже включён через sysctl kernel.bpf_stats_enabled
+                Err(e) => tracing::warn!(
+                    "Не удалось включить учёт времени выполнения eBPF программ: {}. Без kernel.bpf_stats_enabled выборка останется полной, а время программ — нулевым",
+                    e
+                ),
+            }
+        }
+    }
+
+    /// Подстроить коэффициенты выборки по стоимости программ за прошедший интервал
+    #[cfg(feature = "ebpf")]
+    fn adapt_sampling_rates(&mut self) {
+        if !self.config.enable_adaptive_sampling {
+            return;
+        }
+
+        let now = std::time::Instant::now();
+        let elapsed = match self.last_sampling_adjust {
+            Some(last) if now.duration_since(last) < SAMPLING_ADJUST_INTERVAL => return,
+            Some(last) => now.duration_since(last),
+            None => Duration::ZERO,
+        };
+        self.last_sampling_adjust = Some(now);
+
+        let program_stats: Vec<_> = self
+            .loaded_programs()
+            .flat_map(|program| program.program_runtime_stats())
+            .collect();
+        let totals = aggregate_by_class(
+            program_stats
+                .iter()
+                .map(|(name, stats)| (name.as_str(), *stats)),
+        );
+
+        let num_cpus = num_cpus::get();
+        let mut changed = false;
+        for class in SamplingClass::ALL {
+            let Some(stats) = totals.get(&class) else {
+                continue;
+            };
+            if let Some(rate) = self.sampler.observe(class, *stats, elapsed, num_cpus) {
+                tracing::info!("Коэффициент выборки {} изменён на {}", class.name(), rate);
+                changed = true;
+            }
+        }
+        if !changed {
+            return;
+        }
+
+        // Таблица пишется целиком, чтобы объекты, загруженные позже, получили все коэффициенты
+        let rates: Vec<_> = SamplingClass::ALL
+            .iter()
+            .map(|&class| (class, self.sampler.rate(class)))
+            .collect();
+        for program in self.loaded_programs() {
+            if let Err(e) = write_sampling_rates(program, &rates) {
+                tracing::warn!(
+                    "Не удалось обновить выборку в объекте {}: {}",
+                    program.name(),
+                    e
+                );
+            }
+        }
+    }
+
+    /// Пересобрать отчёт о стоимости программ, если с прошлой сборки прошёл интервал
+    #[cfg(feature = "ebpf")]
+    fn refresh_overhead_report(&mut self) {
+        if !self.config.enable_overhead_stats {
+            self.overhead_report = None;
+            return;
+        }
+
+        let now = std::time::Instant::now();
+        if let Some(last) = self.last_overhead_report {
+            if now.duration_since(last) < OVERHEAD_REPORT_INTERVAL {
+                return;
+            }
+        }
+        self.last_overhead_report = Some(now);
+
+        let mut report = EbpfOverheadReport {
+            run_time_stats_enabled: self.bpf_stats_fd.is_some() || sysctl_run_time_stats_enabled(),
+            sampling: self.sampler.snapshot(),
+            ..EbpfOverheadReport::default()
+        };
+
+        for object in self.loaded_programs() {
+            report.programs.extend(
+                object
+                    .program_runtime_stats()
+                    .into_iter()
+                    .map(|(name, stats)| EbpfProgramOverhead::new(object.name(), &name, stats)),
+            );
+            report.maps.extend(object.map_usage());
+
+            match object.map_handle(DEBUG_MAP_NAME) {
+                Ok(Some(map)) => match read_percpu_counters_by_key::<u32>(&map, DEBUG_SLOTS) {
+                    Ok(totals) => {
+                        let slots: Vec<u64> = (0..DEBUG_SLOTS as u32)
+                            .map(|slot| totals.get(&slot).copied().unwrap_or(0))
+                            .collect();
+                        report
+                            .debug_counters
+                            .push(EbpfDebugCounters::from_slots(object.name(), &slots));
+                    }
+                    Err(e) => tracing::debug!(
+                        "Не удалось прочитать отладочные счётчики объекта {}: {}",
+                        object.name(),
+                        e
+                    ),
+                },
+                Ok(None) => {}
+                Err(e) => tracing::debug!("{}", e),
+            }
+        }
+
+        report.sort();
+        if let Some(hottest) = report.programs.first() {
+            tracing::debug!(
+                "Самая дорогая eBPF программа: {}/{} ({} нс за {} запусков)",
+                hottest.object,
+                hottest.program,
+                hottest.run_time_ns,
+                hottest.run_cnt
+            );
+        }
+        self.overhead_report = Some(report);
+    }
+
+    /// Последний отчёт о стоимости eBPF программ и заполнении карт
+    pub fn overhead_report(&self) -> Option<EbpfOverheadReport> {
+        #[cfg(feature = "ebpf")]
+        {
+            self.overhead_report.clone()
+        }
+        #[cfg(not(feature = "ebpf"))]
+        {
+            None
+        }
+    }
+
+    /// Текущие коэффициенты адаптивной выборки и измеренная стоимость классов событий
+    pub fn sampling_state(&self) -> Vec<SamplingClassState> {
+        #[cfg(feature = "ebpf")]
+        {
+            self.sampler.snapshot()
+        }
+        #[cfg(not(feature = "ebpf"))]
+        {
+            Vec::new()
+        }
+    }
+
+    /// Загруженный объект, который прикрепляется для программы `role`
+    ///
+    /// CPU и память системы собираются из одного объекта `cpu_metrics`.
+    #[cfg(feature = "ebpf")]
+    fn role_program(&self, role: EbpfProgramRole) -> Option<&Program> {
+        match role {
+            EbpfProgramRole::CpuMetrics => {
+                self.cpu_program.as_ref().or(self.memory_program.as_ref())
+            }
+            EbpfProgramRole::CpuTemperature => self.cpu_temperature_program.as_ref(),
+            EbpfProgramRole::Syscalls => self.syscall_program.as_ref(),
+            EbpfProgramRole::Network => self.network_program.as_ref(),
+            EbpfProgramRole::NetworkConnections => self.network_connections_program.as_ref(),
+            EbpfProgramRole::Gpu => self.gpu_program.as_ref(),
+            EbpfProgramRole::Filesystem => self.filesystem_program.as_ref(),
+            EbpfProgramRole::ProcessMonitor => self.process_monitoring_program.as_ref(),
+            EbpfProgramRole::ProcessGpu => self.process_gpu_program.as_ref(),
+            EbpfProgramRole::ProcessNetwork => self.process_network_program.as_ref(),
+            EbpfProgramRole::ProcessDisk => self.process_disk_program.as_ref(),
+            EbpfProgramRole::ProcessMemory => self.process_memory_program.as_ref(),
+            EbpfProgramRole::Scheduler => self.sched_program.as_ref(),
+            EbpfProgramRole::ApplicationPerformance => {
+                self.application_performance_program.as_ref()
+            }
+            EbpfProgramRole::MemoryPressure => self.memory_pressure_program.as_ref(),
+            EbpfProgramRole::Kmem => self.kmem_program.as_ref(),
+        }
+    }
+
+    /// Все загруженные eBPF объекты
+    #[cfg(feature = "ebpf")]
+    fn loaded_programs(&self) -> impl Iterator<Item = &Program> {
+        [
+            &self.cpu_program,
+            &self.memory_program,
+            &self.syscall_program,
+            &self.network_program,
+            &self.network_connections_program,
+            &self.process_monitoring_program,
+            &self.process_gpu_program,
+            &self.process_network_program,
+            &self.process_disk_program,
+            &self.process_memory_program,
+            &self.gpu_program,
+            &self.cpu_temperature_program,
+            &self.filesystem_program,
+            &self.application_performance_program,
+            &self.sched_program,
+            &self.memory_pressure_program,
+            &self.kmem_program,
+        ]
+        .into_iter()
+        .flatten()
     }
 
     /// Применить фильтрацию к собранным метрикам
@@ -5882,6 +7538,10 @@ impl EbpfMetricsCollector {
                             bytes: 0,
                             start_time: 0,
                             last_activity: 0,
+                            family: 0,
+                            src_addr: None,
+                            dst_addr: None,
+                            tgid: 0,
                         });
                     entry.packets += stat.packets;
                     entry.bytes += stat.bytes;
@@ -5907,6 +7567,7 @@ impl EbpfMetricsCollector {
             enable,
             pids
         );
+        self.refresh_kernel_filters();
     }
 
     /// Установить фильтрацию по типам системных вызовов
@@ -5918,6 +7579,19 @@ impl EbpfMetricsCollector {
             enable,
             syscall_types
         );
+        self.refresh_kernel_filters();
+    }
+
+    /// Установить фильтрацию по cgroup v2 (пути относительно /sys/fs/cgroup)
+    pub fn set_cgroup_filtering(&mut self, enable: bool, cgroups: Vec<String>) {
+        self.filter_config.enable_cgroup_filtering = enable;
+        self.filter_config.filtered_cgroups = cgroups.clone();
+        tracing::info!(
+            "Установлена фильтрация по cgroup: {} (cgroup: {:?})",
+            enable,
+            cgroups
+        );
+        self.refresh_kernel_filters();
     }
 
     /// Установить фильтрацию по сетевым протоколам
@@ -6457,6 +8131,25 @@ mod tests {
             enable_aggressive_caching: false,
             aggressive_cache_interval_ms: 5000,
             filter_config: EbpfFilterConfig::default(),
+            enable_ringbuf_events: false,
+            ringbuf_wakeup_threshold_bytes: 4096,
+            ringbuf_poll_timeout_ms: 100,
+            syscall_latency_app_syscalls: Vec::new(),
+            enable_adaptive_sampling: true,
+            sampling_cpu_budget_percent: 1.0,
+            max_sampling_rate: 64,
+            enable_overhead_stats: true,
+            process_memory_rss_delta_kb: 1024,
+            filesystem_mode: FilesystemMonitorMode::Detailed,
+            enable_memory_pressure_monitoring: false,
+            enable_kmem_allocation_tracking: false,
+            enable_runqueue_latency_fast_path: false,
+            runqueue_latency_threshold_us: 5_000,
+            runqueue_latency_min_interval_ms: 50,
+            demand_driven_attachment: false,
+            attachment_idle_timeout_secs: 300,
+            enable_epoch_aggregation: false,
+            epoch_interval_ms: 1000,
         };
 
         // Тестируем сериализацию и десериализацию
@@ -6517,6 +8210,17 @@ mod tests {
             process_network_details: None,
             process_disk_details: None,
             process_memory_details: None,
+            lifecycle_events: None,
+            syscall_latency_details: None,
+            program_overhead: None,
+            socket_traffic_details: None,
+            disk_latency_details: None,
+            disk_queue_details: None,
+            filesystem_process_details: None,
+            memory_stall_details: None,
+            cgroup_memory_stall_details: None,
+            cgroup_resource_details: None,
+            epoch_summaries: None,
         };
 
         // Тестируем сериализацию и десериализацию
@@ -6878,6 +8582,25 @@ mod tests {
             enable_aggressive_caching: false,
             aggressive_cache_interval_ms: 5000,
             filter_config: EbpfFilterConfig::default(),
+            enable_ringbuf_events: false,
+            ringbuf_wakeup_threshold_bytes: 4096,
+            ringbuf_poll_timeout_ms: 100,
+            syscall_latency_app_syscalls: Vec::new(),
+            enable_adaptive_sampling: true,
+            sampling_cpu_budget_percent: 1.0,
+            max_sampling_rate: 64,
+            enable_overhead_stats: true,
+            process_memory_rss_delta_kb: 1024,
+            filesystem_mode: FilesystemMonitorMode::Detailed,
+            enable_memory_pressure_monitoring: false,
+            enable_kmem_allocation_tracking: false,
+            enable_runqueue_latency_fast_path: false,
+            runqueue_latency_threshold_us: 5_000,
+            runqueue_latency_min_interval_ms: 50,
+            demand_driven_attachment: false,
+            attachment_idle_timeout_secs: 300,
+            enable_epoch_aggregation: false,
+            epoch_interval_ms: 1000,
         };
 
         // Тестируем сериализацию и десериализацию
@@ -6943,6 +8666,17 @@ mod tests {
             process_network_details: None,
             process_disk_details: None,
             process_memory_details: None,
+            lifecycle_events: None,
+            syscall_latency_details: None,
+            program_overhead: None,
+            socket_traffic_details: None,
+            disk_latency_details: None,
+            disk_queue_details: None,
+            filesystem_process_details: None,
+            memory_stall_details: None,
+            cgroup_memory_stall_details: None,
+            cgroup_resource_details: None,
+            epoch_summaries: None,
         };
 
         // Тестируем сериализацию и десериализацию
@@ -7016,14 +8750,10 @@ mod tests {
         if let Some(filesystem_details) = metrics.filesystem_details {
             assert!(!filesystem_details.is_empty());
 
-            // Проверяем, что статистика имеет разумные значения
+            // В список попадают только пары (файл, процесс) с операциями
             for fs_stat in filesystem_details {
-                assert!(fs_stat.read_count > 0);
-                assert!(fs_stat.write_count > 0);
-                assert!(fs_stat.open_count > 0);
-                assert!(fs_stat.close_count > 0);
-                assert!(fs_stat.bytes_read > 0);
-                assert!(fs_stat.bytes_written > 0);
+                assert!(fs_stat.read_count + fs_stat.write_count + fs_stat.open_count > 0);
+                assert!(!fs_stat.device.is_empty());
             }
         }
     }
@@ -7057,6 +8787,25 @@ mod tests {
             enable_aggressive_caching: false,
             aggressive_cache_interval_ms: 5000,
             filter_config: EbpfFilterConfig::default(),
+            enable_ringbuf_events: false,
+            ringbuf_wakeup_threshold_bytes: 4096,
+            ringbuf_poll_timeout_ms: 100,
+            syscall_latency_app_syscalls: Vec::new(),
+            enable_adaptive_sampling: true,
+            sampling_cpu_budget_percent: 1.0,
+            max_sampling_rate: 64,
+            enable_overhead_stats: true,
+            process_memory_rss_delta_kb: 1024,
+            filesystem_mode: FilesystemMonitorMode::Detailed,
+            enable_memory_pressure_monitoring: false,
+            enable_kmem_allocation_tracking: false,
+            enable_runqueue_latency_fast_path: false,
+            runqueue_latency_threshold_us: 5_000,
+            runqueue_latency_min_interval_ms: 50,
+            demand_driven_attachment: false,
+            attachment_idle_timeout_secs: 300,
+            enable_epoch_aggregation: false,
+            epoch_interval_ms: 1000,
         };
 
         // Тестируем сериализацию и десериализацию
@@ -7126,6 +8875,17 @@ mod tests {
             process_network_details: None,
             process_disk_details: None,
             process_memory_details: None,
+            lifecycle_events: None,
+            syscall_latency_details: None,
+            program_overhead: None,
+            socket_traffic_details: None,
+            disk_latency_details: None,
+            disk_queue_details: None,
+            filesystem_process_details: None,
+            memory_stall_details: None,
+            cgroup_memory_stall_details: None,
+            cgroup_resource_details: None,
+            epoch_summaries: None,
         };
 
         // Тестируем сериализацию и десериализацию
@@ -7288,6 +9048,28 @@ mod tests {
         assert!(collector.get_last_error().is_none());
     }
 
+    #[test]
+    fn test_cached_snapshot_is_shared() {
+        let config = EbpfConfig {
+            enable_caching: true,
+            batch_size: 100,
+            ..Default::default()
+        };
+        let mut collector = EbpfMetricsCollector::new(config);
+        let published = EbpfSnapshot::new(EbpfMetrics {
+            cpu_usage: 12.5,
+            ..Default::default()
+        });
+        collector.initialized = true;
+        collector.metrics_cache = Some(published.clone());
+
+        // Попадание в кэш возвращает тот же снимок, а не копию метрик
+        let snapshot = collector.collect_snapshot().unwrap();
+        assert!(snapshot.ptr_eq(&published));
+        assert_eq!(snapshot.generation(), published.generation());
+        assert_eq!(collector.collect_metrics().unwrap().cpu_usage, 12.5);
+    }
+
     #[test]
     fn test_ebpf_graceful_degradation() {
         // Тестируем graceful degradation при отсутствии eBPF поддержки
@@ -7515,7 +9297,6 @@ mod tests {
         // Тестируем новую функцию итерации по ключам eBPF карт
         #[cfg(feature = "ebpf")]
         {
-            use libbpf_rs::Map;
 
             // Создаем тестовую карту (в реальности это будет mock)
             // Для теста просто проверяем, что функция компилируется и работает
@@ -7809,6 +9590,25 @@ mod tests {
             enable_aggressive_caching: false,
             filter_config: EbpfFilterConfig::default(),
             aggressive_cache_interval_ms: 5000,
+            enable_ringbuf_events: false,
+            ringbuf_wakeup_threshold_bytes: 4096,
+            ringbuf_poll_timeout_ms: 100,
+            syscall_latency_app_syscalls: Vec::new(),
+            enable_adaptive_sampling: true,
+            sampling_cpu_budget_percent: 1.0,
+            max_sampling_rate: 64,
+            enable_overhead_stats: true,
+            process_memory_rss_delta_kb: 1024,
+            filesystem_mode: FilesystemMonitorMode::Detailed,
+            enable_memory_pressure_monitoring: false,
+            enable_kmem_allocation_tracking: false,
+            enable_runqueue_latency_fast_path: false,
+            runqueue_latency_threshold_us: 5_000,
+            runqueue_latency_min_interval_ms: 50,
+            demand_driven_attachment: false,
+            attachment_idle_timeout_secs: 300,
+            enable_epoch_aggregation: false,
+            epoch_interval_ms: 1000,
         };
 
         let mut collector = EbpfMetricsCollector::new(config);
@@ -7873,6 +9673,25 @@ mod tests {
             filter_config: EbpfFilterConfig::default(),
             enable_aggressive_caching: false,
             aggressive_cache_interval_ms: 5000,
+            enable_ringbuf_events: false,
+            ringbuf_wakeup_threshold_bytes: 4096,
+            ringbuf_poll_timeout_ms: 100,
+            syscall_latency_app_syscalls: Vec::new(),
+            enable_adaptive_sampling: true,
+            sampling_cpu_budget_percent: 1.0,
+            max_sampling_rate: 64,
+            enable_overhead_stats: true,
+            process_memory_rss_delta_kb: 1024,
+            filesystem_mode: FilesystemMonitorMode::Detailed,
+            enable_memory_pressure_monitoring: false,
+            enable_kmem_allocation_tracking: false,
+            enable_runqueue_latency_fast_path: false,
+            runqueue_latency_threshold_us: 5_000,
+            runqueue_latency_min_interval_ms: 50,
+            demand_driven_attachment: false,
+            attachment_idle_timeout_secs: 300,
+            enable_epoch_aggregation: false,
+            epoch_interval_ms: 1000,
         };
 
         let mut collector = EbpfMetricsCollector::new(config);
@@ -7917,6 +9736,25 @@ mod tests {
             enable_notifications: false, // Отключаем уведомления для этого теста
             notification_thresholds: EbpfNotificationThresholds::default(),
             filter_config: EbpfFilterConfig::default(),
+            enable_ringbuf_events: false,
+            ringbuf_wakeup_threshold_bytes: 4096,
+            ringbuf_poll_timeout_ms: 100,
+            syscall_latency_app_syscalls: Vec::new(),
+            enable_adaptive_sampling: true,
+            sampling_cpu_budget_percent: 1.0,
+            max_sampling_rate: 64,
+            enable_overhead_stats: true,
+            process_memory_rss_delta_kb: 1024,
+            filesystem_mode: FilesystemMonitorMode::Detailed,
+            enable_memory_pressure_monitoring: false,
+            enable_kmem_allocation_tracking: false,
+            enable_runqueue_latency_fast_path: false,
+            runqueue_latency_threshold_us: 5_000,
+            runqueue_latency_min_interval_ms: 50,
+            demand_driven_attachment: false,
+            attachment_idle_timeout_secs: 300,
+            enable_epoch_aggregation: false,
+            epoch_interval_ms: 1000,
         };
 
         let mut collector = EbpfMetricsCollector::new(config);
@@ -8530,6 +10368,28 @@ mod ebpf_filtering_tests {
         }
     }
 
+    #[test]
+    fn test_kernel_filter_set() {
+        let config = EbpfConfig::default();
+        let mut collector = EbpfMetricsCollector::new(config);
+
+        // По умолчанию фильтры ядра выключены
+        assert!(!collector.kernel_filter_set().is_active());
+
+        collector.set_pid_filtering(true, vec![200, 100, 200]);
+        collector.set_syscall_type_filtering(true, vec![202]);
+        // Несуществующая cgroup пропускается, а без разрешённых cgroup фильтр выключен
+        collector.set_cgroup_filtering(true, vec!["smoothtask-missing.slice".to_string()]);
+
+        let filters = collector.kernel_filter_set();
+        assert_eq!(filters.pids, Some(vec![100, 200]));
+        assert_eq!(filters.syscalls, Some(vec![202]));
+        assert!(filters.cgroup_ids.is_none());
+
+        collector.set_pid_filtering(false, vec![100]);
+        assert!(collector.kernel_filter_set().pids.is_none());
+    }
+
     #[test]
     fn test_set_filtering_thresholds() {
         let config = EbpfConfig::default();
@@ -8887,6 +10747,10 @@ mod ebpf_memory_optimization_tests {
                 bytes: 1000,
                 start_time: 0,
                 last_activity: 0,
+                family: 0,
+                src_addr: None,
+                dst_addr: None,
+                tgid: 0,
             });
         }
 
@@ -9595,7 +11459,7 @@ fn test_comprehensive_gpu_monitoring() {
 
 #[test]
 fn test_gpu_program_selection() {
-    // Тест проверяет выбор оптимальной eBPF программы для GPU мониторинга
+    // Тест проверяет загрузку единственной eBPF программы для GPU мониторинга
     let config = EbpfConfig {
         enable_gpu_monitoring: true,
         ..Default::default()
@@ -9606,17 +11470,10 @@ fn test_gpu_program_selection() {
     // Проверяем, что программа загружается корректно
     assert!(collector.initialize().is_ok());
 
-    // Проверяем, что программа выбрана в зависимости от доступности
+    // Варианты программы убраны: встроенная gpu_monitor загружается всегда
     #[cfg(feature = "ebpf")]
     {
-        if std::path::Path::new("src/ebpf_programs/gpu_monitor_comprehensive.c").exists() {
-            // Должна быть выбрана комплексная программа
-            assert!(
-                collector.gpu_program.is_some(),
-                "Должна быть загружена eBPF программа для GPU"
-            );
-        } else if std::path::Path::new("src/ebpf_programs/gpu_monitor_high_perf.c").exists() {
-            // Должна быть выбрана высокопроизводительная программа
+        if is_program_embedded(GPU_PROGRAM) {
             assert!(
                 collector.gpu_program.is_some(),
                 "Должна быть загружена eBPF программа для GPU"
@@ -9840,6 +11697,277 @@ mod test_application_performance {
         assert_eq!(deserialized.wait_percent, 69.7);
     }
 
+    #[test]
+    fn test_raw_application_performance_layout() {
+        // Раскладка должна совпадать со struct application_performance_stats в ядре
+        assert_eq!(std::mem::size_of::<RawApplicationPerformanceStats>(), 3 * 8 + 8 + 16);
+        assert_eq!(std::mem::align_of::<RawApplicationPerformanceStats>(), 8);
+    }
+
+    #[test]
+    fn test_connection_stat_from_record() {
+        use crate::metrics::ebpf_net::{AF_INET, AF_INET6};
+
+        let mut record = RawConnectionRecord {
+            family: AF_INET,
+            sport: 43210,
+            dport: 443,
+            protocol: 6,
+            state: 1,
+            tgid: 777,
+            packets: 3,
+            bytes: 9000,
+            ..Default::default()
+        };
+        record.saddr[..4].copy_from_slice(&[192, 168, 0, 2]);
+        record.daddr[..4].copy_from_slice(&[1, 1, 1, 1]);
+
+        let stat = ConnectionStat::from_record(&record);
+        assert_eq!(stat.src_ip, 0xC0A8_0002);
+        assert_eq!(stat.dst_ip, 0x0101_0101);
+        assert_eq!(stat.dst_port, 443);
+        assert_eq!(stat.bytes, 9000);
+        assert_eq!(stat.tgid, 777);
+        assert_eq!(stat.src_addr, Some("192.168.0.2".parse().unwrap()));
+
+        // IPv6 адреса доступны только в полных полях
+        let v6: std::net::Ipv6Addr = "2001:db8::2".parse().unwrap();
+        let record = RawConnectionRecord {
+            family: AF_INET6,
+            saddr: v6.octets(),
+            daddr: v6.octets(),
+            ..record
+        };
+        let stat = ConnectionStat::from_record(&record);
+        assert_eq!(stat.src_ip, 0);
+        assert_eq!(stat.family, AF_INET6);
+        assert_eq!(stat.dst_addr, Some(std::net::IpAddr::V6(v6)));
+    }
+
+    #[test]
+    fn test_process_stat_from_raw() {
+        let mut raw = RawProcessInfo {
+            tgid: 4242,
+            ppid: 1,
+            start_time: 1_000,
+            last_activity: 5_000,
+            ..Default::default()
+        };
+        raw.comm[..4].copy_from_slice(b"bash");
+
+        let stat = ProcessStat::from_raw(&raw);
+        assert_eq!(stat.pid, 4242);
+        assert_eq!(stat.ppid, 1);
+        // Запись ядра не содержит счётчиков: они приходят из общих программ
+        assert_eq!(stat.syscall_count, 0);
+        assert_eq!(stat.last_activity, 5_000);
+        assert_eq!(stat.name, "bash");
+    }
+
+    #[test]
+    fn test_process_memory_stat_from_raw() {
+        let mut raw = RawProcessMemoryStat {
+            pid: 4242,
+            tgid: 4242,
+            rss_pages: 256,
+            swap_pages: 16,
+            anon_pages: 200,
+            file_pages: 56,
+            heap_bytes: 65_536,
+            major_faults: 3,
+            ..Default::default()
+        };
+        raw.comm[..4].copy_from_slice(b"bash");
+
+        let stat = ProcessMemoryStat::from_raw(&raw, 4096);
+        assert_eq!(stat.rss_bytes, 1024 * 1024);
+        assert_eq!(stat.swap_bytes, 16 * 4096);
+        assert_eq!(stat.anonymous_memory, 200 * 4096);
+        // Куча хранится в байтах
+        assert_eq!(stat.heap_usage, 65_536);
+        assert_eq!(stat.major_faults, 3);
+        assert_eq!(stat.name, "bash");
+    }
+
+    #[test]
+    fn test_application_performance_from_kernel() {
+        let mut comm = [0u8; 16];
+        comm[..7].copy_from_slice(b"firefox");
+        let app = RawApplicationPerformanceStats {
+            tgid: 4242,
+            page_faults: 3,
+            comm,
+            ..Default::default()
+        };
+        let syscalls = RawSyscallProcessStats {
+            syscalls: 42,
+            lock_wait_ns: 500_000,
+            last_syscall_ns: 50,
+            ..Default::default()
+        };
+        let sched = RawSchedTaskStats {
+            tgid: 4242,
+            runtime_ns: 6_000_000,
+            runqueue_wait_ns: 1_000_000,
+            io_wait_ns: 1_000_000,
+            sleep_ns: 2_000_000,
+            context_switches: 12,
+            last_switch_ns: 99,
+            ..Default::default()
+        };
+
+        let stat =
+            ApplicationPerformanceStat::from_kernel(Some(&app), Some(&sched), Some(&syscalls))
+                .unwrap();
+        assert_eq!(stat.pid, 4242);
+        assert_eq!(stat.name, "firefox");
+        assert_eq!(stat.total_time_ns, 10_000_000);
+        assert_eq!(stat.context_switches, 12);
+        assert_eq!(stat.page_faults, 3);
+        assert_eq!(stat.system_calls, 42);
+        assert_eq!(stat.lock_wait_time_ns, 500_000);
+        assert_eq!(stat.last_update_ns, 99);
+        assert!((stat.execution_percent - 60.0).abs() < 1e-3);
+        assert!((stat.wait_percent - 40.0).abs() < 1e-3);
+        assert!((stat.cpu_wait_percent - 10.0).abs() < 1e-3);
+        assert!((stat.io_wait_percent - 10.0).abs() < 1e-3);
+        assert!((stat.lock_wait_percent - 5.0).abs() < 1e-3);
+        assert!((stat.other_wait_percent - 20.0).abs() < 1e-3);
+        assert_eq!(stat.disk_wait_percent, 0.0);
+    }
+
+    #[test]
+    fn test_application_performance_from_sched_only() {
+        let mut comm = [0u8; 16];
+        comm[..4].copy_from_slice(b"Xorg");
+        let sched = RawSchedTaskStats {
+            tgid: 7,
+            runtime_ns: 1_000,
+            comm,
+            ..Default::default()
+        };
+
+        let stat = ApplicationPerformanceStat::from_kernel(None, Some(&sched), None).unwrap();
+        assert_eq!(stat.name, "Xorg");
+        assert_eq!(stat.execution_percent, 100.0);
+        assert_eq!(stat.lock_wait_time_ns, 0);
+        assert!(ApplicationPerformanceStat::from_kernel(None, None, None).is_none());
+    }
+
+    #[test]
+    fn test_application_performance_from_syscalls_only() {
+        let mut syscalls = RawSyscallProcessStats {
+            syscalls: 7,
+            lock_wait_ns: 1_000,
+            last_syscall_ns: 123,
+            ..Default::default()
+        };
+        syscalls.comm[..4].copy_from_slice(b"sshd");
+
+        let stat = ApplicationPerformanceStat::from_syscalls(77, &syscalls).unwrap();
+        assert_eq!(stat.tgid, 77);
+        assert_eq!(stat.name, "sshd");
+        assert_eq!(stat.system_calls, 7);
+        assert_eq!(stat.lock_wait_time_ns, 1_000);
+        assert_eq!(stat.last_update_ns, 123);
+        assert_eq!(stat.total_time_ns, 0);
+
+        let process = ProcessStat::from_syscalls(77, &syscalls);
+        assert_eq!(process.pid, 77);
+        assert_eq!(process.name, "sshd");
+        assert_eq!(process.syscall_count, 7);
+        assert_eq!(process.last_activity, 123);
+    }
+
+    #[test]
+    fn test_active_processes_include_started_before_load() {
+        // 10 запущен после загрузки и делает системные вызовы, 20 — только exec,
+        // 30 запущен до загрузки и известен лишь по системным вызовам
+        let processes = [
+            RawProcessInfo {
+                tgid: 10,
+                last_activity: 5,
+                ..Default::default()
+            },
+            RawProcessInfo {
+                tgid: 20,
+                last_activity: 6,
+                ..Default::default()
+            },
+            RawProcessInfo {
+                tgid: 40,
+                ..Default::default()
+            },
+        ];
+        let syscalls: std::collections::HashMap<u32, RawSyscallProcessStats> =
+            [(10, 3), (30, 7), (50, 0)]
+                .into_iter()
+                .map(|(tgid, count)| {
+                    (
+                        tgid,
+                        RawSyscallProcessStats {
+                            syscalls: count,
+                            ..Default::default()
+                        },
+                    )
+                })
+                .collect();
+
+        assert_eq!(ProcessStat::count_active(&processes, &syscalls), 3);
+        assert_eq!(ProcessStat::count_active(&[], &syscalls), 2);
+    }
+
+    #[test]
+    fn test_application_performance_memory_wait() {
+        use crate::metrics::ebpf_memory_pressure::RawMemoryStallCounters;
+
+        let sched = RawSchedTaskStats {
+            tgid: 9,
+            runtime_ns: 6_000_000,
+            io_wait_ns: 4_000_000,
+            last_switch_ns: 50,
+            ..Default::default()
+        };
+        let mut stat = ApplicationPerformanceStat::from_kernel(None, Some(&sched), None).unwrap();
+        assert_eq!(stat.memory_wait_time_ns, 0);
+
+        let stalls = RawMemoryStallProcess {
+            stalls: RawMemoryStallCounters {
+                major_faults: 3,
+                major_fault_ns: 2_500_000,
+                stall_ns: 2_500_000,
+                ..Default::default()
+            },
+            last_stall_ns: 80,
+            ..Default::default()
+        };
+        stat.apply_memory_stalls(&stalls);
+        assert_eq!(stat.memory_wait_time_ns, 2_500_000);
+        assert!((stat.memory_wait_percent - 25.0).abs() < 0.001);
+        assert_eq!(stat.last_update_ns, 80);
+        // Ожидание памяти входит во время планировщика
+        assert_eq!(stat.total_time_ns, 10_000_000);
+
+        stat.apply_kmem(&RawKmemCounters {
+            allocations: 40,
+            frees: 32,
+        });
+        assert_eq!(stat.memory_allocations, 40);
+        assert_eq!(stat.memory_frees, 32);
+    }
+
+    #[test]
+    fn test_application_performance_without_samples() {
+        let app = RawApplicationPerformanceStats {
+            tgid: 1,
+            ..Default::default()
+        };
+        let stat = ApplicationPerformanceStat::from_kernel(Some(&app), None, None).unwrap();
+        assert_eq!(stat.execution_percent, 0.0);
+        assert_eq!(stat.wait_percent, 0.0);
+        assert_eq!(stat.name, "");
+    }
+
     #[test]
     fn test_application_performance_config() {
         // Тест проверяет, что конфигурация application_performance_monitoring корректно работает
@@ -0,0 +1,466 @@
+//! Пакетное чтение eBPF карт через `BPF_MAP_LOOKUP_BATCH`.
+//!
+//! Поэлементный обход карты (`get_next_key` + `lookup`) стоит два системных
+//! вызова на запись; для карт на 10–20 тысяч элементов это основная часть
+//! времени сбора метрик. Команда `BPF_MAP_LOOKUP_BATCH` (Linux 5.6+)
+//! возвращает сотни записей за один вызов в заранее выделенные буферы ключей
+//! и значений. Коллекторы читают накопительные счётчики и карты не
+//! дренируют, поэтому `BPF_MAP_LOOKUP_AND_DELETE_BATCH` не используется.
+//!
+//! Буферы [`MapBatchBuffer`] переиспользуются между вызовами (растут, но не
+//! сжимаются). Если ядро или тип карты не поддерживает пакетные команды,
+//! вызывающий код получает [`BatchStatus::Unsupported`] и переходит на
+//! поэлементный обход; неподдерживаемые типы карт запоминаются, чтобы не
+//! повторять заведомо неудачный системный вызов.
+
+use std::sync::atomic::{AtomicU64, Ordering};
+
+/// Минимальный размер пачки (записей за один системный вызов)
+pub const MIN_BATCH_ENTRIES: usize = 64;
+/// Максимальный размер пачки (записей за один системный вызов)
+pub const MAX_BATCH_ENTRIES: usize = 8192;
+
+/// Битовая маска типов карт, для которых пакетные команды не поддерживаются
+static UNSUPPORTED_MAP_TYPES: AtomicU64 = AtomicU64::new(0);
+
+/// Результат одного пакетного вызова
+#[derive(Debug, Clone, Copy, PartialEq, Eq)]
+pub enum BatchStatus {
+    /// Пачка прочитана, в карте есть ещё записи
+    More(u32),
+    /// Пачка прочитана, обход карты завершён
+    Done(u32),
+    /// Пакетные команды не поддерживаются (старое ядро или тип карты)
+    Unsupported,
+    /// Ошибка системного вызова (errno)
+    Error(i32),
+}
+
+/// Источник пакетных данных (карта ядра или ее имитация в тестах)
+pub trait BatchSource {
+    /// Прочитать следующую пачку.
+    ///
+    /// `in_batch` — курсор предыдущего вызова (`None` для первого),
+    /// `out_batch` — буфер для нового курсора, `count` — количество записей
+    /// на входе (ёмкость) и на выходе (прочитано).
+    fn lookup_batch(
+        &mut self,
+        in_batch: Option<&[u8]>,
+        out_batch: &mut [u8],
+        keys: &mut [u8],
+        values: &mut [u8],
+        count: &mut u32,
+    ) -> BatchStatus;
+}
+
+/// Переиспользуемые буферы для пакетного чтения карты
+#[derive(Debug, Default)]
+pub struct MapBatchBuffer {
+    keys: Vec<u8>,
+    values: Vec<u8>,
+    in_batch: Vec<u8>,
+    out_batch: Vec<u8>,
+    key_size: usize,
+    value_stride: usize,
+    capacity: usize,
+}
+
+impl MapBatchBuffer {
+    /// Создать пустой буфер
+    pub fn new() -> Self {
+        Self::default()
+    }
+
+    /// Подготовить буфер для карты с заданной раскладкой.
+    ///
+    /// `value_stride` — размер значения с учётом per-CPU (см. [`value_stride`]).
+    /// Память выделяется только при росте требований.
+    pub fn prepare(&mut self, key_size: usize, value_stride: usize, entries: usize) {
+        let entries = entries.clamp(MIN_BATCH_ENTRIES, MAX_BATCH_ENTRIES);
+        self.key_size = key_size;
+        self.value_stride = value_stride;
+        self.capacity = entries;
+
+        let keys_len = key_size * entries;
+        let values_len = value_stride * entries;
+        // Курсор хэш-карт — индекс бакета (u32), для остальных — ключ
+        let batch_len = key_size.max(8);
+
+        if self.keys.len() < keys_len {
+            self.keys.resize(keys_len, 0);
+        }
+        if self.values.len() < values_len {
+            self.values.resize(values_len, 0);
+        }
+        if self.in_batch.len() < batch_len {
+            self.in_batch.resize(batch_len, 0);
+            self.out_batch.resize(batch_len, 0);
+        }
+    }
+
+    /// Ёмкость пачки в записях
+    pub fn capacity(&self) -> usize {
+        self.capacity
+    }
+
+    /// Объём выделенной памяти в байтах
+    pub fn allocated_bytes(&self) -> usize {
+        self.keys.capacity()
+            + self.values.capacity()
+            + self.in_batch.capacity()
+            + self.out_batch.capacity()
+    }
+
+    /// Прочитать карту целиком пачками.
+    ///
+    /// Для каждой прочитанной пачки вызывается `on_batch(keys, values, count)`.
+    /// Возвращает `Err(BatchStatus::Unsupported)`, если ядро сообщило об
+    /// отсутствии поддержки, — тогда нужен поэлементный обход. Ошибка
+    /// возвращается и после уже прочитанных пачек: частично прочитанная карта
+    /// никогда не выдаётся за полную, и вызывающий код отбрасывает пачки,
+    /// переданные в `on_batch`.
+    pub fn drain<S, F>(&mut self, source: &mut S, mut on_batch: F) -> Result<usize, BatchStatus>
+    where
+        S: BatchSource,
+        F: FnMut(&[u8], &[u8], usize),
+    {
+        let mut total = 0usize;
+        let mut first = true;
+        let batch_len = self.key_size.max(8);
+
+        loop {
+            let mut count = self.capacity as u32;
+            let in_batch = if first {
+                None
+            } else {
+                Some(&self.in_batch[..batch_len])
+            };
+
+            let status = source.lookup_batch(
+                in_batch,
+                &mut self.out_batch[..batch_len],
+                &mut self.keys[..self.key_size * self.capacity],
+                &mut self.values[..self.value_stride * self.capacity],
+                &mut count,
+            );
+
+            let filled = match status {
+                BatchStatus::More(n) | BatchStatus::Done(n) => n as usize,
+                BatchStatus::Unsupported => return Err(BatchStatus::Unsupported),
+                BatchStatus::Error(errno) => return Err(BatchStatus::Error(errno)),
+            };
+
+            let filled = filled.min(self.capacity);
+            if filled > 0 {
+                on_batch(
+                    &self.keys[..self.key_size * filled],
+                    &self.values[..self.value_stride * filled],
+                    filled,
+                );
+                total += filled;
+            }
+
+            if matches!(status, BatchStatus::Done(_)) {
+                return Ok(total);
+            }
+
+            std::mem::swap(&mut self.in_batch, &mut self.out_batch);
+            first = false;
+        }
+    }
+}
+
+/// Размер значения в пакетном буфере.
+///
+/// Для per-CPU карт ядро возвращает значения всех возможных CPU, каждое
+/// выровнено до 8 байт.
+pub fn value_stride(value_size: usize, per_cpu: bool, possible_cpus: usize) -> usize {
+    if per_cpu {
+        ((value_size + 7) & !7) * possible_cpus.max(1)
+    } else {
+        value_size
+    }
+}
+
+/// Разобрать значения пачки в структуры `T`.
+///
+/// Значения, размер слота которых меньше `T`, пропускаются. Для per-CPU карт
+/// каждое значение CPU становится отдельным элементом.
+pub fn decode_values<T: Default + Copy>(
+    values: &[u8],
+    count: usize,
+    stride: usize,
+    slot_size: usize,
+    out: &mut Vec<T>,
+) {
+    let size = std::mem::size_of::<T>();
+    if slot_size < size || stride == 0 || slot_size == 0 {
+        return;
+    }
+
+    for entry in values.chunks_exact(stride).take(count) {
+        for slot in entry.chunks_exact(slot_size) {
+            let mut value = T::default();
+            // SAFETY: T — Copy-структура с C-раскладкой, слот содержит не меньше size_of::<T>() байт
+            unsafe {
+                std::ptr::copy_nonoverlapping(
+                    slot.as_ptr(),
+                    &mut value as *mut T as *mut u8,
+                    size,
+                );
+            }
+            out.push(value);
+        }
+    }
+}
+
+/// Проверить, известно ли, что тип карты не поддерживает пакетные команды
+pub fn is_batch_unsupported(map_type: u32) -> bool {
+    map_type < 64 && UNSUPPORTED_MAP_TYPES.load(Ordering::Relaxed) & (1 << map_type) != 0
+}
+
+/// Запомнить, что тип карты не поддерживает пакетные команды
+pub fn mark_batch_unsupported(map_type: u32) {
+    if map_type < 64 {
+        UNSUPPORTED_MAP_TYPES.fetch_or(1 << map_type, Ordering::Relaxed);
+    }
+}
+
+/// Классифицировать результат системного вызова пакетного чтения
+pub fn classify_batch_result(ret: i64, errno: i32, count: u32) -> BatchStatus {
+    const ENOTSUPP: i32 = 524;
+    if ret == 0 {
+        BatchStatus::More(count)
+    } else if errno == libc::ENOENT {
+        // ENOENT — обход завершён, count содержит последнюю пачку
+        BatchStatus::Done(count)
+    } else if errno == libc::EINVAL || errno == libc::EOPNOTSUPP || errno == ENOTSUPP {
+        BatchStatus::Unsupported
+    } else {
+        BatchStatus::Error(errno)
+    }
+}
+
+/// Пакетный источник поверх файлового дескриптора карты ядра
+pub struct KernelMapBatch {
+    map_fd: i32,
+}
+
+impl KernelMapBatch {
+    /// `BPF_MAP_LOOKUP_BATCH`
+    const BPF_MAP_LOOKUP_BATCH: libc::c_long = 24;
+
+    /// Источник для чтения карты без удаления записей
+    pub fn lookup(map_fd: i32) -> Self {
+        Self { map_fd }
+    }
+}
+
+/// Раскладка `union bpf_attr` для команд `BPF_MAP_*_BATCH`
+#[repr(C)]
+#[derive(Default)]
+struct BpfBatchAttr {
+    in_batch: u64,
+    out_batch: u64,
+    keys: u64,
+    values: u64,
+    count: u32,
+    map_fd: u32,
+    elem_flags: u64,
+    flags: u64,
+}
+
+impl BatchSource for KernelMapBatch {
+    fn lookup_batch(
+        &mut self,
+        in_batch: Option<&[u8]>,
+        out_batch: &mut [u8],
+        keys: &mut [u8],
+        values: &mut [u8],
+        count: &mut u32,
+    ) -> BatchStatus {
+        let mut attr = BpfBatchAttr {
+            in_batch: in_batch.map_or(0, |batch| batch.as_ptr() as u64),
+            out_batch: out_batch.as_mut_ptr() as u64,
+            keys: keys.as_mut_ptr() as u64,
+            values: values.as_mut_ptr() as u64,
+            count: *count,
+            map_fd: self.map_fd as u32,
+            ..Default::default()
+        };
+
+        // SAFETY: attr указывает на буферы, живущие до конца вызова
+        let ret = unsafe {
+            libc::syscall(
+                libc::SYS_bpf,
+                Self::BPF_MAP_LOOKUP_BATCH,
+                &mut attr as *mut BpfBatchAttr,
+                std::mem::size_of::<BpfBatchAttr>() as libc::c_uint,
+            )
+        };
+        let errno = if ret < 0 {
+            std::io::Error::last_os_error().raw_os_error().unwrap_or(0)
+        } else {
+            0
+        };
+
+        *count = attr.count;
+        classify_batch_result(ret as i64, errno, attr.count)
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    /// Имитация карты ядра: отдаёт записи пачками, курсор — индекс следующей записи
+    struct FakeMap {
+        entries: Vec<(u32, u64)>,
+        supported: bool,
+        /// Количество вызовов, после которых ядро перестаёт поддерживать пачки
+        supported_calls: Option<usize>,
+        calls: usize,
+    }
+
+    impl BatchSource for FakeMap {
+        fn lookup_batch(
+            &mut self,
+            in_batch: Option<&[u8]>,
+            out_batch: &mut [u8],
+            keys: &mut [u8],
+            values: &mut [u8],
+            count: &mut u32,
+        ) -> BatchStatus {
+            self.calls += 1;
+            if !self.supported || self.supported_calls.is_some_and(|n| self.calls > n) {
+                return BatchStatus::Unsupported;
+            }
+            let start = in_batch
+                .map(|b| u32::from_ne_bytes(b[..4].try_into().unwrap()) as usize)
+                .unwrap_or(0);
+            let end = (start + *count as usize).min(self.entries.len());
+            for (i, (key, value)) in self.entries[start..end].iter().enumerate() {
+                keys[i * 4..i * 4 + 4].copy_from_slice(&key.to_ne_bytes());
+                values[i * 8..i * 8 + 8].copy_from_slice(&value.to_ne_bytes());
+            }
+            out_batch[..4].copy_from_slice(&(end as u32).to_ne_bytes());
+            *count = (end - start) as u32;
+            if end == self.entries.len() {
+                BatchStatus::Done(*count)
+            } else {
+                BatchStatus::More(*count)
+            }
+        }
+    }
+
+    #[test]
+    fn test_drain_reads_all_entries_in_few_calls() {
+        let mut map = FakeMap {
+            entries: (0..1000).map(|i| (i, i as u64 * 10)).collect(),
+            supported: true,
+            supported_calls: None,
+            calls: 0,
+        };
+        let mut buffer = MapBatchBuffer::new();
+        buffer.prepare(4, 8, 256);
+
+        let mut values: Vec<u64> = Vec::new();
+        let total = buffer
+            .drain(&mut map, |_, batch_values, count| {
+                decode_values(batch_values, count, 8, 8, &mut values)
+            })
+            .unwrap();
+
+        assert_eq!(total, 1000);
+        assert_eq!(values.len(), 1000);
+        assert_eq!(values[999], 9990);
+        assert_eq!(map.calls, 4);
+    }
+
+    #[test]
+    fn test_drain_reports_unsupported() {
+        let mut map = FakeMap {
+            entries: vec![(1, 1)],
+            supported: false,
+            supported_calls: None,
+            calls: 0,
+        };
+        let mut buffer = MapBatchBuffer::new();
+        buffer.prepare(4, 8, 16);
+        assert_eq!(
+            buffer.drain(&mut map, |_, _, _| {}),
+            Err(BatchStatus::Unsupported)
+        );
+    }
+
+    #[test]
+    fn test_drain_does_not_report_partial_read_as_complete() {
+        // Ядро отдало первую пачку и затем сообщило об отсутствии поддержки
+        let mut map = FakeMap {
+            entries: (0..100).map(|i| (i, i as u64)).collect(),
+            supported: true,
+            supported_calls: Some(1),
+            calls: 0,
+        };
+        let mut buffer = MapBatchBuffer::new();
+        buffer.prepare(4, 8, 64);
+
+        let mut delivered = 0;
+        assert_eq!(
+            buffer.drain(&mut map, |_, _, count| delivered += count),
+            Err(BatchStatus::Unsupported)
+        );
+        assert_eq!(delivered, 64);
+        assert_eq!(map.calls, 2);
+    }
+
+    #[test]
+    fn test_buffer_is_reused() {
+        let mut buffer = MapBatchBuffer::new();
+        buffer.prepare(4, 64, 1024);
+        let allocated = buffer.allocated_bytes();
+        buffer.prepare(4, 8, 128);
+        assert_eq!(buffer.allocated_bytes(), allocated);
+        assert_eq!(buffer.capacity(), 128);
+    }
+
+    #[test]
+    fn test_per_cpu_stride_and_decode() {
+        assert_eq!(value_stride(12, false, 4), 12);
+        assert_eq!(value_stride(12, true, 4), 64);
+
+        // Две записи по два CPU, значения u64
+        let mut raw = Vec::new();
+        for v in [1u64, 2, 3, 4] {
+            raw.extend_from_slice(&v.to_ne_bytes());
+        }
+        let mut out: Vec<u64> = Vec::new();
+        decode_values(&raw, 2, 16, 8, &mut out);
+        assert_eq!(out, vec![1, 2, 3, 4]);
+    }
+
+    #[test]
+    fn test_classify_batch_result() {
+        assert_eq!(classify_batch_result(0, 0, 10), BatchStatus::More(10));
+        assert_eq!(
+            classify_batch_result(-1, libc::ENOENT, 3),
+            BatchStatus::Done(3)
+        );
+        assert_eq!(
+            classify_batch_result(-1, libc::EINVAL, 0),
+            BatchStatus::Unsupported
+        );
+        assert_eq!(
+            classify_batch_result(-1, libc::EPERM, 0),
+            BatchStatus::Error(libc::EPERM)
+        );
+    }
+
+    #[test]
+    fn test_unsupported_map_type_registry() {
+        assert!(!is_batch_unsupported(27));
+        mark_batch_unsupported(27);
+        assert!(is_batch_unsupported(27));
+        assert!(!is_batch_unsupported(100));
+    }
+}
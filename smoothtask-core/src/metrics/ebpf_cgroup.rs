@@ -0,0 +1,447 @@
+//! Per-cgroup агрегаты eBPF программ.
+//!
+//! Актуатор меняет приоритеты на уровне cgroup v2 приложений, поэтому
+//! программы `process_disk.c`, `process_network.c`, `gpu_monitor.c`,
+//! `application_performance.c` и `sched_monitor.c` ведут кроме записей
+//! процессов per-CPU итоги по идентификатору cgroup текущей задачи
+//! (`smoothtask_cgroup.h`); время заданий GPU относится к cgroup процесса,
+//! отправившего задание. Коллектору остаётся сложить копии CPU каждой
+//! записи: сводить статистику процессов по cgroup не нужно, а размер карт
+//! ограничен числом cgroup, а не числом процессов.
+//!
+//! Агрегация отключается при сборке (`SMOOTHTASK_BPF_CGROUP_AGGREGATION=0`):
+//! карты остаются пустыми, и список cgroup в метриках не публикуется.
+//!
+//! Энергия cgroup распределяется по времени на CPU из `sched_cgroup_map` вслед
+//! за распределением энергии между процессами (см. `ebpf_energy`).
+
+use super::ebpf_energy::AttributedEnergy;
+use super::ebpf_net::RawNetTraffic;
+use serde::{Deserialize, Serialize};
+use std::collections::HashMap;
+use std::path::{Path, PathBuf};
+use std::time::{Duration, Instant};
+
+/// Итоги дисковых операций по cgroup (`process_disk.c`).
+pub const DISK_CGROUP_MAP: &str = "disk_cgroup_map";
+
+/// Итоги сетевого трафика по cgroup (`process_network.c`).
+pub const NET_CGROUP_MAP: &str = "cgroup_traffic_map";
+
+/// Время выполнения заданий GPU по cgroup (`gpu_monitor.c`).
+pub const GPU_CGROUP_MAP: &str = "gpu_cgroup_map";
+
+/// Итоги счётчиков производительности по cgroup (`application_performance.c`).
+pub const APP_CGROUP_MAP: &str = "app_cgroup_map";
+
+/// Время на CPU и переключения по cgroup (`sched_monitor.c`).
+pub const SCHED_CGROUP_MAP: &str = "sched_cgroup_map";
+
+/// Ёмкость каждой карты (`SMOOTHTASK_MAX_CGROUPS` в `smoothtask_cgroup.h`).
+pub const MAX_CGROUPS: usize = 1024;
+
+/// Минимальный интервал между повторными обходами дерева cgroup.
+///
+/// Удалённая cgroup остаётся в LRU карте до вытеснения, и её идентификатор
+/// не должен вызывать обход на каждом сборе.
+pub const CGROUP_RESCAN_INTERVAL: Duration = Duration::from_secs(10);
+
+/// Сложение копий записи разных CPU.
+pub trait CgroupCounters: Copy + Default {
+    fn merge(&mut self, other: &Self);
+}
+
+impl CgroupCounters for RawNetTraffic {
+    fn merge(&mut self, other: &Self) {
+        RawNetTraffic::merge(self, other);
+    }
+}
+
+/// Итоги cgroup в раскладке ядра (`struct disk_cgroup_stats`).
+#[repr(C)]
+#[derive(Debug, Clone, Copy, Default, PartialEq, Eq)]
+pub struct RawCgroupDiskStats {
+    pub bytes_read: u64,
+    pub bytes_written: u64,
+    pub read_operations: u64,
+    pub write_operations: u64,
+}
+
+impl CgroupCounters for RawCgroupDiskStats {
+    fn merge(&mut self, other: &Self) {
+        self.bytes_read = self.bytes_read.saturating_add(other.bytes_read);
+        self.bytes_written = self.bytes_written.saturating_add(other.bytes_written);
+        self.read_operations = self.read_operations.saturating_add(other.read_operations);
+        self.write_operations = self.write_operations.saturating_add(other.write_operations);
+    }
+}
+
+/// Итоги cgroup в раскладке ядра (`struct gpu_cgroup_stats`).
+#[repr(C)]
+#[derive(Debug, Clone, Copy, Default, PartialEq, Eq)]
+pub struct RawCgroupGpuStats {
+    /// Время, когда кольца GPU выполняли задания cgroup (нс)
+    pub busy_ns: u64,
+    /// Завершённые задания
+    pub jobs: u64,
+}
+
+impl CgroupCounters for RawCgroupGpuStats {
+    fn merge(&mut self, other: &Self) {
+        self.busy_ns = self.busy_ns.saturating_add(other.busy_ns);
+        self.jobs = self.jobs.saturating_add(other.jobs);
+    }
+}
+
+/// Итоги cgroup в раскладке ядра (`struct app_cgroup_stats`).
+#[repr(C)]
+#[derive(Debug, Clone, Copy, Default, PartialEq, Eq)]
+pub struct RawCgroupPerformanceStats {
+    /// Page faults с учётом веса выборки
+    pub page_faults: u64,
+    pub interrupts: u64,
+}
+
+impl CgroupCounters for RawCgroupPerformanceStats {
+    fn merge(&mut self, other: &Self) {
+        self.page_faults = self.page_faults.saturating_add(other.page_faults);
+        self.interrupts = self.interrupts.saturating_add(other.interrupts);
+    }
+}
+
+/// Итоги cgroup в раскладке ядра (`struct sched_cgroup_stats`).
+#[repr(C)]
+#[derive(Debug, Clone, Copy, Default, PartialEq, Eq)]
+pub struct RawCgroupSchedStats {
+    pub runtime_ns: u64,
+    pub context_switches: u64,
+    pub involuntary_switches: u64,
+}
+
+impl CgroupCounters for RawCgroupSchedStats {
+    fn merge(&mut self, other: &Self) {
+        self.runtime_ns = self.runtime_ns.saturating_add(other.runtime_ns);
+        self.context_switches = self.context_switches.saturating_add(other.context_switches);
+        self.involuntary_switches = self
+            .involuntary_switches
+            .saturating_add(other.involuntary_switches);
+    }
+}
+
+/// Свернуть записи per-CPU карты cgroup в таблицу по идентификатору cgroup.
+pub fn reduce_cgroup_entries<V: CgroupCounters>(entries: &[(u64, Vec<V>)]) -> HashMap<u64, V> {
+    entries
+        .iter()
+        .map(|(cgroup_id, per_cpu)| {
+            let merged = per_cpu.iter().fold(V::default(), |mut total, copy| {
+                total.merge(copy);
+                total
+            });
+            (*cgroup_id, merged)
+        })
+        .collect()
+}
+
+/// Итоги всех карт cgroup за один сбор.
+#[derive(Debug, Clone, Default)]
+pub struct CgroupTables {
+    pub sched: HashMap<u64, RawCgroupSchedStats>,
+    pub disk: HashMap<u64, RawCgroupDiskStats>,
+    pub network: HashMap<u64, RawNetTraffic>,
+    pub gpu: HashMap<u64, RawCgroupGpuStats>,
+    pub performance: HashMap<u64, RawCgroupPerformanceStats>,
+}
+
+impl CgroupTables {
+    /// Идентификаторы cgroup, встреченные хотя бы в одной карте.
+    pub fn cgroup_ids(&self) -> Vec<u64> {
+        let mut ids: Vec<u64> = self
+            .sched
+            .keys()
+            .chain(self.disk.keys())
+            .chain(self.network.keys())
+            .chain(self.gpu.keys())
+            .chain(self.performance.keys())
+            .copied()
+            .collect();
+        ids.sort_unstable();
+        ids.dedup();
+        ids
+    }
+}
+
+/// Потребление ресурсов cgroup v2
+#[derive(Debug, Clone, Default, PartialEq, Serialize, Deserialize)]
+pub struct CgroupResourceStat {
+    /// Идентификатор cgroup v2 (номер inode каталога cgroup)
+    pub cgroup_id: u64,
+    /// Путь относительно корня cgroupfs (None — cgroup уже удалена)
+    pub path: Option<String>,
+    pub cpu_time_ns: u64,
+    pub context_switches: u64,
+    pub involuntary_switches: u64,
+    pub disk_bytes_read: u64,
+    pub disk_bytes_written: u64,
+    pub disk_read_operations: u64,
+    pub disk_write_operations: u64,
+    pub network_bytes_sent: u64,
+    pub network_bytes_received: u64,
+    /// Время выполнения заданий GPU (нс)
+    pub gpu_time_ns: u64,
+    /// Завершённые задания GPU
+    pub gpu_jobs: u64,
+    /// Page faults с учётом веса выборки
+    pub page_faults: u64,
+    pub interrupts: u64,
+    /// Накопленная энергия (микроджоули)
+    pub energy_uj: u64,
+    /// Средняя мощность за последний интервал (ватты)
+    pub energy_w: f32,
+}
+
+/// Собрать статистику cgroup из таблиц карт и приписанной энергии.
+///
+/// Возвращает не больше `limit` cgroup с наибольшим временем на CPU.
+pub fn build_cgroup_stats(
+    tables: &CgroupTables,
+    energy: &HashMap<u64, AttributedEnergy>,
+    paths: &CgroupPathCache,
+    limit: usize,
+) -> Vec<CgroupResourceStat> {
+    let mut stats: Vec<CgroupResourceStat> = tables
+        .cgroup_ids()
+        .into_iter()
+        .map(|cgroup_id| {
+            let sched = tables.sched.get(&cgroup_id).copied().unwrap_or_default();
+            let disk = tables.disk.get(&cgroup_id).copied().unwrap_or_default();
+            let network = tables.network.get(&cgroup_id).copied().unwrap_or_default();
+            let gpu = tables.gpu.get(&cgroup_id).copied().unwrap_or_default();
+            let performance = tables
+                .performance
+                .get(&cgroup_id)
+                .copied()
+                .unwrap_or_default();
+            let energy = energy.get(&cgroup_id).copied().unwrap_or_default();
+
+            CgroupResourceStat {
+                cgroup_id,
+                path: paths.path(cgroup_id).map(str::to_string),
+                cpu_time_ns: sched.runtime_ns,
+                context_switches: sched.context_switches,
+                involuntary_switches: sched.involuntary_switches,
+                disk_bytes_read: disk.bytes_read,
+                disk_bytes_written: disk.bytes_written,
+                disk_read_operations: disk.read_operations,
+                disk_write_operations: disk.write_operations,
+                network_bytes_sent: network.bytes_sent,
+                network_bytes_received: network.bytes_received,
+                gpu_time_ns: gpu.busy_ns,
+                gpu_jobs: gpu.jobs,
+                page_faults: performance.page_faults,
+                interrupts: performance.interrupts,
+                energy_uj: energy.energy_uj,
+                energy_w: energy.power_w as f32,
+            }
+        })
+        .collect();
+
+    stats.sort_by(|a, b| {
+        b.cpu_time_ns
+            .cmp(&a.cpu_time_ns)
+            .then(a.cgroup_id.cmp(&b.cgroup_id))
+    });
+    stats.truncate(limit);
+    stats
+}
+
+/// Обратное отображение идентификаторов cgroup в пути cgroupfs.
+///
+/// Идентификатор cgroup v2 — номер inode её каталога, поэтому таблица
+/// строится обходом дерева. Дерево перечитывается, только когда встречен
+/// неизвестный идентификатор, и не чаще [`CGROUP_RESCAN_INTERVAL`].
+#[derive(Debug)]
+pub struct CgroupPathCache {
+    root: PathBuf,
+    paths: HashMap<u64, String>,
+    last_scan: Option<Instant>,
+}
+
+impl CgroupPathCache {
+    pub fn new(root: impl Into<PathBuf>) -> Self {
+        Self {
+            root: root.into(),
+            paths: HashMap::new(),
+            last_scan: None,
+        }
+    }
+
+    /// Путь cgroup относительно корня (`/` — корневая cgroup).
+    pub fn path(&self, cgroup_id: u64) -> Option<&str> {
+        self.paths.get(&cgroup_id).map(String::as_str)
+    }
+
+    /// Перечитать дерево, если среди `cgroup_ids` есть неизвестные.
+    pub fn refresh(&mut self, now: Instant, cgroup_ids: &[u64]) {
+        if cgroup_ids.iter().all(|id| self.paths.contains_key(id)) {
+            return;
+        }
+        if let Some(last) = self.last_scan {
+            if now.duration_since(last) < CGROUP_RESCAN_INTERVAL {
+                return;
+            }
+        }
+
+        self.paths = scan_cgroup_tree(&self.root);
+        self.last_scan = Some(now);
+    }
+}
+
+/// Обойти дерево cgroupfs и вернуть пути каталогов по номеру inode.
+///
+/// Недоступные каталоги пропускаются.
+pub fn scan_cgroup_tree(root: &Path) -> HashMap<u64, String> {
+    use std::os::unix::fs::MetadataExt;
+
+    let mut paths = HashMap::new();
+    let mut pending = vec![(root.to_path_buf(), String::from("/"))];
+
+    while let Some((dir, relative)) = pending.pop() {
+        let Ok(metadata) = std::fs::metadata(&dir) else {
+            continue;
+        };
+        paths.insert(metadata.ino(), relative.clone());
+
+        let Ok(entries) = std::fs::read_dir(&dir) else {
+            continue;
+        };
+        for entry in entries.flatten() {
+            if !entry.file_type().map_or(false, |kind| kind.is_dir()) {
+                continue;
+            }
+            let name = entry.file_name().to_string_lossy().into_owned();
+            let child = if relative == "/" {
+                format!("/{}", name)
+            } else {
+                format!("{}/{}", relative, name)
+            };
+            pending.push((entry.path(), child));
+        }
+    }
+
+    paths
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+    use std::os::unix::fs::MetadataExt;
+
+    #[test]
+    fn test_layout_matches_kernel() {
+        assert_eq!(std::mem::size_of::<RawCgroupDiskStats>(), 32);
+        assert_eq!(std::mem::size_of::<RawCgroupGpuStats>(), 16);
+        assert_eq!(std::mem::size_of::<RawCgroupPerformanceStats>(), 16);
+        assert_eq!(std::mem::size_of::<RawCgroupSchedStats>(), 24);
+    }
+
+    #[test]
+    fn test_reduce_sums_per_cpu_copies() {
+        let copy = |runtime_ns, switches| RawCgroupSchedStats {
+            runtime_ns,
+            context_switches: switches,
+            involuntary_switches: 1,
+        };
+        let entries = vec![
+            (
+                7u64,
+                vec![copy(100, 2), copy(50, 1), RawCgroupSchedStats::default()],
+            ),
+            (9u64, vec![copy(u64::MAX, 1), copy(10, 1)]),
+        ];
+
+        let reduced = reduce_cgroup_entries(&entries);
+        assert_eq!(reduced[&7].runtime_ns, 150);
+        assert_eq!(reduced[&7].context_switches, 3);
+        assert_eq!(reduced[&7].involuntary_switches, 2);
+        assert_eq!(reduced[&9].runtime_ns, u64::MAX);
+    }
+
+    #[test]
+    fn test_build_stats_joins_tables() {
+        let mut tables = CgroupTables::default();
+        tables.sched.insert(
+            1,
+            RawCgroupSchedStats {
+                runtime_ns: 500,
+                ..Default::default()
+            },
+        );
+        tables.sched.insert(
+            2,
+            RawCgroupSchedStats {
+                runtime_ns: 900,
+                ..Default::default()
+            },
+        );
+        tables.disk.insert(
+            1,
+            RawCgroupDiskStats {
+                bytes_read: 4096,
+                read_operations: 1,
+                ..Default::default()
+            },
+        );
+        tables.gpu.insert(
+            3,
+            RawCgroupGpuStats {
+                busy_ns: 4_000_000,
+                jobs: 2,
+            },
+        );
+        let mut energy = HashMap::new();
+        energy.insert(
+            2,
+            AttributedEnergy {
+                energy_uj: 1_000,
+                power_w: 0.5,
+            },
+        );
+        let paths = CgroupPathCache::new("/nonexistent");
+
+        let stats = build_cgroup_stats(&tables, &energy, &paths, 10);
+        let ids: Vec<u64> = stats.iter().map(|stat| stat.cgroup_id).collect();
+        assert_eq!(ids, vec![2, 1, 3]);
+        assert_eq!(stats[0].energy_uj, 1_000);
+        assert_eq!(stats[1].disk_bytes_read, 4096);
+        assert_eq!(stats[2].gpu_time_ns, 4_000_000);
+        assert_eq!(stats[2].gpu_jobs, 2);
+        assert_eq!(stats[2].path, None);
+
+        assert_eq!(build_cgroup_stats(&tables, &energy, &paths, 1).len(), 1);
+    }
+
+    #[test]
+    fn test_path_cache_resolves_inodes() {
+        let root = tempfile::tempdir().unwrap();
+        let app = root.path().join("user.slice/app-firefox.scope");
+        std::fs::create_dir_all(&app).unwrap();
+        let app_id = std::fs::metadata(&app).unwrap().ino();
+        let root_id = std::fs::metadata(root.path()).unwrap().ino();
+
+        let mut cache = CgroupPathCache::new(root.path());
+        let start = Instant::now();
+        cache.refresh(start, &[app_id]);
+        assert_eq!(cache.path(app_id), Some("/user.slice/app-firefox.scope"));
+        assert_eq!(cache.path(root_id), Some("/"));
+
+        // Новая cgroup до истечения интервала не вызывает повторного обхода
+        let late = root.path().join("user.slice/app-late.scope");
+        std::fs::create_dir(&late).unwrap();
+        let late_id = std::fs::metadata(&late).unwrap().ino();
+        cache.refresh(start + Duration::from_secs(1), &[late_id]);
+        assert_eq!(cache.path(late_id), None);
+
+        cache.refresh(start + CGROUP_RESCAN_INTERVAL, &[late_id]);
+        assert_eq!(cache.path(late_id), Some("/user.slice/app-late.scope"));
+    }
+}
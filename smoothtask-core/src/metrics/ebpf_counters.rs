@@ -0,0 +1,94 @@
+//! Per-CPU счётчики глобальных итогов eBPF программ.
+//!
+//! Программы объявляют счётчики через общий заголовок
+//! `ebpf_programs/smoothtask_counters.h`: каждый CPU увеличивает только свою
+//! копию значения обычным сложением, без атомарных операций и конкуренции за
+//! кэш-линию. Итог появляется только в userspace — после пакетного чтения
+//! карты копии всех CPU суммируются функциями этого модуля.
+//!
+//! Пакетное чтение per-CPU карты возвращает значения в порядке
+//! «слот за слотом, внутри слота — CPU за CPU», поэтому для массива из N
+//! слотов на M CPU получается плоский вектор длиной N * M.
+
+use std::collections::HashMap;
+use std::hash::Hash;
+
+/// Общее количество принятых пакетов в программе `network_monitor`.
+pub const TOTAL_PACKET_COUNT_MAP_NAME: &str = "total_packet_count_map";
+
+/// Количество системных вызовов по PID в программе `process_monitor`.
+pub const PROCESS_SYSCALL_COUNT_MAP_NAME: &str = "syscall_stats_map";
+
+/// Сумма per-CPU копий счётчика.
+///
+/// Копии только растут, но при переполнении одной из них итог не должен
+/// паниковать, поэтому сложение выполняется с насыщением.
+pub fn sum_per_cpu(values: &[u64]) -> u64 {
+    values
+        .iter()
+        .fold(0u64, |total, &value| total.saturating_add(value))
+}
+
+/// Свернуть плоский результат чтения per-CPU массива в итоги по слотам.
+///
+/// `num_cpus` — количество копий на слот; неполный хвост (при несогласованном
+/// чтении) тоже учитывается отдельным слотом.
+pub fn reduce_slots(values: &[u64], num_cpus: usize) -> Vec<u64> {
+    if num_cpus == 0 {
+        return Vec::new();
+    }
+
+    values.chunks(num_cpus).map(sum_per_cpu).collect()
+}
+
+/// Свернуть записи per-CPU хеш-карты в итоги по ключу.
+///
+/// Повторяющиеся ключи (например, из нескольких чтений подряд) складываются.
+pub fn reduce_keyed<K, I>(entries: I) -> HashMap<K, u64>
+where
+    K: Eq + Hash,
+    I: IntoIterator<Item = (K, Vec<u64>)>,
+{
+    let mut totals = HashMap::new();
+    for (key, values) in entries {
+        let total: &mut u64 = totals.entry(key).or_default();
+        *total = total.saturating_add(sum_per_cpu(&values));
+    }
+    totals
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    #[test]
+    fn test_sum_per_cpu() {
+        assert_eq!(sum_per_cpu(&[]), 0);
+        assert_eq!(sum_per_cpu(&[3, 0, 5, 2]), 10);
+        assert_eq!(sum_per_cpu(&[u64::MAX, 1]), u64::MAX);
+    }
+
+    #[test]
+    fn test_reduce_slots() {
+        // Два слота на трёх CPU
+        let values = [1, 2, 3, 10, 20, 30];
+        assert_eq!(reduce_slots(&values, 3), vec![6, 60]);
+        // Один слот: итог равен сумме всех копий
+        assert_eq!(reduce_slots(&values, values.len()), vec![66]);
+        assert!(reduce_slots(&values, 0).is_empty());
+        // Неполный хвост учитывается отдельно
+        assert_eq!(reduce_slots(&[1, 1, 1, 1, 5], 2), vec![2, 2, 5]);
+    }
+
+    #[test]
+    fn test_reduce_keyed() {
+        let totals = reduce_keyed(vec![
+            (42u32, vec![1, 2, 3]),
+            (7u32, vec![0, 0, 4]),
+            (42u32, vec![10, 0, 0]),
+        ]);
+        assert_eq!(totals.len(), 2);
+        assert_eq!(totals[&42], 16);
+        assert_eq!(totals[&7], 4);
+    }
+}
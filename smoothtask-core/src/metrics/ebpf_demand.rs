@@ -0,0 +1,422 @@
+//! Прикрепление eBPF программ по запросу потребителей метрик.
+//!
+//! `EbpfMetricsCollector::initialize` загружает все программы, которые
+//! разрешает конфигурация, но прикреплённая программа стоит времени на каждом
+//! событии ядра, даже если её данные никто не читает. В режиме
+//! `demand_driven_attachment` потребители (правила политики, экспорт
+//! Prometheus, обработчики API) объявляют группы метрик, которые им нужны, а
+//! коллектор держит прикреплёнными только программы этих групп. Загруженный
+//! объект и его карты сохраняются: откреплённая программа отключается от точек
+//! трассировки сбросом ссылок (links) и прикрепляется снова без перезагрузки.
+//!
+//! Потребитель объявляет группы одним из двух способов:
+//! - подписка [`EbpfDemand::subscribe`] действует до
+//!   [`EbpfDemand::unsubscribe`] (постоянные потребители);
+//! - запрос [`EbpfDemand::request`] отмечает группы нужными в момент вызова
+//!   (обработчики API и экспорт, которые читают метрики эпизодически).
+//!
+//! Группа остаётся активной ещё `idle_timeout` после того, как её перестали
+//! запрашивать: программа не открепляется между двумя опросами Prometheus.
+
+use std::collections::{BTreeSet, HashMap};
+use std::time::{Duration, Instant};
+
+/// Время, которое группа остаётся прикреплённой без запросов, по умолчанию
+pub const DEFAULT_ATTACHMENT_IDLE_TIMEOUT: Duration = Duration::from_secs(300);
+
+/// Группа eBPF метрик, которую может запросить потребитель
+#[derive(
+    Debug, Clone, Copy, PartialEq, Eq, PartialOrd, Ord, Hash, serde::Serialize, serde::Deserialize,
+)]
+#[serde(rename_all = "snake_case")]
+pub enum EbpfMetricGroup {
+    /// Загрузка CPU
+    Cpu,
+    /// Использование памяти системы
+    Memory,
+    /// Системные вызовы и гистограммы их задержек
+    Syscalls,
+    /// Сетевой трафик системы
+    Network,
+    /// Таблица сетевых соединений
+    Connections,
+    /// Кольца и устройства GPU
+    Gpu,
+    /// Температура CPU и критические точки термальных зон
+    Thermal,
+    /// Файловые операции
+    Filesystem,
+    /// Статистика процессов
+    Processes,
+    /// Использование GPU процессами
+    ProcessGpu,
+    /// Сетевой трафик процессов
+    ProcessNetwork,
+    /// Дисковые операции процессов
+    ProcessDisk,
+    /// Память процессов
+    ProcessMemory,
+    /// Энергопотребление процессов и cgroup
+    ProcessEnergy,
+    /// Производительность приложений
+    ApplicationPerformance,
+    /// Задержки из-за нехватки памяти
+    MemoryPressure,
+    /// Выделения памяти ядра (kmalloc/kfree)
+    KernelAllocations,
+    /// События быстрого пути задержек очереди выполнения
+    RunqueueLatency,
+    /// Сводки эпох агрегатора в ядре (планировщик и трафик процессов)
+    Epoch,
+}
+
+impl EbpfMetricGroup {
+    /// Все группы метрик
+    pub const ALL: [EbpfMetricGroup; 19] = [
+        Self::Cpu,
+        Self::Memory,
+        Self::Syscalls,
+        Self::Network,
+        Self::Connections,
+        Self::Gpu,
+        Self::Thermal,
+        Self::Filesystem,
+        Self::Processes,
+        Self::ProcessGpu,
+        Self::ProcessNetwork,
+        Self::ProcessDisk,
+        Self::ProcessMemory,
+        Self::ProcessEnergy,
+        Self::ApplicationPerformance,
+        Self::MemoryPressure,
+        Self::KernelAllocations,
+        Self::RunqueueLatency,
+        Self::Epoch,
+    ];
+
+    /// Программы, из карт которых собирается группа
+    ///
+    /// Совпадает с тем, какие программы `initialize` загружает для
+    /// соответствующих флагов конфигурации.
+    pub fn programs(self) -> &'static [EbpfProgramRole] {
+        use EbpfProgramRole::*;
+
+        match self {
+            Self::Cpu | Self::Memory => &[CpuMetrics],
+            Self::Syscalls => &[Syscalls],
+            Self::Network => &[Network],
+            Self::Connections => &[NetworkConnections],
+            Self::Gpu => &[Gpu],
+            Self::Thermal => &[CpuTemperature],
+            Self::Filesystem => &[Filesystem],
+            Self::Processes => &[ProcessMonitor, Syscalls],
+            Self::ProcessGpu => &[ProcessGpu, Gpu],
+            Self::ProcessNetwork => &[ProcessNetwork],
+            Self::ProcessDisk => &[ProcessDisk],
+            Self::ProcessMemory => &[ProcessMemory, Scheduler],
+            Self::ProcessEnergy | Self::RunqueueLatency => &[Scheduler],
+            Self::ApplicationPerformance => {
+                &[ApplicationPerformance, Scheduler, Syscalls, MemoryPressure]
+            }
+            Self::MemoryPressure => &[MemoryPressure],
+            Self::KernelAllocations => &[Kmem],
+            Self::Epoch => &[Scheduler, ProcessNetwork],
+        }
+    }
+}
+
+/// eBPF объект коллектора, который прикрепляется и открепляется целиком
+#[derive(Debug, Clone, Copy, PartialEq, Eq, PartialOrd, Ord, Hash)]
+pub enum EbpfProgramRole {
+    /// `cpu_metrics` (CPU и память системы)
+    CpuMetrics,
+    /// `cpu_temperature`
+    CpuTemperature,
+    /// Общая программа системных вызовов `syscall_monitor`
+    Syscalls,
+    /// `network_monitor`
+    Network,
+    /// `network_connections`
+    NetworkConnections,
+    /// `gpu_monitor`
+    Gpu,
+    /// `filesystem_monitor`
+    Filesystem,
+    /// `process_monitor`
+    ProcessMonitor,
+    /// `process_gpu`
+    ProcessGpu,
+    /// `process_network`
+    ProcessNetwork,
+    /// `process_disk`
+    ProcessDisk,
+    /// `process_memory`
+    ProcessMemory,
+    /// Общая программа планировщика `sched_monitor`
+    Scheduler,
+    /// `application_performance`
+    ApplicationPerformance,
+    /// `memory_pressure`
+    MemoryPressure,
+    /// `kmem_allocations`
+    Kmem,
+}
+
+impl EbpfProgramRole {
+    /// Все объекты коллектора
+    pub const ALL: [EbpfProgramRole; 16] = [
+        Self::CpuMetrics,
+        Self::CpuTemperature,
+        Self::Syscalls,
+        Self::Network,
+        Self::NetworkConnections,
+        Self::Gpu,
+        Self::Filesystem,
+        Self::ProcessMonitor,
+        Self::ProcessGpu,
+        Self::ProcessNetwork,
+        Self::ProcessDisk,
+        Self::ProcessMemory,
+        Self::Scheduler,
+        Self::ApplicationPerformance,
+        Self::MemoryPressure,
+        Self::Kmem,
+    ];
+}
+
+/// Программы, нужные для набора групп
+pub fn programs_for_groups(
+    groups: impl IntoIterator<Item = EbpfMetricGroup>,
+) -> BTreeSet<EbpfProgramRole> {
+    groups
+        .into_iter()
+        .flat_map(|group| group.programs().iter().copied())
+        .collect()
+}
+
+/// Учёт подписок потребителей на группы eBPF метрик
+#[derive(Debug, Clone)]
+pub struct EbpfDemand {
+    idle_timeout: Duration,
+    /// Постоянные подписки по имени потребителя
+    subscriptions: HashMap<String, BTreeSet<EbpfMetricGroup>>,
+    /// Последний момент, когда группа была нужна хотя бы одному потребителю
+    last_demanded: HashMap<EbpfMetricGroup, Instant>,
+}
+
+impl Default for EbpfDemand {
+    fn default() -> Self {
+        Self::new(DEFAULT_ATTACHMENT_IDLE_TIMEOUT)
+    }
+}
+
+impl EbpfDemand {
+    /// Создать учёт подписок с заданным временем простоя до открепления
+    pub fn new(idle_timeout: Duration) -> Self {
+        Self {
+            idle_timeout,
+            subscriptions: HashMap::new(),
+            last_demanded: HashMap::new(),
+        }
+    }
+
+    /// Время простоя группы до открепления её программ
+    pub fn idle_timeout(&self) -> Duration {
+        self.idle_timeout
+    }
+
+    /// Изменить время простоя
+    pub fn set_idle_timeout(&mut self, idle_timeout: Duration) {
+        self.idle_timeout = idle_timeout;
+    }
+
+    /// Заменить подписку потребителя новым набором групп
+    pub fn subscribe(&mut self, consumer: &str, groups: &[EbpfMetricGroup]) {
+        self.subscriptions
+            .insert(consumer.to_string(), groups.iter().copied().collect());
+    }
+
+    /// Снять подписку потребителя
+    ///
+    /// Группы подписки остаются активными ещё `idle_timeout` с момента
+    /// последнего вызова [`EbpfDemand::active_groups`].
+    pub fn unsubscribe(&mut self, consumer: &str) -> bool {
+        self.subscriptions.remove(consumer).is_some()
+    }
+
+    /// Отметить группы нужными в момент `now`
+    pub fn request(&mut self, groups: &[EbpfMetricGroup], now: Instant) {
+        for group in groups {
+            self.last_demanded.insert(*group, now);
+        }
+    }
+
+    /// Группы, программы которых должны быть прикреплены в момент `now`
+    ///
+    /// Группы с подпиской продлеваются до `now`; группы, которые не были нужны
+    /// дольше `idle_timeout`, забываются.
+    pub fn active_groups(&mut self, now: Instant) -> BTreeSet<EbpfMetricGroup> {
+        for group in self.subscriptions.values().flatten() {
+            self.last_demanded.insert(*group, now);
+        }
+
+        let idle_timeout = self.idle_timeout;
+        self.last_demanded
+            .retain(|_, last| now.saturating_duration_since(*last) <= idle_timeout);
+        self.last_demanded.keys().copied().collect()
+    }
+
+    /// Группы, нужные потребителям в момент `now`, без продления и забывания
+    ///
+    /// В отличие от [`EbpfDemand::active_groups`] не меняет учёт, поэтому
+    /// подходит для решений во время сбора, которому доступна только ссылка.
+    pub fn requested_groups(&self, now: Instant) -> BTreeSet<EbpfMetricGroup> {
+        let recent = self
+            .last_demanded
+            .iter()
+            .filter(|(_, last)| now.saturating_duration_since(**last) <= self.idle_timeout)
+            .map(|(group, _)| *group);
+        self.subscriptions
+            .values()
+            .flatten()
+            .copied()
+            .chain(recent)
+            .collect()
+    }
+
+    /// Имена потребителей с постоянной подпиской
+    pub fn subscribers(&self) -> Vec<&str> {
+        let mut names: Vec<&str> = self.subscriptions.keys().map(String::as_str).collect();
+        names.sort_unstable();
+        names
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    #[test]
+    fn test_subscription_keeps_group_active() {
+        let start = Instant::now();
+        let mut demand = EbpfDemand::new(Duration::from_secs(60));
+        demand.subscribe("policy", &[EbpfMetricGroup::ProcessEnergy]);
+
+        let later = start + Duration::from_secs(3600);
+        assert_eq!(
+            demand.active_groups(later),
+            BTreeSet::from([EbpfMetricGroup::ProcessEnergy])
+        );
+        assert_eq!(demand.subscribers(), vec!["policy"]);
+    }
+
+    #[test]
+    fn test_request_expires_after_idle_timeout() {
+        let start = Instant::now();
+        let mut demand = EbpfDemand::new(Duration::from_secs(60));
+        demand.request(&[EbpfMetricGroup::Syscalls], start);
+
+        assert!(demand
+            .active_groups(start + Duration::from_secs(59))
+            .contains(&EbpfMetricGroup::Syscalls));
+        // Повторный запрос продлевает группу
+        demand.request(
+            &[EbpfMetricGroup::Syscalls],
+            start + Duration::from_secs(59),
+        );
+        assert!(demand
+            .active_groups(start + Duration::from_secs(100))
+            .contains(&EbpfMetricGroup::Syscalls));
+        assert!(demand
+            .active_groups(start + Duration::from_secs(200))
+            .is_empty());
+    }
+
+    #[test]
+    fn test_requested_groups_do_not_change_demand() {
+        let start = Instant::now();
+        let mut demand = EbpfDemand::new(Duration::from_secs(60));
+        demand.subscribe("policy", &[EbpfMetricGroup::ProcessEnergy]);
+        demand.request(&[EbpfMetricGroup::ProcessNetwork], start);
+
+        assert_eq!(
+            demand.requested_groups(start + Duration::from_secs(30)),
+            BTreeSet::from([
+                EbpfMetricGroup::ProcessEnergy,
+                EbpfMetricGroup::ProcessNetwork
+            ])
+        );
+        assert_eq!(
+            demand.requested_groups(start + Duration::from_secs(90)),
+            BTreeSet::from([EbpfMetricGroup::ProcessEnergy])
+        );
+        // Истёкший запрос не забыт: это делает только active_groups
+        assert_eq!(
+            demand
+                .requested_groups(start + Duration::from_secs(30))
+                .len(),
+            2
+        );
+    }
+
+    #[test]
+    fn test_unsubscribe_detaches_after_idle_timeout() {
+        let start = Instant::now();
+        let mut demand = EbpfDemand::new(Duration::from_secs(60));
+        demand.subscribe("exporter", &[EbpfMetricGroup::Thermal]);
+        assert_eq!(demand.active_groups(start).len(), 1);
+
+        assert!(demand.unsubscribe("exporter"));
+        assert!(!demand.unsubscribe("exporter"));
+        assert_eq!(
+            demand.active_groups(start + Duration::from_secs(30)).len(),
+            1
+        );
+        assert!(demand
+            .active_groups(start + Duration::from_secs(61))
+            .is_empty());
+    }
+
+    #[test]
+    fn test_subscribe_replaces_groups() {
+        let start = Instant::now();
+        let mut demand = EbpfDemand::new(Duration::ZERO);
+        demand.subscribe("api", &[EbpfMetricGroup::Gpu, EbpfMetricGroup::Network]);
+        demand.subscribe("api", &[EbpfMetricGroup::Network]);
+
+        let later = start + Duration::from_secs(1);
+        assert_eq!(
+            demand.active_groups(later),
+            BTreeSet::from([EbpfMetricGroup::Network])
+        );
+    }
+
+    #[test]
+    fn test_shared_programs_are_deduplicated() {
+        let programs = programs_for_groups([
+            EbpfMetricGroup::ProcessEnergy,
+            EbpfMetricGroup::ProcessMemory,
+            EbpfMetricGroup::RunqueueLatency,
+        ]);
+        assert_eq!(
+            programs,
+            BTreeSet::from([EbpfProgramRole::ProcessMemory, EbpfProgramRole::Scheduler])
+        );
+
+        // Агрегатор эпох читает карты обоих источников
+        assert_eq!(
+            programs_for_groups([EbpfMetricGroup::Epoch]),
+            BTreeSet::from([EbpfProgramRole::ProcessNetwork, EbpfProgramRole::Scheduler])
+        );
+
+        // Каждая группа собирается хотя бы из одной программы, и каждая
+        // программа нужна хотя бы одной группе
+        for group in EbpfMetricGroup::ALL {
+            assert!(!group.programs().is_empty(), "{:?}", group);
+        }
+        assert_eq!(
+            programs_for_groups(EbpfMetricGroup::ALL),
+            BTreeSet::from(EbpfProgramRole::ALL)
+        );
+    }
+}
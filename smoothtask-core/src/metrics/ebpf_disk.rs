@@ -0,0 +1,243 @@
+//! Задержки блочного ввода-вывода и глубина очереди устройств.
+//!
+//! `process_disk.c` сопоставляет выдачу запроса устройству (`block_rq_issue`)
+//! с его завершением (`block_rq_complete`) по паре (устройство, начальный
+//! сектор) и накапливает задержку в per-CPU log2 гистограммах по паре
+//! (процесс-владелец, устройство). Владелец определяется при вставке запроса
+//! в очередь планировщика, поэтому запросы, которые выдаёт устройству рабочий
+//! поток kblockd, приписываются процессу, отправившему их. Для каждого
+//! устройства ведётся число запросов в пути и глубина очереди в момент выдачи.
+//!
+//! Здесь гистограммы сливаются по CPU и сворачиваются по устройствам, а
+//! процессы упорядочиваются по суммарному времени ожидания своих запросов:
+//! фоновые процессы, забивающие очередь устройства, оказываются первыми.
+
+use std::collections::BTreeMap;
+
+use super::ebpf_latency::RawLatencyHistogram;
+
+/// Карта per-CPU гистограмм задержек по процессу и устройству.
+pub const DISK_LATENCY_MAP: &str = "disk_latency_map";
+
+/// Карта очередей устройств.
+pub const DISK_DEVICE_MAP: &str = "disk_device_map";
+
+/// Ключ гистограммы в раскладке ядра (`struct disk_latency_key`).
+#[repr(C)]
+#[derive(Debug, Clone, Copy, Default, PartialEq, Eq, Hash)]
+pub struct RawDiskLatencyKey {
+    /// Владелец запросов; 0 — запросы без владельца
+    pub tgid: u32,
+    /// Номер устройства ядра
+    pub dev: u32,
+}
+
+/// Очередь устройства в раскладке ядра (`struct disk_device_stats`).
+#[repr(C)]
+#[derive(Debug, Clone, Copy, Default, PartialEq, Eq)]
+pub struct RawDiskDeviceStats {
+    pub dev: u32,
+    pub pad: u32,
+    /// Выданные устройству и ещё не завершённые запросы
+    pub inflight: i64,
+    pub max_inflight: u64,
+    /// Сумма глубины очереди в момент выдачи запросов
+    pub depth_sum: u64,
+    pub issued: u64,
+    pub completed: u64,
+}
+
+/// Номер устройства ядра (12 бит major, 20 бит minor) в виде `major:minor`.
+pub fn device_name(dev: u32) -> String {
+    format!("{}:{}", dev >> 20, dev & 0xf_ffff)
+}
+
+/// Сводка задержек запросов к устройству для API и Prometheus.
+#[derive(Debug, Clone, Default, PartialEq, serde::Serialize, serde::Deserialize)]
+pub struct DiskLatencyStat {
+    /// Устройство в виде `major:minor`
+    pub device: String,
+    /// TGID владельца запросов, `None` — все запросы устройства
+    #[serde(default)]
+    pub tgid: Option<u32>,
+    /// Количество завершённых запросов
+    pub count: u64,
+    /// Суммарное время от выдачи до завершения (наносекунды)
+    pub total_time_ns: u64,
+    /// Средняя задержка (наносекунды)
+    pub avg_time_ns: u64,
+    /// Медиана задержки (наносекунды)
+    pub p50_ns: u64,
+    /// 99-й перцентиль задержки (наносекунды)
+    pub p99_ns: u64,
+}
+
+impl DiskLatencyStat {
+    /// Построить сводку по слитой гистограмме.
+    pub fn from_histogram(dev: u32, tgid: Option<u32>, hist: &RawLatencyHistogram) -> Self {
+        Self {
+            device: device_name(dev),
+            tgid,
+            count: hist.count,
+            total_time_ns: hist.total_time_ns,
+            avg_time_ns: hist.mean_ns(),
+            p50_ns: hist.percentile_ns(0.50),
+            p99_ns: hist.percentile_ns(0.99),
+        }
+    }
+}
+
+/// Свернуть слитые по CPU гистограммы в сводки.
+///
+/// Сначала идёт по одной сводке на устройство (все владельцы, включая
+/// запросы без владельца) в порядке номеров устройств, затем не более
+/// `max_processes` сводок по паре (процесс, устройство) в порядке убывания
+/// суммарного времени ожидания.
+pub fn summarize_disk_latency(
+    entries: &[(RawDiskLatencyKey, RawLatencyHistogram)],
+    max_processes: usize,
+) -> Vec<DiskLatencyStat> {
+    let mut devices: BTreeMap<u32, RawLatencyHistogram> = BTreeMap::new();
+    for (key, hist) in entries {
+        devices.entry(key.dev).or_default().merge(hist);
+    }
+
+    let mut processes: Vec<&(RawDiskLatencyKey, RawLatencyHistogram)> = entries
+        .iter()
+        .filter(|(key, hist)| key.tgid != 0 && !hist.is_empty())
+        .collect();
+    processes.sort_by(|(a_key, a), (b_key, b)| {
+        b.total_time_ns
+            .cmp(&a.total_time_ns)
+            .then_with(|| (a_key.dev, a_key.tgid).cmp(&(b_key.dev, b_key.tgid)))
+    });
+    processes.truncate(max_processes);
+
+    devices
+        .iter()
+        .filter(|(_, hist)| !hist.is_empty())
+        .map(|(dev, hist)| DiskLatencyStat::from_histogram(*dev, None, hist))
+        .chain(
+            processes
+                .into_iter()
+                .map(|(key, hist)| DiskLatencyStat::from_histogram(key.dev, Some(key.tgid), hist)),
+        )
+        .collect()
+}
+
+/// Очередь блочного устройства.
+#[derive(Debug, Clone, Default, PartialEq, serde::Serialize, serde::Deserialize)]
+pub struct DiskQueueStat {
+    /// Устройство в виде `major:minor`
+    pub device: String,
+    /// Запросы в пути на момент сбора
+    pub inflight: u64,
+    /// Наибольшая замеченная глубина очереди
+    pub max_inflight: u64,
+    /// Средняя глубина очереди в момент выдачи запроса
+    pub avg_depth: f64,
+    /// Выдано запросов
+    pub issued: u64,
+    /// Завершено запросов
+    pub completed: u64,
+}
+
+impl DiskQueueStat {
+    pub fn from_raw(raw: &RawDiskDeviceStats) -> Self {
+        Self {
+            device: device_name(raw.dev),
+            // Счётчик может уйти ниже нуля на мгновение при гонке выдачи и завершения
+            inflight: raw.inflight.max(0) as u64,
+            max_inflight: raw.max_inflight,
+            avg_depth: if raw.issued == 0 {
+                0.0
+            } else {
+                raw.depth_sum as f64 / raw.issued as f64
+            },
+            issued: raw.issued,
+            completed: raw.completed,
+        }
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    fn hist(latencies_ns: &[u64]) -> RawLatencyHistogram {
+        let mut hist = RawLatencyHistogram::default();
+        for &latency in latencies_ns {
+            hist.count += 1;
+            hist.total_time_ns += latency;
+            hist.buckets[(63 - latency.max(1).leading_zeros()) as usize] += 1;
+        }
+        hist
+    }
+
+    fn key(tgid: u32, dev: u32) -> RawDiskLatencyKey {
+        RawDiskLatencyKey { tgid, dev }
+    }
+
+    #[test]
+    fn test_layout_matches_kernel() {
+        assert_eq!(std::mem::size_of::<RawDiskLatencyKey>(), 8);
+        assert_eq!(std::mem::size_of::<RawDiskDeviceStats>(), 48);
+    }
+
+    #[test]
+    fn test_device_name() {
+        // nvme0n1 (259:0) и sda2 (8:2)
+        assert_eq!(device_name(259 << 20), "259:0");
+        assert_eq!(device_name((8 << 20) | 2), "8:2");
+    }
+
+    #[test]
+    fn test_summarize_disk_latency() {
+        let nvme = 259 << 20;
+        let sda = 8 << 20;
+        let entries = [
+            (key(100, nvme), hist(&[100_000, 120_000])),
+            (key(200, nvme), hist(&[8_000_000; 4])),
+            (key(0, nvme), hist(&[50_000])),
+            (key(300, sda), hist(&[2_000_000])),
+        ];
+
+        let stats = summarize_disk_latency(&entries, 2);
+
+        // Устройства по номеру: sda (8:0), затем nvme (259:0)
+        assert_eq!(stats[0].device, "8:0");
+        assert_eq!(stats[0].tgid, None);
+        assert_eq!(stats[1].device, "259:0");
+        assert_eq!(stats[1].count, 7);
+        assert_eq!(stats[1].total_time_ns, 32_270_000);
+
+        // Процессы по суммарному ожиданию, без запросов без владельца
+        assert_eq!(stats.len(), 4);
+        assert_eq!(stats[2].tgid, Some(200));
+        assert_eq!(stats[2].avg_time_ns, 8_000_000);
+        assert_eq!(stats[3].tgid, Some(300));
+    }
+
+    #[test]
+    fn test_queue_stat_from_raw() {
+        let stat = DiskQueueStat::from_raw(&RawDiskDeviceStats {
+            dev: 259 << 20,
+            inflight: 3,
+            max_inflight: 32,
+            depth_sum: 50,
+            issued: 20,
+            completed: 17,
+            ..Default::default()
+        });
+        assert_eq!(stat.device, "259:0");
+        assert_eq!(stat.inflight, 3);
+        assert!((stat.avg_depth - 2.5).abs() < 1e-9);
+
+        let racing = DiskQueueStat::from_raw(&RawDiskDeviceStats {
+            inflight: -1,
+            ..Default::default()
+        });
+        assert_eq!(racing.inflight, 0);
+        assert_eq!(racing.avg_depth, 0.0);
+    }
+}
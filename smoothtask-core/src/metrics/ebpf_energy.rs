@@ -0,0 +1,372 @@
+//! Распределение энергии RAPL между процессами по времени на CPU.
+//!
+//! Энергию ядро не привязывает к задачам, а счётчики RAPL недоступны из eBPF.
+//! Поэтому eBPF часть сводится к общему учёту планировщика (`sched_monitor.c`):
+//! время на CPU по процессам в `sched_task_map` и занятость каждого CPU в
+//! per-CPU слотах `sched_oncpu_map`. Обработчики не обновляют отдельных карт
+//! энергии на событиях.
+//!
+//! Userspace с низкой частотой (не чаще [`MIN_ENERGY_SAMPLE_INTERVAL`]) читает
+//! счётчики пакетов RAPL через powercap (`/sys/class/powercap/intel-rapl:N`) и
+//! делит энергию интервала между процессами пропорционально их времени на CPU
+//! за тот же интервал. Делителем служит суммарная занятость всех CPU, а не
+//! сумма по видимым процессам: доля завершившихся и вытесненных из LRU
+//! процессов остаётся нераспределённой и не завышает оценку остальных.
+//! Энергия простоя распределяется вместе с энергией выполнения.
+//!
+//! Тем же способом энергия делится между cgroup приложений по времени на CPU
+//! из `sched_cgroup_map`: распределение по cgroup следует за распределением по
+//! процессам ([`EnergyAttributor::follow`]) и использует ту же дельту RAPL,
+//! не читая счётчики повторно.
+
+use std::collections::HashMap;
+use std::fs;
+use std::hash::Hash;
+use std::path::{Path, PathBuf};
+use std::time::{Duration, Instant};
+
+/// Каталог зон powercap.
+pub const POWERCAP_ROOT: &str = "/sys/class/powercap";
+
+/// Минимальный интервал между чтениями счётчиков RAPL.
+///
+/// Счётчики обновляются примерно раз в миллисекунду, а их дельта за короткий
+/// интервал шумит сильнее, чем отражает разницу между процессами.
+pub const MIN_ENERGY_SAMPLE_INTERVAL: Duration = Duration::from_secs(1);
+
+/// Дельта счётчика энергии с учётом переполнения на `max_range_uj`.
+pub fn counter_delta(previous: u64, current: u64, max_range_uj: u64) -> u64 {
+    if current >= previous {
+        current - previous
+    } else if max_range_uj > previous {
+        max_range_uj - previous + current
+    } else {
+        // Диапазон неизвестен: интервал пропускается
+        0
+    }
+}
+
+/// Зона RAPL пакета CPU.
+#[derive(Debug, Clone)]
+pub struct RaplZone {
+    /// Имя зоны (`package-0`, ...)
+    pub name: String,
+    energy_path: PathBuf,
+    max_range_uj: u64,
+    last_uj: Option<u64>,
+}
+
+impl RaplZone {
+    /// Энергия с прошлого чтения; `None` при первом чтении и ошибке.
+    fn read_delta_uj(&mut self) -> Option<u64> {
+        let current = fs::read_to_string(&self.energy_path)
+            .ok()?
+            .trim()
+            .parse::<u64>()
+            .ok()?;
+        let delta = self
+            .last_uj
+            .map(|previous| counter_delta(previous, current, self.max_range_uj));
+        self.last_uj = Some(current);
+        delta
+    }
+}
+
+/// Счётчики энергии всех пакетов CPU.
+#[derive(Debug, Clone, Default)]
+pub struct RaplPackages {
+    zones: Vec<RaplZone>,
+}
+
+impl RaplPackages {
+    /// Найти зоны пакетов в каталоге powercap.
+    ///
+    /// Берутся только зоны верхнего уровня `intel-rapl:N` с именем `package-*`
+    /// (их же создаёт драйвер для AMD): подзоны `core` и `uncore` входят в
+    /// пакет, а `psys` включает потребление за пределами CPU.
+    pub fn discover(root: &Path) -> Self {
+        let Ok(entries) = fs::read_dir(root) else {
+            return Self::default();
+        };
+
+        let mut zones: Vec<RaplZone> = entries
+            .flatten()
+            .filter_map(|entry| {
+                let dir_name = entry.file_name().into_string().ok()?;
+                let index = dir_name.strip_prefix("intel-rapl:")?;
+                if index.contains(':') {
+                    return None;
+                }
+
+                let path = entry.path();
+                let name = fs::read_to_string(path.join("name"))
+                    .ok()?
+                    .trim()
+                    .to_string();
+                if !name.starts_with("package") {
+                    return None;
+                }
+                let max_range_uj = fs::read_to_string(path.join("max_energy_range_uj"))
+                    .ok()
+                    .and_then(|value| value.trim().parse().ok())
+                    .unwrap_or(0);
+
+                Some(RaplZone {
+                    name,
+                    energy_path: path.join("energy_uj"),
+                    max_range_uj,
+                    last_uj: None,
+                })
+            })
+            .collect();
+        zones.sort_by(|a, b| a.name.cmp(&b.name));
+
+        Self { zones }
+    }
+
+    pub fn is_empty(&self) -> bool {
+        self.zones.is_empty()
+    }
+
+    pub fn zones(&self) -> &[RaplZone] {
+        &self.zones
+    }
+
+    /// Энергия всех пакетов с прошлого чтения.
+    ///
+    /// `None` при первом чтении и если ни одна зона не прочиталась.
+    pub fn read_delta_uj(&mut self) -> Option<u64> {
+        self.zones
+            .iter_mut()
+            .filter_map(RaplZone::read_delta_uj)
+            .reduce(|a, b| a + b)
+    }
+}
+
+/// Энергия, приписанная процессу или cgroup.
+#[derive(Debug, Clone, Copy, Default, PartialEq)]
+pub struct AttributedEnergy {
+    /// Накопленная энергия с начала наблюдения (микроджоули)
+    pub energy_uj: u64,
+    /// Средняя мощность за последний интервал (ватты)
+    pub power_w: f64,
+}
+
+/// Распределение энергии пакетов между процессами (ключ TGID) или cgroup
+/// (ключ идентификатор cgroup) между сборами.
+#[derive(Debug, Default)]
+pub struct EnergyAttributor<K = u32> {
+    rapl: RaplPackages,
+    last_sample: Option<Instant>,
+    last_busy_ns: u64,
+    /// Энергия последнего интервала (None — счётчики не прочитаны)
+    last_energy_uj: Option<u64>,
+    last_runtime: HashMap<K, u64>,
+    attributed: HashMap<K, AttributedEnergy>,
+}
+
+impl<K: Copy + Eq + Hash + Default> EnergyAttributor<K> {
+    pub fn new(rapl: RaplPackages) -> Self {
+        Self {
+            rapl,
+            ..Default::default()
+        }
+    }
+
+    /// Есть ли счётчики энергии для распределения.
+    pub fn has_energy_source(&self) -> bool {
+        !self.rapl.is_empty()
+    }
+
+    /// Обновить распределение по снимку учёта планировщика.
+    ///
+    /// `busy_ns` — суммарная занятость всех CPU, `runtimes` — время на CPU
+    /// по ключу. Чаще [`MIN_ENERGY_SAMPLE_INTERVAL`] счётчики не читаются и
+    /// возвращается прошлое распределение.
+    pub fn sample<I>(
+        &mut self,
+        now: Instant,
+        busy_ns: u64,
+        runtimes: I,
+    ) -> &HashMap<K, AttributedEnergy>
+    where
+        I: IntoIterator<Item = (K, u64)>,
+    {
+        let due = self.last_sample.map_or(true, |last| {
+            now.duration_since(last) >= MIN_ENERGY_SAMPLE_INTERVAL
+        });
+        if due {
+            let energy_uj = self.rapl.read_delta_uj();
+            self.apportion(now, energy_uj, busy_ns, runtimes);
+        }
+        &self.attributed
+    }
+
+    /// Разделить энергию последнего интервала `leader` по своему ключу.
+    ///
+    /// Счётчики RAPL не читаются: используются энергия и занятость CPU, которые
+    /// `leader` получил при последнем чтении. Пока `leader` не выполнил новое
+    /// чтение, возвращается прошлое распределение.
+    pub fn follow<L, I>(
+        &mut self,
+        leader: &EnergyAttributor<L>,
+        runtimes: I,
+    ) -> &HashMap<K, AttributedEnergy>
+    where
+        I: IntoIterator<Item = (K, u64)>,
+    {
+        if let Some(now) = leader.last_sample {
+            if self.last_sample != Some(now) {
+                self.apportion(now, leader.last_energy_uj, leader.last_busy_ns, runtimes);
+            }
+        }
+        &self.attributed
+    }
+
+    /// Разделить `energy_uj` за интервал с прошлого вызова между ключами.
+    ///
+    /// Первый вызов только запоминает исходные значения счётчиков. Ключи,
+    /// пропавшие из учёта планировщика, удаляются.
+    pub fn apportion<I>(&mut self, now: Instant, energy_uj: Option<u64>, busy_ns: u64, runtimes: I)
+    where
+        I: IntoIterator<Item = (K, u64)>,
+    {
+        let elapsed = self.last_sample.map(|last| now.duration_since(last));
+        let busy_delta = busy_ns.saturating_sub(self.last_busy_ns);
+        let previous = std::mem::take(&mut self.last_runtime);
+        let mut attributed = HashMap::with_capacity(previous.len());
+
+        for (tgid, runtime_ns) in runtimes {
+            self.last_runtime.insert(tgid, runtime_ns);
+            let mut energy = self.attributed.get(&tgid).copied().unwrap_or_default();
+            energy.power_w = 0.0;
+
+            if let (Some(elapsed), Some(energy_uj)) = (elapsed, energy_uj) {
+                // Процесс, появившийся за интервал, выполнялся только в нём
+                let runtime_delta =
+                    runtime_ns.saturating_sub(previous.get(&tgid).copied().unwrap_or(0));
+                if busy_delta > 0 && runtime_delta > 0 {
+                    let share = (runtime_delta as f64 / busy_delta as f64).min(1.0);
+                    let interval_uj = energy_uj as f64 * share;
+                    energy.energy_uj += interval_uj as u64;
+                    if !elapsed.is_zero() {
+                        energy.power_w = interval_uj / 1_000_000.0 / elapsed.as_secs_f64();
+                    }
+                }
+            }
+            attributed.insert(tgid, energy);
+        }
+
+        self.attributed = attributed;
+        self.last_busy_ns = busy_ns;
+        self.last_energy_uj = energy_uj;
+        self.last_sample = Some(now);
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    #[test]
+    fn test_counter_delta_wraps() {
+        assert_eq!(counter_delta(100, 250, 1000), 150);
+        assert_eq!(counter_delta(900, 50, 1000), 150);
+        assert_eq!(counter_delta(900, 50, 0), 0);
+    }
+
+    #[test]
+    fn test_discover_packages() {
+        let root = tempfile::tempdir().unwrap();
+        for (dir, name, energy) in [
+            ("intel-rapl:0", "package-0", "1000"),
+            ("intel-rapl:0:0", "core", "400"),
+            ("intel-rapl:1", "psys", "5000"),
+        ] {
+            let zone = root.path().join(dir);
+            fs::create_dir(&zone).unwrap();
+            fs::write(zone.join("name"), format!("{}\n", name)).unwrap();
+            fs::write(zone.join("energy_uj"), energy).unwrap();
+            fs::write(zone.join("max_energy_range_uj"), "262143328850").unwrap();
+        }
+
+        let mut packages = RaplPackages::discover(root.path());
+        assert_eq!(packages.zones().len(), 1);
+        assert_eq!(packages.zones()[0].name, "package-0");
+
+        assert_eq!(packages.read_delta_uj(), None);
+        fs::write(root.path().join("intel-rapl:0/energy_uj"), "3500").unwrap();
+        assert_eq!(packages.read_delta_uj(), Some(2500));
+    }
+
+    #[test]
+    fn test_apportion_by_runtime_share() {
+        let mut attributor = EnergyAttributor::default();
+        let start = Instant::now();
+        attributor.apportion(start, None, 1_000, [(10, 500), (20, 500)]);
+
+        // За 2 с CPU были заняты 4 мс: 3 мс у процесса 10, 1 мс у нового процесса 30,
+        // процесс 20 не выполнялся
+        let later = start + Duration::from_secs(2);
+        attributor.apportion(
+            later,
+            Some(8_000_000),
+            4_001_000,
+            [(10, 3_000_500), (20, 500), (30, 1_000_000)],
+        );
+
+        let attributed = &attributor.attributed;
+        assert_eq!(attributed[&10].energy_uj, 6_000_000);
+        assert!((attributed[&10].power_w - 3.0).abs() < 1e-9);
+        assert_eq!(attributed[&20], AttributedEnergy::default());
+        assert_eq!(attributed[&30].energy_uj, 2_000_000);
+
+        // Процесс 30 завершился и удаляется, 10 накапливает энергию
+        let last = later + Duration::from_secs(1);
+        attributor.apportion(
+            last,
+            Some(1_000_000),
+            5_001_000,
+            [(10, 4_000_500), (20, 500)],
+        );
+        assert_eq!(attributor.attributed.len(), 2);
+        assert_eq!(attributor.attributed[&10].energy_uj, 7_000_000);
+    }
+
+    #[test]
+    fn test_sample_respects_interval() {
+        let mut attributor = EnergyAttributor::default();
+        let start = Instant::now();
+        attributor.apportion(start, None, 0, [(10, 0)]);
+
+        // Без источников энергии и до истечения интервала распределение не меняется
+        let attributed = attributor.sample(start + Duration::from_millis(10), 1_000, [(10, 1_000)]);
+        assert_eq!(attributed[&10], AttributedEnergy::default());
+        assert_eq!(attributor.last_busy_ns, 0);
+    }
+
+    #[test]
+    fn test_follow_reuses_leader_interval() {
+        let mut processes = EnergyAttributor::<u32>::default();
+        let mut cgroups = EnergyAttributor::<u64>::default();
+        let start = Instant::now();
+
+        // До первого чтения у ведущего распределения нет
+        assert!(cgroups.follow(&processes, [(7, 0)]).is_empty());
+
+        processes.apportion(start, None, 1_000, [(10, 500)]);
+        cgroups.follow(&processes, [(7u64, 500), (8, 500)]);
+
+        let later = start + Duration::from_secs(1);
+        processes.apportion(later, Some(4_000_000), 2_001_000, [(10, 1_000_500)]);
+        let attributed = cgroups.follow(&processes, [(7u64, 1_500_500), (8, 500)]);
+        assert_eq!(attributed[&7].energy_uj, 3_000_000);
+        assert!((attributed[&7].power_w - 3.0).abs() < 1e-9);
+        assert_eq!(attributed[&8].energy_uj, 0);
+
+        // Повторный вызов без нового чтения ведущего не распределяет энергию дважды
+        let attributed = cgroups.follow(&processes, [(7u64, 9_000_000)]);
+        assert_eq!(attributed[&7].energy_uj, 3_000_000);
+        assert_eq!(attributed.len(), 2);
+    }
+}
@@ -0,0 +1,752 @@
+//! Сводки eBPF счётчиков по эпохам, собранные в ядре.
+//!
+//! Без агрегации коллектор на каждом сборе обходит карты процессов целиком, и
+//! стоимость сбора растёт с количеством процессов. Программа
+//! `epoch_aggregator.c` взводит `bpf_timer` и по каждому его срабатыванию
+//! сворачивает `sched_task_map` и `process_traffic_map` (карты программ
+//! `sched_monitor` и `process_network`, подставленные через
+//! `bpf_map__reuse_fd`) в сводку эпохи: суммы за эпоху и
+//! [`EPOCH_TOP_N`] процессов с наибольшим временем на CPU, ожиданием
+//! ввода-вывода и трафиком. Сводки пишутся в кольцо из [`EPOCH_RING_SIZE`]
+//! записей; userspace читает только новые записи, по одной на эпоху.
+//!
+//! Пока агрегатор работает, сбор на каждом тике берёт планировщик и трафик
+//! процессов из сводок и не обходит карты источников: детальная статистика
+//! групп [`EPOCH_SOURCE_GROUPS`] собирается полным обходом только по запросу
+//! потребителя (подписка или недавний запрос API, см. [`collects_group`]).
+//! Исходные счётчики поэтому не сбрасываются: приращения за эпоху считаются в
+//! ядре относительно значений прошлой эпохи. Первая эпоха после запуска только
+//! запоминает эти значения.
+//! Пока агрегатор работает, коллектор подписан на группу
+//! `EbpfMetricGroup::Epoch`, поэтому при `demand_driven_attachment`
+//! источники не открепляются.
+//! Агрегатору нужен Linux 5.19+ (`bpf_timer` и `bpf_map_lookup_percpu_elem`).
+
+use std::collections::{BTreeSet, VecDeque};
+use std::ops::RangeInclusive;
+
+use serde::{Deserialize, Serialize};
+
+use super::ebpf_demand::EbpfMetricGroup;
+
+/// Имя встроенного eBPF объекта агрегатора
+pub const EPOCH_AGGREGATOR_OBJECT: &str = "epoch_aggregator";
+/// Программа, взводящая таймер эпох (`SEC("syscall")`)
+pub const EPOCH_START_PROGRAM: &str = "epoch_start";
+/// Параметры агрегации (`struct epoch_config`)
+pub const EPOCH_CONFIG_MAP: &str = "epoch_config_map";
+/// Кольцо сводок (`struct epoch_summary`)
+pub const EPOCH_RING_MAP: &str = "epoch_ring_map";
+/// Номер последней записанной сводки
+pub const EPOCH_HEAD_MAP: &str = "epoch_head_map";
+
+/// Количество сводок в кольце (`EPOCH_RING_SIZE`)
+pub const EPOCH_RING_SIZE: usize = 16;
+/// Длина списков самых нагруженных процессов (`EPOCH_TOP_N`)
+pub const EPOCH_TOP_N: usize = 8;
+/// Наибольшее количество CPU, трафик которых суммируется (`EPOCH_MAX_CPUS`)
+pub const EPOCH_MAX_CPUS: usize = 256;
+
+/// Длительность эпохи по умолчанию
+pub const DEFAULT_EPOCH_INTERVAL_MS: u64 = 1000;
+/// Наименьшая длительность эпохи: обход карт стоит времени в softirq
+pub const MIN_EPOCH_INTERVAL_MS: u64 = 100;
+/// Наибольшая длительность эпохи
+pub const MAX_EPOCH_INTERVAL_MS: u64 = 60_000;
+
+/// Количество последних сводок, которые хранит userspace
+pub const EPOCH_HISTORY_LEN: usize = EPOCH_RING_SIZE;
+
+/// Группы детальной статистики, сбор которых обходит `sched_task_map` или
+/// `process_traffic_map` целиком
+pub const EPOCH_SOURCE_GROUPS: [EbpfMetricGroup; 6] = [
+    EbpfMetricGroup::ProcessEnergy,
+    EbpfMetricGroup::ProcessGpu,
+    EbpfMetricGroup::ProcessNetwork,
+    EbpfMetricGroup::ProcessDisk,
+    EbpfMetricGroup::ProcessMemory,
+    EbpfMetricGroup::ApplicationPerformance,
+];
+
+/// Собирать ли на очередном сборе детальную статистику группы `group`
+///
+/// Без агрегатора собираются все включённые группы. Пока агрегатор работает,
+/// группы [`EPOCH_SOURCE_GROUPS`] собираются только если они в `requested`
+/// (см. `EbpfDemand::requested_groups`), остальные — как обычно.
+pub fn collects_group(
+    group: EbpfMetricGroup,
+    aggregator_running: bool,
+    requested: &BTreeSet<EbpfMetricGroup>,
+) -> bool {
+    !aggregator_running || !EPOCH_SOURCE_GROUPS.contains(&group) || requested.contains(&group)
+}
+
+/// Параметры агрегации в раскладке ядра (`struct epoch_config`)
+#[repr(C)]
+#[derive(Debug, Clone, Copy, Default, PartialEq, Eq)]
+pub struct RawEpochConfig {
+    pub epoch_ns: u64,
+    pub nr_cpus: u32,
+    pub _pad: u32,
+}
+
+impl RawEpochConfig {
+    /// Параметры для длительности эпохи и количества возможных CPU
+    ///
+    /// Длительность ограничивается диапазоном
+    /// [`MIN_EPOCH_INTERVAL_MS`]..=[`MAX_EPOCH_INTERVAL_MS`], количество CPU —
+    /// [`EPOCH_MAX_CPUS`].
+    pub fn new(interval_ms: u64, nr_cpus: usize) -> Self {
+        let interval_ms = interval_ms.clamp(MIN_EPOCH_INTERVAL_MS, MAX_EPOCH_INTERVAL_MS);
+        Self {
+            epoch_ns: interval_ms * 1_000_000,
+            nr_cpus: nr_cpus.min(EPOCH_MAX_CPUS) as u32,
+            _pad: 0,
+        }
+    }
+
+    /// Сериализовать запись для записи в карту
+    pub fn to_bytes(&self) -> [u8; 16] {
+        let mut bytes = [0u8; 16];
+        bytes[0..8].copy_from_slice(&self.epoch_ns.to_ne_bytes());
+        bytes[8..12].copy_from_slice(&self.nr_cpus.to_ne_bytes());
+        bytes
+    }
+}
+
+/// Процесс в списке самых нагруженных в раскладке ядра (`struct epoch_top`)
+#[repr(C)]
+#[derive(Debug, Clone, Copy, Default, PartialEq, Eq)]
+pub struct RawEpochTop {
+    pub value: u64,
+    pub tgid: u32,
+    pub _pad: u32,
+}
+
+/// Сводка эпохи в раскладке ядра (`struct epoch_summary`)
+#[repr(C)]
+#[derive(Debug, Clone, Copy, Default, PartialEq, Eq)]
+pub struct RawEpochSummary {
+    /// Номер эпохи (с 1); записывается в ядре последним
+    pub seq: u64,
+    /// Монотонное время начала эпохи
+    pub start_ns: u64,
+    /// Монотонное время конца эпохи
+    pub end_ns: u64,
+    /// Время на CPU всех процессов
+    pub cpu_ns: u64,
+    /// Ожидание ввода-вывода всех процессов
+    pub io_wait_ns: u64,
+    /// Отправлено и получено всеми процессами
+    pub net_bytes: u64,
+    pub context_switches: u64,
+    /// Процессы, выполнявшиеся в эпоху
+    pub cpu_tasks: u32,
+    /// Процессы с сетевым трафиком в эпоху
+    pub net_tasks: u32,
+    pub top_cpu: [RawEpochTop; EPOCH_TOP_N],
+    pub top_io: [RawEpochTop; EPOCH_TOP_N],
+    pub top_net: [RawEpochTop; EPOCH_TOP_N],
+}
+
+impl RawEpochSummary {
+    /// Разобрать запись кольца сводок
+    pub fn from_bytes(data: &[u8]) -> Option<Self> {
+        if data.len() < std::mem::size_of::<Self>() {
+            return None;
+        }
+        let u64_at =
+            |offset: usize| u64::from_ne_bytes(data[offset..offset + 8].try_into().unwrap());
+        let u32_at =
+            |offset: usize| u32::from_ne_bytes(data[offset..offset + 4].try_into().unwrap());
+        let top_at = |offset: usize| {
+            let mut top = [RawEpochTop::default(); EPOCH_TOP_N];
+            for (index, entry) in top.iter_mut().enumerate() {
+                let base = offset + index * std::mem::size_of::<RawEpochTop>();
+                entry.value = u64_at(base);
+                entry.tgid = u32_at(base + 8);
+            }
+            top
+        };
+        let top_len = EPOCH_TOP_N * std::mem::size_of::<RawEpochTop>();
+
+        Some(Self {
+            seq: u64_at(0),
+            start_ns: u64_at(8),
+            end_ns: u64_at(16),
+            cpu_ns: u64_at(24),
+            io_wait_ns: u64_at(32),
+            net_bytes: u64_at(40),
+            context_switches: u64_at(48),
+            cpu_tasks: u32_at(56),
+            net_tasks: u32_at(60),
+            top_cpu: top_at(64),
+            top_io: top_at(64 + top_len),
+            top_net: top_at(64 + 2 * top_len),
+        })
+    }
+}
+
+/// Процесс с наибольшим приращением счётчика за эпоху
+#[derive(Debug, Clone, Default, PartialEq, Serialize, Deserialize)]
+pub struct EpochTopProcess {
+    pub tgid: u32,
+    /// Приращение за эпоху (наносекунды для CPU и ввода-вывода, байты для сети)
+    pub total: u64,
+    /// Приращение в секунду
+    pub per_sec: f64,
+}
+
+/// Сводка одной эпохи
+#[derive(Debug, Clone, Default, PartialEq, Serialize, Deserialize)]
+pub struct EpochSummary {
+    /// Номер эпохи
+    pub seq: u64,
+    /// Фактическая длительность эпохи в миллисекундах
+    pub duration_ms: f64,
+    /// Среднее количество занятых процессами CPU
+    pub cpu_cores: f64,
+    /// Среднее количество процессов в ожидании ввода-вывода
+    pub io_wait_load: f64,
+    /// Сетевой трафик процессов (отправлено и получено), байт/с
+    pub net_bytes_per_sec: f64,
+    /// Переключения контекста, 1/с
+    pub context_switches_per_sec: f64,
+    /// Процессы, выполнявшиеся в эпоху
+    pub cpu_processes: u32,
+    /// Процессы с сетевым трафиком в эпоху
+    pub net_processes: u32,
+    /// Процессы с наибольшим временем на CPU
+    pub top_cpu: Vec<EpochTopProcess>,
+    /// Процессы с наибольшим ожиданием ввода-вывода
+    pub top_io: Vec<EpochTopProcess>,
+    /// Процессы с наибольшим трафиком
+    pub top_net: Vec<EpochTopProcess>,
+    /// Эпохи, пропущенные с запуска агрегатора (кольцо перезаписано до чтения)
+    pub missed_epochs: u64,
+}
+
+impl EpochSummary {
+    /// Сводка из записи кольца
+    pub fn from_raw(raw: &RawEpochSummary) -> Self {
+        let duration_ns = raw.end_ns.saturating_sub(raw.start_ns);
+        let seconds = duration_ns as f64 / 1e9;
+        let rate = |value: u64| {
+            if seconds > 0.0 {
+                value as f64 / seconds
+            } else {
+                0.0
+            }
+        };
+        let top = |entries: &[RawEpochTop]| {
+            let mut top: Vec<EpochTopProcess> = entries
+                .iter()
+                .filter(|entry| entry.value > 0)
+                .map(|entry| EpochTopProcess {
+                    tgid: entry.tgid,
+                    total: entry.value,
+                    per_sec: rate(entry.value),
+                })
+                .collect();
+            top.sort_by(|a, b| b.total.cmp(&a.total).then(a.tgid.cmp(&b.tgid)));
+            top
+        };
+
+        Self {
+            seq: raw.seq,
+            duration_ms: duration_ns as f64 / 1e6,
+            cpu_cores: rate(raw.cpu_ns) / 1e9,
+            io_wait_load: rate(raw.io_wait_ns) / 1e9,
+            net_bytes_per_sec: rate(raw.net_bytes),
+            context_switches_per_sec: rate(raw.context_switches),
+            cpu_processes: raw.cpu_tasks,
+            net_processes: raw.net_tasks,
+            top_cpu: top(&raw.top_cpu),
+            top_io: top(&raw.top_io),
+            top_net: top(&raw.top_net),
+            missed_epochs: 0,
+        }
+    }
+}
+
+/// Последние сводки, прочитанные из кольца
+///
+/// Кольцо читается по номеру последней записанной сводки (`head`): новыми
+/// считаются эпохи после последней прочитанной. Самая старая запись кольца
+/// может перезаписываться ядром во время чтения и не читается; запись, номер
+/// которой не совпал с ожидаемым, пропускается и учитывается в
+/// [`EpochSummary::missed_epochs`].
+#[derive(Debug, Default)]
+pub struct EpochHistory {
+    epochs: VecDeque<EpochSummary>,
+    last_seq: u64,
+    missed_epochs: u64,
+}
+
+impl EpochHistory {
+    pub fn new() -> Self {
+        Self::default()
+    }
+
+    /// Номера эпох, которые нужно прочитать из кольца (может быть пустым)
+    pub fn pending(&self, head: u64) -> RangeInclusive<u64> {
+        let oldest_stable = head.saturating_sub(EPOCH_RING_SIZE as u64 - 2).max(1);
+        (self.last_seq + 1).max(oldest_stable)..=head
+    }
+
+    /// Слот кольца эпохи
+    pub fn slot(seq: u64) -> u32 {
+        (seq % EPOCH_RING_SIZE as u64) as u32
+    }
+
+    /// Добавить запись кольца, прочитанную для эпохи `seq`
+    ///
+    /// Возвращает `false`, если запись уже принадлежит другой эпохе.
+    pub fn push(&mut self, seq: u64, raw: &RawEpochSummary) -> bool {
+        if raw.seq != seq || seq <= self.last_seq {
+            return false;
+        }
+        // До первого чтения пропущенных эпох нет: агрегатор только запущен
+        if self.last_seq != 0 {
+            self.missed_epochs += seq - self.last_seq - 1;
+        }
+        self.last_seq = seq;
+
+        let mut summary = EpochSummary::from_raw(raw);
+        summary.missed_epochs = self.missed_epochs;
+        if self.epochs.len() == EPOCH_HISTORY_LEN {
+            self.epochs.pop_front();
+        }
+        self.epochs.push_back(summary);
+        true
+    }
+
+    /// Последняя прочитанная сводка
+    pub fn latest(&self) -> Option<&EpochSummary> {
+        self.epochs.back()
+    }
+
+    /// Прочитанные сводки от старых к новым
+    pub fn recent(&self) -> Vec<EpochSummary> {
+        self.epochs.iter().cloned().collect()
+    }
+}
+
+/// Агрегатор эпох поверх загруженного объекта `epoch_aggregator`
+///
+/// Таймер принадлежит карте объекта: он работает, пока агрегатор не
+/// уничтожен, и останавливается вместе с выгрузкой объекта.
+#[cfg(feature = "ebpf")]
+pub struct EpochAggregator {
+    _program: super::ebpf_objects::EbpfObject,
+    ring_map: libbpf_rs::MapHandle,
+    head_map: libbpf_rs::MapHandle,
+    history: std::sync::Mutex<EpochHistory>,
+}
+
+#[cfg(feature = "ebpf")]
+impl EpochAggregator {
+    /// Загрузить агрегатор поверх карт программ планировщика и сетевого
+    /// трафика процессов и взвести таймер эпох
+    ///
+    /// Отсутствующий источник заменяется пустой картой: его измерения в
+    /// сводках остаются нулевыми.
+    pub fn start(
+        sched: Option<&super::ebpf_objects::EbpfObject>,
+        network: Option<&super::ebpf_objects::EbpfObject>,
+        interval_ms: u64,
+    ) -> anyhow::Result<Self> {
+        use anyhow::Context;
+        use libbpf_rs::{MapCore, MapFlags};
+
+        if sched.is_none() && network.is_none() {
+            anyhow::bail!(
+                "Для агрегации по эпохам не загружены программы sched_monitor и process_network"
+            );
+        }
+
+        let program = super::ebpf_objects::EbpfObject::load_with_shared_maps(
+            EPOCH_AGGREGATOR_OBJECT,
+            &[
+                (super::ebpf_sched::SCHED_TASK_MAP_NAME, sched),
+                (super::ebpf_net::PROCESS_TRAFFIC_MAP_NAME, network),
+            ],
+        )?;
+
+        let nr_cpus = libbpf_rs::num_possible_cpus()
+            .context("Не удалось определить количество возможных CPU")?;
+        if nr_cpus > EPOCH_MAX_CPUS {
+            tracing::warn!(
+                "Трафик процессов в сводках эпох учитывается только для первых {} из {} CPU",
+                EPOCH_MAX_CPUS,
+                nr_cpus
+            );
+        }
+
+        let map = |name: &str| {
+            program
+                .map_handle(name)?
+                .with_context(|| format!("Карта {} не найдена", name))
+        };
+        let config = RawEpochConfig::new(interval_ms, nr_cpus);
+        map(EPOCH_CONFIG_MAP)?.update(&0u32.to_ne_bytes(), &config.to_bytes(), MapFlags::ANY)?;
+        let ring_map = map(EPOCH_RING_MAP)?;
+        let head_map = map(EPOCH_HEAD_MAP)?;
+
+        let code = program.run_syscall_program(EPOCH_START_PROGRAM)?;
+        if code != 0 {
+            anyhow::bail!(
+                "Программа {} не взвела таймер эпох (код {}). Требуется Linux 5.19+ с поддержкой bpf_timer",
+                EPOCH_START_PROGRAM,
+                code
+            );
+        }
+
+        tracing::info!(
+            "Агрегация eBPF счётчиков по эпохам запущена (эпоха {} мс)",
+            config.epoch_ns / 1_000_000
+        );
+
+        Ok(Self {
+            _program: program,
+            ring_map,
+            head_map,
+            history: std::sync::Mutex::new(EpochHistory::new()),
+        })
+    }
+
+    /// Прочитать сводки, записанные с прошлого вызова, и вернуть последние
+    /// сводки от старых к новым
+    pub fn poll(&self) -> Vec<EpochSummary> {
+        use libbpf_rs::{MapCore, MapFlags};
+
+        let Ok(mut history) = self.history.lock() else {
+            return Vec::new();
+        };
+
+        let head = match self.head_map.lookup(&0u32.to_ne_bytes(), MapFlags::ANY) {
+            Ok(Some(bytes)) if bytes.len() >= 8 => {
+                u64::from_ne_bytes(bytes[..8].try_into().unwrap())
+            }
+            Ok(_) => 0,
+            Err(e) => {
+                tracing::debug!("Не удалось прочитать номер последней эпохи: {}", e);
+                return history.recent();
+            }
+        };
+
+        for seq in history.pending(head) {
+            let key = EpochHistory::slot(seq).to_ne_bytes();
+            let raw = match self.ring_map.lookup(&key, MapFlags::ANY) {
+                Ok(Some(bytes)) => RawEpochSummary::from_bytes(&bytes),
+                Ok(None) => None,
+                Err(e) => {
+                    tracing::debug!("Не удалось прочитать сводку эпохи {}: {}", seq, e);
+                    None
+                }
+            };
+            if let Some(raw) = raw {
+                history.push(seq, &raw);
+            }
+        }
+
+        history.recent()
+    }
+}
+
+/// Последняя сводка в формате Prometheus
+pub fn epoch_summary_to_prometheus(summary: &EpochSummary) -> String {
+    let mut output = String::new();
+
+    let gauges: [(&str, &str, String); 7] = [
+        (
+            "smoothtask_ebpf_epoch_seq",
+            "Sequence number of the last in-kernel aggregation epoch",
+            summary.seq.to_string(),
+        ),
+        (
+            "smoothtask_ebpf_epoch_cpu_cores",
+            "Average number of CPUs used by processes during the epoch",
+            format!("{:.4}", summary.cpu_cores),
+        ),
+        (
+            "smoothtask_ebpf_epoch_io_wait_load",
+            "Average number of processes waiting for I/O during the epoch",
+            format!("{:.4}", summary.io_wait_load),
+        ),
+        (
+            "smoothtask_ebpf_epoch_net_bytes_per_second",
+            "Process network traffic (sent and received) during the epoch",
+            format!("{:.1}", summary.net_bytes_per_sec),
+        ),
+        (
+            "smoothtask_ebpf_epoch_context_switches_per_second",
+            "Context switches per second during the epoch",
+            format!("{:.1}", summary.context_switches_per_sec),
+        ),
+        (
+            "smoothtask_ebpf_epoch_active_processes",
+            "Processes that ran on a CPU during the epoch",
+            summary.cpu_processes.to_string(),
+        ),
+        (
+            "smoothtask_ebpf_epoch_missed_total",
+            "Epochs overwritten in the kernel ring before userspace read them",
+            summary.missed_epochs.to_string(),
+        ),
+    ];
+    for (name, help, value) in gauges {
+        let metric_type = if name.ends_with("_total") {
+            "counter"
+        } else {
+            "gauge"
+        };
+        output.push_str(&format!("# HELP {} {}\n", name, help));
+        output.push_str(&format!("# TYPE {} {}\n", name, metric_type));
+        output.push_str(&format!("{} {}\n", name, value));
+    }
+
+    let families: [(&str, &str, &[EpochTopProcess], f64); 3] = [
+        (
+            "smoothtask_ebpf_epoch_top_cpu_cores",
+            "CPUs used by the busiest processes during the epoch",
+            &summary.top_cpu,
+            1e9,
+        ),
+        (
+            "smoothtask_ebpf_epoch_top_io_wait_load",
+            "I/O wait of the processes waiting longest during the epoch",
+            &summary.top_io,
+            1e9,
+        ),
+        (
+            "smoothtask_ebpf_epoch_top_net_bytes_per_second",
+            "Network traffic of the busiest processes during the epoch",
+            &summary.top_net,
+            1.0,
+        ),
+    ];
+    for (name, help, top, scale) in families {
+        if top.is_empty() {
+            continue;
+        }
+        output.push_str(&format!("# HELP {} {}\n", name, help));
+        output.push_str(&format!("# TYPE {} gauge\n", name));
+        for process in top {
+            output.push_str(&format!(
+                "{}{{tgid=\"{}\"}} {:.4}\n",
+                name,
+                process.tgid,
+                process.per_sec / scale
+            ));
+        }
+    }
+
+    output
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    #[test]
+    fn test_tick_skips_source_walks_while_aggregating() {
+        let nothing = BTreeSet::new();
+
+        for group in EPOCH_SOURCE_GROUPS {
+            assert!(collects_group(group, false, &nothing));
+            assert!(!collects_group(group, true, &nothing));
+        }
+        // Группы без обхода карт источников собираются как обычно
+        assert!(collects_group(EbpfMetricGroup::Syscalls, true, &nothing));
+        assert!(collects_group(EbpfMetricGroup::Processes, true, &nothing));
+
+        // Запрос детальной статистики возвращает полный обход только своей группы
+        let requested = BTreeSet::from([EbpfMetricGroup::ProcessNetwork]);
+        assert!(collects_group(
+            EbpfMetricGroup::ProcessNetwork,
+            true,
+            &requested
+        ));
+        assert!(!collects_group(
+            EbpfMetricGroup::ProcessEnergy,
+            true,
+            &requested
+        ));
+    }
+
+    fn raw_summary(seq: u64) -> RawEpochSummary {
+        let mut raw = RawEpochSummary {
+            seq,
+            start_ns: 1_000_000_000,
+            end_ns: 1_500_000_000,
+            cpu_ns: 1_000_000_000,
+            io_wait_ns: 250_000_000,
+            net_bytes: 1_000,
+            context_switches: 50,
+            cpu_tasks: 2,
+            net_tasks: 1,
+            ..Default::default()
+        };
+        raw.top_cpu[3] = RawEpochTop {
+            value: 300_000_000,
+            tgid: 20,
+            _pad: 0,
+        };
+        raw.top_cpu[5] = RawEpochTop {
+            value: 700_000_000,
+            tgid: 10,
+            _pad: 0,
+        };
+        raw.top_net[0] = RawEpochTop {
+            value: 1_000,
+            tgid: 30,
+            _pad: 0,
+        };
+        raw
+    }
+
+    fn to_bytes(raw: &RawEpochSummary) -> Vec<u8> {
+        let mut bytes = Vec::new();
+        for value in [
+            raw.seq,
+            raw.start_ns,
+            raw.end_ns,
+            raw.cpu_ns,
+            raw.io_wait_ns,
+            raw.net_bytes,
+            raw.context_switches,
+        ] {
+            bytes.extend_from_slice(&value.to_ne_bytes());
+        }
+        bytes.extend_from_slice(&raw.cpu_tasks.to_ne_bytes());
+        bytes.extend_from_slice(&raw.net_tasks.to_ne_bytes());
+        for top in [&raw.top_cpu, &raw.top_io, &raw.top_net] {
+            for entry in top {
+                bytes.extend_from_slice(&entry.value.to_ne_bytes());
+                bytes.extend_from_slice(&entry.tgid.to_ne_bytes());
+                bytes.extend_from_slice(&0u32.to_ne_bytes());
+            }
+        }
+        bytes
+    }
+
+    #[test]
+    fn test_layouts_match_kernel() {
+        assert_eq!(std::mem::size_of::<RawEpochConfig>(), 16);
+        assert_eq!(std::mem::size_of::<RawEpochTop>(), 16);
+        assert_eq!(std::mem::size_of::<RawEpochSummary>(), 448);
+    }
+
+    #[test]
+    fn test_config_is_clamped() {
+        let config = RawEpochConfig::new(10, 1024);
+        assert_eq!(config.epoch_ns, MIN_EPOCH_INTERVAL_MS * 1_000_000);
+        assert_eq!(config.nr_cpus as usize, EPOCH_MAX_CPUS);
+
+        let config = RawEpochConfig::new(1000, 8);
+        assert_eq!(config.epoch_ns, 1_000_000_000);
+        assert_eq!(&config.to_bytes()[8..12], &8u32.to_ne_bytes());
+    }
+
+    #[test]
+    fn test_summary_roundtrip() {
+        let raw = raw_summary(7);
+        let bytes = to_bytes(&raw);
+        assert_eq!(bytes.len(), std::mem::size_of::<RawEpochSummary>());
+        assert_eq!(RawEpochSummary::from_bytes(&bytes), Some(raw));
+        assert_eq!(RawEpochSummary::from_bytes(&bytes[..100]), None);
+    }
+
+    #[test]
+    fn test_summary_rates_and_top() {
+        let summary = EpochSummary::from_raw(&raw_summary(1));
+
+        assert_eq!(summary.duration_ms, 500.0);
+        assert_eq!(summary.cpu_cores, 2.0);
+        assert_eq!(summary.io_wait_load, 0.5);
+        assert_eq!(summary.net_bytes_per_sec, 2_000.0);
+        assert_eq!(summary.context_switches_per_sec, 100.0);
+
+        // Пустые слоты отброшены, процессы отсортированы по убыванию
+        let tgids: Vec<u32> = summary.top_cpu.iter().map(|p| p.tgid).collect();
+        assert_eq!(tgids, vec![10, 20]);
+        assert_eq!(summary.top_cpu[0].per_sec, 1_400_000_000.0);
+        assert!(summary.top_io.is_empty());
+        assert_eq!(summary.top_net[0].total, 1_000);
+    }
+
+    #[test]
+    fn test_zero_duration_has_no_rates() {
+        let raw = RawEpochSummary {
+            seq: 1,
+            cpu_ns: 100,
+            ..Default::default()
+        };
+        let summary = EpochSummary::from_raw(&raw);
+        assert_eq!(summary.cpu_cores, 0.0);
+        assert_eq!(summary.net_bytes_per_sec, 0.0);
+    }
+
+    #[test]
+    fn test_pending_skips_slot_being_written() {
+        let mut history = EpochHistory::new();
+        assert!(history.pending(0).is_empty());
+        assert_eq!(history.pending(3), 1..=3);
+
+        // Кольцо переполнено: самая старая запись может перезаписываться
+        assert_eq!(history.pending(40), 26..=40);
+
+        assert!(history.push(40, &raw_summary(40)));
+        assert!(history.pending(40).is_empty());
+        assert_eq!(history.pending(42), 41..=42);
+    }
+
+    #[test]
+    fn test_push_counts_missed_epochs() {
+        let mut history = EpochHistory::new();
+
+        // Эпохи до первого чтения не считаются пропущенными
+        assert!(history.push(5, &raw_summary(5)));
+        assert_eq!(history.latest().unwrap().missed_epochs, 0);
+
+        // Запись уже перезаписана следующей эпохой
+        assert!(!history.push(6, &raw_summary(22)));
+        assert!(history.push(7, &raw_summary(7)));
+        assert_eq!(history.latest().unwrap().missed_epochs, 1);
+
+        // Повтор и старые эпохи игнорируются
+        assert!(!history.push(7, &raw_summary(7)));
+        assert!(!history.push(4, &raw_summary(4)));
+
+        let seqs: Vec<u64> = history.recent().iter().map(|s| s.seq).collect();
+        assert_eq!(seqs, vec![5, 7]);
+    }
+
+    #[test]
+    fn test_history_is_bounded() {
+        let mut history = EpochHistory::new();
+        for seq in 1..=(EPOCH_HISTORY_LEN as u64 + 4) {
+            history.push(seq, &raw_summary(seq));
+        }
+        let recent = history.recent();
+        assert_eq!(recent.len(), EPOCH_HISTORY_LEN);
+        assert_eq!(recent[0].seq, 5);
+        assert_eq!(EpochHistory::slot(17), 1);
+    }
+
+    #[test]
+    fn test_prometheus_export() {
+        let mut summary = EpochSummary::from_raw(&raw_summary(3));
+        summary.missed_epochs = 2;
+        let text = epoch_summary_to_prometheus(&summary);
+
+        assert!(text.contains("smoothtask_ebpf_epoch_seq 3\n"));
+        assert!(text.contains("smoothtask_ebpf_epoch_cpu_cores 2.0000\n"));
+        assert!(text.contains("# TYPE smoothtask_ebpf_epoch_missed_total counter\n"));
+        assert!(text.contains("smoothtask_ebpf_epoch_missed_total 2\n"));
+        assert!(text.contains("smoothtask_ebpf_epoch_top_cpu_cores{tgid=\"10\"} 1.4000\n"));
+        assert!(text.contains("smoothtask_ebpf_epoch_top_net_bytes_per_second{tgid=\"30\"}"));
+        assert!(!text.contains("smoothtask_ebpf_epoch_top_io_wait_load"));
+    }
+}
@@ -0,0 +1,604 @@
+//! Потоковая доставка событий жизненного цикла из eBPF через кольцевой буфер.
+//!
+//! Программа `lifecycle_events.c` публикует события exec/fork/exit, смены
+//! состояния TCP и блочных запросов в `BPF_MAP_TYPE_RINGBUF`. Поток-потребитель
+//! (см. `ebpf_ringbuf`) вычитывает их пачками и применяет к
+//! [`LifecycleEventAggregator`], который поддерживает счётчики и живой набор
+//! процессов без полного обхода HASH карт на каждом тике.
+
+use std::collections::HashSet;
+
+#[cfg(feature = "ebpf")]
+use super::ebpf_ringbuf::RingBufferConsumer;
+
+/// Размер события в кольцевом буфере (байт), см. `struct lifecycle_event`
+pub const LIFECYCLE_EVENT_SIZE: usize = 56;
+
+/// Имя кольцевого буфера в `lifecycle_events.c`
+pub const LIFECYCLE_RINGBUF_MAP: &str = "lifecycle_events";
+/// Имя карты настроек потока событий
+pub const LIFECYCLE_CONFIG_MAP: &str = "lifecycle_config_map";
+
+const EVENT_EXEC: u32 = 1;
+const EVENT_FORK: u32 = 2;
+const EVENT_EXIT: u32 = 3;
+const EVENT_TCP_STATE: u32 = 4;
+const EVENT_BLOCK_RQ_ISSUE: u32 = 5;
+const EVENT_BLOCK_RQ_COMPLETE: u32 = 6;
+
+/// Состояние TCP_ESTABLISHED из include/net/tcp_states.h
+const TCP_ESTABLISHED: u32 = 1;
+/// Состояние TCP_CLOSE из include/net/tcp_states.h
+const TCP_CLOSE: u32 = 7;
+
+/// Событие жизненного цикла в том виде, в котором оно лежит в кольцевом буфере
+#[repr(C)]
+#[derive(Debug, Clone, Copy, Default, PartialEq, Eq)]
+pub struct RawLifecycleEvent {
+    pub timestamp_ns: u64,
+    pub value: u64,
+    pub event_type: u32,
+    pub pid: u32,
+    pub tgid: u32,
+    pub aux: u32,
+    pub aux2: u32,
+    pub _pad: u32,
+    pub comm: [u8; 16],
+}
+
+/// Разобранное событие жизненного цикла
+#[derive(Debug, Clone, PartialEq, Eq)]
+pub enum LifecycleEvent {
+    /// Процесс выполнил execve
+    Exec { tgid: u32, comm: String },
+    /// Создан новый процесс (не поток)
+    Fork { parent_tgid: u32, child_tgid: u32 },
+    /// Завершился лидер группы потоков
+    Exit { tgid: u32, exit_code: u64 },
+    /// Смена состояния TCP сокета
+    TcpStateChange {
+        tgid: u32,
+        old_state: u32,
+        new_state: u32,
+        sport: u16,
+        dport: u16,
+    },
+    /// Блочный запрос отправлен устройству
+    BlockIssue { dev: u32, bytes: u64, write: bool },
+    /// Блочный запрос завершён
+    BlockComplete { dev: u32, bytes: u64, write: bool },
+}
+
+/// Разобрать запись кольцевого буфера
+///
+/// Возвращает `None` для записей неожиданного размера или неизвестного типа.
+pub fn parse_lifecycle_event(data: &[u8]) -> Option<LifecycleEvent> {
+    if data.len() < LIFECYCLE_EVENT_SIZE {
+        return None;
+    }
+
+    let u64_at = |offset: usize| {
+        u64::from_ne_bytes(data[offset..offset + 8].try_into().unwrap_or([0; 8]))
+    };
+    let u32_at = |offset: usize| {
+        u32::from_ne_bytes(data[offset..offset + 4].try_into().unwrap_or([0; 4]))
+    };
+
+    let value = u64_at(8);
+    let event_type = u32_at(16);
+    let tgid = u32_at(24);
+    let aux = u32_at(28);
+    let aux2 = u32_at(32);
+
+    let event = match event_type {
+        EVENT_EXEC => {
+            let comm = &data[40..56];
+            let len = comm.iter().position(|&b| b == 0).unwrap_or(comm.len());
+            LifecycleEvent::Exec {
+                tgid,
+                comm: String::from_utf8_lossy(&comm[..len]).into_owned(),
+            }
+        }
+        EVENT_FORK => LifecycleEvent::Fork {
+            parent_tgid: tgid,
+            child_tgid: aux,
+        },
+        EVENT_EXIT => LifecycleEvent::Exit {
+            tgid,
+            exit_code: value,
+        },
+        EVENT_TCP_STATE => LifecycleEvent::TcpStateChange {
+            tgid,
+            old_state: aux2,
+            new_state: aux,
+            sport: (value >> 16) as u16,
+            dport: value as u16,
+        },
+        EVENT_BLOCK_RQ_ISSUE => LifecycleEvent::BlockIssue {
+            dev: aux,
+            bytes: value,
+            write: aux2 != 0,
+        },
+        EVENT_BLOCK_RQ_COMPLETE => LifecycleEvent::BlockComplete {
+            dev: aux,
+            bytes: value,
+            write: aux2 != 0,
+        },
+        _ => return None,
+    };
+
+    Some(event)
+}
+
+/// Сводка по событиям жизненного цикла
+///
+/// Счётчики (`*_total`) монотонно растут с момента запуска потока событий,
+/// поля `active_*` и `inflight_*` — текущие значения.
+#[derive(Debug, Clone, Default, PartialEq, serde::Serialize, serde::Deserialize)]
+pub struct LifecycleEventSummary {
+    /// Всего обработано событий
+    pub events_total: u64,
+    /// Количество execve
+    pub process_execs_total: u64,
+    /// Количество созданных процессов
+    pub process_forks_total: u64,
+    /// Количество завершённых процессов
+    pub process_exits_total: u64,
+    /// Количество переходов TCP в ESTABLISHED
+    pub tcp_established_total: u64,
+    /// Количество переходов TCP в CLOSE
+    pub tcp_closed_total: u64,
+    /// Количество отправленных блочных запросов
+    pub block_requests_issued_total: u64,
+    /// Количество завершённых блочных запросов
+    pub block_requests_completed_total: u64,
+    /// Прочитано байт (по завершённым запросам)
+    pub block_bytes_read_total: u64,
+    /// Записано байт (по завершённым запросам)
+    pub block_bytes_written_total: u64,
+    /// Текущее количество известных процессов
+    pub active_processes: u64,
+    /// Текущее количество установленных TCP соединений
+    pub active_tcp_connections: u64,
+    /// Текущее количество блочных запросов в полёте
+    pub inflight_block_requests: u64,
+}
+
+/// Агрегатор событий жизненного цикла
+///
+/// Применяет события инкрементально, поддерживая набор живых процессов.
+/// Начальный набор процессов и число установленных соединений задаются через
+/// [`LifecycleEventAggregator::seed_processes`] и
+/// [`LifecycleEventAggregator::seed_tcp_connections`], поскольку события о
+/// процессах и соединениях, появившихся до старта потока, не приходят.
+#[derive(Debug, Default)]
+pub struct LifecycleEventAggregator {
+    live_tgids: HashSet<u32>,
+    summary: LifecycleEventSummary,
+}
+
+impl LifecycleEventAggregator {
+    /// Создать пустой агрегатор
+    pub fn new() -> Self {
+        Self::default()
+    }
+
+    /// Заполнить начальный набор живых процессов
+    pub fn seed_processes<I: IntoIterator<Item = u32>>(&mut self, tgids: I) {
+        self.live_tgids.extend(tgids);
+        self.summary.active_processes = self.live_tgids.len() as u64;
+    }
+
+    /// Учесть TCP соединения, установленные до старта потока
+    pub fn seed_tcp_connections(&mut self, established: u64) {
+        self.summary.active_tcp_connections += established;
+    }
+
+    /// Применить одно событие
+    pub fn apply(&mut self, event: &LifecycleEvent) {
+        let summary = &mut self.summary;
+        summary.events_total += 1;
+
+        match event {
+            LifecycleEvent::Exec { tgid, .. } => {
+                summary.process_execs_total += 1;
+                self.live_tgids.insert(*tgid);
+            }
+            LifecycleEvent::Fork { child_tgid, .. } => {
+                summary.process_forks_total += 1;
+                self.live_tgids.insert(*child_tgid);
+            }
+            LifecycleEvent::Exit { tgid, .. } => {
+                summary.process_exits_total += 1;
+                self.live_tgids.remove(tgid);
+            }
+            LifecycleEvent::TcpStateChange {
+                old_state,
+                new_state,
+                ..
+            } => {
+                if *new_state == TCP_ESTABLISHED && *old_state != TCP_ESTABLISHED {
+                    summary.tcp_established_total += 1;
+                    summary.active_tcp_connections += 1;
+                } else if *old_state == TCP_ESTABLISHED && *new_state != TCP_ESTABLISHED {
+                    summary.active_tcp_connections =
+                        summary.active_tcp_connections.saturating_sub(1);
+                }
+                if *new_state == TCP_CLOSE {
+                    summary.tcp_closed_total += 1;
+                }
+            }
+            LifecycleEvent::BlockIssue { .. } => {
+                summary.block_requests_issued_total += 1;
+                summary.inflight_block_requests += 1;
+            }
+            LifecycleEvent::BlockComplete { bytes, write, .. } => {
+                summary.block_requests_completed_total += 1;
+                summary.inflight_block_requests = summary.inflight_block_requests.saturating_sub(1);
+                if *write {
+                    summary.block_bytes_written_total += bytes;
+                } else {
+                    summary.block_bytes_read_total += bytes;
+                }
+            }
+        }
+
+        self.summary.active_processes = self.live_tgids.len() as u64;
+    }
+
+    /// Применить пачку событий
+    pub fn apply_batch(&mut self, events: &[LifecycleEvent]) {
+        for event in events {
+            self.apply(event);
+        }
+    }
+
+    /// Текущая сводка
+    pub fn summary(&self) -> LifecycleEventSummary {
+        self.summary.clone()
+    }
+}
+
+/// Прочитать PID всех процессов из /proc для начального заполнения агрегатора
+pub fn read_procfs_tgids() -> Vec<u32> {
+    match std::fs::read_dir("/proc") {
+        Ok(entries) => entries
+            .filter_map(|entry| entry.ok())
+            .filter_map(|entry| entry.file_name().to_str()?.parse::<u32>().ok())
+            .collect(),
+        Err(e) => {
+            tracing::warn!("Не удалось прочитать /proc для начального набора процессов: {}", e);
+            Vec::new()
+        }
+    }
+}
+
+/// Посчитать соединения в состоянии ESTABLISHED в содержимом /proc/net/tcp{,6}
+///
+/// Четвёртая колонка `st` — шестнадцатеричный код состояния из tcp_states.h,
+/// первая строка файла — заголовок.
+pub fn count_procfs_established(content: &str) -> u64 {
+    content
+        .lines()
+        .skip(1)
+        .filter_map(|line| line.split_whitespace().nth(3))
+        .filter(|state| u32::from_str_radix(state, 16).ok() == Some(TCP_ESTABLISHED))
+        .count() as u64
+}
+
+/// Прочитать число установленных TCP соединений из /proc/net/tcp и /proc/net/tcp6
+/// для начального заполнения агрегатора
+pub fn read_procfs_tcp_established() -> u64 {
+    ["/proc/net/tcp", "/proc/net/tcp6"]
+        .iter()
+        .map(|path| match std::fs::read_to_string(path) {
+            Ok(content) => count_procfs_established(&content),
+            Err(e) => {
+                tracing::debug!(
+                    "Не удалось прочитать {} для начального числа соединений: {}",
+                    path,
+                    e
+                );
+                0
+            }
+        })
+        .sum()
+}
+
+/// Параметры потока событий
+#[derive(Debug, Clone, Copy, PartialEq, Eq)]
+pub struct LifecycleStreamConfig {
+    /// Порог накопленных байт для принудительного пробуждения потребителя (0 — по умолчанию libbpf)
+    pub wakeup_threshold_bytes: u64,
+    /// Таймаут ожидания событий в poll (миллисекунды)
+    pub poll_timeout_ms: u64,
+}
+
+/// Сериализовать настройки для `lifecycle_config_map` (раскладка `struct lifecycle_config`)
+pub fn encode_stream_config(config: &LifecycleStreamConfig, event_mask: u32) -> [u8; 16] {
+    let mut bytes = [0u8; 16];
+    bytes[0..8].copy_from_slice(&config.wakeup_threshold_bytes.to_ne_bytes());
+    bytes[8..12].copy_from_slice(&event_mask.to_ne_bytes());
+    bytes
+}
+
+/// Поток-потребитель кольцевого буфера событий жизненного цикла
+///
+/// Владеет загруженным объектом `lifecycle_events`; поток останавливается
+/// при вызове [`LifecycleEventStream::stop`] или при уничтожении структуры.
+#[cfg(feature = "ebpf")]
+pub struct LifecycleEventStream {
+    _program: std::sync::Arc<super::ebpf_objects::EbpfObject>,
+    aggregator: std::sync::Arc<std::sync::Mutex<LifecycleEventAggregator>>,
+    consumer: RingBufferConsumer,
+}
+
+#[cfg(feature = "ebpf")]
+impl LifecycleEventStream {
+    /// Запустить поток событий поверх загруженной программы `lifecycle_events`
+    pub fn start(
+        program: std::sync::Arc<super::ebpf_objects::EbpfObject>,
+        config: LifecycleStreamConfig,
+    ) -> anyhow::Result<Self> {
+        use anyhow::Context;
+        use libbpf_rs::{MapCore, MapFlags};
+        use std::sync::{Arc, Mutex};
+        use std::time::Duration;
+
+        let ringbuf_map = program
+            .map_handle(LIFECYCLE_RINGBUF_MAP)?
+            .with_context(|| format!("Карта {} не найдена", LIFECYCLE_RINGBUF_MAP))?;
+
+        if let Some(config_map) = program.map_handle(LIFECYCLE_CONFIG_MAP)? {
+            config_map
+                .update(
+                    &0u32.to_ne_bytes(),
+                    &encode_stream_config(&config, 0),
+                    MapFlags::ANY,
+                )
+                .context("Не удалось записать настройки потока событий")?;
+        }
+
+        let mut aggregator = LifecycleEventAggregator::new();
+        aggregator.seed_processes(read_procfs_tgids());
+        aggregator.seed_tcp_connections(read_procfs_tcp_established());
+        let aggregator = Arc::new(Mutex::new(aggregator));
+
+        let worker_aggregator = Arc::clone(&aggregator);
+        let poll_timeout = Duration::from_millis(config.poll_timeout_ms.max(1));
+        let consumer = RingBufferConsumer::start(
+            "ebpf-lifecycle",
+            ringbuf_map,
+            poll_timeout,
+            256,
+            parse_lifecycle_event,
+            move |events: &[LifecycleEvent]| {
+                // Применяем накопленные за один poll события под одной блокировкой
+                if let Ok(mut aggregator) = worker_aggregator.lock() {
+                    aggregator.apply_batch(events);
+                }
+            },
+        )?;
+
+        tracing::info!(
+            "Поток событий жизненного цикла запущен (порог пробуждения: {} байт, таймаут poll: {:?})",
+            config.wakeup_threshold_bytes,
+            poll_timeout
+        );
+
+        Ok(Self {
+            _program: program,
+            aggregator,
+            consumer,
+        })
+    }
+
+    /// Текущая сводка по событиям
+    pub fn summary(&self) -> LifecycleEventSummary {
+        self.aggregator
+            .lock()
+            .map(|aggregator| aggregator.summary())
+            .unwrap_or_default()
+    }
+
+    /// Остановить поток-потребитель
+    pub fn stop(&mut self) {
+        self.consumer.stop();
+    }
+}
+
+#[cfg(feature = "ebpf")]
+impl Drop for LifecycleEventStream {
+    fn drop(&mut self) {
+        self.stop();
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    fn raw_event(event_type: u32, tgid: u32, value: u64, aux: u32, aux2: u32) -> Vec<u8> {
+        let mut comm = [0u8; 16];
+        comm[..4].copy_from_slice(b"bash");
+        let raw = RawLifecycleEvent {
+            timestamp_ns: 42,
+            value,
+            event_type,
+            pid: tgid,
+            tgid,
+            aux,
+            aux2,
+            _pad: 0,
+            comm,
+        };
+        let bytes = unsafe {
+            std::slice::from_raw_parts(
+                &raw as *const RawLifecycleEvent as *const u8,
+                std::mem::size_of::<RawLifecycleEvent>(),
+            )
+        };
+        bytes.to_vec()
+    }
+
+    #[test]
+    fn test_raw_event_layout_matches_kernel() {
+        assert_eq!(std::mem::size_of::<RawLifecycleEvent>(), LIFECYCLE_EVENT_SIZE);
+    }
+
+    #[test]
+    fn test_parse_exec_and_fork() {
+        let exec = parse_lifecycle_event(&raw_event(EVENT_EXEC, 100, 0, 0, 0)).unwrap();
+        assert_eq!(
+            exec,
+            LifecycleEvent::Exec {
+                tgid: 100,
+                comm: "bash".to_string()
+            }
+        );
+
+        let fork = parse_lifecycle_event(&raw_event(EVENT_FORK, 100, 0, 101, 0)).unwrap();
+        assert_eq!(
+            fork,
+            LifecycleEvent::Fork {
+                parent_tgid: 100,
+                child_tgid: 101
+            }
+        );
+    }
+
+    #[test]
+    fn test_parse_tcp_ports() {
+        let value = (8080u64 << 16) | 443;
+        let event = parse_lifecycle_event(&raw_event(EVENT_TCP_STATE, 7, value, 1, 2)).unwrap();
+        assert_eq!(
+            event,
+            LifecycleEvent::TcpStateChange {
+                tgid: 7,
+                old_state: 2,
+                new_state: 1,
+                sport: 8080,
+                dport: 443
+            }
+        );
+    }
+
+    #[test]
+    fn test_parse_rejects_short_and_unknown() {
+        assert!(parse_lifecycle_event(&[0u8; 10]).is_none());
+        assert!(parse_lifecycle_event(&raw_event(99, 1, 0, 0, 0)).is_none());
+    }
+
+    #[test]
+    fn test_aggregator_process_lifecycle() {
+        let mut aggregator = LifecycleEventAggregator::new();
+        aggregator.seed_processes([1, 2]);
+        aggregator.apply_batch(&[
+            LifecycleEvent::Fork {
+                parent_tgid: 1,
+                child_tgid: 3,
+            },
+            LifecycleEvent::Exec {
+                tgid: 3,
+                comm: "ls".to_string(),
+            },
+            LifecycleEvent::Exit {
+                tgid: 2,
+                exit_code: 0,
+            },
+        ]);
+
+        let summary = aggregator.summary();
+        assert_eq!(summary.events_total, 3);
+        assert_eq!(summary.process_forks_total, 1);
+        assert_eq!(summary.process_execs_total, 1);
+        assert_eq!(summary.process_exits_total, 1);
+        assert_eq!(summary.active_processes, 2);
+    }
+
+    #[test]
+    fn test_aggregator_tcp_and_block() {
+        let mut aggregator = LifecycleEventAggregator::new();
+        let tcp = |old_state, new_state| LifecycleEvent::TcpStateChange {
+            tgid: 1,
+            old_state,
+            new_state,
+            sport: 1,
+            dport: 2,
+        };
+        aggregator.apply_batch(&[
+            tcp(2, TCP_ESTABLISHED),
+            tcp(3, TCP_ESTABLISHED),
+            tcp(TCP_ESTABLISHED, 4),
+            tcp(4, TCP_CLOSE),
+            LifecycleEvent::BlockIssue {
+                dev: 8,
+                bytes: 4096,
+                write: true,
+            },
+            LifecycleEvent::BlockIssue {
+                dev: 8,
+                bytes: 512,
+                write: false,
+            },
+            LifecycleEvent::BlockComplete {
+                dev: 8,
+                bytes: 4096,
+                write: true,
+            },
+        ]);
+
+        let summary = aggregator.summary();
+        assert_eq!(summary.tcp_established_total, 2);
+        assert_eq!(summary.active_tcp_connections, 1);
+        assert_eq!(summary.tcp_closed_total, 1);
+        assert_eq!(summary.block_requests_issued_total, 2);
+        assert_eq!(summary.inflight_block_requests, 1);
+        assert_eq!(summary.block_bytes_written_total, 4096);
+        assert_eq!(summary.block_bytes_read_total, 0);
+    }
+
+    #[test]
+    fn test_count_procfs_established() {
+        let content = "  sl  local_address rem_address   st tx_queue rx_queue tr tm->when retrnsmt   uid  timeout inode\n\
+   0: 0100007F:0277 00000000:0000 0A 00000000:00000000 00:00000000 00000000     0        0 1 1\n\
+   1: 0100007F:9C40 0100007F:0277 01 00000000:00000000 00:00000000 00000000  1000        0 2 1\n\
+   2: 0100007F:9C42 0100007F:0277 01 00000000:00000000 00:00000000 00000000  1000        0 3 1\n\
+   3: 0100007F:9C44 0100007F:0277 06 00000000:00000000 03:00000000 00000000     0        0 0 1\n";
+        assert_eq!(count_procfs_established(content), 2);
+        assert_eq!(count_procfs_established(""), 0);
+    }
+
+    #[test]
+    fn test_seeded_tcp_connections_close_without_underflow() {
+        let mut aggregator = LifecycleEventAggregator::new();
+        aggregator.seed_tcp_connections(2);
+        let tcp = |old_state, new_state| LifecycleEvent::TcpStateChange {
+            tgid: 1,
+            old_state,
+            new_state,
+            sport: 1,
+            dport: 2,
+        };
+
+        // Закрытие соединения, установленного до старта потока, уменьшает счётчик
+        aggregator.apply_batch(&[tcp(TCP_ESTABLISHED, 4), tcp(2, TCP_ESTABLISHED)]);
+        let summary = aggregator.summary();
+        assert_eq!(summary.active_tcp_connections, 2);
+        assert_eq!(summary.tcp_established_total, 1);
+
+        aggregator.apply_batch(&[tcp(TCP_ESTABLISHED, 4), tcp(TCP_ESTABLISHED, 4)]);
+        assert_eq!(aggregator.summary().active_tcp_connections, 0);
+    }
+
+    #[test]
+    fn test_encode_stream_config() {
+        let config = LifecycleStreamConfig {
+            wakeup_threshold_bytes: 4096,
+            poll_timeout_ms: 100,
+        };
+        let bytes = encode_stream_config(&config, 0b110);
+        assert_eq!(u64::from_ne_bytes(bytes[0..8].try_into().unwrap()), 4096);
+        assert_eq!(u32::from_ne_bytes(bytes[8..12].try_into().unwrap()), 0b110);
+    }
+}
@@ -0,0 +1,339 @@
+//! Операции с файловой системой из eBPF.
+//!
+//! `filesystem_monitor.c` считает открытия, чтения и записи обычных файлов в
+//! программах fexit на `vfs_open`, `vfs_read` и `vfs_write` с реально
+//! переданным объёмом. Режим программы задаётся в карте конфигурации и может
+//! меняться во время работы (см. [`FilesystemMonitorMode`]):
+//! - в режиме счётчиков ведутся только общие per-CPU итоги;
+//! - в детальном режиме дополнительно ведутся per-CPU записи по TGID и по паре
+//!   (файл, процесс) в LRU картах.
+//!
+//! Здесь копии CPU сливаются, а из записей по файлам выбираются самые
+//! нагруженные по объёму, так что в метрики попадает только верх списка.
+
+use super::ebpf_disk::device_name;
+
+/// Имя программы мониторинга файловой системы.
+pub const FILESYSTEM_PROGRAM: &str = "filesystem_monitor";
+
+/// Карта конфигурации программы.
+pub const FILESYSTEM_CONFIG_MAP: &str = "filesystem_config_map";
+
+/// Карта общих per-CPU итогов.
+pub const FS_TOTALS_MAP: &str = "fs_totals_map";
+
+/// Карта итогов по TGID.
+pub const FS_PROCESS_IO_MAP: &str = "fs_process_io_map";
+
+/// Карта операций по паре (файл, процесс).
+pub const FS_FILE_IO_MAP: &str = "fs_file_io_map";
+
+/// Режим программы мониторинга файловой системы.
+#[derive(Debug, Clone, Copy, Default, PartialEq, Eq, serde::Serialize, serde::Deserialize)]
+#[serde(rename_all = "snake_case")]
+pub enum FilesystemMonitorMode {
+    /// Только общие счётчики операций и байт
+    Counters,
+    /// Счётчики по процессам и по файлам
+    #[default]
+    Detailed,
+}
+
+/// Конфигурация в раскладке ядра (`struct filesystem_config`).
+#[repr(C)]
+#[derive(Debug, Clone, Copy, Default, PartialEq, Eq)]
+pub struct RawFilesystemConfig {
+    pub mode: u32,
+    pub pad: u32,
+}
+
+impl RawFilesystemConfig {
+    pub fn new(mode: FilesystemMonitorMode) -> Self {
+        Self {
+            mode: match mode {
+                FilesystemMonitorMode::Counters => 0,
+                FilesystemMonitorMode::Detailed => 1,
+            },
+            pad: 0,
+        }
+    }
+
+    /// Байтовое представление для записи в карту.
+    pub fn to_ne_bytes(self) -> [u8; 8] {
+        let mut bytes = [0u8; 8];
+        bytes[..4].copy_from_slice(&self.mode.to_ne_bytes());
+        bytes[4..].copy_from_slice(&self.pad.to_ne_bytes());
+        bytes
+    }
+}
+
+/// Счётчики операций в раскладке ядра (`struct fs_io_counters`).
+#[repr(C)]
+#[derive(Debug, Clone, Copy, Default, PartialEq, Eq)]
+pub struct RawFsIoCounters {
+    pub reads: u64,
+    pub writes: u64,
+    pub opens: u64,
+    pub bytes_read: u64,
+    pub bytes_written: u64,
+}
+
+impl RawFsIoCounters {
+    pub fn merge(&mut self, other: &Self) {
+        self.reads += other.reads;
+        self.writes += other.writes;
+        self.opens += other.opens;
+        self.bytes_read += other.bytes_read;
+        self.bytes_written += other.bytes_written;
+    }
+
+    /// Сумма копий всех CPU.
+    pub fn merge_per_cpu(per_cpu: &[Self]) -> Self {
+        let mut merged = Self::default();
+        for counters in per_cpu {
+            merged.merge(counters);
+        }
+        merged
+    }
+
+    pub fn total_ops(&self) -> u64 {
+        self.reads + self.writes + self.opens
+    }
+
+    pub fn total_bytes(&self) -> u64 {
+        self.bytes_read + self.bytes_written
+    }
+}
+
+/// Ключ пары (файл, процесс) в раскладке ядра (`struct fs_file_key`).
+#[repr(C)]
+#[derive(Debug, Clone, Copy, Default, PartialEq, Eq, Hash)]
+pub struct RawFsFileKey {
+    pub ino: u64,
+    /// Номер устройства ядра (`s_dev` суперблока)
+    pub dev: u32,
+    pub tgid: u32,
+}
+
+/// Операции процесса с файлом в раскладке ядра (`struct fs_file_stats`).
+#[repr(C)]
+#[derive(Debug, Clone, Copy, Default, PartialEq, Eq)]
+pub struct RawFsFileStats {
+    pub io: RawFsIoCounters,
+    /// Последняя операция на CPU этой копии
+    pub last_access_ns: u64,
+}
+
+/// Статистика по операциям процесса с файлом
+#[derive(Debug, Clone, Default, PartialEq, serde::Serialize, serde::Deserialize)]
+pub struct FilesystemStat {
+    /// Устройство файла в виде `major:minor`
+    pub device: String,
+    /// Номер inode файла
+    pub inode: u64,
+    /// TGID процесса
+    pub tgid: u32,
+    /// Количество операций чтения
+    pub read_count: u64,
+    /// Количество операций записи
+    pub write_count: u64,
+    /// Количество операций открытия
+    pub open_count: u64,
+    /// Количество прочитанных байт
+    pub bytes_read: u64,
+    /// Количество записанных байт
+    pub bytes_written: u64,
+    /// Время последней операции (монотонные наносекунды)
+    pub last_access_ns: u64,
+}
+
+/// Итоги операций с файлами по процессу
+#[derive(Debug, Clone, Default, PartialEq, serde::Serialize, serde::Deserialize)]
+pub struct ProcessFilesystemStat {
+    pub tgid: u32,
+    pub read_count: u64,
+    pub write_count: u64,
+    pub open_count: u64,
+    pub bytes_read: u64,
+    pub bytes_written: u64,
+}
+
+impl ProcessFilesystemStat {
+    pub fn from_raw(tgid: u32, io: &RawFsIoCounters) -> Self {
+        Self {
+            tgid,
+            read_count: io.reads,
+            write_count: io.writes,
+            open_count: io.opens,
+            bytes_read: io.bytes_read,
+            bytes_written: io.bytes_written,
+        }
+    }
+}
+
+/// Порядок верха списка: больше байт, затем больше операций
+fn busier(a: &RawFsIoCounters, b: &RawFsIoCounters) -> std::cmp::Ordering {
+    b.total_bytes()
+        .cmp(&a.total_bytes())
+        .then(b.total_ops().cmp(&a.total_ops()))
+}
+
+/// Выбрать не более `limit` самых нагруженных пар (файл, процесс).
+///
+/// Копии CPU сливаются, время последней операции берётся наибольшее. Записи
+/// без операций пропускаются. Верх выбирается частичной сортировкой за
+/// линейное время, сортируются только выбранные записи.
+pub fn top_files(
+    entries: &[(RawFsFileKey, Vec<RawFsFileStats>)],
+    limit: usize,
+) -> Vec<FilesystemStat> {
+    if limit == 0 {
+        return Vec::new();
+    }
+
+    let mut merged: Vec<(RawFsFileKey, RawFsFileStats)> = entries
+        .iter()
+        .map(|(key, per_cpu)| {
+            let mut stats = RawFsFileStats::default();
+            for copy in per_cpu {
+                stats.io.merge(&copy.io);
+                stats.last_access_ns = stats.last_access_ns.max(copy.last_access_ns);
+            }
+            (*key, stats)
+        })
+        .filter(|(_, stats)| stats.io.total_ops() > 0)
+        .collect();
+
+    let order = |a: &(RawFsFileKey, RawFsFileStats), b: &(RawFsFileKey, RawFsFileStats)| {
+        busier(&a.1.io, &b.1.io)
+            .then((a.0.dev, a.0.ino, a.0.tgid).cmp(&(b.0.dev, b.0.ino, b.0.tgid)))
+    };
+    if merged.len() > limit {
+        merged.select_nth_unstable_by(limit - 1, order);
+        merged.truncate(limit);
+    }
+    merged.sort_by(order);
+
+    merged
+        .into_iter()
+        .map(|(key, stats)| FilesystemStat {
+            device: device_name(key.dev),
+            inode: key.ino,
+            tgid: key.tgid,
+            read_count: stats.io.reads,
+            write_count: stats.io.writes,
+            open_count: stats.io.opens,
+            bytes_read: stats.io.bytes_read,
+            bytes_written: stats.io.bytes_written,
+            last_access_ns: stats.last_access_ns,
+        })
+        .collect()
+}
+
+/// Итоги процессов в порядке убывания объёма, не более `limit` записей.
+pub fn top_processes(
+    entries: &[(u32, Vec<RawFsIoCounters>)],
+    limit: usize,
+) -> Vec<ProcessFilesystemStat> {
+    let mut merged: Vec<(u32, RawFsIoCounters)> = entries
+        .iter()
+        .map(|(tgid, per_cpu)| (*tgid, RawFsIoCounters::merge_per_cpu(per_cpu)))
+        .filter(|(_, io)| io.total_ops() > 0)
+        .collect();
+    merged.sort_by(|a, b| busier(&a.1, &b.1).then(a.0.cmp(&b.0)));
+    merged.truncate(limit);
+
+    merged
+        .iter()
+        .map(|(tgid, io)| ProcessFilesystemStat::from_raw(*tgid, io))
+        .collect()
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    fn io(reads: u64, bytes_read: u64, writes: u64, bytes_written: u64) -> RawFsIoCounters {
+        RawFsIoCounters {
+            reads,
+            writes,
+            opens: 0,
+            bytes_read,
+            bytes_written,
+        }
+    }
+
+    fn file(ino: u64, tgid: u32) -> RawFsFileKey {
+        RawFsFileKey {
+            ino,
+            dev: 259 << 20,
+            tgid,
+        }
+    }
+
+    fn stats(io: RawFsIoCounters, last_access_ns: u64) -> RawFsFileStats {
+        RawFsFileStats { io, last_access_ns }
+    }
+
+    #[test]
+    fn test_layout_matches_kernel() {
+        assert_eq!(std::mem::size_of::<RawFilesystemConfig>(), 8);
+        assert_eq!(std::mem::size_of::<RawFsIoCounters>(), 40);
+        assert_eq!(std::mem::size_of::<RawFsFileKey>(), 16);
+        assert_eq!(std::mem::size_of::<RawFsFileStats>(), 48);
+    }
+
+    #[test]
+    fn test_config_mode() {
+        let counters = RawFilesystemConfig::new(FilesystemMonitorMode::Counters);
+        assert_eq!(counters.to_ne_bytes(), [0u8; 8]);
+        let detailed = RawFilesystemConfig::new(FilesystemMonitorMode::Detailed);
+        assert_eq!(detailed.mode, 1);
+        assert_eq!(
+            FilesystemMonitorMode::default(),
+            FilesystemMonitorMode::Detailed
+        );
+    }
+
+    #[test]
+    fn test_top_files_merges_and_selects() {
+        let entries = vec![
+            (
+                file(10, 100),
+                vec![stats(io(2, 4096, 0, 0), 50), stats(io(1, 1024, 0, 0), 70)],
+            ),
+            (file(11, 100), vec![stats(io(0, 0, 8, 1 << 20), 60)]),
+            (file(12, 200), vec![stats(io(1, 100, 0, 0), 10)]),
+            (file(13, 200), vec![stats(RawFsIoCounters::default(), 0)]),
+        ];
+
+        let top = top_files(&entries, 2);
+        assert_eq!(top.len(), 2);
+        assert_eq!(top[0].inode, 11);
+        assert_eq!(top[0].device, "259:0");
+        assert_eq!(top[0].bytes_written, 1 << 20);
+        assert_eq!(top[1].inode, 10);
+        assert_eq!(top[1].read_count, 3);
+        assert_eq!(top[1].bytes_read, 5120);
+        assert_eq!(top[1].last_access_ns, 70);
+
+        // Пустые записи не попадают в список даже без ограничения
+        assert_eq!(top_files(&entries, 10).len(), 3);
+        assert!(top_files(&entries, 0).is_empty());
+    }
+
+    #[test]
+    fn test_top_processes() {
+        let entries = vec![
+            (100, vec![io(1, 10, 0, 0), io(1, 10, 0, 0)]),
+            (200, vec![io(0, 0, 1, 4096)]),
+            (300, vec![RawFsIoCounters::default()]),
+        ];
+
+        let top = top_processes(&entries, 10);
+        assert_eq!(top.len(), 2);
+        assert_eq!(top[0].tgid, 200);
+        assert_eq!(top[1].read_count, 2);
+        assert_eq!(top[1].bytes_read, 20);
+    }
+}
@@ -0,0 +1,221 @@
+//! Фильтрация событий eBPF на уровне ядра.
+//!
+//! Общий заголовок `ebpf_programs/smoothtask_filter.h` добавляет в программы
+//! небольшие карты фильтров: флаги активных фильтров, разрешённые TGID,
+//! разрешённые cgroup v2 и разрешённые номера системных вызовов. Обработчики
+//! проверяют их до любых записей в карты, поэтому отфильтрованные события не
+//! тратят ни время в ядре, ни память карт.
+//!
+//! Здесь описано содержимое этих карт: [`KernelFilterSet`] строится из
+//! конфигурации фильтрации и записывается во все загруженные объекты при
+//! инициализации и при каждом изменении фильтров.
+
+use std::io;
+use std::path::Path;
+
+/// Карта флагов активных фильтров.
+pub const FILTER_CONFIG_MAP_NAME: &str = "smoothtask_filter_config_map";
+
+/// Карта разрешённых процессов (TGID).
+pub const FILTER_PID_MAP_NAME: &str = "smoothtask_filter_pid_map";
+
+/// Карта разрешённых cgroup (идентификатор cgroup v2).
+pub const FILTER_CGROUP_MAP_NAME: &str = "smoothtask_filter_cgroup_map";
+
+/// Карта разрешённых номеров системных вызовов.
+pub const FILTER_SYSCALL_MAP_NAME: &str = "smoothtask_filter_syscall_map";
+
+/// Фильтр по TGID включён.
+pub const FILTER_FLAG_PID: u32 = 1 << 0;
+/// Фильтр по cgroup (вместе с поддеревом) включён.
+pub const FILTER_FLAG_CGROUP: u32 = 1 << 1;
+/// Фильтр по номеру системного вызова включён.
+pub const FILTER_FLAG_SYSCALL: u32 = 1 << 2;
+
+/// Ёмкость карты разрешённых процессов.
+pub const MAX_FILTER_PIDS: usize = 1024;
+/// Ёмкость карты разрешённых cgroup.
+pub const MAX_FILTER_CGROUPS: usize = 64;
+/// Размер таблицы разрешённых системных вызовов.
+pub const MAX_FILTER_SYSCALLS: u32 = 512;
+
+/// Точка монтирования cgroup v2 по умолчанию.
+pub const DEFAULT_CGROUP_ROOT: &str = "/sys/fs/cgroup";
+
+/// Значение `smoothtask_filter_config_map` в раскладке ядра.
+#[repr(C)]
+#[derive(Debug, Clone, Copy, Default, PartialEq, Eq)]
+pub struct RawFilterConfig {
+    pub flags: u32,
+    pub _pad: u32,
+}
+
+impl RawFilterConfig {
+    /// Байтовое представление для записи в карту.
+    pub fn to_ne_bytes(self) -> [u8; 8] {
+        let mut bytes = [0u8; 8];
+        bytes[..4].copy_from_slice(&self.flags.to_ne_bytes());
+        bytes[4..].copy_from_slice(&self._pad.to_ne_bytes());
+        bytes
+    }
+}
+
+/// Содержимое карт фильтров ядра.
+///
+/// `None` означает, что фильтр выключен и пропускает все события.
+#[derive(Debug, Clone, Default, PartialEq, Eq)]
+pub struct KernelFilterSet {
+    /// Разрешённые TGID
+    pub pids: Option<Vec<u32>>,
+    /// Разрешённые идентификаторы cgroup
+    pub cgroup_ids: Option<Vec<u64>>,
+    /// Разрешённые номера системных вызовов
+    pub syscalls: Option<Vec<u32>>,
+}
+
+impl KernelFilterSet {
+    /// Собрать набор фильтров из списков конфигурации.
+    ///
+    /// Пустой список выключает фильтр (как и в userspace фильтрации), повторы
+    /// удаляются, а номера вне таблицы и элементы сверх ёмкости карт ядра
+    /// отбрасываются.
+    pub fn new(pids: Option<&[u32]>, cgroup_ids: Option<&[u64]>, syscalls: Option<&[u32]>) -> Self {
+        Self {
+            pids: normalize(pids, MAX_FILTER_PIDS),
+            cgroup_ids: normalize(cgroup_ids, MAX_FILTER_CGROUPS),
+            syscalls: normalize(
+                syscalls
+                    .map(|ids| ids.iter().copied().filter(|&id| id < MAX_FILTER_SYSCALLS))
+                    .map(Iterator::collect::<Vec<_>>)
+                    .as_deref(),
+                usize::MAX,
+            ),
+        }
+    }
+
+    /// Включён ли хотя бы один фильтр.
+    pub fn is_active(&self) -> bool {
+        self.raw_config().flags != 0
+    }
+
+    /// Значение карты флагов.
+    pub fn raw_config(&self) -> RawFilterConfig {
+        let mut flags = 0;
+        if self.pids.is_some() {
+            flags |= FILTER_FLAG_PID;
+        }
+        if self.cgroup_ids.is_some() {
+            flags |= FILTER_FLAG_CGROUP;
+        }
+        if self.syscalls.is_some() {
+            flags |= FILTER_FLAG_SYSCALL;
+        }
+        RawFilterConfig { flags, _pad: 0 }
+    }
+
+    /// Таблица разрешённых системных вызовов: одно значение на номер.
+    pub fn syscall_table(&self) -> Vec<u8> {
+        let mut table = vec![0u8; MAX_FILTER_SYSCALLS as usize];
+        for &id in self.syscalls.iter().flatten() {
+            table[id as usize] = 1;
+        }
+        table
+    }
+}
+
+fn normalize<T: Copy + Ord>(values: Option<&[T]>, capacity: usize) -> Option<Vec<T>> {
+    let values = values.filter(|values| !values.is_empty())?;
+    let mut values = values.to_vec();
+    values.sort_unstable();
+    values.dedup();
+    values.truncate(capacity);
+    Some(values)
+}
+
+/// Идентификатор cgroup v2 по пути относительно корня иерархии.
+///
+/// Идентификатор, возвращаемый `bpf_get_current_cgroup_id()`, совпадает с
+/// номером inode каталога cgroup.
+pub fn resolve_cgroup_id(root: &Path, cgroup: &str) -> io::Result<u64> {
+    use std::os::unix::fs::MetadataExt;
+
+    let relative = cgroup.trim_start_matches('/');
+    let metadata = std::fs::metadata(root.join(relative))?;
+    if !metadata.is_dir() {
+        return Err(io::Error::new(
+            io::ErrorKind::InvalidInput,
+            format!("{} не является каталогом cgroup", cgroup),
+        ));
+    }
+    Ok(metadata.ino())
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    #[test]
+    fn test_layout_matches_kernel() {
+        assert_eq!(std::mem::size_of::<RawFilterConfig>(), 8);
+        let raw = RawFilterConfig {
+            flags: FILTER_FLAG_CGROUP,
+            _pad: 0,
+        };
+        assert_eq!(&raw.to_ne_bytes()[..4], &FILTER_FLAG_CGROUP.to_ne_bytes());
+    }
+
+    #[test]
+    fn test_empty_lists_disable_filters() {
+        let set = KernelFilterSet::new(Some(&[]), None, Some(&[]));
+        assert_eq!(set, KernelFilterSet::default());
+        assert!(!set.is_active());
+        assert!(set.syscall_table().iter().all(|&allowed| allowed == 0));
+        // Список только из недопустимых номеров тоже выключает фильтр
+        assert!(KernelFilterSet::new(None, None, Some(&[9999]))
+            .syscalls
+            .is_none());
+    }
+
+    #[test]
+    fn test_flags_and_normalization() {
+        let set = KernelFilterSet::new(Some(&[42, 7, 42]), Some(&[100]), Some(&[1, 0, 9999]));
+        assert_eq!(set.pids, Some(vec![7, 42]));
+        assert_eq!(
+            set.raw_config().flags,
+            FILTER_FLAG_PID | FILTER_FLAG_CGROUP | FILTER_FLAG_SYSCALL
+        );
+        // Номера вне таблицы ядра отбрасываются
+        assert_eq!(set.syscalls, Some(vec![0, 1]));
+        let table = set.syscall_table();
+        assert_eq!(table.len(), MAX_FILTER_SYSCALLS as usize);
+        assert_eq!((table[0], table[1], table[2]), (1, 1, 0));
+    }
+
+    #[test]
+    fn test_pid_capacity() {
+        let pids: Vec<u32> = (0..(MAX_FILTER_PIDS as u32 + 10)).collect();
+        let set = KernelFilterSet::new(Some(&pids), None, None);
+        assert_eq!(set.pids.map(|pids| pids.len()), Some(MAX_FILTER_PIDS));
+    }
+
+    #[test]
+    fn test_resolve_cgroup_id() {
+        use std::os::unix::fs::MetadataExt;
+        use tempfile::tempdir;
+
+        let root = tempdir().unwrap();
+        let cgroup = root.path().join("user.slice");
+        std::fs::create_dir(&cgroup).unwrap();
+        let expected = std::fs::metadata(&cgroup).unwrap().ino();
+
+        assert_eq!(
+            resolve_cgroup_id(root.path(), "/user.slice").unwrap(),
+            expected
+        );
+        assert_eq!(
+            resolve_cgroup_id(root.path(), "user.slice").unwrap(),
+            expected
+        );
+        assert!(resolve_cgroup_id(root.path(), "missing.slice").is_err());
+    }
+}
@@ -0,0 +1,407 @@
+//! Учёт загрузки GPU по кольцам планировщика DRM и по процессам.
+//!
+//! Программа `gpu_monitor.c` сопоставляет запуск и завершение каждого
+//! задания `drm_sched` по его fence и накапливает время занятости в двух
+//! картах:
+//! - `gpu_ring_stats_map` — по кольцу планировщика (`gfx_0.0.0`, `sdma0`, ...)
+//!   с именем кольца и устройства;
+//! - `gpu_process_usage_map` — по паре (TGID отправителя, кольцо).
+//!
+//! Счётчики в картах только растут. Здесь кольца группируются в устройства
+//! по имени устройства, а загрузка в процентах считается по приросту времени
+//! занятости между замерами ([`GpuBusySampler`]).
+
+use std::collections::HashMap;
+use std::hash::Hash;
+use std::time::{Duration, Instant};
+
+use super::ebpf_sched::comm_to_string;
+
+/// Программа учёта заданий GPU.
+pub const GPU_PROGRAM: &str = "gpu_monitor";
+
+/// Карта статистики колец.
+pub const GPU_RING_STATS_MAP: &str = "gpu_ring_stats_map";
+
+/// Карта времени процессов на кольцах.
+pub const GPU_PROCESS_USAGE_MAP: &str = "gpu_process_usage_map";
+
+/// Имя устройства для колец, планировщик которых не хранит устройство.
+pub const UNKNOWN_GPU_DEVICE: &str = "gpu";
+
+/// Минимальный интервал между замерами загрузки.
+///
+/// Устройства и процессы собираются в одном цикле несколькими вызовами;
+/// повторный замер в пределах интервала возвращает прежние значения, а не
+/// загрузку за несколько миллисекунд.
+pub const MIN_SAMPLE_INTERVAL: Duration = Duration::from_millis(100);
+
+/// Запись `gpu_ring_stats_map` в раскладке ядра (`struct gpu_ring_stats`).
+#[repr(C)]
+#[derive(Debug, Clone, Copy, Default, PartialEq, Eq)]
+pub struct RawGpuRingStats {
+    /// Адрес `drm_gpu_scheduler` кольца
+    pub ring: u64,
+    /// Время, когда на кольце выполнялось задание
+    pub busy_ns: u64,
+    /// Завершённые задания
+    pub jobs: u64,
+    pub last_done_ns: u64,
+    pub name: [u8; 16],
+    pub device: [u8; 32],
+}
+
+impl RawGpuRingStats {
+    /// Имя кольца планировщика.
+    pub fn name(&self) -> String {
+        comm_to_string(&self.name)
+    }
+
+    /// Имя устройства кольца.
+    pub fn device(&self) -> String {
+        match comm_to_string(&self.device) {
+            device if device.is_empty() => UNKNOWN_GPU_DEVICE.to_string(),
+            device => device,
+        }
+    }
+}
+
+/// Запись `gpu_process_usage_map` в раскладке ядра (`struct gpu_process_usage`).
+#[repr(C)]
+#[derive(Debug, Clone, Copy, Default, PartialEq, Eq)]
+pub struct RawGpuProcessUsage {
+    pub ring: u64,
+    pub tgid: u32,
+    pub pad: u32,
+    pub busy_ns: u64,
+    pub jobs: u64,
+    pub last_update_ns: u64,
+}
+
+/// Соответствие колец устройствам.
+///
+/// Идентификатор устройства — номер его имени в отсортированном списке, так
+/// что он не зависит от порядка обхода карты.
+#[derive(Debug, Clone, Default, PartialEq)]
+pub struct GpuTopology {
+    devices: Vec<String>,
+    ring_device: HashMap<u64, u32>,
+}
+
+impl GpuTopology {
+    /// Построить соответствие по записям колец.
+    pub fn from_rings(rings: &[RawGpuRingStats]) -> Self {
+        let mut devices: Vec<String> = rings.iter().map(RawGpuRingStats::device).collect();
+        devices.sort();
+        devices.dedup();
+
+        let ring_device = rings
+            .iter()
+            .map(|ring| {
+                let device = ring.device();
+                let gpu_id = devices.binary_search(&device).unwrap_or_default();
+                (ring.ring, gpu_id as u32)
+            })
+            .collect();
+
+        Self {
+            devices,
+            ring_device,
+        }
+    }
+
+    /// Имена устройств по порядку идентификаторов.
+    pub fn devices(&self) -> &[String] {
+        &self.devices
+    }
+
+    /// Идентификатор устройства кольца.
+    pub fn gpu_id(&self, ring: u64) -> Option<u32> {
+        self.ring_device.get(&ring).copied()
+    }
+}
+
+/// Загрузка устройства GPU.
+#[derive(Debug, Clone, PartialEq)]
+pub struct GpuDeviceUsage {
+    pub gpu_id: u32,
+    pub device: String,
+    /// Суммарное время занятости колец устройства
+    pub busy_ns: u64,
+    pub jobs: u64,
+    /// Загрузка самого занятого кольца за последний интервал (%)
+    pub usage_percent: f64,
+    /// Кольца, выполнявшие задания за последний интервал
+    pub active_rings: u32,
+}
+
+/// Свернуть кольца в устройства.
+///
+/// `ring_rates` — загрузка колец в процентах по адресу кольца (см.
+/// [`GpuBusySampler`]). Кольца одного устройства работают параллельно, поэтому
+/// загрузка устройства — максимум по его кольцам, а не сумма.
+pub fn device_usage(
+    topology: &GpuTopology,
+    rings: &[RawGpuRingStats],
+    ring_rates: &HashMap<u64, f64>,
+) -> Vec<GpuDeviceUsage> {
+    let mut devices: Vec<GpuDeviceUsage> = topology
+        .devices()
+        .iter()
+        .enumerate()
+        .map(|(gpu_id, device)| GpuDeviceUsage {
+            gpu_id: gpu_id as u32,
+            device: device.clone(),
+            busy_ns: 0,
+            jobs: 0,
+            usage_percent: 0.0,
+            active_rings: 0,
+        })
+        .collect();
+
+    for ring in rings {
+        let Some(device) = topology
+            .gpu_id(ring.ring)
+            .and_then(|gpu_id| devices.get_mut(gpu_id as usize))
+        else {
+            continue;
+        };
+        let rate = ring_rates.get(&ring.ring).copied().unwrap_or(0.0);
+
+        device.busy_ns += ring.busy_ns;
+        device.jobs += ring.jobs;
+        device.usage_percent = device.usage_percent.max(rate);
+        if rate > 0.0 {
+            device.active_rings += 1;
+        }
+    }
+
+    devices
+}
+
+/// Время GPU процесса по всем кольцам.
+#[derive(Debug, Clone, Copy, Default, PartialEq, Eq)]
+pub struct GpuProcessUsage {
+    pub tgid: u32,
+    pub busy_ns: u64,
+    pub jobs: u64,
+    pub last_update_ns: u64,
+    /// Устройство, на котором процесс провёл больше всего времени
+    pub gpu_id: u32,
+}
+
+/// Свернуть записи (процесс, кольцо) в записи процессов.
+pub fn fold_process_usage(
+    topology: &GpuTopology,
+    usage: &[RawGpuProcessUsage],
+) -> HashMap<u32, GpuProcessUsage> {
+    let mut per_device: HashMap<(u32, u32), u64> = HashMap::new();
+    let mut processes: HashMap<u32, GpuProcessUsage> = HashMap::new();
+
+    for record in usage.iter().filter(|record| record.tgid != 0) {
+        let process = processes.entry(record.tgid).or_insert(GpuProcessUsage {
+            tgid: record.tgid,
+            ..Default::default()
+        });
+        process.busy_ns += record.busy_ns;
+        process.jobs += record.jobs;
+        process.last_update_ns = process.last_update_ns.max(record.last_update_ns);
+
+        let gpu_id = topology.gpu_id(record.ring).unwrap_or_default();
+        *per_device.entry((record.tgid, gpu_id)).or_default() += record.busy_ns;
+    }
+
+    for process in processes.values_mut() {
+        process.gpu_id = per_device
+            .iter()
+            .filter(|((tgid, _), _)| *tgid == process.tgid)
+            .max_by_key(|((_, gpu_id), busy_ns)| (**busy_ns, std::cmp::Reverse(*gpu_id)))
+            .map(|((_, gpu_id), _)| *gpu_id)
+            .unwrap_or_default();
+    }
+
+    processes
+}
+
+/// Загрузка в процентах по приросту растущих счётчиков времени занятости.
+///
+/// Первый замер только запоминает значения и даёт нулевую загрузку. Ключи,
+/// пропавшие из карты, забываются.
+#[derive(Debug)]
+pub struct GpuBusySampler<K> {
+    last_sample: Option<Instant>,
+    busy_ns: HashMap<K, u64>,
+    rates: HashMap<K, f64>,
+}
+
+impl<K> Default for GpuBusySampler<K> {
+    fn default() -> Self {
+        Self {
+            last_sample: None,
+            busy_ns: HashMap::new(),
+            rates: HashMap::new(),
+        }
+    }
+}
+
+impl<K: Eq + Hash + Clone> GpuBusySampler<K> {
+    pub fn new() -> Self {
+        Self::default()
+    }
+
+    /// Замерить загрузку по текущим значениям счётчиков.
+    pub fn sample<I>(&mut self, now: Instant, current: I) -> HashMap<K, f64>
+    where
+        I: IntoIterator<Item = (K, u64)>,
+    {
+        let elapsed = match self.last_sample {
+            Some(last) if now.saturating_duration_since(last) < MIN_SAMPLE_INTERVAL => {
+                return self.rates.clone();
+            }
+            Some(last) => now.saturating_duration_since(last).as_nanos() as f64,
+            None => 0.0,
+        };
+
+        let busy_ns: HashMap<K, u64> = current.into_iter().collect();
+        self.rates = busy_ns
+            .iter()
+            .map(|(key, &busy)| {
+                let rate = match self.busy_ns.get(key) {
+                    Some(&previous) if elapsed > 0.0 => {
+                        (busy.saturating_sub(previous) as f64 * 100.0 / elapsed).min(100.0)
+                    }
+                    _ => 0.0,
+                };
+                (key.clone(), rate)
+            })
+            .collect();
+        self.busy_ns = busy_ns;
+        self.last_sample = Some(now);
+
+        self.rates.clone()
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    fn ring(address: u64, name: &str, device: &str, busy_ns: u64) -> RawGpuRingStats {
+        let mut stats = RawGpuRingStats {
+            ring: address,
+            busy_ns,
+            jobs: 1,
+            ..Default::default()
+        };
+        stats.name[..name.len()].copy_from_slice(name.as_bytes());
+        stats.device[..device.len()].copy_from_slice(device.as_bytes());
+        stats
+    }
+
+    #[test]
+    fn test_layout_matches_kernel() {
+        assert_eq!(std::mem::size_of::<RawGpuRingStats>(), 80);
+        assert_eq!(std::mem::size_of::<RawGpuProcessUsage>(), 40);
+    }
+
+    #[test]
+    fn test_rings_grouped_by_device() {
+        let rings = [
+            ring(0x30, "sdma0", "0000:03:00.0", 200),
+            ring(0x10, "gfx_0.0.0", "0000:03:00.0", 500),
+            ring(0x20, "gfx_0.0.0", "0000:0a:00.0", 100),
+            ring(0x40, "ring0", "", 50),
+        ];
+        let topology = GpuTopology::from_rings(&rings);
+
+        assert_eq!(topology.devices(), ["0000:03:00.0", "0000:0a:00.0", "gpu"]);
+        assert_eq!(topology.gpu_id(0x10), Some(0));
+        assert_eq!(topology.gpu_id(0x30), Some(0));
+        assert_eq!(topology.gpu_id(0x20), Some(1));
+        assert_eq!(topology.gpu_id(0x40), Some(2));
+        assert_eq!(rings[1].name(), "gfx_0.0.0");
+
+        let rates = HashMap::from([(0x10, 40.0), (0x30, 75.0), (0x20, 0.0)]);
+        let devices = device_usage(&topology, &rings, &rates);
+
+        assert_eq!(devices.len(), 3);
+        assert_eq!(devices[0].busy_ns, 700);
+        assert_eq!(devices[0].jobs, 2);
+        assert_eq!(devices[0].usage_percent, 75.0);
+        assert_eq!(devices[0].active_rings, 2);
+        assert_eq!(devices[1].usage_percent, 0.0);
+        assert_eq!(devices[1].active_rings, 0);
+    }
+
+    #[test]
+    fn test_process_usage_folded_over_rings() {
+        let rings = [
+            ring(0x10, "gfx_0.0.0", "0000:03:00.0", 0),
+            ring(0x20, "gfx_0.0.0", "0000:0a:00.0", 0),
+        ];
+        let topology = GpuTopology::from_rings(&rings);
+        let usage = [
+            RawGpuProcessUsage {
+                ring: 0x10,
+                tgid: 100,
+                busy_ns: 300,
+                jobs: 3,
+                last_update_ns: 10,
+                ..Default::default()
+            },
+            RawGpuProcessUsage {
+                ring: 0x20,
+                tgid: 100,
+                busy_ns: 900,
+                jobs: 1,
+                last_update_ns: 20,
+                ..Default::default()
+            },
+            RawGpuProcessUsage {
+                ring: 0x10,
+                tgid: 200,
+                busy_ns: 50,
+                jobs: 1,
+                ..Default::default()
+            },
+        ];
+
+        let processes = fold_process_usage(&topology, &usage);
+
+        assert_eq!(processes.len(), 2);
+        let game = processes[&100];
+        assert_eq!(game.busy_ns, 1200);
+        assert_eq!(game.jobs, 4);
+        assert_eq!(game.last_update_ns, 20);
+        assert_eq!(game.gpu_id, 1);
+        assert_eq!(processes[&200].gpu_id, 0);
+    }
+
+    #[test]
+    fn test_busy_sampler_rates() {
+        let start = Instant::now();
+        let mut sampler = GpuBusySampler::new();
+
+        // Первый замер — только база
+        let rates = sampler.sample(start, [(1u64, 1_000), (2, 5_000)]);
+        assert_eq!(rates[&1], 0.0);
+
+        // За 1 с кольцо 1 занято 250 мс, кольцо 2 — простаивает
+        let second = start + Duration::from_secs(1);
+        let rates = sampler.sample(second, [(1u64, 250_001_000), (2, 5_000)]);
+        assert!((rates[&1] - 25.0).abs() < 1e-9);
+        assert_eq!(rates[&2], 0.0);
+
+        // Повторный замер в пределах интервала возвращает прежние значения
+        let rates = sampler.sample(second + Duration::from_millis(5), [(1u64, u64::MAX)]);
+        assert!((rates[&1] - 25.0).abs() < 1e-9);
+        assert!(rates.contains_key(&2));
+
+        // Новое кольцо сначала получает базу; загрузка не превышает 100%
+        let third = second + Duration::from_secs(1);
+        let rates = sampler.sample(third, [(1u64, 5_000_000_000), (3, 10)]);
+        assert_eq!(rates[&1], 100.0);
+        assert_eq!(rates[&3], 0.0);
+        assert!(!rates.contains_key(&2));
+    }
+}
@@ -0,0 +1,563 @@
+//! Гистограммы задержек системных вызовов из eBPF.
+//!
+//! `syscall_monitor.c` хранит время входа в системный вызов отдельно
+//! для каждого потока и накапливает задержки в per-CPU log2 гистограммах:
+//! интервал `N` содержит задержки из `[2^N, 2^(N+1))` наносекунд. Этот модуль
+//! описывает раскладку гистограмм в ядре, сливает значения всех CPU и
+//! оценивает перцентили (p50/p99) для API и Prometheus экспортера.
+//!
+//! Гистограммы в ядре накапливаются с загрузки программы, поэтому среднее и
+//! перцентили считаются по приросту с прошлого сбора ([`LatencyWindow`]):
+//! иначе через несколько часов работы они перестали бы отражать текущие
+//! задержки. Счётчики вызовов и интервалы гистограммы остаются накопленными.
+
+use std::collections::HashMap;
+use std::hash::Hash;
+
+/// Количество log2 интервалов гистограммы (совпадает с SMOOTHTASK_LATENCY_BUCKETS в ядре).
+pub const LATENCY_BUCKETS: usize = 32;
+
+/// Имя карты глобальных гистограмм по номеру системного вызова.
+pub const SYSCALL_LATENCY_HIST_MAP_NAME: &str = "syscall_latency_hist_map";
+
+/// Имя карты гистограмм по процессу и номеру системного вызова.
+pub const SYSCALL_APP_LATENCY_MAP_NAME: &str = "syscall_app_latency_map";
+
+/// Имя карты номеров системных вызовов с гистограммами по процессам.
+pub const SYSCALL_APP_FILTER_MAP_NAME: &str = "syscall_app_filter_map";
+
+/// Гистограмма задержек в раскладке ядра (`struct smoothtask_latency_hist`).
+#[repr(C)]
+#[derive(Debug, Clone, Copy, Default, PartialEq, Eq)]
+pub struct RawLatencyHistogram {
+    pub count: u64,
+    pub total_time_ns: u64,
+    pub buckets: [u64; LATENCY_BUCKETS],
+}
+
+/// Ключ гистограммы процесса (`struct syscall_app_key`).
+#[repr(C)]
+#[derive(Debug, Clone, Copy, Default, PartialEq, Eq, Hash)]
+pub struct RawSyscallAppKey {
+    pub tgid: u32,
+    pub syscall_id: u32,
+}
+
+impl RawLatencyHistogram {
+    /// Прибавить значения другой гистограммы (например, другого CPU).
+    pub fn merge(&mut self, other: &Self) {
+        self.count = self.count.saturating_add(other.count);
+        self.total_time_ns = self.total_time_ns.saturating_add(other.total_time_ns);
+        for (bucket, value) in self.buckets.iter_mut().zip(other.buckets.iter()) {
+            *bucket = bucket.saturating_add(*value);
+        }
+    }
+
+    /// Слить per-CPU значения одной записи карты.
+    pub fn merge_per_cpu<'a, I>(per_cpu: I) -> Self
+    where
+        I: IntoIterator<Item = &'a RawLatencyHistogram>,
+    {
+        let mut merged = Self::default();
+        for value in per_cpu {
+            merged.merge(value);
+        }
+        merged
+    }
+
+    /// Прирост гистограммы с предыдущего снимка `previous` той же записи.
+    ///
+    /// Если гистограмма уменьшилась (запись вытеснена из LRU карты и создана
+    /// заново), приростом считается она целиком.
+    pub fn delta_since(&self, previous: &Self) -> Self {
+        if self.count < previous.count {
+            return *self;
+        }
+
+        let mut delta = Self {
+            count: self.count - previous.count,
+            total_time_ns: self.total_time_ns.saturating_sub(previous.total_time_ns),
+            buckets: [0; LATENCY_BUCKETS],
+        };
+        for ((bucket, current), before) in delta
+            .buckets
+            .iter_mut()
+            .zip(self.buckets.iter())
+            .zip(previous.buckets.iter())
+        {
+            *bucket = current.saturating_sub(*before);
+        }
+        delta
+    }
+
+    /// Нет ни одного измерения.
+    pub fn is_empty(&self) -> bool {
+        self.count == 0
+    }
+
+    /// Средняя задержка в наносекундах.
+    pub fn mean_ns(&self) -> u64 {
+        if self.count == 0 {
+            0
+        } else {
+            self.total_time_ns / self.count
+        }
+    }
+
+    /// Оценка перцентиля `quantile` (0.0..=1.0) в наносекундах.
+    ///
+    /// Внутри найденного интервала значение интерполируется линейно, поэтому
+    /// погрешность не превышает ширины log2 интервала.
+    pub fn percentile_ns(&self, quantile: f64) -> u64 {
+        let total: u64 = self.buckets.iter().sum();
+        if total == 0 {
+            return 0;
+        }
+
+        let rank = (quantile.clamp(0.0, 1.0) * total as f64).ceil().max(1.0) as u64;
+        let mut seen = 0u64;
+        for (index, &in_bucket) in self.buckets.iter().enumerate() {
+            if in_bucket == 0 {
+                continue;
+            }
+            if seen + in_bucket >= rank {
+                let lower = bucket_lower_bound_ns(index);
+                let upper = bucket_upper_bound_ns(index);
+                let fraction = (rank - seen) as f64 / in_bucket as f64;
+                return lower + ((upper - lower) as f64 * fraction) as u64;
+            }
+            seen += in_bucket;
+        }
+
+        bucket_upper_bound_ns(LATENCY_BUCKETS - 1)
+    }
+}
+
+/// Нижняя граница интервала гистограммы в наносекундах.
+pub fn bucket_lower_bound_ns(index: usize) -> u64 {
+    if index == 0 {
+        0
+    } else {
+        1u64 << index.min(63)
+    }
+}
+
+/// Верхняя граница интервала гистограммы в наносекундах.
+pub fn bucket_upper_bound_ns(index: usize) -> u64 {
+    1u64 << (index + 1).min(63)
+}
+
+/// Накопленные гистограммы предыдущего сбора по ключу записи
+#[derive(Debug)]
+pub struct LatencyWindow<K> {
+    previous: HashMap<K, RawLatencyHistogram>,
+}
+
+impl<K> Default for LatencyWindow<K> {
+    fn default() -> Self {
+        Self {
+            previous: HashMap::new(),
+        }
+    }
+}
+
+impl<K: Eq + Hash + Copy> LatencyWindow<K> {
+    pub fn new() -> Self {
+        Self::default()
+    }
+
+    /// Прирост гистограмм `current` с прошлого сбора.
+    ///
+    /// При первом сборе и для новых ключей приростом считается вся
+    /// гистограмма. Ключи, пропавшие из карты, забываются.
+    pub fn advance(
+        &mut self,
+        current: &HashMap<K, RawLatencyHistogram>,
+    ) -> HashMap<K, RawLatencyHistogram> {
+        let deltas = current
+            .iter()
+            .map(|(key, hist)| {
+                let delta = match self.previous.get(key) {
+                    Some(previous) => hist.delta_since(previous),
+                    None => *hist,
+                };
+                (*key, delta)
+            })
+            .collect();
+        self.previous = current.clone();
+        deltas
+    }
+}
+
+/// Сводка задержек системного вызова для API и Prometheus.
+#[derive(Debug, Clone, Default, PartialEq, serde::Serialize, serde::Deserialize)]
+pub struct SyscallLatencyStat {
+    /// Номер системного вызова
+    pub syscall_id: u32,
+    /// Имя системного вызова (если известно)
+    #[serde(default)]
+    pub syscall_name: Option<String>,
+    /// TGID процесса для гистограмм по процессам, `None` — по всей системе
+    #[serde(default)]
+    pub tgid: Option<u32>,
+    /// Количество завершённых вызовов
+    pub count: u64,
+    /// Суммарное время выполнения (наносекунды)
+    pub total_time_ns: u64,
+    /// Количество вызовов с прошлого сбора, по которым посчитаны среднее и перцентили
+    #[serde(default)]
+    pub interval_count: u64,
+    /// Среднее время выполнения с прошлого сбора (наносекунды)
+    pub avg_time_ns: u64,
+    /// Медиана задержки с прошлого сбора (наносекунды)
+    pub p50_ns: u64,
+    /// 99-й перцентиль задержки с прошлого сбора (наносекунды)
+    pub p99_ns: u64,
+    /// Количество вызовов в log2 интервалах (интервал N — задержки из [2^N, 2^(N+1)) нс)
+    #[serde(default)]
+    pub buckets: Vec<u64>,
+}
+
+impl SyscallLatencyStat {
+    /// Построить сводку по слитой гистограмме.
+    ///
+    /// `total` — гистограмма с загрузки программы, `interval` — её прирост
+    /// с прошлого сбора (см. [`LatencyWindow`]).
+    pub fn from_histograms(
+        syscall_id: u32,
+        tgid: Option<u32>,
+        total: &RawLatencyHistogram,
+        interval: &RawLatencyHistogram,
+    ) -> Self {
+        // Хвост из пустых интервалов не передаём
+        let used = total
+            .buckets
+            .iter()
+            .rposition(|&value| value != 0)
+            .map_or(0, |index| index + 1);
+
+        Self {
+            syscall_id,
+            syscall_name: syscall_name(syscall_id).map(str::to_string),
+            tgid,
+            count: total.count,
+            total_time_ns: total.total_time_ns,
+            interval_count: interval.count,
+            avg_time_ns: interval.mean_ns(),
+            p50_ns: interval.percentile_ns(0.50),
+            p99_ns: interval.percentile_ns(0.99),
+            buckets: total.buckets[..used].to_vec(),
+        }
+    }
+
+    /// Построить сводку, в которой интервал совпадает со всей гистограммой.
+    pub fn from_histogram(syscall_id: u32, tgid: Option<u32>, hist: &RawLatencyHistogram) -> Self {
+        Self::from_histograms(syscall_id, tgid, hist, hist)
+    }
+}
+
+/// Ключ сводки: процесс (`None` — вся система) и номер системного вызова
+pub type SyscallLatencyKey = (Option<u32>, u32);
+
+/// Сводки задержек по накопленным гистограммам всех записей карт.
+///
+/// Записи без измерений пропускаются; среднее и перцентили считаются по
+/// приросту с прошлого вызова `window`. Сводки упорядочены по ключу.
+pub fn syscall_latency_stats(
+    window: &mut LatencyWindow<SyscallLatencyKey>,
+    totals: &HashMap<SyscallLatencyKey, RawLatencyHistogram>,
+) -> Vec<SyscallLatencyStat> {
+    let intervals = window.advance(totals);
+    let mut stats: Vec<SyscallLatencyStat> = totals
+        .iter()
+        .filter(|(_, total)| !total.is_empty())
+        .map(|(&(tgid, syscall_id), total)| {
+            let interval = intervals.get(&(tgid, syscall_id)).unwrap_or(total);
+            SyscallLatencyStat::from_histograms(syscall_id, tgid, total, interval)
+        })
+        .collect();
+    stats.sort_unstable_by_key(|stat| (stat.tgid, stat.syscall_id));
+    stats
+}
+
+/// Номера системных вызовов, задержки которых важны для приоритизации
+/// приложений и по умолчанию отслеживаются по процессам.
+#[cfg(target_arch = "x86_64")]
+const KNOWN_SYSCALLS: &[(u32, &str)] = &[
+    (0, "read"),
+    (1, "write"),
+    (7, "poll"),
+    (17, "pread64"),
+    (18, "pwrite64"),
+    (202, "futex"),
+    (232, "epoll_wait"),
+    (281, "epoll_pwait"),
+    (426, "io_uring_enter"),
+];
+
+#[cfg(target_arch = "aarch64")]
+const KNOWN_SYSCALLS: &[(u32, &str)] = &[
+    (63, "read"),
+    (64, "write"),
+    (67, "pread64"),
+    (68, "pwrite64"),
+    (73, "ppoll"),
+    (98, "futex"),
+    (22, "epoll_pwait"),
+    (426, "io_uring_enter"),
+];
+
+#[cfg(not(any(target_arch = "x86_64", target_arch = "aarch64")))]
+const KNOWN_SYSCALLS: &[(u32, &str)] = &[];
+
+/// Имя системного вызова, если номер известен для текущей архитектуры.
+pub fn syscall_name(syscall_id: u32) -> Option<&'static str> {
+    KNOWN_SYSCALLS
+        .iter()
+        .find(|(id, _)| *id == syscall_id)
+        .map(|(_, name)| *name)
+}
+
+/// Номер системного вызова по имени для текущей архитектуры.
+pub fn syscall_id(name: &str) -> Option<u32> {
+    KNOWN_SYSCALLS
+        .iter()
+        .find(|(_, known)| *known == name)
+        .map(|(id, _)| *id)
+}
+
+/// Системные вызовы, для которых по умолчанию ведутся гистограммы по процессам:
+/// futex, read и io_uring_enter.
+pub fn default_app_latency_syscalls() -> Vec<u32> {
+    KNOWN_SYSCALLS
+        .iter()
+        .filter(|(_, name)| matches!(*name, "futex" | "read" | "io_uring_enter"))
+        .map(|(id, _)| *id)
+        .collect()
+}
+
+/// Преобразовать сводки задержек в формат Prometheus.
+///
+/// Сводки по всей системе экспортируются как `smoothtask_syscall_latency_*`,
+/// сводки по процессам — как `smoothtask_app_syscall_latency_*` с меткой `tgid`.
+pub fn syscall_latency_to_prometheus(stats: &[SyscallLatencyStat]) -> String {
+    let mut output = String::new();
+
+    let (applications, system): (Vec<_>, Vec<_>) =
+        stats.iter().partition(|stat| stat.tgid.is_some());
+
+    for (prefix, scope, group) in [
+        ("smoothtask_syscall", "system-wide", &system),
+        ("smoothtask_app_syscall", "per-process", &applications),
+    ] {
+        if group.is_empty() {
+            continue;
+        }
+
+        let families: [(&str, &str, &str, fn(&SyscallLatencyStat) -> u64); 4] = [
+            ("calls_total", "counter", "Completed syscalls", |stat| {
+                stat.count
+            }),
+            (
+                "latency_avg_ns",
+                "gauge",
+                "Mean syscall latency in nanoseconds since the previous collection",
+                |stat| stat.avg_time_ns,
+            ),
+            (
+                "latency_p50_ns",
+                "gauge",
+                "Median syscall latency in nanoseconds since the previous collection",
+                |stat| stat.p50_ns,
+            ),
+            (
+                "latency_p99_ns",
+                "gauge",
+                "99th percentile syscall latency in nanoseconds since the previous collection",
+                |stat| stat.p99_ns,
+            ),
+        ];
+
+        for (suffix, metric_type, help, value) in families {
+            output.push_str(&format!(
+                "# HELP {}_{} {} ({})\n",
+                prefix, suffix, help, scope
+            ));
+            output.push_str(&format!("# TYPE {}_{} {}\n", prefix, suffix, metric_type));
+            for stat in group.iter() {
+                output.push_str(&format!(
+                    "{}_{}{{{}}} {}\n",
+                    prefix,
+                    suffix,
+                    prometheus_labels(stat),
+                    value(stat)
+                ));
+            }
+        }
+    }
+
+    output
+}
+
+fn prometheus_labels(stat: &SyscallLatencyStat) -> String {
+    let mut labels = format!(
+        "syscall=\"{}\",syscall_id=\"{}\"",
+        stat.syscall_name.as_deref().unwrap_or("unknown"),
+        stat.syscall_id
+    );
+    if let Some(tgid) = stat.tgid {
+        labels.push_str(&format!(",tgid=\"{}\"", tgid));
+    }
+    labels
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    fn histogram(samples: &[(usize, u64)]) -> RawLatencyHistogram {
+        let mut hist = RawLatencyHistogram::default();
+        for &(bucket, count) in samples {
+            hist.buckets[bucket] += count;
+            hist.count += count;
+            hist.total_time_ns += count * bucket_lower_bound_ns(bucket).max(1);
+        }
+        hist
+    }
+
+    #[test]
+    fn test_layout_matches_kernel() {
+        assert_eq!(
+            std::mem::size_of::<RawLatencyHistogram>(),
+            16 + 8 * LATENCY_BUCKETS
+        );
+        assert_eq!(std::mem::size_of::<RawSyscallAppKey>(), 8);
+    }
+
+    #[test]
+    fn test_bucket_bounds() {
+        assert_eq!(bucket_lower_bound_ns(0), 0);
+        assert_eq!(bucket_upper_bound_ns(0), 2);
+        assert_eq!(bucket_lower_bound_ns(10), 1024);
+        assert_eq!(bucket_upper_bound_ns(10), 2048);
+    }
+
+    #[test]
+    fn test_merge_per_cpu() {
+        let cpu0 = histogram(&[(10, 5)]);
+        let cpu1 = histogram(&[(10, 3), (20, 2)]);
+        let merged = RawLatencyHistogram::merge_per_cpu([&cpu0, &cpu1]);
+        assert_eq!(merged.count, 10);
+        assert_eq!(merged.buckets[10], 8);
+        assert_eq!(merged.buckets[20], 2);
+        assert_eq!(
+            merged.total_time_ns,
+            cpu0.total_time_ns + cpu1.total_time_ns
+        );
+    }
+
+    #[test]
+    fn test_percentiles() {
+        // 98 быстрых вызовов около 1 мкс и 2 медленных около 1 мс
+        let hist = histogram(&[(10, 98), (20, 2)]);
+        let p50 = hist.percentile_ns(0.50);
+        let p99 = hist.percentile_ns(0.99);
+        assert!((1024..=2048).contains(&p50), "p50 = {}", p50);
+        assert!((1 << 20..=1 << 21).contains(&p99), "p99 = {}", p99);
+        assert_eq!(RawLatencyHistogram::default().percentile_ns(0.99), 0);
+    }
+
+    #[test]
+    fn test_stat_from_histogram() {
+        let hist = histogram(&[(3, 4), (5, 1)]);
+        let stat = SyscallLatencyStat::from_histogram(4242, Some(7), &hist);
+        assert_eq!(stat.count, 5);
+        assert_eq!(stat.tgid, Some(7));
+        assert_eq!(stat.buckets, vec![0, 0, 0, 4, 0, 1]);
+        assert_eq!(stat.avg_time_ns, hist.total_time_ns / 5);
+        assert!(stat.p50_ns <= stat.p99_ns);
+
+        let json = serde_json::to_string(&stat).unwrap();
+        let decoded: SyscallLatencyStat = serde_json::from_str(&json).unwrap();
+        assert_eq!(decoded, stat);
+    }
+
+    #[test]
+    fn test_stats_skip_idle_syscalls() {
+        let mut window = LatencyWindow::new();
+        let totals = HashMap::from([
+            ((None, 1), RawLatencyHistogram::default()),
+            ((Some(7), 1), histogram(&[(4, 2)])),
+        ]);
+        let stats = syscall_latency_stats(&mut window, &totals);
+        assert_eq!(stats.len(), 1);
+        assert_eq!(stats[0].count, 2);
+        assert_eq!(stats[0].interval_count, 2);
+        assert_eq!(stats[0].tgid, Some(7));
+    }
+
+    #[test]
+    fn test_percentiles_follow_current_interval() {
+        let mut window = LatencyWindow::new();
+
+        // Долгая история быстрых вызовов около 1 мкс
+        let history = histogram(&[(10, 100_000)]);
+        let first = syscall_latency_stats(&mut window, &HashMap::from([((None, 1), history)]));
+        assert!((1024..=2048).contains(&first[0].p99_ns));
+
+        // За интервал пришли только медленные вызовы около 1 мс
+        let mut current = history;
+        current.merge(&histogram(&[(20, 100)]));
+        let second = syscall_latency_stats(&mut window, &HashMap::from([((None, 1), current)]));
+        assert_eq!(second[0].count, 100_100);
+        assert_eq!(second[0].interval_count, 100);
+        assert!(
+            (1 << 20..=1 << 21).contains(&second[0].p50_ns),
+            "p50 = {}",
+            second[0].p50_ns
+        );
+
+        // Без новых вызовов перцентили не показывают устаревшие значения
+        let idle = syscall_latency_stats(&mut window, &HashMap::from([((None, 1), current)]));
+        assert_eq!(idle[0].interval_count, 0);
+        assert_eq!(idle[0].p99_ns, 0);
+    }
+
+    #[test]
+    fn test_recreated_entry_counts_in_full() {
+        let previous = histogram(&[(10, 50)]);
+        let recreated = histogram(&[(12, 3)]);
+        assert_eq!(recreated.delta_since(&previous), recreated);
+        assert_eq!(
+            histogram(&[(10, 60)]).delta_since(&previous),
+            histogram(&[(10, 10)])
+        );
+    }
+
+    #[test]
+    fn test_prometheus_export() {
+        let hist = histogram(&[(10, 99), (20, 1)]);
+        let stats = vec![
+            SyscallLatencyStat::from_histogram(4242, None, &hist),
+            SyscallLatencyStat::from_histogram(4242, Some(321), &hist),
+        ];
+
+        let output = syscall_latency_to_prometheus(&stats);
+        assert!(output.contains("# TYPE smoothtask_syscall_calls_total counter"));
+        assert!(output.contains(
+            "smoothtask_syscall_calls_total{syscall=\"unknown\",syscall_id=\"4242\"} 100"
+        ));
+        assert!(output.contains("smoothtask_app_syscall_latency_p99_ns{"));
+        assert!(output.contains("tgid=\"321\""));
+        assert!(syscall_latency_to_prometheus(&[]).is_empty());
+    }
+
+    #[test]
+    fn test_default_app_syscalls_are_known() {
+        for id in default_app_latency_syscalls() {
+            let name = syscall_name(id).expect("известный номер");
+            assert_eq!(syscall_id(name), Some(id));
+        }
+        assert_eq!(syscall_id("not_a_syscall"), None);
+    }
+}
@@ -0,0 +1,105 @@
+//! Учёт памяти процессов в eBPF.
+//!
+//! Программа `process_memory.c` ведёт по одной записи на процесс (TGID) в
+//! HASH карте и обновляет её из `mmap`, `munmap` и `brk` только тогда, когда
+//! RSS процесса изменился не меньше чем на заданный порог с момента прошлой
+//! записи. Размеры хранятся в страницах и переводятся в байты здесь.
+//!
+//! Порог и коэффициент выборки записываются в карту конфигурации при загрузке
+//! программы (см. [`RawProcessMemoryConfig`]); пока конфигурация не записана,
+//! программа ничего не делает.
+
+/// Карта статистики памяти по TGID.
+pub const PROCESS_MEMORY_STATS_MAP: &str = "process_memory_stats";
+
+/// Карта конфигурации программы.
+pub const PROCESS_MEMORY_CONFIG_MAP: &str = "process_memory_config_map";
+
+/// Порог изменения RSS по умолчанию, после которого запись переписывается (КБ).
+pub const DEFAULT_RSS_DELTA_KB: u64 = 1024;
+
+/// Конфигурация в раскладке ядра (`struct process_memory_config`).
+#[repr(C)]
+#[derive(Debug, Clone, Copy, Default, PartialEq, Eq)]
+pub struct RawProcessMemoryConfig {
+    pub enabled: u32,
+    /// Обрабатывается одно событие из N (0 и 1 — все события)
+    pub sampling_rate: u32,
+    /// Минимальное изменение RSS, при котором запись переписывается
+    pub rss_delta_pages: u64,
+}
+
+impl RawProcessMemoryConfig {
+    /// Включённая конфигурация с порогом в килобайтах.
+    ///
+    /// Порог округляется вверх до целых страниц; нулевой порог переписывает
+    /// запись на каждом событии.
+    pub fn new(rss_delta_kb: u64, page_size: u64) -> Self {
+        let page_size = page_size.max(1);
+        Self {
+            enabled: 1,
+            sampling_rate: 1,
+            rss_delta_pages: rss_delta_kb.saturating_mul(1024).div_ceil(page_size),
+        }
+    }
+
+    /// Байтовое представление для записи в карту.
+    pub fn to_ne_bytes(self) -> [u8; 16] {
+        let mut bytes = [0u8; 16];
+        bytes[..4].copy_from_slice(&self.enabled.to_ne_bytes());
+        bytes[4..8].copy_from_slice(&self.sampling_rate.to_ne_bytes());
+        bytes[8..].copy_from_slice(&self.rss_delta_pages.to_ne_bytes());
+        bytes
+    }
+}
+
+/// Запись `process_memory_stats` в раскладке ядра (`struct process_memory_stat`).
+#[repr(C)]
+#[derive(Debug, Clone, Copy, Default, PartialEq, Eq)]
+pub struct RawProcessMemoryStat {
+    pub pid: u32,
+    pub tgid: u32,
+    pub last_update_ns: u64,
+    pub rss_pages: u64,
+    pub vm_pages: u64,
+    /// Резидентные файловые и shmem страницы
+    pub shared_pages: u64,
+    pub swap_pages: u64,
+    pub anon_pages: u64,
+    pub file_pages: u64,
+    pub stack_pages: u64,
+    /// Размер кучи (`brk - start_brk`) в байтах
+    pub heap_bytes: u64,
+    pub major_faults: u64,
+    pub minor_faults: u64,
+    /// Количество перезаписей записи
+    pub updates: u64,
+    pub comm: [u8; 16],
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    #[test]
+    fn test_layout_matches_kernel() {
+        assert_eq!(std::mem::size_of::<RawProcessMemoryConfig>(), 16);
+        assert_eq!(std::mem::size_of::<RawProcessMemoryStat>(), 120);
+        assert_eq!(std::mem::align_of::<RawProcessMemoryStat>(), 8);
+    }
+
+    #[test]
+    fn test_config_delta_in_pages() {
+        let config = RawProcessMemoryConfig::new(DEFAULT_RSS_DELTA_KB, 4096);
+        assert_eq!(config.enabled, 1);
+        assert_eq!(config.rss_delta_pages, 256);
+
+        // Неполная страница округляется вверх
+        assert_eq!(RawProcessMemoryConfig::new(5, 4096).rss_delta_pages, 2);
+        assert_eq!(RawProcessMemoryConfig::new(0, 4096).rss_delta_pages, 0);
+
+        let bytes = config.to_ne_bytes();
+        assert_eq!(&bytes[..4], &1u32.to_ne_bytes());
+        assert_eq!(&bytes[8..], &256u64.to_ne_bytes());
+    }
+}
@@ -0,0 +1,445 @@
+//! Задержки из-за нехватки памяти из eBPF.
+//!
+//! `memory_pressure.c` измеряет время, которое потоки процесса стоят в
+//! ожидании памяти: major page fault (`handle_mm_fault` с `VM_FAULT_MAJOR`),
+//! чтение страниц из swap (`do_swap_page`) и прямое освобождение памяти
+//! (direct reclaim и reclaim по лимиту memcg). Итоги ведутся в per-CPU картах
+//! по TGID и по cgroup v2.
+//!
+//! Здесь копии CPU сливаются, а [`MemoryStallTracker`] переводит
+//! накопленное время задержек в долю времени между сборами — сигнал в духе
+//! PSI memory `some`, но по процессу и по cgroup.
+//!
+//! Счётчики kmalloc/kfree дорогие и ведутся отдельной программой
+//! `kmem_allocations.c`, которая загружается только по требованию.
+
+use std::collections::HashMap;
+use std::hash::Hash;
+use std::time::Instant;
+
+/// Имя программы учёта задержек памяти.
+pub const MEMORY_PRESSURE_PROGRAM: &str = "memory_pressure";
+
+/// Per-CPU итоги по TGID.
+pub const MEMORY_STALL_PROCESS_MAP: &str = "memory_stall_process_map";
+
+/// Per-CPU итоги по идентификатору cgroup v2.
+pub const MEMORY_STALL_CGROUP_MAP: &str = "memory_stall_cgroup_map";
+
+/// Имя программы учёта kmalloc/kfree.
+pub const KMEM_PROGRAM: &str = "kmem_allocations";
+
+/// Per-CPU счётчики kmalloc/kfree по TGID.
+pub const KMEM_PROCESS_MAP: &str = "kmem_process_map";
+
+/// Задержки в раскладке ядра (`struct memory_stall_counters`).
+#[repr(C)]
+#[derive(Debug, Clone, Copy, Default, PartialEq, Eq)]
+pub struct RawMemoryStallCounters {
+    pub major_faults: u64,
+    pub major_fault_ns: u64,
+    pub swapins: u64,
+    pub swapin_ns: u64,
+    pub reclaims: u64,
+    pub reclaim_ns: u64,
+    /// Общая задержка без двойного учёта вложенных событий
+    pub stall_ns: u64,
+}
+
+impl RawMemoryStallCounters {
+    pub fn merge(&mut self, other: &Self) {
+        self.major_faults = self.major_faults.saturating_add(other.major_faults);
+        self.major_fault_ns = self.major_fault_ns.saturating_add(other.major_fault_ns);
+        self.swapins = self.swapins.saturating_add(other.swapins);
+        self.swapin_ns = self.swapin_ns.saturating_add(other.swapin_ns);
+        self.reclaims = self.reclaims.saturating_add(other.reclaims);
+        self.reclaim_ns = self.reclaim_ns.saturating_add(other.reclaim_ns);
+        self.stall_ns = self.stall_ns.saturating_add(other.stall_ns);
+    }
+
+    /// Сумма копий всех CPU.
+    pub fn merge_per_cpu(per_cpu: &[Self]) -> Self {
+        let mut merged = Self::default();
+        for counters in per_cpu {
+            merged.merge(counters);
+        }
+        merged
+    }
+}
+
+/// Итоги процесса в раскладке ядра (`struct memory_stall_process`).
+#[repr(C)]
+#[derive(Debug, Clone, Copy, Default, PartialEq, Eq)]
+pub struct RawMemoryStallProcess {
+    pub stalls: RawMemoryStallCounters,
+    pub last_stall_ns: u64,
+    pub comm: [u8; 16],
+}
+
+impl RawMemoryStallProcess {
+    /// Слить копии всех CPU: счётчики суммируются, время берётся наибольшее,
+    /// имя — из первой заполненной копии.
+    pub fn merge_per_cpu(per_cpu: &[Self]) -> Self {
+        let mut merged = Self::default();
+        for copy in per_cpu {
+            merged.stalls.merge(&copy.stalls);
+            merged.last_stall_ns = merged.last_stall_ns.max(copy.last_stall_ns);
+            if merged.comm[0] == 0 {
+                merged.comm = copy.comm;
+            }
+        }
+        merged
+    }
+
+    pub fn name(&self) -> String {
+        super::ebpf_sched::comm_to_string(&self.comm)
+    }
+}
+
+/// Счётчики kmalloc/kfree в раскладке ядра (`struct kmem_counters`).
+#[repr(C)]
+#[derive(Debug, Clone, Copy, Default, PartialEq, Eq)]
+pub struct RawKmemCounters {
+    /// Выделения с учётом веса выборки
+    pub allocations: u64,
+    /// Освобождения с учётом веса выборки
+    pub frees: u64,
+}
+
+impl RawKmemCounters {
+    /// Сумма копий всех CPU.
+    pub fn merge_per_cpu(per_cpu: &[Self]) -> Self {
+        per_cpu.iter().fold(Self::default(), |acc, copy| Self {
+            allocations: acc.allocations.saturating_add(copy.allocations),
+            frees: acc.frees.saturating_add(copy.frees),
+        })
+    }
+}
+
+/// Свернуть записи `kmem_process_map` в таблицу по TGID.
+pub fn reduce_kmem_counters(
+    entries: &[(u32, Vec<RawKmemCounters>)],
+) -> HashMap<u32, RawKmemCounters> {
+    entries
+        .iter()
+        .map(|(tgid, per_cpu)| (*tgid, RawKmemCounters::merge_per_cpu(per_cpu)))
+        .collect()
+}
+
+/// Свернуть записи `memory_stall_process_map` в таблицу по TGID.
+pub fn reduce_process_stalls(
+    entries: &[(u32, Vec<RawMemoryStallProcess>)],
+) -> HashMap<u32, RawMemoryStallProcess> {
+    entries
+        .iter()
+        .map(|(tgid, per_cpu)| (*tgid, RawMemoryStallProcess::merge_per_cpu(per_cpu)))
+        .collect()
+}
+
+/// Задержки процесса из-за нехватки памяти
+#[derive(Debug, Clone, Default, PartialEq, serde::Serialize, serde::Deserialize)]
+pub struct ProcessMemoryStallStat {
+    /// TGID процесса
+    pub tgid: u32,
+    /// Имя процесса
+    pub name: String,
+    /// Количество major page fault
+    pub major_faults: u64,
+    /// Суммарное время major page fault (наносекунды)
+    pub major_fault_ns: u64,
+    /// Количество чтений страниц из swap
+    pub swapins: u64,
+    /// Суммарное время чтения страниц из swap (наносекунды)
+    pub swapin_ns: u64,
+    /// Количество прямых освобождений памяти
+    pub reclaims: u64,
+    /// Суммарное время прямого освобождения памяти (наносекунды)
+    pub reclaim_ns: u64,
+    /// Общее время ожидания памяти (наносекунды)
+    pub stall_ns: u64,
+    /// Доля времени ожидания памяти с прошлого сбора (0-100%; задержки
+    /// потоков суммируются, поэтому для многопоточных процессов значение
+    /// ограничивается сверху)
+    pub stall_percent: f64,
+    /// Время последней задержки (монотонные наносекунды)
+    pub last_stall_ns: u64,
+}
+
+/// Задержки cgroup из-за нехватки памяти
+#[derive(Debug, Clone, Default, PartialEq, serde::Serialize, serde::Deserialize)]
+pub struct CgroupMemoryStallStat {
+    /// Идентификатор cgroup v2 (номер inode каталога cgroup)
+    pub cgroup_id: u64,
+    pub major_faults: u64,
+    pub major_fault_ns: u64,
+    pub swapins: u64,
+    pub swapin_ns: u64,
+    pub reclaims: u64,
+    pub reclaim_ns: u64,
+    pub stall_ns: u64,
+    /// Доля времени ожидания памяти с прошлого сбора (0-100%)
+    pub stall_percent: f64,
+}
+
+impl ProcessMemoryStallStat {
+    pub fn from_raw(tgid: u32, raw: &RawMemoryStallProcess, stall_percent: f64) -> Self {
+        let stalls = &raw.stalls;
+        Self {
+            tgid,
+            name: raw.name(),
+            major_faults: stalls.major_faults,
+            major_fault_ns: stalls.major_fault_ns,
+            swapins: stalls.swapins,
+            swapin_ns: stalls.swapin_ns,
+            reclaims: stalls.reclaims,
+            reclaim_ns: stalls.reclaim_ns,
+            stall_ns: stalls.stall_ns,
+            stall_percent,
+            last_stall_ns: raw.last_stall_ns,
+        }
+    }
+}
+
+impl CgroupMemoryStallStat {
+    pub fn from_raw(cgroup_id: u64, stalls: &RawMemoryStallCounters, stall_percent: f64) -> Self {
+        Self {
+            cgroup_id,
+            major_faults: stalls.major_faults,
+            major_fault_ns: stalls.major_fault_ns,
+            swapins: stalls.swapins,
+            swapin_ns: stalls.swapin_ns,
+            reclaims: stalls.reclaims,
+            reclaim_ns: stalls.reclaim_ns,
+            stall_ns: stalls.stall_ns,
+            stall_percent,
+        }
+    }
+}
+
+/// Прирост времени задержек между сборами по ключу
+#[derive(Debug)]
+struct StallWindow<K> {
+    stall_ns: HashMap<K, u64>,
+}
+
+impl<K> Default for StallWindow<K> {
+    fn default() -> Self {
+        Self {
+            stall_ns: HashMap::new(),
+        }
+    }
+}
+
+impl<K: Eq + Hash + Copy> StallWindow<K> {
+    /// Доля задержек за `elapsed_ns`; для новых ключей и первого сбора — 0.
+    /// Ключи, пропавшие из карты, забываются.
+    fn advance(&mut self, elapsed_ns: u64, current: &HashMap<K, u64>) -> HashMap<K, f64> {
+        let rates = current
+            .iter()
+            .map(|(key, &stall)| {
+                let rate = match self.stall_ns.get(key) {
+                    Some(&previous) if elapsed_ns > 0 => {
+                        (stall.saturating_sub(previous) as f64 * 100.0 / elapsed_ns as f64)
+                            .min(100.0)
+                    }
+                    _ => 0.0,
+                };
+                (*key, rate)
+            })
+            .collect();
+        self.stall_ns = current.clone();
+        rates
+    }
+}
+
+/// Доля времени ожидания памяти процессов и cgroup между сборами
+#[derive(Debug, Default)]
+pub struct MemoryStallTracker {
+    last_sample: Option<Instant>,
+    processes: StallWindow<u32>,
+    cgroups: StallWindow<u64>,
+}
+
+impl MemoryStallTracker {
+    pub fn new() -> Self {
+        Self::default()
+    }
+
+    /// Обработать новый снимок карт.
+    ///
+    /// Результаты упорядочены по убыванию доли задержки за интервал, затем
+    /// по накопленной задержке; записи без задержек пропускаются, в каждом
+    /// списке не более `limit` записей.
+    pub fn sample(
+        &mut self,
+        now: Instant,
+        processes: &HashMap<u32, RawMemoryStallProcess>,
+        cgroups: &HashMap<u64, RawMemoryStallCounters>,
+        limit: usize,
+    ) -> (Vec<ProcessMemoryStallStat>, Vec<CgroupMemoryStallStat>) {
+        let elapsed_ns = self
+            .last_sample
+            .map(|last| now.saturating_duration_since(last).as_nanos() as u64)
+            .unwrap_or(0);
+        self.last_sample = Some(now);
+
+        let process_stalls: HashMap<u32, u64> = processes
+            .iter()
+            .map(|(tgid, raw)| (*tgid, raw.stalls.stall_ns))
+            .collect();
+        let process_rates = self.processes.advance(elapsed_ns, &process_stalls);
+        let cgroup_stalls: HashMap<u64, u64> = cgroups
+            .iter()
+            .map(|(id, stalls)| (*id, stalls.stall_ns))
+            .collect();
+        let cgroup_rates = self.cgroups.advance(elapsed_ns, &cgroup_stalls);
+
+        let mut process_stats: Vec<ProcessMemoryStallStat> = processes
+            .iter()
+            .filter(|(_, raw)| raw.stalls.stall_ns > 0)
+            .map(|(tgid, raw)| ProcessMemoryStallStat::from_raw(*tgid, raw, process_rates[tgid]))
+            .collect();
+        process_stats.sort_by(|a, b| {
+            b.stall_percent
+                .total_cmp(&a.stall_percent)
+                .then(b.stall_ns.cmp(&a.stall_ns))
+                .then(a.tgid.cmp(&b.tgid))
+        });
+        process_stats.truncate(limit);
+
+        let mut cgroup_stats: Vec<CgroupMemoryStallStat> = cgroups
+            .iter()
+            .filter(|(_, stalls)| stalls.stall_ns > 0)
+            .map(|(id, stalls)| CgroupMemoryStallStat::from_raw(*id, stalls, cgroup_rates[id]))
+            .collect();
+        cgroup_stats.sort_by(|a, b| {
+            b.stall_percent
+                .total_cmp(&a.stall_percent)
+                .then(b.stall_ns.cmp(&a.stall_ns))
+                .then(a.cgroup_id.cmp(&b.cgroup_id))
+        });
+        cgroup_stats.truncate(limit);
+
+        (process_stats, cgroup_stats)
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+    use std::time::Duration;
+
+    fn stalls(major_faults: u64, major_fault_ns: u64, stall_ns: u64) -> RawMemoryStallCounters {
+        RawMemoryStallCounters {
+            major_faults,
+            major_fault_ns,
+            stall_ns,
+            ..Default::default()
+        }
+    }
+
+    fn process(stalls: RawMemoryStallCounters, last: u64, comm: &str) -> RawMemoryStallProcess {
+        let mut raw = RawMemoryStallProcess {
+            stalls,
+            last_stall_ns: last,
+            ..Default::default()
+        };
+        raw.comm[..comm.len()].copy_from_slice(comm.as_bytes());
+        raw
+    }
+
+    #[test]
+    fn test_layout_matches_kernel() {
+        assert_eq!(std::mem::size_of::<RawMemoryStallCounters>(), 56);
+        assert_eq!(std::mem::size_of::<RawMemoryStallProcess>(), 80);
+        assert_eq!(std::mem::size_of::<RawKmemCounters>(), 16);
+    }
+
+    #[test]
+    fn test_merge_per_cpu() {
+        let entries = vec![(
+            100,
+            vec![
+                process(RawMemoryStallCounters::default(), 0, ""),
+                process(stalls(2, 3_000_000, 3_000_000), 50, "firefox"),
+                process(
+                    RawMemoryStallCounters {
+                        reclaims: 1,
+                        reclaim_ns: 500_000,
+                        stall_ns: 500_000,
+                        ..Default::default()
+                    },
+                    80,
+                    "firefox",
+                ),
+            ],
+        )];
+
+        let table = reduce_process_stalls(&entries);
+        let merged = &table[&100];
+        assert_eq!(merged.stalls.major_faults, 2);
+        assert_eq!(merged.stalls.reclaims, 1);
+        assert_eq!(merged.stalls.stall_ns, 3_500_000);
+        assert_eq!(merged.last_stall_ns, 80);
+        assert_eq!(merged.name(), "firefox");
+
+        let kmem = reduce_kmem_counters(&[(
+            100,
+            vec![
+                RawKmemCounters {
+                    allocations: 10,
+                    frees: 4,
+                },
+                RawKmemCounters {
+                    allocations: 5,
+                    frees: 6,
+                },
+            ],
+        )]);
+        assert_eq!(kmem[&100].allocations, 15);
+        assert_eq!(kmem[&100].frees, 10);
+    }
+
+    #[test]
+    fn test_tracker_stall_percent() {
+        let mut tracker = MemoryStallTracker::new();
+        let start = Instant::now();
+
+        let mut processes = HashMap::new();
+        processes.insert(100, process(stalls(1, 1_000_000, 1_000_000), 10, "firefox"));
+        processes.insert(200, process(RawMemoryStallCounters::default(), 0, "bash"));
+        let mut cgroups = HashMap::new();
+        cgroups.insert(7u64, stalls(1, 1_000_000, 1_000_000));
+
+        // Первый сбор: доля ещё не известна, процессы без задержек пропускаются
+        let (first, first_cgroups) = tracker.sample(start, &processes, &cgroups, 10);
+        assert_eq!(first.len(), 1);
+        assert_eq!(first[0].tgid, 100);
+        assert_eq!(first[0].stall_percent, 0.0);
+        assert_eq!(first_cgroups[0].stall_percent, 0.0);
+
+        // За 100 мс процесс ждал память 25 мс
+        processes.insert(
+            100,
+            process(stalls(3, 26_000_000, 26_000_000), 90, "firefox"),
+        );
+        processes.insert(300, process(stalls(1, 2_000_000, 2_000_000), 95, "java"));
+        cgroups.insert(7, stalls(3, 51_000_000, 51_000_000));
+        let (second, second_cgroups) =
+            tracker.sample(start + Duration::from_millis(100), &processes, &cgroups, 10);
+        assert_eq!(second.len(), 2);
+        assert_eq!(second[0].tgid, 100);
+        assert!((second[0].stall_percent - 25.0).abs() < 1e-9);
+        assert_eq!(second[0].major_faults, 3);
+        // Новый процесс получает долю со следующего сбора
+        assert_eq!(second[1].tgid, 300);
+        assert_eq!(second[1].stall_percent, 0.0);
+        assert!((second_cgroups[0].stall_percent - 50.0).abs() < 1e-9);
+
+        // Ограничение длины списка
+        let (limited, _) =
+            tracker.sample(start + Duration::from_millis(200), &processes, &cgroups, 1);
+        assert_eq!(limited.len(), 1);
+        assert_eq!(limited[0].tgid, 100);
+    }
+}
@@ -0,0 +1,328 @@
+//! Учёт сетевого трафика процессов и сокетов в eBPF.
+//!
+//! Программа `process_network.c` считает реально переданные байты в точках,
+//! где ядро уже знает объём скопированных данных: `tcp_sendmsg`,
+//! `tcp_cleanup_rbuf`, `udp_sendmsg`/`udpv6_sendmsg` и `skb_consume_udp`.
+//! Итоги ведутся в двух LRU per-CPU картах — по TGID и по cookie сокета.
+//! Каждый CPU обновляет только свою копию записи, а сложение копий выполняется
+//! здесь, после пакетного чтения карт.
+//!
+//! Программа `network_connections.c` ведёт по одной записи на живое TCP
+//! соединение в LRU карте с ключом cookie сокета (см. [`RawConnectionRecord`]).
+
+use serde::{Deserialize, Serialize};
+use std::collections::HashMap;
+use std::net::{IpAddr, Ipv4Addr, Ipv6Addr};
+
+/// Карта трафика по TGID.
+pub const PROCESS_TRAFFIC_MAP_NAME: &str = "process_traffic_map";
+
+/// Карта трафика по cookie сокета.
+pub const SOCKET_TRAFFIC_MAP_NAME: &str = "socket_traffic_map";
+
+/// Карта активных TCP соединений по cookie сокета.
+pub const CONNECTION_MAP_NAME: &str = "connection_map";
+
+/// Семейство адресов IPv4 (`AF_INET`).
+pub const AF_INET: u16 = 2;
+
+/// Семейство адресов IPv6 (`AF_INET6`).
+pub const AF_INET6: u16 = 10;
+
+/// Трафик в раскладке ядра (`struct net_traffic`).
+#[repr(C)]
+#[derive(Debug, Clone, Copy, Default, PartialEq, Eq)]
+pub struct RawNetTraffic {
+    pub bytes_sent: u64,
+    pub bytes_received: u64,
+    /// Количество успешных отправок
+    pub send_calls: u64,
+    /// Количество успешных чтений
+    pub recv_calls: u64,
+}
+
+impl RawNetTraffic {
+    /// Прибавить копию другого CPU.
+    pub fn merge(&mut self, other: &Self) {
+        self.bytes_sent = self.bytes_sent.saturating_add(other.bytes_sent);
+        self.bytes_received = self.bytes_received.saturating_add(other.bytes_received);
+        self.send_calls = self.send_calls.saturating_add(other.send_calls);
+        self.recv_calls = self.recv_calls.saturating_add(other.recv_calls);
+    }
+
+    /// Сумма переданных и полученных байт.
+    pub fn total_bytes(&self) -> u64 {
+        self.bytes_sent.saturating_add(self.bytes_received)
+    }
+
+    /// Сумма per-CPU копий записи.
+    pub fn sum(per_cpu: &[Self]) -> Self {
+        per_cpu.iter().fold(Self::default(), |mut total, value| {
+            total.merge(value);
+            total
+        })
+    }
+}
+
+/// Запись `socket_traffic_map` в раскладке ядра (`struct socket_traffic`).
+///
+/// Владелец и протокол заполнены только в копиях CPU, на которых сокет
+/// уже использовался; в остальных копиях они нулевые.
+#[repr(C)]
+#[derive(Debug, Clone, Copy, Default, PartialEq, Eq)]
+pub struct RawSocketTraffic {
+    pub traffic: RawNetTraffic,
+    pub tgid: u32,
+    /// Протокол (`IPPROTO_TCP`, `IPPROTO_UDP`)
+    pub protocol: u16,
+    /// Семейство адресов (`AF_INET`, `AF_INET6`)
+    pub family: u16,
+}
+
+/// Трафик сокета.
+#[derive(Debug, Clone, PartialEq, Eq, Serialize, Deserialize)]
+pub struct SocketTrafficStat {
+    /// Cookie сокета (`bpf_get_socket_cookie`), уникальный за время работы ядра
+    pub cookie: u64,
+    /// Процесс, первым передавший данные через сокет
+    pub tgid: u32,
+    pub protocol: u16,
+    pub family: u16,
+    pub bytes_sent: u64,
+    pub bytes_received: u64,
+    pub send_calls: u64,
+    pub recv_calls: u64,
+}
+
+impl SocketTrafficStat {
+    /// Свернуть per-CPU копии записи сокета.
+    ///
+    /// Возвращает `None`, если ни одна копия не содержит владельца.
+    pub fn from_per_cpu(cookie: u64, per_cpu: &[RawSocketTraffic]) -> Option<Self> {
+        let owner = per_cpu.iter().find(|value| value.tgid != 0)?;
+        let traffic = per_cpu
+            .iter()
+            .fold(RawNetTraffic::default(), |mut total, value| {
+                total.merge(&value.traffic);
+                total
+            });
+
+        Some(Self {
+            cookie,
+            tgid: owner.tgid,
+            protocol: owner.protocol,
+            family: owner.family,
+            bytes_sent: traffic.bytes_sent,
+            bytes_received: traffic.bytes_received,
+            send_calls: traffic.send_calls,
+            recv_calls: traffic.recv_calls,
+        })
+    }
+
+    /// Сумма переданных и полученных байт.
+    pub fn total_bytes(&self) -> u64 {
+        self.bytes_sent.saturating_add(self.bytes_received)
+    }
+}
+
+/// Запись `connection_map` в раскладке ядра (`struct connection_record`).
+///
+/// Для IPv4 адрес занимает первые 4 байта полей адресов (в сетевом порядке),
+/// порты хранятся в порядке байт хоста.
+#[repr(C)]
+#[derive(Debug, Clone, Copy, Default, PartialEq, Eq)]
+pub struct RawConnectionRecord {
+    pub saddr: [u8; 16],
+    pub daddr: [u8; 16],
+    pub sport: u16,
+    pub dport: u16,
+    pub family: u16,
+    pub protocol: u8,
+    /// Состояние TCP (`TCP_ESTABLISHED` и т.д.)
+    pub state: u8,
+    /// Процесс-владелец; 0, пока соединение не передавало данных
+    pub tgid: u32,
+    pub _pad: u32,
+    /// Количество операций отправки и чтения
+    pub packets: u64,
+    pub bytes: u64,
+    pub start_time: u64,
+    pub last_activity: u64,
+}
+
+impl RawConnectionRecord {
+    /// Адрес источника.
+    pub fn src_addr(&self) -> Option<IpAddr> {
+        decode_addr(self.family, &self.saddr)
+    }
+
+    /// Адрес назначения.
+    pub fn dst_addr(&self) -> Option<IpAddr> {
+        decode_addr(self.family, &self.daddr)
+    }
+}
+
+/// Разобрать адрес из записи ядра.
+///
+/// IPv4-адреса двухстековых IPv6 сокетов (`::ffff:a.b.c.d`) возвращаются как
+/// IPv4. Неизвестное семейство даёт `None`.
+pub fn decode_addr(family: u16, raw: &[u8; 16]) -> Option<IpAddr> {
+    match family {
+        AF_INET => Some(IpAddr::V4(Ipv4Addr::new(raw[0], raw[1], raw[2], raw[3]))),
+        AF_INET6 => {
+            let addr = Ipv6Addr::from(*raw);
+            Some(match addr.to_ipv4_mapped() {
+                Some(v4) => IpAddr::V4(v4),
+                None => IpAddr::V6(addr),
+            })
+        }
+        _ => None,
+    }
+}
+
+/// Свернуть записи `process_traffic_map` в итоги по TGID.
+///
+/// Повторяющиеся ключи (например, из нескольких чтений подряд) складываются.
+pub fn reduce_process_traffic<I>(entries: I) -> HashMap<u32, RawNetTraffic>
+where
+    I: IntoIterator<Item = (u32, Vec<RawNetTraffic>)>,
+{
+    let mut totals: HashMap<u32, RawNetTraffic> = HashMap::new();
+    for (tgid, per_cpu) in entries {
+        totals
+            .entry(tgid)
+            .or_default()
+            .merge(&RawNetTraffic::sum(&per_cpu));
+    }
+    totals
+}
+
+/// Упорядочить сокеты по объёму трафика и оставить `limit` самых нагруженных.
+pub fn top_sockets(mut sockets: Vec<SocketTrafficStat>, limit: usize) -> Vec<SocketTrafficStat> {
+    sockets.sort_by(|a, b| {
+        b.total_bytes()
+            .cmp(&a.total_bytes())
+            .then(a.cookie.cmp(&b.cookie))
+    });
+    sockets.truncate(limit);
+    sockets
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    fn traffic(sent: u64, received: u64) -> RawNetTraffic {
+        RawNetTraffic {
+            bytes_sent: sent,
+            bytes_received: received,
+            send_calls: u64::from(sent > 0),
+            recv_calls: u64::from(received > 0),
+        }
+    }
+
+    #[test]
+    fn test_layout_matches_kernel() {
+        assert_eq!(std::mem::size_of::<RawNetTraffic>(), 32);
+        assert_eq!(std::mem::size_of::<RawSocketTraffic>(), 40);
+        assert_eq!(std::mem::align_of::<RawSocketTraffic>(), 8);
+    }
+
+    #[test]
+    fn test_reduce_process_traffic() {
+        let entries = vec![
+            (
+                100,
+                vec![traffic(1500, 0), traffic(0, 64), RawNetTraffic::default()],
+            ),
+            (200, vec![traffic(10, 10)]),
+            // Повтор ключа складывается
+            (100, vec![traffic(500, 0)]),
+        ];
+        let totals = reduce_process_traffic(entries);
+
+        assert_eq!(totals.len(), 2);
+        let first = totals[&100];
+        assert_eq!(first.bytes_sent, 2000);
+        assert_eq!(first.bytes_received, 64);
+        assert_eq!(first.send_calls, 2);
+        assert_eq!(first.recv_calls, 1);
+        assert_eq!(totals[&200].total_bytes(), 20);
+    }
+
+    #[test]
+    fn test_socket_from_per_cpu() {
+        let per_cpu = [
+            // Копия CPU, на котором сокет ещё не использовался
+            RawSocketTraffic::default(),
+            RawSocketTraffic {
+                traffic: traffic(4096, 0),
+                tgid: 42,
+                protocol: 6,
+                family: 10,
+            },
+            RawSocketTraffic {
+                traffic: traffic(0, 1024),
+                tgid: 42,
+                protocol: 6,
+                family: 10,
+            },
+        ];
+        let stat = SocketTrafficStat::from_per_cpu(7, &per_cpu).unwrap();
+
+        assert_eq!(stat.tgid, 42);
+        assert_eq!(stat.protocol, 6);
+        assert_eq!(stat.family, 10);
+        assert_eq!(stat.bytes_sent, 4096);
+        assert_eq!(stat.bytes_received, 1024);
+        assert_eq!(stat.total_bytes(), 5120);
+
+        assert!(SocketTrafficStat::from_per_cpu(8, &[RawSocketTraffic::default()]).is_none());
+    }
+
+    #[test]
+    fn test_connection_record_addresses() {
+        assert_eq!(std::mem::size_of::<RawConnectionRecord>(), 80);
+
+        let mut v4 = RawConnectionRecord {
+            family: AF_INET,
+            ..Default::default()
+        };
+        v4.saddr[..4].copy_from_slice(&[192, 168, 1, 10]);
+        v4.daddr[..4].copy_from_slice(&[10, 0, 0, 1]);
+        assert_eq!(v4.src_addr(), Some("192.168.1.10".parse().unwrap()));
+        assert_eq!(v4.dst_addr(), Some("10.0.0.1".parse().unwrap()));
+
+        let v6: Ipv6Addr = "2001:db8::1".parse().unwrap();
+        let mapped: Ipv6Addr = "::ffff:10.1.2.3".parse().unwrap();
+        let record = RawConnectionRecord {
+            family: AF_INET6,
+            saddr: v6.octets(),
+            daddr: mapped.octets(),
+            ..Default::default()
+        };
+        assert_eq!(record.src_addr(), Some(IpAddr::V6(v6)));
+        // Двухстековый сокет с IPv4 собеседником
+        assert_eq!(record.dst_addr(), Some("10.1.2.3".parse().unwrap()));
+
+        assert_eq!(RawConnectionRecord::default().src_addr(), None);
+    }
+
+    #[test]
+    fn test_top_sockets() {
+        let socket = |cookie, bytes_sent| SocketTrafficStat {
+            cookie,
+            tgid: 1,
+            protocol: 6,
+            family: 2,
+            bytes_sent,
+            bytes_received: 0,
+            send_calls: 1,
+            recv_calls: 0,
+        };
+        let top = top_sockets(vec![socket(1, 10), socket(2, 1000), socket(3, 100)], 2);
+
+        let cookies: Vec<u64> = top.iter().map(|socket| socket.cookie).collect();
+        assert_eq!(cookies, vec![2, 3]);
+    }
+}
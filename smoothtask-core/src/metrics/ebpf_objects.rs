@@ -0,0 +1,558 @@
+//! Встроенные eBPF объекты, скомпилированные на этапе сборки.
+//!
+//! `build.rs` компилирует программы из `src/ebpf_programs/*.c` в CO-RE
+//! объекты `.bpf.o` и встраивает их байткод в бинарник. Этот модуль
+//! предоставляет поиск объектов по имени программы и их загрузку из памяти
+//! через `libbpf_rs::ObjectBuilder::open_memory`, без обращения к файловой
+//! системе и компилятору в рантайме.
+//!
+//! Имя программы — это имя исходного файла без расширения
+//! (`cpu_metrics` для `cpu_metrics.c`). Для совместимости со старыми
+//! вызовами допускается передавать и путь вида `src/ebpf_programs/cpu_metrics.c`.
+
+#[cfg(feature = "ebpf")]
+use anyhow::{Context, Result};
+
+include!(concat!(env!("OUT_DIR"), "/ebpf_objects.rs"));
+
+/// Получить имя программы из пути к исходнику или объекту.
+///
+/// `src/ebpf_programs/cpu_metrics.c` и `cpu_metrics.bpf.o` дают `cpu_metrics`.
+pub fn program_name_from_path(path: &str) -> &str {
+    let file_name = path.rsplit('/').next().unwrap_or(path);
+    file_name
+        .strip_suffix(".bpf.o")
+        .or_else(|| file_name.strip_suffix(".c"))
+        .unwrap_or(file_name)
+}
+
+/// Найти байткод встроенного объекта по имени программы (или пути к ней).
+pub fn embedded_object(program: &str) -> Option<&'static [u8]> {
+    find_object(EMBEDDED_EBPF_OBJECTS, program)
+}
+
+/// Проверить, встроен ли объект программы в бинарник.
+pub fn is_program_embedded(program: &str) -> bool {
+    embedded_object(program).is_some()
+}
+
+/// Выбрать первую встроенную программу из списка кандидатов по приоритету.
+///
+/// Заменяет прежние каскады проверок `Path::exists` для вариантов программ
+/// (например, high_perf → optimized → basic для файловой системы).
+pub fn select_embedded_program<'a>(candidates: &[&'a str]) -> Option<&'a str> {
+    select_from(EMBEDDED_EBPF_OBJECTS, candidates)
+}
+
+/// Список имён всех встроенных программ.
+pub fn embedded_program_names() -> Vec<&'static str> {
+    EMBEDDED_EBPF_OBJECTS.iter().map(|(name, _)| *name).collect()
+}
+
+fn find_object(table: &[(&'static str, &'static [u8])], program: &str) -> Option<&'static [u8]> {
+    let name = program_name_from_path(program);
+    table
+        .iter()
+        .find(|(embedded, bytes)| *embedded == name && !bytes.is_empty())
+        .map(|(_, bytes)| *bytes)
+}
+
+fn select_from<'a>(
+    table: &[(&'static str, &'static [u8])],
+    candidates: &[&'a str],
+) -> Option<&'a str> {
+    candidates
+        .iter()
+        .copied()
+        .find(|candidate| find_object(table, candidate).is_some())
+}
+
+/// eBPF объект, загруженный из встроенного байткода.
+///
+/// Владеет `libbpf_rs::Object` и ссылками (links) прикреплённых программ:
+/// пока ссылки живы, программы прикреплены к точкам трассировки.
+/// [`EbpfObject::detach`] сбрасывает ссылки, а [`EbpfObject::attach`] создаёт их
+/// заново; объект и его карты при этом остаются загруженными в ядро.
+/// Ссылки программ-итераторов (`SEC("iter/...")`) хранятся отдельно по имени
+/// программы: они ничего не трассируют и только выгружают данные по запросу
+/// (см. [`EbpfObject::read_iterator`]), поэтому не открепляются.
+/// Программы `SEC("perf_event")` прикрепляются только к переданному событию
+/// perf ([`EbpfObject::attach_perf_event`]); их ссылки хранятся вместе с
+/// остальными, и [`EbpfObject::attach`] после открепления их не восстанавливает.
+/// Программы `SEC("syscall")` не прикрепляются вовсе: они выполняются по
+/// вызову [`EbpfObject::run_syscall_program`].
+#[cfg(feature = "ebpf")]
+pub struct EbpfObject {
+    name: String,
+    object: std::sync::Mutex<libbpf_rs::Object>,
+    links: std::sync::Mutex<Option<Vec<libbpf_rs::Link>>>,
+    iterators: Vec<(String, libbpf_rs::Link)>,
+}
+
+#[cfg(feature = "ebpf")]
+impl EbpfObject {
+    /// Открыть встроенный объект, загрузить его в ядро и прикрепить программы.
+    pub fn load(program: &str) -> Result<Self> {
+        Self::load_with_shared_maps(program, &[])
+    }
+
+    /// Загрузить объект, заменив часть его карт картами других объектов.
+    ///
+    /// Для каждой пары (имя карты, объект) карта с этим именем берётся из
+    /// уже загруженного объекта (`bpf_map__reuse_fd`): программы обоих
+    /// объектов работают с одними данными без копирования. Если объекта нет
+    /// (`None`), собственная карта урезается до одной записи, чтобы не
+    /// занимать память под данные, которых не будет.
+    pub fn load_with_shared_maps(
+        program: &str,
+        shared_maps: &[(&str, Option<&EbpfObject>)],
+    ) -> Result<Self> {
+        use libbpf_rs::ObjectBuilder;
+        use std::os::fd::AsFd;
+
+        let name = program_name_from_path(program).to_string();
+        let bytes = embedded_object(&name).with_context(|| {
+            format!(
+                "eBPF объект {} не встроен в бинарник. Пересоберите smoothtask-core с feature \"ebpf\" и доступным clang",
+                name
+            )
+        })?;
+
+        let mut open_object = ObjectBuilder::default()
+            .open_memory(bytes)
+            .with_context(|| format!("Не удалось открыть встроенный eBPF объект {}", name))?;
+
+        for mut map in open_object.maps_mut() {
+            let Some((map_name, source)) = shared_maps
+                .iter()
+                .find(|(map_name, _)| map.name() == *map_name)
+            else {
+                continue;
+            };
+            match source {
+                Some(source) => {
+                    let handle = source.map_handle(map_name)?.with_context(|| {
+                        format!("Карта {} не найдена в объекте {}", map_name, source.name())
+                    })?;
+                    map.reuse_fd(handle.as_fd()).with_context(|| {
+                        format!(
+                            "Не удалось подставить карту {} объекта {} в объект {}",
+                            map_name,
+                            source.name(),
+                            name
+                        )
+                    })?;
+                }
+                None => map.set_max_entries(1).with_context(|| {
+                    format!("Не удалось уменьшить карту {} объекта {}", map_name, name)
+                })?,
+            }
+        }
+
+        let mut object = open_object.load().with_context(|| {
+            format!(
+                "Не удалось загрузить eBPF объект {} в ядро. Это может быть вызвано: 1) Несовместимостью версии ядра (требуется Linux 5.4+ с BTF), 2) Отсутствием необходимых прав (CAP_BPF или root)",
+                name
+            )
+        })?;
+
+        let mut iterators = Vec::new();
+        for program in object.progs_mut() {
+            if !is_iterator(&program) {
+                continue;
+            }
+            match program.attach() {
+                Ok(link) => iterators.push((program.name().to_string_lossy().into_owned(), link)),
+                Err(e) => warn_attach_failed(&program, &name, e),
+            }
+        }
+        let links = attach_tracing_programs(&mut object, &name);
+
+        tracing::info!(
+            "eBPF объект {} загружен из памяти ({} байт, {} программ прикреплено)",
+            name,
+            bytes.len(),
+            links.len() + iterators.len()
+        );
+
+        Ok(Self {
+            name,
+            object: std::sync::Mutex::new(object),
+            links: std::sync::Mutex::new(Some(links)),
+            iterators,
+        })
+    }
+
+    /// Прикреплены ли программы объекта к точкам трассировки
+    pub fn is_attached(&self) -> bool {
+        self.links.lock().map_or(true, |links| links.is_some())
+    }
+
+    /// Прикрепить программы объекта заново после [`EbpfObject::detach`]
+    ///
+    /// Объект не перезагружается: программы и карты с накопленными данными
+    /// остаются теми же. Возвращает количество прикреплённых программ.
+    pub fn attach(&self) -> usize {
+        let Ok(mut links) = self.links.lock() else {
+            return 0;
+        };
+        if let Some(links) = links.as_ref() {
+            return links.len();
+        }
+
+        let attached = match self.object.lock() {
+            Ok(mut object) => attach_tracing_programs(&mut object, &self.name),
+            Err(_) => Vec::new(),
+        };
+        let count = attached.len();
+        *links = Some(attached);
+        tracing::info!(
+            "Программы eBPF объекта {} прикреплены ({})",
+            self.name,
+            count
+        );
+        count
+    }
+
+    /// Открепить программы объекта от точек трассировки
+    ///
+    /// Программы перестают выполняться на событиях ядра, карты сохраняют
+    /// последние данные. Возвращает количество откреплённых программ.
+    pub fn detach(&self) -> usize {
+        let Ok(mut links) = self.links.lock() else {
+            return 0;
+        };
+        let count = links.take().map_or(0, |links| links.len());
+        if count > 0 {
+            tracing::info!(
+                "Программы eBPF объекта {} откреплены ({})",
+                self.name,
+                count
+            );
+        }
+        count
+    }
+
+    /// Прикрепить программу `SEC("perf_event")` к открытому событию perf
+    ///
+    /// Дескриптор `perf_fd` должен оставаться открытым, пока программа
+    /// прикреплена; ссылка сбрасывается вместе с остальными при
+    /// [`EbpfObject::detach`].
+    pub fn attach_perf_event(&self, program_name: &str, perf_fd: i32) -> Result<()> {
+        let mut object = self
+            .object
+            .lock()
+            .map_err(|_| anyhow::anyhow!("eBPF объект {} недоступен", self.name))?;
+        let program = object
+            .progs_mut()
+            .find(|program| program.name() == program_name)
+            .with_context(|| {
+                format!(
+                    "Программа {} не найдена в объекте {}",
+                    program_name, self.name
+                )
+            })?;
+        let link = program.attach_perf_event(perf_fd).with_context(|| {
+            format!(
+                "Не удалось прикрепить программу {} объекта {} к событию perf",
+                program_name, self.name
+            )
+        })?;
+
+        let mut links = self
+            .links
+            .lock()
+            .map_err(|_| anyhow::anyhow!("eBPF объект {} недоступен", self.name))?;
+        links.get_or_insert_with(Vec::new).push(link);
+        Ok(())
+    }
+
+    /// Выполнить программу `SEC("syscall")` один раз (`BPF_PROG_TEST_RUN`).
+    ///
+    /// Возвращает код возврата программы.
+    pub fn run_syscall_program(&self, program_name: &str) -> Result<u32> {
+        let mut object = self
+            .object
+            .lock()
+            .map_err(|_| anyhow::anyhow!("eBPF объект {} недоступен", self.name))?;
+        let mut program = object
+            .progs_mut()
+            .find(|program| program.name() == program_name)
+            .with_context(|| {
+                format!(
+                    "Программа {} не найдена в объекте {}",
+                    program_name, self.name
+                )
+            })?;
+        let output = program
+            .test_run(libbpf_rs::ProgramInput::default())
+            .with_context(|| {
+                format!(
+                    "Не удалось выполнить программу {} объекта {}",
+                    program_name, self.name
+                )
+            })?;
+        Ok(output.return_value)
+    }
+
+    /// Имя программы, из которой загружен объект.
+    pub fn name(&self) -> &str {
+        &self.name
+    }
+
+    /// Количество прикреплённых программ (включая итераторы).
+    pub fn attached_programs(&self) -> usize {
+        let links = self
+            .links
+            .lock()
+            .map_or(0, |links| links.as_ref().map_or(0, Vec::len));
+        links + self.iterators.len()
+    }
+
+    /// Выполнить программу-итератор и прочитать весь её вывод.
+    ///
+    /// Каждое чтение создаёт новый проход итератора по объектам ядра.
+    /// Возвращает `None`, если итератора с таким именем в объекте нет.
+    pub fn read_iterator(&self, program_name: &str) -> Result<Option<Vec<u8>>> {
+        let mut output = Vec::new();
+        Ok(self
+            .read_iterator_into(program_name, &mut output)?
+            .then_some(output))
+    }
+
+    /// Выполнить программу-итератор и прочитать её вывод в буфер вызывающего.
+    ///
+    /// Буфер очищается перед чтением, его ёмкость сохраняется, так что при
+    /// повторных чтениях память не выделяется заново. Возвращает `false`,
+    /// если итератора с таким именем в объекте нет.
+    pub fn read_iterator_into(&self, program_name: &str, output: &mut Vec<u8>) -> Result<bool> {
+        use std::io::Read;
+
+        output.clear();
+        let Some((_, link)) = self.iterators.iter().find(|(name, _)| name == program_name) else {
+            return Ok(false);
+        };
+
+        let mut iter = libbpf_rs::Iter::new(link).with_context(|| {
+            format!(
+                "Не удалось создать итератор {} объекта {}",
+                program_name, self.name
+            )
+        })?;
+        iter.read_to_end(output).with_context(|| {
+            format!(
+                "Не удалось прочитать итератор {} объекта {}",
+                program_name, self.name
+            )
+        })?;
+        Ok(true)
+    }
+
+    /// Получить владеющий дескриптор карты по имени.
+    ///
+    /// Возвращает `None`, если карта с таким именем в объекте отсутствует.
+    pub fn map_handle(&self, map_name: &str) -> Result<Option<libbpf_rs::MapHandle>> {
+        let object = self
+            .object
+            .lock()
+            .map_err(|_| anyhow::anyhow!("eBPF объект {} недоступен", self.name))?;
+        for map in object.maps() {
+            if map.name() == map_name {
+                let handle = libbpf_rs::MapHandle::try_from(&map).with_context(|| {
+                    format!(
+                        "Не удалось получить дескриптор карты {} объекта {}",
+                        map_name, self.name
+                    )
+                })?;
+                return Ok(Some(handle));
+            }
+        }
+        Ok(None)
+    }
+
+    /// Накопленная ядром статистика выполнения каждой программы объекта.
+    ///
+    /// Ненулевые значения появляются только при включённом учёте
+    /// (`BPF_ENABLE_STATS`, см. `ebpf_sampling`). Программы, статистику которых
+    /// прочитать не удалось, пропускаются.
+    pub fn program_runtime_stats(
+        &self,
+    ) -> Vec<(String, super::ebpf_sampling::ProgramRuntimeStats)> {
+        use std::os::fd::{AsFd, AsRawFd};
+
+        let Ok(object) = self.object.lock() else {
+            return Vec::new();
+        };
+        object
+            .progs()
+            .filter_map(|program| {
+                let name = program.name().to_string_lossy().into_owned();
+                match super::ebpf_sampling::query_program_runtime(program.as_fd().as_raw_fd()) {
+                    Ok(stats) => Some((name, stats)),
+                    Err(e) => {
+                        tracing::debug!(
+                            "Не удалось прочитать статистику программы {} объекта {}: {}",
+                            name,
+                            self.name,
+                            e
+                        );
+                        None
+                    }
+                }
+            })
+            .collect()
+    }
+
+    /// Память каждой карты объекта по учёту ядра (`memlock`), в байтах.
+    ///
+    /// Читается из fdinfo дескрипторов карт; карты, fdinfo которых прочитать
+    /// не удалось, пропускаются.
+    pub fn map_memory(&self) -> Vec<(String, u64)> {
+        use std::os::fd::{AsFd, AsRawFd};
+
+        let Ok(object) = self.object.lock() else {
+            return Vec::new();
+        };
+        object
+            .maps()
+            .filter_map(|map| {
+                let fdinfo_path = format!("/proc/self/fdinfo/{}", map.as_fd().as_raw_fd());
+                let fdinfo = std::fs::read_to_string(fdinfo_path).ok()?;
+                let bytes = super::ebpf_overhead::parse_fdinfo_memlock(&fdinfo)?;
+                Some((map.name().to_string_lossy().into_owned(), bytes))
+            })
+            .collect()
+    }
+
+    /// Заполнение хеш-карт объекта.
+    ///
+    /// Записи считаются обходом ключей, поэтому метод вызывается редко (см.
+    /// `ebpf_overhead::OVERHEAD_REPORT_INTERVAL`). Массивы, кольцевые буферы и
+    /// другие карты без понятия заполнения пропускаются.
+    pub fn map_usage(&self) -> Vec<super::ebpf_overhead::EbpfMapUsage> {
+        use libbpf_rs::{MapCore, MapType};
+
+        let Ok(object) = self.object.lock() else {
+            return Vec::new();
+        };
+        object
+            .maps()
+            .filter(|map| {
+                matches!(
+                    map.map_type(),
+                    MapType::Hash
+                        | MapType::PercpuHash
+                        | MapType::LruHash
+                        | MapType::LruPercpuHash
+                        | MapType::LpmTrie
+                )
+            })
+            .map(|map| {
+                super::ebpf_overhead::EbpfMapUsage::new(
+                    &self.name,
+                    &map.name().to_string_lossy(),
+                    map.keys().count() as u64,
+                    map.max_entries(),
+                )
+            })
+            .collect()
+    }
+}
+
+/// Программа-итератор (`SEC("iter/...")`)
+#[cfg(feature = "ebpf")]
+fn is_iterator(program: &libbpf_rs::ProgramMut<'_>) -> bool {
+    program.section().to_string_lossy().starts_with("iter/")
+}
+
+/// Программа выборки по событию perf (`SEC("perf_event")`): без дескриптора
+/// события её не к чему прикрепить автоматически
+#[cfg(feature = "ebpf")]
+fn is_perf_event(program: &libbpf_rs::ProgramMut<'_>) -> bool {
+    program.section().to_string_lossy() == "perf_event"
+}
+
+/// Программа `SEC("syscall")`: выполняется только по вызову из userspace
+#[cfg(feature = "ebpf")]
+fn is_syscall_program(program: &libbpf_rs::ProgramMut<'_>) -> bool {
+    program.section().to_string_lossy() == "syscall"
+}
+
+#[cfg(feature = "ebpf")]
+fn warn_attach_failed(program: &libbpf_rs::ProgramMut<'_>, object: &str, e: libbpf_rs::Error) {
+    tracing::warn!(
+        "Не удалось прикрепить программу {:?} из объекта {}: {}",
+        program.name(),
+        object,
+        e
+    );
+}
+
+/// Прикрепить все программы объекта, кроме итераторов и программ perf_event
+/// и syscall
+#[cfg(feature = "ebpf")]
+fn attach_tracing_programs(object: &mut libbpf_rs::Object, name: &str) -> Vec<libbpf_rs::Link> {
+    let mut links = Vec::new();
+    for program in object.progs_mut() {
+        if is_iterator(&program) || is_perf_event(&program) || is_syscall_program(&program) {
+            continue;
+        }
+        match program.attach() {
+            Ok(link) => links.push(link),
+            Err(e) => warn_attach_failed(&program, name, e),
+        }
+    }
+    links
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    static TEST_TABLE: &[(&str, &[u8])] = &[
+        ("gpu_monitor", b"\x7fELF"),
+        ("gpu_monitor_high_perf", b""),
+        ("cpu_metrics", b"\x7fELF"),
+    ];
+
+    #[test]
+    fn test_program_name_from_path() {
+        assert_eq!(
+            program_name_from_path("src/ebpf_programs/cpu_metrics.c"),
+            "cpu_metrics"
+        );
+        assert_eq!(program_name_from_path("cpu_metrics.bpf.o"), "cpu_metrics");
+        assert_eq!(program_name_from_path("cpu_metrics"), "cpu_metrics");
+        assert_eq!(
+            program_name_from_path("/usr/lib/smoothtask/process_gpu.bpf.o"),
+            "process_gpu"
+        );
+    }
+
+    #[test]
+    fn test_find_object_by_name_and_path() {
+        assert!(find_object(TEST_TABLE, "cpu_metrics").is_some());
+        assert!(find_object(TEST_TABLE, "src/ebpf_programs/cpu_metrics.c").is_some());
+        assert!(find_object(TEST_TABLE, "network_monitor").is_none());
+        // Пустой объект считается отсутствующим
+        assert!(find_object(TEST_TABLE, "gpu_monitor_high_perf").is_none());
+    }
+
+    #[test]
+    fn test_select_by_priority() {
+        let candidates = [
+            "gpu_monitor_comprehensive",
+            "gpu_monitor_high_perf",
+            "gpu_monitor",
+        ];
+        assert_eq!(select_from(TEST_TABLE, &candidates), Some("gpu_monitor"));
+        assert_eq!(select_from(TEST_TABLE, &["filesystem_monitor"]), None);
+    }
+
+    #[test]
+    fn test_embedded_table_names_are_plain() {
+        for name in embedded_program_names() {
+            assert_eq!(program_name_from_path(name), name);
+        }
+    }
+}
@@ -0,0 +1,411 @@
+//! Стоимость загруженных eBPF программ и заполнение их карт.
+//!
+//! Отчёт [`EbpfOverheadReport`] собирается коллектором периодически и
+//! отвечает на вопрос «какая проба стала горячей точкой»:
+//! - время выполнения и количество запусков каждой программы (`run_time_ns`,
+//!   `run_cnt` из `bpf_prog_info`, пока включён `BPF_ENABLE_STATS`);
+//! - заполнение хеш-карт относительно `max_entries` (массивы всегда заполнены,
+//!   поэтому не учитываются);
+//! - отладочные счётчики общего заголовка `ebpf_programs/smoothtask_debug.h`:
+//!   пропавшие записи и отказы `bpf_map_update_elem()` по каждому объекту;
+//! - текущие коэффициенты адаптивной выборки.
+//!
+//! Отчёт публикуется через API (`/api/ebpf/overhead`) и в Prometheus.
+
+use std::time::Duration;
+
+use serde::{Deserialize, Serialize};
+
+use super::ebpf_sampling::{ProgramRuntimeStats, SamplingClassState};
+
+/// Per-CPU массив отладочных счётчиков.
+pub const DEBUG_MAP_NAME: &str = "smoothtask_debug_map";
+
+/// Слот счётчика пропавших записей.
+pub const DEBUG_SLOT_LOOKUP_MISS: usize = 0;
+/// Слот счётчика отказов обновления карт.
+pub const DEBUG_SLOT_UPDATE_FAIL: usize = 1;
+/// Размер массива отладочных счётчиков (с запасом под новые слоты).
+pub const DEBUG_SLOTS: usize = 4;
+
+/// Интервал пересборки отчёта: подсчёт записей хеш-карт обходит их целиком.
+pub const OVERHEAD_REPORT_INTERVAL: Duration = Duration::from_secs(10);
+
+/// Системный переключатель учёта времени выполнения eBPF программ.
+pub const BPF_STATS_SYSCTL_PATH: &str = "/proc/sys/kernel/bpf_stats_enabled";
+
+/// Включён ли учёт времени выполнения через sysctl `kernel.bpf_stats_enabled`.
+pub fn sysctl_run_time_stats_enabled() -> bool {
+    std::fs::read_to_string(BPF_STATS_SYSCTL_PATH)
+        .map(|value| value.trim() == "1")
+        .unwrap_or(false)
+}
+
+/// Память карты по учёту ядра (поле `memlock` из `/proc/<pid>/fdinfo/<fd>`), в байтах.
+///
+/// Учитывает и карты без понятия заполнения (массивы, кольцевые буферы).
+pub fn parse_fdinfo_memlock(fdinfo: &str) -> Option<u64> {
+    fdinfo
+        .lines()
+        .find_map(|line| line.strip_prefix("memlock:"))
+        .and_then(|value| value.trim().parse().ok())
+}
+
+/// Стоимость одной eBPF программы.
+#[derive(Debug, Clone, Default, PartialEq, Serialize, Deserialize)]
+pub struct EbpfProgramOverhead {
+    /// Объект (имя исходного файла), из которого загружена программа
+    pub object: String,
+    /// Имя программы (функции)
+    pub program: String,
+    /// Количество запусков
+    pub run_cnt: u64,
+    /// Суммарное время выполнения (нс)
+    pub run_time_ns: u64,
+    /// Среднее время одного запуска (нс)
+    pub avg_run_time_ns: u64,
+}
+
+impl EbpfProgramOverhead {
+    /// Построить запись по статистике ядра.
+    pub fn new(object: &str, program: &str, stats: ProgramRuntimeStats) -> Self {
+        Self {
+            object: object.to_string(),
+            program: program.to_string(),
+            run_cnt: stats.run_cnt,
+            run_time_ns: stats.run_time_ns,
+            avg_run_time_ns: stats.run_time_ns.checked_div(stats.run_cnt).unwrap_or(0),
+        }
+    }
+}
+
+/// Заполнение одной карты.
+#[derive(Debug, Clone, Default, PartialEq, Serialize, Deserialize)]
+pub struct EbpfMapUsage {
+    /// Объект, которому принадлежит карта
+    pub object: String,
+    /// Имя карты
+    pub map: String,
+    /// Текущее количество записей
+    pub entries: u64,
+    /// Ёмкость карты
+    pub max_entries: u32,
+    /// Доля заполнения (0.0–1.0)
+    pub fill_ratio: f64,
+}
+
+impl EbpfMapUsage {
+    /// Построить запись по количеству записей и ёмкости.
+    pub fn new(object: &str, map: &str, entries: u64, max_entries: u32) -> Self {
+        let fill_ratio = if max_entries == 0 {
+            0.0
+        } else {
+            (entries as f64 / max_entries as f64).min(1.0)
+        };
+        Self {
+            object: object.to_string(),
+            map: map.to_string(),
+            entries,
+            max_entries,
+            fill_ratio,
+        }
+    }
+}
+
+/// Отладочные счётчики одного объекта.
+#[derive(Debug, Clone, Default, PartialEq, Eq, Serialize, Deserialize)]
+pub struct EbpfDebugCounters {
+    /// Объект, из которого прочитаны счётчики
+    pub object: String,
+    /// Записи, которые должны были существовать, но не нашлись
+    pub lookup_misses: u64,
+    /// Отказы `bpf_map_update_elem()` (переполнение карты, нехватка памяти)
+    pub update_failures: u64,
+}
+
+impl EbpfDebugCounters {
+    /// Разобрать итоги слотов `smoothtask_debug_map` (уже свёрнутые по CPU).
+    pub fn from_slots(object: &str, slots: &[u64]) -> Self {
+        let slot = |index: usize| slots.get(index).copied().unwrap_or(0);
+        Self {
+            object: object.to_string(),
+            lookup_misses: slot(DEBUG_SLOT_LOOKUP_MISS),
+            update_failures: slot(DEBUG_SLOT_UPDATE_FAIL),
+        }
+    }
+}
+
+/// Отчёт о стоимости eBPF подсистемы.
+#[derive(Debug, Clone, Default, PartialEq, Serialize, Deserialize)]
+pub struct EbpfOverheadReport {
+    /// Учёт времени выполнения программ включён (иначе run_time_ns нулевые)
+    pub run_time_stats_enabled: bool,
+    /// Стоимость программ
+    pub programs: Vec<EbpfProgramOverhead>,
+    /// Заполнение хеш-карт
+    pub maps: Vec<EbpfMapUsage>,
+    /// Отладочные счётчики объектов
+    pub debug_counters: Vec<EbpfDebugCounters>,
+    /// Коэффициенты адаптивной выборки
+    pub sampling: Vec<SamplingClassState>,
+}
+
+impl EbpfOverheadReport {
+    /// Упорядочить записи: самые дорогие программы и самые заполненные карты первыми.
+    pub fn sort(&mut self) {
+        self.programs.sort_by(|a, b| {
+            b.run_time_ns
+                .cmp(&a.run_time_ns)
+                .then_with(|| a.object.cmp(&b.object))
+                .then_with(|| a.program.cmp(&b.program))
+        });
+        self.maps.sort_by(|a, b| {
+            b.fill_ratio
+                .total_cmp(&a.fill_ratio)
+                .then_with(|| a.object.cmp(&b.object))
+                .then_with(|| a.map.cmp(&b.map))
+        });
+        self.debug_counters.sort_by(|a, b| a.object.cmp(&b.object));
+    }
+}
+
+fn escape_label(value: &str) -> String {
+    value
+        .replace('\\', "\\\\")
+        .replace('"', "\\\"")
+        .replace('\n', "\\n")
+}
+
+fn push_family<T>(
+    output: &mut String,
+    name: &str,
+    metric_type: &str,
+    help: &str,
+    items: &[T],
+    labels: impl Fn(&T) -> String,
+    value: impl Fn(&T) -> String,
+) {
+    if items.is_empty() {
+        return;
+    }
+
+    output.push_str(&format!("# HELP {} {}\n", name, help));
+    output.push_str(&format!("# TYPE {} {}\n", name, metric_type));
+    for item in items {
+        output.push_str(&format!("{}{{{}}} {}\n", name, labels(item), value(item)));
+    }
+}
+
+/// Отчёт в формате Prometheus.
+pub fn overhead_to_prometheus(report: &EbpfOverheadReport) -> String {
+    let mut output = String::new();
+
+    let program_labels = |program: &EbpfProgramOverhead| {
+        format!(
+            "object=\"{}\",program=\"{}\"",
+            escape_label(&program.object),
+            escape_label(&program.program)
+        )
+    };
+    push_family(
+        &mut output,
+        "smoothtask_ebpf_program_runs_total",
+        "counter",
+        "Invocations of the eBPF program",
+        &report.programs,
+        program_labels,
+        |program| program.run_cnt.to_string(),
+    );
+    push_family(
+        &mut output,
+        "smoothtask_ebpf_program_run_time_ns_total",
+        "counter",
+        "Total run time of the eBPF program in nanoseconds",
+        &report.programs,
+        program_labels,
+        |program| program.run_time_ns.to_string(),
+    );
+    push_family(
+        &mut output,
+        "smoothtask_ebpf_program_avg_run_time_ns",
+        "gauge",
+        "Mean run time of one eBPF program invocation in nanoseconds",
+        &report.programs,
+        program_labels,
+        |program| program.avg_run_time_ns.to_string(),
+    );
+
+    let map_labels = |map: &EbpfMapUsage| {
+        format!(
+            "object=\"{}\",map=\"{}\"",
+            escape_label(&map.object),
+            escape_label(&map.map)
+        )
+    };
+    push_family(
+        &mut output,
+        "smoothtask_ebpf_map_entries",
+        "gauge",
+        "Entries in the eBPF hash map",
+        &report.maps,
+        map_labels,
+        |map| map.entries.to_string(),
+    );
+    push_family(
+        &mut output,
+        "smoothtask_ebpf_map_max_entries",
+        "gauge",
+        "Capacity of the eBPF hash map",
+        &report.maps,
+        map_labels,
+        |map| map.max_entries.to_string(),
+    );
+    push_family(
+        &mut output,
+        "smoothtask_ebpf_map_fill_ratio",
+        "gauge",
+        "Fill ratio of the eBPF hash map (0-1)",
+        &report.maps,
+        map_labels,
+        |map| format!("{:.4}", map.fill_ratio),
+    );
+
+    let object_labels =
+        |counters: &EbpfDebugCounters| format!("object=\"{}\"", escape_label(&counters.object));
+    push_family(
+        &mut output,
+        "smoothtask_ebpf_lookup_misses_total",
+        "counter",
+        "eBPF map entries that were expected but missing",
+        &report.debug_counters,
+        object_labels,
+        |counters| counters.lookup_misses.to_string(),
+    );
+    push_family(
+        &mut output,
+        "smoothtask_ebpf_update_failures_total",
+        "counter",
+        "Failed eBPF map updates (full map, out of memory)",
+        &report.debug_counters,
+        object_labels,
+        |counters| counters.update_failures.to_string(),
+    );
+
+    let class_labels = |state: &SamplingClassState| format!("class=\"{}\"", state.class.name());
+    push_family(
+        &mut output,
+        "smoothtask_ebpf_sampling_rate",
+        "gauge",
+        "Adaptive sampling rate of the event class (1 = every event)",
+        &report.sampling,
+        class_labels,
+        |state| state.rate.to_string(),
+    );
+    push_family(
+        &mut output,
+        "smoothtask_ebpf_sampling_overhead_percent",
+        "gauge",
+        "Measured CPU share of the event class programs in percent of all CPUs",
+        &report.sampling,
+        class_labels,
+        |state| format!("{:.4}", state.overhead_percent),
+    );
+
+    output
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+    use crate::metrics::ebpf_sampling::SamplingClass;
+
+    fn report() -> EbpfOverheadReport {
+        let mut report = EbpfOverheadReport {
+            run_time_stats_enabled: true,
+            programs: vec![
+                EbpfProgramOverhead::new(
+                    "application_performance",
+                    "trace_kmalloc",
+                    ProgramRuntimeStats {
+                        run_time_ns: 1_000,
+                        run_cnt: 10,
+                    },
+                ),
+                EbpfProgramOverhead::new(
+                    "sched_monitor",
+                    "sched_switch",
+                    ProgramRuntimeStats {
+                        run_time_ns: 90_000,
+                        run_cnt: 300,
+                    },
+                ),
+            ],
+            maps: vec![
+                EbpfMapUsage::new("sched_monitor", "sched_task_map", 512, 20480),
+                EbpfMapUsage::new("process_monitor", "process_map", 10240, 10240),
+            ],
+            debug_counters: vec![EbpfDebugCounters::from_slots("process_monitor", &[3, 7])],
+            sampling: vec![SamplingClassState {
+                class: SamplingClass::Kmem,
+                rate: 8,
+                overhead_percent: 0.75,
+            }],
+        };
+        report.sort();
+        report
+    }
+
+    #[test]
+    fn test_program_overhead() {
+        let overhead = EbpfProgramOverhead::new("a", "b", ProgramRuntimeStats::default());
+        assert_eq!(overhead.avg_run_time_ns, 0);
+
+        let report = report();
+        // Самая дорогая программа первой
+        assert_eq!(report.programs[0].program, "sched_switch");
+        assert_eq!(report.programs[0].avg_run_time_ns, 300);
+    }
+
+    #[test]
+    fn test_map_usage_and_debug_counters() {
+        let report = report();
+        assert_eq!(report.maps[0].map, "process_map");
+        assert_eq!(report.maps[0].fill_ratio, 1.0);
+        assert_eq!(report.maps[1].fill_ratio, 0.025);
+        assert_eq!(EbpfMapUsage::new("o", "m", 5, 0).fill_ratio, 0.0);
+
+        let counters = &report.debug_counters[0];
+        assert_eq!((counters.lookup_misses, counters.update_failures), (3, 7));
+        assert_eq!(EbpfDebugCounters::from_slots("o", &[]).update_failures, 0);
+    }
+
+    #[test]
+    fn test_overhead_to_prometheus() {
+        let output = overhead_to_prometheus(&report());
+        assert!(output.contains("# TYPE smoothtask_ebpf_program_runs_total counter"));
+        assert!(output.contains(
+            "smoothtask_ebpf_program_avg_run_time_ns{object=\"sched_monitor\",program=\"sched_switch\"} 300"
+        ));
+        assert!(output.contains(
+            "smoothtask_ebpf_map_fill_ratio{object=\"process_monitor\",map=\"process_map\"} 1.0000"
+        ));
+        assert!(
+            output.contains("smoothtask_ebpf_update_failures_total{object=\"process_monitor\"} 7")
+        );
+        assert!(output.contains("smoothtask_ebpf_sampling_rate{class=\"kmem\"} 8"));
+
+        // Пустой отчёт не порождает семейств без значений
+        assert!(overhead_to_prometheus(&EbpfOverheadReport::default()).is_empty());
+    }
+
+    #[test]
+    fn test_parse_fdinfo_memlock() {
+        let fdinfo = "pos:\t0\nflags:\t02000002\nmnt_id:\t15\nino:\t1057\n\
+                      map_type:\t1\nkey_size:\t4\nvalue_size:\t80\n\
+                      max_entries:\t10240\nmap_flags:\t0x0\nmap_extra:\t0x0\n\
+                      memlock:\t1003520\nmap_id:\t42\nfrozen:\t0\n";
+        assert_eq!(parse_fdinfo_memlock(fdinfo), Some(1_003_520));
+        assert_eq!(parse_fdinfo_memlock("pos:\t0\nflags:\t02\n"), None);
+        assert_eq!(parse_fdinfo_memlock("memlock:\tunknown\n"), None);
+    }
+}
@@ -0,0 +1,1428 @@
+//! Профилировщик стеков по запросу для диагностики зависаний.
+//!
+//! Агрегированные счётчики показывают, что процесс простаивает или занимает
+//! CPU, но не показывают где. Сессия профилирования запускается через API с
+//! явной длительностью и списком TGID: программа `stack_profiler.c` снимает
+//! стеки отмеченных процессов на CPU (программа perf_event на таймере
+//! cpu-clock каждого CPU) и вне CPU (`sched_switch`, время от ухода с CPU до
+//! возвращения). Стеки записываются в карту `BPF_MAP_TYPE_STACK_TRACE`, а
+//! счётчики агрегируются в ядре, так что стоимость сессии ограничена и при
+//! 99 Гц на всех CPU.
+//!
+//! По окончании сессии программы открепляются, объект выгружается, а
+//! результат символизируется: адреса ядра — по `/proc/kallsyms`, адреса
+//! процессов — по `/proc/<pid>/maps` и таблицам символов ELF (`.symtab` или
+//! `.dynsym`) отображённых файлов. Имена не деманглируются; адреса без символа
+//! выводятся как `файл+0xсмещение`. Результат доступен в формате свёрнутых
+//! стеков (`comm;кадр;кадр значение`, вход `flamegraph.pl`) и деревом для
+//! d3-flame-graph.
+
+use std::collections::HashMap;
+use std::fs::File;
+use std::sync::{mpsc, Arc, Mutex};
+use std::time::{Duration, Instant};
+
+use serde::{Deserialize, Serialize};
+
+/// Имя встроенного eBPF объекта профилировщика
+pub const STACK_PROFILER_OBJECT: &str = "stack_profiler";
+/// Программа выборки на CPU (`SEC("perf_event")`)
+pub const PROFILE_CPU_SAMPLE_PROGRAM: &str = "profile_cpu_sample";
+/// Параметры сессии (`struct profile_config`)
+pub const PROFILE_CONFIG_MAP: &str = "profile_config_map";
+/// Отмеченные процессы
+pub const PROFILE_TARGET_MAP: &str = "profile_target_map";
+/// Карта стеков `BPF_MAP_TYPE_STACK_TRACE`
+pub const PROFILE_STACK_MAP: &str = "profile_stack_map";
+/// Агрегированные счётчики по ключу (`struct profile_key`)
+pub const PROFILE_COUNT_MAP: &str = "profile_count_map";
+
+/// Ёмкость карты отмеченных процессов (`PROFILE_MAX_TARGETS`)
+pub const MAX_PROFILE_TARGETS: usize = 64;
+/// Ёмкость карты счётчиков (`PROFILE_MAX_COUNTS`)
+pub const PROFILE_MAX_COUNTS: usize = 16384;
+/// Глубина стека в карте стеков (`PROFILE_STACK_DEPTH`)
+pub const PROFILE_STACK_DEPTH: usize = 64;
+
+/// Выборка на CPU (`PROFILE_MODE_ON_CPU`)
+pub const PROFILE_MODE_ON_CPU: u32 = 1 << 0;
+/// Ожидание вне CPU (`PROFILE_MODE_OFF_CPU`)
+pub const PROFILE_MODE_OFF_CPU: u32 = 1 << 1;
+
+/// Частота выборки по умолчанию: не кратна типичным периодам таймеров
+pub const DEFAULT_PROFILE_FREQUENCY_HZ: u64 = 99;
+/// Наибольшая допустимая частота выборки
+pub const MAX_PROFILE_FREQUENCY_HZ: u64 = 1000;
+/// Наибольшая длительность сессии
+pub const MAX_PROFILE_DURATION_SECS: u64 = 300;
+/// Порог времени вне CPU по умолчанию (мкс): короткие ожидания почти не
+/// влияют на отзывчивость, но составляют большую часть переключений
+pub const DEFAULT_MIN_OFFCPU_US: u64 = 1000;
+
+/// Ошибка `bpf_get_stackid()` для потока без пользовательского стека (-EFAULT)
+const STACK_ID_NO_USER_STACK: i32 = -14;
+
+/// Вид выборки
+#[derive(Debug, Clone, Copy, PartialEq, Eq, Hash, Serialize, Deserialize)]
+#[serde(rename_all = "snake_case")]
+pub enum StackKind {
+    /// Выборка на CPU; значение — количество выборок
+    OnCpu,
+    /// Ожидание вне CPU; значение — время в микросекундах
+    OffCpu,
+}
+
+impl StackKind {
+    fn from_raw(kind: u32) -> Option<Self> {
+        match kind {
+            0 => Some(StackKind::OnCpu),
+            1 => Some(StackKind::OffCpu),
+            _ => None,
+        }
+    }
+}
+
+/// Параметры сессии профилирования
+#[derive(Debug, Clone, PartialEq, Eq, Serialize, Deserialize)]
+pub struct StackProfileRequest {
+    /// Профилируемые процессы
+    pub tgids: Vec<u32>,
+    /// Длительность сессии в секундах
+    pub duration_secs: u64,
+    /// Снимать стеки на CPU
+    #[serde(default = "default_enabled")]
+    pub on_cpu: bool,
+    /// Снимать стеки ожидания вне CPU
+    #[serde(default = "default_enabled")]
+    pub off_cpu: bool,
+    /// Частота выборки на CPU (Гц, на каждом CPU)
+    #[serde(default = "default_frequency_hz")]
+    pub frequency_hz: u64,
+    /// Ожидания вне CPU короче порога (мкс) не учитываются
+    #[serde(default = "default_min_offcpu_us")]
+    pub min_offcpu_us: u64,
+}
+
+fn default_enabled() -> bool {
+    true
+}
+
+fn default_frequency_hz() -> u64 {
+    DEFAULT_PROFILE_FREQUENCY_HZ
+}
+
+fn default_min_offcpu_us() -> u64 {
+    DEFAULT_MIN_OFFCPU_US
+}
+
+impl StackProfileRequest {
+    /// Проверить параметры сессии
+    pub fn validate(&self) -> anyhow::Result<()> {
+        if self.tgids.is_empty() {
+            anyhow::bail!("Не указаны процессы для профилирования");
+        }
+        if self.tgids.len() > MAX_PROFILE_TARGETS {
+            anyhow::bail!(
+                "Слишком много процессов для профилирования: {} (максимум {})",
+                self.tgids.len(),
+                MAX_PROFILE_TARGETS
+            );
+        }
+        if self.tgids.contains(&0) {
+            anyhow::bail!("TGID 0 (idle) не может быть профилирован");
+        }
+        if self.duration_secs == 0 || self.duration_secs > MAX_PROFILE_DURATION_SECS {
+            anyhow::bail!(
+                "Длительность сессии должна быть от 1 до {} секунд",
+                MAX_PROFILE_DURATION_SECS
+            );
+        }
+        if !self.on_cpu && !self.off_cpu {
+            anyhow::bail!("Не выбран ни один режим профилирования (on_cpu, off_cpu)");
+        }
+        if self.on_cpu && (self.frequency_hz == 0 || self.frequency_hz > MAX_PROFILE_FREQUENCY_HZ) {
+            anyhow::bail!(
+                "Частота выборки должна быть от 1 до {} Гц",
+                MAX_PROFILE_FREQUENCY_HZ
+            );
+        }
+        Ok(())
+    }
+
+    /// Маска режимов `PROFILE_MODE_*`
+    pub fn modes(&self) -> u32 {
+        let mut modes = 0;
+        if self.on_cpu {
+            modes |= PROFILE_MODE_ON_CPU;
+        }
+        if self.off_cpu {
+            modes |= PROFILE_MODE_OFF_CPU;
+        }
+        modes
+    }
+}
+
+/// Параметры сессии в раскладке ядра (`struct profile_config`)
+#[repr(C)]
+#[derive(Debug, Clone, Copy, Default, PartialEq, Eq)]
+pub struct RawProfileConfig {
+    pub min_offcpu_ns: u64,
+    pub modes: u32,
+    pub _pad: u32,
+}
+
+impl RawProfileConfig {
+    /// Параметры для запроса; нулевая маска режимов останавливает учёт
+    pub fn new(request: &StackProfileRequest) -> Self {
+        Self {
+            min_offcpu_ns: request.min_offcpu_us.saturating_mul(1_000),
+            modes: request.modes(),
+            _pad: 0,
+        }
+    }
+
+    /// Сериализовать запись для записи в карту
+    pub fn to_bytes(&self) -> [u8; 16] {
+        let mut bytes = [0u8; 16];
+        bytes[0..8].copy_from_slice(&self.min_offcpu_ns.to_ne_bytes());
+        bytes[8..12].copy_from_slice(&self.modes.to_ne_bytes());
+        bytes
+    }
+}
+
+/// Ключ агрегации в раскладке ядра (`struct profile_key`)
+#[repr(C)]
+#[derive(Debug, Clone, Copy, Default, PartialEq, Eq)]
+pub struct RawProfileKey {
+    pub tgid: u32,
+    pub kind: u32,
+    pub user_stack_id: i32,
+    pub kernel_stack_id: i32,
+    pub comm: [u8; 16],
+}
+
+impl RawProfileKey {
+    /// Разобрать ключ карты счётчиков
+    pub fn from_bytes(data: &[u8]) -> Option<Self> {
+        if data.len() < std::mem::size_of::<Self>() {
+            return None;
+        }
+        let u32_at =
+            |offset: usize| u32::from_ne_bytes(data[offset..offset + 4].try_into().unwrap());
+        let mut comm = [0u8; 16];
+        comm.copy_from_slice(&data[16..32]);
+        Some(Self {
+            tgid: u32_at(0),
+            kind: u32_at(4),
+            user_stack_id: u32_at(8) as i32,
+            kernel_stack_id: u32_at(12) as i32,
+            comm,
+        })
+    }
+
+    /// Имя потока
+    pub fn comm(&self) -> String {
+        let len = self.comm.iter().position(|&b| b == 0).unwrap_or(16);
+        String::from_utf8_lossy(&self.comm[..len]).into_owned()
+    }
+}
+
+/// Счётчики ключа в раскладке ядра (`struct profile_count`)
+#[repr(C)]
+#[derive(Debug, Clone, Copy, Default, PartialEq, Eq)]
+pub struct RawProfileCount {
+    /// Выборки на CPU или уходы с CPU
+    pub samples: u64,
+    /// Суммарное время вне CPU (нс)
+    pub total_ns: u64,
+}
+
+impl RawProfileCount {
+    /// Разобрать значение карты счётчиков
+    pub fn from_bytes(data: &[u8]) -> Option<Self> {
+        if data.len() < std::mem::size_of::<Self>() {
+            return None;
+        }
+        Some(Self {
+            samples: u64::from_ne_bytes(data[0..8].try_into().ok()?),
+            total_ns: u64::from_ne_bytes(data[8..16].try_into().ok()?),
+        })
+    }
+}
+
+/// Адреса стека из значения карты стеков (от вершины к корню)
+///
+/// Ядро дополняет стеки короче `PROFILE_STACK_DEPTH` нулями.
+pub fn parse_stack_trace(data: &[u8]) -> Vec<u64> {
+    data.chunks_exact(8)
+        .map(|chunk| u64::from_ne_bytes(chunk.try_into().unwrap()))
+        .take_while(|&addr| addr != 0)
+        .collect()
+}
+
+/// Атрибуты события perf (`struct perf_event_attr`, `PERF_ATTR_SIZE_VER5`)
+#[repr(C)]
+#[derive(Debug, Clone, Copy, Default)]
+pub struct RawPerfEventAttr {
+    pub type_: u32,
+    pub size: u32,
+    pub config: u64,
+    pub sample_freq: u64,
+    pub sample_type: u64,
+    pub read_format: u64,
+    pub flags: u64,
+    pub wakeup_events: u32,
+    pub bp_type: u32,
+    pub config1: u64,
+    pub config2: u64,
+    pub branch_sample_type: u64,
+    pub sample_regs_user: u64,
+    pub sample_stack_user: u32,
+    pub clockid: i32,
+    pub sample_regs_intr: u64,
+    pub aux_watermark: u32,
+    pub sample_max_stack: u16,
+    pub _reserved: u16,
+}
+
+impl RawPerfEventAttr {
+    const PERF_TYPE_SOFTWARE: u32 = 1;
+    const PERF_COUNT_SW_CPU_CLOCK: u64 = 0;
+    /// Бит `freq`: `sample_freq` задаёт частоту, а не период
+    const FLAG_FREQ: u64 = 1 << 10;
+
+    /// Программный таймер cpu-clock с заданной частотой выборки
+    ///
+    /// Не требует аппаратных счётчиков, поэтому работает и в виртуальных машинах.
+    pub fn cpu_clock(frequency_hz: u64) -> Self {
+        Self {
+            type_: Self::PERF_TYPE_SOFTWARE,
+            size: std::mem::size_of::<Self>() as u32,
+            config: Self::PERF_COUNT_SW_CPU_CLOCK,
+            sample_freq: frequency_hz,
+            flags: Self::FLAG_FREQ,
+            ..Default::default()
+        }
+    }
+}
+
+/// Разобрать список CPU в формате sysfs (`0-3,6`)
+pub fn parse_cpu_list(text: &str) -> Vec<u32> {
+    let mut cpus = Vec::new();
+    for range in text.trim().split(',').filter(|range| !range.is_empty()) {
+        let mut bounds = range
+            .splitn(2, '-')
+            .map(|bound| bound.trim().parse::<u32>());
+        match (bounds.next(), bounds.next()) {
+            (Some(Ok(cpu)), None) => cpus.push(cpu),
+            (Some(Ok(first)), Some(Ok(last))) if first <= last => cpus.extend(first..=last),
+            _ => {}
+        }
+    }
+    cpus
+}
+
+/// Символы ядра из `/proc/kallsyms`
+///
+/// При `kernel.kptr_restrict` адреса скрыты (нулевые) и таблица пуста:
+/// кадры ядра выводятся адресами.
+#[derive(Debug, Clone, Default)]
+pub struct KernelSymbols {
+    symbols: Vec<(u64, String)>,
+}
+
+impl KernelSymbols {
+    /// Прочитать `/proc/kallsyms`
+    pub fn load() -> Self {
+        match std::fs::read_to_string("/proc/kallsyms") {
+            Ok(text) => Self::parse(&text),
+            Err(e) => {
+                tracing::debug!("Не удалось прочитать /proc/kallsyms: {}", e);
+                Self::default()
+            }
+        }
+    }
+
+    /// Разобрать содержимое `/proc/kallsyms` (только символы кода)
+    pub fn parse(text: &str) -> Self {
+        let mut symbols: Vec<(u64, String)> = text
+            .lines()
+            .filter_map(|line| {
+                let mut fields = line.split_whitespace();
+                let addr = u64::from_str_radix(fields.next()?, 16).ok()?;
+                let kind = fields.next()?;
+                let name = fields.next()?;
+                let is_code = matches!(kind, "t" | "T" | "w" | "W");
+                (addr != 0 && is_code).then(|| (addr, name.to_string()))
+            })
+            .collect();
+        symbols.sort_by_key(|(addr, _)| *addr);
+        Self { symbols }
+    }
+
+    /// Ближайший символ не выше адреса
+    pub fn resolve(&self, addr: u64) -> Option<&str> {
+        let index = self.symbols.partition_point(|(start, _)| *start <= addr);
+        index
+            .checked_sub(1)
+            .map(|index| self.symbols[index].1.as_str())
+    }
+}
+
+/// Исполняемая область из `/proc/<pid>/maps`
+#[derive(Debug, Clone, PartialEq, Eq)]
+pub struct MapRegion {
+    pub start: u64,
+    pub end: u64,
+    /// Смещение области в файле
+    pub offset: u64,
+    /// Устройство и inode файла: один файл в разных процессах читается один раз
+    pub dev: String,
+    pub inode: u64,
+    pub path: String,
+}
+
+/// Разобрать `/proc/<pid>/maps`, оставив исполняемые области файлов
+pub fn parse_proc_maps(text: &str) -> Vec<MapRegion> {
+    let mut regions: Vec<MapRegion> = text
+        .lines()
+        .filter_map(|line| {
+            let fields: Vec<&str> = line.split_whitespace().collect();
+            if fields.len() < 6 || !fields[1].contains('x') || !fields[5].starts_with('/') {
+                return None;
+            }
+            let (start, end) = fields[0].split_once('-')?;
+            let path = fields[5..].join(" ");
+            Some(MapRegion {
+                start: u64::from_str_radix(start, 16).ok()?,
+                end: u64::from_str_radix(end, 16).ok()?,
+                offset: u64::from_str_radix(fields[2], 16).ok()?,
+                dev: fields[3].to_string(),
+                inode: fields[4].parse().ok()?,
+                path: path.trim_end_matches(" (deleted)").to_string(),
+            })
+        })
+        .collect();
+    regions.sort_by_key(|region| region.start);
+    regions
+}
+
+/// Позиционное чтение файла без загрузки целиком (образы вроде libxul
+/// занимают сотни мегабайт, а нужны только заголовки и таблицы символов)
+trait ElfSource {
+    fn read_at(&self, offset: u64, len: usize) -> Option<Vec<u8>>;
+}
+
+impl ElfSource for [u8] {
+    fn read_at(&self, offset: u64, len: usize) -> Option<Vec<u8>> {
+        let start = usize::try_from(offset).ok()?;
+        self.get(start..start.checked_add(len)?).map(<[u8]>::to_vec)
+    }
+}
+
+impl ElfSource for File {
+    fn read_at(&self, offset: u64, len: usize) -> Option<Vec<u8>> {
+        use std::os::unix::fs::FileExt;
+
+        let mut buffer = vec![0u8; len];
+        self.read_exact_at(&mut buffer, offset).ok()?;
+        Some(buffer)
+    }
+}
+
+/// Функции из таблиц символов ELF64 (little-endian)
+#[derive(Debug, Clone, Default)]
+pub struct ElfSymbols {
+    /// Загружаемые сегменты: (смещение в файле, виртуальный адрес, размер в файле)
+    segments: Vec<(u64, u64, u64)>,
+    /// Функции: (адрес, размер, имя), по возрастанию адреса
+    symbols: Vec<(u64, u64, String)>,
+}
+
+impl ElfSymbols {
+    const PT_LOAD: u32 = 1;
+    const SHT_SYMTAB: u32 = 2;
+    const SHT_DYNSYM: u32 = 11;
+    const STT_FUNC: u8 = 2;
+    const SYMBOL_SIZE: usize = 24;
+    /// Ограничение на таблицы, чтобы повреждённый файл не вызвал огромное выделение
+    const MAX_TABLE_SIZE: u64 = 64 * 1024 * 1024;
+
+    /// Прочитать таблицы символов файла
+    pub fn from_file(file: &File) -> Option<Self> {
+        Self::parse(file)
+    }
+
+    /// Разобрать образ ELF из памяти
+    pub fn from_bytes(data: &[u8]) -> Option<Self> {
+        Self::parse(data)
+    }
+
+    fn parse<S: ElfSource + ?Sized>(source: &S) -> Option<Self> {
+        let header = source.read_at(0, 64)?;
+        // Только 64-битные little-endian образы
+        if &header[0..4] != b"\x7fELF" || header[4] != 2 || header[5] != 1 {
+            return None;
+        }
+        let phoff = read_u64(&header, 0x20)?;
+        let shoff = read_u64(&header, 0x28)?;
+        let phentsize = read_u16(&header, 0x36)? as u64;
+        let phnum = read_u16(&header, 0x38)? as u64;
+        let shentsize = read_u16(&header, 0x3a)? as u64;
+        let shnum = read_u16(&header, 0x3c)? as u64;
+
+        let mut segments = Vec::new();
+        if phentsize >= 56 {
+            let table = source.read_at(phoff, (phentsize * phnum) as usize)?;
+            for header in table.chunks_exact(phentsize as usize) {
+                if read_u32(header, 0)? == Self::PT_LOAD {
+                    segments.push((
+                        read_u64(header, 8)?,
+                        read_u64(header, 16)?,
+                        read_u64(header, 32)?,
+                    ));
+                }
+            }
+        }
+
+        let mut symbols = Vec::new();
+        if shentsize >= 64 && shnum > 0 {
+            let table = source.read_at(shoff, (shentsize * shnum) as usize)?;
+            let sections: Vec<&[u8]> = table.chunks_exact(shentsize as usize).collect();
+            for section in &sections {
+                let kind = read_u32(section, 4)?;
+                if kind != Self::SHT_SYMTAB && kind != Self::SHT_DYNSYM {
+                    continue;
+                }
+                let strtab = sections.get(read_u32(section, 0x28)? as usize)?;
+                let (Some(entries), Some(names)) =
+                    (read_table(source, section), read_table(source, strtab))
+                else {
+                    continue;
+                };
+                for symbol in entries.chunks_exact(Self::SYMBOL_SIZE) {
+                    let value = read_u64(symbol, 8)?;
+                    let size = read_u64(symbol, 16)?;
+                    let defined = read_u16(symbol, 6)? != 0;
+                    if symbol[4] & 0xf != Self::STT_FUNC || value == 0 || !defined {
+                        continue;
+                    }
+                    if let Some(name) = read_name(&names, read_u32(symbol, 0)? as usize) {
+                        symbols.push((value, size, name));
+                    }
+                }
+            }
+        }
+
+        // .symtab и .dynsym повторяют друг друга: оставляем один символ на адрес
+        symbols.sort_by(|a, b| a.0.cmp(&b.0).then(b.1.cmp(&a.1)));
+        symbols.dedup_by_key(|symbol| symbol.0);
+
+        Some(Self { segments, symbols })
+    }
+
+    /// Функция, содержащая указанное смещение в файле
+    pub fn resolve_file_offset(&self, file_offset: u64) -> Option<&str> {
+        let vaddr = self
+            .segments
+            .iter()
+            .find(|(offset, _, size)| file_offset >= *offset && file_offset - offset < *size)
+            .map(|(offset, vaddr, _)| file_offset - offset + vaddr)?;
+
+        let index = self
+            .symbols
+            .partition_point(|(value, _, _)| *value <= vaddr);
+        let (value, size, name) = &self.symbols[index.checked_sub(1)?];
+        (*size == 0 || vaddr - value < *size).then_some(name.as_str())
+    }
+}
+
+fn read_u16(data: &[u8], offset: usize) -> Option<u16> {
+    Some(u16::from_le_bytes(
+        data.get(offset..offset + 2)?.try_into().ok()?,
+    ))
+}
+
+fn read_u32(data: &[u8], offset: usize) -> Option<u32> {
+    Some(u32::from_le_bytes(
+        data.get(offset..offset + 4)?.try_into().ok()?,
+    ))
+}
+
+fn read_u64(data: &[u8], offset: usize) -> Option<u64> {
+    Some(u64::from_le_bytes(
+        data.get(offset..offset + 8)?.try_into().ok()?,
+    ))
+}
+
+/// Содержимое секции по её заголовку
+fn read_table<S: ElfSource + ?Sized>(source: &S, section: &[u8]) -> Option<Vec<u8>> {
+    let offset = read_u64(section, 0x18)?;
+    let size = read_u64(section, 0x20)?;
+    if size > ElfSymbols::MAX_TABLE_SIZE {
+        return None;
+    }
+    source.read_at(offset, size as usize)
+}
+
+fn read_name(names: &[u8], offset: usize) -> Option<String> {
+    let tail = names.get(offset..)?;
+    let len = tail.iter().position(|&b| b == 0)?;
+    (len > 0).then(|| String::from_utf8_lossy(&tail[..len]).into_owned())
+}
+
+/// Преобразование адресов стека в имена кадров
+pub trait FrameResolver {
+    /// Кадр пользовательского стека процесса
+    fn user_frame(&mut self, tgid: u32, addr: u64) -> String;
+    /// Кадр стека ядра
+    fn kernel_frame(&mut self, addr: u64) -> String;
+}
+
+/// Символизация по `/proc/kallsyms`, `/proc/<pid>/maps` и таблицам ELF
+///
+/// Файлы читаются через `/proc/<pid>/root`, поэтому процессы в других
+/// пространствах имён монтирования (контейнеры, flatpak) тоже символизируются.
+#[derive(Debug, Default)]
+pub struct StackSymbolizer {
+    kernel: KernelSymbols,
+    regions: HashMap<u32, Vec<MapRegion>>,
+    objects: HashMap<(String, u64), Option<ElfSymbols>>,
+}
+
+impl StackSymbolizer {
+    pub fn new(kernel: KernelSymbols) -> Self {
+        Self {
+            kernel,
+            ..Default::default()
+        }
+    }
+}
+
+impl FrameResolver for StackSymbolizer {
+    fn user_frame(&mut self, tgid: u32, addr: u64) -> String {
+        let regions = self.regions.entry(tgid).or_insert_with(|| {
+            std::fs::read_to_string(format!("/proc/{}/maps", tgid))
+                .map(|text| parse_proc_maps(&text))
+                .unwrap_or_default()
+        });
+        let Some(region) = regions
+            .iter()
+            .find(|region| addr >= region.start && addr < region.end)
+        else {
+            return format!("0x{:x}", addr);
+        };
+
+        let file_offset = addr - region.start + region.offset;
+        let symbols = self
+            .objects
+            .entry((region.dev.clone(), region.inode))
+            .or_insert_with(|| {
+                File::open(format!("/proc/{}/root{}", tgid, region.path))
+                    .ok()
+                    .and_then(|file| ElfSymbols::from_file(&file))
+            });
+
+        match symbols
+            .as_ref()
+            .and_then(|symbols| symbols.resolve_file_offset(file_offset))
+        {
+            Some(name) => name.to_string(),
+            None => {
+                let file = region.path.rsplit('/').next().unwrap_or(&region.path);
+                format!("{}+0x{:x}", file, file_offset)
+            }
+        }
+    }
+
+    fn kernel_frame(&mut self, addr: u64) -> String {
+        match self.kernel.resolve(addr) {
+            Some(name) => format!("{}_[k]", name),
+            None => format!("0x{:x}_[k]", addr),
+        }
+    }
+}
+
+/// Символизированный стек с агрегированными счётчиками
+#[derive(Debug, Clone, PartialEq, Eq, Serialize, Deserialize)]
+pub struct FoldedStack {
+    pub tgid: u32,
+    /// Имя потока
+    pub comm: String,
+    pub kind: StackKind,
+    /// Кадры от корня к вершине: пользовательский стек, затем стек ядра
+    pub frames: Vec<String>,
+    /// Выборки на CPU или уходы с CPU
+    pub samples: u64,
+    /// Суммарное время вне CPU (нс)
+    pub total_ns: u64,
+}
+
+impl FoldedStack {
+    /// Значение в свёрнутом формате: выборки или микросекунды вне CPU
+    pub fn value(&self) -> u64 {
+        match self.kind {
+            StackKind::OnCpu => self.samples,
+            StackKind::OffCpu => self.total_ns / 1_000,
+        }
+    }
+}
+
+/// Символизировать агрегированные счётчики ядра
+///
+/// Возвращает стеки и количество выборок, стек которых ядро не сохранило
+/// (переполнение или коллизия в карте стеков). Отсутствие пользовательского
+/// стека у потоков ядра потерей не считается.
+pub fn fold_stacks(
+    entries: &[(RawProfileKey, RawProfileCount)],
+    stacks: &HashMap<u32, Vec<u64>>,
+    resolver: &mut impl FrameResolver,
+) -> (Vec<FoldedStack>, u64) {
+    let mut folded = Vec::with_capacity(entries.len());
+    let mut lost_samples = 0u64;
+
+    for (key, count) in entries {
+        let Some(kind) = StackKind::from_raw(key.kind) else {
+            continue;
+        };
+        if (key.user_stack_id < 0 && key.user_stack_id != STACK_ID_NO_USER_STACK)
+            || key.kernel_stack_id < 0
+        {
+            lost_samples += count.samples;
+        }
+
+        let stack = |id: i32| {
+            u32::try_from(id)
+                .ok()
+                .and_then(|id| stacks.get(&id))
+                .map_or(&[][..], Vec::as_slice)
+        };
+        let mut frames: Vec<String> = stack(key.user_stack_id)
+            .iter()
+            .rev()
+            .map(|&addr| resolver.user_frame(key.tgid, addr))
+            .collect();
+        frames.extend(
+            stack(key.kernel_stack_id)
+                .iter()
+                .rev()
+                .map(|&addr| resolver.kernel_frame(addr)),
+        );
+        if frames.is_empty() {
+            frames.push("[unknown]".to_string());
+        }
+
+        folded.push(FoldedStack {
+            tgid: key.tgid,
+            comm: key.comm(),
+            kind,
+            frames,
+            samples: count.samples,
+            total_ns: count.total_ns,
+        });
+    }
+
+    (folded, lost_samples)
+}
+
+/// Узел дерева d3-flame-graph
+#[derive(Debug, Clone, PartialEq, Eq, Serialize, Deserialize)]
+pub struct FlameGraphNode {
+    pub name: String,
+    pub value: u64,
+    pub children: Vec<FlameGraphNode>,
+}
+
+impl FlameGraphNode {
+    fn new(name: &str) -> Self {
+        Self {
+            name: name.to_string(),
+            value: 0,
+            children: Vec::new(),
+        }
+    }
+
+    fn insert<'a>(&mut self, path: impl Iterator<Item = &'a str>, value: u64) {
+        self.value += value;
+        let mut node = self;
+        for name in path {
+            let index = match node.children.iter().position(|child| child.name == name) {
+                Some(index) => index,
+                None => {
+                    node.children.push(FlameGraphNode::new(name));
+                    node.children.len() - 1
+                }
+            };
+            node = &mut node.children[index];
+            node.value += value;
+        }
+    }
+}
+
+/// Результат сессии профилирования
+#[derive(Debug, Clone, PartialEq, Eq, Serialize, Deserialize)]
+pub struct StackProfile {
+    pub request: StackProfileRequest,
+    /// Начало сессии (секунды Unix)
+    pub started_at: u64,
+    /// Фактическая длительность (мс); меньше запрошенной при досрочной остановке
+    pub duration_ms: u64,
+    pub stacks: Vec<FoldedStack>,
+    /// Выборки без сохранённого стека
+    pub lost_samples: u64,
+    /// Карта счётчиков заполнена: часть новых стеков не учтена
+    pub truncated: bool,
+}
+
+impl StackProfile {
+    fn stacks_of(&self, kind: StackKind) -> impl Iterator<Item = &FoldedStack> {
+        self.stacks.iter().filter(move |stack| stack.kind == kind)
+    }
+
+    /// Свёрнутые стеки (`comm;кадр;...;кадр значение`) для `flamegraph.pl`
+    ///
+    /// Стеки с одинаковыми именами кадров объединяются; строки идут по
+    /// убыванию значения.
+    pub fn folded(&self, kind: StackKind) -> String {
+        let mut lines: HashMap<String, u64> = HashMap::new();
+        for stack in self.stacks_of(kind) {
+            let line = std::iter::once(stack.comm.as_str())
+                .chain(stack.frames.iter().map(String::as_str))
+                .collect::<Vec<_>>()
+                .join(";");
+            *lines.entry(line).or_default() += stack.value();
+        }
+
+        let mut lines: Vec<(String, u64)> = lines.into_iter().filter(|(_, v)| *v > 0).collect();
+        lines.sort_by(|a, b| b.1.cmp(&a.1).then_with(|| a.0.cmp(&b.0)));
+        lines
+            .into_iter()
+            .map(|(line, value)| format!("{} {}\n", line, value))
+            .collect()
+    }
+
+    /// Дерево для d3-flame-graph; первый уровень — имена потоков
+    pub fn flamegraph(&self, kind: StackKind) -> FlameGraphNode {
+        let mut root = FlameGraphNode::new("all");
+        for stack in self.stacks_of(kind) {
+            let path =
+                std::iter::once(stack.comm.as_str()).chain(stack.frames.iter().map(String::as_str));
+            root.insert(path, stack.value());
+        }
+        root
+    }
+}
+
+/// Состояние профилировщика
+#[derive(Debug, Clone, Copy, PartialEq, Eq, Serialize, Deserialize)]
+#[serde(rename_all = "snake_case")]
+pub enum StackProfileState {
+    Idle,
+    Running,
+    Finished,
+    Failed,
+}
+
+/// Сводка о текущей или последней сессии
+#[derive(Debug, Clone, PartialEq, Eq, Serialize, Deserialize)]
+pub struct StackProfileStatus {
+    pub state: StackProfileState,
+    pub request: Option<StackProfileRequest>,
+    /// Оставшееся время выполняющейся сессии (мс)
+    pub remaining_ms: Option<u64>,
+    /// Количество стеков в результате
+    pub stacks: Option<usize>,
+    pub error: Option<String>,
+}
+
+#[cfg_attr(not(feature = "ebpf"), allow(dead_code))]
+enum ProfilerState {
+    Idle,
+    Running {
+        session: u64,
+        request: StackProfileRequest,
+        started: Instant,
+        stop: mpsc::Sender<()>,
+    },
+    Finished(Arc<StackProfile>),
+    Failed {
+        request: StackProfileRequest,
+        error: String,
+    },
+}
+
+/// Сессии профилирования стеков
+///
+/// Одновременно выполняется не более одной сессии. Сессия работает в
+/// отдельном потоке: загружает объект `stack_profiler`, ждёт окончания
+/// длительности (или [`StackProfiler::stop`]), открепляет программы, читает и
+/// символизирует результат и выгружает объект. Результат хранится до начала
+/// следующей сессии.
+pub struct StackProfiler {
+    state: Arc<Mutex<ProfilerState>>,
+    #[cfg_attr(not(feature = "ebpf"), allow(dead_code))]
+    next_session: std::sync::atomic::AtomicU64,
+}
+
+impl Default for StackProfiler {
+    fn default() -> Self {
+        Self::new()
+    }
+}
+
+impl StackProfiler {
+    pub fn new() -> Self {
+        Self {
+            state: Arc::new(Mutex::new(ProfilerState::Idle)),
+            next_session: std::sync::atomic::AtomicU64::new(1),
+        }
+    }
+
+    /// Запустить сессию профилирования
+    ///
+    /// Возвращает ошибку при неверных параметрах, если предыдущая сессия ещё
+    /// выполняется или без поддержки eBPF. Ошибки загрузки объекта и
+    /// прикрепления программ видны в [`StackProfiler::status`].
+    pub fn start(&self, request: StackProfileRequest) -> anyhow::Result<()> {
+        request.validate()?;
+
+        #[cfg(feature = "ebpf")]
+        {
+            use anyhow::Context;
+            use std::sync::atomic::Ordering;
+
+            let mut state = self
+                .state
+                .lock()
+                .map_err(|_| anyhow::anyhow!("Состояние профилировщика недоступно"))?;
+            if matches!(*state, ProfilerState::Running { .. }) {
+                anyhow::bail!("Сессия профилирования уже выполняется");
+            }
+
+            let session = self.next_session.fetch_add(1, Ordering::Relaxed);
+            let (stop_tx, stop_rx) = mpsc::channel();
+            let worker_state = Arc::clone(&self.state);
+            let worker_request = request.clone();
+
+            // Поток ждёт освобождения состояния, так что увидит Running этой сессии
+            std::thread::Builder::new()
+                .name("ebpf-profiler".to_string())
+                .spawn(move || {
+                    let result = run_session(&worker_request, stop_rx);
+                    let Ok(mut state) = worker_state.lock() else {
+                        return;
+                    };
+                    if !matches!(*state, ProfilerState::Running { session: s, .. } if s == session)
+                    {
+                        return;
+                    }
+                    *state = match result {
+                        Ok(profile) => {
+                            tracing::info!(
+                                "Сессия профилирования стеков завершена: {} стеков, {} мс",
+                                profile.stacks.len(),
+                                profile.duration_ms
+                            );
+                            ProfilerState::Finished(Arc::new(profile))
+                        }
+                        Err(e) => {
+                            tracing::warn!("Сессия профилирования стеков не удалась: {:#}", e);
+                            ProfilerState::Failed {
+                                request: worker_request,
+                                error: format!("{:#}", e),
+                            }
+                        }
+                    };
+                })
+                .context("Не удалось запустить поток профилировщика")?;
+
+            *state = ProfilerState::Running {
+                session,
+                request,
+                started: Instant::now(),
+                stop: stop_tx,
+            };
+            Ok(())
+        }
+
+        #[cfg(not(feature = "ebpf"))]
+        {
+            anyhow::bail!("Профилирование стеков требует поддержки eBPF")
+        }
+    }
+
+    /// Завершить выполняющуюся сессию досрочно, сохранив собранное
+    ///
+    /// Возвращает `false`, если сессия не выполняется.
+    pub fn stop(&self) -> bool {
+        match self.state.lock().as_deref() {
+            Ok(ProfilerState::Running { stop, .. }) => stop.send(()).is_ok(),
+            _ => false,
+        }
+    }
+
+    /// Сводка о текущей или последней сессии
+    pub fn status(&self) -> StackProfileStatus {
+        let mut status = StackProfileStatus {
+            state: StackProfileState::Idle,
+            request: None,
+            remaining_ms: None,
+            stacks: None,
+            error: None,
+        };
+        match self.state.lock().as_deref() {
+            Ok(ProfilerState::Idle) => {}
+            Ok(ProfilerState::Running {
+                request, started, ..
+            }) => {
+                let duration = Duration::from_secs(request.duration_secs);
+                status.state = StackProfileState::Running;
+                status.remaining_ms =
+                    Some(duration.saturating_sub(started.elapsed()).as_millis() as u64);
+                status.request = Some(request.clone());
+            }
+            Ok(ProfilerState::Finished(profile)) => {
+                status.state = StackProfileState::Finished;
+                status.request = Some(profile.request.clone());
+                status.stacks = Some(profile.stacks.len());
+            }
+            Ok(ProfilerState::Failed { request, error }) => {
+                status.state = StackProfileState::Failed;
+                status.request = Some(request.clone());
+                status.error = Some(error.clone());
+            }
+            Err(_) => {
+                status.state = StackProfileState::Failed;
+                status.error = Some("Состояние профилировщика недоступно".to_string());
+            }
+        }
+        status
+    }
+
+    /// Результат последней завершённой сессии
+    pub fn profile(&self) -> Option<Arc<StackProfile>> {
+        match self.state.lock().as_deref() {
+            Ok(ProfilerState::Finished(profile)) => Some(Arc::clone(profile)),
+            _ => None,
+        }
+    }
+}
+
+/// Онлайн CPU для событий perf
+#[cfg(feature = "ebpf")]
+fn online_cpus() -> Vec<u32> {
+    match std::fs::read_to_string("/sys/devices/system/cpu/online") {
+        Ok(text) => parse_cpu_list(&text),
+        Err(_) => {
+            let count = std::thread::available_parallelism().map_or(1, |n| n.get());
+            (0..count as u32).collect()
+        }
+    }
+}
+
+/// Открыть таймер выборки на CPU для всех процессов
+#[cfg(feature = "ebpf")]
+fn open_perf_event(attr: &RawPerfEventAttr, cpu: u32) -> std::io::Result<std::os::fd::OwnedFd> {
+    use std::os::fd::FromRawFd;
+
+    const PERF_FLAG_FD_CLOEXEC: libc::c_ulong = 1 << 3;
+
+    // SAFETY: attr указывает на корректно заполненную структуру размера attr.size
+    let fd = unsafe {
+        libc::syscall(
+            libc::SYS_perf_event_open,
+            attr as *const RawPerfEventAttr,
+            -1 as libc::pid_t,
+            cpu as libc::c_int,
+            -1 as libc::c_int,
+            PERF_FLAG_FD_CLOEXEC,
+        )
+    };
+    if fd < 0 {
+        return Err(std::io::Error::last_os_error());
+    }
+    // SAFETY: дескриптор только что открыт и никому не принадлежит
+    Ok(unsafe { std::os::fd::OwnedFd::from_raw_fd(fd as i32) })
+}
+
+/// Выполнить сессию: загрузить объект, дождаться окончания, прочитать результат
+#[cfg(feature = "ebpf")]
+fn run_session(
+    request: &StackProfileRequest,
+    stop: mpsc::Receiver<()>,
+) -> anyhow::Result<StackProfile> {
+    use anyhow::Context;
+    use libbpf_rs::{MapCore, MapFlags};
+    use std::os::fd::AsRawFd;
+
+    // sched_switch прикрепляется при загрузке, но ничего не учитывает, пока
+    // в profile_config_map нулевая маска режимов
+    let object = super::ebpf_objects::EbpfObject::load(STACK_PROFILER_OBJECT)?;
+    let map = |name: &str| -> anyhow::Result<libbpf_rs::MapHandle> {
+        object
+            .map_handle(name)?
+            .with_context(|| format!("Карта {} не найдена", name))
+    };
+    let config_map = map(PROFILE_CONFIG_MAP)?;
+    let target_map = map(PROFILE_TARGET_MAP)?;
+    let stack_map = map(PROFILE_STACK_MAP)?;
+    let count_map = map(PROFILE_COUNT_MAP)?;
+
+    for tgid in &request.tgids {
+        target_map
+            .update(&tgid.to_ne_bytes(), &[1u8], MapFlags::ANY)
+            .with_context(|| format!("Не удалось отметить процесс {} для профилирования", tgid))?;
+    }
+
+    let mut perf_events = Vec::new();
+    if request.on_cpu {
+        let attr = RawPerfEventAttr::cpu_clock(request.frequency_hz);
+        for cpu in online_cpus() {
+            match open_perf_event(&attr, cpu) {
+                Ok(fd) => {
+                    object.attach_perf_event(PROFILE_CPU_SAMPLE_PROGRAM, fd.as_raw_fd())?;
+                    perf_events.push(fd);
+                }
+                Err(e) => tracing::warn!("Не удалось открыть таймер выборки на CPU {}: {}", cpu, e),
+            }
+        }
+        if perf_events.is_empty() {
+            anyhow::bail!("Не удалось открыть таймер выборки ни на одном CPU");
+        }
+    }
+
+    let config_key = 0u32.to_ne_bytes();
+    config_map
+        .update(
+            &config_key,
+            &RawProfileConfig::new(request).to_bytes(),
+            MapFlags::ANY,
+        )
+        .context("Не удалось записать параметры сессии профилирования")?;
+
+    let started_at = std::time::SystemTime::now()
+        .duration_since(std::time::UNIX_EPOCH)
+        .map_or(0, |elapsed| elapsed.as_secs());
+    let started = Instant::now();
+    tracing::info!(
+        "Сессия профилирования стеков запущена: процессы {:?}, {} с, {} CPU",
+        request.tgids,
+        request.duration_secs,
+        perf_events.len()
+    );
+
+    // Сессия завершается по истечении длительности или по запросу остановки
+    let _ = stop.recv_timeout(Duration::from_secs(request.duration_secs));
+
+    let _ = config_map.update(
+        &config_key,
+        &RawProfileConfig::default().to_bytes(),
+        MapFlags::ANY,
+    );
+    object.detach();
+    drop(perf_events);
+    let duration_ms = started.elapsed().as_millis() as u64;
+
+    let mut entries = Vec::new();
+    for key in count_map.keys() {
+        let count = count_map
+            .lookup(&key, MapFlags::ANY)?
+            .and_then(|value| RawProfileCount::from_bytes(&value));
+        if let (Some(key), Some(count)) = (RawProfileKey::from_bytes(&key), count) {
+            entries.push((key, count));
+        }
+    }
+
+    let mut stacks = HashMap::new();
+    for (key, _) in &entries {
+        for id in [key.user_stack_id, key.kernel_stack_id] {
+            let Ok(id) = u32::try_from(id) else {
+                continue;
+            };
+            if stacks.contains_key(&id) {
+                continue;
+            }
+            if let Some(trace) = stack_map.lookup(&id.to_ne_bytes(), MapFlags::ANY)? {
+                stacks.insert(id, parse_stack_trace(&trace));
+            }
+        }
+    }
+
+    let mut symbolizer = StackSymbolizer::new(KernelSymbols::load());
+    let (folded, lost_samples) = fold_stacks(&entries, &stacks, &mut symbolizer);
+
+    Ok(StackProfile {
+        request: request.clone(),
+        started_at,
+        duration_ms,
+        stacks: folded,
+        lost_samples,
+        truncated: entries.len() >= PROFILE_MAX_COUNTS,
+    })
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    fn request(tgids: Vec<u32>) -> StackProfileRequest {
+        serde_json::from_value(serde_json::json!({ "tgids": tgids, "duration_secs": 5 })).unwrap()
+    }
+
+    fn key(kind: u32, user_stack_id: i32, kernel_stack_id: i32) -> RawProfileKey {
+        let mut comm = [0u8; 16];
+        comm[..6].copy_from_slice(b"editor");
+        RawProfileKey {
+            tgid: 42,
+            kind,
+            user_stack_id,
+            kernel_stack_id,
+            comm,
+        }
+    }
+
+    /// Имена кадров прямо из адресов
+    struct HexResolver;
+
+    impl FrameResolver for HexResolver {
+        fn user_frame(&mut self, _tgid: u32, addr: u64) -> String {
+            format!("u{:x}", addr)
+        }
+
+        fn kernel_frame(&mut self, addr: u64) -> String {
+            format!("k{:x}", addr)
+        }
+    }
+
+    #[test]
+    fn test_layouts_match_program() {
+        assert_eq!(std::mem::size_of::<RawProfileConfig>(), 16);
+        assert_eq!(std::mem::size_of::<RawProfileKey>(), 32);
+        assert_eq!(std::mem::size_of::<RawProfileCount>(), 16);
+        // PERF_ATTR_SIZE_VER5
+        assert_eq!(std::mem::size_of::<RawPerfEventAttr>(), 112);
+    }
+
+    #[test]
+    fn test_request_defaults_and_validation() {
+        let request = request(vec![42]);
+        assert!(request.on_cpu && request.off_cpu);
+        assert_eq!(request.frequency_hz, DEFAULT_PROFILE_FREQUENCY_HZ);
+        assert_eq!(request.modes(), PROFILE_MODE_ON_CPU | PROFILE_MODE_OFF_CPU);
+        assert!(request.validate().is_ok());
+
+        let config = RawProfileConfig::new(&request);
+        assert_eq!(config.min_offcpu_ns, DEFAULT_MIN_OFFCPU_US * 1_000);
+        let bytes = config.to_bytes();
+        assert_eq!(u32::from_ne_bytes(bytes[8..12].try_into().unwrap()), 3);
+
+        let invalid = [
+            StackProfileRequest {
+                tgids: Vec::new(),
+                ..request.clone()
+            },
+            StackProfileRequest {
+                tgids: (1..=MAX_PROFILE_TARGETS as u32 + 1).collect(),
+                ..request.clone()
+            },
+            StackProfileRequest {
+                duration_secs: MAX_PROFILE_DURATION_SECS + 1,
+                ..request.clone()
+            },
+            StackProfileRequest {
+                on_cpu: false,
+                off_cpu: false,
+                ..request.clone()
+            },
+            StackProfileRequest {
+                frequency_hz: 0,
+                ..request.clone()
+            },
+        ];
+        for request in invalid {
+            assert!(request.validate().is_err(), "{:?}", request);
+        }
+
+        // Частота не важна без выборки на CPU
+        let off_cpu_only = StackProfileRequest {
+            on_cpu: false,
+            frequency_hz: 0,
+            ..request
+        };
+        assert!(off_cpu_only.validate().is_ok());
+        assert_eq!(off_cpu_only.modes(), PROFILE_MODE_OFF_CPU);
+    }
+
+    #[test]
+    fn test_parse_raw_records() {
+        let mut data = Vec::new();
+        data.extend_from_slice(&42u32.to_ne_bytes());
+        data.extend_from_slice(&1u32.to_ne_bytes());
+        data.extend_from_slice(&7i32.to_ne_bytes());
+        data.extend_from_slice(&(-14i32).to_ne_bytes());
+        data.extend_from_slice(b"editor\0\0\0\0\0\0\0\0\0\0");
+
+        let parsed = RawProfileKey::from_bytes(&data).unwrap();
+        assert_eq!(parsed, key(1, 7, -14));
+        assert_eq!(parsed.comm(), "editor");
+        assert!(RawProfileKey::from_bytes(&data[..31]).is_none());
+
+        let mut count = 3u64.to_ne_bytes().to_vec();
+        count.extend_from_slice(&5_000u64.to_ne_bytes());
+        assert_eq!(
+            RawProfileCount::from_bytes(&count),
+            Some(RawProfileCount {
+                samples: 3,
+                total_ns: 5_000
+            })
+        );
+
+        let mut trace = Vec::new();
+        for addr in [0x1000u64, 0x2000, 0, 0] {
+            trace.extend_from_slice(&addr.to_ne_bytes());
+        }
+        assert_eq!(parse_stack_trace(&trace), vec![0x1000, 0x2000]);
+    }
+
+    #[test]
+    fn test_parse_cpu_list() {
+        assert_eq!(parse_cpu_list("0-3,6\n"), vec![0, 1, 2, 3, 6]);
+        assert_eq!(parse_cpu_list("0"), vec![0]);
+        assert!(parse_cpu_list("").is_empty());
+    }
+
+    #[test]
+    fn test_kernel_symbols() {
+        let symbols = KernelSymbols::parse(
+            "ffffffff81000000 T _stext\n\
+             ffffffff81001000 t do_syscall_64\n\
+             ffffffff81002000 D some_data\n\
+             ffffffffc0000000 t nf_hook\t[nf_conntrack]\n",
+        );
+        assert_eq!(symbols.resolve(0xffffffff81001010), Some("do_syscall_64"));
+        // Данные не считаются кодом
+        assert_eq!(symbols.resolve(0xffffffff81002010), Some("do_syscall_64"));
+        assert_eq!(symbols.resolve(0xffffffffc0000004), Some("nf_hook"));
+        assert_eq!(symbols.resolve(0x1000), None);
+
+        // kptr_restrict скрывает адреса
+        let hidden = KernelSymbols::parse("0000000000000000 T _stext\n");
+        assert_eq!(hidden.resolve(0xffffffff81000000), None);
+    }
+
+    #[test]
+    fn test_parse_proc_maps() {
+        let regions = parse_proc_maps(
+            "55d0c0000000-55d0c0001000 r--p 00000000 08:01 1234  /usr/bin/editor\n\
+             55d0c0001000-55d0c0005000 r-xp 00001000 08:01 1234  /usr/bin/editor\n\
+             7f0000000000-7f0000001000 r-xp 00000000 00:00 0     [vdso]\n\
+             7f0000100000-7f0000200000 r-xp 00020000 08:01 99  /tmp/lib foo.so (deleted)\n",
+        );
+        assert_eq!(regions.len(), 2);
+        assert_eq!(regions[0].start, 0x55d0c0001000);
+        assert_eq!(regions[0].offset, 0x1000);
+        assert_eq!(regions[0].inode, 1234);
+        assert_eq!(regions[1].path, "/tmp/lib foo.so");
+    }
+
+    #[test]
+    fn test_symbolize_own_function() {
+        let mut symbolizer = StackSymbolizer::default();
+        let name = symbolizer.user_frame(std::process::id(), parse_proc_maps as usize as u64);
+        assert!(name.contains("parse_proc_maps"), "{}", name);
+    }
+
+    #[test]
+    fn test_fold_stacks() {
+        let stacks = HashMap::from([(1u32, vec![0x30, 0x20, 0x10]), (2, vec![0xb0, 0xa0])]);
+        let entries = [
+            (
+                key(0, 1, 2),
+                RawProfileCount {
+                    samples: 5,
+                    total_ns: 0,
+                },
+            ),
+            // Поток ядра без пользовательского стека
+            (
+                key(1, STACK_ID_NO_USER_STACK, 2),
+                RawProfileCount {
+                    samples: 2,
+                    total_ns: 3_000_000,
+                },
+            ),
+            // Карта стеков переполнена
+            (
+                key(0, -17, -17),
+                RawProfileCount {
+                    samples: 4,
+                    total_ns: 0,
+                },
+            ),
+        ];
+
+        let (folded, lost) = fold_stacks(&entries, &stacks, &mut HexResolver);
+        assert_eq!(lost, 4);
+        assert_eq!(folded[0].frames, ["u10", "u20", "u30", "ka0", "kb0"]);
+        assert_eq!(folded[0].kind, StackKind::OnCpu);
+        assert_eq!(folded[1].frames, ["ka0", "kb0"]);
+        assert_eq!(folded[1].value(), 3_000);
+        assert_eq!(folded[2].frames, ["[unknown]"]);
+    }
+
+    #[test]
+    fn test_folded_and_flamegraph_output() {
+        let stack = |frames: &[&str], samples| FoldedStack {
+            tgid: 42,
+            comm: "editor".to_string(),
+            kind: StackKind::OnCpu,
+            frames: frames.iter().map(|frame| frame.to_string()).collect(),
+            samples,
+            total_ns: 0,
+        };
+        let profile = StackProfile {
+            request: request(vec![42]),
+            started_at: 0,
+            duration_ms: 5_000,
+            stacks: vec![
+                stack(&["main", "render"], 3),
+                stack(&["main", "parse"], 5),
+                // Другие адреса той же функции
+                stack(&["main", "render"], 1),
+                FoldedStack {
+                    kind: StackKind::OffCpu,
+                    total_ns: 2_000_000,
+                    ..stack(&["main", "futex_wait_[k]"], 1)
+                },
+            ],
+            lost_samples: 0,
+            truncated: false,
+        };
+
+        assert_eq!(
+            profile.folded(StackKind::OnCpu),
+            "editor;main;parse 5\neditor;main;render 4\n"
+        );
+        assert_eq!(
+            profile.folded(StackKind::OffCpu),
+            "editor;main;futex_wait_[k] 2000\n"
+        );
+
+        let tree = profile.flamegraph(StackKind::OnCpu);
+        assert_eq!(tree.value, 9);
+        let main = &tree.children[0].children[0];
+        assert_eq!((main.name.as_str(), main.value), ("main", 9));
+        assert_eq!(main.children.len(), 2);
+        assert_eq!(main.children[0].name, "render");
+        assert_eq!(main.children[0].value, 4);
+    }
+
+    #[test]
+    fn test_profiler_rejects_invalid_request() {
+        let profiler = StackProfiler::new();
+        assert!(profiler.start(request(Vec::new())).is_err());
+        assert_eq!(profiler.status().state, StackProfileState::Idle);
+        assert!(!profiler.stop());
+        assert!(profiler.profile().is_none());
+    }
+}
@@ -0,0 +1,199 @@
+//! Общий поток-потребитель кольцевых буферов eBPF.
+//!
+//! Потоки событий жизненного цикла (`ebpf_events`) и задержек очереди
+//! выполнения (`ebpf_runqueue`) вычитывают `BPF_MAP_TYPE_RINGBUF` одинаково:
+//! libbpf `ring_buffer__poll` поверх epoll в отдельном потоке, разбор записей
+//! в колбэке libbpf и обработка накопленной за один poll пачки вне колбэка.
+//! [`RingBufferConsumer`] владеет этим потоком; потребитель задаёт только
+//! разбор записи и обработку пачки.
+//!
+//! Прерванное сигналом ожидание (EINTR) повторяется сразу. После других ошибок
+//! poll поток ждёт `poll_timeout`, чтобы не крутиться вхолостую, а
+//! предупреждение выводится не чаще [`POLL_ERROR_WARN_INTERVAL`] с числом
+//! пропущенных с прошлого раза ошибок.
+
+#[cfg(feature = "ebpf")]
+use std::sync::atomic::{AtomicBool, Ordering};
+#[cfg(feature = "ebpf")]
+use std::sync::Arc;
+#[cfg(feature = "ebpf")]
+use std::thread::JoinHandle;
+use std::time::{Duration, Instant};
+
+#[cfg(feature = "ebpf")]
+use anyhow::{Context, Result};
+
+/// Минимальный интервал между предупреждениями об ошибках poll одного потока
+pub const POLL_ERROR_WARN_INTERVAL: Duration = Duration::from_secs(60);
+
+/// Ограничитель предупреждений о повторяющихся ошибках poll
+#[cfg_attr(not(feature = "ebpf"), allow(dead_code))]
+#[derive(Debug, Default)]
+struct PollErrorLog {
+    last_warning: Option<Instant>,
+    suppressed: u64,
+}
+
+#[cfg_attr(not(feature = "ebpf"), allow(dead_code))]
+impl PollErrorLog {
+    /// Учесть ошибку в момент `now`
+    ///
+    /// Возвращает число ошибок, пропущенных с прошлого предупреждения, если
+    /// пора предупредить снова, иначе `None`.
+    fn record(&mut self, now: Instant) -> Option<u64> {
+        let due = self.last_warning.map_or(true, |at| {
+            now.duration_since(at) >= POLL_ERROR_WARN_INTERVAL
+        });
+        if !due {
+            self.suppressed += 1;
+            return None;
+        }
+
+        self.last_warning = Some(now);
+        Some(std::mem::take(&mut self.suppressed))
+    }
+}
+
+/// Поток-потребитель одного кольцевого буфера
+///
+/// Поток останавливается при вызове [`RingBufferConsumer::stop`] или при
+/// уничтожении структуры.
+#[cfg(feature = "ebpf")]
+pub struct RingBufferConsumer {
+    stop: Arc<AtomicBool>,
+    worker: Option<JoinHandle<()>>,
+}
+
+#[cfg(feature = "ebpf")]
+impl RingBufferConsumer {
+    /// Запустить поток `name`, вычитывающий кольцевой буфер `ringbuf_map`
+    ///
+    /// `parse` вызывается для каждой записи в колбэке libbpf, записи, которые
+    /// не удалось разобрать, отбрасываются. `on_batch` получает события,
+    /// накопленные за один poll, и вызывается вне колбэка libbpf, поэтому
+    /// медленная обработка не задерживает вычитку буфера. Возвращает ошибку,
+    /// если потребителя libbpf не удалось создать.
+    pub fn start<T, P, B>(
+        name: &str,
+        ringbuf_map: libbpf_rs::MapHandle,
+        poll_timeout: Duration,
+        batch_capacity: usize,
+        parse: P,
+        mut on_batch: B,
+    ) -> Result<Self>
+    where
+        T: 'static,
+        P: Fn(&[u8]) -> Option<T> + Send + 'static,
+        B: FnMut(&[T]) + Send + 'static,
+    {
+        use libbpf_rs::RingBufferBuilder;
+        use std::cell::RefCell;
+        use std::rc::Rc;
+        use std::sync::mpsc;
+
+        let stop = Arc::new(AtomicBool::new(false));
+        let worker_stop = Arc::clone(&stop);
+        let (ready_tx, ready_rx) = mpsc::channel::<Result<()>>();
+
+        // Кольцевой буфер libbpf не является Send, поэтому строится внутри потока
+        let worker = std::thread::Builder::new()
+            .name(name.to_string())
+            .spawn(move || {
+                let batch = Rc::new(RefCell::new(Vec::with_capacity(batch_capacity)));
+                let callback_batch = Rc::clone(&batch);
+
+                let mut builder = RingBufferBuilder::new();
+                let ringbuf = builder
+                    .add(&ringbuf_map, move |data: &[u8]| {
+                        if let Some(event) = parse(data) {
+                            callback_batch.borrow_mut().push(event);
+                        }
+                        0
+                    })
+                    .and_then(|builder| builder.build());
+
+                let ringbuf = match ringbuf {
+                    Ok(ringbuf) => {
+                        let _ = ready_tx.send(Ok(()));
+                        ringbuf
+                    }
+                    Err(e) => {
+                        let _ = ready_tx.send(Err(anyhow::anyhow!(
+                            "Не удалось создать потребителя кольцевого буфера: {}",
+                            e
+                        )));
+                        return;
+                    }
+                };
+
+                let mut poll_errors = PollErrorLog::default();
+                while !worker_stop.load(Ordering::Relaxed) {
+                    if let Err(e) = ringbuf.poll(poll_timeout) {
+                        if e.kind() == libbpf_rs::ErrorKind::Interrupted {
+                            continue;
+                        }
+                        if let Some(suppressed) = poll_errors.record(Instant::now()) {
+                            tracing::warn!(
+                                "Ошибка ожидания событий кольцевого буфера: {} (пропущено повторов: {})",
+                                e,
+                                suppressed
+                            );
+                        }
+                        std::thread::sleep(poll_timeout);
+                        continue;
+                    }
+
+                    let mut pending = batch.borrow_mut();
+                    if pending.is_empty() {
+                        continue;
+                    }
+                    on_batch(&pending);
+                    pending.clear();
+                }
+            })
+            .with_context(|| format!("Не удалось запустить поток {}", name))?;
+
+        ready_rx
+            .recv()
+            .with_context(|| format!("Поток {} завершился до инициализации", name))??;
+
+        Ok(Self {
+            stop,
+            worker: Some(worker),
+        })
+    }
+
+    /// Остановить поток-потребитель
+    pub fn stop(&mut self) {
+        self.stop.store(true, Ordering::Relaxed);
+        if let Some(worker) = self.worker.take() {
+            let _ = worker.join();
+        }
+    }
+}
+
+#[cfg(feature = "ebpf")]
+impl Drop for RingBufferConsumer {
+    fn drop(&mut self) {
+        self.stop();
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    #[test]
+    fn test_poll_errors_warn_once_per_interval() {
+        let start = Instant::now();
+        let mut log = PollErrorLog::default();
+
+        assert_eq!(log.record(start), Some(0));
+        assert_eq!(log.record(start + Duration::from_secs(1)), None);
+        assert_eq!(log.record(start + Duration::from_secs(30)), None);
+
+        let next = start + POLL_ERROR_WARN_INTERVAL;
+        assert_eq!(log.record(next), Some(2));
+        assert_eq!(log.record(next + Duration::from_millis(10)), None);
+    }
+}
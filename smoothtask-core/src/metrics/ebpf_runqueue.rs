@@ -0,0 +1,357 @@
+//! Быстрый путь реакции на задержки в очереди выполнения.
+//!
+//! Общая программа планировщика `sched_monitor.c` измеряет ожидание потока в
+//! очереди выполнения (от `sched_wakeup` или вытеснения до `sched_switch`).
+//! Для процессов, отмеченных в `sched_latency_target_map`, превышение порога
+//! публикуется в кольцевой буфер `sched_latency_events`. Поток-потребитель
+//! (см. `ebpf_ringbuf`) передаёт события обработчику (быстрому пути
+//! актуатора), который применяет заранее вычисленный класс приоритета, не
+//! дожидаясь следующего тика.
+
+use std::collections::HashSet;
+
+#[cfg(feature = "ebpf")]
+use super::ebpf_ringbuf::RingBufferConsumer;
+
+/// Имя карты порогов отмеченных процессов в `sched_monitor.c`
+pub const SCHED_LATENCY_TARGET_MAP: &str = "sched_latency_target_map";
+/// Имя кольцевого буфера событий превышения порога
+pub const SCHED_LATENCY_RINGBUF_MAP: &str = "sched_latency_events";
+
+/// Размер события в кольцевом буфере (байт), см. `struct sched_latency_event`
+pub const RUNQUEUE_LATENCY_EVENT_SIZE: usize = 32;
+
+/// Ёмкость карты порогов (`SCHED_MAX_LATENCY_TARGETS`)
+pub const MAX_RUNQUEUE_LATENCY_TARGETS: usize = 1024;
+
+/// Наименьший поддерживаемый порог (`SCHED_LATENCY_MIN_THRESHOLD_NS`):
+/// более короткие ожидания программа не сверяет с картой порогов
+pub const MIN_RUNQUEUE_LATENCY_THRESHOLD_NS: u64 = 1_000_000;
+
+/// Порог отмеченного процесса в раскладке ядра (`struct sched_latency_target`)
+#[repr(C)]
+#[derive(Debug, Clone, Copy, Default, PartialEq, Eq)]
+pub struct RawRunqueueLatencyTarget {
+    /// Порог ожидания в очереди выполнения (нс)
+    pub threshold_ns: u64,
+    /// Минимальный интервал между событиями процесса (нс)
+    pub min_interval_ns: u64,
+    /// Время последнего опубликованного события (заполняет ядро)
+    pub last_event_ns: u64,
+}
+
+impl RawRunqueueLatencyTarget {
+    /// Создать запись для карты порогов
+    ///
+    /// Порог ниже [`MIN_RUNQUEUE_LATENCY_THRESHOLD_NS`] поднимается до него,
+    /// поскольку программа не проверяет более короткие ожидания.
+    pub fn new(threshold_ns: u64, min_interval_ns: u64) -> Self {
+        Self {
+            threshold_ns: threshold_ns.max(MIN_RUNQUEUE_LATENCY_THRESHOLD_NS),
+            min_interval_ns,
+            last_event_ns: 0,
+        }
+    }
+
+    /// Сериализовать запись для записи в карту
+    pub fn to_bytes(&self) -> [u8; 24] {
+        let mut bytes = [0u8; 24];
+        bytes[0..8].copy_from_slice(&self.threshold_ns.to_ne_bytes());
+        bytes[8..16].copy_from_slice(&self.min_interval_ns.to_ne_bytes());
+        bytes[16..24].copy_from_slice(&self.last_event_ns.to_ne_bytes());
+        bytes
+    }
+}
+
+/// Событие превышения порога в раскладке ядра (`struct sched_latency_event`)
+#[repr(C)]
+#[derive(Debug, Clone, Copy, Default, PartialEq, Eq)]
+pub struct RawRunqueueLatencyEvent {
+    pub timestamp_ns: u64,
+    pub latency_ns: u64,
+    pub tgid: u32,
+    pub pid: u32,
+    pub cpu: u32,
+    pub _pad: u32,
+}
+
+/// Разобранное событие превышения порога
+#[derive(Debug, Clone, Copy, PartialEq, Eq)]
+pub struct RunqueueLatencyEvent {
+    /// Монотонное время события (нс)
+    pub timestamp_ns: u64,
+    /// Ожидание потока в очереди выполнения (нс)
+    pub latency_ns: u64,
+    /// Процесс, к которому относится поток
+    pub tgid: u32,
+    /// Поток, ожидавший CPU
+    pub pid: u32,
+    /// CPU, на котором поток получил управление
+    pub cpu: u32,
+}
+
+/// Разобрать запись кольцевого буфера
+///
+/// Возвращает `None` для записей неожиданного размера.
+pub fn parse_runqueue_latency_event(data: &[u8]) -> Option<RunqueueLatencyEvent> {
+    if data.len() < RUNQUEUE_LATENCY_EVENT_SIZE {
+        return None;
+    }
+
+    let u64_at =
+        |offset: usize| u64::from_ne_bytes(data[offset..offset + 8].try_into().unwrap_or([0; 8]));
+    let u32_at =
+        |offset: usize| u32::from_ne_bytes(data[offset..offset + 4].try_into().unwrap_or([0; 4]));
+
+    Some(RunqueueLatencyEvent {
+        timestamp_ns: u64_at(0),
+        latency_ns: u64_at(8),
+        tgid: u32_at(16),
+        pid: u32_at(20),
+        cpu: u32_at(24),
+    })
+}
+
+/// Изменения карты порогов, необходимые для перехода к новому набору процессов
+#[derive(Debug, Clone, Default, PartialEq, Eq)]
+pub struct TargetSyncPlan {
+    /// Процессы, которые нужно добавить в карту
+    pub added: Vec<u32>,
+    /// Процессы, которые нужно удалить из карты
+    pub removed: Vec<u32>,
+}
+
+/// Вычислить изменения карты порогов
+///
+/// Уже опубликованные процессы не перезаписываются, чтобы не сбрасывать
+/// `last_event_ns` и ограничение частоты событий в ядре. Количество
+/// процессов в карте не превышает [`MAX_RUNQUEUE_LATENCY_TARGETS`]; при
+/// переполнении добавляются процессы с меньшими TGID.
+pub fn plan_target_sync(published: &HashSet<u32>, desired: &HashSet<u32>) -> TargetSyncPlan {
+    let mut removed: Vec<u32> = published.difference(desired).copied().collect();
+    removed.sort_unstable();
+
+    let capacity = MAX_RUNQUEUE_LATENCY_TARGETS.saturating_sub(published.len() - removed.len());
+    let mut added: Vec<u32> = desired.difference(published).copied().collect();
+    added.sort_unstable();
+    added.truncate(capacity);
+
+    TargetSyncPlan { added, removed }
+}
+
+/// Параметры быстрого пути
+#[derive(Debug, Clone, Copy, PartialEq, Eq)]
+pub struct RunqueueLatencySettings {
+    /// Порог ожидания в очереди выполнения (нс)
+    pub threshold_ns: u64,
+    /// Минимальный интервал между событиями одного процесса (нс)
+    ///
+    /// Ограничение приблизительное: потоки процесса, одновременно превысившие
+    /// порог на разных CPU, могут опубликовать по событию каждый (см.
+    /// `report_runqueue_latency` в `sched_monitor.c`).
+    pub min_interval_ns: u64,
+    /// Таймаут ожидания событий в poll (миллисекунды)
+    pub poll_timeout_ms: u64,
+}
+
+/// Обработчик событий быстрого пути, вызывается в потоке-потребителе
+pub type RunqueueLatencyHandler = Box<dyn FnMut(&RunqueueLatencyEvent) + Send>;
+
+/// Поток-потребитель событий превышения порога ожидания
+///
+/// Владеет загруженным объектом `sched_monitor` и картой порогов; поток
+/// останавливается при вызове [`RunqueueLatencyStream::stop`] или при
+/// уничтожении структуры.
+#[cfg(feature = "ebpf")]
+pub struct RunqueueLatencyStream {
+    _program: std::sync::Arc<super::ebpf_objects::EbpfObject>,
+    target_map: libbpf_rs::MapHandle,
+    target: RawRunqueueLatencyTarget,
+    published: HashSet<u32>,
+    events_total: std::sync::Arc<std::sync::atomic::AtomicU64>,
+    consumer: RingBufferConsumer,
+}
+
+#[cfg(feature = "ebpf")]
+impl RunqueueLatencyStream {
+    /// Запустить поток событий поверх загруженной программы `sched_monitor`
+    pub fn start(
+        program: std::sync::Arc<super::ebpf_objects::EbpfObject>,
+        settings: RunqueueLatencySettings,
+        mut handler: RunqueueLatencyHandler,
+    ) -> anyhow::Result<Self> {
+        use anyhow::Context;
+        use std::sync::atomic::{AtomicU64, Ordering};
+        use std::sync::Arc;
+        use std::time::Duration;
+
+        let target_map = program
+            .map_handle(SCHED_LATENCY_TARGET_MAP)?
+            .with_context(|| format!("Карта {} не найдена", SCHED_LATENCY_TARGET_MAP))?;
+        let ringbuf_map = program
+            .map_handle(SCHED_LATENCY_RINGBUF_MAP)?
+            .with_context(|| format!("Карта {} не найдена", SCHED_LATENCY_RINGBUF_MAP))?;
+
+        let events_total = Arc::new(AtomicU64::new(0));
+        let worker_events = Arc::clone(&events_total);
+        let consumer = RingBufferConsumer::start(
+            "ebpf-runqueue",
+            ringbuf_map,
+            Duration::from_millis(settings.poll_timeout_ms.max(1)),
+            64,
+            parse_runqueue_latency_event,
+            move |events: &[RunqueueLatencyEvent]| {
+                // Обработчик вызывается вне колбэка libbpf, чтобы системные
+                // вызовы актуатора не задерживали вычитку буфера
+                worker_events.fetch_add(events.len() as u64, Ordering::Relaxed);
+                for event in events {
+                    handler(event);
+                }
+            },
+        )?;
+
+        tracing::info!(
+            "Быстрый путь задержек очереди выполнения запущен (порог: {} мкс, интервал: {} мс)",
+            settings.threshold_ns / 1_000,
+            settings.min_interval_ns / 1_000_000
+        );
+
+        Ok(Self {
+            _program: program,
+            target_map,
+            target: RawRunqueueLatencyTarget::new(settings.threshold_ns, settings.min_interval_ns),
+            published: HashSet::new(),
+            events_total,
+            consumer,
+        })
+    }
+
+    /// Синхронизировать карту порогов с набором отмеченных процессов
+    ///
+    /// Возвращает количество процессов в карте после синхронизации.
+    pub fn sync_targets(&mut self, tgids: &HashSet<u32>) -> anyhow::Result<usize> {
+        use anyhow::Context;
+        use libbpf_rs::{MapCore, MapFlags};
+
+        let plan = plan_target_sync(&self.published, tgids);
+
+        for tgid in &plan.removed {
+            // Запись уже могла исчезнуть вместе с процессом
+            let _ = self.target_map.delete(&tgid.to_ne_bytes());
+            self.published.remove(tgid);
+        }
+
+        let value = self.target.to_bytes();
+        for tgid in &plan.added {
+            self.target_map
+                .update(&tgid.to_ne_bytes(), &value, MapFlags::ANY)
+                .with_context(|| format!("Не удалось отметить процесс {} в карте порогов", tgid))?;
+            self.published.insert(*tgid);
+        }
+
+        Ok(self.published.len())
+    }
+
+    /// Количество событий, полученных с момента запуска
+    pub fn events_total(&self) -> u64 {
+        self.events_total.load(std::sync::atomic::Ordering::Relaxed)
+    }
+
+    /// Остановить поток-потребитель
+    pub fn stop(&mut self) {
+        self.consumer.stop();
+    }
+}
+
+#[cfg(feature = "ebpf")]
+impl Drop for RunqueueLatencyStream {
+    fn drop(&mut self) {
+        self.stop();
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    #[test]
+    fn test_raw_layout_matches_kernel() {
+        assert_eq!(
+            std::mem::size_of::<RawRunqueueLatencyEvent>(),
+            RUNQUEUE_LATENCY_EVENT_SIZE
+        );
+        assert_eq!(std::mem::size_of::<RawRunqueueLatencyTarget>(), 24);
+    }
+
+    #[test]
+    fn test_parse_event() {
+        let raw = RawRunqueueLatencyEvent {
+            timestamp_ns: 10,
+            latency_ns: 7_000_000,
+            tgid: 100,
+            pid: 105,
+            cpu: 3,
+            _pad: 0,
+        };
+        let bytes = unsafe {
+            std::slice::from_raw_parts(
+                &raw as *const RawRunqueueLatencyEvent as *const u8,
+                std::mem::size_of::<RawRunqueueLatencyEvent>(),
+            )
+        };
+
+        let event = parse_runqueue_latency_event(bytes).unwrap();
+        assert_eq!(
+            event,
+            RunqueueLatencyEvent {
+                timestamp_ns: 10,
+                latency_ns: 7_000_000,
+                tgid: 100,
+                pid: 105,
+                cpu: 3,
+            }
+        );
+        assert!(parse_runqueue_latency_event(&bytes[..16]).is_none());
+    }
+
+    #[test]
+    fn test_target_threshold_clamped() {
+        let target = RawRunqueueLatencyTarget::new(100, 50_000_000);
+        assert_eq!(target.threshold_ns, MIN_RUNQUEUE_LATENCY_THRESHOLD_NS);
+
+        let bytes = RawRunqueueLatencyTarget::new(5_000_000, 50_000_000).to_bytes();
+        assert_eq!(
+            u64::from_ne_bytes(bytes[0..8].try_into().unwrap()),
+            5_000_000
+        );
+        assert_eq!(
+            u64::from_ne_bytes(bytes[8..16].try_into().unwrap()),
+            50_000_000
+        );
+        assert_eq!(u64::from_ne_bytes(bytes[16..24].try_into().unwrap()), 0);
+    }
+
+    #[test]
+    fn test_plan_target_sync() {
+        let published: HashSet<u32> = [1, 2, 3].into_iter().collect();
+        let desired: HashSet<u32> = [2, 3, 5, 4].into_iter().collect();
+
+        let plan = plan_target_sync(&published, &desired);
+        assert_eq!(plan.added, vec![4, 5]);
+        assert_eq!(plan.removed, vec![1]);
+
+        let unchanged = plan_target_sync(&desired, &desired);
+        assert_eq!(unchanged, TargetSyncPlan::default());
+    }
+
+    #[test]
+    fn test_plan_target_sync_respects_capacity() {
+        let published: HashSet<u32> = (0..MAX_RUNQUEUE_LATENCY_TARGETS as u32 - 1).collect();
+        let mut desired = published.clone();
+        desired.extend([5000, 5001, 5002]);
+
+        let plan = plan_target_sync(&published, &desired);
+        assert_eq!(plan.added, vec![5000]);
+        assert!(plan.removed.is_empty());
+    }
+}
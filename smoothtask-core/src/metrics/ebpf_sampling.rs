@@ -0,0 +1,494 @@
+//! Адаптивная выборка высокочастотных событий eBPF.
+//!
+//! Общий заголовок `ebpf_programs/smoothtask_sampling.h` добавляет в программы
+//! таблицу коэффициентов выборки по классам событий (системные вызовы,
+//! kmalloc/kfree, page faults, приём пакетов). Обработчик с коэффициентом N
+//! в среднем обрабатывает одно событие из N и учитывает его с весом N, так
+//! что счётчики остаются несмещёнными.
+//!
+//! Коэффициенты подбирает [`AdaptiveSampler`] по измеренной стоимости самих
+//! программ: ядро ведёт `run_time_ns` / `run_cnt` каждой программы, пока
+//! открыт дескриптор `BPF_ENABLE_STATS`. Если доля CPU, которую тратят
+//! программы класса, превышает бюджет, коэффициент растёт пропорционально
+//! превышению; когда нагрузка спадает ниже половины бюджета, коэффициент
+//! уменьшается вдвое, возвращая точность.
+
+use std::collections::HashMap;
+use std::io;
+use std::os::fd::{FromRawFd, OwnedFd, RawFd};
+use std::time::Duration;
+
+use serde::{Deserialize, Serialize};
+
+/// Таблица коэффициентов выборки.
+pub const SAMPLING_MAP_NAME: &str = "smoothtask_sampling_map";
+
+/// Бюджет CPU на класс событий по умолчанию (процент от всех CPU).
+pub const DEFAULT_SAMPLING_CPU_BUDGET_PERCENT: f64 = 1.0;
+
+/// Максимальный коэффициент выборки по умолчанию.
+pub const DEFAULT_MAX_SAMPLING_RATE: u32 = 64;
+
+/// Минимальный интервал между подстройками коэффициентов: на более коротких
+/// интервалах оценка стоимости программ слишком шумная.
+pub const SAMPLING_ADJUST_INTERVAL: Duration = Duration::from_secs(1);
+
+/// Класс высокочастотных событий с общим коэффициентом выборки.
+#[derive(Debug, Clone, Copy, PartialEq, Eq, Hash, Serialize, Deserialize)]
+#[serde(rename_all = "snake_case")]
+pub enum SamplingClass {
+    /// Входы в системные вызовы
+    Syscalls,
+    /// Выделения и освобождения памяти ядра
+    Kmem,
+    /// Пользовательские page faults
+    PageFaults,
+    /// Принятые сетевые пакеты
+    NetRx,
+}
+
+impl SamplingClass {
+    /// Все классы в порядке индексов таблицы ядра.
+    pub const ALL: [SamplingClass; 4] = [
+        SamplingClass::Syscalls,
+        SamplingClass::Kmem,
+        SamplingClass::PageFaults,
+        SamplingClass::NetRx,
+    ];
+
+    /// Индекс в `smoothtask_sampling_map` (совпадает с SMOOTHTASK_SAMPLE_*).
+    pub fn index(self) -> u32 {
+        match self {
+            SamplingClass::Syscalls => 0,
+            SamplingClass::Kmem => 1,
+            SamplingClass::PageFaults => 2,
+            SamplingClass::NetRx => 3,
+        }
+    }
+
+    /// Имя класса для логов и API.
+    pub fn name(self) -> &'static str {
+        match self {
+            SamplingClass::Syscalls => "syscalls",
+            SamplingClass::Kmem => "kmem",
+            SamplingClass::PageFaults => "page_faults",
+            SamplingClass::NetRx => "net_rx",
+        }
+    }
+
+    /// Класс, к которому относится программа с данным именем функции.
+    ///
+    /// Программы без выборки (обработчики выхода, низкочастотные события)
+    /// не относятся ни к одному классу. Выходы из системных вызовов входят в
+    /// класс системных вызовов: их стоимость тоже снижается выборкой на входе.
+    pub fn for_program(name: &str) -> Option<Self> {
+        match name {
+            "trace_kmalloc" | "trace_kfree" => Some(SamplingClass::Kmem),
+            "trace_page_fault_user" => Some(SamplingClass::PageFaults),
+            "trace_network_packet" | "trace_total_network_packet" => Some(SamplingClass::NetRx),
+            // Имя программы в ядре обрезается до 15 символов
+            name if name.starts_with("trace_syscall") => Some(SamplingClass::Syscalls),
+            _ => None,
+        }
+    }
+}
+
+/// Значение `smoothtask_sampling_map` в раскладке ядра.
+#[repr(C)]
+#[derive(Debug, Clone, Copy, Default, PartialEq, Eq)]
+pub struct RawSamplingConfig {
+    pub rate: u32,
+    pub _pad: u32,
+}
+
+impl RawSamplingConfig {
+    /// Байтовое представление для записи в карту.
+    pub fn to_ne_bytes(self) -> [u8; 8] {
+        let mut bytes = [0u8; 8];
+        bytes[..4].copy_from_slice(&self.rate.to_ne_bytes());
+        bytes[4..].copy_from_slice(&self._pad.to_ne_bytes());
+        bytes
+    }
+}
+
+/// Накопленная ядром статистика выполнения программы.
+#[derive(Debug, Clone, Copy, Default, PartialEq, Eq, Serialize, Deserialize)]
+pub struct ProgramRuntimeStats {
+    /// Суммарное время выполнения (нс)
+    pub run_time_ns: u64,
+    /// Количество запусков
+    pub run_cnt: u64,
+}
+
+impl ProgramRuntimeStats {
+    /// Сумма статистик (с насыщением).
+    pub fn merged(self, other: Self) -> Self {
+        Self {
+            run_time_ns: self.run_time_ns.saturating_add(other.run_time_ns),
+            run_cnt: self.run_cnt.saturating_add(other.run_cnt),
+        }
+    }
+}
+
+/// Просуммировать статистику программ по классам выборки.
+pub fn aggregate_by_class<'a, I>(programs: I) -> HashMap<SamplingClass, ProgramRuntimeStats>
+where
+    I: IntoIterator<Item = (&'a str, ProgramRuntimeStats)>,
+{
+    let mut totals: HashMap<SamplingClass, ProgramRuntimeStats> = HashMap::new();
+    for (name, stats) in programs {
+        if let Some(class) = SamplingClass::for_program(name) {
+            let total = totals.entry(class).or_default();
+            *total = total.merged(stats);
+        }
+    }
+    totals
+}
+
+/// Текущее состояние класса выборки.
+#[derive(Debug, Clone, Copy, PartialEq, Serialize, Deserialize)]
+pub struct SamplingClassState {
+    /// Класс событий
+    pub class: SamplingClass,
+    /// Текущий коэффициент выборки (1 — все события)
+    pub rate: u32,
+    /// Измеренная на последнем интервале доля CPU (процент от всех CPU)
+    pub overhead_percent: f64,
+}
+
+#[derive(Debug, Clone, Copy)]
+struct ClassState {
+    rate: u32,
+    last: Option<ProgramRuntimeStats>,
+    overhead_percent: f64,
+}
+
+impl Default for ClassState {
+    fn default() -> Self {
+        Self {
+            rate: 1,
+            last: None,
+            overhead_percent: 0.0,
+        }
+    }
+}
+
+/// Контроллер коэффициентов выборки по измеренной стоимости программ.
+#[derive(Debug, Clone)]
+pub struct AdaptiveSampler {
+    budget_percent: f64,
+    max_rate: u32,
+    states: HashMap<SamplingClass, ClassState>,
+}
+
+impl AdaptiveSampler {
+    /// Создать контроллер с бюджетом CPU на класс и предельным коэффициентом.
+    pub fn new(budget_percent: f64, max_rate: u32) -> Self {
+        Self {
+            budget_percent: if budget_percent > 0.0 {
+                budget_percent
+            } else {
+                DEFAULT_SAMPLING_CPU_BUDGET_PERCENT
+            },
+            max_rate: max_rate.max(1),
+            states: HashMap::new(),
+        }
+    }
+
+    /// Текущий коэффициент класса.
+    pub fn rate(&self, class: SamplingClass) -> u32 {
+        self.states.get(&class).map_or(1, |state| state.rate)
+    }
+
+    /// Учесть накопленную статистику класса за интервал `elapsed`.
+    ///
+    /// Первое наблюдение только запоминает базу. Возвращает новый
+    /// коэффициент, если его нужно записать в ядро.
+    pub fn observe(
+        &mut self,
+        class: SamplingClass,
+        stats: ProgramRuntimeStats,
+        elapsed: Duration,
+        num_cpus: usize,
+    ) -> Option<u32> {
+        let budget = self.budget_percent;
+        let max_rate = self.max_rate;
+        let state = self.states.entry(class).or_default();
+        let last = state.last.replace(stats)?;
+
+        let capacity_ns = elapsed.as_nanos() as f64 * num_cpus.max(1) as f64;
+        // Счётчики ядра сбрасываются при перезагрузке программ
+        if capacity_ns <= 0.0 || stats.run_time_ns < last.run_time_ns {
+            return None;
+        }
+
+        let overhead = (stats.run_time_ns - last.run_time_ns) as f64 / capacity_ns * 100.0;
+        state.overhead_percent = overhead;
+
+        let rate = if overhead > budget {
+            // Стоимость почти обратно пропорциональна коэффициенту
+            let wanted = (state.rate as f64 * overhead / budget).ceil() as u32;
+            wanted.max(state.rate.saturating_add(1)).min(max_rate)
+        } else if overhead < budget / 2.0 {
+            (state.rate / 2).max(1)
+        } else {
+            state.rate
+        };
+
+        if rate == state.rate {
+            return None;
+        }
+        state.rate = rate;
+        Some(rate)
+    }
+
+    /// Состояние всех наблюдаемых классов.
+    pub fn snapshot(&self) -> Vec<SamplingClassState> {
+        SamplingClass::ALL
+            .iter()
+            .filter_map(|class| {
+                self.states.get(class).map(|state| SamplingClassState {
+                    class: *class,
+                    rate: state.rate,
+                    overhead_percent: state.overhead_percent,
+                })
+            })
+            .collect()
+    }
+}
+
+impl Default for AdaptiveSampler {
+    fn default() -> Self {
+        Self::new(
+            DEFAULT_SAMPLING_CPU_BUDGET_PERCENT,
+            DEFAULT_MAX_SAMPLING_RATE,
+        )
+    }
+}
+
+/// `BPF_OBJ_GET_INFO_BY_FD`
+const BPF_OBJ_GET_INFO_BY_FD: libc::c_long = 15;
+/// `BPF_ENABLE_STATS`
+const BPF_ENABLE_STATS: libc::c_long = 32;
+/// `BPF_STATS_RUN_TIME`
+const BPF_STATS_RUN_TIME: u32 = 0;
+
+/// Размер буфера `struct bpf_prog_info` (с запасом под новые поля).
+const PROG_INFO_SIZE: usize = 256;
+/// Смещение `run_time_ns` в `struct bpf_prog_info`.
+const PROG_INFO_RUN_TIME_OFFSET: usize = 192;
+/// Смещение `run_cnt` в `struct bpf_prog_info`.
+const PROG_INFO_RUN_CNT_OFFSET: usize = 200;
+
+/// Раскладка `union bpf_attr` для `BPF_OBJ_GET_INFO_BY_FD`
+#[repr(C)]
+#[derive(Default)]
+struct BpfInfoAttr {
+    bpf_fd: u32,
+    info_len: u32,
+    info: u64,
+}
+
+/// Раскладка `union bpf_attr` для `BPF_ENABLE_STATS`
+#[repr(C)]
+#[derive(Default)]
+struct BpfEnableStatsAttr {
+    stats_type: u32,
+}
+
+/// Разобрать статистику выполнения из буфера `struct bpf_prog_info`.
+///
+/// Старые ядра возвращают укороченную структуру; отсутствующие поля читаются
+/// как ноль.
+pub fn parse_prog_info_runtime(info: &[u8]) -> ProgramRuntimeStats {
+    let read_u64 = |offset: usize| {
+        info.get(offset..offset + 8).map_or(0, |bytes| {
+            u64::from_ne_bytes(bytes.try_into().unwrap_or([0; 8]))
+        })
+    };
+    ProgramRuntimeStats {
+        run_time_ns: read_u64(PROG_INFO_RUN_TIME_OFFSET),
+        run_cnt: read_u64(PROG_INFO_RUN_CNT_OFFSET),
+    }
+}
+
+/// Включить учёт времени выполнения eBPF программ (Linux 5.8+).
+///
+/// Учёт действует, пока открыт возвращённый дескриптор.
+pub fn enable_run_time_stats() -> io::Result<OwnedFd> {
+    let mut attr = BpfEnableStatsAttr {
+        stats_type: BPF_STATS_RUN_TIME,
+    };
+
+    // SAFETY: attr живёт до конца вызова
+    let ret = unsafe {
+        libc::syscall(
+            libc::SYS_bpf,
+            BPF_ENABLE_STATS,
+            &mut attr as *mut BpfEnableStatsAttr,
+            std::mem::size_of::<BpfEnableStatsAttr>() as libc::c_uint,
+        )
+    };
+    if ret < 0 {
+        return Err(io::Error::last_os_error());
+    }
+
+    // SAFETY: ядро вернуло новый дескриптор, которым больше никто не владеет
+    Ok(unsafe { OwnedFd::from_raw_fd(ret as RawFd) })
+}
+
+/// Прочитать статистику выполнения программы по её дескриптору.
+pub fn query_program_runtime(prog_fd: RawFd) -> io::Result<ProgramRuntimeStats> {
+    let mut info = [0u8; PROG_INFO_SIZE];
+    let mut attr = BpfInfoAttr {
+        bpf_fd: prog_fd as u32,
+        info_len: info.len() as u32,
+        info: info.as_mut_ptr() as u64,
+    };
+
+    // SAFETY: attr указывает на буфер, живущий до конца вызова
+    let ret = unsafe {
+        libc::syscall(
+            libc::SYS_bpf,
+            BPF_OBJ_GET_INFO_BY_FD,
+            &mut attr as *mut BpfInfoAttr,
+            std::mem::size_of::<BpfInfoAttr>() as libc::c_uint,
+        )
+    };
+    if ret < 0 {
+        return Err(io::Error::last_os_error());
+    }
+
+    let filled = (attr.info_len as usize).min(info.len());
+    Ok(parse_prog_info_runtime(&info[..filled]))
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    fn stats(run_time_ns: u64) -> ProgramRuntimeStats {
+        ProgramRuntimeStats {
+            run_time_ns,
+            run_cnt: 0,
+        }
+    }
+
+    #[test]
+    fn test_layout_matches_kernel() {
+        assert_eq!(std::mem::size_of::<RawSamplingConfig>(), 8);
+        assert_eq!(std::mem::size_of::<BpfInfoAttr>(), 16);
+        let raw = RawSamplingConfig { rate: 16, _pad: 0 };
+        assert_eq!(&raw.to_ne_bytes()[..4], &16u32.to_ne_bytes());
+        let indices: Vec<u32> = SamplingClass::ALL
+            .iter()
+            .map(|class| class.index())
+            .collect();
+        assert_eq!(indices, vec![0, 1, 2, 3]);
+    }
+
+    #[test]
+    fn test_program_classes() {
+        assert_eq!(
+            SamplingClass::for_program("trace_syscall_entry"),
+            Some(SamplingClass::Syscalls)
+        );
+        // Имя, обрезанное ядром
+        assert_eq!(
+            SamplingClass::for_program("trace_syscall_e"),
+            Some(SamplingClass::Syscalls)
+        );
+        assert_eq!(
+            SamplingClass::for_program("trace_kfree"),
+            Some(SamplingClass::Kmem)
+        );
+        assert_eq!(SamplingClass::for_program("trace_process_exit"), None);
+
+        let totals = aggregate_by_class(vec![
+            ("trace_syscall_entry", stats(100)),
+            ("trace_syscall_exit", stats(50)),
+            ("trace_kmalloc", stats(7)),
+            ("trace_tcp_connection", stats(1000)),
+        ]);
+        assert_eq!(totals.len(), 2);
+        assert_eq!(totals[&SamplingClass::Syscalls].run_time_ns, 150);
+        assert_eq!(totals[&SamplingClass::Kmem].run_time_ns, 7);
+    }
+
+    #[test]
+    fn test_sampler_backs_off_and_recovers() {
+        let mut sampler = AdaptiveSampler::new(1.0, 64);
+        let class = SamplingClass::Syscalls;
+        let second = Duration::from_secs(1);
+
+        // Первое наблюдение — только база
+        assert_eq!(sampler.observe(class, stats(0), second, 4), None);
+
+        // 4% от четырёх CPU при бюджете 1% — коэффициент растёт вчетверо
+        assert_eq!(
+            sampler.observe(class, stats(160_000_000), second, 4),
+            Some(4)
+        );
+        assert_eq!(sampler.rate(class), 4);
+
+        // В пределах бюджета коэффициент не меняется
+        assert_eq!(sampler.observe(class, stats(190_000_000), second, 4), None);
+
+        // Нагрузка спала — точность возвращается ступенями
+        assert_eq!(
+            sampler.observe(class, stats(190_000_000), second, 4),
+            Some(2)
+        );
+        assert_eq!(
+            sampler.observe(class, stats(190_000_000), second, 4),
+            Some(1)
+        );
+        assert_eq!(sampler.observe(class, stats(190_000_000), second, 4), None);
+
+        let snapshot = sampler.snapshot();
+        assert_eq!(snapshot.len(), 1);
+        assert_eq!(snapshot[0].rate, 1);
+    }
+
+    #[test]
+    fn test_sampler_limits() {
+        let mut sampler = AdaptiveSampler::new(1.0, 8);
+        let class = SamplingClass::NetRx;
+        let second = Duration::from_secs(1);
+
+        sampler.observe(class, stats(0), second, 1);
+        // Перегрузка упирается в предел
+        assert_eq!(
+            sampler.observe(class, stats(500_000_000), second, 1),
+            Some(8)
+        );
+        assert_eq!(
+            sampler.observe(class, stats(1_000_000_000), second, 1),
+            None
+        );
+        // Сброс счётчиков ядра не меняет коэффициент
+        assert_eq!(sampler.observe(class, stats(10), second, 1), None);
+        assert_eq!(sampler.rate(class), 8);
+    }
+
+    #[test]
+    fn test_parse_prog_info_runtime() {
+        let mut info = [0u8; PROG_INFO_SIZE];
+        info[PROG_INFO_RUN_TIME_OFFSET..PROG_INFO_RUN_TIME_OFFSET + 8]
+            .copy_from_slice(&12345u64.to_ne_bytes());
+        info[PROG_INFO_RUN_CNT_OFFSET..PROG_INFO_RUN_CNT_OFFSET + 8]
+            .copy_from_slice(&67u64.to_ne_bytes());
+        assert_eq!(
+            parse_prog_info_runtime(&info),
+            ProgramRuntimeStats {
+                run_time_ns: 12345,
+                run_cnt: 67
+            }
+        );
+        // Укороченная структура старого ядра
+        assert_eq!(
+            parse_prog_info_runtime(&info[..100]),
+            ProgramRuntimeStats::default()
+        );
+    }
+}
@@ -0,0 +1,194 @@
+//! Общая запись планировщика для eBPF коллекторов.
+//!
+//! Программа `sched_monitor.c` — единственная точка подключения к
+//! `sched_switch`. Она ведёт одну компактную запись на процесс (TGID) в
+//! `sched_task_map`: время на CPU, ожидание в очереди выполнения, время сна
+//! с разбивкой на ввод-вывод и обычный сон, число переключений и снимок RSS.
+//! Коллекторы производительности приложений, энергопотребления и памяти
+//! читают эту запись вместо собственных обработчиков переключения контекста.
+
+use std::collections::HashMap;
+
+/// Имя встроенной программы планировщика.
+pub const SCHED_PROGRAM_NAME: &str = "sched_monitor";
+
+/// Имя карты с записями процессов.
+pub const SCHED_TASK_MAP_NAME: &str = "sched_task_map";
+
+/// Имя per-CPU карты с занятостью CPU.
+pub const SCHED_ONCPU_MAP_NAME: &str = "sched_oncpu_map";
+
+/// Запись `sched_task_map` в раскладке ядра (`struct sched_task_stats`).
+///
+/// Первые 64 байта обновляются на каждом переключении контекста и занимают
+/// одну кэш-линию; имя процесса записывается только при создании записи.
+#[repr(C)]
+#[derive(Debug, Clone, Copy, Default, PartialEq, Eq)]
+pub struct RawSchedTaskStats {
+    pub tgid: u32,
+    /// CPU последнего выполнения
+    pub last_cpu: u32,
+    /// Время на CPU в наносекундах
+    pub runtime_ns: u64,
+    /// Ожидание в очереди выполнения в наносекундах
+    pub runqueue_wait_ns: u64,
+    /// Непрерываемый сон (ввод-вывод) в наносекундах
+    pub io_wait_ns: u64,
+    /// Прерываемый сон в наносекундах
+    pub sleep_ns: u64,
+    /// Монотонное время последнего переключения с участием процесса
+    pub last_switch_ns: u64,
+    /// Количество уходов с CPU
+    pub context_switches: u32,
+    /// Из них вытеснений
+    pub involuntary_switches: u32,
+    /// Последний снимок RSS в страницах
+    pub rss_pages: u64,
+    pub comm: [u8; 16],
+}
+
+impl RawSchedTaskStats {
+    /// Имя лидера группы потоков.
+    pub fn name(&self) -> String {
+        comm_to_string(&self.comm)
+    }
+
+    /// Время вне CPU без учёта ожидания в очереди выполнения.
+    pub fn off_cpu_ns(&self) -> u64 {
+        self.io_wait_ns.saturating_add(self.sleep_ns)
+    }
+
+    /// Всё учтённое время процесса: выполнение, очередь и сон.
+    pub fn total_time_ns(&self) -> u64 {
+        self.runtime_ns
+            .saturating_add(self.runqueue_wait_ns)
+            .saturating_add(self.off_cpu_ns())
+    }
+
+    /// Снимок RSS в байтах.
+    pub fn rss_bytes(&self, page_size: u64) -> u64 {
+        self.rss_pages.saturating_mul(page_size)
+    }
+}
+
+/// Преобразовать имя задачи из ядра (`char comm[16]`) в строку.
+pub fn comm_to_string(comm: &[u8]) -> String {
+    let len = comm.iter().position(|&b| b == 0).unwrap_or(comm.len());
+    String::from_utf8_lossy(&comm[..len]).into_owned()
+}
+
+/// Слот `sched_oncpu_map` одного CPU в раскладке ядра (`struct sched_oncpu_slot`).
+#[repr(C)]
+#[derive(Debug, Clone, Copy, Default, PartialEq, Eq)]
+pub struct RawSchedOncpuSlot {
+    /// Начало выполнения текущей задачи
+    pub oncpu_ts: u64,
+    /// Время, когда CPU выполнял задачи, кроме idle
+    pub busy_ns: u64,
+    pub pid: u32,
+    pub tgid: u32,
+}
+
+/// Суммарная занятость всех CPU по их слотам.
+pub fn total_busy_ns(slots: &[RawSchedOncpuSlot]) -> u64 {
+    slots.iter().map(|slot| slot.busy_ns).sum()
+}
+
+/// Снимок `sched_task_map`, проиндексированный по TGID.
+#[derive(Debug, Clone, Default)]
+pub struct SchedTaskTable {
+    tasks: HashMap<u32, RawSchedTaskStats>,
+}
+
+impl SchedTaskTable {
+    /// Построить таблицу из прочитанных записей, пропуская пустые слоты.
+    pub fn from_records(records: Vec<RawSchedTaskStats>) -> Self {
+        let tasks = records
+            .into_iter()
+            .filter(|record| record.tgid != 0)
+            .map(|record| (record.tgid, record))
+            .collect();
+        Self { tasks }
+    }
+
+    /// Запись процесса по TGID.
+    pub fn get(&self, tgid: u32) -> Option<&RawSchedTaskStats> {
+        self.tasks.get(&tgid)
+    }
+
+    /// Количество процессов в снимке.
+    pub fn len(&self) -> usize {
+        self.tasks.len()
+    }
+
+    /// Пуст ли снимок (программа не загружена или ещё не было переключений).
+    pub fn is_empty(&self) -> bool {
+        self.tasks.is_empty()
+    }
+
+    /// Итератор по записям.
+    pub fn iter(&self) -> impl Iterator<Item = &RawSchedTaskStats> {
+        self.tasks.values()
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    fn record(tgid: u32, name: &[u8]) -> RawSchedTaskStats {
+        let mut comm = [0u8; 16];
+        comm[..name.len()].copy_from_slice(name);
+        RawSchedTaskStats {
+            tgid,
+            comm,
+            ..Default::default()
+        }
+    }
+
+    #[test]
+    fn test_layout_matches_kernel() {
+        assert_eq!(std::mem::size_of::<RawSchedTaskStats>(), 80);
+        assert_eq!(std::mem::align_of::<RawSchedTaskStats>(), 8);
+        // Горячая часть записи укладывается в одну кэш-линию
+        let base = RawSchedTaskStats::default();
+        let comm_offset = base.comm.as_ptr() as usize - &base as *const _ as usize;
+        assert_eq!(comm_offset, 64);
+        assert_eq!(std::mem::size_of::<RawSchedOncpuSlot>(), 24);
+    }
+
+    #[test]
+    fn test_time_accounting() {
+        let stats = RawSchedTaskStats {
+            runtime_ns: 5_000,
+            runqueue_wait_ns: 1_000,
+            io_wait_ns: 3_000,
+            sleep_ns: 1_000,
+            rss_pages: 256,
+            ..record(10, b"worker")
+        };
+        assert_eq!(stats.off_cpu_ns(), 4_000);
+        assert_eq!(stats.total_time_ns(), 10_000);
+        assert_eq!(stats.rss_bytes(4096), 1024 * 1024);
+        assert_eq!(stats.name(), "worker");
+    }
+
+    #[test]
+    fn test_comm_without_terminator() {
+        assert_eq!(comm_to_string(b"0123456789abcdef"), "0123456789abcdef");
+        assert_eq!(comm_to_string(&[0u8; 16]), "");
+    }
+
+    #[test]
+    fn test_table_skips_empty_slots() {
+        let table = SchedTaskTable::from_records(vec![
+            record(0, b""),
+            record(42, b"firefox"),
+            record(7, b"Xorg"),
+        ]);
+        assert_eq!(table.len(), 2);
+        assert!(table.get(0).is_none());
+        assert_eq!(table.get(42).map(|t| t.name()), Some("firefox".to_string()));
+        assert!(SchedTaskTable::default().is_empty());
+    }
+}
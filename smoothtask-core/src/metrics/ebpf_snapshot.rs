@@ -0,0 +1,327 @@
+//! Разделяемые снимки eBPF метрик.
+//!
+//! Коллектор публикует каждый собранный набор метрик как неизменяемый снимок
+//! с номером поколения. Снимок — указатель на общие данные: кэш коллектора,
+//! `SystemMetrics` и обработчики API держат одну и ту же копию, и
+//! клонирование снимка только увеличивает счётчик ссылок. Следующий сбор
+//! строит новое поколение рядом с текущим и подменяет указатель, не трогая
+//! данные, которые ещё читают обработчики; прежнее поколение освобождается
+//! вместе с последней ссылкой на него.
+//!
+//! Сериализация выполняется по секциям и лениво: секция кодируется в JSON при
+//! первом обращении и хранится в снимке до смены поколения, поэтому частые
+//! опросы API и экспорт Prometheus не повторяют её для неизменных данных.
+//! Секция хранится готовым текстом ([`RawValue`]): обработчик вставляет её в
+//! ответ без повторного кодирования и без копирования дерева `Value`.
+
+use std::fmt;
+use std::ops::Deref;
+use std::sync::atomic::{AtomicU64, Ordering};
+use std::sync::{Arc, OnceLock};
+
+use serde::{Deserialize, Deserializer, Serialize, Serializer};
+use serde_json::value::RawValue;
+
+use super::ebpf::EbpfMetrics;
+
+/// Следующий номер поколения (общий для всех коллекторов процесса)
+static NEXT_GENERATION: AtomicU64 = AtomicU64::new(1);
+
+/// Секции снимка, которые обработчики API вставляют в ответ целиком
+///
+/// Обработчики, которые фильтруют записи или меняют их форму, строят ответ
+/// из метрик снимка и секций не используют.
+#[derive(Debug, Clone, Copy, PartialEq, Eq, Hash)]
+pub enum EbpfSnapshotSection {
+    ProcessEnergy,
+    ProcessGpu,
+}
+
+impl EbpfSnapshotSection {
+    /// Все секции в порядке индексов кэша
+    pub const ALL: [EbpfSnapshotSection; 2] = [
+        EbpfSnapshotSection::ProcessEnergy,
+        EbpfSnapshotSection::ProcessGpu,
+    ];
+
+    /// Закодировать секцию; `None`, если её нет в метриках
+    fn encode(self, metrics: &EbpfMetrics) -> Option<Box<RawValue>> {
+        let value = match self {
+            EbpfSnapshotSection::ProcessEnergy => metrics
+                .process_energy_details
+                .as_ref()
+                .map(serde_json::value::to_raw_value),
+            EbpfSnapshotSection::ProcessGpu => metrics
+                .process_gpu_details
+                .as_ref()
+                .map(serde_json::value::to_raw_value),
+        }?;
+
+        match value {
+            Ok(value) => Some(value),
+            Err(e) => {
+                tracing::warn!(
+                    "Не удалось сериализовать секцию {:?} eBPF снимка: {}",
+                    self,
+                    e
+                );
+                None
+            }
+        }
+    }
+}
+
+struct SnapshotInner {
+    generation: u64,
+    metrics: EbpfMetrics,
+    sections: [OnceLock<Option<Box<RawValue>>>; EbpfSnapshotSection::ALL.len()],
+    prometheus: OnceLock<String>,
+}
+
+/// Неизменяемый снимок eBPF метрик одного поколения
+///
+/// Разыменовывается в [`EbpfMetrics`]; сериализуется и сравнивается как
+/// сами метрики, так что формат `SystemMetrics` не меняется.
+#[derive(Clone)]
+pub struct EbpfSnapshot {
+    inner: Arc<SnapshotInner>,
+}
+
+impl EbpfSnapshot {
+    /// Опубликовать метрики как снимок нового поколения
+    pub fn new(metrics: EbpfMetrics) -> Self {
+        Self {
+            inner: Arc::new(SnapshotInner {
+                generation: NEXT_GENERATION.fetch_add(1, Ordering::Relaxed),
+                metrics,
+                sections: Default::default(),
+                prometheus: OnceLock::new(),
+            }),
+        }
+    }
+
+    /// Номер поколения; у разных снимков он различается
+    pub fn generation(&self) -> u64 {
+        self.inner.generation
+    }
+
+    /// Метрики снимка
+    pub fn metrics(&self) -> &EbpfMetrics {
+        &self.inner.metrics
+    }
+
+    /// Копия метрик для изменения (снимок остаётся прежним)
+    pub fn to_metrics(&self) -> EbpfMetrics {
+        self.inner.metrics.clone()
+    }
+
+    /// Секция в JSON, закодированная не более одного раза за поколение
+    ///
+    /// Сериализатор serde_json записывает [`RawValue`] в вывод как есть,
+    /// поэтому поле ответа с этой секцией не кодируется повторно.
+    pub fn section_json(&self, section: EbpfSnapshotSection) -> Option<&RawValue> {
+        self.inner.sections[section as usize]
+            .get_or_init(|| section.encode(&self.inner.metrics))
+            .as_deref()
+    }
+
+    /// eBPF часть экспорта Prometheus (перцентили задержек системных вызовов,
+    /// стоимость программ и последняя сводка эпохи), сформированная один раз
+    /// за поколение
+    pub fn prometheus_text(&self) -> &str {
+        self.inner.prometheus.get_or_init(|| {
+            let metrics = &self.inner.metrics;
+            let mut text = String::new();
+            if let Some(latency_details) = &metrics.syscall_latency_details {
+                text.push_str(&super::ebpf_latency::syscall_latency_to_prometheus(
+                    latency_details,
+                ));
+            }
+            if let Some(overhead) = &metrics.program_overhead {
+                text.push_str(&super::ebpf_overhead::overhead_to_prometheus(overhead));
+            }
+            if let Some(epoch) = metrics.epoch_summaries.as_ref().and_then(|e| e.last()) {
+                text.push_str(&super::ebpf_epoch::epoch_summary_to_prometheus(epoch));
+            }
+            text
+        })
+    }
+
+    /// Ссылаются ли снимки на одни и те же данные
+    pub fn ptr_eq(&self, other: &Self) -> bool {
+        Arc::ptr_eq(&self.inner, &other.inner)
+    }
+}
+
+impl From<EbpfMetrics> for EbpfSnapshot {
+    fn from(metrics: EbpfMetrics) -> Self {
+        Self::new(metrics)
+    }
+}
+
+impl Deref for EbpfSnapshot {
+    type Target = EbpfMetrics;
+
+    fn deref(&self) -> &EbpfMetrics {
+        &self.inner.metrics
+    }
+}
+
+impl Default for EbpfSnapshot {
+    fn default() -> Self {
+        Self::new(EbpfMetrics::default())
+    }
+}
+
+impl PartialEq for EbpfSnapshot {
+    fn eq(&self, other: &Self) -> bool {
+        self.ptr_eq(other) || self.inner.metrics == other.inner.metrics
+    }
+}
+
+impl fmt::Debug for EbpfSnapshot {
+    fn fmt(&self, f: &mut fmt::Formatter<'_>) -> fmt::Result {
+        f.debug_struct("EbpfSnapshot")
+            .field("generation", &self.inner.generation)
+            .field("metrics", &self.inner.metrics)
+            .finish()
+    }
+}
+
+impl Serialize for EbpfSnapshot {
+    fn serialize<S: Serializer>(&self, serializer: S) -> Result<S::Ok, S::Error> {
+        self.inner.metrics.serialize(serializer)
+    }
+}
+
+impl<'de> Deserialize<'de> for EbpfSnapshot {
+    fn deserialize<D: Deserializer<'de>>(deserializer: D) -> Result<Self, D::Error> {
+        EbpfMetrics::deserialize(deserializer).map(EbpfSnapshot::new)
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+    use crate::metrics::ebpf::ProcessEnergyStat;
+    use crate::metrics::ebpf_latency::SyscallLatencyStat;
+
+    fn metrics_with_latency() -> EbpfMetrics {
+        EbpfMetrics {
+            syscall_latency_details: Some(vec![SyscallLatencyStat {
+                tgid: Some(42),
+                ..Default::default()
+            }]),
+            ..Default::default()
+        }
+    }
+
+    fn metrics_with_energy(tgid: u32) -> EbpfMetrics {
+        EbpfMetrics {
+            process_energy_details: Some(vec![ProcessEnergyStat {
+                pid: tgid,
+                tgid,
+                energy_uj: 1_000,
+                last_update_ns: 1,
+                cpu_id: 0,
+                name: "app".to_string(),
+                energy_w: 0.5,
+            }]),
+            ..Default::default()
+        }
+    }
+
+    #[test]
+    fn test_clone_shares_data() {
+        let snapshot = EbpfSnapshot::new(metrics_with_latency());
+        let reader = snapshot.clone();
+
+        assert!(snapshot.ptr_eq(&reader));
+        assert_eq!(snapshot.generation(), reader.generation());
+        assert!(std::ptr::eq(snapshot.metrics(), reader.metrics()));
+    }
+
+    #[test]
+    fn test_generations_are_distinct() {
+        let first = EbpfSnapshot::new(EbpfMetrics::default());
+        let second = EbpfSnapshot::new(EbpfMetrics::default());
+
+        assert_ne!(first.generation(), second.generation());
+        assert!(!first.ptr_eq(&second));
+        // Сравнение идёт по метрикам, а не по поколению
+        assert_eq!(first, second);
+    }
+
+    #[test]
+    fn test_section_json_is_cached_per_generation() {
+        let snapshot = EbpfSnapshot::new(metrics_with_energy(42));
+
+        let first = snapshot
+            .section_json(EbpfSnapshotSection::ProcessEnergy)
+            .expect("секция энергии присутствует");
+        let second = snapshot
+            .clone()
+            .section_json(EbpfSnapshotSection::ProcessEnergy)
+            .map(|value| value as *const RawValue);
+
+        let parsed: serde_json::Value = serde_json::from_str(first.get()).unwrap();
+        assert_eq!(parsed[0]["tgid"], 42);
+        assert_eq!(second, Some(first as *const RawValue));
+        assert!(snapshot
+            .section_json(EbpfSnapshotSection::ProcessGpu)
+            .is_none());
+    }
+
+    #[test]
+    fn test_section_json_is_spliced_verbatim() {
+        #[derive(Serialize)]
+        struct Response<'a> {
+            status: &'static str,
+            process_energy: Option<&'a RawValue>,
+        }
+
+        let snapshot = EbpfSnapshot::new(metrics_with_energy(7));
+        let section = snapshot.section_json(EbpfSnapshotSection::ProcessEnergy);
+        let body = serde_json::to_string(&Response {
+            status: "ok",
+            process_energy: section,
+        })
+        .unwrap();
+
+        assert_eq!(
+            body,
+            format!(
+                r#"{{"status":"ok","process_energy":{}}}"#,
+                section.unwrap().get()
+            )
+        );
+    }
+
+    #[test]
+    fn test_prometheus_text_is_cached() {
+        let snapshot = EbpfSnapshot::new(metrics_with_latency());
+        let text = snapshot.prometheus_text();
+
+        assert_eq!(
+            text,
+            crate::metrics::ebpf_latency::syscall_latency_to_prometheus(
+                snapshot.syscall_latency_details.as_deref().unwrap()
+            )
+        );
+        assert!(std::ptr::eq(text, snapshot.prometheus_text()));
+        assert!(EbpfSnapshot::default().prometheus_text().is_empty());
+    }
+
+    #[test]
+    fn test_serializes_as_metrics() {
+        let metrics = metrics_with_latency();
+        let snapshot = EbpfSnapshot::new(metrics.clone());
+
+        let json = serde_json::to_value(&snapshot).unwrap();
+        assert_eq!(json, serde_json::to_value(&metrics).unwrap());
+
+        let restored: EbpfSnapshot = serde_json::from_value(json).unwrap();
+        assert_eq!(restored, snapshot);
+        assert_ne!(restored.generation(), snapshot.generation());
+    }
+}
@@ -0,0 +1,163 @@
+//! Общая программа системных вызовов.
+//!
+//! `syscall_monitor.c` — единственная программа, подключённая к входу и
+//! выходу из системных вызовов (`tp_btf/sys_enter` и `tp_btf/sys_exit`, на
+//! ядрах без BTF — вариант `syscall_monitor_raw_tp` на `raw_tp`). Она ведёт
+//! общий счётчик, гистограммы задержек (см. [`super::ebpf_latency`]), счётчики
+//! по процессам и время ожидания futex, которые читают коллекторы системных
+//! вызовов, процессов и производительности приложений.
+//!
+//! Номера вызовов с дополнительным учётом помечаются из userspace флагами
+//! `SYSCALL_TRACK_*` в `syscall_app_filter_map`. Копии счётчиков процессов
+//! по CPU сливаются здесь.
+
+use std::collections::HashMap;
+
+/// Имя программы для ядер с BTF точками трассировки.
+pub const SYSCALL_PROGRAM: &str = "syscall_monitor";
+
+/// Имя варианта программы на `raw_tp`.
+pub const SYSCALL_RAW_TP_PROGRAM: &str = "syscall_monitor_raw_tp";
+
+/// Общий per-CPU счётчик системных вызовов.
+pub const TOTAL_SYSCALL_COUNT_MAP: &str = "total_syscall_count_map";
+
+/// Per-CPU счётчики по TGID.
+pub const SYSCALL_PROCESS_MAP: &str = "syscall_process_map";
+
+/// Вести гистограммы задержек по процессам для номера вызова.
+pub const SYSCALL_TRACK_APP_LATENCY: u32 = 1;
+
+/// Учитывать время ожидания блокировок (номер futex).
+pub const SYSCALL_TRACK_LOCK_WAIT: u32 = 2;
+
+/// Флаги номеров системных вызовов для `syscall_app_filter_map`.
+///
+/// Номера вне `0..max_syscalls` пропускаются. Результат упорядочен по номеру.
+pub fn tracking_flags(
+    app_latency_syscalls: &[u32],
+    lock_wait_syscall: Option<u32>,
+    max_syscalls: u32,
+) -> Vec<(u32, u32)> {
+    let mut flags: HashMap<u32, u32> = HashMap::new();
+    for &syscall_id in app_latency_syscalls {
+        *flags.entry(syscall_id).or_default() |= SYSCALL_TRACK_APP_LATENCY;
+    }
+    if let Some(syscall_id) = lock_wait_syscall {
+        *flags.entry(syscall_id).or_default() |= SYSCALL_TRACK_LOCK_WAIT;
+    }
+
+    let mut flags: Vec<(u32, u32)> = flags
+        .into_iter()
+        .filter(|(syscall_id, _)| *syscall_id < max_syscalls)
+        .collect();
+    flags.sort_unstable();
+    flags
+}
+
+/// Счётчики процесса в раскладке ядра (`struct syscall_process_stats`).
+#[repr(C)]
+#[derive(Debug, Clone, Copy, Default, PartialEq, Eq)]
+pub struct RawSyscallProcessStats {
+    /// Системные вызовы с учётом веса выборки
+    pub syscalls: u64,
+    /// Время ожидания futex (учитывается без выборки)
+    pub lock_wait_ns: u64,
+    pub last_syscall_ns: u64,
+    pub comm: [u8; 16],
+}
+
+impl RawSyscallProcessStats {
+    /// Слить копии всех CPU: счётчики суммируются, время берётся наибольшее,
+    /// имя — из первой заполненной копии.
+    pub fn merge_per_cpu(per_cpu: &[Self]) -> Self {
+        let mut merged = Self::default();
+        for copy in per_cpu {
+            merged.syscalls = merged.syscalls.saturating_add(copy.syscalls);
+            merged.lock_wait_ns = merged.lock_wait_ns.saturating_add(copy.lock_wait_ns);
+            merged.last_syscall_ns = merged.last_syscall_ns.max(copy.last_syscall_ns);
+            if merged.comm[0] == 0 {
+                merged.comm = copy.comm;
+            }
+        }
+        merged
+    }
+
+    pub fn name(&self) -> String {
+        super::ebpf_sched::comm_to_string(&self.comm)
+    }
+}
+
+/// Свернуть записи `syscall_process_map` в таблицу по TGID.
+pub fn reduce_process_stats(
+    entries: &[(u32, Vec<RawSyscallProcessStats>)],
+) -> HashMap<u32, RawSyscallProcessStats> {
+    entries
+        .iter()
+        .map(|(tgid, per_cpu)| (*tgid, RawSyscallProcessStats::merge_per_cpu(per_cpu)))
+        .collect()
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    fn stats(syscalls: u64, lock_wait_ns: u64, last: u64, comm: &str) -> RawSyscallProcessStats {
+        let mut raw = RawSyscallProcessStats {
+            syscalls,
+            lock_wait_ns,
+            last_syscall_ns: last,
+            ..Default::default()
+        };
+        raw.comm[..comm.len()].copy_from_slice(comm.as_bytes());
+        raw
+    }
+
+    #[test]
+    fn test_layout_matches_kernel() {
+        assert_eq!(std::mem::size_of::<RawSyscallProcessStats>(), 40);
+    }
+
+    #[test]
+    fn test_tracking_flags() {
+        let flags = tracking_flags(&[202, 0, 426, 900], Some(202), 512);
+        assert_eq!(
+            flags,
+            vec![
+                (0, SYSCALL_TRACK_APP_LATENCY),
+                (202, SYSCALL_TRACK_APP_LATENCY | SYSCALL_TRACK_LOCK_WAIT),
+                (426, SYSCALL_TRACK_APP_LATENCY),
+            ]
+        );
+
+        // Ожидание блокировок учитывается и без гистограмм по процессам
+        assert_eq!(
+            tracking_flags(&[], Some(98), 512),
+            vec![(98, SYSCALL_TRACK_LOCK_WAIT)]
+        );
+        assert!(tracking_flags(&[], None, 512).is_empty());
+    }
+
+    #[test]
+    fn test_reduce_process_stats_merges_cpus() {
+        let entries = vec![
+            (
+                100,
+                vec![
+                    stats(0, 0, 0, ""),
+                    stats(10, 500, 70, "firefox"),
+                    stats(5, 250, 90, "firefox"),
+                ],
+            ),
+            (200, vec![stats(1, 0, 10, "bash")]),
+        ];
+
+        let table = reduce_process_stats(&entries);
+        assert_eq!(table.len(), 2);
+        assert_eq!(table[&100].syscalls, 15);
+        assert_eq!(table[&100].lock_wait_ns, 750);
+        assert_eq!(table[&100].last_syscall_ns, 90);
+        assert_eq!(table[&100].name(), "firefox");
+        assert_eq!(table[&200].name(), "bash");
+    }
+}
@@ -0,0 +1,256 @@
+//! Состояние процессов eBPF программ в task-local storage.
+//!
+//! Программы `process_monitor`, `process_gpu`, `process_disk` и
+//! `application_performance` хранят запись процесса в карте
+//! `BPF_MAP_TYPE_TASK_STORAGE` (Linux 5.11+), привязанной к лидеру группы
+//! потоков (см. `smoothtask_task_state.h`). Доступ к записи не требует
+//! хеширования, число процессов не ограничено `max_entries`, а запись
+//! освобождается ядром вместе с задачей.
+//!
+//! Карта task storage не поддерживает обход ключей, поэтому каждая программа
+//! содержит итератор `iter/task`, который выдаёт записи процессов подряд в
+//! раскладке ядра; здесь они разбираются обратно в структуры.
+//!
+//! Для старых ядер каждая программа собрана ещё и в вариант `<имя>_legacy`,
+//! в котором те же записи лежат в HASH карте с ключом TGID. Коллектор
+//! загружает его, если основной объект не прошёл загрузку, и читает карту
+//! обычным обходом.
+//!
+//! Раскладки записей определены в общем заголовке `smoothtask_bpf.h`, который
+//! фиксирует их размеры статическими проверками; здесь лежат их зеркала.
+//! Записи содержат только поля, которые заполняет ядро, и помещаются в одну
+//! кэш-линию: время CPU, системные вызовы и время GPU коллектор берёт из карт
+//! общих программ.
+
+use serde::{Deserialize, Serialize};
+
+use super::ebpf_batch;
+
+/// Суффикс варианта программы с HASH картами вместо task storage.
+pub const LEGACY_SUFFIX: &str = "_legacy";
+
+/// Программы, хранящие состояние процессов в task storage.
+pub const TASK_STATE_PROGRAMS: &[&str] = &[
+    "application_performance",
+    "process_disk",
+    "process_gpu",
+    "process_monitor",
+];
+
+/// Итератор записей `process_map` (`process_monitor.c`).
+pub const PROCESS_INFO_ITER: &str = "dump_process_info";
+
+/// Итератор записей `process_gpu_map` (`process_gpu.c`).
+pub const PROCESS_GPU_ITER: &str = "dump_process_gpu";
+
+/// Итератор записей `process_disk_stats_map` (`process_disk.c`).
+pub const PROCESS_DISK_ITER: &str = "dump_process_disk";
+
+/// Итератор записей `application_performance_map` (`application_performance.c`).
+pub const APPLICATION_PERFORMANCE_ITER: &str = "dump_application_performance";
+
+/// Способ хранения состояния процессов в загруженном объекте.
+#[derive(Debug, Clone, Copy, PartialEq, Eq, Serialize, Deserialize)]
+#[serde(rename_all = "snake_case")]
+pub enum TaskStateBackend {
+    /// `BPF_MAP_TYPE_TASK_STORAGE`, записи читаются итератором
+    TaskStorage,
+    /// HASH карта с ключом TGID (legacy вариант программы)
+    Hash,
+}
+
+impl TaskStateBackend {
+    /// Определить способ хранения по имени загруженной программы.
+    pub fn of_program(program: &str) -> Self {
+        if program.ends_with(LEGACY_SUFFIX) {
+            Self::Hash
+        } else {
+            Self::TaskStorage
+        }
+    }
+}
+
+/// Проверить, хранит ли программа состояние процессов в task storage.
+pub fn is_task_state_program(program: &str) -> bool {
+    TASK_STATE_PROGRAMS.contains(&program)
+}
+
+/// Имя legacy варианта программы.
+pub fn legacy_program_name(program: &str) -> String {
+    format!("{}{}", program, LEGACY_SUFFIX)
+}
+
+/// Разобрать вывод итератора: записи `T` подряд, без разделителей.
+///
+/// Неполная запись в конце (например, при обрыве чтения) отбрасывается.
+pub fn decode_records<T: Default + Copy>(bytes: &[u8]) -> Vec<T> {
+    let size = std::mem::size_of::<T>();
+    let mut records = Vec::new();
+    if size == 0 {
+        return records;
+    }
+
+    ebpf_batch::decode_values(bytes, bytes.len() / size, size, size, &mut records);
+    records
+}
+
+/// Запись `process_map` в раскладке ядра (`struct process_info`).
+#[repr(C)]
+#[derive(Debug, Clone, Copy, Default, PartialEq, Eq)]
+pub struct RawProcessInfo {
+    pub start_time: u64,
+    pub last_activity: u64,
+    pub tgid: u32,
+    pub ppid: u32,
+    pub comm: [u8; 16],
+}
+
+/// Запись `process_gpu_map` в раскладке ядра (`struct process_gpu_stats`).
+#[repr(C)]
+#[derive(Debug, Clone, Copy, Default, PartialEq, Eq)]
+pub struct RawProcessGpuStats {
+    pub memory_usage_bytes: u64,
+    pub last_update_ns: u64,
+    pub tgid: u32,
+    pub _pad: u32,
+}
+
+/// Запись `process_disk_stats_map` в раскладке ядра (`struct process_disk_stats`).
+#[repr(C)]
+#[derive(Debug, Clone, Copy, Default, PartialEq, Eq)]
+pub struct RawProcessDiskStats {
+    pub bytes_read: u64,
+    pub bytes_written: u64,
+    pub read_operations: u64,
+    pub write_operations: u64,
+    pub last_timestamp: u64,
+    pub tgid: u32,
+    pub _pad: u32,
+}
+
+/// Запись `application_performance_map` в раскладке ядра
+/// (`struct application_performance_stats`).
+///
+/// Содержит только счётчики событий программы `application_performance`:
+/// время выполнения, очереди выполнения и сна берётся из общей записи
+/// планировщика, системные вызовы и ожидание блокировок — из общей программы
+/// системных вызовов, выделения памяти ядра — из `kmem_allocations`.
+#[repr(C)]
+#[derive(Debug, Clone, Copy, Default, PartialEq, Eq)]
+pub struct RawApplicationPerformanceStats {
+    /// Page faults с учётом веса выборки
+    pub page_faults: u64,
+    pub interrupts: u64,
+    pub last_update_ns: u64,
+    pub tgid: u32,
+    pub _pad: u32,
+    pub comm: [u8; 16],
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    fn as_bytes<T: Copy>(records: &[T]) -> Vec<u8> {
+        let size = std::mem::size_of_val(records);
+        // SAFETY: записи — Copy-структуры с C-раскладкой, читаются как байты
+        unsafe { std::slice::from_raw_parts(records.as_ptr() as *const u8, size).to_vec() }
+    }
+
+    #[test]
+    fn test_layout_matches_kernel() {
+        assert_eq!(std::mem::size_of::<RawProcessInfo>(), 40);
+        assert_eq!(std::mem::size_of::<RawProcessGpuStats>(), 24);
+        assert_eq!(std::mem::size_of::<RawProcessDiskStats>(), 48);
+        assert_eq!(std::mem::size_of::<RawApplicationPerformanceStats>(), 48);
+        assert_eq!(std::mem::align_of::<RawProcessInfo>(), 8);
+    }
+
+    /// Размеры из `SMOOTHTASK_ASSERT_SIZE(имя, размер)` общего заголовка
+    fn declared_sizes(header: &str) -> Vec<(String, usize)> {
+        header
+            .lines()
+            .filter_map(|line| line.trim().strip_prefix("SMOOTHTASK_ASSERT_SIZE("))
+            .filter_map(|rest| {
+                let (name, size) = rest.split_once(',')?;
+                let size = size.trim().strip_suffix(");")?;
+                Some((name.trim().to_string(), size.parse().ok()?))
+            })
+            .collect()
+    }
+
+    #[test]
+    fn test_layouts_match_shared_header() {
+        use crate::metrics::ebpf_cgroup::{
+            RawCgroupDiskStats, RawCgroupGpuStats, RawCgroupPerformanceStats, RawCgroupSchedStats,
+        };
+        use crate::metrics::ebpf_net::RawNetTraffic;
+        use crate::metrics::ebpf_sched::RawSchedTaskStats;
+        use std::mem::size_of;
+
+        let mirrors = [
+            ("process_info", size_of::<RawProcessInfo>()),
+            ("process_gpu_stats", size_of::<RawProcessGpuStats>()),
+            ("process_disk_stats", size_of::<RawProcessDiskStats>()),
+            (
+                "application_performance_stats",
+                size_of::<RawApplicationPerformanceStats>(),
+            ),
+            ("sched_task_stats", size_of::<RawSchedTaskStats>()),
+            ("net_traffic", size_of::<RawNetTraffic>()),
+            ("disk_cgroup_stats", size_of::<RawCgroupDiskStats>()),
+            ("gpu_cgroup_stats", size_of::<RawCgroupGpuStats>()),
+            ("app_cgroup_stats", size_of::<RawCgroupPerformanceStats>()),
+            ("sched_cgroup_stats", size_of::<RawCgroupSchedStats>()),
+        ];
+
+        let declared = declared_sizes(include_str!("../ebpf_programs/smoothtask_bpf.h"));
+        assert_eq!(declared.len(), mirrors.len());
+        for (name, size) in &declared {
+            let mirror = mirrors.iter().find(|(mirror, _)| mirror == name);
+            assert_eq!(mirror.map(|(_, size)| *size), Some(*size), "{}", name);
+        }
+    }
+
+    #[test]
+    fn test_backend_and_legacy_names() {
+        assert!(is_task_state_program("process_gpu"));
+        assert!(!is_task_state_program("cpu_metrics"));
+        assert_eq!(legacy_program_name("process_gpu"), "process_gpu_legacy");
+        assert_eq!(
+            TaskStateBackend::of_program("process_gpu"),
+            TaskStateBackend::TaskStorage
+        );
+        assert_eq!(
+            TaskStateBackend::of_program(&legacy_program_name("process_gpu")),
+            TaskStateBackend::Hash
+        );
+    }
+
+    #[test]
+    fn test_decode_records() {
+        let records = [
+            RawProcessDiskStats {
+                bytes_read: 4096,
+                read_operations: 1,
+                tgid: 100,
+                ..Default::default()
+            },
+            RawProcessDiskStats {
+                bytes_written: 8192,
+                write_operations: 2,
+                tgid: 200,
+                ..Default::default()
+            },
+        ];
+        let mut bytes = as_bytes(&records);
+
+        assert_eq!(decode_records::<RawProcessDiskStats>(&bytes), records);
+
+        // Хвост неполной записи отбрасывается
+        bytes.extend_from_slice(&[0xff; 10]);
+        assert_eq!(decode_records::<RawProcessDiskStats>(&bytes), records);
+
+        assert!(decode_records::<RawProcessDiskStats>(&[]).is_empty());
+    }
+}
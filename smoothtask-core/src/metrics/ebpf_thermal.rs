@@ -0,0 +1,187 @@
+//! Температура термальных зон из eBPF.
+//!
+//! `cpu_temperature.c` обновляет запись зоны в `thermal_zone_map` в точке
+//! трассировки `thermal_temperature`, то есть с частотой опроса самой зоны, и
+//! не подключается к чтениям датчика. Здесь выполняется то, что раньше делали
+//! обработчики в ядре: выбор зон процессора по их типу, критические пороги из
+//! sysfs (`/sys/class/thermal/thermal_zoneN/trip_point_*`) и свёртка по зонам.
+
+use std::collections::HashMap;
+use std::fs;
+use std::path::Path;
+
+/// Имя карты состояний термальных зон.
+pub const THERMAL_ZONE_MAP: &str = "thermal_zone_map";
+
+/// Каталог термальных зон в sysfs.
+pub const THERMAL_SYSFS_ROOT: &str = "/sys/class/thermal";
+
+/// Состояние зоны в раскладке ядра (`struct thermal_zone_state`).
+#[repr(C)]
+#[derive(Debug, Clone, Copy, Default, PartialEq, Eq)]
+pub struct RawThermalZoneState {
+    /// Номер зоны (`thermal_zoneN`)
+    pub id: i32,
+    /// Последняя температура в миллиградусах
+    pub temperature_mc: i32,
+    /// Наибольшая температура с загрузки программы в миллиградусах
+    pub max_temperature_mc: i32,
+    pub pad: u32,
+    pub updates: u64,
+    pub last_update_ns: u64,
+    pub zone_type: [u8; 20],
+    pub pad2: u32,
+}
+
+impl RawThermalZoneState {
+    /// Тип зоны (`x86_pkg_temp`, `cpu-thermal`, ...).
+    pub fn zone_type(&self) -> String {
+        super::ebpf_sched::comm_to_string(&self.zone_type)
+    }
+}
+
+/// Относится ли зона к процессору по её типу.
+///
+/// `acpitz` сюда не входит: на многих платформах это датчик корпуса.
+pub fn is_cpu_zone(zone_type: &str) -> bool {
+    let zone_type = zone_type.to_ascii_lowercase();
+    zone_type.contains("cpu") || zone_type.contains("x86_pkg") || zone_type.contains("soc")
+}
+
+/// Критическая температура зон в миллиградусах по номеру зоны.
+///
+/// Пороги не меняются во время работы, поэтому читаются один раз при загрузке
+/// программы. Для зоны без точки `critical` берётся точка `hot`.
+pub fn read_critical_trips(root: &Path) -> HashMap<i32, i32> {
+    let Ok(entries) = fs::read_dir(root) else {
+        return HashMap::new();
+    };
+
+    entries
+        .flatten()
+        .filter_map(|entry| {
+            let name = entry.file_name().into_string().ok()?;
+            let id = name.strip_prefix("thermal_zone")?.parse::<i32>().ok()?;
+            let zone = entry.path();
+
+            let mut critical = None;
+            let mut hot = None;
+            for trip in 0.. {
+                let Ok(kind) = fs::read_to_string(zone.join(format!("trip_point_{}_type", trip)))
+                else {
+                    break;
+                };
+                let temperature =
+                    fs::read_to_string(zone.join(format!("trip_point_{}_temp", trip)))
+                        .ok()
+                        .and_then(|value| value.trim().parse::<i32>().ok());
+                match kind.trim() {
+                    "critical" => critical = critical.or(temperature),
+                    "hot" => hot = hot.or(temperature),
+                    _ => {}
+                }
+            }
+
+            critical.or(hot).map(|temperature| (id, temperature))
+        })
+        .collect()
+}
+
+/// Градусы Цельсия из миллиградусов; отрицательные значения дают 0.
+pub fn millicelsius_to_celsius(value: i32) -> u32 {
+    (value.max(0) / 1000) as u32
+}
+
+/// Средняя и наибольшая текущая температура зон процессора.
+///
+/// Если ни одна зона не опознана как зона процессора, берутся все зоны.
+pub fn summarize_cpu_zones(zones: &[RawThermalZoneState]) -> Option<(u32, u32)> {
+    let cpu_zones: Vec<&RawThermalZoneState> = zones
+        .iter()
+        .filter(|zone| is_cpu_zone(&zone.zone_type()))
+        .collect();
+    let selected: Vec<&RawThermalZoneState> = if cpu_zones.is_empty() {
+        zones.iter().collect()
+    } else {
+        cpu_zones
+    };
+    if selected.is_empty() {
+        return None;
+    }
+
+    let total: i64 = selected.iter().map(|zone| zone.temperature_mc as i64).sum();
+    let average = (total / selected.len() as i64).clamp(0, i32::MAX as i64) as i32;
+    let hottest = selected
+        .iter()
+        .map(|zone| zone.temperature_mc)
+        .max()
+        .unwrap_or(0);
+
+    Some((
+        millicelsius_to_celsius(average),
+        millicelsius_to_celsius(hottest),
+    ))
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    fn zone(id: i32, zone_type: &str, temperature_mc: i32) -> RawThermalZoneState {
+        let mut raw = RawThermalZoneState {
+            id,
+            temperature_mc,
+            max_temperature_mc: temperature_mc,
+            ..Default::default()
+        };
+        raw.zone_type[..zone_type.len()].copy_from_slice(zone_type.as_bytes());
+        raw
+    }
+
+    #[test]
+    fn test_layout_matches_kernel() {
+        assert_eq!(std::mem::size_of::<RawThermalZoneState>(), 56);
+    }
+
+    #[test]
+    fn test_summarize_prefers_cpu_zones() {
+        let zones = [
+            zone(0, "acpitz", 30_000),
+            zone(1, "x86_pkg_temp", 62_000),
+            zone(2, "cpu-thermal", 70_500),
+        ];
+        assert_eq!(zones[1].zone_type(), "x86_pkg_temp");
+        assert_eq!(summarize_cpu_zones(&zones), Some((66, 70)));
+
+        // Без зон процессора берутся все зоны
+        assert_eq!(summarize_cpu_zones(&zones[..1]), Some((30, 30)));
+        assert_eq!(summarize_cpu_zones(&[]), None);
+        assert_eq!(millicelsius_to_celsius(-5_000), 0);
+    }
+
+    #[test]
+    fn test_read_critical_trips() {
+        let root = tempfile::tempdir().unwrap();
+        for (zone_name, trips) in [
+            (
+                "thermal_zone0",
+                &[("passive", "85000"), ("critical", "105000")][..],
+            ),
+            ("thermal_zone3", &[("hot", "95000")][..]),
+            ("thermal_zone4", &[("active", "60000")][..]),
+            ("cooling_device0", &[("critical", "1")][..]),
+        ] {
+            let zone = root.path().join(zone_name);
+            fs::create_dir(&zone).unwrap();
+            for (index, (kind, temperature)) in trips.iter().enumerate() {
+                fs::write(zone.join(format!("trip_point_{}_type", index)), kind).unwrap();
+                fs::write(zone.join(format!("trip_point_{}_temp", index)), temperature).unwrap();
+            }
+        }
+
+        let trips = read_critical_trips(root.path());
+        assert_eq!(trips.len(), 2);
+        assert_eq!(trips[&0], 105_000);
+        assert_eq!(trips[&3], 95_000);
+    }
+}
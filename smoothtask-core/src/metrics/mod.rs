@@ -16,6 +16,7 @@
 //! - **system**: Глобальные метрики системы из /proc и PSI
 //! - **process**: Метрики отдельных процессов
 //! - **process_energy**: Мониторинг энергопотребления процессов
+//! - **task_snapshot**: Снимок всех задач одним проходом итератора iter/task вместо обхода /proc
 //! - **windows**: Интроспекция окон через X11/Wayland
 //! - **audio**: Метрики аудио-системы (PipeWire/PulseAudio)
 //! - **input**: Отслеживание активности пользователя
@@ -24,6 +25,32 @@
 //! - **amdgpu_wrapper**: Расширенный мониторинг AMD GPU через AMDGPU
 //! - **gpu**: Мониторинг GPU устройств и их метрик
 //! - **ebpf**: Высокопроизводительный сбор метрик через eBPF
+//! - **ebpf_batch**: Пакетное чтение eBPF карт через BPF_MAP_LOOKUP_BATCH
+//! - **ebpf_cgroup**: Per-CPU итоги eBPF программ по cgroup v2 приложений и распределение энергии между cgroup
+//! - **ebpf_counters**: Свёртка per-CPU счётчиков глобальных итогов eBPF программ
+//! - **ebpf_demand**: Подписки потребителей на группы eBPF метрик и прикрепление программ только по запросу
+//! - **ebpf_disk**: Задержки блочного ввода-вывода по процессам и глубина очереди устройств
+//! - **ebpf_energy**: Распределение энергии RAPL между процессами по времени на CPU
+//! - **ebpf_epoch**: Сводки счётчиков по эпохам, собранные в ядре по bpf_timer
+//! - **ebpf_events**: Потоковая доставка событий жизненного цикла из eBPF через кольцевой буфер
+//! - **ebpf_filesystem**: Операции с файлами по процессам и файлам с выбором самых нагруженных
+//! - **ebpf_filter**: Фильтрация событий eBPF в ядре по процессу, cgroup и системному вызову
+//! - **ebpf_gpu**: Время занятости колец GPU и процессов по заданиям планировщика DRM
+//! - **ebpf_latency**: Log2 гистограммы задержек системных вызовов и оценка перцентилей
+//! - **ebpf_memory**: Учёт памяти процессов eBPF программой с записью только при заметном изменении RSS
+//! - **ebpf_memory_pressure**: Задержки из-за нехватки памяти (major page fault, swap-in, reclaim) по процессам и cgroup
+//! - **ebpf_net**: Учёт реального сетевого трафика процессов и сокетов по данным eBPF
+//! - **ebpf_objects**: Встроенные CO-RE объекты eBPF программ, скомпилированные при сборке
+//! - **ebpf_overhead**: Стоимость загруженных eBPF программ, заполнение карт и отладочные счётчики ядра
+//! - **ebpf_profiler**: Профилирование стеков по запросу на CPU и вне CPU с агрегацией в карте стеков eBPF
+//! - **ebpf_ringbuf**: Общий поток-потребитель кольцевых буферов eBPF с обработкой событий пачками
+//! - **ebpf_runqueue**: Быстрый путь реакции на задержки в очереди выполнения через кольцевой буфер eBPF
+//! - **ebpf_sampling**: Адаптивная выборка высокочастотных событий eBPF по измеренной стоимости программ
+//! - **ebpf_sched**: Общая запись планировщика (sched_switch) для коллекторов приложений, энергии и памяти
+//! - **ebpf_snapshot**: Разделяемые без копирования снимки eBPF метрик с кэшем сериализации по поколениям
+//! - **ebpf_syscall**: Общая программа системных вызовов: счётчики по процессам и ожидание futex
+//! - **ebpf_task_state**: Состояние процессов eBPF программ в task-local storage и его выгрузка итераторами
+//! - **ebpf_thermal**: Температура термальных зон из eBPF, пороги из sysfs и свёртка по зонам процессора
 //! - **filesystem_monitor**: Мониторинг файловой системы в реальном времени
 //! - **storage**: Обнаружение и мониторинг SATA устройств
 //! - **extended_hardware_sensors**: Расширенный мониторинг аппаратных сенсоров
@@ -46,6 +73,32 @@ pub mod cache_monitor;
 pub mod container;
 pub mod custom;
 pub mod ebpf;
+pub mod ebpf_batch;
+pub mod ebpf_cgroup;
+pub mod ebpf_counters;
+pub mod ebpf_demand;
+pub mod ebpf_disk;
+pub mod ebpf_energy;
+pub mod ebpf_epoch;
+pub mod ebpf_events;
+pub mod ebpf_filesystem;
+pub mod ebpf_filter;
+pub mod ebpf_gpu;
+pub mod ebpf_latency;
+pub mod ebpf_memory;
+pub mod ebpf_memory_pressure;
+pub mod ebpf_net;
+pub mod ebpf_objects;
+pub mod ebpf_overhead;
+pub mod ebpf_profiler;
+pub mod ebpf_ringbuf;
+pub mod ebpf_runqueue;
+pub mod ebpf_sampling;
+pub mod ebpf_sched;
+pub mod ebpf_snapshot;
+pub mod ebpf_syscall;
+pub mod ebpf_task_state;
+pub mod ebpf_thermal;
 pub mod energy_monitoring;
 pub mod extended_hardware_sensors;
 pub mod filesystem_monitor;
@@ -65,6 +118,7 @@ pub mod process_network;
 pub mod prometheus_exporter;
 pub mod scheduling_latency;
 pub mod system;
+pub mod task_snapshot;
 pub mod thunderbolt_monitor;
 pub mod vm;
 pub mod windows;
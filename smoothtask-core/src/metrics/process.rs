@@ -5,6 +5,7 @@
 
 use crate::actuator::read_ionice;
 use crate::logging::snapshots::{ProcessMemoryUsage, ProcessPerformanceMetrics, ProcessRecord, ProcessResourceUtilization};
+use crate::metrics::task_snapshot::{read_task_snapshot, TaskSnapshot};
 use anyhow::{Context, Result};
 use lazy_static::lazy_static;
 use lru::LruCache;
@@ -46,6 +47,9 @@ pub struct ProcessCacheConfig {
     pub enable_priority_caching: bool,
     /// Коэффициент приоритета для важных процессов (умножается на базовый TTL).
     pub priority_cache_multiplier: f64,
+    /// Перечислять процессы и обновлять их динамические поля по снимку
+    /// eBPF итератора `iter/task` вместо обхода /proc (если он доступен).
+    pub use_task_snapshot: bool,
 }
 
 impl Default for ProcessCacheConfig {
@@ -64,6 +68,7 @@ impl Default for ProcessCacheConfig {
             max_cache_ttl_seconds: 15,
             enable_priority_caching: true,
             priority_cache_multiplier: 2.0,
+            use_task_snapshot: true,
         }
     }
 }
@@ -721,6 +726,14 @@ pub fn collect_process_metrics(config: Option<ProcessCacheConfig>) -> Result<Vec
         cache_write.update_config(cfg);
     }
 
+    // Быстрый путь: список процессов и их динамические поля из снимка iter/task
+    let use_task_snapshot = PROCESS_CACHE.read().unwrap().config.use_task_snapshot;
+    if use_task_snapshot {
+        if let Some(snapshot) = read_task_snapshot() {
+            return Ok(collect_from_task_snapshot(snapshot));
+        }
+    }
+
     let all_procs = procfs::process::all_processes()
         .context("Не удалось получить список процессов из /proc: проверьте права доступа и доступность /proc. Попробуйте: ls -la /proc | sudo ls /proc. Для устранения: 1) Проверьте права: id && groups, 2) Проверьте монтирование: mount | grep proc, 3) Попробуйте запустить с sudo, 4) Проверьте SELinux: getenforce, 5) Проверьте AppArmor: aa-status")?;
 
@@ -931,6 +944,131 @@ pub fn collect_process_metrics(config: Option<ProcessCacheConfig>) -> Result<Vec
     Ok(processes)
 }
 
+/// Параметры пересчёта единиц снимка задач, общие для цикла сбора.
+struct TaskSnapshotContext {
+    ticks_per_second: u64,
+    page_size: u64,
+    boot_time_secs: Option<u64>,
+    now_secs: u64,
+}
+
+impl TaskSnapshotContext {
+    fn current() -> Self {
+        Self {
+            ticks_per_second: procfs::ticks_per_second().max(1),
+            page_size: procfs::page_size(),
+            boot_time_secs: procfs::boot_time_secs().ok(),
+            now_secs: SystemTime::now()
+                .duration_since(std::time::UNIX_EPOCH)
+                .unwrap_or_default()
+                .as_secs(),
+        }
+    }
+}
+
+/// Собрать метрики процессов по снимку задач `iter/task`.
+///
+/// Процессы перечисляются по снимку, а не по /proc. Для записей из кэша
+/// динамические поля обновляются из снимка без обращения к /proc; /proc
+/// читается целиком только для новых процессов и записей с истёкшим TTL.
+fn collect_from_task_snapshot(snapshot: HashMap<i32, TaskSnapshot>) -> Vec<ProcessRecord> {
+    let cache_config = PROCESS_CACHE.read().unwrap().config.clone();
+    let context = TaskSnapshotContext::current();
+    let total_process_count = snapshot.len();
+    tracing::info!(
+        "Начало сбора метрик процессов по снимку iter/task. Найдено {} процессов",
+        total_process_count
+    );
+
+    let collect = |(pid, task): (i32, TaskSnapshot)| -> Option<ProcessRecord> {
+        if cache_config.enable_caching {
+            let cached = PROCESS_CACHE.read().unwrap().get_cached(pid);
+            // Запись с другим временем запуска принадлежит завершившемуся
+            // процессу, PID которого уже переиспользован
+            let start_time = task.start_time_ticks(context.ticks_per_second);
+            if let Some(mut record) = cached.filter(|record| record.start_time == start_time) {
+                CACHE_STATS.write().unwrap().record_request(true, None);
+                apply_task_snapshot(&mut record, &task, &context);
+                return Some(record);
+            }
+            CACHE_STATS.write().unwrap().record_request(false, None);
+        }
+
+        let proc = match Process::new(pid) {
+            Ok(proc) => proc,
+            Err(ProcError::NotFound(_)) => return None, // процесс завершился
+            Err(e) => {
+                tracing::warn!("Ошибка доступа к /proc/{}: {}", pid, e);
+                return None;
+            }
+        };
+
+        match collect_single_process(&proc) {
+            Ok(Some(record)) => {
+                if cache_config.enable_caching {
+                    let mut cache_write = PROCESS_CACHE.write().unwrap();
+                    cache_write.cache_record(record.clone());
+                }
+                Some(record)
+            }
+            Ok(None) => None,
+            Err(e) => {
+                tracing::warn!("Ошибка сбора метрик для процесса PID {}: {}", pid, e);
+                None
+            }
+        }
+    };
+
+    let processes: Vec<ProcessRecord> = if cache_config.enable_parallel_processing {
+        snapshot.into_par_iter().filter_map(&collect).collect()
+    } else {
+        snapshot.into_iter().filter_map(&collect).collect()
+    };
+
+    tracing::info!(
+        "Завершен сбор метрик процессов по снимку iter/task. Успешно собрано {} из {} процессов",
+        processes.len(),
+        total_process_count
+    );
+
+    processes
+}
+
+/// Обновить динамические поля записи процесса из снимка задач.
+///
+/// Статические поля (cmdline, exe, окружение, cgroup path, UID/GID) остаются
+/// из последнего полного чтения /proc.
+fn apply_task_snapshot(
+    record: &mut ProcessRecord,
+    task: &TaskSnapshot,
+    context: &TaskSnapshotContext,
+) {
+    record.ppid = task.ppid as i32;
+    record.state = task.state_name().to_string();
+    record.nice = task.nice;
+    record.voluntary_ctx = Some(task.voluntary_ctx);
+    record.involuntary_ctx = Some(task.involuntary_ctx);
+
+    // У потоков ядра нет VmRSS и VmSwap в /proc/[pid]/status
+    if !task.is_kernel_thread {
+        record.rss_mb = Some(task.rss_mb(context.page_size));
+        record.swap_mb = Some(task.swap_mb(context.page_size));
+    }
+
+    if let Some(boot_time) = context.boot_time_secs {
+        let start_time_secs = boot_time + record.start_time / context.ticks_per_second;
+        record.uptime_sec = context.now_secs.saturating_sub(start_time_secs);
+    }
+
+    let memory = record
+        .memory_usage_details
+        .get_or_insert_with(ProcessMemoryUsage::default);
+    memory.total_rss_bytes = task.rss_pages.saturating_mul(context.page_size);
+    memory.memory_pages = Some(task.rss_pages);
+    memory.major_page_faults = Some(task.maj_flt);
+    memory.minor_page_faults = Some(task.min_flt);
+}
+
 /// Собрать метрики энергопотребления для процесса.
 ///
 /// Использует новый модуль process_energy для сбора данных из различных источников:
@@ -2231,6 +2369,54 @@ Gid:    1000 1000 1000 1000
         assert_eq!(lang, Some("ru_RU.UTF-8".to_string()));
         assert_eq!(user, Some("Пользователь".to_string()));
     }
+
+    #[test]
+    fn test_apply_task_snapshot() {
+        let context = TaskSnapshotContext {
+            ticks_per_second: 100,
+            page_size: 4096,
+            boot_time_secs: Some(1_000),
+            now_secs: 2_000,
+        };
+        let task = TaskSnapshot {
+            tgid: 42,
+            ppid: 1,
+            nice: 5,
+            state: 0x0002,
+            rss_pages: 25_600,
+            swap_pages: 512,
+            min_flt: 300,
+            maj_flt: 7,
+            voluntary_ctx: 11,
+            involuntary_ctx: 3,
+            ..Default::default()
+        };
+        let mut record = ProcessRecord {
+            pid: 42,
+            cmdline: Some("bash -l".to_string()),
+            // Запущен через 500 секунд после загрузки
+            start_time: 50_000,
+            ..Default::default()
+        };
+
+        apply_task_snapshot(&mut record, &task, &context);
+
+        assert_eq!(record.ppid, 1);
+        assert_eq!(record.nice, 5);
+        assert_eq!(record.state, "Waiting");
+        assert_eq!(record.rss_mb, Some(100));
+        assert_eq!(record.swap_mb, Some(2));
+        assert_eq!(record.voluntary_ctx, Some(11));
+        assert_eq!(record.involuntary_ctx, Some(3));
+        assert_eq!(record.uptime_sec, 500);
+        // Статические поля не меняются
+        assert_eq!(record.cmdline.as_deref(), Some("bash -l"));
+
+        let memory = record.memory_usage_details.unwrap();
+        assert_eq!(memory.total_rss_bytes, 25_600 * 4096);
+        assert_eq!(memory.major_page_faults, Some(7));
+        assert_eq!(memory.minor_page_faults, Some(300));
+    }
 }
 
 /// Тесты для кэширования метрик процессов
@@ -2274,6 +2460,7 @@ mod cache_tests {
             max_cache_ttl_seconds: 10,
             enable_priority_caching: false,
             priority_cache_multiplier: 1.0,
+            use_task_snapshot: false,
         };
 
         let cache = ProcessCache::with_config(config.clone());
@@ -2381,6 +2568,7 @@ mod cache_tests {
                 max_cache_ttl_seconds: 10,
                 enable_priority_caching: false,
                 priority_cache_multiplier: 1.0,
+                use_task_snapshot: false,
             },
         };
 
@@ -2495,6 +2683,7 @@ mod cache_tests {
             max_cache_ttl_seconds: 10,
             enable_priority_caching: false,
             priority_cache_multiplier: 1.0,
+            use_task_snapshot: false,
         };
 
         cache.update_config(new_config.clone());
@@ -455,8 +455,12 @@ impl ProcessEnergyMonitor {
     }
 
     /// Получить кэшированные eBPF метрики с обработкой ошибок.
-    async fn get_cached_ebpf_metrics(&self) -> Result<Option<crate::metrics::ebpf::EbpfMetrics>> {
-        // Пробуем получить eBPF метрики через глобальный коллектор
+    async fn get_cached_ebpf_metrics(&self) -> Result<Option<crate::metrics::ebpf::EbpfSnapshot>> {
+        // Пробуем получить eBPF метрики через глобальный коллектор; время на CPU
+        // для распределения энергии считает общая программа планировщика
+        crate::metrics::system::request_ebpf_metric_groups(&[
+            crate::metrics::ebpf::EbpfMetricGroup::ProcessEnergy,
+        ]);
         let ebpf_metrics = crate::metrics::system::collect_ebpf_metrics();
 
         // Логируем информацию о доступности eBPF
@@ -17,6 +17,8 @@ use std::collections::HashMap;
 use std::time::{SystemTime, UNIX_EPOCH};
 
 use crate::logging::snapshots::ProcessRecord;
+use crate::metrics::ebpf_latency::{syscall_latency_to_prometheus, SyscallLatencyStat};
+use crate::metrics::ebpf_overhead::{overhead_to_prometheus, EbpfOverheadReport};
 use crate::metrics::extended_hardware_sensors::{
     ExtendedHardwareSensors, ExtendedHardwareSensorsMonitor,
 };
@@ -1011,6 +1013,40 @@ impl PrometheusExporter {
         Ok(output)
     }
 
+    /// Export eBPF syscall latency percentiles in Prometheus format (standalone)
+    pub fn export_syscall_latency_metrics_prometheus(
+        &self,
+        stats: &[SyscallLatencyStat],
+    ) -> Result<String> {
+        let mut output = String::new();
+
+        if self.config.include_help_text {
+            output.push_str("# HELP syscall_latency_metrics eBPF syscall latency histograms\n");
+            output.push_str("# TYPE syscall_latency_metrics gauge\n");
+        }
+
+        output.push_str(&syscall_latency_to_prometheus(stats));
+
+        Ok(output)
+    }
+
+    /// Export per-program eBPF overhead, map fill levels and kernel debug counters (standalone)
+    pub fn export_ebpf_overhead_metrics_prometheus(
+        &self,
+        report: &EbpfOverheadReport,
+    ) -> Result<String> {
+        let mut output = String::new();
+
+        if self.config.include_help_text {
+            output.push_str("# HELP ebpf_overhead_metrics eBPF program run time and map usage\n");
+            output.push_str("# TYPE ebpf_overhead_metrics gauge\n");
+        }
+
+        output.push_str(&overhead_to_prometheus(report));
+
+        Ok(output)
+    }
+
     /// Export extended hardware sensors metrics in Prometheus format
     pub fn export_extended_hardware_sensors_prometheus(
         &self,
@@ -1566,6 +1602,68 @@ mod tests {
         assert!(output.contains("eth0"));
     }
 
+    #[test]
+    fn test_syscall_latency_metrics_export() {
+        let exporter = PrometheusExporter::new();
+        let stats = vec![SyscallLatencyStat {
+            syscall_id: 202,
+            syscall_name: Some("futex".to_string()),
+            tgid: Some(1234),
+            count: 10,
+            total_time_ns: 50_000,
+            interval_count: 10,
+            avg_time_ns: 5_000,
+            p50_ns: 4_096,
+            p99_ns: 16_384,
+            buckets: Vec::new(),
+        }];
+
+        let result = exporter.export_syscall_latency_metrics_prometheus(&stats);
+        assert!(result.is_ok());
+
+        let output = result.unwrap();
+        assert!(output.contains(
+            "smoothtask_app_syscall_latency_p99_ns{syscall=\"futex\",syscall_id=\"202\",tgid=\"1234\"} 16384"
+        ));
+        assert!(output.contains("smoothtask_app_syscall_calls_total"));
+        assert!(!output.contains("smoothtask_syscall_latency_p50_ns"));
+    }
+
+    #[test]
+    fn test_ebpf_overhead_metrics_export() {
+        use crate::metrics::ebpf_overhead::{EbpfMapUsage, EbpfProgramOverhead};
+        use crate::metrics::ebpf_sampling::ProgramRuntimeStats;
+
+        let exporter = PrometheusExporter::new();
+        let report = EbpfOverheadReport {
+            run_time_stats_enabled: true,
+            programs: vec![EbpfProgramOverhead::new(
+                "application_performance",
+                "trace_kmalloc",
+                ProgramRuntimeStats {
+                    run_time_ns: 2_500,
+                    run_cnt: 10,
+                },
+            )],
+            maps: vec![EbpfMapUsage::new(
+                "application_performance",
+                "application_performance_map",
+                512,
+                1024,
+            )],
+            ..EbpfOverheadReport::default()
+        };
+
+        let output = exporter
+            .export_ebpf_overhead_metrics_prometheus(&report)
+            .unwrap();
+        assert!(output.contains(
+            "smoothtask_ebpf_program_avg_run_time_ns{object=\"application_performance\",program=\"trace_kmalloc\"} 250"
+        ));
+        assert!(output.contains("smoothtask_ebpf_map_fill_ratio{object=\"application_performance\",map=\"application_performance_map\"} 0.5000"));
+        assert!(!output.contains("smoothtask_ebpf_lookup_misses_total"));
+    }
+
     #[test]
     fn test_http_headers_export() {
         let exporter = PrometheusExporter::new();
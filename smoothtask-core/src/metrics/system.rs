@@ -1103,8 +1103,9 @@ pub struct SystemMetrics {
     pub disk: DiskMetrics,
     /// Метрики GPU (опционально, так как может быть недоступно на некоторых системах)
     pub gpu: Option<crate::metrics::gpu::GpuMetricsCollection>,
-    /// Метрики eBPF (опционально, так как требует поддержки eBPF в системе)
-    pub ebpf: Option<crate::metrics::ebpf::EbpfMetrics>,
+    /// Метрики eBPF (опционально, так как требует поддержки eBPF в системе);
+    /// снимок разделяется с коллектором и API без копирования
+    pub ebpf: Option<crate::metrics::ebpf::EbpfSnapshot>,
     /// Метрики системных вызовов
     pub system_calls: SystemCallMetrics,
     /// Метрики использования inode
@@ -4454,7 +4455,7 @@ lazy_static! {
         std::sync::Mutex::new(None);
 }
 
-pub fn collect_ebpf_metrics() -> Option<crate::metrics::ebpf::EbpfMetrics> {
+pub fn collect_ebpf_metrics() -> Option<crate::metrics::ebpf::EbpfSnapshot> {
     // Проверяем, включена ли поддержка eBPF
     if !crate::metrics::ebpf::EbpfMetricsCollector::is_ebpf_enabled() {
         tracing::debug!("eBPF support is disabled (compiled without 'ebpf' feature)");
@@ -4463,44 +4464,198 @@ pub fn collect_ebpf_metrics() -> Option<crate::metrics::ebpf::EbpfMetrics> {
 
     #[cfg(feature = "ebpf")]
     {
-        // Используем кэшированный коллектор для уменьшения накладных расходов
-        let mut collector_guard = EBPF_COLLECTOR.lock().unwrap();
-
-        if collector_guard.is_none() {
-            // Инициализируем коллектор при первом вызове
-            let config = crate::metrics::ebpf::EbpfConfig::default();
-            let mut collector = crate::metrics::ebpf::EbpfMetricsCollector::new(config);
-
-            if let Err(e) = collector.initialize() {
-                tracing::warn!("Failed to initialize eBPF metrics collector: {}", e);
-                return None;
+        // Собираем метрики с использованием кэшированного коллектора
+        with_ebpf_collector(|collector| match collector.collect_snapshot() {
+            Ok(snapshot) => {
+                tracing::debug!(
+                    "Successfully collected eBPF metrics (generation {})",
+                    snapshot.generation()
+                );
+                Some(snapshot)
+            }
+            Err(e) => {
+                tracing::warn!("Failed to collect eBPF metrics: {}", e);
+                None
             }
+        })
+        .flatten()
+    }
+
+    #[cfg(not(feature = "ebpf"))]
+    {
+        // Без eBPF поддержки возвращаем None
+        None
+    }
+}
 
-            *collector_guard = Some(collector);
+/// Выполнить действие над кэшированным eBPF коллектором
+///
+/// Коллектор инициализируется при первом обращении; при ошибке инициализации
+/// возвращается `None`, и попытка повторяется при следующем вызове.
+#[cfg(feature = "ebpf")]
+fn with_ebpf_collector<R>(
+    action: impl FnOnce(&mut crate::metrics::ebpf::EbpfMetricsCollector) -> R,
+) -> Option<R> {
+    // Используем кэшированный коллектор для уменьшения накладных расходов
+    let mut collector_guard = EBPF_COLLECTOR.lock().unwrap();
+
+    if collector_guard.is_none() {
+        // Инициализируем коллектор при первом вызове
+        let config = crate::metrics::ebpf::EbpfConfig::default();
+        let mut collector = crate::metrics::ebpf::EbpfMetricsCollector::new(config);
+
+        if let Err(e) = collector.initialize() {
+            tracing::warn!("Failed to initialize eBPF metrics collector: {}", e);
+            return None;
         }
 
-        // Собираем метрики с использованием кэшированного коллектора
-        if let Some(collector) = collector_guard.as_mut() {
-            match collector.collect_metrics() {
-                Ok(metrics) => {
-                    tracing::debug!("Successfully collected eBPF metrics: {:?}", metrics);
-                    return Some(metrics);
-                }
-                Err(e) => {
-                    tracing::warn!("Failed to collect eBPF metrics: {}", e);
-                    return None;
-                }
+        *collector_guard = Some(collector);
+    }
+
+    collector_guard.as_mut().map(action)
+}
+
+/// Запустить быстрый путь реакции на задержки в очереди выполнения
+///
+/// Поток событий работает поверх общей программы планировщика кэшированного
+/// eBPF коллектора, поэтому `sched_switch` не подключается повторно.
+pub fn start_ebpf_runqueue_fast_path(
+    settings: crate::metrics::ebpf::RunqueueLatencySettings,
+    handler: crate::metrics::ebpf::RunqueueLatencyHandler,
+) -> Result<()> {
+    #[cfg(feature = "ebpf")]
+    {
+        with_ebpf_collector(|collector| {
+            collector.start_runqueue_latency_fast_path(settings, handler)
+        })
+        .unwrap_or_else(|| Err(anyhow!("eBPF коллектор не инициализирован")))
+    }
+
+    #[cfg(not(feature = "ebpf"))]
+    {
+        let _ = (settings, handler);
+        Err(anyhow!(
+            "Быстрый путь задержек очереди выполнения требует поддержки eBPF"
+        ))
+    }
+}
+
+/// Синхронизировать набор процессов, отмеченных для быстрого пути
+///
+/// Возвращает количество отмеченных процессов (0, если быстрый путь не запущен).
+pub fn sync_ebpf_runqueue_targets(tgids: &std::collections::HashSet<u32>) -> Result<usize> {
+    #[cfg(feature = "ebpf")]
+    {
+        with_ebpf_collector(|collector| collector.sync_runqueue_latency_targets(tgids))
+            .unwrap_or(Ok(0))
+    }
+
+    #[cfg(not(feature = "ebpf"))]
+    {
+        let _ = tgids;
+        Ok(0)
+    }
+}
+
+/// Включить прикрепление eBPF программ по запросу потребителей
+///
+/// Программы кэшированного коллектора остаются загруженными, но прикреплены
+/// только для групп метрик, на которые подписаны или которые запрашивали
+/// потребители за последние `idle_timeout` (см. `metrics::ebpf_demand`).
+pub fn enable_ebpf_demand_driven_attachment(idle_timeout: std::time::Duration) {
+    #[cfg(feature = "ebpf")]
+    {
+        with_ebpf_collector(|collector| collector.enable_demand_driven_attachment(idle_timeout));
+    }
+
+    #[cfg(not(feature = "ebpf"))]
+    {
+        let _ = idle_timeout;
+    }
+}
+
+/// Подписать потребителя на группы eBPF метрик кэшированного коллектора
+pub fn subscribe_ebpf_metric_groups(
+    consumer: &str,
+    groups: &[crate::metrics::ebpf::EbpfMetricGroup],
+) {
+    #[cfg(feature = "ebpf")]
+    {
+        with_ebpf_collector(|collector| collector.subscribe_metric_groups(consumer, groups));
+    }
+
+    #[cfg(not(feature = "ebpf"))]
+    {
+        let _ = (consumer, groups);
+    }
+}
+
+/// Снять подписку потребителя на группы eBPF метрик
+pub fn unsubscribe_ebpf_metric_groups(consumer: &str) {
+    #[cfg(feature = "ebpf")]
+    {
+        with_ebpf_collector(|collector| collector.unsubscribe_metric_groups(consumer));
+    }
+
+    #[cfg(not(feature = "ebpf"))]
+    {
+        let _ = consumer;
+    }
+}
+
+/// Отметить группы eBPF метрик нужными сейчас
+///
+/// Вызывается потребителями, которые читают метрики эпизодически (обработчики
+/// API, экспорт Prometheus). Коллектор не создаётся ради запроса: до первого
+/// сбора метрик запрос игнорируется.
+pub fn request_ebpf_metric_groups(groups: &[crate::metrics::ebpf::EbpfMetricGroup]) {
+    #[cfg(feature = "ebpf")]
+    {
+        if let Ok(mut collector) = EBPF_COLLECTOR.lock() {
+            if let Some(collector) = collector.as_mut() {
+                collector.request_metric_groups(groups);
             }
         }
     }
 
     #[cfg(not(feature = "ebpf"))]
     {
-        // Без eBPF поддержки возвращаем None
-        None
+        let _ = groups;
     }
 }
 
+lazy_static! {
+    /// Профилировщик стеков: загружает собственный eBPF объект на время сессии
+    /// и не зависит от кэшированного коллектора
+    static ref EBPF_STACK_PROFILER: crate::metrics::ebpf_profiler::StackProfiler =
+        crate::metrics::ebpf_profiler::StackProfiler::new();
+}
+
+/// Запустить сессию профилирования стеков выбранных процессов
+///
+/// Сессия выполняется в фоне в течение `request.duration_secs`, после чего
+/// программы открепляются автоматически (см. `metrics::ebpf_profiler`).
+pub fn start_ebpf_stack_profile(
+    request: crate::metrics::ebpf_profiler::StackProfileRequest,
+) -> Result<()> {
+    EBPF_STACK_PROFILER.start(request)
+}
+
+/// Завершить сессию профилирования досрочно; `false`, если она не выполняется
+pub fn stop_ebpf_stack_profile() -> bool {
+    EBPF_STACK_PROFILER.stop()
+}
+
+/// Состояние текущей или последней сессии профилирования стеков
+pub fn ebpf_stack_profile_status() -> crate::metrics::ebpf_profiler::StackProfileStatus {
+    EBPF_STACK_PROFILER.status()
+}
+
+/// Результат последней завершённой сессии профилирования стеков
+pub fn ebpf_stack_profile() -> Option<Arc<crate::metrics::ebpf_profiler::StackProfile>> {
+    EBPF_STACK_PROFILER.profile()
+}
+
 pub fn read_file(path: &Path) -> Result<String> {
     fs::read_to_string(path).with_context(|| {
         format!(
@@ -6935,8 +7090,19 @@ SwapFree:        4096000 kB
             process_gpu_details: None,
             process_network_details: None,
             process_disk_details: None,
+            lifecycle_events: None,
+            syscall_latency_details: None,
+            program_overhead: None,
+            socket_traffic_details: None,
+            disk_latency_details: None,
+            disk_queue_details: None,
+            filesystem_process_details: None,
+            memory_stall_details: None,
+            cgroup_memory_stall_details: None,
+            cgroup_resource_details: None,
+            epoch_summaries: None,
         };
-        metrics.ebpf = Some(ebpf_metrics.clone());
+        metrics.ebpf = Some(ebpf_metrics.clone().into());
 
         // Проверяем, что eBPF метрики установлены корректно
         assert!(metrics.ebpf.is_some());
@@ -7008,7 +7174,7 @@ SwapFree:        4096000 kB
             hardware: HardwareMetrics::default(),
             disk: DiskMetrics::default(),
             gpu: None,
-            ebpf: Some(crate::metrics::ebpf::EbpfMetrics::default()),
+            ebpf: Some(crate::metrics::ebpf::EbpfSnapshot::default()),
             system_calls: SystemCallMetrics::default(),
             inode: InodeMetrics::default(),
             swap: SwapMetrics::default(),
@@ -0,0 +1,399 @@
+//! Снимок задач системы через итератор `iter/task`.
+//!
+//! Программа `task_snapshot.c` выдаёт по одной записи [`RawTaskSnapshot`]
+//! на каждую задачу ядра прямо из `task_struct`: идентификаторы, nice,
+//! состояние, время CPU, RSS, ошибки страниц, переключения контекста и
+//! cgroup. Весь вывод итератора читается одним проходом в переиспользуемый
+//! буфер и сворачивается по TGID без промежуточных векторов записей
+//! (см. [`fold_task_snapshot`]).
+//!
+//! Снимок заменяет чтение `/proc/[pid]/stat` и `/proc/[pid]/status` для
+//! каждого процесса на каждом цикле сбора: `process.rs` берёт из него список
+//! процессов и динамические поля, а `/proc` читает только для новых процессов
+//! (командная строка, исполняемый файл, окружение, cgroup path).
+
+use std::borrow::Cow;
+use std::collections::HashMap;
+
+/// Имя программы снимка задач.
+pub const TASK_SNAPSHOT_PROGRAM: &str = "task_snapshot";
+
+/// Итератор снимка задач (`task_snapshot.c`).
+pub const TASK_SNAPSHOT_ITER: &str = "dump_task_snapshot";
+
+/// Запись лидера группы потоков (содержит общие для процесса поля).
+pub const TASK_FLAG_LEADER: u32 = 1 << 0;
+
+/// Поток ядра.
+pub const TASK_FLAG_KTHREAD: u32 = 1 << 1;
+
+/// Запись задачи в раскладке ядра (`struct task_snapshot_record`).
+#[repr(C)]
+#[derive(Debug, Clone, Copy, Default, PartialEq, Eq)]
+pub struct RawTaskSnapshot {
+    pub pid: u32,
+    pub tgid: u32,
+    pub ppid: u32,
+    pub nice: i32,
+    /// `__state | exit_state`
+    pub state: u32,
+    /// `TASK_FLAG_*`
+    pub flags: u32,
+    pub utime_ns: u64,
+    pub stime_ns: u64,
+    /// Момент запуска от загрузки системы (заполнен только у лидера)
+    pub start_time_ns: u64,
+    /// RSS в страницах (заполнен только у лидера)
+    pub rss_pages: u64,
+    /// Страницы в swap (заполнен только у лидера)
+    pub swap_pages: u64,
+    pub min_flt: u64,
+    pub maj_flt: u64,
+    pub nvcsw: u64,
+    pub nivcsw: u64,
+    /// Идентификатор cgroup v2 (заполнен только у лидера)
+    pub cgroup_id: u64,
+    pub comm: [u8; 16],
+}
+
+/// Снимок процесса: записи его потоков, свёрнутые по TGID.
+#[derive(Debug, Clone, Default, PartialEq, Eq)]
+pub struct TaskSnapshot {
+    pub tgid: u32,
+    pub ppid: u32,
+    pub nice: i32,
+    /// Состояние лидера (`__state | exit_state`)
+    pub state: u32,
+    pub is_kernel_thread: bool,
+    /// Количество живых потоков, включая лидера
+    pub threads: u32,
+    /// Время в режиме пользователя всех потоков, включая завершившиеся
+    pub utime_ns: u64,
+    /// Время в режиме ядра всех потоков, включая завершившиеся
+    pub stime_ns: u64,
+    pub start_time_ns: u64,
+    pub rss_pages: u64,
+    pub swap_pages: u64,
+    pub min_flt: u64,
+    pub maj_flt: u64,
+    /// Добровольные переключения контекста лидера, как в `/proc/[pid]/status`
+    pub voluntary_ctx: u64,
+    /// Вытеснения лидера, как в `/proc/[pid]/status`
+    pub involuntary_ctx: u64,
+    pub cgroup_id: u64,
+    /// Имя лидера (`comm`), дополненное нулями
+    pub comm: [u8; 16],
+}
+
+impl TaskSnapshot {
+    /// Учесть запись одного потока процесса.
+    fn merge(&mut self, raw: &RawTaskSnapshot) {
+        self.threads += 1;
+        self.utime_ns = self.utime_ns.saturating_add(raw.utime_ns);
+        self.stime_ns = self.stime_ns.saturating_add(raw.stime_ns);
+        self.min_flt = self.min_flt.saturating_add(raw.min_flt);
+        self.maj_flt = self.maj_flt.saturating_add(raw.maj_flt);
+
+        if raw.flags & TASK_FLAG_LEADER != 0 {
+            self.tgid = raw.tgid;
+            self.ppid = raw.ppid;
+            self.nice = raw.nice;
+            self.state = raw.state;
+            self.is_kernel_thread = raw.flags & TASK_FLAG_KTHREAD != 0;
+            self.start_time_ns = raw.start_time_ns;
+            self.rss_pages = raw.rss_pages;
+            self.swap_pages = raw.swap_pages;
+            self.voluntary_ctx = raw.nvcsw;
+            self.involuntary_ctx = raw.nivcsw;
+            self.cgroup_id = raw.cgroup_id;
+            self.comm = raw.comm;
+        }
+    }
+
+    /// Имя лидера без завершающих нулей.
+    pub fn comm_str(&self) -> Cow<'_, str> {
+        let end = self
+            .comm
+            .iter()
+            .position(|&b| b == 0)
+            .unwrap_or(self.comm.len());
+        String::from_utf8_lossy(&self.comm[..end])
+    }
+
+    /// Время CPU процесса в наносекундах.
+    pub fn cpu_time_ns(&self) -> u64 {
+        self.utime_ns.saturating_add(self.stime_ns)
+    }
+
+    /// Время запуска в тиках часов, как поле `starttime` в `/proc/[pid]/stat`.
+    pub fn start_time_ticks(&self, ticks_per_second: u64) -> u64 {
+        let ns_per_tick = 1_000_000_000 / ticks_per_second.clamp(1, 1_000_000_000);
+        self.start_time_ns / ns_per_tick
+    }
+
+    /// RSS в мегабайтах, с тем же округлением, что и `VmRSS` в `process.rs`.
+    pub fn rss_mb(&self, page_size: u64) -> u64 {
+        pages_to_mb(self.rss_pages, page_size)
+    }
+
+    /// Объём в swap в мегабайтах.
+    pub fn swap_mb(&self, page_size: u64) -> u64 {
+        pages_to_mb(self.swap_pages, page_size)
+    }
+
+    /// Состояние процесса в виде варианта `procfs::process::ProcState`
+    /// (то же, что `format!("{:?}", stat.state)` для `/proc/[pid]/stat`).
+    pub fn state_name(&self) -> &'static str {
+        task_state_name(self.state)
+    }
+}
+
+/// Свернуть вывод итератора в снимки процессов по TGID.
+///
+/// Записи читаются прямо из буфера итератора. Потоки, лидер которых
+/// завершился во время прохода, отбрасываются, как и неполная запись в конце.
+pub fn fold_task_snapshot(bytes: &[u8]) -> HashMap<i32, TaskSnapshot> {
+    let size = std::mem::size_of::<RawTaskSnapshot>();
+    let mut processes: HashMap<i32, TaskSnapshot> = HashMap::with_capacity(bytes.len() / size / 4);
+
+    for chunk in bytes.chunks_exact(size) {
+        // SAFETY: chunk содержит ровно size_of::<RawTaskSnapshot>() байт, а любая
+        // последовательность байт — допустимое значение этой C-структуры
+        let raw: RawTaskSnapshot =
+            unsafe { std::ptr::read_unaligned(chunk.as_ptr() as *const RawTaskSnapshot) };
+        processes.entry(raw.tgid as i32).or_default().merge(&raw);
+    }
+
+    // TGID заполняется только из записи лидера
+    processes.retain(|_, process| process.tgid != 0);
+    processes
+}
+
+/// Имя состояния задачи по `__state | exit_state` в терминах `ProcState`.
+///
+/// Повторяет `task_state_index()` ядра: берётся старший бит из TASK_REPORT,
+/// а простаивающий поток ядра (`TASK_IDLE`) показывается отдельно.
+pub fn task_state_name(state: u32) -> &'static str {
+    // TASK_UNINTERRUPTIBLE | TASK_NOLOAD
+    const TASK_IDLE: u32 = 0x0402;
+    // TASK_RUNNING .. TASK_PARKED
+    const TASK_REPORT: u32 = 0x007f;
+
+    if state == TASK_IDLE {
+        return "Idle";
+    }
+
+    match 32 - (state & TASK_REPORT).leading_zeros() {
+        0 => "Running",
+        1 => "Sleeping",
+        2 => "Waiting",
+        3 => "Stopped",
+        4 => "Tracing",
+        5 => "Dead",
+        6 => "Zombie",
+        _ => "Parked",
+    }
+}
+
+fn pages_to_mb(pages: u64, page_size: u64) -> u64 {
+    pages.saturating_mul(page_size) / (1024 * 1024)
+}
+
+#[cfg(feature = "ebpf")]
+mod reader {
+    use super::{fold_task_snapshot, TaskSnapshot, TASK_SNAPSHOT_ITER, TASK_SNAPSHOT_PROGRAM};
+    use crate::metrics::ebpf_objects::EbpfObject;
+    use anyhow::{Context, Result};
+    use lazy_static::lazy_static;
+    use std::collections::HashMap;
+    use std::sync::Mutex;
+
+    /// Загруженная программа снимка и буфер вывода итератора.
+    pub struct TaskSnapshotReader {
+        object: EbpfObject,
+        buffer: Vec<u8>,
+    }
+
+    impl TaskSnapshotReader {
+        /// Загрузить программу снимка.
+        pub fn load() -> Result<Self> {
+            let object = EbpfObject::load(TASK_SNAPSHOT_PROGRAM)?;
+            Ok(Self {
+                object,
+                buffer: Vec::new(),
+            })
+        }
+
+        /// Снять снимок всех процессов.
+        pub fn read(&mut self) -> Result<HashMap<i32, TaskSnapshot>> {
+            let found = self
+                .object
+                .read_iterator_into(TASK_SNAPSHOT_ITER, &mut self.buffer)?;
+            if !found {
+                anyhow::bail!(
+                    "Итератор {} не прикреплён в объекте {}",
+                    TASK_SNAPSHOT_ITER,
+                    TASK_SNAPSHOT_PROGRAM
+                );
+            }
+            Ok(fold_task_snapshot(&self.buffer))
+        }
+    }
+
+    enum ReaderState {
+        NotLoaded,
+        Ready(TaskSnapshotReader),
+        Unavailable,
+    }
+
+    lazy_static! {
+        static ref TASK_SNAPSHOT_READER: Mutex<ReaderState> = Mutex::new(ReaderState::NotLoaded);
+    }
+
+    /// Снять снимок общей программой процесса.
+    ///
+    /// Программа загружается при первом вызове. Если загрузка или чтение не
+    /// удались, снимок отключается до перезапуска, и возвращается `None`.
+    pub fn read_task_snapshot() -> Option<HashMap<i32, TaskSnapshot>> {
+        let mut state = TASK_SNAPSHOT_READER.lock().ok()?;
+
+        if let ReaderState::NotLoaded = *state {
+            *state = match TaskSnapshotReader::load()
+                .context("Снимок задач через iter/task недоступен")
+            {
+                Ok(reader) => ReaderState::Ready(reader),
+                Err(e) => {
+                    tracing::warn!("{:#}; процессы будут читаться из /proc", e);
+                    ReaderState::Unavailable
+                }
+            };
+        }
+
+        let ReaderState::Ready(reader) = &mut *state else {
+            return None;
+        };
+
+        match reader.read() {
+            Ok(snapshot) => Some(snapshot),
+            Err(e) => {
+                tracing::warn!(
+                    "Не удалось прочитать снимок задач: {:#}; процессы будут читаться из /proc",
+                    e
+                );
+                *state = ReaderState::Unavailable;
+                None
+            }
+        }
+    }
+}
+
+#[cfg(feature = "ebpf")]
+pub use reader::{read_task_snapshot, TaskSnapshotReader};
+
+/// Без eBPF снимок недоступен.
+#[cfg(not(feature = "ebpf"))]
+pub fn read_task_snapshot() -> Option<HashMap<i32, TaskSnapshot>> {
+    None
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    fn as_bytes(records: &[RawTaskSnapshot]) -> Vec<u8> {
+        let size = std::mem::size_of_val(records);
+        // SAFETY: записи — Copy-структуры с C-раскладкой, читаются как байты
+        unsafe { std::slice::from_raw_parts(records.as_ptr() as *const u8, size).to_vec() }
+    }
+
+    fn task(pid: u32, tgid: u32) -> RawTaskSnapshot {
+        let mut raw = RawTaskSnapshot {
+            pid,
+            tgid,
+            utime_ns: 1_000,
+            stime_ns: 500,
+            min_flt: 10,
+            maj_flt: 1,
+            nvcsw: 5,
+            nivcsw: 2,
+            ..Default::default()
+        };
+        if pid == tgid {
+            raw.flags = TASK_FLAG_LEADER;
+            raw.ppid = 1;
+            raw.nice = -5;
+            raw.state = 0x0001;
+            raw.start_time_ns = 12_340_000_000;
+            raw.rss_pages = 512;
+            raw.swap_pages = 256;
+            raw.cgroup_id = 77;
+            raw.comm[..4].copy_from_slice(b"bash");
+        }
+        raw
+    }
+
+    #[test]
+    fn test_layout_matches_kernel() {
+        assert_eq!(std::mem::size_of::<RawTaskSnapshot>(), 120);
+        assert_eq!(std::mem::align_of::<RawTaskSnapshot>(), 8);
+    }
+
+    #[test]
+    fn test_fold_task_snapshot() {
+        // Поток идёт раньше лидера, процесс 300 без лидера отбрасывается
+        let mut bytes = as_bytes(&[
+            task(101, 100),
+            task(100, 100),
+            task(301, 300),
+            task(200, 200),
+        ]);
+        bytes.extend_from_slice(&[0xff; 7]);
+        let snapshot = fold_task_snapshot(&bytes);
+
+        assert_eq!(snapshot.len(), 2);
+        let process = &snapshot[&100];
+        assert_eq!(process.tgid, 100);
+        assert_eq!(process.threads, 2);
+        assert_eq!(process.ppid, 1);
+        assert_eq!(process.nice, -5);
+        assert_eq!(process.cpu_time_ns(), 3_000);
+        assert_eq!(process.min_flt, 20);
+        assert_eq!(process.maj_flt, 2);
+        // Переключения контекста только лидера
+        assert_eq!(process.voluntary_ctx, 5);
+        assert_eq!(process.involuntary_ctx, 2);
+        assert_eq!(process.cgroup_id, 77);
+        assert_eq!(process.comm_str(), "bash");
+        assert_eq!(process.state_name(), "Sleeping");
+        assert!(!process.is_kernel_thread);
+        assert_eq!(snapshot[&200].threads, 1);
+
+        assert!(fold_task_snapshot(&[]).is_empty());
+    }
+
+    #[test]
+    fn test_unit_conversions() {
+        let process = TaskSnapshot {
+            start_time_ns: 12_345_678_901,
+            rss_pages: 2560,
+            swap_pages: 255,
+            ..Default::default()
+        };
+        assert_eq!(process.start_time_ticks(100), 1234);
+        assert_eq!(process.rss_mb(4096), 10);
+        assert_eq!(process.swap_mb(4096), 0);
+    }
+
+    #[test]
+    fn test_task_state_name() {
+        assert_eq!(task_state_name(0x0000), "Running");
+        assert_eq!(task_state_name(0x0001), "Sleeping");
+        assert_eq!(task_state_name(0x0002), "Waiting");
+        assert_eq!(task_state_name(0x0402), "Idle");
+        assert_eq!(task_state_name(0x0004), "Stopped");
+        // TASK_TRACED = TASK_WAKEKILL | __TASK_TRACED
+        assert_eq!(task_state_name(0x0108), "Tracing");
+        assert_eq!(task_state_name(0x0020), "Zombie");
+        assert_eq!(task_state_name(0x0040), "Parked");
+    }
+}
@@ -146,6 +146,17 @@ fn test_ebpf_metrics_structure() {
         process_gpu_details: None,
         process_network_details: None,
         process_disk_details: None,
+        lifecycle_events: None,
+        syscall_latency_details: None,
+        program_overhead: None,
+        socket_traffic_details: None,
+        disk_latency_details: None,
+        disk_queue_details: None,
+        filesystem_process_details: None,
+        memory_stall_details: None,
+        cgroup_memory_stall_details: None,
+        cgroup_resource_details: None,
+        epoch_summaries: None,
     };
 
     // Проверяем, что структура корректно хранит данные
@@ -210,6 +221,17 @@ fn test_ebpf_metrics_cloning() {
         process_gpu_details: None,
         process_network_details: None,
         process_disk_details: None,
+        lifecycle_events: None,
+        syscall_latency_details: None,
+        program_overhead: None,
+        socket_traffic_details: None,
+        disk_latency_details: None,
+        disk_queue_details: None,
+        filesystem_process_details: None,
+        memory_stall_details: None,
+        cgroup_memory_stall_details: None,
+        cgroup_resource_details: None,
+        epoch_summaries: None,
     };
 
     let metrics2 = metrics1.clone();